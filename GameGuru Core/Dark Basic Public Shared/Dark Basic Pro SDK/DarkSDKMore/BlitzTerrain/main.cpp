@@ -2,15 +2,44 @@
 #include "createobject.h"
 #include "rttms.h"
 #include "code-from-dbp.h"
+#include "smoothing.h"
 #include "CObjectsC.h"
 #include "CMemblocks.h"
 #include "CGfxC.h"
 #include ".\..\..\Shared\Objects\ShadowMapping\cShadowMaps.h"
+#include ".\..\..\..\Include\cThreadPool.h"
 
 bool update_mesh_light(sMesh* pMesh, sObject* pObject, sFrame* pFrame);
 
 s_BT_main BT_Main;
 
+// sectors are built and refreshed on the thread pool when there is one
+extern cThreadPool* g_pThreadPool;
+
+template<class F>
+static void BT_Intern_Parallel(int Count,int Grain,F& Func)
+{
+	if(g_pThreadPool!=NULL)
+		g_pThreadPool->parallel_for(0,Count,Grain,Func);
+	else
+		for(int i=0;i<Count;i++)
+			Func(i);
+}
+
+static unsigned long BT_Intern_ThreadSlots()
+{
+	return g_pThreadPool!=NULL?(unsigned long)g_pThreadPool->size()+1:1;
+}
+
+static unsigned long BT_Intern_ThreadSlot()
+{
+	// slot 0 is the calling thread, then one per pool worker
+	cThreadPoolWorkerInfo& Worker=cThreadPoolCurrentWorker();
+	if(g_pThreadPool!=NULL && Worker.pool==g_pThreadPool)
+		return Worker.index+1;
+	return 0;
+}
+
 // shadow mapping
 extern CascadedShadowsManager g_CascadedShadow;
 
@@ -861,6 +890,7 @@ void BT_BuildTerrain(unsigned long terrainid,unsigned long ObjectID,bool Generat
 	//Make sectors
 		Terrain->Sectors=0;
 		Generator.Size=Terrain->LODLevel[0].SectorDetail;
+		Generator.Scratch=NULL;
 		if(Excludememblock>0)
 		{
 			Generator.exclusion=(bool*)malloc((Generator.Size+1)*(Generator.Size+1)*sizeof(bool));
@@ -874,6 +904,9 @@ void BT_BuildTerrain(unsigned long terrainid,unsigned long ObjectID,bool Generat
 			BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
 		BT_Intern_StartQuadMapGeneration(Generator);
 
+	//Without an exclusion map the quadmaps are generated afterwards all at once
+		std::vector<BT_Quadmap_Generator> SectorGenerators;
+
 		for(LODLevel=0;LODLevel<Terrain->LODLevels;LODLevel++)
 		{
 			s_BT_LODLevel* LODLevelPtr=&Terrain->LODLevel[LODLevel];
@@ -948,9 +981,6 @@ void BT_BuildTerrain(unsigned long terrainid,unsigned long ObjectID,bool Generat
 				if(Column==LODLevelPtr->Split-1)
 					Generator.RemoveFarZ=true;
 
-			//Get heights for this sector
-				BT_Intern_GetSectorHeights(Terrain,LODLevel,Row,Column,Generator.heights);
-
 				Terrain->LODLevel[LODLevel].Sector[Sector].Excluded=false;
 				if(Excludememblock>0)
 				{
@@ -978,7 +1008,13 @@ void BT_BuildTerrain(unsigned long terrainid,unsigned long ObjectID,bool Generat
 					if(SectorPtr->QuadMap==nullptr)
 						BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
 					memset(SectorPtr->QuadMap,0,sizeof(BT_QuadMap));
-					SectorPtr->QuadMap->Generate(Generator);
+					if(Excludememblock>0)
+					{
+						BT_Intern_GetSectorHeights(Terrain,LODLevel,Row,Column,Generator.heights);
+						SectorPtr->QuadMap->Generate(Generator);
+					}else{
+						SectorGenerators.push_back(Generator);
+					}
 				}
 
 				//Sector Info
@@ -1000,7 +1036,43 @@ void BT_BuildTerrain(unsigned long terrainid,unsigned long ObjectID,bool Generat
 			}
 		}
 
+	//Generate quadmaps, each thread with its own heights and scratch
+		if(SectorGenerators.empty()==false)
+		{
+			unsigned long Slots=BT_Intern_ThreadSlots();
+			std::vector<float*> SlotHeights(Slots,(float*)NULL);
+			std::vector<BT_QuadMap_Main> SlotScratch(Slots);
+			memset(&SlotScratch[0],0,Slots*sizeof(BT_QuadMap_Main));
+			SlotHeights[0]=Generator.heights;
+			for(unsigned long Slot=1;Slot<Slots;Slot++)
+			{
+				SlotHeights[Slot]=(float*)malloc((Generator.Size+1)*(Generator.Size+1)*sizeof(float));
+				if(SlotHeights[Slot]==nullptr)
+					BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
+				BT_Intern_AllocateQuadMapScratch(&SlotScratch[Slot],Generator.Size);
+			}
+
+			auto GenerateSector=[&](int i)
+			{
+				unsigned long Slot=BT_Intern_ThreadSlot();
+				BT_Quadmap_Generator SectorGenerator=SectorGenerators[i];
+				SectorGenerator.heights=SlotHeights[Slot];
+				SectorGenerator.Scratch=Slot>0?&SlotScratch[Slot]:NULL;
+				s_BT_Sector* SectorPtr=SectorGenerator.Sector;
+				BT_Intern_GetSectorHeights(Terrain,SectorGenerator.LODLevel,SectorPtr->Row,SectorPtr->Column,SectorGenerator.heights);
+				SectorPtr->QuadMap->Generate(SectorGenerator);
+			};
+			BT_Intern_Parallel((int)SectorGenerators.size(),1,GenerateSector);
+
+			for(unsigned long Slot=1;Slot<Slots;Slot++)
+			{
+				free(SlotHeights[Slot]);
+				BT_Intern_FreeQuadMapScratch(&SlotScratch[Slot]);
+			}
+		}
+
 	//Post process quadmap
+		std::vector<BT_QuadMap*> NormalQuadMaps;
 		for(LODLevel=0;LODLevel<Terrain->LODLevels;LODLevel++)
 		{
 			Generator.TileSize=C_BT_INTERNALSCALE*Terrain->LODLevel[LODLevel].TileSpan;
@@ -1035,12 +1107,19 @@ void BT_BuildTerrain(unsigned long terrainid,unsigned long ObjectID,bool Generat
 						if(OtherSectorPtr->Excluded==false)
 							SectorPtr->QuadMap->Below=OtherSectorPtr->QuadMap;
 					}
-					
-					SectorPtr->QuadMap->CalculateNormals();
+
+					NormalQuadMaps.push_back(SectorPtr->QuadMap);
 				}
 			}
 		}
 
+	//Normals read the heights of neighbouring sectors, so only once every quadmap is made
+		auto CalculateSectorNormals=[&](int i)
+		{
+			NormalQuadMaps[i]->CalculateNormals();
+		};
+		BT_Intern_Parallel((int)NormalQuadMaps.size(),1,CalculateSectorNormals);
+
 	//Delete exclusion
 		if(Excludememblock>0)
 			DeleteMemblock(Excludememblock);
@@ -1208,6 +1287,28 @@ int BT_ContinueBuild()
 		if(BT_Main.CurrentBuildTerrainSector+numsectorstomake>BT_Main.CurrentBuildTerrain->Sectors)
 			numsectorstomake=BT_Main.CurrentBuildTerrain->Sectors-BT_Main.CurrentBuildTerrainSector;
 
+	//Generate the meshdata of the sectors about to be built together, the buffers are then made one at a time
+		std::vector<BT_QuadMap*> BuildQuadMaps;
+		unsigned long BuildLODLevel=BT_Main.CurrentBuildLODLevel;
+		unsigned long BuildSector=BT_Main.CurrentBuildSector;
+		for(I=0;I<numsectorstomake;I++)
+		{
+			s_BT_Sector* SectorPtr=&BT_Main.CurrentBuildTerrain->LODLevel[BuildLODLevel].Sector[BuildSector];
+			if(SectorPtr->Excluded==false)
+				BuildQuadMaps.push_back(SectorPtr->QuadMap);
+			BuildSector++;
+			if(BuildSector==BT_Main.CurrentBuildTerrain->LODLevel[BuildLODLevel].Sectors)
+			{
+				BuildSector=0;
+				BuildLODLevel++;
+			}
+		}
+		auto GenerateSectorMeshData=[&](int i)
+		{
+			BuildQuadMaps[i]->GenerateMeshData();
+		};
+		BT_Intern_Parallel((int)BuildQuadMaps.size(),1,GenerateSectorMeshData);
+
 	//Loop
 		for(I=0;I<numsectorstomake;I++)
 		{
@@ -1557,6 +1658,7 @@ void BT_MakeSectorObject(unsigned long terrainid,unsigned long LODLevel,unsigned
 						sObject* Object=BT_Intern_CreateBlankObject(ObjectID,1);
 
 						//Generate the mesh
+						BT_Intern_RefreshSector(&BT_Main.Terrains[terrainid].LODLevel[LODLevel].Sector[SectorID]);
 						BT_Main.Terrains[terrainid].LODLevel[LODLevel].Sector[SectorID].QuadMap->GenerateDBPMesh(Object->pFrame->pMesh);
 
 						// for now only reference the actual LOD1 sector as we can guarentee this clipping is perfect.
@@ -1610,6 +1712,9 @@ void BT_MakeTerrainObject(unsigned long terrainid,unsigned long LODLevel,unsigne
 		//Variables
 			unsigned long SectorID=0;
 
+		//Bring any changed sectors up to date
+			BT_Intern_RefreshTerrain(&BT_Main.Terrains[terrainid]);
+
 		//Generate the object
 			sObject* Object=BT_Intern_CreateBlankObject(ObjectID,BT_Main.Terrains[terrainid].LODLevel[LODLevel].Sectors);
 
@@ -2056,6 +2161,75 @@ void BT_UpdateTerrainCull(unsigned long TerrainID)
 
 
 
+// =================================
+// === BT UPDATE TERRAIN REGION ===
+// =================================
+void BT_UpdateTerrainRegion(unsigned long TerrainID,unsigned long TVrow,unsigned long TVcol,unsigned long Rows,unsigned long Cols)
+{
+//Set current function
+	BT_Main.CurrentFunction=C_BT_FUNCTION_UPDATETERRAINREGION;
+
+//Check that the terrain exists
+	if(BT_Intern_TerrainExist(TerrainID))
+	{
+		s_BT_terrain* Terrain=&BT_Main.Terrains[TerrainID];
+
+	//Check that the terrain is generated and the region has points
+		if(Terrain->Generated==false)
+		{
+			BT_Intern_Error(C_BT_ERROR_TERRAINNOTGENERATED);
+			return;
+		}
+		if(Rows==0 || Cols==0)
+			return;
+		unsigned long LastTVrow=min(TVrow+Rows-1,(unsigned long)Terrain->Heightmapsize);
+		unsigned long LastTVcol=min(TVcol+Cols-1,(unsigned long)Terrain->Heightmapsize);
+
+	//Unlock the sectors the region is on, a point on an edge is in the sectors both sides
+		std::vector<s_BT_Sector*> ChangedSectors;
+		for(unsigned char LODLevel=0;LODLevel<Terrain->LODLevels;LODLevel++)
+		{
+			s_BT_LODLevel* LODLevelPtr=&Terrain->LODLevel[LODLevel];
+			unsigned long SectorPoints=LODLevelPtr->SectorDetail*LODLevelPtr->TileSpan;
+			unsigned long TopS=TVrow/SectorPoints;
+			unsigned long LeftS=TVcol/SectorPoints;
+			if(TopS*SectorPoints==TVrow && TopS>0)
+				TopS--;
+			if(LeftS*SectorPoints==TVcol && LeftS>0)
+				LeftS--;
+			unsigned long BottomS=min(LastTVrow/SectorPoints,(unsigned long)LODLevelPtr->Split-1);
+			unsigned long RightS=min(LastTVcol/SectorPoints,(unsigned long)LODLevelPtr->Split-1);
+			for(unsigned long Srow=TopS;Srow<=BottomS;Srow++)
+			{
+				for(unsigned long Scol=LeftS;Scol<=RightS;Scol++)
+				{
+					s_BT_Sector* SectorPtr=&LODLevelPtr->Sector[Srow*LODLevelPtr->Split+Scol];
+					if(SectorPtr->Excluded==false)
+					{
+						BT_Intern_UnlockSectorVertexData(SectorPtr);
+						if(SectorPtr->QuadMap->NeedsRefresh() || SectorPtr->UpdateObjects)
+							ChangedSectors.push_back(SectorPtr);
+					}
+				}
+			}
+		}
+
+	//Rebuild the changed sectors together, then their seams
+		if(ChangedSectors.empty()==false)
+		{
+			BT_Intern_RefreshSectors(&ChangedSectors[0],(unsigned long)ChangedSectors.size());
+			for(unsigned long i=0;i<ChangedSectors.size();i++)
+				BT_Intern_FixSectorLODSeams(ChangedSectors[i]);
+		}
+	}else{
+		BT_Intern_Error(C_BT_ERROR_TERRAINDOESNTEXIST);
+		return;
+	}
+}
+// === END FUNCTION ===
+
+
+
 // =========================
 // === BT RENDER TERRAIN ===
 // =========================
@@ -2250,6 +2424,7 @@ void BT_Intern_Render()
 
 				//Update Cull
 				BT_RTTMS_UnlockTerrain(&BT_Main.Terrains[TerrainID]);
+				BT_Intern_RefreshTerrain(&BT_Main.Terrains[TerrainID]);
 				BT_Intern_UpdateCullBoxesRec(&BT_Main.Terrains[TerrainID],BT_Main.Terrains[TerrainID].QuadTree,BT_Main.Terrains[TerrainID].QuadTreeLevels);
 
 				// camera 30 (cube rendering) does not cull terrain visibility
@@ -3152,8 +3327,9 @@ static void BT_Intern_FixSectorLODSeams(s_BT_Sector* SectorPtr)
 	{
 		if(SectorPtr->QuadTree->Culled==false && SectorPtr->QuadTree->DrawThis==true)
 		{
-		//Make sure that the sector is unlocked
+		//Make sure that the sector is unlocked and up to date before the sides are set
 			BT_Intern_UnlockSectorVertexData(SectorPtr);
+			BT_Intern_RefreshSector(SectorPtr);
 
 		//Update sides
 			// Top
@@ -3914,6 +4090,8 @@ static char* BT_Intern_GetFunctionName(int number)
 		Name="BT MakeTerrainObject";
 	}else if(number==C_BT_FUNCTION_ENABLEAUTORENDER){
 		Name="BT EnableAutoRender";
+	}else if(number==C_BT_FUNCTION_UPDATETERRAINREGION){
+		Name="BT UpdateTerrainRegion";
 	}
 
 //Return the name
@@ -4731,7 +4909,7 @@ void BT_Intern_RTTMSUpdateHandler(unsigned long TerrainID,unsigned long LODLevel
 //Change mesh data
 	if(EndVertex>0)
 	{
-	//Update meshdata
+	//Update meshdata, the mesh itself is refreshed with the other changed sectors by BT_Intern_RefreshSector
 		Sector->QuadMap->ChangeMeshData(StartVertex,EndVertex,Vertices);
 		Sector->UpdateMesh=true;
 
@@ -4741,7 +4919,40 @@ void BT_Intern_RTTMSUpdateHandler(unsigned long TerrainID,unsigned long LODLevel
 		Sector->TopSideNeedsUpdate=true;
 		Sector->BottomSideNeedsUpdate=true;
 
-	//Update collision
+	//Update collision once the mesh is refreshed
+		Sector->UpdateObjects=true;
+
+	//Say that the cull box has changed
+		s_BT_QuadTree* QuadTree=Sector->QuadTree;
+		do{
+			QuadTree->CullboxChanged=true;
+			QuadTree=QuadTree->Parent;
+		}while(QuadTree!=NULL);
+	}
+#endif
+}
+// === END FUNCTION ===
+
+
+
+// ================================
+// === BT INTERN REFRESH SECTOR ===
+// ================================
+static void BT_Intern_RefreshSector(s_BT_Sector* Sector)
+{
+//Bring the quadmap up to date, new mesh data has lost its side LOD
+	if(Sector->QuadMap->RefreshMeshData()==true)
+	{
+		Sector->UpdateMesh=true;
+		Sector->LeftSideNeedsUpdate=true;
+		Sector->RightSideNeedsUpdate=true;
+		Sector->TopSideNeedsUpdate=true;
+		Sector->BottomSideNeedsUpdate=true;
+	}
+
+//Update collision
+	if(Sector->UpdateObjects==true)
+	{
 		if(Sector->DBPObject!=0){
 			Sector->QuadMap->UpdateDBPMesh(Sector->DBPObject->pFrame->pMesh);
 		}
@@ -4750,15 +4961,50 @@ void BT_Intern_RTTMSUpdateHandler(unsigned long TerrainID,unsigned long LODLevel
 			if ( Sector->LODLevelObjectFrame )
 				Sector->QuadMap->UpdateDBPMesh(Sector->LODLevelObjectFrame->pMesh);
 		}
+		Sector->UpdateObjects=false;
+	}
+}
+// === END FUNCTION ===
 
-	//Say that the cull box has changed
-		s_BT_QuadTree* QuadTree=Sector->QuadTree;
-		do{
-			QuadTree->CullboxChanged=true;
-			QuadTree=QuadTree->Parent;
-		}while(QuadTree!=NULL);
+
+
+// =================================
+// === BT INTERN REFRESH SECTORS ===
+// =================================
+static void BT_Intern_RefreshSectors(s_BT_Sector** Sectors,unsigned long Count)
+{
+//Sectors only write to themselves and read their neighbours heights, so they can all be refreshed at once
+	auto RefreshSector=[&](int i)
+	{
+		BT_Intern_RefreshSector(Sectors[i]);
+	};
+	BT_Intern_Parallel((int)Count,1,RefreshSector);
+}
+// === END FUNCTION ===
+
+
+
+// =================================
+// === BT INTERN REFRESH TERRAIN ===
+// =================================
+static void BT_Intern_RefreshTerrain(s_BT_terrain* Terrain)
+{
+//Find the sectors with changes waiting
+	std::vector<s_BT_Sector*> ChangedSectors;
+	for(unsigned char LODLevel=0;LODLevel<Terrain->LODLevels;LODLevel++)
+	{
+		s_BT_LODLevel* LODLevelPtr=&Terrain->LODLevel[LODLevel];
+		for(unsigned long Sector=0;Sector<LODLevelPtr->Sectors;Sector++)
+		{
+			s_BT_Sector* SectorPtr=&LODLevelPtr->Sector[Sector];
+			if(SectorPtr->Excluded==false && (SectorPtr->QuadMap->NeedsRefresh() || SectorPtr->UpdateObjects))
+				ChangedSectors.push_back(SectorPtr);
+		}
 	}
-#endif
+
+//Refresh them
+	if(ChangedSectors.empty()==false)
+		BT_Intern_RefreshSectors(&ChangedSectors[0],(unsigned long)ChangedSectors.size());
 }
 // === END FUNCTION ===
 
@@ -4785,24 +5031,6 @@ static float BT_Intern_GetHeightFromColor(unsigned long Colour)
 // =========================
 static void BT_Intern_SmoothTerrain(s_BT_terrain* Terrain)
 {
-//Loop through smooth levels
-	for(unsigned char SmoothLevel=0;SmoothLevel<Terrain->Smoothing;SmoothLevel++){
-		for(unsigned short y=1;y<Terrain->Heightmapsize-1;y++){
-			for(unsigned short x=1;x<Terrain->Heightmapsize-1;x++){
-				float CornA=Terrain->HeightPoint[(x-1)+(y-1)*Terrain->Heightmapsize];
-				float CornB=Terrain->HeightPoint[(x+1)+(y-1)*Terrain->Heightmapsize];
-				float CornC=Terrain->HeightPoint[(x-1)+(y+1)*Terrain->Heightmapsize];
-				float CornD=Terrain->HeightPoint[(x+1)+(y+1)*Terrain->Heightmapsize];
-				float NexA=Terrain->HeightPoint[(x-1)+y*Terrain->Heightmapsize];
-				float NexB=Terrain->HeightPoint[(x+1)+y*Terrain->Heightmapsize];
-				float NexC=Terrain->HeightPoint[x+(y-1)*Terrain->Heightmapsize];
-				float NexD=Terrain->HeightPoint[x+(y+1)*Terrain->Heightmapsize];
-				float Middle=Terrain->HeightPoint[x+y*Terrain->Heightmapsize];
-				float CornerAverage=(CornA+CornB+CornC+CornD)/4.0f;
-				float NeighborAverage=(CornerAverage+NexA+NexB+NexC+NexD)/5.0f;
-				Terrain->HeightPoint[x+y*Terrain->Heightmapsize]=(Middle+NeighborAverage)/2.0f;
-			}
-		}
-	}
+	BT_Intern_SmoothHeights(Terrain->HeightPoint,Terrain->Heightmapsize,Terrain->Smoothing,g_pThreadPool);
 }
 // === END FUNCTION ===
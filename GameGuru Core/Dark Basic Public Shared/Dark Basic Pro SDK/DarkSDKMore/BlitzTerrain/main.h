@@ -98,6 +98,9 @@ struct s_BT_Sector
 	//Update mesh bool
 	bool UpdateMesh;
 
+	//Collision objects wait for the quadmap to be refreshed
+	bool UpdateObjects;
+
 	//RTTMS
 	bool VertexDataLocked;
 	BT_RTTMS_STRUCT* VertexDataRTTMS;
@@ -419,6 +422,9 @@ struct BT_RTTMS_VERTEX;
 void BT_Intern_RTTMSUpdateHandler(unsigned long TerrainID,unsigned long LODLevelID,unsigned long SectorID,unsigned short StartVertex,unsigned short EndVertex,float* VerticesPtr);
 
 static void BT_Intern_SmoothTerrain(s_BT_terrain* Terrain);
+static void BT_Intern_RefreshSector(s_BT_Sector* Sector);
+static void BT_Intern_RefreshSectors(s_BT_Sector** Sectors,unsigned long Count);
+static void BT_Intern_RefreshTerrain(s_BT_terrain* Terrain);
 
 
 #define C_BT_ERROR_MAXTERRAINSEXCEDED 1
@@ -506,6 +512,7 @@ static void BT_Intern_SmoothTerrain(s_BT_terrain* Terrain);
 #define C_BT_FUNCTION_GETSECTORINFO 62
 #define C_BT_FUNCTION_MAKETERRAINOBJECT 63
 #define C_BT_FUNCTION_ENABLEAUTORENDER 64
+#define C_BT_FUNCTION_UPDATETERRAINREGION 65
 
 #define C_BT_INSTRUCTION_SETCURRENTCAMERA 1
 #define C_BT_INSTRUCTION_UPDATETERRAINCULL 3
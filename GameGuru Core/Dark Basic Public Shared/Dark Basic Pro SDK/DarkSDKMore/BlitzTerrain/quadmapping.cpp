@@ -8,40 +8,53 @@ extern IGGDevice* m_pD3D;
 
 void BT_Intern_StartQuadMapGeneration(BT_Quadmap_Generator Generator)
 {
-	if(BT_Main.QuadmapInfo.Locked==false){
-		BT_Main.QuadmapInfo.Locked=true;
-		BT_Main.QuadmapInfo.TempVertices=(Generator.Size+1)*(Generator.Size+1)+1;
-		BT_Main.QuadmapInfo.TempQuads=Generator.Size*Generator.Size;
-		BT_Main.QuadmapInfo.TempVertexdata=(BT_Quadmap_Vertex*)malloc((BT_Main.QuadmapInfo.TempVertices+1)*sizeof(BT_Quadmap_Vertex));
-		if(BT_Main.QuadmapInfo.TempVertexdata==nullptr)
-			BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
-		memset(BT_Main.QuadmapInfo.TempVertexdata,0,(BT_Main.QuadmapInfo.TempVertices+1)*sizeof(BT_Quadmap_Vertex));
-		BT_Main.QuadmapInfo.TempQuaddata=(BT_Quadmap_Quad*)malloc(BT_Main.QuadmapInfo.TempQuads*sizeof(BT_Quadmap_Quad));
-		if(BT_Main.QuadmapInfo.TempQuaddata==nullptr)
-			BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
-		memset(BT_Main.QuadmapInfo.TempQuaddata,0,BT_Main.QuadmapInfo.TempQuads*sizeof(BT_Quadmap_Quad));
-		BT_Main.QuadmapInfo.TempVertexMap=(BT_Quadmap_Vertex***)malloc((Generator.Size+1)*sizeof(BT_Quadmap_Vertex**));
-		if(BT_Main.QuadmapInfo.TempVertexMap==nullptr)
+	if(BT_Main.QuadmapInfo.Locked==false)
+		BT_Intern_AllocateQuadMapScratch(&BT_Main.QuadmapInfo,Generator.Size);
+}
+
+void BT_Intern_EndQuadMapGeneration()
+{
+	BT_Intern_FreeQuadMapScratch(&BT_Main.QuadmapInfo);
+}
+
+void BT_Intern_AllocateQuadMapScratch(BT_QuadMap_Main* Scratch,unsigned char Size)
+{
+	Scratch->Locked=true;
+	Scratch->TempVertices=(Size+1)*(Size+1)+1;
+	Scratch->TempQuads=Size*Size;
+	Scratch->TempVertexdata=(BT_Quadmap_Vertex*)malloc((Scratch->TempVertices+1)*sizeof(BT_Quadmap_Vertex));
+	if(Scratch->TempVertexdata==nullptr)
+		BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
+	memset(Scratch->TempVertexdata,0,(Scratch->TempVertices+1)*sizeof(BT_Quadmap_Vertex));
+	Scratch->TempQuaddata=(BT_Quadmap_Quad*)malloc(Scratch->TempQuads*sizeof(BT_Quadmap_Quad));
+	if(Scratch->TempQuaddata==nullptr)
+		BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
+	memset(Scratch->TempQuaddata,0,Scratch->TempQuads*sizeof(BT_Quadmap_Quad));
+	Scratch->TempVertexMap=(BT_Quadmap_Vertex***)malloc((Size+1)*sizeof(BT_Quadmap_Vertex**));
+	if(Scratch->TempVertexMap==nullptr)
+		BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
+	memset(Scratch->TempVertexMap,0,(Size+1)*sizeof(BT_Quadmap_Vertex**));
+	Scratch->TempVertexMapRows=Size+1;
+	for(unsigned long i=0;i<unsigned(Size+1);i++){
+		Scratch->TempVertexMap[i]=(BT_Quadmap_Vertex**)malloc((Size+1)*sizeof(BT_Quadmap_Vertex*));
+		if(Scratch->TempVertexMap[i]==nullptr)
 			BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
-		memset(BT_Main.QuadmapInfo.TempVertexMap,0,(Generator.Size+1)*sizeof(BT_Quadmap_Vertex**));
-		for(unsigned long i=0;i<unsigned(Generator.Size+1);i++){
-			BT_Main.QuadmapInfo.TempVertexMap[i]=(BT_Quadmap_Vertex**)malloc((Generator.Size+1)*sizeof(BT_Quadmap_Vertex*));
-			if(BT_Main.QuadmapInfo.TempVertexMap[i]==nullptr)
-				BT_Intern_Error(C_BT_ERROR_MEMORYERROR);
-			memset(BT_Main.QuadmapInfo.TempVertexMap[i],0,(Generator.Size+1)*sizeof(BT_Quadmap_Vertex*));
-		}
+		memset(Scratch->TempVertexMap[i],0,(Size+1)*sizeof(BT_Quadmap_Vertex*));
 	}
 }
 
-void BT_Intern_EndQuadMapGeneration()
+void BT_Intern_FreeQuadMapScratch(BT_QuadMap_Main* Scratch)
 {
-	if(BT_Main.QuadmapInfo.Locked){
-		free(BT_Main.QuadmapInfo.TempVertexdata);
-		free(BT_Main.QuadmapInfo.TempQuaddata);
-		free(BT_Main.QuadmapInfo.TempVertexMap);
-		BT_Main.QuadmapInfo.TempVertices=0;
-		BT_Main.QuadmapInfo.TempQuads=0;
-		BT_Main.QuadmapInfo.Locked=false;
+	if(Scratch->Locked){
+		for(unsigned long i=0;i<Scratch->TempVertexMapRows;i++)
+			free(Scratch->TempVertexMap[i]);
+		free(Scratch->TempVertexdata);
+		free(Scratch->TempQuaddata);
+		free(Scratch->TempVertexMap);
+		Scratch->TempVertices=0;
+		Scratch->TempQuads=0;
+		Scratch->TempVertexMapRows=0;
+		Scratch->Locked=false;
 	}
 }
 
@@ -74,9 +87,10 @@ void BT_QuadMap::Generate(BT_Quadmap_Generator Generator)
 	TileSize=Generator.TileSize;
 
 //Allocate Vertices and Quads
-	TempVertex=BT_Main.QuadmapInfo.TempVertexdata;
-	TempQuad=BT_Main.QuadmapInfo.TempQuaddata;
-	BT_Quadmap_Vertex*** VertexMap=BT_Main.QuadmapInfo.TempVertexMap;
+	BT_QuadMap_Main* Scratch=Generator.Scratch!=NULL?Generator.Scratch:&BT_Main.QuadmapInfo;
+	TempVertex=Scratch->TempVertexdata;
+	TempQuad=Scratch->TempQuaddata;
+	BT_Quadmap_Vertex*** VertexMap=Scratch->TempVertexMap;
 
 //Allocate Quadmap
 	QuadMap=(BT_Quadmap_Quad**)malloc(Quads*sizeof(BT_Quadmap_Quad*));
@@ -997,16 +1011,42 @@ void BT_QuadMap::ChangeMeshData(unsigned short VertexStart,unsigned short Vertex
 		for(unsigned short Vertexn=VertexStart;Vertexn<VertexEnd+1;Vertexn++)
 			Vertex[Vertexn].Pos_y=Vertices[Vertexn];
 
-	//Regenerate mesh data
+	//Mesh data, bounds and normals are left to RefreshMeshData, so every sector
+	//changed at the same time can be refreshed together once all their heights are in
 		UpdateVertices=true;
-		GenerateMeshData();
+		RefreshBounds=true;
+		RefreshNormals=true;
+	}
+}
+
+bool BT_QuadMap::RefreshMeshData()
+{
+//Variables
+	bool Regenerated=false;
 
+//Check that the quadmap is generated
+	if(Generated==true){
 	//Recalculate bounds
-		CalculateBounds();
+		if(RefreshBounds==true){
+			CalculateBounds();
+			RefreshBounds=false;
+		}
 
-	//Refresh normals
-		RefreshNormals=true;
+	//Recalculate normals, they go into the mesh with the positions
+		if(RefreshNormals==true){
+			CalculateNormals();
+			RefreshNormals=false;
+			UpdateVertices=true;
+		}
+
+	//Regenerate mesh data, this undoes any side LOD so the caller has to fix the seams again
+		if(MeshMade==true && UpdateVertices==true){
+			GenerateMeshData();
+			UpdateVertexBuffer=true;
+			Regenerated=true;
+		}
 	}
+	return Regenerated;
 }
 
 void BT_QuadMap::DeleteInternalData()
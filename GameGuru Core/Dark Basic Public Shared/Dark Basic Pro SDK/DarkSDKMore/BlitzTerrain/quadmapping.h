@@ -3,6 +3,7 @@
 
 ///struct GGVECTOR4;
 struct s_BT_Sector;
+struct BT_QuadMap_Main;
 
 struct BT_Quadmap_Generator
 {
@@ -18,6 +19,7 @@ struct BT_Quadmap_Generator
 	unsigned long LODLevel;
 	bool RemoveFarX;
 	bool RemoveFarZ;
+	BT_QuadMap_Main* Scratch; //NULL for BT_Main.QuadmapInfo, sectors generated together each need their own
 };
 
 struct BT_Quadmap_Vertex
@@ -106,6 +108,8 @@ public:
 	void DeleteInternalData();
 	void ReduceQuad(unsigned short QuadTL,unsigned short QuadTR,unsigned short QuadBL,unsigned short QuadBR,BT_Quadmap_Quad* Quads, bool CheckHeights);
 	void ChangeMeshData(unsigned short VertexStart,unsigned short VertexEnd,float* Vertices);
+	bool RefreshMeshData();
+	bool NeedsRefresh() {return Generated && (RefreshBounds || RefreshNormals || (MeshMade && UpdateVertices));}
 	unsigned short FindVertex(unsigned short Vrow,unsigned short Vcol);
 
 	BT_QuadMap* Above;
@@ -137,6 +141,7 @@ private:
 	bool UpdateVertices;
 	bool UpdateIndices;
 	bool RefreshNormals;
+	bool RefreshBounds;
 
 	//Buffer updates
 	bool UpdateVertexBuffer;
@@ -163,6 +168,8 @@ private:
 
 void BT_Intern_StartQuadMapGeneration(BT_Quadmap_Generator Generator);
 void BT_Intern_EndQuadMapGeneration();
+void BT_Intern_AllocateQuadMapScratch(BT_QuadMap_Main* Scratch,unsigned char Size);
+void BT_Intern_FreeQuadMapScratch(BT_QuadMap_Main* Scratch);
 
 struct BT_QuadMap_Main
 {
@@ -170,6 +177,7 @@ struct BT_QuadMap_Main
 	BT_Quadmap_Vertex* TempVertexdata;
 	BT_Quadmap_Quad* TempQuaddata;
 	BT_Quadmap_Vertex*** TempVertexMap;
+	unsigned long TempVertexMapRows;
 	unsigned long TempVertices;
 	unsigned long TempQuads;
 };
@@ -0,0 +1,61 @@
+#include "smoothing.h"
+#include ".\..\..\..\Include\cThreadPool.h"
+#include <vector>
+#include <atomic>
+#include <thread>
+
+void BT_Intern_SmoothHeights(float* HeightPoint,long Size,unsigned long Levels,cThreadPool* ThreadPool)
+{
+	if(Levels==0 || Size<3)
+		return;
+
+//Each point is smoothed with the points before it already smoothed, so a row can be
+//worked on alongside the row above it as long as it stays two points behind. Rows
+//are handed out in order and say how far along they are, which keeps the result
+//exactly the same as smoothing one point at a time
+	std::vector< std::atomic<long> > Progress(Size);
+	std::atomic<long> NextRow(1);
+	auto SmoothRows=[&](int)
+	{
+		for(;;)
+		{
+			long y=NextRow.fetch_add(1);
+			if(y>=Size-1)
+				break;
+			long Ready=Progress[y-1].load(std::memory_order_acquire);
+			for(long x=1;x<Size-1;x++){
+				while(Ready<x+2){
+					std::this_thread::yield();
+					Ready=Progress[y-1].load(std::memory_order_acquire);
+				}
+				float CornA=HeightPoint[(x-1)+(y-1)*Size];
+				float CornB=HeightPoint[(x+1)+(y-1)*Size];
+				float CornC=HeightPoint[(x-1)+(y+1)*Size];
+				float CornD=HeightPoint[(x+1)+(y+1)*Size];
+				float NexA=HeightPoint[(x-1)+y*Size];
+				float NexB=HeightPoint[(x+1)+y*Size];
+				float NexC=HeightPoint[x+(y-1)*Size];
+				float NexD=HeightPoint[x+(y+1)*Size];
+				float Middle=HeightPoint[x+y*Size];
+				float CornerAverage=(CornA+CornB+CornC+CornD)/4.0f;
+				float NeighborAverage=(CornerAverage+NexA+NexB+NexC+NexD)/5.0f;
+				HeightPoint[x+y*Size]=(Middle+NeighborAverage)/2.0f;
+				if((x&31)==0)
+					Progress[y].store(x+1,std::memory_order_release);
+			}
+			Progress[y].store(Size,std::memory_order_release);
+		}
+	};
+
+//Loop through smooth levels
+	for(unsigned long SmoothLevel=0;SmoothLevel<Levels;SmoothLevel++){
+		Progress[0].store(Size);
+		for(long y=1;y<Size;y++)
+			Progress[y].store(0);
+		NextRow.store(1);
+		if(ThreadPool!=NULL)
+			ThreadPool->parallel_for(0,(int)ThreadPool->size()+1,1,SmoothRows);
+		else
+			SmoothRows(0);
+	}
+}
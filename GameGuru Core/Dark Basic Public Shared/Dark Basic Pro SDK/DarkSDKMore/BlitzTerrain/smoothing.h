@@ -0,0 +1,10 @@
+#ifndef _SMOOTHING_H
+#define _SMOOTHING_H
+
+class cThreadPool;
+
+//Smooths a square heightmap Levels times, edge points are left alone. Runs as a row
+//wavefront on the pool when there is one and gives the same heights as the serial loop
+void BT_Intern_SmoothHeights(float* HeightPoint,long Size,unsigned long Levels,cThreadPool* ThreadPool);
+
+#endif
@@ -118,6 +118,134 @@ void BT_SetGroundHeight(unsigned long TerrainID,float X,float Z,float Height)
 
 
 
+//Region heights, Heights holds Rows heights for the first column then the next and so on
+
+void BT_GetPointHeights(unsigned long TerrainID,unsigned long TVrow,unsigned long TVcol,unsigned long Rows,unsigned long Cols,float* Heights)
+{
+//Check that the terrain exists
+	if(BT_Intern_TerrainExist(TerrainID))
+	{
+	//Get terrain info
+		BT_TerrainInfo* TerrainInfo=(BT_TerrainInfo*)BT_GetTerrainInfo(TerrainID);
+
+	//Check that the terrain is built and generated, and the region has points
+		if(TerrainInfo->Built==true && TerrainInfo->Generated==true && Rows>0 && Cols>0)
+		{
+		//The first LODLevel has every point, read each sector the region is on once. The far
+		//edge of the terrain is only in the last sector
+			BT_LODLevelInfo* LODLevelInfo=(BT_LODLevelInfo*)BT_GetLODLevelInfo(TerrainID,0);
+			unsigned long Detail=LODLevelInfo->SectorDetail;
+			unsigned long LastS=LODLevelInfo->Split-1;
+			unsigned long LastRow=min(TVrow+Rows-1,(unsigned long)TerrainInfo->Heightmapsize);
+			unsigned long LastCol=min(TVcol+Cols-1,(unsigned long)TerrainInfo->Heightmapsize);
+			for(unsigned long Srow=min(TVrow/Detail,LastS);Srow<=min(LastRow/Detail,LastS);Srow++)
+			{
+				for(unsigned long Scol=min(TVcol/Detail,LastS);Scol<=min(LastCol/Detail,LastS);Scol++)
+				{
+					BT_UnlockVertexData();
+					BT_LockVertexdataForSector(TerrainID,0,Srow*LODLevelInfo->Split+Scol);
+					unsigned long FirstRow=max(TVrow,Srow*Detail);
+					unsigned long FirstCol=max(TVcol,Scol*Detail);
+					unsigned long EndRow=min(LastRow,(Srow+1)*Detail);
+					unsigned long EndCol=min(LastCol,(Scol+1)*Detail);
+					for(unsigned long Col=FirstCol;Col<=EndCol;Col++)
+					{
+						for(unsigned long Row=FirstRow;Row<=EndRow;Row++)
+						{
+						#ifdef COMPILE_GDK
+							float Height=BT_GetVertexPositionY((unsigned short)(Row-Srow*Detail),(unsigned short)(Col-Scol*Detail));
+						#else
+							unsigned long temp=BT_GetVertexPositionY((unsigned short)(Row-Srow*Detail),(unsigned short)(Col-Scol*Detail));
+							float Height=*(float*)&temp;
+						#endif
+							Heights[(Col-TVcol)*Rows+(Row-TVrow)]=Height;
+						}
+					}
+					BT_UnlockVertexData();
+				}
+			}
+		}
+	}
+}
+
+void BT_SetPointHeights(unsigned long TerrainID,unsigned long TVrow,unsigned long TVcol,unsigned long Rows,unsigned long Cols,const float* Heights)
+{
+//Check that the terrain exists
+	if(BT_Intern_TerrainExist(TerrainID))
+	{
+	//Get terrain info
+		BT_TerrainInfo* TerrainInfo=(BT_TerrainInfo*)BT_GetTerrainInfo(TerrainID);
+
+	//Check that the terrain is built and generated, and the region has points
+		if(TerrainInfo->Built==true && TerrainInfo->Generated==true && Rows>0 && Cols>0)
+		{
+			unsigned long LastTVrow=min(TVrow+Rows-1,(unsigned long)TerrainInfo->Heightmapsize);
+			unsigned long LastTVcol=min(TVcol+Cols-1,(unsigned long)TerrainInfo->Heightmapsize);
+
+		//Loop through LODLevels
+			for(unsigned char LODLevel=0;LODLevel<TerrainInfo->LODLevels;LODLevel++)
+			{
+			//Get LODLevel info
+				BT_LODLevelInfo* LODLevelInfo=(BT_LODLevelInfo*)BT_GetLODLevelInfo(TerrainID,LODLevel);
+				unsigned long Detail=LODLevelInfo->SectorDetail;
+
+			//Find the points of this LODLevel in the region
+				unsigned long TwoPowerLODLevel=1<<LODLevel;
+				unsigned long FirstVrow=(TVrow+TwoPowerLODLevel-1)/TwoPowerLODLevel;
+				unsigned long FirstVcol=(TVcol+TwoPowerLODLevel-1)/TwoPowerLODLevel;
+				unsigned long LastVrow=LastTVrow/TwoPowerLODLevel;
+				unsigned long LastVcol=LastTVcol/TwoPowerLODLevel;
+				if(FirstVrow>LastVrow || FirstVcol>LastVcol)
+					continue;
+
+			//Find the sectors the points are on, a point on an edge is in the sectors both sides
+				unsigned long TopS=FirstVrow/Detail;
+				unsigned long LeftS=FirstVcol/Detail;
+				if(TopS*Detail==FirstVrow && TopS>0)
+					TopS--;
+				if(LeftS*Detail==FirstVcol && LeftS>0)
+					LeftS--;
+				unsigned long BottomS=min(LastVrow/Detail,(unsigned long)LODLevelInfo->Split-1);
+				unsigned long RightS=min(LastVcol/Detail,(unsigned long)LODLevelInfo->Split-1);
+
+			//Lock each sector once and only write the points that differ, so the update covers just those
+				for(unsigned long Srow=TopS;Srow<=BottomS;Srow++)
+				{
+					for(unsigned long Scol=LeftS;Scol<=RightS;Scol++)
+					{
+						BT_UnlockVertexData();
+						BT_LockVertexdataForSector(TerrainID,LODLevel,Srow*LODLevelInfo->Split+Scol);
+						unsigned long StartVrow=max(FirstVrow,Srow*Detail);
+						unsigned long StartVcol=max(FirstVcol,Scol*Detail);
+						unsigned long EndVrow=min(LastVrow,(Srow+1)*Detail);
+						unsigned long EndVcol=min(LastVcol,(Scol+1)*Detail);
+						for(unsigned long Vcol=StartVcol;Vcol<=EndVcol;Vcol++)
+						{
+							for(unsigned long Vrow=StartVrow;Vrow<=EndVrow;Vrow++)
+							{
+								float Height=Heights[(Vcol*TwoPowerLODLevel-TVcol)*Rows+(Vrow*TwoPowerLODLevel-TVrow)];
+							#ifdef COMPILE_GDK
+								float CurrentHeight=BT_GetVertexPositionY((unsigned short)(Vrow-Srow*Detail),(unsigned short)(Vcol-Scol*Detail));
+							#else
+								unsigned long temp=BT_GetVertexPositionY((unsigned short)(Vrow-Srow*Detail),(unsigned short)(Vcol-Scol*Detail));
+								float CurrentHeight=*(float*)&temp;
+							#endif
+								if(*(unsigned int*)&CurrentHeight!=*(unsigned int*)&Height)
+									BT_SetVertexHeight((unsigned short)(Vrow-Srow*Detail),(unsigned short)(Vcol-Scol*Detail),Height);
+							}
+						}
+						BT_UnlockVertexData();
+					}
+				}
+			}
+
+		//Rebuild just the sectors that changed, all together
+			BT_UpdateTerrainRegion(TerrainID,TVrow,TVcol,Rows,Cols);
+		}
+	}
+}
+
+
 //CIRCLE BRUSHES
 
 typedef float(*CircleBrush_t)(float XDist,float ZDist,float MidHeight,float Radius,float Amount,float CurrentHeight,float CapHeight);
@@ -381,7 +381,9 @@ inline void MemSetQuad(void *dest, UINT data, int count)
 		} // end asm
 	#else
 	//LB: and the 64-bit equiv.
-	memset(dest, data, count * 4);
+	// memset only repeats the low byte, so store whole quads
+	UINT* pQuad = (UINT*)dest;
+	for ( int i = 0; i < count; i++ ) pQuad[i] = data;
 	#endif
 } // end MemSetQuad
 
@@ -0,0 +1,571 @@
+//
+// Occlusion Rasterizer
+//
+
+#include "OcclusionRasterizer.h"
+#include ".\..\..\..\Include\cThreadPool.h"
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	// a clip space vertex, only x, y and w matter for depth as 1/w
+	struct sClipVertex
+	{
+		float x, y, w;
+	};
+
+	// signed distance to the clip plane, in front when not negative
+	inline float ClipDistance ( const sClipVertex& v, int plane, float nearClip )
+	{
+		switch ( plane )
+		{
+			case 0 : return v.x + v.w * OCCLUSION_GUARD_BAND;
+			case 1 : return v.w * OCCLUSION_GUARD_BAND - v.x;
+			case 2 : return v.y + v.w * OCCLUSION_GUARD_BAND;
+			case 3 : return v.w * OCCLUSION_GUARD_BAND - v.y;
+		}
+		return v.w - nearClip;
+	}
+
+	inline int ClipOutcode ( const sClipVertex& v, float nearClip )
+	{
+		int code = 0;
+		for ( int plane = 0; plane < 5; plane++ )
+			if ( ClipDistance ( v, plane, nearClip ) < 0.0f ) code |= 1 << plane;
+		return code;
+	}
+}
+
+cOcclusionRasterizer::cOcclusionRasterizer()
+	:	width(0), height(0), bufferWidth(0), bufferHeight(0), tilesX(0), tilesY(0), blocksX(0), blocksY(0),
+		nearClip(1.0f), backfaceCulling(true), jobCount(0)
+{
+	memset ( matrix, 0, sizeof(matrix) );
+	memset ( planes, 0, sizeof(planes) );
+	memset ( stats, 0, sizeof(stats) );
+}
+
+cOcclusionRasterizer::~cOcclusionRasterizer()
+{
+}
+
+void cOcclusionRasterizer::setResolution(int newWidth, int newHeight)
+{
+	if ( newWidth < 1 ) newWidth = 1;
+	if ( newHeight < 1 ) newHeight = 1;
+	if ( newWidth == width && newHeight == height ) return;
+
+	width = newWidth;
+	height = newHeight;
+	tilesX = (width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+	tilesY = (height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+	bufferWidth = tilesX * OCCLUSION_TILE_WIDTH;
+	bufferHeight = tilesY * OCCLUSION_TILE_HEIGHT;
+	blocksX = bufferWidth / OCCLUSION_BLOCK_SIZE;
+	blocksY = bufferHeight / OCCLUSION_BLOCK_SIZE;
+
+	depth.assign ( bufferWidth * bufferHeight, 0.0f );
+	blockMin.assign ( blocksX * blocksY, 0.0f );
+	blockMax.assign ( blocksX * blocksY, 0.0f );
+
+	// bins are sized for the old tile count
+	jobs.clear();
+	jobCount = 0;
+}
+
+void cOcclusionRasterizer::begin(const float viewProjection[16], float nearDistance)
+{
+	memcpy ( matrix, viewProjection, sizeof(matrix) );
+	nearClip = nearDistance;
+	vertices.clear();
+	stats[OCCLUSION_STAT_TRIANGLES] = 0;
+	stats[OCCLUSION_STAT_DRAWN] = 0;
+
+	// view planes in world space from the columns of the matrix, clip = v * M
+	const float* m = matrix;
+	for ( int i = 0; i < 4; i++ )
+	{
+		float column0 = m [ i * 4 + 0 ];
+		float column1 = m [ i * 4 + 1 ];
+		float column3 = m [ i * 4 + 3 ];
+		planes[0][i] = column3 + column0;
+		planes[1][i] = column3 - column0;
+		planes[2][i] = column3 + column1;
+		planes[3][i] = column3 - column1;
+		planes[4][i] = column3;
+	}
+	planes[4][3] -= nearClip;
+	for ( int p = 0; p < 5; p++ )
+	{
+		float length = sqrtf ( planes[p][0]*planes[p][0] + planes[p][1]*planes[p][1] + planes[p][2]*planes[p][2] );
+		if ( length > 0.0f )
+			for ( int i = 0; i < 4; i++ )
+				planes[p][i] /= length;
+	}
+}
+
+void cOcclusionRasterizer::addTriangles(const float* triangles, int count)
+{
+	if ( count <= 0 ) return;
+	vertices.insert ( vertices.end(), triangles, triangles + count * 9 );
+	stats[OCCLUSION_STAT_TRIANGLES] += count;
+}
+
+void cOcclusionRasterizer::addTriangle(const float* a, const float* b, const float* c)
+{
+	vertices.insert ( vertices.end(), a, a + 3 );
+	vertices.insert ( vertices.end(), b, b + 3 );
+	vertices.insert ( vertices.end(), c, c + 3 );
+	stats[OCCLUSION_STAT_TRIANGLES]++;
+}
+
+bool cOcclusionRasterizer::isSphereOutside(const float centre[3], float radius) const
+{
+	for ( int p = 0; p < 5; p++ )
+	{
+		float distance = planes[p][0]*centre[0] + planes[p][1]*centre[1] + planes[p][2]*centre[2] + planes[p][3];
+		if ( distance < -radius ) return true;
+	}
+	return false;
+}
+
+void cOcclusionRasterizer::render(cThreadPool* pool)
+{
+	if ( width == 0 ) return;
+
+	int tileCount = tilesX * tilesY;
+	int triangleCount = getTriangleCount();
+	jobCount = (triangleCount + OCCLUSION_SETUP_GRAIN - 1) / OCCLUSION_SETUP_GRAIN;
+	if ( (int)jobs.size() < jobCount ) jobs.resize ( jobCount );
+	for ( int j = 0; j < jobCount; j++ )
+	{
+		jobs[j].triangles.clear();
+		jobs[j].bins.resize ( tileCount );
+		for ( int t = 0; t < tileCount; t++ )
+			jobs[j].bins[t].clear();
+	}
+
+	// set up and bin, then rasterize each tile from the bins of every job in order
+	auto setup = [this] ( int j ) { setupTriangles ( j ); };
+	auto raster = [this] ( int t ) { rasterizeTile ( t ); };
+	if ( pool )
+	{
+		pool->parallel_for ( 0, jobCount, 1, setup );
+		pool->parallel_for ( 0, tileCount, 1, raster );
+	}
+	else
+	{
+		for ( int j = 0; j < jobCount; j++ ) setup ( j );
+		for ( int t = 0; t < tileCount; t++ ) raster ( t );
+	}
+
+	unsigned int drawn = 0;
+	for ( int j = 0; j < jobCount; j++ )
+		drawn += (unsigned int)jobs[j].triangles.size();
+	stats[OCCLUSION_STAT_DRAWN] = drawn;
+}
+
+void cOcclusionRasterizer::setupTriangles(int j)
+{
+	Job& job = jobs[j];
+	int first = j * OCCLUSION_SETUP_GRAIN;
+	int last = first + OCCLUSION_SETUP_GRAIN;
+	if ( last > getTriangleCount() ) last = getTriangleCount();
+
+	const float* m = matrix;
+	for ( int t = first; t < last; t++ )
+	{
+		const float* v = &vertices [ t * 9 ];
+		float clip[9];
+		for ( int i = 0; i < 3; i++, v += 3 )
+		{
+			clip [ i*3 + 0 ] = v[0]*m[0] + v[1]*m[4] + v[2]*m[8] + m[12];
+			clip [ i*3 + 1 ] = v[0]*m[1] + v[1]*m[5] + v[2]*m[9] + m[13];
+			clip [ i*3 + 2 ] = v[0]*m[3] + v[1]*m[7] + v[2]*m[11] + m[15];
+		}
+		setupTriangle ( clip, job );
+	}
+}
+
+void cOcclusionRasterizer::setupTriangle(const float* clip, Job& job)
+{
+	// clip against the near plane and a guard band around the view, most
+	// triangles are wholly inside or outside and skip the polygon clipper
+	sClipVertex polygon[2][8];
+	int count = 3;
+	memcpy ( polygon[0], clip, sizeof(sClipVertex) * 3 );
+	int code0 = ClipOutcode ( polygon[0][0], nearClip );
+	int code1 = ClipOutcode ( polygon[0][1], nearClip );
+	int code2 = ClipOutcode ( polygon[0][2], nearClip );
+	if ( code0 & code1 & code2 ) return;
+	int current = 0;
+	if ( code0 | code1 | code2 )
+	{
+		int planesCrossed = code0 | code1 | code2;
+		for ( int plane = 0; plane < 5 && count >= 3; plane++ )
+		{
+			if ( !(planesCrossed & (1 << plane)) ) continue;
+			const sClipVertex* in = polygon[current];
+			sClipVertex* out = polygon[current ^ 1];
+			int outCount = 0;
+			for ( int i = 0; i < count; i++ )
+			{
+				const sClipVertex& a = in[i];
+				const sClipVertex& b = in[(i + 1) % count];
+				float da = ClipDistance ( a, plane, nearClip );
+				float db = ClipDistance ( b, plane, nearClip );
+				if ( da >= 0.0f ) out[outCount++] = a;
+				if ( (da >= 0.0f) != (db >= 0.0f) )
+				{
+					float s = da / (da - db);
+					out[outCount].x = a.x + (b.x - a.x) * s;
+					out[outCount].y = a.y + (b.y - a.y) * s;
+					out[outCount].w = a.w + (b.w - a.w) * s;
+					outCount++;
+				}
+			}
+			count = outCount;
+			current ^= 1;
+		}
+		if ( count < 3 ) return;
+	}
+
+	// to pixels, y down
+	float sx[8], sy[8], sz[8];
+	float halfWidth = width * 0.5f;
+	float halfHeight = height * 0.5f;
+	for ( int i = 0; i < count; i++ )
+	{
+		const sClipVertex& v = polygon[current][i];
+		float invW = 1.0f / v.w;
+		sx[i] = (v.x * invW + 1.0f) * halfWidth;
+		sy[i] = (1.0f - v.y * invW) * halfHeight;
+		sz[i] = invW;
+	}
+
+	// fan out the clipped polygon
+	for ( int i = 1; i + 1 < count; i++ )
+	{
+		int i0 = 0, i1 = i, i2 = i + 1;
+		float area = (sx[i1] - sx[i0]) * (sy[i2] - sy[i0]) - (sx[i2] - sx[i0]) * (sy[i1] - sy[i0]);
+		if ( area == 0.0f ) continue;
+		if ( area < 0.0f )
+		{
+			if ( backfaceCulling ) continue;
+			i1 = i + 1;
+			i2 = i;
+			area = -area;
+		}
+
+		// pixel centres inside the bounds
+		float minX = sx[i0], maxX = sx[i0], minY = sy[i0], maxY = sy[i0];
+		if ( sx[i1] < minX ) minX = sx[i1];
+		if ( sx[i1] > maxX ) maxX = sx[i1];
+		if ( sx[i2] < minX ) minX = sx[i2];
+		if ( sx[i2] > maxX ) maxX = sx[i2];
+		if ( sy[i1] < minY ) minY = sy[i1];
+		if ( sy[i1] > maxY ) maxY = sy[i1];
+		if ( sy[i2] < minY ) minY = sy[i2];
+		if ( sy[i2] > maxY ) maxY = sy[i2];
+		Triangle tri;
+		tri.minX = (int)ceilf ( minX - 0.5f );
+		tri.minY = (int)ceilf ( minY - 0.5f );
+		tri.maxX = (int)floorf ( maxX - 0.5f );
+		tri.maxY = (int)floorf ( maxY - 0.5f );
+		if ( tri.minX < 0 ) tri.minX = 0;
+		if ( tri.minY < 0 ) tri.minY = 0;
+		if ( tri.maxX > width - 1 ) tri.maxX = width - 1;
+		if ( tri.maxY > height - 1 ) tri.maxY = height - 1;
+		if ( tri.minX > tri.maxX || tri.minY > tri.maxY ) continue;
+
+		// edge functions of v0v1, v1v2 and v2v0, positive to the inside
+		int index[3] = { i0, i1, i2 };
+		for ( int e = 0; e < 3; e++ )
+		{
+			int a = index[e];
+			int b = index[(e + 1) % 3];
+			tri.edgeA[e] = sy[a] - sy[b];
+			tri.edgeB[e] = sx[b] - sx[a];
+			tri.edgeC[e] = -(tri.edgeA[e] * sx[a] + tri.edgeB[e] * sy[a]);
+		}
+
+		// each vertex is weighted by the edge opposite it over the area
+		float invArea = 1.0f / area;
+		float z0 = sz[i0] * invArea, z1 = sz[i1] * invArea, z2 = sz[i2] * invArea;
+		tri.depthA = z0 * tri.edgeA[1] + z1 * tri.edgeA[2] + z2 * tri.edgeA[0];
+		tri.depthB = z0 * tri.edgeB[1] + z1 * tri.edgeB[2] + z2 * tri.edgeB[0];
+		tri.depthC = z0 * tri.edgeC[1] + z1 * tri.edgeC[2] + z2 * tri.edgeC[0];
+
+		int number = (int)job.triangles.size();
+		job.triangles.push_back ( tri );
+		int tileX0 = tri.minX / OCCLUSION_TILE_WIDTH, tileX1 = tri.maxX / OCCLUSION_TILE_WIDTH;
+		int tileY0 = tri.minY / OCCLUSION_TILE_HEIGHT, tileY1 = tri.maxY / OCCLUSION_TILE_HEIGHT;
+		for ( int ty = tileY0; ty <= tileY1; ty++ )
+			for ( int tx = tileX0; tx <= tileX1; tx++ )
+				job.bins [ ty * tilesX + tx ].push_back ( number );
+	}
+}
+
+void cOcclusionRasterizer::rasterizeTile(int tile)
+{
+	int tileX = (tile % tilesX) * OCCLUSION_TILE_WIDTH;
+	int tileY = (tile / tilesX) * OCCLUSION_TILE_HEIGHT;
+
+	for ( int y = 0; y < OCCLUSION_TILE_HEIGHT; y++ )
+		memset ( &depth [ (tileY + y) * bufferWidth + tileX ], 0, sizeof(float) * OCCLUSION_TILE_WIDTH );
+
+	for ( int j = 0; j < jobCount; j++ )
+	{
+		const Job& job = jobs[j];
+		const std::vector<int>& bin = job.bins[tile];
+		for ( size_t b = 0; b < bin.size(); b++ )
+		{
+			const Triangle& tri = job.triangles [ bin[b] ];
+			int x0 = tri.minX > tileX ? tri.minX : tileX;
+			int y0 = tri.minY > tileY ? tri.minY : tileY;
+			int x1 = tri.maxX < tileX + OCCLUSION_TILE_WIDTH - 1 ? tri.maxX : tileX + OCCLUSION_TILE_WIDTH - 1;
+			int y1 = tri.maxY < tileY + OCCLUSION_TILE_HEIGHT - 1 ? tri.maxY : tileY + OCCLUSION_TILE_HEIGHT - 1;
+			rasterizeTriangle ( tri, x0, y0, x1, y1 );
+		}
+	}
+
+	buildBlocks ( tile );
+}
+
+void cOcclusionRasterizer::rasterizeTriangle(const Triangle& tri, int x0, int y0, int x1, int y1)
+{
+	// four pixels at a time from a multiple of four, which never leaves the tile
+	x0 &= ~3;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 four = _mm_set1_ps ( 4.0f );
+	const __m128 startX = _mm_add_ps ( _mm_set1_ps ( (float)x0 ), _mm_setr_ps ( 0.5f, 1.5f, 2.5f, 3.5f ) );
+	const __m128 a0 = _mm_set1_ps ( tri.edgeA[0] ), a1 = _mm_set1_ps ( tri.edgeA[1] ), a2 = _mm_set1_ps ( tri.edgeA[2] );
+	const __m128 za = _mm_set1_ps ( tri.depthA );
+
+	for ( int y = y0; y <= y1; y++ )
+	{
+		float py = y + 0.5f;
+		__m128 row0 = _mm_set1_ps ( tri.edgeB[0] * py + tri.edgeC[0] );
+		__m128 row1 = _mm_set1_ps ( tri.edgeB[1] * py + tri.edgeC[1] );
+		__m128 row2 = _mm_set1_ps ( tri.edgeB[2] * py + tri.edgeC[2] );
+		__m128 rowZ = _mm_set1_ps ( tri.depthB * py + tri.depthC );
+		__m128 px = startX;
+		float* pDepth = &depth [ y * bufferWidth ];
+		for ( int x = x0; x <= x1; x += 4, px = _mm_add_ps ( px, four ) )
+		{
+			__m128 e0 = _mm_add_ps ( _mm_mul_ps ( a0, px ), row0 );
+			__m128 e1 = _mm_add_ps ( _mm_mul_ps ( a1, px ), row1 );
+			__m128 e2 = _mm_add_ps ( _mm_mul_ps ( a2, px ), row2 );
+			__m128 inside = _mm_cmpge_ps ( _mm_min_ps ( e0, _mm_min_ps ( e1, e2 ) ), zero );
+			if ( _mm_movemask_ps ( inside ) == 0 ) continue;
+
+			// 1/w is positive on every drawn pixel so pixels outside can add zero
+			__m128 z = _mm_and_ps ( _mm_add_ps ( _mm_mul_ps ( za, px ), rowZ ), inside );
+			_mm_storeu_ps ( pDepth + x, _mm_max_ps ( _mm_loadu_ps ( pDepth + x ), z ) );
+		}
+	}
+}
+
+void cOcclusionRasterizer::buildBlocks(int tile)
+{
+	int tileX = (tile % tilesX) * OCCLUSION_TILE_WIDTH;
+	int tileY = (tile / tilesX) * OCCLUSION_TILE_HEIGHT;
+	for ( int by = tileY; by < tileY + OCCLUSION_TILE_HEIGHT; by += OCCLUSION_BLOCK_SIZE )
+	{
+		for ( int bx = tileX; bx < tileX + OCCLUSION_TILE_WIDTH; bx += OCCLUSION_BLOCK_SIZE )
+		{
+			// only pixels on the screen count, the padding is never drawn to
+			int block = (by / OCCLUSION_BLOCK_SIZE) * blocksX + bx / OCCLUSION_BLOCK_SIZE;
+			int x1 = bx + OCCLUSION_BLOCK_SIZE < width ? bx + OCCLUSION_BLOCK_SIZE : width;
+			int y1 = by + OCCLUSION_BLOCK_SIZE < height ? by + OCCLUSION_BLOCK_SIZE : height;
+			if ( bx >= x1 || by >= y1 )
+			{
+				blockMin[block] = 0.0f;
+				blockMax[block] = 0.0f;
+				continue;
+			}
+			if ( x1 - bx == OCCLUSION_BLOCK_SIZE )
+			{
+				__m128 lo = _mm_set1_ps ( 3.4e38f ), hi = _mm_setzero_ps();
+				for ( int y = by; y < y1; y++ )
+				{
+					const float* pDepth = &depth [ y * bufferWidth + bx ];
+					for ( int x = 0; x < OCCLUSION_BLOCK_SIZE; x += 4 )
+					{
+						__m128 d = _mm_loadu_ps ( pDepth + x );
+						lo = _mm_min_ps ( lo, d );
+						hi = _mm_max_ps ( hi, d );
+					}
+				}
+				lo = _mm_min_ps ( lo, _mm_shuffle_ps ( lo, lo, _MM_SHUFFLE(1,0,3,2) ) );
+				lo = _mm_min_ps ( lo, _mm_shuffle_ps ( lo, lo, _MM_SHUFFLE(2,3,0,1) ) );
+				hi = _mm_max_ps ( hi, _mm_shuffle_ps ( hi, hi, _MM_SHUFFLE(1,0,3,2) ) );
+				hi = _mm_max_ps ( hi, _mm_shuffle_ps ( hi, hi, _MM_SHUFFLE(2,3,0,1) ) );
+				_mm_store_ss ( &blockMin[block], lo );
+				_mm_store_ss ( &blockMax[block], hi );
+			}
+			else
+			{
+				float lo = 3.4e38f, hi = 0.0f;
+				for ( int y = by; y < y1; y++ )
+				{
+					const float* pDepth = &depth [ y * bufferWidth ];
+					for ( int x = bx; x < x1; x++ )
+					{
+						if ( pDepth[x] < lo ) lo = pDepth[x];
+						if ( pDepth[x] > hi ) hi = pDepth[x];
+					}
+				}
+				blockMin[block] = lo;
+				blockMax[block] = hi;
+			}
+		}
+	}
+}
+
+int cOcclusionRasterizer::testBox(const float* box) const
+{
+	if ( width == 0 ) return OCCLUSION_VISIBLE;
+
+	// all eight corners, four at a time
+	const float* m = matrix;
+	const __m128 cornerX = _mm_setr_ps ( box[0], box[3], box[0], box[3] );
+	const __m128 cornerY = _mm_setr_ps ( box[1], box[1], box[4], box[4] );
+	__m128 partX = _mm_add_ps ( _mm_mul_ps ( cornerX, _mm_set1_ps ( m[0] ) ), _mm_mul_ps ( cornerY, _mm_set1_ps ( m[4] ) ) );
+	__m128 partY = _mm_add_ps ( _mm_mul_ps ( cornerX, _mm_set1_ps ( m[1] ) ), _mm_mul_ps ( cornerY, _mm_set1_ps ( m[5] ) ) );
+	__m128 partW = _mm_add_ps ( _mm_mul_ps ( cornerX, _mm_set1_ps ( m[3] ) ), _mm_mul_ps ( cornerY, _mm_set1_ps ( m[7] ) ) );
+	__m128 clipX[2], clipY[2], clipW[2];
+	for ( int i = 0; i < 2; i++ )
+	{
+		float z = box [ 2 + i * 3 ];
+		clipX[i] = _mm_add_ps ( partX, _mm_set1_ps ( z * m[8] + m[12] ) );
+		clipY[i] = _mm_add_ps ( partY, _mm_set1_ps ( z * m[9] + m[13] ) );
+		clipW[i] = _mm_add_ps ( partW, _mm_set1_ps ( z * m[11] + m[15] ) );
+	}
+
+	// outside when every corner is beyond the same plane
+	const __m128 nearW = _mm_set1_ps ( nearClip );
+	int outside = 0x1f, behind = 0;
+	for ( int i = 0; i < 2; i++ )
+	{
+		__m128 negW = _mm_sub_ps ( _mm_setzero_ps(), clipW[i] );
+		int left = _mm_movemask_ps ( _mm_cmplt_ps ( clipX[i], negW ) );
+		int right = _mm_movemask_ps ( _mm_cmpgt_ps ( clipX[i], clipW[i] ) );
+		int bottom = _mm_movemask_ps ( _mm_cmplt_ps ( clipY[i], negW ) );
+		int top = _mm_movemask_ps ( _mm_cmpgt_ps ( clipY[i], clipW[i] ) );
+		int nearMask = _mm_movemask_ps ( _mm_cmplt_ps ( clipW[i], nearW ) );
+		int all = 0;
+		if ( left == 15 ) all |= 1;
+		if ( right == 15 ) all |= 2;
+		if ( bottom == 15 ) all |= 4;
+		if ( top == 15 ) all |= 8;
+		if ( nearMask == 15 ) all |= 16;
+		outside &= all;
+		behind |= nearMask;
+	}
+	if ( outside ) return OCCLUSION_OUTSIDE;
+
+	// a box reaching through the near plane cannot be bounded on screen
+	if ( behind ) return OCCLUSION_VISIBLE;
+
+	// screen bounds and the nearest 1/w
+	__m128 invW0 = _mm_div_ps ( _mm_set1_ps ( 1.0f ), clipW[0] );
+	__m128 invW1 = _mm_div_ps ( _mm_set1_ps ( 1.0f ), clipW[1] );
+	__m128 ndcX0 = _mm_mul_ps ( clipX[0], invW0 ), ndcX1 = _mm_mul_ps ( clipX[1], invW1 );
+	__m128 ndcY0 = _mm_mul_ps ( clipY[0], invW0 ), ndcY1 = _mm_mul_ps ( clipY[1], invW1 );
+	__m128 loX = _mm_min_ps ( ndcX0, ndcX1 ), hiX = _mm_max_ps ( ndcX0, ndcX1 );
+	__m128 loY = _mm_min_ps ( ndcY0, ndcY1 ), hiY = _mm_max_ps ( ndcY0, ndcY1 );
+	__m128 nearest = _mm_max_ps ( invW0, invW1 );
+	float lanes[5][4];
+	_mm_storeu_ps ( lanes[0], loX );
+	_mm_storeu_ps ( lanes[1], hiX );
+	_mm_storeu_ps ( lanes[2], loY );
+	_mm_storeu_ps ( lanes[3], hiY );
+	_mm_storeu_ps ( lanes[4], nearest );
+	float minNdcX = lanes[0][0], maxNdcX = lanes[1][0], minNdcY = lanes[2][0], maxNdcY = lanes[3][0], boxDepth = lanes[4][0];
+	for ( int i = 1; i < 4; i++ )
+	{
+		if ( lanes[0][i] < minNdcX ) minNdcX = lanes[0][i];
+		if ( lanes[1][i] > maxNdcX ) maxNdcX = lanes[1][i];
+		if ( lanes[2][i] < minNdcY ) minNdcY = lanes[2][i];
+		if ( lanes[3][i] > maxNdcY ) maxNdcY = lanes[3][i];
+		if ( lanes[4][i] > boxDepth ) boxDepth = lanes[4][i];
+	}
+
+	// every pixel the box touches, rounded outwards
+	float fx0 = (minNdcX + 1.0f) * width * 0.5f;
+	float fx1 = (maxNdcX + 1.0f) * width * 0.5f;
+	float fy0 = (1.0f - maxNdcY) * height * 0.5f;
+	float fy1 = (1.0f - minNdcY) * height * 0.5f;
+	if ( fx1 < 0.0f || fy1 < 0.0f || fx0 >= (float)width || fy0 >= (float)height ) return OCCLUSION_OUTSIDE;
+	int x0 = fx0 > 0.0f ? (int)fx0 : 0;
+	int y0 = fy0 > 0.0f ? (int)fy0 : 0;
+	int x1 = fx1 < (float)(width - 1) ? (int)fx1 : width - 1;
+	int y1 = fy1 < (float)(height - 1) ? (int)fy1 : height - 1;
+
+	// blocks wholly behind the drawn depth need no more, a block wholly within
+	// the box with a pixel further away shows the box, the rest read pixels
+	const __m128 boxDepth4 = _mm_set1_ps ( boxDepth );
+	const __m128i laneIndex = _mm_setr_epi32 ( 0, 1, 2, 3 );
+	for ( int by = y0 / OCCLUSION_BLOCK_SIZE; by <= y1 / OCCLUSION_BLOCK_SIZE; by++ )
+	{
+		int blockY0 = by * OCCLUSION_BLOCK_SIZE;
+		int blockY1 = blockY0 + OCCLUSION_BLOCK_SIZE - 1;
+		if ( blockY1 > height - 1 ) blockY1 = height - 1;
+		int rowY0 = blockY0 > y0 ? blockY0 : y0;
+		int rowY1 = blockY1 < y1 ? blockY1 : y1;
+		for ( int bx = x0 / OCCLUSION_BLOCK_SIZE; bx <= x1 / OCCLUSION_BLOCK_SIZE; bx++ )
+		{
+			int block = by * blocksX + bx;
+			if ( boxDepth <= blockMin[block] ) continue;
+
+			int blockX0 = bx * OCCLUSION_BLOCK_SIZE;
+			int blockX1 = blockX0 + OCCLUSION_BLOCK_SIZE - 1;
+			if ( blockX1 > width - 1 ) blockX1 = width - 1;
+			if ( blockX0 >= x0 && blockX1 <= x1 && blockY0 >= y0 && blockY1 <= y1 ) return OCCLUSION_VISIBLE;
+
+			int colX0 = blockX0 > x0 ? blockX0 : x0;
+			int colX1 = blockX1 < x1 ? blockX1 : x1;
+			int firstX = colX0 & ~3;
+			for ( int y = rowY0; y <= rowY1; y++ )
+			{
+				const float* pDepth = &depth [ y * bufferWidth ];
+				for ( int x = firstX; x <= colX1; x += 4 )
+				{
+					__m128i pixel = _mm_add_epi32 ( _mm_set1_epi32 ( x ), laneIndex );
+					__m128i wanted = _mm_andnot_si128 ( _mm_cmplt_epi32 ( pixel, _mm_set1_epi32 ( colX0 ) ), _mm_cmplt_epi32 ( pixel, _mm_set1_epi32 ( colX1 + 1 ) ) );
+					__m128 further = _mm_cmplt_ps ( _mm_loadu_ps ( pDepth + x ), boxDepth4 );
+					if ( _mm_movemask_ps ( _mm_and_ps ( further, _mm_castsi128_ps ( wanted ) ) ) ) return OCCLUSION_VISIBLE;
+				}
+			}
+		}
+	}
+	return OCCLUSION_HIDDEN;
+}
+
+void cOcclusionRasterizer::testBoxes(const float* boxes, int count, unsigned char* results, cThreadPool* pool)
+{
+	auto test = [this, boxes, results] ( int i ) { results[i] = (unsigned char)testBox ( boxes + i * 6 ); };
+	if ( pool )
+		pool->parallel_for ( 0, count, 64, test );
+	else
+		for ( int i = 0; i < count; i++ ) test ( i );
+
+	stats[OCCLUSION_STAT_BOXES] = count > 0 ? count : 0;
+	stats[OCCLUSION_STAT_HIDDEN] = 0;
+	stats[OCCLUSION_STAT_OUTSIDE] = 0;
+	for ( int i = 0; i < count; i++ )
+	{
+		if ( results[i] == OCCLUSION_HIDDEN ) stats[OCCLUSION_STAT_HIDDEN]++;
+		if ( results[i] == OCCLUSION_OUTSIDE ) stats[OCCLUSION_STAT_OUTSIDE]++;
+	}
+}
+
+unsigned int cOcclusionRasterizer::getStat(int stat) const
+{
+	if ( stat < 0 || stat >= OCCLUSION_STAT_COUNT ) return 0;
+	return stats[stat];
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+
+class cThreadPool;
+
+// the screen is split into tiles that are binned and rasterized independently
+#define OCCLUSION_TILE_WIDTH		64
+#define OCCLUSION_TILE_HEIGHT		32
+
+// min and max depth are kept per block of this many pixels square
+#define OCCLUSION_BLOCK_SIZE		8
+
+// triangles clipped and binned by one job
+#define OCCLUSION_SETUP_GRAIN		1024
+
+// how far outside the view triangles may reach before they are clipped, in view widths
+#define OCCLUSION_GUARD_BAND		2.0f
+
+// testBox results
+#define OCCLUSION_OUTSIDE			0		// box is outside the view
+#define OCCLUSION_HIDDEN			1		// box is behind what was rasterized
+#define OCCLUSION_VISIBLE			2
+
+// getStat values
+#define OCCLUSION_STAT_TRIANGLES	0		// added since begin
+#define OCCLUSION_STAT_DRAWN		1		// left after culling and clipping
+#define OCCLUSION_STAT_BOXES		2		// tested by the last testBoxes
+#define OCCLUSION_STAT_HIDDEN		3
+#define OCCLUSION_STAT_OUTSIDE		4
+#define OCCLUSION_STAT_COUNT		5
+
+// depth only software rasterizer for occlusion culling. Occluder triangles are
+// set up and binned to screen tiles by several jobs, then each tile is
+// rasterized four pixels at a time by a single job so no locking is needed.
+// Depth is stored as 1/w, zero where nothing was drawn, with the nearest value
+// kept. Once rendered the min and max of every block of pixels lets most box
+// tests finish without reading the pixels, and since the buffer is then only
+// read any number of boxes can be tested at once
+class cOcclusionRasterizer
+{
+public:
+	cOcclusionRasterizer();
+	~cOcclusionRasterizer();
+
+	void setResolution(int width, int height);
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+	// starts a frame with the world to clip matrix (row vectors, view times
+	// projection) and the near plane distance, forgets the previous triangles
+	void begin(const float viewProjection[16], float nearClip);
+	// front faces wind clockwise on screen, as with the default D3D cull mode
+	void setBackfaceCulling(bool cull) { backfaceCulling = cull; }
+
+	// world space triangles, nine floats each, copied so the caller can reuse its memory
+	void addTriangles(const float* vertices, int count);
+	void addTriangle(const float* a, const float* b, const float* c);
+	int getTriangleCount() const { return (int)(vertices.size() / 9); }
+
+	// true when the sphere is wholly outside the view
+	bool isSphereOutside(const float centre[3], float radius) const;
+
+	// clips, bins and rasterizes everything added since begin and builds the
+	// min and max blocks, spread over the pool when one is given
+	void render(cThreadPool* pool);
+
+	// world space boxes as min xyz then max xyz, six floats each, giving an
+	// OCCLUSION_ result. testBox only reads so may be called from any thread
+	int testBox(const float* box) const;
+	void testBoxes(const float* boxes, int count, unsigned char* results, cThreadPool* pool);
+
+	const float* getDepth() const { return depth.empty() ? 0 : &depth[0]; }
+	int getDepthPitch() const { return bufferWidth; }
+	unsigned int getStat(int stat) const;
+
+private:
+	struct Triangle
+	{
+		float edgeA[3];         // edge functions, all three positive inside
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;           // 1/w as a plane across the screen
+		float depthB;
+		float depthC;
+		int minX;               // pixel bounds, inclusive
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	struct Job
+	{
+		std::vector<Triangle> triangles;
+		std::vector< std::vector<int> > bins;   // triangle numbers per tile
+	};
+
+	void setupTriangles(int job);
+	void setupTriangle(const float* clip, Job& job);
+	void rasterizeTile(int tile);
+	void rasterizeTriangle(const Triangle& tri, int x0, int y0, int x1, int y1);
+	void buildBlocks(int tile);
+
+	int width;
+	int height;
+	int bufferWidth;            // rounded up to whole tiles
+	int bufferHeight;
+	int tilesX;
+	int tilesY;
+	int blocksX;
+	int blocksY;
+
+	float matrix[16];
+	float nearClip;
+	float planes[5][4];         // left, right, bottom, top, near
+	bool backfaceCulling;
+
+	std::vector<float> vertices;
+	std::vector<Job> jobs;
+	int jobCount;
+
+	std::vector<float> depth;
+	std::vector<float> blockMin;
+	std::vector<float> blockMax;
+
+	unsigned int stats[OCCLUSION_STAT_COUNT];
+};
@@ -16,6 +16,8 @@
 
 #include "CBasic2DC.h"
 #include "CObjectsC.h"
+#include "OcclusionRasterizer.h"
+#include ".\..\..\..\Include\cThreadPool.h"
 
 extern "C" FILE* GG_fopen( const char* filename, const char* mode );
 
@@ -50,6 +52,28 @@ bool	g_occluderf9Mode = false;
 bool    g_enabeleverything = false;
 int cpu3dMaxPolys = CPU_3D_MAX_POLY_SETTING;
 
+// occlusion rasterizer, used in place of the render list unless CPU3DSetRasterizer(0)
+cOcclusionRasterizer g_OcclusionRasterizer;
+int g_iOcclusionRasterizerMode = 1;
+
+// the occluder runs on its own thread alongside the main loop, so it gets its own
+// workers rather than waiting on (and stealing from) the main thread pool
+static cThreadPool* g_pOcclusionThreadPool = NULL;
+static cThreadPool* OcclusionThreadPool ( void )
+{
+	if ( g_pOcclusionThreadPool == NULL )
+	{
+		unsigned int iThreads = std::thread::hardware_concurrency() / 2;
+		if ( iThreads < 1 ) iThreads = 1;
+		if ( iThreads > 4 ) iThreads = 4;
+		g_pOcclusionThreadPool = new cThreadPool ( iThreads );
+	}
+	return g_pOcclusionThreadPool;
+}
+
+#define OCCLUSION_RASTER_WIDTH 512
+#define OCCLUDEE_HIDE_COUNTDOWN 4
+
 #define MAX_CACHED_OBJECTS 130000
 #define USE_SCREEN_SPACE_OCCLUDER
 #define SHOW_LESS_OCCLUDEES_ON_HIGH_PRIM_CALLS
@@ -691,30 +715,10 @@ int lightmappedobjectoffset = MAXINT32;
 bool forceIsVisCheck;
 float fLargeRadiusValue;
 
-DB void OccludeeCheck( int id , bool isCharacter )                                    
+// distance, size and view tests shared by OccludeeCheck and OccludeeCheckBatch,
+// returns true when these alone decided the visibility of the object
+bool OccludeePreCheck ( sObject* p, bool isCharacter, float& original_radius, float& dist )
 {
-	#ifdef _TIME_TAKEN_
-	ResetTimer();
-	#endif
-
-	forceIsVisCheck = false;
-
-	pRendlist = &rend_list;
-	GGVECTOR3 vecPosition;
-
-	// clear renderlist so we can use it for occludees
-	pRendlist->num_polys = 0;
-
-	sObject* p = GetObjectData ( id );
-	sObject* p2;
-
-	if (!p ) return;
-
-	if ( p->pInstanceOfObject )
-		p2 = p->pInstanceOfObject;
-	else
-		p2 = p;
-
 	VECTOR4D world_pos;
 	world_pos.x = p->position.vecPosition.x + p->collision.vecCentre.x;
 	world_pos.y = p->position.vecPosition.y + p->collision.vecCentre.y;
@@ -722,7 +726,6 @@ DB void OccludeeCheck( int id , bool isCharacter )
 	world_pos.w = 1.0f;
 
 	float max_radius;
-	float original_radius;
 	max_radius = p->collision.fScaledLargestRadius * 1.25f;
 	if ( p->collision.fLargestRadius > max_radius )
 		max_radius = p->collision.fLargestRadius * 1.25f;
@@ -734,7 +737,7 @@ DB void OccludeeCheck( int id , bool isCharacter )
 	{
 		p->dwCountdownToUniverseVisOff = 0;
 		p->bUniverseVisible = true;	
-		return;
+		return true;
 	}
 
 	original_radius = max_radius;
@@ -745,13 +748,13 @@ DB void OccludeeCheck( int id , bool isCharacter )
 	else
 		max_radius *= 2;
 	
-	float dist = sqrt( ((world_pos.x - cam.pos.x)*(world_pos.x - cam.pos.x)) + ((world_pos.y - cam.pos.y)*(world_pos.y - cam.pos.y)) +((world_pos.z - cam.pos.z)*(world_pos.z - cam.pos.z)) );
+	dist = sqrt( ((world_pos.x - cam.pos.x)*(world_pos.x - cam.pos.x)) + ((world_pos.y - cam.pos.y)*(world_pos.y - cam.pos.y)) +((world_pos.z - cam.pos.z)*(world_pos.z - cam.pos.z)) );
 
 	// For stuff that is miles away
 	if ( dist > occludeeMaxDistance && AggresiveMode > 0.1f )
 	{
 		p->bUniverseVisible = false;	
-		return;
+		return true;
 	}
 
 #ifdef HIDE_SMALL_OBJECTS
@@ -761,22 +764,22 @@ DB void OccludeeCheck( int id , bool isCharacter )
 		if ( max_radius < 5.0f && dist > (3000.0f * hideSmallObjectsMultiplier) )
 		{
 			p->bUniverseVisible = false;	
-			return;
+			return true;
 		}
 		if ( max_radius < 100.0f && dist > (5000.0f * hideSmallObjectsMultiplier) )
 		{
 			p->bUniverseVisible = false;	
-			return;
+			return true;
 		}
 		if ( max_radius < 5.0f && dist > (2800.0f * hideSmallObjectsMultiplier) && p->bUniverseVisible == false )
 		{
 			p->bUniverseVisible = false;	
-			return;
+			return true;
 		}
 		if ( max_radius < 100.0f && dist > (4800.0f * hideSmallObjectsMultiplier) && p->bUniverseVisible == false )
 		{
 			p->bUniverseVisible = false;	
-			return;
+			return true;
 		}
 	}
 	#endif
@@ -788,7 +791,7 @@ DB void OccludeeCheck( int id , bool isCharacter )
 	{
 		p->dwCountdownToUniverseVisOff = 0;
 		p->bUniverseVisible = true;	
-		return;
+		return true;
 	}
 
 	// step 1: transform the center of the object's bounding
@@ -805,7 +808,7 @@ DB void OccludeeCheck( int id , bool isCharacter )
 		if ( ((sphere_pos.z - max_radius) > cam.far_clip_z) || ((sphere_pos.z + max_radius) < cam.near_clip_z) )
 		{
 			p->bUniverseVisible = false;
-			return;
+			return true;
 		}
 
 		// cull only based on x clipping planes
@@ -815,7 +818,7 @@ DB void OccludeeCheck( int id , bool isCharacter )
 		if ( ((sphere_pos.x-max_radius) > z_test)  || ((sphere_pos.x+max_radius) < -z_test) )  
 		{
 			p->bUniverseVisible = false;
-			return;
+			return true;
 		}
 
 		// cull only based on y clipping planes
@@ -825,9 +828,40 @@ DB void OccludeeCheck( int id , bool isCharacter )
 		if ( ((sphere_pos.y-max_radius) > z_test)  || ((sphere_pos.y+max_radius) < -z_test) )
 		{
 			p->bUniverseVisible = false;
-			return;
+			return true;
 		}
 	}
+	return false;
+}
+
+DB void OccludeeCheck( int id , bool isCharacter )                                    
+{
+	#ifdef _TIME_TAKEN_
+	ResetTimer();
+	#endif
+
+	forceIsVisCheck = false;
+
+	pRendlist = &rend_list;
+	GGVECTOR3 vecPosition;
+
+	// clear renderlist so we can use it for occludees
+	pRendlist->num_polys = 0;
+
+	sObject* p = GetObjectData ( id );
+	sObject* p2;
+
+	if (!p ) return;
+
+	if ( p->pInstanceOfObject )
+		p2 = p->pInstanceOfObject;
+	else
+		p2 = p;
+
+	float original_radius;
+	float dist;
+	if ( OccludeePreCheck ( p, isCharacter, original_radius, dist ) )
+		return;
 
 	float fWidth1  = p2->collision.vecMin.x * p->position.vecScale.x;
 	float fHeight1 = p2->collision.vecMin.y * p->position.vecScale.y;
@@ -1418,6 +1452,127 @@ UpdateTimer();
 
 }
 
+// the sorted occluders into the occlusion rasterizer, sharing the polygon cache
+// and poly budget of DrawOccluder
+void CPU3DRasterizeOccluders ( void )
+{
+	tagCameraData* camData = (tagCameraData*)GetCameraInternalData ( CameraIndex );
+	if ( camData==NULL ) return;
+
+	// same camera and shift as begin() gave the render list
+	GGMATRIX matShift, matViewProj;
+	GGMatrixTranslation ( &matShift, -gCPUOccluderCamShiftX, 0.0f, -gCPUOccluderCamShiftZ );
+	matViewProj = matShift * camData->matView * camData->matProjection;
+	float fViewProj[16] = { matViewProj._11, matViewProj._12, matViewProj._13, matViewProj._14,
+							matViewProj._21, matViewProj._22, matViewProj._23, matViewProj._24,
+							matViewProj._31, matViewProj._32, matViewProj._33, matViewProj._34,
+							matViewProj._41, matViewProj._42, matViewProj._43, matViewProj._44 };
+	g_OcclusionRasterizer.setResolution ( OCCLUSION_RASTER_WIDTH, (int)(OCCLUSION_RASTER_WIDTH / cam.aspect_ratio) );
+	g_OcclusionRasterizer.begin ( fViewProj, cam.near_clip_z );
+
+	for ( unsigned int c = 0; c < OccluderListClosest.size(); c++ )
+	{
+		int id = OccluderListClosest[c];
+		int cachedID = id-70000;
+		if ( cachedID >= MAX_CACHED_OBJECTS || id < 70000 ) continue;
+
+		// first sight of an occluder only fills its cache
+		if ( cachedPolys[cachedID]==NULL )
+		{
+			DrawOccluder ( id );
+			continue;
+		}
+
+		tPolyList* pList = cachedPolys[cachedID];
+		if ( pList->max_radius==-999999 || pList->polys.size()==0 ) continue;
+		float fCentre[3] = { pList->world_pos.x, pList->world_pos.y, pList->world_pos.z };
+		if ( g_OcclusionRasterizer.isSphereOutside ( fCentre, pList->max_radius ) ) continue;
+
+		// the whole object or nothing, as with the render list
+		if ( g_OcclusionRasterizer.getTriangleCount() + (int)pList->polys.size() > cpu3dMaxPolys ) continue;
+		for ( unsigned int j = 0; j < pList->polys.size(); j++ )
+		{
+			float fA[3] = { pList->polys[j].vertexList[0].x, pList->polys[j].vertexList[0].y, pList->polys[j].vertexList[0].z };
+			float fB[3] = { pList->polys[j].vertexList[1].x, pList->polys[j].vertexList[1].y, pList->polys[j].vertexList[1].z };
+			float fC[3] = { pList->polys[j].vertexList[2].x, pList->polys[j].vertexList[2].y, pList->polys[j].vertexList[2].z };
+			g_OcclusionRasterizer.addTriangle ( fA, fB, fC );
+		}
+		OccluderListDrawn.push_back ( id );
+		howManyOccludersDrawn++;
+	}
+
+	g_OcclusionRasterizer.render ( OcclusionThreadPool() );
+}
+
+// tests many occludees at once against the occlusion rasterizer, the distance
+// and view checks of OccludeeCheck run first and the rest are tested as world
+// space boxes spread over the thread pool. With bDelayHide hidden objects are
+// given the countdown CPU3DDoOcclude runs down for the occludee list
+void OccludeeCheckBatch ( const std::vector<int>& ids, const std::vector<bool>& isCharacter, bool bDelayHide )
+{
+	static std::vector<sObject*> objects;
+	static std::vector<float> boxes;
+	static std::vector<unsigned char> results;
+	objects.clear();
+	boxes.clear();
+
+	for ( unsigned int i = 0; i < ids.size(); i++ )
+	{
+		sObject* p = GetObjectData ( ids[i] );
+		if ( !p ) continue;
+
+		float original_radius;
+		float dist;
+		if ( OccludeePreCheck ( p, i < isCharacter.size() ? isCharacter[i] : false, original_radius, dist ) )
+			continue;
+
+		// the same box OccludeeCheck builds, bounded in world space
+		sObject* p2 = p->pInstanceOfObject ? p->pInstanceOfObject : p;
+		GGVECTOR3 vecMin = GGVECTOR3 ( p2->collision.vecMin.x * p->position.vecScale.x, p2->collision.vecMin.y * p->position.vecScale.y, p2->collision.vecMin.z * p->position.vecScale.z );
+		GGVECTOR3 vecMax = GGVECTOR3 ( p2->collision.vecMax.x * p->position.vecScale.x, p2->collision.vecMax.y * p->position.vecScale.y, p2->collision.vecMax.z * p->position.vecScale.z );
+		float fBox[6] = { 1e30f, 1e30f, 1e30f, -1e30f, -1e30f, -1e30f };
+		for ( int corner = 0; corner < 8; corner++ )
+		{
+			GGVECTOR3 vecPosition = GGVECTOR3 ( (corner&1) ? vecMax.x : vecMin.x, (corner&2) ? vecMax.y : vecMin.y, (corner&4) ? vecMax.z : vecMin.z );
+			GGVec3TransformCoord ( &vecPosition, &vecPosition, &p->position.matWorld );
+			if ( vecPosition.x < fBox[0] ) fBox[0] = vecPosition.x;
+			if ( vecPosition.y < fBox[1] ) fBox[1] = vecPosition.y;
+			if ( vecPosition.z < fBox[2] ) fBox[2] = vecPosition.z;
+			if ( vecPosition.x > fBox[3] ) fBox[3] = vecPosition.x;
+			if ( vecPosition.y > fBox[4] ) fBox[4] = vecPosition.y;
+			if ( vecPosition.z > fBox[5] ) fBox[5] = vecPosition.z;
+		}
+		objects.push_back ( p );
+		boxes.insert ( boxes.end(), fBox, fBox + 6 );
+	}
+
+	results.resize ( objects.size() );
+	if ( objects.size() > 0 )
+		g_OcclusionRasterizer.testBoxes ( &boxes[0], (int)objects.size(), &results[0], OcclusionThreadPool() );
+
+	for ( unsigned int i = 0; i < objects.size(); i++ )
+	{
+		sObject* p = objects[i];
+		if ( results[i] == OCCLUSION_VISIBLE )
+		{
+			p->dwCountdownToUniverseVisOff = 0;
+			p->bUniverseVisible = true;
+		}
+		else if ( results[i] == OCCLUSION_OUTSIDE )
+		{
+			p->bUniverseVisible = false;
+		}
+		else
+		{
+			howManyOccludeesHidden++;
+			if ( !bDelayHide )
+				p->bUniverseVisible = false;
+			else if ( p->bUniverseVisible && p->dwCountdownToUniverseVisOff == 0 )
+				p->dwCountdownToUniverseVisOff = OCCLUDEE_HIDE_COUNTDOWN;
+		}
+	}
+}
+
 void CPU3DAddOccluder ( int id )
 {
 	OccluderList.push_back ( id );
@@ -1496,6 +1651,11 @@ void CPU3DShow( int show )
 	ShowZbuffer = show;
 }
 
+void CPU3DSetRasterizer( int mode )
+{
+	g_iOcclusionRasterizerMode = mode;
+}
+
 bool doneOcclude = false;
 
 void Sync ( void );
@@ -1856,27 +2016,36 @@ void CPU3DDoOcclude()
 
 	}
 
-	int objectID;
-	if (g_pOccluderBVH->traverse(cam.pos, cam.dir, objectID))
+	if ( g_iOcclusionRasterizerMode )
+	{
+		// every sorted occluder rasterized, then the occludees tested in one batch
+		CPU3DRasterizeOccluders();
+		OccludeeCheckBatch ( OccludeeList, OccludeeListIsCharacter, true );
+	}
+	else
 	{
-		if (DrawOccluder(objectID))
+		int objectID;
+		if (g_pOccluderBVH->traverse(cam.pos, cam.dir, objectID))
 		{
-			OccluderListDrawn.push_back(objectID);
-			howManyOccludersDrawn++;
+			if (DrawOccluder(objectID))
+			{
+				OccluderListDrawn.push_back(objectID);
+				howManyOccludersDrawn++;
+			}
 		}
-	}
 
-	Draw();	
+		Draw();	
 
-	bool found = false;
+		bool found = false;
 
-	int objectID;
-	if (g_pOccludeeBVH->traverse(cam.pos, cam.dir, objectID))
-	{
-		sObject* p = GetObjectData(objectID);
-		if (p)
+		int objectID;
+		if (g_pOccludeeBVH->traverse(cam.pos, cam.dir, objectID))
 		{
-			p->bUniverseVisible = true;
+			sObject* p = GetObjectData(objectID);
+			if (p)
+			{
+				p->bUniverseVisible = true;
+			}
 		}
 	}
 
@@ -1898,11 +2067,25 @@ void CPU3DDoOcclude()
 	}
 
 	// Veg Check too
-	for ( int c = iGridObjectStart; c < iGridObjectEnd ; c++ )
+	if ( g_iOcclusionRasterizerMode )
 	{
-		if ( c > 0 )
+		static std::vector<int> vegList;
+		static std::vector<bool> vegIsCharacter;
+		vegList.clear();
+		for ( int c = iGridObjectStart; c < iGridObjectEnd ; c++ )
 		{
-			if ( ObjectExist ( c ) == 1 ) OccludeeCheck ( c , false );
+			if ( c > 0 && ObjectExist ( c ) == 1 ) vegList.push_back ( c );
+		}
+		OccludeeCheckBatch ( vegList, vegIsCharacter, false );
+	}
+	else
+	{
+		for ( int c = iGridObjectStart; c < iGridObjectEnd ; c++ )
+		{
+			if ( c > 0 )
+			{
+				if ( ObjectExist ( c ) == 1 ) OccludeeCheck ( c , false );
+			}
 		}
 	}
 
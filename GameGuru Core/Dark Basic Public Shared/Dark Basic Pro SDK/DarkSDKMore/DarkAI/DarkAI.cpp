@@ -1044,6 +1044,13 @@ void AIMakePathBetweenPoints ( int iPathID, float x, float z, float x2, float z2
 	AIMakePathBetweenPoints ( iPathID, 0, x, z, x2, z2, -1, 0 );
 }
 
+int AIMakePathsBetweenPoints ( int iCount, int* pPathIDs, int* pContainerIDs, float* pPoints, int* pDestContainers, float fMaxEdgeCost )
+{
+	if ( CheckAIInit ( )==0 ) return 0;
+
+	return cWorld.AddObstaclePaths ( iCount, pPathIDs, pContainerIDs, pPoints, pDestContainers, fMaxEdgeCost );
+}
+
 void AIMakePathFromClosestWaypoints ( int iPathID, int iContainerID, float x, float z )
 {
 	if ( CheckAIInit ( )==0 ) return;
@@ -2863,23 +2863,6 @@ void Entity::StrafeAvoid ( )
 
 void Entity::CalculateAvoidPosition ( float fDist )
 {
-	/*
-	if ( cMovePath.CountPoints ( ) > 2 )
-	{
-		int iIndex = pContainer->pPathFinder->GetClosestWaypoint ( cMovePath.GetPoint ( 1 ).x, cMovePath.GetPoint ( 1 ).y );
-		pContainer->pPathFinder->DeActivateWaypoint ( iIndex );
-
-		pContainer->pPathFinder->CalculatePath ( GetX ( ), GetZ ( ), vecFinalDest.x, vecFinalDest.z, &cMovePath );
-		
-		if ( cMovePath.CountPoints ( ) >= 2 )
-		{
-			vecAvoidPos.x = cMovePath.GetPoint ( 1 ).x;
-			vecAvoidPos.z = cMovePath.GetPoint ( 1 ).y;
-			vecAvoidPos.y = GetY ( );
-			return;
-		}
-	}*/
-	
 	if ( pWorld->RandInt( 4 ) == 0 )
 	{
 		if ( rand( ) % 2 == 0 ) bAvoidLeft = true;
@@ -3663,29 +3646,24 @@ void Entity::UpdateMovement ( float fTimeDelta )
 	///if ( fMoveFeedbackTimer <= 0.0f ) UpdateFeedbackPos ( );
 
 	// calculate path as often as fPathTimer allows (intensive calc)
+	// every AI waiting in the list joins the next batch, the batches are spaced by CurrentAIWorkedPathTimer
 	bool bUpdateMovement = false;
-	if ( g_LeeThread.GetWorkInProgress() == -1 )
+	int ListOfEntitiesToUpdateMovementIndex = -1;
+	if ( g_LeeThread.IsCollecting() && CurrentAIWorkedPathTimer <= 0.0f && g_LeeThread.GetWorkInProgress( this->iID ) == false )
 	{
-		if ( ListOfEntitiesToUpdateMovement.size() > 0 )
+		for ( int lindex = 0; lindex < (int)ListOfEntitiesToUpdateMovement.size(); lindex++ )
 		{
-			// go through all entities and work out who gets to update their path this cycle (only one per cycle in turn)
-			//if ( ListOfEntitiesToUpdateMovementIndex > (int)ListOfEntitiesToUpdateMovement.size()-1 ) ListOfEntitiesToUpdateMovementIndex = 0;
-			//if ( ListOfEntitiesToUpdateMovementIndex <= (int)ListOfEntitiesToUpdateMovement.size()-1 )
-			int ListOfEntitiesToUpdateMovementIndex = 0; // always take first (oldest) one first (erase when done with it)
+			if ( ListOfEntitiesToUpdateMovement[lindex] == this->iID )
 			{
-				if ( ListOfEntitiesToUpdateMovement[ListOfEntitiesToUpdateMovementIndex] == this->iID )
-				{
-					if (((bRedoPath ) && !bChangingContainers && iAggressiveness != 2 && !bIsLeaping && !bIsDiving) ) 
-					{
-						// only allow if spacing time has elapsed
-						CurrentAIWorkedPathTimer -= fTimeDelta;
-						if ( CurrentAIWorkedPathTimer <= 0.0f )
-						{
-							CurrentAIWorkedPathTimer = 0.1f; // X second until next inc.
-							bUpdateMovement = true;
-						}
-					}
-				}
+				ListOfEntitiesToUpdateMovementIndex = lindex;
+				break;
+			}
+		}
+		if ( ListOfEntitiesToUpdateMovementIndex != -1 )
+		{
+			if (((bRedoPath ) && !bChangingContainers && iAggressiveness != 2 && !bIsLeaping && !bIsDiving) ) 
+			{
+				bUpdateMovement = true;
 			}
 		}
 	}
@@ -3714,127 +3692,23 @@ void Entity::UpdateMovement ( float fTimeDelta )
 		// remove any old paths (about to create a new one)
 		cMovePath.DebugHide ( );
 		DebugHideDestination ( );
-		ListOfEntitiesToUpdateMovement.erase (ListOfEntitiesToUpdateMovement.begin()+0);
+		ListOfEntitiesToUpdateMovement.erase (ListOfEntitiesToUpdateMovement.begin()+ListOfEntitiesToUpdateMovementIndex);
 		bRedoPath = false;
 
-		// thread task issue
+		// thread task issue, solved with the rest of the batch
 		g_LeeThread.BeginWork( this->iID, GetX(), GetZ(), vecFinalDest.x, vecFinalDest.y, vecFinalDest.z, pContainer, iDestContainer );
 	}
-	if ( g_LeeThread.GetWorkInProgress() == this->iID )
+	if ( g_LeeThread.GetWorkInProgress( this->iID ) == true )
 	{
-		if ( g_LeeThread.GetWorkComplete() == 1 )
+		if ( g_LeeThread.GetWorkComplete( this->iID ) == true )
 		{
 			// ready for new path and set timers for next think-time
 			fForceUpdatePathTimer = 0.0f;
 			fPathTimer = 0.75f;
 
 			// get new path from path calculation done in thread
-			Path cNewPath = g_LeeThread.GetNewPath();
-			g_LeeThread.GetNewFinalDest ( &vecFinalDest.x, &vecFinalDest.y, &vecFinalDest.z );
-			g_LeeThread.EndWork();
-
-			/*
-			// prepare level obstacles for new path calculation
 			Path cNewPath;
-			pContainer->pPathFinder->ActivateAllWaypoints ( );
-			pContainer->pPathFinder->CalculatePath ( GetX( ), GetZ( ), vecFinalDest.x, vecFinalDest.z, &cNewPath, fPathStartCostLimit, iDestContainer );
-
-			// if no path to finaldest, work from finaldest back to known reachable point
-			if ( cNewPath.CountPoints() == 0 )
-			{
-				// okay, so final dest not pathable, and no direct line to barrier
-				// so find closest node from container, and set that as finaldest
-				int iThisContainer = GetContainer()->GetID(); 
-				iDestContainer = iThisContainer; // container ID can be changed below
-				float fBestDistance = 999999.0f;
-				float fBestX = 0.0f;
-				float fBestZ = 0.0f;
-				float fDX = GetX( ) - vecFinalDest.x;
-				float fDZ = GetZ( ) - vecFinalDest.z;
-				float fDD = sqrt ( fabs(fDX*fDX) + fabs(fDZ*fDZ) );
-				float fDDInc = fDD / 30.0f;
-				int iDistCount = (int)fDDInc;
-				for ( int iDist = 1; iDist <= 30; iDist++ )
-				{
-					for ( int iAng = 0; iAng < 360; iAng+=45 )
-					{
-						// this is where I want the AI to try to get to
-						float fTryX = vecFinalDest.x + (sin(iAng*DEGTORAD)*(iDist*fDDInc));
-						float fTryZ = vecFinalDest.z + (cos(iAng*DEGTORAD)*(iDist*fDDInc));
-						int waypointmax = waypoint_getmax();
-						for ( int waypointindex = 1; waypointindex <= waypointmax; waypointindex++ )
-						{
-							int tokay = waypoint_ispointinzoneex ( waypointindex, fTryX, vecFinalDest.y, fTryZ, 1 );
-							if ( tokay == 1 ) 
-							{
-								iDestContainer = waypointindex;
-								fBestDistance = 0;
-								fBestX = fTryX;
-								fBestZ = fTryZ;
-								iDist = 31;
-								iAng = 361;
-								break;
-							}
-						}
-					}
-				}
-				if ( fBestDistance != 999999.0f )
-				{
-					// best is within waypoint zone, but outside AI obstacle zone (margin added to AI waypoint system)
-					// so project away from player to ensure we get inside
-					float fDX = fBestX - vecFinalDest.x;
-					float fDZ = fBestZ - vecFinalDest.z;
-					float fDD = sqrt ( fabs(fDX*fDX)+fabs(fDZ*fDZ) );
-					fDX = (fDX/fDD)*(fDD+30.0f);
-					fDZ = (fDZ/fDD)*(fDD+30.0f);
-					fBestX = vecFinalDest.x + fDX;
-					fBestZ = vecFinalDest.z + fDZ;
-
-					// now assign final pos
-					if ( iDestContainer != iThisContainer )
-					{
-						// found closer position in another container, so just go there
-						vecFinalDest.x = fBestX;
-						vecFinalDest.z = fBestZ;
-					}
-					else
-					{
-						// same container, so dont get too close to edge when move nearer target
-						float fPushX = fBestX - vecFinalDest.x;
-						float fPushZ = fBestZ - vecFinalDest.z;
-						float fPushDD = sqrt ( fabs(fPushX*fPushX) + fabs(fPushZ*fPushZ) );
-						fPushX /= fPushDD;
-						fPushZ /= fPushDD;
-						vecFinalDest.x = fBestX + (fPushX*2.0f);
-						vecFinalDest.z = fBestZ + (fPushZ*2.0f);
-					}
-				}
-				else
-				{
-					if ( GetContainer()->GetID() == 0 )
-					{
-						float fResult = pContainer->pPathFinder->FindClosestPolygon ( GetX( ), GetZ( ), vecFinalDest.x, vecFinalDest.z );
-						if ( fResult >= 0.1f ) 
-						{
-							iDestContainer = GetContainer()->GetID(); 
-							vecFinalDest.x = GetX( ) + ( vecFinalDest.x - GetX( ) )*fResult;
-							vecFinalDest.z = GetZ( ) + ( vecFinalDest.z - GetZ( ) )*fResult;
-						}
-					}
-				}
-
-				// chart new path to this permimeter position
-				cNewPath.Clear ( );
-				pContainer->pPathFinder->ActivateAllWaypoints ( );
-				pContainer->pPathFinder->CalculatePath ( GetX( ), GetZ( ), vecFinalDest.x, vecFinalDest.z, &cNewPath, fPathStartCostLimit, iDestContainer );
-				if ( cNewPath.CountPoints( ) == 2 )
-				{
-					// if path has zero length, reduce to a single node
-					if ( fabs ( cNewPath.GetPoint( 0 ).x - cNewPath.GetPoint( 1 ).x ) < 5.0f && fabs ( cNewPath.GetPoint( 0 ).y - cNewPath.GetPoint( 1 ).y ) < 5.0f )
-						cNewPath.RemoveLast();
-				}
-			}
-			*/
+			g_LeeThread.TakeResult ( this->iID, &cNewPath, &vecFinalDest.x, &vecFinalDest.y, &vecFinalDest.z );
 
 			// create move path from above result
 			cMovePath.Clear ( );
@@ -3862,154 +3736,6 @@ void Entity::UpdateMovement ( float fTimeDelta )
 		}
 	}
 
-	// and ensure this expensive task is only done once per fPathTimer
-	/* new thread code
-	if ( bUpdateMovement && fPathTimer <= 0.0f )
-	{
-		// new path must start from here, and is also final pos if no path routed
-		vecFinalDest.x = GetX( );
-		vecFinalDest.y = GetY( );
-		vecFinalDest.z = GetZ( );
-
-		// if stored final dest in "pre_", restore it
-		if ( pre_vecFinalDest.x != -999 )
-		{
-			vecFinalDest.x = pre_vecFinalDest.x;
-			vecFinalDest.y = pre_vecFinalDest.y;
-			vecFinalDest.z = pre_vecFinalDest.z;
-			vecLastDest.x = pre_vecLastDest.x;
-			vecLastDest.y = pre_vecLastDest.y;
-			vecLastDest.z = pre_vecLastDest.z;
-		}
-		pre_vecFinalDest.x = -999;
-		pre_vecLastDest.x = -999;
-
-		// remove any old paths (about to create a new one)
-		cMovePath.DebugHide ( );
-		DebugHideDestination ( );
-		ListOfEntitiesToUpdateMovement.erase (ListOfEntitiesToUpdateMovement.begin()+0);
-
-		// prepare level obstacles for new path calculation
-		Path cNewPath;
-		pContainer->pPathFinder->ActivateAllWaypoints ( );
-		pContainer->pPathFinder->CalculatePath ( GetX( ), GetZ( ), vecFinalDest.x, vecFinalDest.z, &cNewPath, fPathStartCostLimit, iDestContainer );
-		bRedoPath = false;
-		fForceUpdatePathTimer = 0.0f;
-		fPathTimer = 0.75f; // 070317 - faster zombies require higher fidelity to prevent stop start
-
-		// if no path to finaldest, work from finaldest back to known reachable point
-		if ( cNewPath.CountPoints() == 0 )
-		{
-			// okay, so final dest not pathable, and no direct line to barrier
-			// so find closest node from container, and set that as finaldest
-			int iThisContainer = GetContainer()->GetID(); 
-			iDestContainer = iThisContainer; // container ID can be changed below
-			float fBestDistance = 999999.0f;
-			float fBestX = 0.0f;
-			float fBestZ = 0.0f;
-			float fDX = GetX( ) - vecFinalDest.x;
-			float fDZ = GetZ( ) - vecFinalDest.z;
-			float fDD = sqrt ( fabs(fDX*fDX) + fabs(fDZ*fDZ) );
-			float fDDInc = fDD / 30.0f;
-			int iDistCount = (int)fDDInc;
-			for ( int iDist = 1; iDist <= 30; iDist++ )
-			{
-				for ( int iAng = 0; iAng < 360; iAng+=45 )
-				{
-					// this is where I want the AI to try to get to
-					float fTryX = vecFinalDest.x + (sin(iAng*DEGTORAD)*(iDist*fDDInc));
-					float fTryZ = vecFinalDest.z + (cos(iAng*DEGTORAD)*(iDist*fDDInc));
-					int waypointmax = waypoint_getmax();
-					for ( int waypointindex = 1; waypointindex <= waypointmax; waypointindex++ )
-					{
-						int tokay = waypoint_ispointinzoneex ( waypointindex, fTryX, vecFinalDest.y, fTryZ, 1 );
-						if ( tokay == 1 ) 
-						{
-							iDestContainer = waypointindex;
-							fBestDistance = 0;
-							fBestX = fTryX;
-							fBestZ = fTryZ;
-							iDist = 31;
-							iAng = 361;
-							break;
-						}
-					}
-				}
-			}
-			if ( fBestDistance != 999999.0f )
-			{
-				// best is within waypoint zone, but outside AI obstacle zone (margin added to AI waypoint system)
-				// so project away from player to ensure we get inside
-				float fDX = fBestX - vecFinalDest.x;
-				float fDZ = fBestZ - vecFinalDest.z;
-				float fDD = sqrt ( fabs(fDX*fDX)+fabs(fDZ*fDZ) );
-				fDX = (fDX/fDD)*(fDD+30.0f);
-				fDZ = (fDZ/fDD)*(fDD+30.0f);
-				fBestX = vecFinalDest.x + fDX;
-				fBestZ = vecFinalDest.z + fDZ;
-
-				// now assign final pos
-				if ( iDestContainer != iThisContainer )
-				{
-					// found closer position in another container, so just go there
-					vecFinalDest.x = fBestX;
-					vecFinalDest.z = fBestZ;
-				}
-				else
-				{
-					// same container, so dont get too close to edge when move nearer target
-					float fPushX = fBestX - vecFinalDest.x;
-					float fPushZ = fBestZ - vecFinalDest.z;
-					float fPushDD = sqrt ( fabs(fPushX*fPushX) + fabs(fPushZ*fPushZ) );
-					fPushX /= fPushDD;
-					fPushZ /= fPushDD;
-					vecFinalDest.x = fBestX + (fPushX*2.0f);
-					vecFinalDest.z = fBestZ + (fPushZ*2.0f);
-				}
-			}
-			else
-			{
-				if ( GetContainer()->GetID() == 0 )
-				{
-					float fResult = pContainer->pPathFinder->FindClosestPolygon ( GetX( ), GetZ( ), vecFinalDest.x, vecFinalDest.z );
-					if ( fResult >= 0.1f ) 
-					{
-						iDestContainer = GetContainer()->GetID(); 
-						vecFinalDest.x = GetX( ) + ( vecFinalDest.x - GetX( ) )*fResult;
-						vecFinalDest.z = GetZ( ) + ( vecFinalDest.z - GetZ( ) )*fResult;
-					}
-				}
-			}
-
-			// chart new path to this permimeter position
-			cNewPath.Clear ( );
-			pContainer->pPathFinder->ActivateAllWaypoints ( );
-			pContainer->pPathFinder->CalculatePath ( GetX( ), GetZ( ), vecFinalDest.x, vecFinalDest.z, &cNewPath, fPathStartCostLimit, iDestContainer );
-			if ( cNewPath.CountPoints( ) == 2 )
-			{
-				// if path has zero length, reduce to a single node
-				if ( fabs ( cNewPath.GetPoint( 0 ).x - cNewPath.GetPoint( 1 ).x ) < 5.0f && fabs ( cNewPath.GetPoint( 0 ).y - cNewPath.GetPoint( 1 ).y ) < 5.0f )
-					cNewPath.RemoveLast();
-			}
-		}
-
-		// create move path from above result
-		cMovePath.Clear ( );
-		if ( cNewPath.CountPoints( ) > 0 )
-		{
-			// make new path the move path
-			cMovePath = cNewPath;
-			iCurrentMovePoint = 1;
-			bChangingContainers = false;
-			if ( cNewPath.CountPoints( ) > 1 )
-			{
-				if ( cMovePath.GetPoint( 0 ).container != cMovePath.GetPoint( 1 ).container ) 
-					bChangingContainers = true;
-			}
-		}
-	}
-	IN A THREAD END*/
-	
 	// set intermediate destination based on path and avoidance data
 	if ( bAvoiding && !bChangingContainers && !bIsLeaping && !bIsDiving )
 	{
@@ -4472,10 +4198,7 @@ void Entity::UpdateMovement ( float fTimeDelta )
 void Entity::RemoveFromThread ( )
 {
 	// when destroy entity, ensure leave any thread work
-	if ( g_LeeThread.GetWorkInProgress() == this->iID )
-	{
-		g_LeeThread.EndWork();
-	}
+	g_LeeThread.EndWork( this->iID );
 }
 
 void Entity::UpdateState ( )
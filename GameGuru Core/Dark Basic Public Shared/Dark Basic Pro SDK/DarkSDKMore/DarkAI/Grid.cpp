@@ -1,461 +1,316 @@
 #include "Grid.h"
 #include <stdio.h>
+#include <limits.h>
+
+#define GRID_INITIAL_SLOTS		4096
+#define GRID_KEY_BIAS			0x8000000080000000ULL
 
 Grid::Grid( )
 {
-	for( int i = 0; i < 100; i++ )
-		for( int j = 0; j < 100; j++ )
-			m_pGrid [ i ][ j ] = NULL;
-
-	hMutex = CreateMutex( NULL, FALSE, NULL );
+	m_iCapacity = 0;
+	m_iUsed = 0;
+	m_pKey = NULL;
+	m_pValue = NULL;
+	m_pReserved = NULL;
+	m_pPositionTimer = NULL;
+	m_pReserveTimer = NULL;
+
+	Allocate( GRID_INITIAL_SLOTS );
 }
 
 Grid::~Grid( )
 {
-	Reset( );
-	CloseHandle( hMutex );
+	Free( );
 }
 
-void Grid::Reset( )
+void Grid::Allocate( int iCapacity )
 {
-	int result = WaitForSingleObject( hMutex, INFINITE );
-	if ( result != WAIT_OBJECT_0 )
+	m_iCapacity = iCapacity;
+	m_pKey = new std::atomic<unsigned long long> [ iCapacity ];
+	m_pValue = new std::atomic<int> [ iCapacity ];
+	m_pReserved = new std::atomic<int> [ iCapacity ];
+	m_pPositionTimer = new std::atomic<float> [ iCapacity ];
+	m_pReserveTimer = new std::atomic<float> [ iCapacity ];
+
+	for ( int i = 0; i < iCapacity; i++ )
 	{
-		char str[64];
-		sprintf_s( str, 64, "Failed to lock Grid (reset) mutex, error: %d", GetLastError( ) );
-		MessageBox( NULL, str, "Error", 0 );
-		exit(-1);
+		m_pKey [ i ].store( 0, std::memory_order_relaxed );
+		m_pValue [ i ].store( 0, std::memory_order_relaxed );
+		m_pReserved [ i ].store( 0, std::memory_order_relaxed );
+		m_pPositionTimer [ i ].store( 0.0f, std::memory_order_relaxed );
+		m_pReserveTimer [ i ].store( 0.0f, std::memory_order_relaxed );
 	}
 
-	for( int i = 0; i < 100; i++ )
-	{
-		for( int j = 0; j < 100; j++ )
-		{
-			GridElement *pElement = m_pGrid [ i ][ j ];
-
-			while ( pElement )
-			{
-				m_pGrid [ i ][ j ] = pElement->pNextElement;
-
-				delete pElement;
-				pElement = m_pGrid [ i ][ j ];
-			}
-		}
-	}
+	m_iUsed = 0;
+}
 
-	ReleaseMutex( hMutex );
+void Grid::Free( )
+{
+	if ( m_pKey ) delete [] m_pKey;
+	if ( m_pValue ) delete [] m_pValue;
+	if ( m_pReserved ) delete [] m_pReserved;
+	if ( m_pPositionTimer ) delete [] m_pPositionTimer;
+	if ( m_pReserveTimer ) delete [] m_pReserveTimer;
+
+	m_pKey = NULL;
+	m_pValue = NULL;
+	m_pReserved = NULL;
+	m_pPositionTimer = NULL;
+	m_pReserveTimer = NULL;
+	m_iCapacity = 0;
 }
 
-void Grid::SetPosition( int x, int z, int value )
+// all 32 bits of x then z, flipped by the bias so the unused key 0 is the
+// cell INT_MIN,INT_MIN, which is moved one cell over as it can never be stored
+unsigned long long Grid::MakeKey( int x, int z )
 {
-	int indexX = abs(x) % 100;
-	int indexZ = abs(z) % 100;
+	if ( x == INT_MIN && z == INT_MIN ) z++;
+	unsigned long long ux = (unsigned long long) (unsigned int) x;
+	unsigned long long uz = (unsigned long long) (unsigned int) z;
+	return ( ( ux << 32 ) | uz ) ^ GRID_KEY_BIAS;
+}
 
-	if ( indexX > 99 ) indexX = 99;
-	if ( indexZ > 99 ) indexZ = 99;
-	if ( indexX < 0 ) indexX = 0;
-	if ( indexZ < 0 ) indexZ = 0;
+static inline unsigned int GridHash( unsigned long long key )
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return (unsigned int) key;
+}
 
-	int result = WaitForSingleObject( hMutex, INFINITE );
-	if ( result != WAIT_OBJECT_0 )
-	{
-		char str[64];
-		sprintf_s( str, 64, "Failed to lock Grid (set) mutex, error: %d", GetLastError( ) );
-		MessageBox( NULL, str, "Error", 0 );
-		exit(-1);
-	}
+int Grid::FindSlot( int x, int z )
+{
+	unsigned long long key = MakeKey( x, z );
+	int mask = m_iCapacity - 1;
+	int slot = GridHash( key ) & mask;
 
-	if ( !m_pGrid [ indexX ][ indexZ ] )
+	for ( int i = 0; i < m_iCapacity; i++ )
 	{
-		m_pGrid [ indexX ][ indexZ ] = new GridElement();
-		m_pGrid [ indexX ][ indexZ ]->SetData( x,z, value );
+		unsigned long long current = m_pKey [ slot ].load( std::memory_order_acquire );
+		if ( current == key ) return slot;
+		if ( current == 0 ) return -1;
+		slot = ( slot + 1 ) & mask;
 	}
-	else
-	{
-		GridElement *pElement = m_pGrid [ indexX ][ indexZ ];
-
-		while ( pElement )
-		{
-			if ( pElement->GetX() == x && pElement->GetZ() == z )
-			{
-				pElement->SetData( x,z, value );
-				ReleaseMutex( hMutex );
-				return;
-			}
-
-			pElement = pElement->pNextElement;
-		}
 
-		GridElement *pNewElement = new GridElement();
-		pNewElement->SetData( x,z, value );
-
-		pElement = m_pGrid [ indexX ][ indexZ ];
-
-		while ( pElement->pNextElement )
-		{
-			pElement = pElement->pNextElement;
-		}
-
-		pElement->pNextElement = pNewElement;
-	}
-
-	ReleaseMutex( hMutex );
+	return -1;
 }
 
-int Grid::GetPosition( int x, int z )
+int Grid::FindOrAddSlot( int x, int z )
 {
-	int indexX = abs(x) % 100;
-	int indexZ = abs(z) % 100;
+	unsigned long long key = MakeKey( x, z );
+	int mask = m_iCapacity - 1;
+	int slot = GridHash( key ) & mask;
 
-	if ( indexX > 99 ) indexX = 99;
-	if ( indexZ > 99 ) indexZ = 99;
-	if ( indexX < 0 ) indexX = 0;
-	if ( indexZ < 0 ) indexZ = 0;
-
-	int result = WaitForSingleObject( hMutex, INFINITE );
-	if ( result != WAIT_OBJECT_0 )
+	for ( int i = 0; i < m_iCapacity; i++ )
 	{
-		char str[64];
-		sprintf_s( str, 64, "Failed to lock Grid (get) mutex, error: %d", GetLastError( ) );
-		MessageBox( NULL, str, "Error", 0 );
-		exit(-1);
-	}
-
-	if ( m_pGrid [ indexX ][ indexZ ] )
-	{
-		GridElement *pElement = m_pGrid [ indexX ][ indexZ ];
-
-		while ( pElement )
+		unsigned long long current = m_pKey [ slot ].load( std::memory_order_acquire );
+		if ( current == key ) return slot;
+		if ( current == 0 )
 		{
-			if ( pElement->GetX( ) == x && pElement->GetZ( ) == z ) 
+			// keep a quarter of the table free so probes stay short, the caller grows it
+			if ( m_iUsed * 4 >= m_iCapacity * 3 ) return -1;
+
+			// another thread may claim this slot first, if it was for the same cell use it
+			if ( m_pKey [ slot ].compare_exchange_strong( current, key, std::memory_order_acq_rel ) )
 			{
-				int value = pElement->GetValue( );
-				ReleaseMutex( hMutex );
-				return value;
+				m_iUsed++;
+				return slot;
 			}
-
-			pElement = pElement->pNextElement;
+			if ( current == key ) return slot;
 		}
-		
+		slot = ( slot + 1 ) & mask;
 	}
-	
-	ReleaseMutex( hMutex );
-	return 0;
+
+	return -1;
 }
 
-void Grid::DeletePosition( int x, int z )
+int Grid::AddSlot( std::shared_lock<std::shared_timed_mutex> &lock, int x, int z )
 {
-	int indexX = abs(x) % 100;
-	int indexZ = abs(z) % 100;
-
-	if ( indexX > 99 ) indexX = 99;
-	if ( indexZ > 99 ) indexZ = 99;
-	if ( indexX < 0 ) indexX = 0;
-	if ( indexZ < 0 ) indexZ = 0;
-
-	int result = WaitForSingleObject( hMutex, INFINITE );
-	if ( result != WAIT_OBJECT_0 )
-	{
-		char str[64];
-		sprintf_s( str, 64, "Failed to lock Grid (delete) mutex, error: %d", GetLastError( ) );
-		MessageBox( NULL, str, "Error", 0 );
-		exit(-1);
-	}
-
-	if ( m_pGrid [ indexX ][ indexZ ] )
+	// when the table is too full to take the cell, grow it and try again
+	int slot = FindOrAddSlot( x, z );
+	while ( slot < 0 )
 	{
-		GridElement *pElement = m_pGrid [ indexX ][ indexZ ];
-		GridElement *pPrevElement = NULL;
-
-		while ( pElement )
+		int iCapacity = m_iCapacity;
+		lock.unlock( );
 		{
-			if ( pElement->GetX( ) == x && pElement->GetZ( ) == z ) 
-			{
-				if ( !pPrevElement ) m_pGrid [ indexX ][ indexZ ] = pElement->pNextElement;
-				else pPrevElement->pNextElement = pElement->pNextElement;
-
-				delete pElement;
-			}
-			else
-			{
-				pPrevElement = pElement;
-			}
-
-			if ( pPrevElement ) pElement = pPrevElement->pNextElement;
-			else pElement = m_pGrid [ indexX ][ indexZ ];
+			std::unique_lock<std::shared_timed_mutex> grow( m_Lock );
+			if ( m_iCapacity == iCapacity ) Rebuild( iCapacity * 2 );
 		}
-		
+		lock.lock( );
+		slot = FindOrAddSlot( x, z );
 	}
-	
-	ReleaseMutex( hMutex );
+	return slot;
 }
 
-void Grid::Increment( int x, int z )
+void Grid::Reset( )
 {
-	int indexX = abs(x) % 100;
-	int indexZ = abs(z) % 100;
+	std::unique_lock<std::shared_timed_mutex> lock( m_Lock );
 
-	if ( indexX > 99 ) indexX = 99;
-	if ( indexZ > 99 ) indexZ = 99;
-	if ( indexX < 0 ) indexX = 0;
-	if ( indexZ < 0 ) indexZ = 0;
-
-	int result = WaitForSingleObject( hMutex, INFINITE );
-	if ( result != WAIT_OBJECT_0 )
+	for ( int i = 0; i < m_iCapacity; i++ )
 	{
-		char str[64];
-		sprintf_s( str, 64, "Failed to lock Grid (inc) mutex, error: %d", GetLastError( ) );
-		MessageBox( NULL, str, "Error", 0 );
-		exit(-1);
+		m_pKey [ i ].store( 0, std::memory_order_relaxed );
+		m_pValue [ i ].store( 0, std::memory_order_relaxed );
+		m_pReserved [ i ].store( 0, std::memory_order_relaxed );
 	}
 
-	if ( !m_pGrid [ indexX ][ indexZ ] )
-	{
-		m_pGrid [ indexX ][ indexZ ] = new GridElement();
-		m_pGrid [ indexX ][ indexZ ]->SetData( x,z, 1 );
-	}
-	else
-	{
-		GridElement *pElement = m_pGrid [ indexX ][ indexZ ];
-
-		while ( pElement )
-		{
-			if ( pElement->GetX() == x && pElement->GetZ() == z )
-			{
-				pElement->Increment( );
-				ReleaseMutex( hMutex );
-				return;
-			}
-
-			pElement = pElement->pNextElement;
-		}
-
-		GridElement *pNewElement = new GridElement();
-		pNewElement->SetData( x,z, 1 );
+	m_iUsed = 0;
+}
 
-		pElement = m_pGrid [ indexX ][ indexZ ];
+void Grid::SetPosition( int x, int z, int value )
+{
+	std::shared_lock<std::shared_timed_mutex> lock( m_Lock );
+	int slot = AddSlot( lock, x, z );
 
-		while ( pElement->pNextElement )
-		{
-			pElement = pElement->pNextElement;
-		}
+	m_pValue [ slot ].store( value, std::memory_order_relaxed );
+	m_pPositionTimer [ slot ].store( 1.0f, std::memory_order_relaxed );
+}
 
-		pElement->pNextElement = pNewElement;
-	}
+int Grid::GetPosition( int x, int z )
+{
+	std::shared_lock<std::shared_timed_mutex> lock( m_Lock );
+	int slot = FindSlot( x, z );
+	if ( slot < 0 ) return 0;
 
-	ReleaseMutex( hMutex );
+	return m_pValue [ slot ].load( std::memory_order_relaxed );
 }
 
-void Grid::Decrement( int x, int z )
+void Grid::DeletePosition( int x, int z )
 {
-	int indexX = abs(x) % 100;
-	int indexZ = abs(z) % 100;
-
-	if ( indexX > 99 ) indexX = 99;
-	if ( indexZ > 99 ) indexZ = 99;
-	if ( indexX < 0 ) indexX = 0;
-	if ( indexZ < 0 ) indexZ = 0;
+	std::shared_lock<std::shared_timed_mutex> lock( m_Lock );
+	int slot = FindSlot( x, z );
+	if ( slot < 0 ) return;
 
-	int result = WaitForSingleObject( hMutex, INFINITE );
-	if ( result != WAIT_OBJECT_0 )
-	{
-		char str[64];
-		sprintf_s( str, 64, "Failed to lock Grid (inc) mutex, error: %d", GetLastError( ) );
-		MessageBox( NULL, str, "Error", 0 );
-		exit(-1);
-	}
+	m_pValue [ slot ].store( 0, std::memory_order_relaxed );
+	m_pReserved [ slot ].store( 0, std::memory_order_relaxed );
+}
 
-	bool bDelete = false;
+void Grid::Increment( int x, int z )
+{
+	std::shared_lock<std::shared_timed_mutex> lock( m_Lock );
+	int slot = AddSlot( lock, x, z );
 
-	if ( !m_pGrid [ indexX ][ indexZ ] )
-	{
-		ReleaseMutex( hMutex );
-		return;
-	}
+	if ( m_pValue [ slot ].fetch_add( 1, std::memory_order_relaxed ) == 0 )
+		m_pPositionTimer [ slot ].store( 1.0f, std::memory_order_relaxed );
+}
 
-	GridElement *pElement = m_pGrid [ indexX ][ indexZ ];
+void Grid::Decrement( int x, int z )
+{
+	std::shared_lock<std::shared_timed_mutex> lock( m_Lock );
+	int slot = FindSlot( x, z );
+	if ( slot < 0 ) return;
 
-	while ( pElement )
+	// an empty cell stays at zero, same as deleting the element when it reached zero
+	int value = m_pValue [ slot ].load( std::memory_order_relaxed );
+	while ( value > 0 )
 	{
-		if ( pElement->GetX() == x && pElement->GetZ() == z )
+		if ( m_pValue [ slot ].compare_exchange_weak( value, value - 1, std::memory_order_relaxed ) )
 		{
-			pElement->Decrement( );
-			if ( pElement->GetValue( ) <= 0 ) bDelete = true;
-			break;
+			if ( value - 1 == 0 ) m_pReserved [ slot ].store( 0, std::memory_order_relaxed );
+			return;
 		}
-
-		pElement = pElement->pNextElement;
 	}
-	
-	ReleaseMutex( hMutex );
-
-	if ( bDelete ) DeletePosition( x,z );
+	if ( value < 0 )
+	{
+		m_pValue [ slot ].store( 0, std::memory_order_relaxed );
+		m_pReserved [ slot ].store( 0, std::memory_order_relaxed );
+	}
 }
 
 void Grid::Reserve( int x, int z, int value )
 {
-	int indexX = abs(x) % 100;
-	int indexZ = abs(z) % 100;
+	std::shared_lock<std::shared_timed_mutex> lock( m_Lock );
+	int slot = AddSlot( lock, x, z );
 
-	if ( indexX > 99 ) indexX = 99;
-	if ( indexZ > 99 ) indexZ = 99;
-	if ( indexX < 0 ) indexX = 0;
-	if ( indexZ < 0 ) indexZ = 0;
+	// a newly used cell is marked -1 so it reads as reserved rather than occupied
+	int expected = 0;
+	if ( m_pValue [ slot ].compare_exchange_strong( expected, -1, std::memory_order_relaxed ) )
+		m_pPositionTimer [ slot ].store( 1.0f, std::memory_order_relaxed );
 
-	int result = WaitForSingleObject( hMutex, INFINITE );
-	if ( result != WAIT_OBJECT_0 )
-	{
-		char str[64];
-		sprintf_s( str, 64, "Failed to lock Grid (reserve) mutex, error: %d", GetLastError( ) );
-		MessageBox( NULL, str, "Error", 0 );
-		exit(-1);
-	}
-
-	if ( !m_pGrid [ indexX ][ indexZ ] )
-	{
-		m_pGrid [ indexX ][ indexZ ] = new GridElement();
-		m_pGrid [ indexX ][ indexZ ]->SetData( x,z, -1 );
-		m_pGrid [ indexX ][ indexZ ]->SetReserved( value );
-	}
-	else
-	{
-		GridElement *pElement = m_pGrid [ indexX ][ indexZ ];
-
-		while ( pElement )
-		{
-			if ( pElement->GetX() == x && pElement->GetZ() == z )
-			{
-				//pElement->SetData( x,z, 0 );
-				pElement->SetReserved( value );
-				ReleaseMutex( hMutex );
-				return;
-			}
-
-			pElement = pElement->pNextElement;
-		}
-
-		GridElement *pNewElement = new GridElement();
-		pNewElement->SetData( x,z, -1 );
-		pNewElement->SetReserved( value );
-
-		pElement = m_pGrid [ indexX ][ indexZ ];
+	m_pReserved [ slot ].store( value, std::memory_order_relaxed );
+	m_pReserveTimer [ slot ].store( 5.0f, std::memory_order_relaxed );
+}
 
-		while ( pElement->pNextElement )
-		{
-			pElement = pElement->pNextElement;
-		}
+int Grid::GetReserved( int x, int z )
+{
+	std::shared_lock<std::shared_timed_mutex> lock( m_Lock );
+	int slot = FindSlot( x, z );
+	if ( slot < 0 ) return 0;
 
-		pElement->pNextElement = pNewElement;
-	}
+	return m_pReserved [ slot ].load( std::memory_order_relaxed );
+}
 
-	ReleaseMutex( hMutex );
+bool Grid::GetSlot( int iSlot, int *pX, int *pZ, int *pValue, int *pReserved )
+{
+	std::shared_lock<std::shared_timed_mutex> lock( m_Lock );
+	if ( iSlot < 0 || iSlot >= m_iCapacity ) return false;
+
+	unsigned long long key = m_pKey [ iSlot ].load( std::memory_order_acquire );
+	if ( key == 0 ) return false;
+
+	key ^= GRID_KEY_BIAS;
+	if ( pX ) *pX = (int) (unsigned int) ( key >> 32 );
+	if ( pZ ) *pZ = (int) (unsigned int) key;
+	if ( pValue ) *pValue = m_pValue [ iSlot ].load( std::memory_order_relaxed );
+	if ( pReserved ) *pReserved = m_pReserved [ iSlot ].load( std::memory_order_relaxed );
+	return true;
 }
 
-int Grid::GetReserved( int x, int z )
+void Grid::Update( float fTimeDelta )
 {
-	int indexX = abs(x) % 100;
-	int indexZ = abs(z) % 100;
+	// cell expiry stays disabled as the grid timers are not used now, but
+	// cells that have emptied give their slots back once the table gets busy
+	if ( m_iUsed * 2 < m_iCapacity ) return;
 
-	if ( indexX > 99 ) indexX = 99;
-	if ( indexZ > 99 ) indexZ = 99;
-	if ( indexX < 0 ) indexX = 0;
-	if ( indexZ < 0 ) indexZ = 0;
+	// AI threads may be reading the grid, wait for them to finish first
+	std::unique_lock<std::shared_timed_mutex> lock( m_Lock );
+	Rebuild( m_iCapacity );
+}
 
-	int result = WaitForSingleObject( hMutex, INFINITE );
-	if ( result != WAIT_OBJECT_0 )
+void Grid::Rebuild( int iMinCapacity )
+{
+	// caller holds the exclusive lock, empty cells are dropped on the way
+	int iLive = 0;
+	for ( int i = 0; i < m_iCapacity; i++ )
 	{
-		char str[64];
-		sprintf_s( str, 64, "Failed to lock Grid (getR) mutex, error: %d", GetLastError( ) );
-		MessageBox( NULL, str, "Error", 0 );
-		exit(-1);
+		if ( m_pKey [ i ].load( std::memory_order_relaxed ) == 0 ) continue;
+		if ( m_pValue [ i ].load( std::memory_order_relaxed ) != 0 || m_pReserved [ i ].load( std::memory_order_relaxed ) != 0 ) iLive++;
 	}
 
-	if ( m_pGrid [ indexX ][ indexZ ] )
-	{
-		GridElement *pElement = m_pGrid [ indexX ][ indexZ ];
+	int iNewCapacity = iMinCapacity;
+	while ( iLive * 4 > iNewCapacity ) iNewCapacity *= 2;
 
-		while ( pElement )
-		{
-			if ( pElement->GetX( ) == x && pElement->GetZ( ) == z ) 
-			{
-				int value = pElement->GetReserved( );
-				ReleaseMutex( hMutex );
-				return value;
-			}
+	std::atomic<unsigned long long> *pOldKey = m_pKey;
+	std::atomic<int> *pOldValue = m_pValue;
+	std::atomic<int> *pOldReserved = m_pReserved;
+	std::atomic<float> *pOldPositionTimer = m_pPositionTimer;
+	std::atomic<float> *pOldReserveTimer = m_pReserveTimer;
+	int iOldCapacity = m_iCapacity;
 
-			pElement = pElement->pNextElement;
-		}
-		
-	}
-	
-	ReleaseMutex( hMutex );
-	return 0;
-}
+	Allocate( iNewCapacity );
 
-void Grid::Update( float fTimeDelta )
-{
-	/* this does nothing as grid not used now
-	for( int i = 0; i < 100; i++ )
+	for ( int i = 0; i < iOldCapacity; i++ )
 	{
-		for( int j = 0; j < 100; j++ )
-		{
-			GridElement *pElement = m_pGrid [ i ][ j ];
-			GridElement *pPrevElement = NULL;
-
-			while ( pElement )
-			{
-				pElement->DecreaseTime( fTimeDelta );
-
-				if ( pElement->PositionHasExpired( ) )
-				{
-					if ( pElement->GetReserved( ) )
-					{
-						pElement->SetData( pElement->GetX(), pElement->GetZ(), -1 );
-					}
-					else
-					{
-						if ( pPrevElement ) pPrevElement->pNextElement = pElement->pNextElement;
-						else m_pGrid [ i ][ j ] = pElement->pNextElement;
-
-						GridElement *pDelElement = pElement;
-						pElement = pElement->pNextElement;
-						delete pDelElement;
-						continue;
-					}
-				}
-
-				if ( pElement->GetReserved( ) )
-				{
-					if ( pElement->ReserveHasExpired( ) )
-					{
-						pElement->SetReserved( 0 );
-						if ( pElement->GetValue( ) <= 0 )
-						{
-							if ( pPrevElement ) pPrevElement->pNextElement = pElement->pNextElement;
-							else m_pGrid [ i ][ j ] = pElement->pNextElement;
-
-							GridElement *pDelElement = pElement;
-							pElement = pElement->pNextElement;
-							delete pDelElement;
-							continue;
-						}
-					}
-				}
-
-				pPrevElement = pElement;
-				pElement = pElement->pNextElement;
-			}
-		}
+		unsigned long long key = pOldKey [ i ].load( std::memory_order_relaxed );
+		if ( key == 0 ) continue;
+		int value = pOldValue [ i ].load( std::memory_order_relaxed );
+		int reserved = pOldReserved [ i ].load( std::memory_order_relaxed );
+		if ( value == 0 && reserved == 0 ) continue;
+
+		int mask = m_iCapacity - 1;
+		int slot = GridHash( key ) & mask;
+		while ( m_pKey [ slot ].load( std::memory_order_relaxed ) != 0 ) slot = ( slot + 1 ) & mask;
+
+		m_pKey [ slot ].store( key, std::memory_order_relaxed );
+		m_pValue [ slot ].store( value, std::memory_order_relaxed );
+		m_pReserved [ slot ].store( reserved, std::memory_order_relaxed );
+		m_pPositionTimer [ slot ].store( pOldPositionTimer [ i ].load( std::memory_order_relaxed ), std::memory_order_relaxed );
+		m_pReserveTimer [ slot ].store( pOldReserveTimer [ i ].load( std::memory_order_relaxed ), std::memory_order_relaxed );
+		m_iUsed++;
 	}
-	*/
-}
-
-GridElement* Grid::GetRootElement( int x, int z )
-{
-	if ( x < 0 ) x = 0;
-	if ( z < 0 ) z = 0;
-	if ( x > 99 ) x = 99;
-	if ( z > 99 ) z = 99;
 
-	return m_pGrid [ x ][ z ];
-}
\ No newline at end of file
+	delete [] pOldKey;
+	delete [] pOldValue;
+	delete [] pOldReserved;
+	delete [] pOldPositionTimer;
+	delete [] pOldReserveTimer;
+}
@@ -1,41 +1,16 @@
 #ifndef H_GRID
 #define H_GRID
 
-#include <windows.h>
-
-class GridElement
-{
-
-public:
-
-	GridElement( ) { pNextElement = NULL; m_value = 0; m_x = 0; m_z = 0; m_reserved = 0; }
-	~GridElement( ) {};
-
-	void SetData( int x, int z, int value ) { m_x = x; m_z = z; m_value = value; m_timer2 = 1.0f; }
-	int GetX( ) { return m_x; }
-	int GetZ( ) { return m_z; }
-	int GetValue( ) { return m_value; }
-	void SetReserved( int value ) { m_reserved = value; m_timer = 5.0f; }
-	int GetReserved( ) { return m_reserved; }
-	void DecreaseTime( float fTimeDelta ) { m_timer -= fTimeDelta; m_timer2 -= fTimeDelta; }
-	bool ReserveHasExpired( ) { return m_timer <= 0.0f; }
-	bool PositionHasExpired( ) { return m_timer2 <= 0.0f; }
-	void Increment( ) { m_value++; }
-	void Decrement( ) { m_value--; }
-
-	GridElement *pNextElement;
-
-private:
-
-	int m_x;
-	int m_z;
-	int m_value;
-	int m_reserved;
-	float m_timer;
-	float m_timer2;
-	
-};
-
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+// avoidance grid, an open addressed hash keyed by the full cell coordinate so
+// distant cells never share an entry. Each field lives in its own array and
+// every per-cell operation is a single atomic, so AI threads can read and
+// write cells at the same time under a shared lock. A cell keeps its slot
+// once used, the table is only rebuilt (to grow it or reclaim empty slots)
+// under the exclusive lock so no thread is reading it at the time
 class Grid
 {
 
@@ -57,12 +32,31 @@ public:
 	void Reset( );
 	void Update( float fTimeDelta );
 
-	GridElement* GetRootElement( int x, int z );
+	// used by the debug display to visit every cell in use
+	int GetNumSlots( ) { return m_iCapacity; }
+	bool GetSlot( int iSlot, int *pX, int *pZ, int *pValue, int *pReserved );
 
 private:
 
-	HANDLE hMutex;
-	GridElement* m_pGrid [ 100 ][ 100 ];
+	static unsigned long long MakeKey( int x, int z );
+	int FindSlot( int x, int z );
+	int FindOrAddSlot( int x, int z );
+	int AddSlot( std::shared_lock<std::shared_timed_mutex> &lock, int x, int z );
+	void Rebuild( int iMinCapacity );
+	void Allocate( int iCapacity );
+	void Free( );
+
+	// shared for cell access, exclusive while the arrays are replaced
+	std::shared_timed_mutex m_Lock;
+
+	int m_iCapacity;						// always a power of 2
+	std::atomic<int> m_iUsed;				// slots with a key, including empty cells
+
+	std::atomic<unsigned long long> *m_pKey;	// 0 = slot never used
+	std::atomic<int> *m_pValue;
+	std::atomic<int> *m_pReserved;
+	std::atomic<float> *m_pPositionTimer;
+	std::atomic<float> *m_pReserveTimer;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,4 +1,7 @@
 #include "LeeThread.h"
+#include "World.h"
+
+extern World cWorld;
 
 // prototypes
 int waypoint_getmax(void);
@@ -6,6 +9,8 @@ int waypoint_ispointinzoneex( int iWPIndex, float fX, float fY, float fZ, int iS
 
 LeeThread::LeeThread( )
 {
+	m_iBatchState = LEETHREAD_COLLECTING;
+	m_iCompleteFrames = 0;
 }
 
 LeeThread::~LeeThread( )
@@ -15,148 +20,214 @@ LeeThread::~LeeThread( )
 void LeeThread::SetupData( void )
 {
 	// reset work thread flags
-	m_iAIBeingWorkedOn = -1;
-	m_iAIWorkComplete = -1;
+	m_Job_list.clear();
+	m_iBatchState = LEETHREAD_COLLECTING;
+	m_iCompleteFrames = 0;
 	m_bReadyToRun = false;
 	m_bKeepRunning = true;
 }
 
-void LeeThread::BeginWork( int iAIObj, float fX, float fZ, float fFDX, float fFDY, float fFDZ, Container* pContainer, int iDestContID )
+int LeeThread::FindJob( int iAIObj )
 {
-	m_fGetX = fX;
-	m_fGetZ = fZ;
-	m_fFinalDestX = fFDX;
-	m_fFinalDestY = fFDY;
-	m_fFinalDestZ = fFDZ;
-	m_pContainer = pContainer;
-	m_iDestContainer = iDestContID;
-	m_iAIBeingWorkedOn = iAIObj;
+	for ( int i = 0; i < (int)m_Job_list.size(); i++ )
+		if ( m_Job_list[i].iAIObj == iAIObj ) return i;
+	return -1;
+}
+
+bool LeeThread::BeginWork( int iAIObj, float fX, float fZ, float fFDX, float fFDY, float fFDZ, Container* pContainer, int iDestContID )
+{
+	// AI join the batch while it is collecting, the worker starts on it in StartBatch
+	if ( m_iBatchState != LEETHREAD_COLLECTING ) return false;
+	if ( FindJob ( iAIObj ) >= 0 ) return false;
+	sLeePathJob sJob;
+	sJob.iAIObj = iAIObj;
+	sJob.fGetX = fX;
+	sJob.fGetZ = fZ;
+	sJob.fFinalDestX = fFDX;
+	sJob.fFinalDestY = fFDY;
+	sJob.fFinalDestZ = fFDZ;
+	sJob.pContainer = pContainer;
+	sJob.iDestContainer = iDestContID;
+	m_Job_list.push_back ( sJob );
+	return true;
+}
+
+void LeeThread::StartBatch( void )
+{
+	// called once a cycle after all AI have updated
+	if ( m_iBatchState == LEETHREAD_COLLECTING )
+	{
+		if ( m_Job_list.size() > 0 ) m_iBatchState = LEETHREAD_WORKING;
+	}
+	else if ( m_iBatchState == LEETHREAD_COMPLETE )
+	{
+		// results nobody came back for (AI no longer updating) are dropped after a while
+		if ( ++m_iCompleteFrames > 60 )
+		{
+			m_Job_list.clear();
+			m_iBatchState = LEETHREAD_COLLECTING;
+		}
+	}
 }
 
 unsigned int LeeThread::Run( )
 {
-	// wait for the trigger to do some path finding work
+	// wait for a batch of path finding work
 	m_bReadyToRun = false;
 	while ( m_bKeepRunning == true )
 	{
-		if ( m_iAIBeingWorkedOn != -1 && m_iAIWorkComplete == -1 )
+		if ( m_iBatchState == LEETHREAD_WORKING )
 		{
-			// local values
-			float fPathStartCostLimit = -1.0f;
+			SolveBatch();
+			m_iCompleteFrames = 0;
+			m_iBatchState = LEETHREAD_COMPLETE;
+		}
+		else
+		{
+			//PE: This thread takes 70% of CPU time used even if it has nothing to do , so sleep a little.
+			Sleep(1);
+		}
+	}
+	m_bReadyToRun = true;
+	return 0;
+}
 
-			// prepare level obstacles for new path calculation
-			Path cNewPath;
-			m_pContainer->pPathFinder->ActivateAllWaypoints ( );
-			m_pContainer->pPathFinder->CalculatePath ( m_fGetX, m_fGetZ, m_fFinalDestX, m_fFinalDestZ, &cNewPath, fPathStartCostLimit, m_iDestContainer );
+void LeeThread::SolveBatch( void )
+{
+	// every AI tries for its final destination first, all in one batch on the thread pool
+	int iCount = (int)m_Job_list.size();
+	std::vector < sPathQuery > sQuery_list ( iCount );
+	for ( int i = 0; i < iCount; i++ )
+	{
+		sLeePathJob* pJob = &m_Job_list[i];
+		pJob->cNewPath.Clear ( );
+		sQuery_list[i].fSX = pJob->fGetX;
+		sQuery_list[i].fSY = pJob->fGetZ;
+		sQuery_list[i].fEX = pJob->fFinalDestX;
+		sQuery_list[i].fEY = pJob->fFinalDestZ;
+		sQuery_list[i].iContainer = pJob->pContainer->GetID();
+		sQuery_list[i].iDestContainer = pJob->iDestContainer;
+		sQuery_list[i].pResult = &pJob->cNewPath;
+	}
+	cWorld.CalculatePathBatch ( &sQuery_list[0], iCount );
 
-			// if no path to finaldest, work from finaldest back to known reachable point
-			if ( cNewPath.CountPoints() == 0 )
-			{
-				// okay, so final dest not pathable, and no direct line to barrier
-				// so find closest node from container, and set that as finaldest
-				int iThisContainer = m_pContainer->GetID(); 
-				m_iDestContainer = iThisContainer; // container ID can be changed below
-				float fBestDistance = 999999.0f;
-				float fBestX = 0.0f;
-				float fBestZ = 0.0f;
-				float fDX = m_fGetX - m_fFinalDestX;
-				float fDZ = m_fGetZ - m_fFinalDestZ;
-				float fDD = sqrt ( fabs(fDX*fDX) + fabs(fDZ*fDZ) );
-				float fDDInc = fDD / 30.0f;
-				int iDistCount = (int)fDDInc;
-				for ( int iDist = 1; iDist <= 30; iDist++ )
-				{
-					for ( int iAng = 0; iAng < 360; iAng+=45 )
-					{
-						// this is where I want the AI to try to get to
-						float fTryX = m_fFinalDestX + (sin(iAng*DEGTORAD)*(iDist*fDDInc));
-						float fTryZ = m_fFinalDestZ + (cos(iAng*DEGTORAD)*(iDist*fDDInc));
-						int waypointmax = waypoint_getmax();
-						for ( int waypointindex = 1; waypointindex <= waypointmax; waypointindex++ )
-						{
-							int tokay = waypoint_ispointinzoneex ( waypointindex, fTryX, m_fFinalDestY, fTryZ, 1 );
-							if ( tokay == 1 ) 
-							{
-								m_iDestContainer = waypointindex;
-								fBestDistance = 0;
-								fBestX = fTryX;
-								fBestZ = fTryZ;
-								iDist = 31;
-								iAng = 361;
-								break;
-							}
-						}
-					}
-				}
-				if ( fBestDistance != 999999.0f )
-				{
-					// best is within waypoint zone, but outside AI obstacle zone (margin added to AI waypoint system)
-					// so project away from player to ensure we get inside
-					float fDX = fBestX - m_fFinalDestX;
-					float fDZ = fBestZ - m_fFinalDestZ;
-					float fDD = sqrt ( fabs(fDX*fDX)+fabs(fDZ*fDZ) );
-					fDX = (fDX/fDD)*(fDD+30.0f);
-					fDZ = (fDZ/fDD)*(fDD+30.0f);
-					fBestX = m_fFinalDestX + fDX;
-					fBestZ = m_fFinalDestZ + fDZ;
-
-					// now assign final pos
-					if ( m_iDestContainer != iThisContainer )
-					{
-						// found closer position in another container, so just go there
-						m_fFinalDestX = fBestX;
-						m_fFinalDestZ = fBestZ;
-					}
-					else
-					{
-						// same container, so dont get too close to edge when move nearer target
-						float fPushX = fBestX - m_fFinalDestX;
-						float fPushZ = fBestZ - m_fFinalDestZ;
-						float fPushDD = sqrt ( fabs(fPushX*fPushX) + fabs(fPushZ*fPushZ) );
-						fPushX /= fPushDD;
-						fPushZ /= fPushDD;
-						m_fFinalDestX = fBestX + (fPushX*2.0f);
-						m_fFinalDestZ = fBestZ + (fPushZ*2.0f);
-					}
-				}
-				else
-				{
-					if ( m_pContainer->GetID() == 0 )
-					{
-						float fResult = m_pContainer->pPathFinder->FindClosestPolygon ( m_fGetX, m_fGetZ, m_fFinalDestX, m_fFinalDestZ );
-						if ( fResult >= 0.1f ) 
-						{
-							m_iDestContainer = m_pContainer->GetID(); 
-							m_fFinalDestX = m_fGetX + ( m_fFinalDestX - m_fGetX )*fResult;
-							m_fFinalDestZ = m_fGetZ + ( m_fFinalDestZ - m_fGetZ )*fResult;
-						}
-					}
-				}
+	// if no path to finaldest, work from finaldest back to known reachable point
+	// and chart new paths to those permimeter positions in a second batch
+	std::vector < int > iRetry_list;
+	sQuery_list.clear ( );
+	for ( int i = 0; i < iCount; i++ )
+	{
+		sLeePathJob* pJob = &m_Job_list[i];
+		if ( pJob->cNewPath.CountPoints() > 0 ) continue;
+		FindReachableDest ( pJob );
+		sPathQuery sQuery;
+		sQuery.fSX = pJob->fGetX;
+		sQuery.fSY = pJob->fGetZ;
+		sQuery.fEX = pJob->fFinalDestX;
+		sQuery.fEY = pJob->fFinalDestZ;
+		sQuery.iContainer = pJob->pContainer->GetID();
+		sQuery.iDestContainer = pJob->iDestContainer;
+		sQuery.pResult = &pJob->cNewPath;
+		sQuery_list.push_back ( sQuery );
+		iRetry_list.push_back ( i );
+	}
+	if ( sQuery_list.empty() ) return;
+	cWorld.CalculatePathBatch ( &sQuery_list[0], (int)sQuery_list.size() );
 
-				// chart new path to this permimeter position
-				cNewPath.Clear ( );
-				m_pContainer->pPathFinder->ActivateAllWaypoints ( );
-				m_pContainer->pPathFinder->CalculatePath ( m_fGetX, m_fGetZ, m_fFinalDestX, m_fFinalDestZ, &cNewPath, fPathStartCostLimit, m_iDestContainer );
-				if ( cNewPath.CountPoints( ) == 2 )
+	for ( int r = 0; r < (int)iRetry_list.size(); r++ )
+	{
+		Path* pNewPath = &m_Job_list[iRetry_list[r]].cNewPath;
+		if ( pNewPath->CountPoints( ) == 2 )
+		{
+			// if path has zero length, reduce to a single node
+			if ( fabs ( pNewPath->GetPoint( 0 ).x - pNewPath->GetPoint( 1 ).x ) < 5.0f && fabs ( pNewPath->GetPoint( 0 ).y - pNewPath->GetPoint( 1 ).y ) < 5.0f )
+				pNewPath->RemoveLast();
+		}
+	}
+}
+
+void LeeThread::FindReachableDest( sLeePathJob* pJob )
+{
+	// okay, so final dest not pathable, and no direct line to barrier
+	// so find closest node from container, and set that as finaldest
+	int iThisContainer = pJob->pContainer->GetID(); 
+	pJob->iDestContainer = iThisContainer; // container ID can be changed below
+	float fBestDistance = 999999.0f;
+	float fBestX = 0.0f;
+	float fBestZ = 0.0f;
+	float fDX = pJob->fGetX - pJob->fFinalDestX;
+	float fDZ = pJob->fGetZ - pJob->fFinalDestZ;
+	float fDD = sqrt ( fabs(fDX*fDX) + fabs(fDZ*fDZ) );
+	float fDDInc = fDD / 30.0f;
+	int iDistCount = (int)fDDInc;
+	for ( int iDist = 1; iDist <= 30; iDist++ )
+	{
+		for ( int iAng = 0; iAng < 360; iAng+=45 )
+		{
+			// this is where I want the AI to try to get to
+			float fTryX = pJob->fFinalDestX + (sin(iAng*DEGTORAD)*(iDist*fDDInc));
+			float fTryZ = pJob->fFinalDestZ + (cos(iAng*DEGTORAD)*(iDist*fDDInc));
+			int waypointmax = waypoint_getmax();
+			for ( int waypointindex = 1; waypointindex <= waypointmax; waypointindex++ )
+			{
+				int tokay = waypoint_ispointinzoneex ( waypointindex, fTryX, pJob->fFinalDestY, fTryZ, 1 );
+				if ( tokay == 1 ) 
 				{
-					// if path has zero length, reduce to a single node
-					if ( fabs ( m_cNewPath.GetPoint( 0 ).x - cNewPath.GetPoint( 1 ).x ) < 5.0f && fabs ( cNewPath.GetPoint( 0 ).y - cNewPath.GetPoint( 1 ).y ) < 5.0f )
-						cNewPath.RemoveLast();
+					pJob->iDestContainer = waypointindex;
+					fBestDistance = 0;
+					fBestX = fTryX;
+					fBestZ = fTryZ;
+					iDist = 31;
+					iAng = 361;
+					break;
 				}
 			}
+		}
+	}
+	if ( fBestDistance != 999999.0f )
+	{
+		// best is within waypoint zone, but outside AI obstacle zone (margin added to AI waypoint system)
+		// so project away from player to ensure we get inside
+		float fDX = fBestX - pJob->fFinalDestX;
+		float fDZ = fBestZ - pJob->fFinalDestZ;
+		float fDD = sqrt ( fabs(fDX*fDX)+fabs(fDZ*fDZ) );
+		fDX = (fDX/fDD)*(fDD+30.0f);
+		fDZ = (fDZ/fDD)*(fDD+30.0f);
+		fBestX = pJob->fFinalDestX + fDX;
+		fBestZ = pJob->fFinalDestZ + fDZ;
 
-			// pass cNewPath back as result of this thread work
-			m_cNewPath = cNewPath;
-			m_iAIWorkComplete = m_iAIBeingWorkedOn;
+		// now assign final pos
+		if ( pJob->iDestContainer != iThisContainer )
+		{
+			// found closer position in another container, so just go there
+			pJob->fFinalDestX = fBestX;
+			pJob->fFinalDestZ = fBestZ;
 		}
 		else
 		{
-			//PE: This thread takes 70% of CPU time used even if it has nothing to do , so sleep a little.
-			Sleep(1);
+			// same container, so dont get too close to edge when move nearer target
+			float fPushX = fBestX - pJob->fFinalDestX;
+			float fPushZ = fBestZ - pJob->fFinalDestZ;
+			float fPushDD = sqrt ( fabs(fPushX*fPushX) + fabs(fPushZ*fPushZ) );
+			fPushX /= fPushDD;
+			fPushZ /= fPushDD;
+			pJob->fFinalDestX = fBestX + (fPushX*2.0f);
+			pJob->fFinalDestZ = fBestZ + (fPushZ*2.0f);
+		}
+	}
+	else
+	{
+		if ( pJob->pContainer->GetID() == 0 )
+		{
+			float fResult = pJob->pContainer->pPathFinder->FindClosestPolygon ( pJob->fGetX, pJob->fGetZ, pJob->fFinalDestX, pJob->fFinalDestZ );
+			if ( fResult >= 0.1f ) 
+			{
+				pJob->iDestContainer = pJob->pContainer->GetID(); 
+				pJob->fFinalDestX = pJob->fGetX + ( pJob->fFinalDestX - pJob->fGetX )*fResult;
+				pJob->fFinalDestZ = pJob->fGetZ + ( pJob->fFinalDestZ - pJob->fGetZ )*fResult;
+			}
 		}
 	}
-	m_bReadyToRun = true;
-	return 0;
 }
 
 void LeeThread::StopRunning ( void )
@@ -169,16 +240,47 @@ bool LeeThread::IsReadyToRun ( void )
 	return m_bReadyToRun;
 }
 
-void LeeThread::EndWork ( void )
+void LeeThread::FinishBatchIfEmpty ( void )
 {
-	// remember the LeeThread is still running in a VERY TIGHT loop above
-	m_iAIBeingWorkedOn = -1; // do this first to wipe out old job
-	m_iAIWorkComplete = -1; // and only then can we declare the job done
+	if ( m_iBatchState == LEETHREAD_COMPLETE && m_Job_list.empty() )
+		m_iBatchState = LEETHREAD_COLLECTING;
+}
+
+bool LeeThread::TakeResult ( int iAIObj, Path* pNewPath, float* pfFDX, float* pfFDY, float* pfFDZ )
+{
+	if ( m_iBatchState != LEETHREAD_COMPLETE ) return false;
+	int iJob = FindJob ( iAIObj );
+	if ( iJob < 0 ) return false;
+	*pNewPath = m_Job_list[iJob].cNewPath;
+	*pfFDX = m_Job_list[iJob].fFinalDestX;
+	*pfFDY = m_Job_list[iJob].fFinalDestY;
+	*pfFDZ = m_Job_list[iJob].fFinalDestZ;
+	m_Job_list.erase ( m_Job_list.begin() + iJob );
+	FinishBatchIfEmpty();
+	return true;
+}
+
+void LeeThread::EndWork ( int iAIObj )
+{
+	// the worker may be writing the batch, so a job leaving mid batch is only unhooked from its AI
+	int iJob = FindJob ( iAIObj );
+	if ( iJob < 0 ) return;
+	if ( m_iBatchState == LEETHREAD_WORKING )
+	{
+		m_Job_list[iJob].iAIObj = -1;
+	}
+	else
+	{
+		m_Job_list.erase ( m_Job_list.begin() + iJob );
+		FinishBatchIfEmpty();
+	}
 }
 
-void LeeThread::GetNewFinalDest ( float* pfFDX, float* pfFDY, float* pfFDZ )
+void LeeThread::EndAllWork ( void )
 {
-	*pfFDX = m_fFinalDestX;
-	*pfFDY = m_fFinalDestY;
-	*pfFDZ = m_fFinalDestZ;
+	// wait out a running batch, then wipe it
+	while ( m_bKeepRunning == true && m_bReadyToRun == false && m_iBatchState == LEETHREAD_WORKING )
+		Sleep(1);
+	m_Job_list.clear();
+	m_iBatchState = LEETHREAD_COLLECTING;
 }
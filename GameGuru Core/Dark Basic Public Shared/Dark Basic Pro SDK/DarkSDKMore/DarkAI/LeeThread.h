@@ -5,9 +5,30 @@
 #include "Path.h"
 #include "Container.h"
 #include "PathFinderAdvanced.h"
+#include <vector>
+#include <atomic>
 
 #define DEGTORAD 0.01745329252f
 
+// batch states, jobs are only added while collecting and results only read once complete
+#define LEETHREAD_COLLECTING	0
+#define LEETHREAD_WORKING		1
+#define LEETHREAD_COMPLETE		2
+
+// one AI waiting for a new path, and the path and final destination found for it
+struct sLeePathJob
+{
+	int iAIObj;
+	float fGetX;
+	float fGetZ;
+	float fFinalDestX;
+	float fFinalDestY;
+	float fFinalDestZ;
+	Container* pContainer;
+	int iDestContainer;
+	Path cNewPath;
+};
+
 class LeeThread : public Thread
 {
 
@@ -16,33 +37,31 @@ public:
 	LeeThread( );
 	~LeeThread( );
 	void SetupData ( void );
-	void BeginWork ( int iAIObj, float fX, float fZ, float fFDX, float fFDY, float fFDZ, Container* pContainer, int iDestContID );
+	bool BeginWork ( int iAIObj, float fX, float fZ, float fFDX, float fFDY, float fFDZ, Container* pContainer, int iDestContID );
+	void StartBatch ( void );
 	unsigned int Run( );
-	void EndWork ( void );
+	void EndWork ( int iAIObj );
+	void EndAllWork ( void );
 
 	void StopRunning ( void );
 	bool IsReadyToRun ( void );
 
-	int GetWorkInProgress ( void ) { return m_iAIBeingWorkedOn; }
-	int GetWorkComplete ( void ) { if ( m_iAIWorkComplete > 0 ) return 1; else return 0; }
-	Path GetNewPath ( void ) { return m_cNewPath; }
-	void GetNewFinalDest ( float* pfFDX, float* pfFDY, float* pfFDZ ); 
+	bool IsCollecting ( void ) { return m_iBatchState == LEETHREAD_COLLECTING; }
+	bool GetWorkInProgress ( int iAIObj ) { return FindJob ( iAIObj ) >= 0; }
+	bool GetWorkComplete ( int iAIObj ) { return m_iBatchState == LEETHREAD_COMPLETE && FindJob ( iAIObj ) >= 0; }
+	bool TakeResult ( int iAIObj, Path* pNewPath, float* pfFDX, float* pfFDY, float* pfFDZ );
 
 private:
 
-	// input data
-	int m_iAIBeingWorkedOn;
-	float m_fGetX;
-	float m_fGetZ;
-	float m_fFinalDestX;
-	float m_fFinalDestY;
-	float m_fFinalDestZ;
-	Container* m_pContainer;
-	int m_iDestContainer;
-
-	// output result
-	int m_iAIWorkComplete;
-	Path m_cNewPath;
+	int FindJob ( int iAIObj );
+	void SolveBatch ( void );
+	void FindReachableDest ( sLeePathJob* pJob );
+	void FinishBatchIfEmpty ( void );
+
+	// the batch, only touched by the worker while working
+	std::vector < sLeePathJob > m_Job_list;
+	std::atomic<int> m_iBatchState;
+	int m_iCompleteFrames;
 
 	// loop
 	bool m_bReadyToRun;
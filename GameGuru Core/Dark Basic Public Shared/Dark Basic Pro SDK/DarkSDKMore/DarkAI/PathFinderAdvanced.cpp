@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include <windows.h>
 #include "World.h"
+#include "cThreadPool.h"
+#include <atomic>
 
 extern "C" int GG_fopen_s( FILE** pFile, const char* filename, const char* mode );
 
@@ -651,6 +653,7 @@ void PathFinderAdvanced::MakeMemblockFromWaypoints ( int iMemblockID )
 void PathFinderAdvanced::MakeWaypointsFromMemblock ( int iMemblockID )
 {
 	ClearWaypoints ( );
+	bVisibilityCacheValid = false;
 
 #pragma warning ( disable : 4312 ) //conversion from 'DWORD' to 'int *' of greater size
 	int *pIData = (int*) GetMemblockPtr ( iMemblockID );
@@ -693,61 +696,255 @@ void PathFinderAdvanced::MakeWaypointsFromMemblock ( int iMemblockID )
 	}
 }
 
+// identifies a waypoint by everything the visibility test depends on, so a
+// cached edge is only reused if neither end has moved or changed its corner
+static unsigned long long WaypointVisibilityKey ( const PathFinderAdvanced::sWaypoint *pWaypoint )
+{
+	float fValues [ 5 ] = { pWaypoint->fX, pWaypoint->fY, pWaypoint->fVX, pWaypoint->fVY, pWaypoint->fCAngle };
+	unsigned long long iKey = 14695981039346656037ULL;
+	for ( int i = 0; i < 5; i++ )
+	{
+		unsigned int iBits;
+		memcpy ( &iBits, &fValues [ i ], sizeof(iBits) );
+		iKey = ( iKey ^ iBits ) * 1099511628211ULL;
+	}
+	return iKey;
+}
+
+void PathFinderAdvanced::MarkVisibilityDirty ( const sPolygonData &sPolygon )
+{
+	if ( sPolygon.sVertexData_list.empty ( ) ) return;
+
+	float fMinX = sPolygon.sVertexData_list [ 0 ].fX;
+	float fMinY = sPolygon.sVertexData_list [ 0 ].fY;
+	float fMaxX = fMinX;
+	float fMaxY = fMinY;
+	for ( int i = 1; i < (int) sPolygon.sVertexData_list.size ( ); i++ )
+	{
+		const sVertexData &v = sPolygon.sVertexData_list [ i ];
+		if ( v.fX < fMinX ) fMinX = v.fX;
+		if ( v.fY < fMinY ) fMinY = v.fY;
+		if ( v.fX > fMaxX ) fMaxX = v.fX;
+		if ( v.fY > fMaxY ) fMaxY = v.fY;
+	}
+
+	// waypoints sit just off the expanded corners
+	float fMargin = fCurrRadius + 0.01f;
+	fVisibilityDirty_list.push_back ( fMinX - fMargin );
+	fVisibilityDirty_list.push_back ( fMinY - fMargin );
+	fVisibilityDirty_list.push_back ( fMaxX + fMargin );
+	fVisibilityDirty_list.push_back ( fMaxY + fMargin );
+}
+
+bool PathFinderAdvanced::VisibilityDirty ( const std::vector<float> &fDirty_list, float fSX, float fSY, float fEX, float fEY )
+{
+	float fMinX = fSX < fEX ? fSX : fEX;
+	float fMaxX = fSX < fEX ? fEX : fSX;
+	float fMinY = fSY < fEY ? fSY : fEY;
+	float fMaxY = fSY < fEY ? fEY : fSY;
+
+	for ( int i = 0; i + 3 < (int) fDirty_list.size ( ); i += 4 )
+	{
+		if ( fMaxX < fDirty_list [ i ] || fMinX > fDirty_list [ i+2 ] ) continue;
+		if ( fMaxY < fDirty_list [ i+1 ] || fMinY > fDirty_list [ i+3 ] ) continue;
+		return true;
+	}
+
+	return false;
+}
+
+// builds edges between every pair of mutually visible waypoints. Waypoints are
+// bucketed into a grid of fLimit sized cells so only nearby pairs are considered,
+// each pair is tested once (the test is symmetric), and the polygon checks are
+// spread over the path worker threads. If the polygons have only changed locally
+// since the last build, edges between unchanged waypoints away from the change
+// are taken from the previous build instead of being tested again
 void PathFinderAdvanced::UpdateVisibility ( float fLimit )
 {	
+	vector < sWaypoint* > pWaypoint_list;
+	pWaypoint_list.reserve ( iNumWaypoints );
+	for ( sWaypoint *pWaypoint = pWaypointList; pWaypoint; pWaypoint = pWaypoint->pNextWaypoint )
+		pWaypoint_list.push_back ( pWaypoint );
+	int iCount = (int) pWaypoint_list.size ( );
+
+	// gather what the previous build found before the edges are cleared
+	bool bReuse = bVisibilityCacheValid && fVisibilityCacheLimit == fLimit;
+	vector < unsigned long long > iOldWaypoint_list;
+	vector < pair<unsigned long long,unsigned long long> > iOldEdge_list;
+	vector < float > fDirty_list;
+	if ( bReuse )
+	{
+		for ( int i = 0; i < (int) iVisibilityDirtyPolygon_list.size ( ); i++ )
+		{
+			for ( int j = 0; j < (int) sPolygonData_list.size ( ); j++ )
+			{
+				if ( sPolygonData_list [ j ].id != iVisibilityDirtyPolygon_list [ i ] ) continue;
+				MarkVisibilityDirty ( sPolygonData_list [ j ] );
+			}
+		}
+		fDirty_list = fVisibilityDirty_list;
+
+		for ( int i = 0; i < iCount; i++ )
+		{
+			// bridges get their edges from ConnectContainers, never reuse them
+			if ( pWaypoint_list [ i ]->bFlags & DARKAI_WAYPOINT_BRIDGE ) continue;
+			unsigned long long iKey = WaypointVisibilityKey ( pWaypoint_list [ i ] );
+			iOldWaypoint_list.push_back ( iKey );
+			for ( sWaypointEdge *pEdge = pWaypoint_list [ i ]->pEdgeList; pEdge; pEdge = pEdge->pNextEdge )
+			{
+				if ( !pEdge->pOtherWP || ( pEdge->pOtherWP->bFlags & DARKAI_WAYPOINT_BRIDGE ) ) continue;
+				unsigned long long iOtherKey = WaypointVisibilityKey ( pEdge->pOtherWP );
+				if ( iKey < iOtherKey ) iOldEdge_list.push_back ( make_pair ( iKey, iOtherKey ) );
+			}
+		}
+		sort ( iOldWaypoint_list.begin ( ), iOldWaypoint_list.end ( ) );
+		sort ( iOldEdge_list.begin ( ), iOldEdge_list.end ( ) );
+	}
+
 	RemoveAllEdges ( );
-	
-	sWaypoint *pWaypoint = pWaypointList;
-    sWaypoint *pWaypoint2;
-    
-	while ( pWaypoint )
-    {
-		pWaypoint->pEdgeList = 0;
-        
-        pWaypoint2 = pWaypointList;
-        
-        while ( pWaypoint2 )
-        {
-			if ( pWaypoint != pWaypoint2 )
+
+	// uniform grid over the waypoints, a single cell when there is no limit
+	float fMinX = 0, fMinY = 0, fMaxX = 0, fMaxY = 0;
+	for ( int i = 0; i < iCount; i++ )
+	{
+		float fX = pWaypoint_list [ i ]->fX;
+		float fY = pWaypoint_list [ i ]->fY;
+		if ( i == 0 || fX < fMinX ) fMinX = fX;
+		if ( i == 0 || fY < fMinY ) fMinY = fY;
+		if ( i == 0 || fX > fMaxX ) fMaxX = fX;
+		if ( i == 0 || fY > fMaxY ) fMaxY = fY;
+	}
+	float fCellSize = 1.0f;
+	int iGridW = 1, iGridH = 1;
+	if ( fLimit > 0 )
+	{
+		fCellSize = fLimit;
+		float fCellsX = ( fMaxX - fMinX ) / fCellSize + 1;
+		float fCellsY = ( fMaxY - fMinY ) / fCellSize + 1;
+		if ( fCellsX * fCellsY < 1048576.0f )
+		{
+			iGridW = (int) fCellsX;
+			iGridH = (int) fCellsY;
+		}
+	}
+	vector < int > iCellStart ( iGridW*iGridH + 1, 0 );
+	vector < int > iCellWaypoint ( iCount );
+	vector < int > iWaypointCell ( iCount );
+	for ( int i = 0; i < iCount; i++ )
+	{
+		int iCellX = 0, iCellY = 0;
+		if ( iGridW > 1 || iGridH > 1 )
+		{
+			iCellX = (int) ( ( pWaypoint_list [ i ]->fX - fMinX ) / fCellSize );
+			iCellY = (int) ( ( pWaypoint_list [ i ]->fY - fMinY ) / fCellSize );
+			if ( iCellX >= iGridW ) iCellX = iGridW - 1;
+			if ( iCellY >= iGridH ) iCellY = iGridH - 1;
+		}
+		iWaypointCell [ i ] = iCellY*iGridW + iCellX;
+		iCellStart [ iWaypointCell [ i ] + 1 ]++;
+	}
+	for ( int c = 0; c < iGridW*iGridH; c++ ) iCellStart [ c+1 ] += iCellStart [ c ];
+	{
+		vector < int > iFill ( iCellStart.begin ( ), iCellStart.end ( ) - 1 );
+		for ( int i = 0; i < iCount; i++ ) iCellWaypoint [ iFill [ iWaypointCell [ i ] ]++ ] = i;
+	}
+
+	// each row holds the visible waypoints with a higher index than the row waypoint
+	vector < vector < pair<int,float> > > sVisible_list ( iCount );
+	std::atomic<int> iNextRow ( 0 );
+
+	auto fnTestRows = [&] ( )
+	{
+		int i;
+		while ( ( i = iNextRow++ ) < iCount )
+		{
+			sWaypoint *pWaypoint = pWaypoint_list [ i ];
+			unsigned long long iKey = 0;
+			bool bKnown = false;
+			if ( bReuse && !( pWaypoint->bFlags & DARKAI_WAYPOINT_BRIDGE ) )
 			{
-				float fX = pWaypoint->fX;
-				float fY = pWaypoint->fY;
-				float fX2 = pWaypoint2->fX;
-				float fY2 = pWaypoint2->fY;
-
-				float fDiffX = fX2 - fX;
-				float fDiffY = fY2 - fY;
-				float fLength = fDiffX*fDiffX + fDiffY*fDiffY;
-				if ( fLength > 0.000001 )
+				iKey = WaypointVisibilityKey ( pWaypoint );
+				bKnown = binary_search ( iOldWaypoint_list.begin ( ), iOldWaypoint_list.end ( ), iKey );
+			}
+
+			int iCellX = iWaypointCell [ i ] % iGridW;
+			int iCellY = iWaypointCell [ i ] / iGridW;
+			for ( int iNY = iCellY - 1; iNY <= iCellY + 1; iNY++ )
+			{
+				if ( iNY < 0 || iNY >= iGridH ) continue;
+				for ( int iNX = iCellX - 1; iNX <= iCellX + 1; iNX++ )
 				{
-					if ( !QuickPolygonsCheck ( pWaypoint->fX, pWaypoint->fY, pWaypoint2->fX, pWaypoint2->fY, 2 ) )
+					if ( iNX < 0 || iNX >= iGridW ) continue;
+					int iCell = iNY*iGridW + iNX;
+					for ( int k = iCellStart [ iCell ]; k < iCellStart [ iCell+1 ]; k++ )
 					{
-						//check the extensions for walls
+						int j = iCellWaypoint [ k ];
+						if ( j <= i ) continue;
+						sWaypoint *pWaypoint2 = pWaypoint_list [ j ];
+
+						float fDiffX = pWaypoint2->fX - pWaypoint->fX;
+						float fDiffY = pWaypoint2->fY - pWaypoint->fY;
+						float fLength = fDiffX*fDiffX + fDiffY*fDiffY;
+						if ( fLength <= 0.000001 ) continue;
+						float fDist = ActualDistance ( pWaypoint->fX, pWaypoint->fY, pWaypoint2->fX, pWaypoint2->fY );
+						if ( fLimit >= 0 && fDist >= fLimit ) continue;
+
+						// check the extensions for walls
 						fLength = sqrt(fLength);
 						float fNX = fDiffX / fLength;
 						float fNY = fDiffY / fLength;
-
 						bool bValid = (fNX*pWaypoint2->fVX + fNY*pWaypoint2->fVY) < pWaypoint2->fCAngle;
 						bValid = bValid && ((-fNX)*pWaypoint->fVX + (-fNY)*pWaypoint->fVY) < pWaypoint->fCAngle;
+						if ( !bValid ) continue;
 
-						//if ( !QuickPolygonsCheck ( fX, fY, fNewX, fNewY, 2 ) || !QuickPolygonsCheck ( fX2, fY2, fNewX2, fNewY2, 2 ) )
-						if ( bValid )
+						bool bVisible = false;
+						bool bCached = false;
+						if ( bKnown && !( pWaypoint2->bFlags & DARKAI_WAYPOINT_BRIDGE )
+						  && !VisibilityDirty ( fDirty_list, pWaypoint->fX, pWaypoint->fY, pWaypoint2->fX, pWaypoint2->fY ) )
 						{
-							float fDist = ActualDistance ( pWaypoint->fX, pWaypoint->fY, pWaypoint2->fX, pWaypoint2->fY );
-							if ( fLimit < 0 || fDist < fLimit ) 
+							unsigned long long iKey2 = WaypointVisibilityKey ( pWaypoint2 );
+							if ( binary_search ( iOldWaypoint_list.begin ( ), iOldWaypoint_list.end ( ), iKey2 ) )
 							{
-								pWaypoint->AddEdge ( pWaypoint2, fDist );
+								pair<unsigned long long,unsigned long long> sEdgeKey = iKey < iKey2 ? make_pair ( iKey, iKey2 ) : make_pair ( iKey2, iKey );
+								bVisible = binary_search ( iOldEdge_list.begin ( ), iOldEdge_list.end ( ), sEdgeKey );
+								bCached = true;
 							}
 						}
+						if ( !bCached ) bVisible = !QuickPolygonsCheck ( pWaypoint->fX, pWaypoint->fY, pWaypoint2->fX, pWaypoint2->fY, 2 );
+
+						if ( bVisible ) sVisible_list [ i ].push_back ( make_pair ( j, fDist ) );
 					}
 				}
 			}
+		}
+	};
 
-			pWaypoint2 = pWaypoint2->pNextWaypoint;
-        }
-        
-		pWaypoint = pWaypoint->pNextWaypoint;
-    }
+	int iNumTasks = cWorld.GetPathThreadCount ( );
+	if ( iCount < 64 || iNumTasks < 2 )
+	{
+		fnTestRows ( );
+	}
+	else
+	{
+		cThreadPool *pPool = cWorld.GetPathThreadPool ( );
+		pPool->parallel_for ( 0, iNumTasks, 1, [&fnTestRows] ( int ) { fnTestRows ( ); } );
+	}
+
+	for ( int i = 0; i < iCount; i++ )
+	{
+		for ( int k = 0; k < (int) sVisible_list [ i ].size ( ); k++ )
+		{
+			sWaypoint *pWaypoint2 = pWaypoint_list [ sVisible_list [ i ] [ k ].first ];
+			float fDist = sVisible_list [ i ] [ k ].second;
+			pWaypoint_list [ i ]->AddEdge ( pWaypoint2, fDist );
+			pWaypoint2->AddEdge ( pWaypoint_list [ i ], fDist );
+		}
+	}
+
+	bVisibilityCacheValid = true;
+	fVisibilityCacheLimit = fLimit;
+	iVisibilityDirtyPolygon_list.clear ( );
+	fVisibilityDirty_list.clear ( );
 }
 
 void PathFinderAdvanced::UpdateSingleVisibility ( PathFinderAdvanced::sWaypoint *pNewWP, float fLimit, bool duplex )
@@ -832,6 +1029,9 @@ PathFinderAdvanced::PathFinderAdvanced ( Container *pContainer )
 
 	pAllDoors = 0;
 
+	bVisibilityCacheValid = false;
+	fVisibilityCacheLimit = -1;
+
 	pCoverPointList = 0;
 }
 
@@ -1451,6 +1651,10 @@ void PathFinderAdvanced::ClearPolygons ( )
     sPolygonData_list.clear ( );
 	sPolygonOrigData_list.clear ( );
 	sViewBlockingData_list.clear ( );
+
+	bVisibilityCacheValid = false;
+	iVisibilityDirtyPolygon_list.clear ( );
+	fVisibilityDirty_list.clear ( );
 }
 
 void PathFinderAdvanced::SaveObstacleData( char *pFilename )
@@ -1623,6 +1827,9 @@ void PathFinderAdvanced::LoadObstacleData( char *pFilename )
 		return;
 	}
 
+	// loaded edges were not built by UpdateVisibility
+	bVisibilityCacheValid = false;
+
 	// go through all polygons stored
 	int iNumPolys;
 	fread( &iNumPolys, sizeof(int), 1, pFile );
@@ -1966,6 +2173,7 @@ void PathFinderAdvanced::AddPolygon ( Polygon2D *const pPolygon, bool bUpdate )
 
 	sPolygonOrigData_list.push_back ( sNewPolygon );	//original data
 	sPolygonData_list.push_back ( sNewPolygon );
+	iVisibilityDirtyPolygon_list.push_back ( sNewPolygon.id );
 	
 	//if ( fCurrRadius > 0 && bUpdate ) SetRadius ( fCurrRadius );
 }
@@ -2030,6 +2238,7 @@ void PathFinderAdvanced::SetRadius ( float fRadius )
         }
     }
 
+	if ( fCurrRadius != fRadius ) bVisibilityCacheValid = false;
 	fCurrRadius = fRadius;
 	SetGridRadius( fRadius * 2.5f );
 	//SetGridRadius( 100.0f );
@@ -2046,6 +2255,7 @@ void PathFinderAdvanced::RemovePolygon ( int id )
 		if ( sPolygonData_list [ i ].id == id )
 		{
 			if ( sPolygonData_list [ i ].bBlocksPath ) bRebuild = true;
+			MarkVisibilityDirty ( sPolygonData_list [ i ] );
 			sPolygonData_list.erase ( sPolygonData_list.begin( ) + i );
 			i--;
 		}
@@ -3205,6 +3415,287 @@ void PathFinderAdvanced::ClearDistanceData( )
     }
 }
 
+void PathSearchScratch::Begin( int iNumNodes )
+{
+	// ids N and N+1 are the start and end points of the query
+	int iSize = iNumNodes + 2;
+	if ( (int) iStamp.size ( ) < iSize )
+	{
+		fDistG.resize ( iSize );
+		iParent.resize ( iSize );
+		iStamp.resize ( iSize, 0 );
+		iState.resize ( iSize );
+		fGoalCost.resize ( iSize );
+		pNode.resize ( iSize );
+	}
+
+	iCurrentStamp++;
+	if ( iCurrentStamp == 0 )
+	{
+		// wrapped, old stamps could now look valid
+		std::fill ( iStamp.begin ( ), iStamp.end ( ), 0 );
+		iCurrentStamp = 1;
+	}
+
+	sOpen_list.clear ( );
+	sStartEdge_list.clear ( );
+}
+
+void PathSearchScratch::Touch( int iID )
+{
+	if ( iStamp [ iID ] == iCurrentStamp ) return;
+
+	iStamp [ iID ] = iCurrentStamp;
+	iState [ iID ] = 0;
+	fDistG [ iID ] = 0;
+	iParent [ iID ] = -1;
+	fGoalCost [ iID ] = -1;
+	pNode [ iID ] = 0;
+}
+
+int PathFinderAdvanced::IndexWaypoints ( int iFirstID )
+{
+	sWaypoint *pWaypoint = pWaypointList;
+
+	while ( pWaypoint )
+	{
+		pWaypoint->iID = iFirstID++;
+		pWaypoint = pWaypoint->pNextWaypoint;
+	}
+
+	return iFirstID;
+}
+
+void PathFinderAdvanced::LockPathFinding ( )
+{
+	if ( !hPathFindingMutex ) return;
+
+	WaitForSingleObject( hPathFindingMutex, INFINITE );
+}
+
+void PathFinderAdvanced::UnlockPathFinding ( )
+{
+	if ( !hPathFindingMutex ) return;
+
+	ReleaseMutex( hPathFindingMutex );
+}
+
+//same result as CalculatePath + ShortestPath but only reads the waypoint graph,
+//so any number of these can run at once as long as each has its own scratch.
+//the start and end points are not added to the graph, instead the start edges
+//and the edges into the end point are kept in the scratch
+bool PathFinderAdvanced::SolvePathQuery ( sPathQuery *pQuery, PathFinderAdvanced *pDestPathFinder, PathSearchScratch *pScratch, int iNumNodes )
+{
+	if ( !pQuery || !pQuery->pResult || !pScratch ) return false;
+	if ( !pDestPathFinder ) pDestPathFinder = this;
+
+	Path *pFinalPath = pQuery->pResult;
+	float fSX = pQuery->fSX;
+	float fSY = pQuery->fSY;
+	float fEX = pQuery->fEX;
+	float fEY = pQuery->fEY;
+	float fMaxEdgeCost = pQuery->fMaxEdgeCost;
+	int iDestinationContainer = pDestPathFinder->pOwner->GetID( );
+
+	FindClosestOutsidePoint ( &fSX, &fSY );
+	pDestPathFinder->FindClosestOutsidePoint ( &fEX, &fEY );
+
+	if ( pDestPathFinder == this && !QuickPolygonsCheck ( fSX, fSY, fEX, fEY, 2 ) && !BlockedByDoor(fSX, fSY, fEX, fEY) )
+	{
+		if ( fMaxEdgeCost < 0 || (fSX-fEX)*(fSX-fEX) + (fSY-fEY)*(fSY-fEY) < fMaxEdgeCost*fMaxEdgeCost )
+		{
+			pFinalPath->AddPoint( fSX, 0, fSY );
+			pFinalPath->AddPoint( fEX, 0, fEY );
+			return true;
+		}
+	}
+
+	if ( !pWaypointList || !pDestPathFinder->pWaypointList ) return false;
+
+	const int iStartID = iNumNodes;
+	const int iEndID = iNumNodes + 1;
+
+	pScratch->Begin ( iNumNodes );
+
+	// edges out of the start point (UpdateSingleVisibility, not duplex)
+	sWaypoint *pWaypoint = pWaypointList;
+	while ( pWaypoint )
+	{
+		if ( pWaypoint->iID >= 0 && pWaypoint->iID < iNumNodes && !QuickPolygonsCheck ( pWaypoint->fX, pWaypoint->fY, fSX, fSY, 2 ) )
+		{
+			float fDist = ActualDistance ( pWaypoint->fX, pWaypoint->fY, fSX, fSY );
+			if ( ( fMaxEdgeCost < 0 || fDist < fMaxEdgeCost ) && !BlockedByDoor( pWaypoint->fX, pWaypoint->fY, fSX, fSY ) )
+			{
+				PathSearchScratch::sStartEdge sEdge;
+				sEdge.pWP = pWaypoint;
+				sEdge.fCost = fDist;
+				pScratch->sStartEdge_list.push_back ( sEdge );
+			}
+		}
+		pWaypoint = pWaypoint->pNextWaypoint;
+	}
+
+	// edges into the end point, looked up when each waypoint is expanded
+	pWaypoint = pDestPathFinder->pWaypointList;
+	while ( pWaypoint )
+	{
+		if ( pWaypoint->iID >= 0 && pWaypoint->iID < iNumNodes && !pDestPathFinder->QuickPolygonsCheck ( pWaypoint->fX, pWaypoint->fY, fEX, fEY, 2 ) )
+		{
+			float fDist = ActualDistance ( pWaypoint->fX, pWaypoint->fY, fEX, fEY );
+			if ( ( fMaxEdgeCost < 0 || fDist < fMaxEdgeCost ) && !pDestPathFinder->BlockedByDoor( pWaypoint->fX, pWaypoint->fY, fEX, fEY ) )
+			{
+				pScratch->Touch ( pWaypoint->iID );
+				pScratch->fGoalCost [ pWaypoint->iID ] = fDist;
+			}
+		}
+		pWaypoint = pWaypoint->pNextWaypoint;
+	}
+
+	pScratch->Touch ( iStartID );
+	pScratch->Touch ( iEndID );
+	pScratch->iState [ iStartID ] = 1;
+	pScratch->iParent [ iStartID ] = iStartID;
+
+	PathSearchScratch::sOpenNode sStartNode;
+	sStartNode.iID = iStartID;
+	sStartNode.fCost = EstimateDistance ( fSX, fSY, fEX, fEY );
+	pScratch->sOpen_list.push_back ( sStartNode );
+
+	std::vector<PathSearchScratch::sOpenNode> &sOpen_list = pScratch->sOpen_list;
+	int iFoundID = -1;
+
+	while ( !sOpen_list.empty ( ) )
+	{
+		PathSearchScratch::sOpenNode sCurrent = sOpen_list.front ( );
+		pop_heap ( sOpen_list.begin ( ), sOpen_list.end ( ) );
+		sOpen_list.pop_back ( );
+
+		int iID = sCurrent.iID;
+		if ( pScratch->iState [ iID ] == 2 ) continue; // already expanded via a cheaper entry
+
+		if ( iID == iEndID )
+		{
+			iFoundID = iID;
+			break;
+		}
+
+		pWaypoint = ( iID == iStartID ) ? 0 : pScratch->pNode [ iID ];
+		if ( pWaypoint && pWaypoint->pContainer->GetID( ) == iDestinationContainer
+		  && EstimateDistance ( pWaypoint->fX, pWaypoint->fY, fEX, fEY ) < 1 )
+		{
+			iFoundID = iID;
+			break;
+		}
+
+		pScratch->iState [ iID ] = 2;
+		float fDistG = pScratch->fDistG [ iID ];
+
+		if ( iID == iStartID )
+		{
+			for ( int i = 0; i < (int) pScratch->sStartEdge_list.size ( ); i++ )
+			{
+				sWaypoint *pNextWP = pScratch->sStartEdge_list [ i ].pWP;
+				int iNextID = pNextWP->iID;
+				pScratch->Touch ( iNextID );
+				pScratch->pNode [ iNextID ] = pNextWP;
+				if ( pScratch->iState [ iNextID ] == 2 ) continue;
+
+				float fNewG = fDistG + pScratch->sStartEdge_list [ i ].fCost + pNextWP->fWPCost;
+				if ( pScratch->iState [ iNextID ] == 0 || fNewG < pScratch->fDistG [ iNextID ] )
+				{
+					pScratch->iState [ iNextID ] = 1;
+					pScratch->fDistG [ iNextID ] = fNewG;
+					pScratch->iParent [ iNextID ] = iID;
+
+					PathSearchScratch::sOpenNode sNode;
+					sNode.iID = iNextID;
+					sNode.fCost = fNewG + EstimateDistance ( pNextWP->fX, pNextWP->fY, fEX, fEY );
+					sOpen_list.push_back ( sNode );
+					push_heap ( sOpen_list.begin ( ), sOpen_list.end ( ) );
+				}
+			}
+			continue;
+		}
+
+		sWaypointEdge *pEdge = pWaypoint->pEdgeList;
+		while ( pEdge )
+		{
+			sWaypoint *pNextWP = pEdge->pOtherWP;
+
+			// edges blocked by a door are skipped, same as ShortestPath
+			if ( !pNextWP || pEdge->pDoors || pNextWP->iID < 0 || pNextWP->iID >= iNumNodes )
+			{
+				pEdge = pEdge->pNextEdge;
+				continue;
+			}
+
+			int iNextID = pNextWP->iID;
+			pScratch->Touch ( iNextID );
+			pScratch->pNode [ iNextID ] = pNextWP;
+
+			if ( pScratch->iState [ iNextID ] != 2 )
+			{
+				float fNewG = fDistG + pEdge->fCost + pNextWP->fWPCost;
+				if ( pScratch->iState [ iNextID ] == 0 || fNewG < pScratch->fDistG [ iNextID ] )
+				{
+					pScratch->iState [ iNextID ] = 1;
+					pScratch->fDistG [ iNextID ] = fNewG;
+					pScratch->iParent [ iNextID ] = iID;
+
+					PathSearchScratch::sOpenNode sNode;
+					sNode.iID = iNextID;
+					sNode.fCost = fNewG + EstimateDistance ( pNextWP->fX, pNextWP->fY, fEX, fEY );
+					sOpen_list.push_back ( sNode );
+					push_heap ( sOpen_list.begin ( ), sOpen_list.end ( ) );
+				}
+			}
+
+			pEdge = pEdge->pNextEdge;
+		}
+
+		// this waypoint can see the end point
+		float fGoalCost = pScratch->fGoalCost [ iID ];
+		if ( fGoalCost >= 0 && pScratch->iState [ iEndID ] != 2 )
+		{
+			float fNewG = fDistG + fGoalCost;
+			if ( pScratch->iState [ iEndID ] == 0 || fNewG < pScratch->fDistG [ iEndID ] )
+			{
+				pScratch->iState [ iEndID ] = 1;
+				pScratch->fDistG [ iEndID ] = fNewG;
+				pScratch->iParent [ iEndID ] = iID;
+
+				PathSearchScratch::sOpenNode sNode;
+				sNode.iID = iEndID;
+				sNode.fCost = fNewG;
+				sOpen_list.push_back ( sNode );
+				push_heap ( sOpen_list.begin ( ), sOpen_list.end ( ) );
+			}
+		}
+	}
+
+	sOpen_list.clear ( );
+
+	if ( iFoundID < 0 ) return false;
+
+	// walk back to the start point
+	int iID = iFoundID;
+	while ( true )
+	{
+		if ( iID == iEndID ) pFinalPath->InsertPoint ( 0, fEX, fEY, iDestinationContainer );
+		else if ( iID == iStartID ) pFinalPath->InsertPoint ( 0, fSX, fSY, pOwner->GetID( ) );
+		else
+		{
+			sWaypoint *pPathWP = pScratch->pNode [ iID ];
+			pFinalPath->InsertPoint ( 0, pPathWP->fX, pPathWP->fY, pPathWP->pContainer->GetID( ) );
+		}
+
+		if ( iID == iStartID ) break;
+		iID = pScratch->iParent [ iID ];
+	}
+
+	return true;
+}
+
 void PathFinderAdvanced::SearchCoverPoints ( float fSX, float fSY, float fTX, float fTY, Path *pPoints )
 {
 	sCoverPoint *pCoverPoint = pCoverPointList;
@@ -3889,58 +4380,50 @@ void PathFinderAdvanced::DebugUpdateAvoidanceGrid( float fTimeDelta )
 		int iLimb = 1;
 		float length = sqrt( 2*fGridRadius*fGridRadius );
 
-		for( int i = 0; i < 100; i++ )
-		{
-			for( int j = 0; j < 100; j++ )
-			{
-				GridElement *pElement = cGrid.GetRootElement( i,j );
-
-				while ( pElement )
-				{
-					if ( pElement->GetValue() > 0 )
-					{
-						AddLimb ( iGridObject2, iLimb, iTempMesh );
-						OffsetLimb ( iGridObject2, iLimb, GridItoF(pElement->GetX()), 0.0f, GridItoF(pElement->GetZ()) );
+		int x, z, value, reserved;
 
-						iLimb++;
-					}
+		for( int i = 0; i < cGrid.GetNumSlots(); i++ )
+		{
+			if ( !cGrid.GetSlot( i, &x, &z, &value, &reserved ) ) continue;
 
-					if ( pElement->GetReserved() > 0 )
-					{
-						AddLimb ( iGridObject2, iLimb, iTempMesh );
-						ScaleLimb ( iGridObject2, iLimb, 50.0f, 50.0f, 50.0f );
-						RotateLimb ( iGridObject2, iLimb, 0.0f, 45.0f, 0.0f );
-						OffsetLimb ( iGridObject2, iLimb, GridItoF(pElement->GetX()), 0.0f, GridItoF(pElement->GetZ()) );
+			if ( value > 0 )
+			{
+				AddLimb ( iGridObject2, iLimb, iTempMesh );
+				OffsetLimb ( iGridObject2, iLimb, GridItoF(x), 0.0f, GridItoF(z) );
 
-						iLimb++;
-					}
+				iLimb++;
+			}
 
-					pElement = pElement->pNextElement;
-				}
+			if ( reserved > 0 )
+			{
+				AddLimb ( iGridObject2, iLimb, iTempMesh );
+				ScaleLimb ( iGridObject2, iLimb, 50.0f, 50.0f, 50.0f );
+				RotateLimb ( iGridObject2, iLimb, 0.0f, 45.0f, 0.0f );
+				OffsetLimb ( iGridObject2, iLimb, GridItoF(x), 0.0f, GridItoF(z) );
 
-				GridElement *pUElement = cUndesirableGrid.GetRootElement( i,j );
+				iLimb++;
+			}
+		}
 
-				while ( pUElement )
-				{
-					if ( pUElement->GetValue() > 0 )
-					{
-						AddLimb ( iGridObject2, iLimb, iTempMesh2 );
-						ScaleLimb ( iGridObject2, iLimb, 100.0f, 100.0f, length * 100.0f );
-						RotateLimb ( iGridObject2, iLimb, 0.0f, 45.0f, 0.0f );
-						OffsetLimb ( iGridObject2, iLimb, GridItoF(pUElement->GetX()), 0.0f, GridItoF(pUElement->GetZ()) );
+		for( int i = 0; i < cUndesirableGrid.GetNumSlots(); i++ )
+		{
+			if ( !cUndesirableGrid.GetSlot( i, &x, &z, &value, NULL ) ) continue;
 
-						iLimb++;
+			if ( value > 0 )
+			{
+				AddLimb ( iGridObject2, iLimb, iTempMesh2 );
+				ScaleLimb ( iGridObject2, iLimb, 100.0f, 100.0f, length * 100.0f );
+				RotateLimb ( iGridObject2, iLimb, 0.0f, 45.0f, 0.0f );
+				OffsetLimb ( iGridObject2, iLimb, GridItoF(x), 0.0f, GridItoF(z) );
 
-						AddLimb ( iGridObject2, iLimb, iTempMesh2 );
-						ScaleLimb ( iGridObject2, iLimb, 100.0f, 100.0f, length * 100.0f );
-						RotateLimb ( iGridObject2, iLimb, 0.0f, 135.0f, 0.0f );
-						OffsetLimb ( iGridObject2, iLimb, GridItoF(pUElement->GetX()), 0.0f, GridItoF(pUElement->GetZ()) );
+				iLimb++;
 
-						iLimb++;
-					}
+				AddLimb ( iGridObject2, iLimb, iTempMesh2 );
+				ScaleLimb ( iGridObject2, iLimb, 100.0f, 100.0f, length * 100.0f );
+				RotateLimb ( iGridObject2, iLimb, 0.0f, 135.0f, 0.0f );
+				OffsetLimb ( iGridObject2, iLimb, GridItoF(x), 0.0f, GridItoF(z) );
 
-					pUElement = pUElement->pNextElement;
-				}
+				iLimb++;
 			}
 		}
 
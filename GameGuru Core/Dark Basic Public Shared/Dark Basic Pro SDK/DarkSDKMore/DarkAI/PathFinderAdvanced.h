@@ -96,6 +96,22 @@ struct sCoverPoint
 	float GetLeapDistance() { return fLeapDist; }
 };
 
+//one request for the batched path solver, see World::CalculatePathBatch
+struct sPathQuery
+{
+	float fSX, fSY;
+	float fEX, fEY;
+	int iContainer;
+	int iDestContainer;		//-1 = same as iContainer
+	float fMaxEdgeCost;
+	Path *pResult;			//must be defined, assumed clear
+	bool bFound;
+
+	sPathQuery() { fSX = 0; fSY = 0; fEX = 0; fEY = 0; iContainer = 0; iDestContainer = -1; fMaxEdgeCost = -1; pResult = 0; bFound = false; }
+};
+
+class PathSearchScratch;
+
 //contains all processes relating to working out the path
 //can be replaced as long as CalculatePath() exists
 class PathFinderAdvanced
@@ -211,6 +227,8 @@ public:
 
 		Container* pContainer;
 		bool bIsBridge;
+
+		int iID; // dense index assigned by IndexWaypoints, used by PathSearchScratch
         
         int iVisited;
         sWaypoint *pParent;
@@ -223,7 +241,7 @@ public:
 		void RemoveEdge ( sWaypoint *pWaypoint );
 		void ClearEdges ( );
 		
-		sWaypoint ( ) { pEdgeList = 0; iNumEdges = 0; fWPCost = 0; pContainer = 0; bIsBridge = false; bCanPeek = false; fVX = 0; fVY = 0; fCAngle = 0; bFlags = 0; }
+		sWaypoint ( ) { iID = -1; pEdgeList = 0; iNumEdges = 0; fWPCost = 0; pContainer = 0; bIsBridge = false; bCanPeek = false; fVX = 0; fVY = 0; fCAngle = 0; bFlags = 0; }
 		~sWaypoint ( );
 
 		bool operator ==(sWaypoint w) const {
@@ -276,6 +294,16 @@ private:
 	float fAvoidanceGridDebugTimer;
 	float fAvoidanceGridHeight;
 
+	// UpdateVisibility reuses the previous edges for waypoints that have not changed
+	// and whose connecting line does not cross a polygon added or removed since
+	bool bVisibilityCacheValid;
+	float fVisibilityCacheLimit;
+	std::vector<int> iVisibilityDirtyPolygon_list;	// ids added since the last build
+	std::vector<float> fVisibilityDirty_list;		// minx,miny,maxx,maxy of removed polygons
+
+	void MarkVisibilityDirty ( const sPolygonData &sPolygon );
+	bool VisibilityDirty ( const std::vector<float> &fDirty_list, float fSX, float fSY, float fEX, float fEY );
+
 	Blocker *pBlockerList;
   
   public:  
@@ -407,6 +435,17 @@ private:
     
     //uses A* on the waypoints to find the shortest path
     bool ShortestPath ( float fEX, float fEY, Path* pBuildPath, int iDestinationContainer );
+
+	//gives every waypoint a dense id starting at iFirstID, returns the next free id
+	int IndexWaypoints ( int iFirstID );
+
+	//re-entrant version of CalculatePath, all search state lives in pScratch.
+	//waypoints must have been indexed (iNumNodes ids) and the graph must not
+	//change while queries are running, see World::CalculatePathBatch
+	bool SolvePathQuery ( sPathQuery *pQuery, PathFinderAdvanced *pDestPathFinder, PathSearchScratch *pScratch, int iNumNodes );
+
+	static void LockPathFinding ( );
+	static void UnlockPathFinding ( );
     
     //The main function. Polygon list must have been passed sometime before  
     //paths pFinalPath must be defined, assumed clear.
@@ -443,4 +482,45 @@ private:
 	void DebugUpdateAvoidanceGrid( float fTimeDelta );
 };
 
+//A* bookkeeping for one query at a time, indexed by sWaypoint::iID so the
+//waypoint graph itself is never written during a search. One per worker,
+//reused between queries (the stamp avoids clearing the arrays each time)
+class PathSearchScratch
+{
+public:
+
+	struct sOpenNode
+	{
+		int iID;
+		float fCost;
+
+		bool operator<(const sOpenNode &o) const {
+			return fCost > o.fCost;
+		}
+	};
+
+	struct sStartEdge
+	{
+		PathFinderAdvanced::sWaypoint *pWP;
+		float fCost;
+	};
+
+	std::vector<float> fDistG;
+	std::vector<int> iParent;
+	std::vector<unsigned int> iStamp;		//node state is only valid when iStamp == iCurrentStamp
+	std::vector<unsigned char> iState;		//1 = open, 2 = closed
+	std::vector<float> fGoalCost;			//cost of the edge to the end point, <0 if not visible
+	std::vector<PathFinderAdvanced::sWaypoint*> pNode;	//waypoint for each id touched by this search
+	std::vector<sOpenNode> sOpen_list;
+	std::vector<sStartEdge> sStartEdge_list;
+	unsigned int iCurrentStamp;
+
+	PathSearchScratch() { iCurrentStamp = 0; }
+	~PathSearchScratch() { }
+
+	void Begin( int iNumNodes );
+	bool Touched( int iID ) const { return iStamp [ iID ] == iCurrentStamp; }
+	void Touch( int iID );
+};
+
 #endif
@@ -470,7 +470,7 @@ void Team::UpdateMemberMovement ( float fTimeDelta )
 			float fDX = pEntity->GetX() - fPlayerX;
 			float fDZ = pEntity->GetZ() - fPlayerZ;
 			float fPlrDist = fabs(fDX*fDX)+fabs(fDZ*fDZ); 
-			if ( fPlrDist < 3000.0f*3000.0f || pEntity->bAlwaysActive==true  || g_LeeThread.GetWorkInProgress() == pEntity->GetID() )
+			if ( fPlrDist < 3000.0f*3000.0f || pEntity->bAlwaysActive==true  || g_LeeThread.GetWorkInProgress( pEntity->GetID() ) == true )
 			{
 				// update entity movement logic
 				pEntity->UpdateMovement ( fTimeDelta );
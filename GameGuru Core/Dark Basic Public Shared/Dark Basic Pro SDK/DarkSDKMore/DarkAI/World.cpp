@@ -18,6 +18,7 @@
 #include "CollisionTree.h"
 #include "AIThread.h"
 #include "LeeThread.h"
+#include "cThreadPool.h"
 
 extern "C" FILE* GG_fopen( const char* filename, const char* mode );
 
@@ -29,6 +30,7 @@ extern float g_fShapeMidX;
 extern float g_fShapeMidZ;
 extern float g_fShapeRadius;
 extern int g_GUIShaderEffectID;
+extern cThreadPool* g_pThreadPool;
 
 FILE *pDebugFile;
 AIThread tAIThread;
@@ -36,6 +38,7 @@ AIThread tAIThread;
 // Global to host second thread to handle path finding perf hit
 bool g_bLeeThreadStarted = false;
 LeeThread g_LeeThread;
+extern float CurrentAIWorkedPathTimer;
 
 World::World ( )
 {
@@ -88,6 +91,9 @@ World::~World ( )
 	if ( pManualPolygon ) delete pManualPolygon;
 	if ( pContainerList ) delete pContainerList;
 
+	for ( int i = 0; i < (int) pPathScratch_list.size ( ); i++ ) delete pPathScratch_list [ i ];
+	pPathScratch_list.clear ( );
+
 	FreeConsole ( );
 }
 
@@ -107,7 +113,7 @@ int World::GetTotalPaths()
 void World::Reset ( )
 {
 	// ensure thread reset for next foray
-	g_LeeThread.EndWork();
+	g_LeeThread.EndAllWork();
 
 	pManualPolygon = 0;
 
@@ -1485,6 +1491,118 @@ int World::AddObstaclePath ( int iPathID, int iContainerID, float x, float z, fl
 	return 0;
 }
 
+// batch version of AddObstaclePath, pPoints holds x,z,x2,z2 for each path.
+// invalid or existing path IDs are skipped, returns the number of paths found
+int World::AddObstaclePaths ( int iCount, int *pPathIDs, int *pContainerIDs, float *pPoints, int *pDestContainers, float fMaxEdgeCost )
+{
+	if ( iCount <= 0 || !pPathIDs || !pContainerIDs || !pPoints ) return 0;
+
+	vector < sPathQuery > sQuery_list;
+	sQuery_list.reserve ( iCount );
+
+	for ( int i = 0; i < iCount; i++ )
+	{
+		int iPathID = pPathIDs [ i ];
+		if ( iPathID < 1 || iPathID >= iMaxPath ) continue;
+		if ( ppPathArray [ iPathID ] ) continue;
+		if ( !GetContainer ( pContainerIDs [ i ] ) ) continue;
+
+		ppPathArray [ iPathID ] = new Path( );
+
+		sPathQuery sQuery;
+		sQuery.fSX = pPoints [ i*4 + 0 ];
+		sQuery.fSY = pPoints [ i*4 + 1 ];
+		sQuery.fEX = pPoints [ i*4 + 2 ];
+		sQuery.fEY = pPoints [ i*4 + 3 ];
+		sQuery.iContainer = pContainerIDs [ i ];
+		sQuery.iDestContainer = pDestContainers ? pDestContainers [ i ] : -1;
+		sQuery.fMaxEdgeCost = fMaxEdgeCost;
+		sQuery.pResult = ppPathArray [ iPathID ];
+		sQuery_list.push_back ( sQuery );
+	}
+
+	if ( sQuery_list.empty ( ) ) return 0;
+
+	return CalculatePathBatch ( &sQuery_list [ 0 ], (int) sQuery_list.size ( ) );
+}
+
+// path work shares the engine thread pool rather than starting workers of its own
+cThreadPool* World::GetPathThreadPool ( )
+{
+	return g_pThreadPool;
+}
+
+// the thread waiting on a parallel_for helps, so it counts as one more
+int World::GetPathThreadCount ( )
+{
+	return g_pThreadPool ? (int) g_pThreadPool->size ( ) + 1 : 1;
+}
+
+int World::IndexAllWaypoints ( )
+{
+	int iNumNodes = 0;
+	Container *pContainer = pContainerList;
+
+	while ( pContainer )
+	{
+		iNumNodes = pContainer->pPathFinder->IndexWaypoints( iNumNodes );
+		pContainer = pContainer->pNextContainer;
+	}
+
+	return iNumNodes;
+}
+
+// solves many paths at once on the engine thread pool, each task owns a
+// PathSearchScratch so the waypoint graph is only read. Holds the path finding
+// mutex for the duration so CalculatePath cannot add its temporary waypoints.
+// returns the number of queries that found a path
+int World::CalculatePathBatch ( sPathQuery *pQueries, int iCount )
+{
+	if ( !pQueries || iCount <= 0 ) return 0;
+
+	cThreadPool *pPool = GetPathThreadPool ( );
+	int iNumTasks = GetPathThreadCount ( );
+	if ( iNumTasks > iCount ) iNumTasks = iCount;
+	while ( (int) pPathScratch_list.size ( ) < iNumTasks ) pPathScratch_list.push_back ( new PathSearchScratch ( ) );
+
+	PathFinderAdvanced::LockPathFinding ( );
+
+	int iNumNodes = IndexAllWaypoints ( );
+
+	// no destination means stay in the start container, same as AddObstaclePath
+	for ( int i = 0; i < iCount; i++ )
+	{
+		pQueries [ i ].bFound = false;
+		if ( pQueries [ i ].iDestContainer < 0 ) pQueries [ i ].iDestContainer = pQueries [ i ].iContainer;
+	}
+
+	auto fnSolveTask = [this, pQueries, iCount, iNumTasks, iNumNodes] ( int iTask )
+	{
+		PathSearchScratch *pScratch = pPathScratch_list [ iTask ];
+		for ( int i = iTask; i < iCount; i += iNumTasks )
+		{
+			sPathQuery *pQuery = &pQueries [ i ];
+			Container *pContainer = GetContainer ( pQuery->iContainer );
+			Container *pDestContainer = GetContainer ( pQuery->iDestContainer );
+			if ( !pContainer || !pDestContainer || !pQuery->pResult ) continue;
+
+			pQuery->bFound = pContainer->pPathFinder->SolvePathQuery ( pQuery, pDestContainer->pPathFinder, pScratch, iNumNodes );
+		}
+	};
+
+	if ( pPool && iNumTasks > 1 )
+		pPool->parallel_for ( 0, iNumTasks, 1, fnSolveTask );
+	else
+		fnSolveTask ( 0 );
+
+	PathFinderAdvanced::UnlockPathFinding ( );
+
+	int iFound = 0;
+	for ( int i = 0; i < iCount; i++ ) if ( pQueries [ i ].bFound ) iFound++;
+
+	return iFound;
+}
+
 Path* World::GetPath ( int iPathID )
 {
 	if ( iPathID < 1 || iPathID >= iMaxPath ) return 0;
@@ -1607,6 +1725,14 @@ void World::UpdateWorld ( )
 		pTeamController->Update ( fTimeDelta, pBeaconList, pZoneList );
 		CleanUpWorldBeacons ( fTimeDelta );
 	}
+
+	// hand the AI that asked for a path this cycle to the path thread as one batch
+	bool bWasCollecting = g_LeeThread.IsCollecting();
+	g_LeeThread.StartBatch();
+	if ( bWasCollecting == true && g_LeeThread.IsCollecting() == false )
+		CurrentAIWorkedPathTimer = 0.1f; // X second until next batch
+	else
+		CurrentAIWorkedPathTimer -= fTimeDelta;
 	/*else
 	{
 		tAIThread.Join( );
@@ -23,6 +23,10 @@ class PathFinderAdvanced;
 
 class CollisionObject;
 
+struct sPathQuery;
+class PathSearchScratch;
+class cThreadPool;
+
 struct tempCoverPoint
 {
 	float fx;
@@ -51,6 +55,11 @@ private:
 
 	CollisionObject *pVisibilityData;
 
+	// batched path finding, one scratch per worker task
+	vector < PathSearchScratch* > pPathScratch_list;
+
+	int IndexAllWaypoints ( );
+
 public:
 
 	void UpdateWorld ( );
@@ -137,6 +146,10 @@ public:
 	int MakePathFromMemblock ( int iPathID, int iMemblockID );
 	int MakeMemblockFromPath ( int iMemblockID, int iPathID );
 	int AddObstaclePath ( int iPathID, int iContainerID, float x, float z, float x2, float z2, float fMaxEdgeCost, int destContainer = -1 );
+	int AddObstaclePaths ( int iCount, int *pPathIDs, int *pContainerIDs, float *pPoints, int *pDestContainers, float fMaxEdgeCost );
+	int CalculatePathBatch ( sPathQuery *pQueries, int iCount );
+	cThreadPool* GetPathThreadPool ( );
+	int GetPathThreadCount ( );
 	Path* GetPath ( int iPathID );
 	int GetMaxPath ( );
 	int AssignEntityToPatrolPath ( Entity *pEntity, int iPathID );
@@ -10,6 +10,7 @@
 #include "DBProJoints.h"
 #include "DBProJointManager.h"
 #include "BT2DX.h"
+#include "SceneBVH.h"
 
 #include "CObjectsC.h"
 #include ".\..\..\Error\CError.h"
@@ -114,6 +115,7 @@ void DBProRagDoll::ResetObjectParametersForCulling()
 			pObject->collision.fScaledRadius = 0;//pMesh->Collision.fRadius;
 			pObject->collision.fScaledLargestRadius = 0;//->Collision.fRadius;
 			pObject->collision.bColCenterUpdated = true;
+			g_SceneBVH.markDirty ( pObject );
 		}
 	}
 	//FHB:Leave for debugging
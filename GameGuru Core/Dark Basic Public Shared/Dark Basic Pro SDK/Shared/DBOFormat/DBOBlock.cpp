@@ -23,6 +23,7 @@ bool			g_bWriteAsText				= false;
 LPSTR			g_pBlockEnd					= NULL;
 DWORD			g_dwVersion					= 0;
 LPSTR			g_pBlockStart				= NULL;
+sDBOMappedFile*	g_pBlockMappedFile			= NULL;
 
 bool ScanFrame      ( sFrame* pFrame, LPSTR* ppBlock, DWORD* pdwSize );
 bool ConstructFrame ( sFrame** ppFrame, LPSTR* ppBlock );
@@ -159,6 +160,23 @@ DARKSDK_DLL bool WriteCODE ( DWORD dwCode, DWORD dwCodeSize, LPSTR* ppBlock, DWO
 	return true;
 }
 
+DARKSDK_DLL bool WritePadding ( LPSTR* ppBlock, DWORD* pdwSize )
+{
+	// goes just before a data code so the data after its header starts on the payload
+	// boundary, *pdwSize is the offset from the start of the block in both passes
+	if ( g_bWriteAsText ) return true;
+	if ( ( *pdwSize + 8 ) % DBO_PAYLOAD_ALIGNMENT == 0 ) return true;
+	DWORD dwPadding = ( DBO_PAYLOAD_ALIGNMENT - ( *pdwSize + 16 ) % DBO_PAYLOAD_ALIGNMENT ) % DBO_PAYLOAD_ALIGNMENT;
+	WriteCODE ( DBOBLOCK_MESH_PADDING, dwPadding, ppBlock, pdwSize );
+	if ( ppBlock )
+	{
+		memset ( *ppBlock, 0, dwPadding );
+		*ppBlock += dwPadding;
+	}
+	*pdwSize += dwPadding;
+	return true;
+}
+
 DARKSDK_DLL bool WriteVECTOR ( GGVECTOR3 vecVector, LPSTR* ppBlock, DWORD* pdwSize )
 {
 	DWORD dwLen = sizeof(vecVector);
@@ -614,6 +632,25 @@ DARKSDK_DLL bool ReadIndexData ( WORD** pwIndexData, DWORD dwIndexCount, LPSTR*
 	return true;
 }
 
+DARKSDK_DLL bool ReadMappedData ( sMesh* pMesh, void** ppData, DWORD dwLength, LPSTR* ppBlock )
+{
+	// only when loading from a mapped file, and only data that is aligned and
+	// wholly inside it, otherwise the caller copies it as before
+	if ( g_pBlockMappedFile==NULL || dwLength==0 ) return false;
+	if ( ( (ULONG_PTR)*ppBlock & ( DBO_PAYLOAD_ALIGNMENT - 1 ) ) != 0 ) return false;
+	if ( *ppBlock + dwLength > g_pBlockEnd ) return false;
+	(*ppData) = (void*)*ppBlock;
+	*ppBlock += dwLength;
+
+	// one reference for each mesh pointing into the view
+	if ( pMesh->pMappedFile==NULL )
+	{
+		pMesh->pMappedFile = g_pBlockMappedFile;
+		InterlockedIncrement ( &g_pBlockMappedFile->lReferences );
+	}
+	return true;
+}
+
 DARKSDK_DLL bool ReadOffsetListData ( int** pwIndexData, DWORD dwIndexCount, LPSTR* ppBlock )
 {
 	DWORD dwLength = sizeof(int) * dwIndexCount;
@@ -866,6 +903,7 @@ DARKSDK_DLL bool ScanMesh ( sMesh* pMesh, LPSTR* ppBlock, DWORD* pdwSize )
 		}
 		
 		// Write vertex data
+		WritePadding ( ppBlock, pdwSize );
 		WriteCODE	( DBOBLOCK_MESH_VERTEXDATA,	pMesh->dwFVFSize*pMesh->dwVertexCount, ppBlock, pdwSize );
 		WriteVertexData ( pMesh->pVertexData, pMesh->dwFVFSize, pMesh->dwVertexCount, ppBlock, pdwSize );
 		WriteCR ( ppBlock, pdwSize );
@@ -873,6 +911,7 @@ DARKSDK_DLL bool ScanMesh ( sMesh* pMesh, LPSTR* ppBlock, DWORD* pdwSize )
 		// Write index data
 		if ( pMesh->dwIndexCount )
 		{
+			WritePadding ( ppBlock, pdwSize );
 			WriteCODE	( DBOBLOCK_MESH_INDEXDATA, pMesh->dwIndexCount*sizeof(WORD), ppBlock, pdwSize );
 			WriteIndices ( pMesh->pIndices, pMesh->dwIndexCount, ppBlock, pdwSize );
 			WriteCR ( ppBlock, pdwSize );
@@ -1603,12 +1642,18 @@ DARKSDK_DLL bool ConstructMesh ( sMesh** ppMesh, LPSTR* ppBlock )
 			
 			case DBOBLOCK_MESH_VERTEXDATA :		
 				
-				ReadVertexData ( &(*ppMesh)->pVertexData, (*ppMesh)->dwFVFSize, (*ppMesh)->dwVertexCount, ppBlock );	
+				if ( ReadMappedData ( *ppMesh, (void**)&(*ppMesh)->pVertexData, (*ppMesh)->dwFVFSize * (*ppMesh)->dwVertexCount, ppBlock ) )
+					(*ppMesh)->bVertexDataMapped = true;
+				else
+					ReadVertexData ( &(*ppMesh)->pVertexData, (*ppMesh)->dwFVFSize, (*ppMesh)->dwVertexCount, ppBlock );	
 				break;
 			
 			case DBOBLOCK_MESH_INDEXDATA :
 			{
-				ReadIndexData ( &(*ppMesh)->pIndices, (*ppMesh)->dwIndexCount, ppBlock );
+				if ( ReadMappedData ( *ppMesh, (void**)&(*ppMesh)->pIndices, sizeof(WORD) * (*ppMesh)->dwIndexCount, ppBlock ) )
+					(*ppMesh)->bIndexDataMapped = true;
+				else
+					ReadIndexData ( &(*ppMesh)->pIndices, (*ppMesh)->dwIndexCount, ppBlock );
 
 				if ( ( *ppMesh )->dwIndexCount == 0 )
 					*ppBlock += dwCodeSize;
@@ -2004,6 +2049,60 @@ DARKSDK_DLL bool DBOLoadBlockFile ( LPSTR pFilename, void** ppBlock, DWORD* pdwS
 	return true;
 }
 
+DARKSDK_DLL bool DBOMapBlockFile ( LPSTR pFilename, sDBOMappedFile** ppMappedFile )
+{
+	// map file copy-on-write, so meshes can still change their data in place
+	// and only the pages they touch become private
+	*ppMappedFile = NULL;
+	HANDLE hfile = GG_CreateFile ( pFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hfile == INVALID_HANDLE_VALUE )
+		return false;
+	DWORD dwSize = GetFileSize ( hfile, NULL );
+	HANDLE hMapping = NULL;
+	if ( dwSize > 0 && dwSize != INVALID_FILE_SIZE )
+		hMapping = CreateFileMapping ( hfile, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	CloseHandle ( hfile );
+	if ( hMapping == NULL )
+		return false;
+
+	// the view keeps the mapping and the file open until it is unmapped
+	LPSTR pView = (LPSTR)MapViewOfFile ( hMapping, FILE_MAP_COPY, 0, 0, 0 );
+	CloseHandle ( hMapping );
+	if ( pView == NULL )
+		return false;
+
+	// the caller holds the first reference
+	sDBOMappedFile* pMappedFile = new sDBOMappedFile;
+	pMappedFile->pView = pView;
+	pMappedFile->dwSize = dwSize;
+	pMappedFile->lReferences = 1;
+	*ppMappedFile = pMappedFile;
+
+	// okay
+	return true;
+}
+
+DARKSDK_DLL bool DBOConvertMappedFileToObject ( sDBOMappedFile* pMappedFile, sObject** ppObject )
+{
+	// meshes built while this is set point into the view where they can
+	g_pBlockMappedFile = pMappedFile;
+	bool bResult = DBOConvertBlockToObject ( (void*)pMappedFile->pView, pMappedFile->dwSize, ppObject );
+	g_pBlockMappedFile = NULL;
+	return bResult;
+}
+
+DARKSDK_DLL void DBOReleaseMappedFile ( sDBOMappedFile* pMappedFile )
+{
+	// unmapped with the last reference, meshes can be freed from any thread
+	if ( pMappedFile == NULL )
+		return;
+	if ( InterlockedDecrement ( &pMappedFile->lReferences ) == 0 )
+	{
+		UnmapViewOfFile ( pMappedFile->pView );
+		delete pMappedFile;
+	}
+}
+
 DARKSDK_DLL bool DBOSaveBlockFile ( LPSTR pFilename, void* pBlock, DWORD dwSize )
 {
 	// save new file
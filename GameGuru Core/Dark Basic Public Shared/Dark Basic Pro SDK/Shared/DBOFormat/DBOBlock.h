@@ -17,7 +17,11 @@
 // 0001 - Pre-U6 version
 // 1060 - U1.060 version 
 // 1062 - U1.062 version 
-#define	DBO_VERSION_NUMBER					1062
+// 1063 - vertex and index data padded to start on 16 byte boundaries
+#define	DBO_VERSION_NUMBER					1063
+
+// vertex and index data of 1063 files start on this boundary
+#define DBO_PAYLOAD_ALIGNMENT				16
 
 #define DBOBLOCK_ROOT_FRAME					1
 #define DBOBLOCK_ROOT_ANIMATIONSET			2
@@ -69,6 +73,7 @@
 #define DBOBLOCK_MESH_ZWRITE				160
 #define DBOBLOCK_MESH_ALPHATESTVALUE		166
 #define DBOBLOCK_MESH_SPECULAROVERRIDE		167
+#define DBOBLOCK_MESH_PADDING				168		// zeros before vertex or index data, skipped by readers
 
 #define	DBOBLOCK_MESH_USEMULTIMAT			123
 #define	DBOBLOCK_MESH_MULTIMATCOUNT			124
@@ -133,10 +138,22 @@
 //        - they save and want to save out this data
 #define	DBOBLOCK_OBJECT_CUSTOMDATA			406
 
+// a DBO file mapped copy-on-write, meshes built from it point their vertex and index
+// data into the view and hold a reference each, the loader holds one until it is done
+struct sDBOMappedFile
+{
+	LPSTR							pView;
+	DWORD							dwSize;
+	LONG							lReferences;
+};
+
 DARKSDK bool DBOConvertObjectToBlock	( sObject* pObject, void** ppBlock, DWORD* pdwBlockSize );
 DARKSDK bool DBOConvertBlockToObject	( void* pBlock, DWORD dwBlockSize, sObject** ppObject );
 DARKSDK bool DBOLoadBlockFile			( LPSTR pFilename, void** ppBlock, DWORD* pdwSize );
 DARKSDK bool DBOSaveBlockFile			( LPSTR pFilename, void* pBlock, DWORD dwSize );
 DARKSDK bool ConstructObject            ( sObject** ppObject, LPSTR* ppBlock );
+DARKSDK bool DBOMapBlockFile			( LPSTR pFilename, sDBOMappedFile** ppMappedFile );
+DARKSDK bool DBOConvertMappedFileToObject ( sDBOMappedFile* pMappedFile, sObject** ppObject );
+DARKSDK void DBOReleaseMappedFile		( sDBOMappedFile* pMappedFile );
 
 #endif _DBOBLOCK_H_
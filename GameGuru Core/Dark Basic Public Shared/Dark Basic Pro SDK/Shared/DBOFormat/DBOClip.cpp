@@ -0,0 +1,695 @@
+
+//
+// DBOClip Functions Implementation
+//
+
+//////////////////////////////////////////////////////////////////////////////////
+// DBOCLIP HEADER ////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+#include "DBOClip.h"
+#include "DBOFrame.h"
+#include <math.h>
+#include <unordered_map>
+
+// samples are never closer than the keys, a clip longer than this many samples is sampled coarser
+#define ANIMCLIP_MAX_SAMPLES		16384
+
+// largest difference allowed between a matrix key and its scale, rotate, position rebuild
+#define ANIMCLIP_MATRIX_TOLERANCE	0.001f
+
+int g_iAnimationClipMode = 0;
+
+// clips are shared by every clone reading the same anim data, keyed by the first source anim
+std::unordered_map< sAnimation*, sAnimationClip* > g_AnimationClips;
+
+// poses evaluated from clips, keyed by clip, quantised times and blend so every
+// object playing the same clip at about the same frame can share one
+struct sAnimationPoseKey
+{
+	sAnimationClip*					pClip;
+	int								iTimeA;
+	int								iTimeB;
+	int								iBlend;
+	bool operator== ( const sAnimationPoseKey& other ) const { return pClip == other.pClip && iTimeA == other.iTimeA && iTimeB == other.iTimeB && iBlend == other.iBlend; }
+};
+struct sAnimationPoseKeyHash
+{
+	size_t operator() ( const sAnimationPoseKey& key ) const
+	{
+		size_t hash = (size_t)key.pClip;
+		hash = hash * 31 + (size_t)key.iTimeA;
+		hash = hash * 31 + (size_t)key.iTimeB;
+		hash = hash * 31 + (size_t)key.iBlend;
+		return hash;
+	}
+};
+std::unordered_map< sAnimationPoseKey, std::vector<GGMATRIX>, sAnimationPoseKeyHash > g_AnimationPoses;
+int g_iAnimationPoseCacheMode = 0;
+float g_fAnimationPoseCacheQuantum = 0.0f;
+DWORD g_dwAnimationPoseStats [ ANIMPOSE_STAT_COUNT ] = { 0 };
+
+static void ForgetAnimationClipPoses ( sAnimationClip* pClip );
+
+//////////////////////////////////////////////////////////////////////////////////
+// INTERNAL CLIP FUNCTIONS ///////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+static sAnimation* GetAnimationClipSource ( sAnimation* pAnim )
+{
+	// clones keep no key data of their own, they read it from the object they came from
+	if ( pAnim->pSharedReadAnim ) return pAnim->pSharedReadAnim;
+	return pAnim;
+}
+
+static bool AnimationClipMatches ( sAnimationClip* pClip, sAnimation* pAnim )
+{
+	// the track list must still line up with the anim list and its key counts
+	DWORD dwTrack = 0;
+	while ( pAnim != NULL )
+	{
+		if ( dwTrack >= pClip->dwTrackCount ) return false;
+		sAnimationClipTrack* pTrack = &pClip->tracks [ dwTrack ];
+		sAnimation* pSource = GetAnimationClipSource ( pAnim );
+		if ( pTrack->pSource != pSource ) return false;
+		if ( pTrack->dwNumPositionKeys != pSource->dwNumPositionKeys ) return false;
+		if ( pTrack->dwNumRotateKeys != pSource->dwNumRotateKeys ) return false;
+		if ( pTrack->dwNumScaleKeys != pSource->dwNumScaleKeys ) return false;
+		if ( pTrack->dwNumMatrixKeys != pSource->dwNumMatrixKeys ) return false;
+		pAnim = pAnim->pNext;
+		dwTrack++;
+	}
+	return dwTrack == pClip->dwTrackCount;
+}
+
+static void AnimationClipKeyRange ( sAnimation* pSource, float* pfStart, float* pfEnd, float* pfStep )
+{
+	// widen the clip to cover every key and find the closest two keys anywhere in it
+	DWORD dwCounts [ 4 ] = { pSource->dwNumPositionKeys, pSource->dwNumRotateKeys, pSource->dwNumScaleKeys, pSource->dwNumMatrixKeys };
+	for ( int iType = 0; iType < 4; iType++ )
+	{
+		if ( dwCounts [ iType ] == 0 ) continue;
+		if ( iType == 0 && pSource->pPositionKeys == NULL ) continue;
+		if ( iType == 1 && pSource->pRotateKeys == NULL ) continue;
+		if ( iType == 2 && pSource->pScaleKeys == NULL ) continue;
+		if ( iType == 3 && pSource->pMatrixKeys == NULL ) continue;
+		DWORD dwLast = 0;
+		for ( DWORD dwKey = 0; dwKey < dwCounts [ iType ]; dwKey++ )
+		{
+			DWORD dwTime = 0;
+			if ( iType == 0 ) dwTime = pSource->pPositionKeys [ dwKey ].dwTime;
+			if ( iType == 1 ) dwTime = pSource->pRotateKeys [ dwKey ].dwTime;
+			if ( iType == 2 ) dwTime = pSource->pScaleKeys [ dwKey ].dwTime;
+			if ( iType == 3 ) dwTime = pSource->pMatrixKeys [ dwKey ].dwTime;
+			if ( (float)dwTime < *pfStart ) *pfStart = (float)dwTime;
+			if ( (float)dwTime > *pfEnd ) *pfEnd = (float)dwTime;
+			if ( dwKey > 0 && dwTime > dwLast && (float)( dwTime - dwLast ) < *pfStep ) *pfStep = (float)( dwTime - dwLast );
+			dwLast = dwTime;
+		}
+	}
+}
+
+static void QuaternionFromRotation ( GGQUATERNION* pQuat, const float r[3][3] )
+{
+	// inverse of GGMatrixRotationQuaternion, largest component first to keep precision
+	float fTrace = r[0][0] + r[1][1] + r[2][2];
+	if ( fTrace > 0.0f )
+	{
+		float s = sqrtf ( fTrace + 1.0f ) * 2.0f;
+		pQuat->w = 0.25f * s;
+		pQuat->x = ( r[1][2] - r[2][1] ) / s;
+		pQuat->y = ( r[2][0] - r[0][2] ) / s;
+		pQuat->z = ( r[0][1] - r[1][0] ) / s;
+	}
+	else if ( r[0][0] > r[1][1] && r[0][0] > r[2][2] )
+	{
+		float s = sqrtf ( 1.0f + r[0][0] - r[1][1] - r[2][2] ) * 2.0f;
+		pQuat->w = ( r[1][2] - r[2][1] ) / s;
+		pQuat->x = 0.25f * s;
+		pQuat->y = ( r[0][1] + r[1][0] ) / s;
+		pQuat->z = ( r[2][0] + r[0][2] ) / s;
+	}
+	else if ( r[1][1] > r[2][2] )
+	{
+		float s = sqrtf ( 1.0f + r[1][1] - r[0][0] - r[2][2] ) * 2.0f;
+		pQuat->w = ( r[2][0] - r[0][2] ) / s;
+		pQuat->x = ( r[0][1] + r[1][0] ) / s;
+		pQuat->y = 0.25f * s;
+		pQuat->z = ( r[1][2] + r[2][1] ) / s;
+	}
+	else
+	{
+		float s = sqrtf ( 1.0f + r[2][2] - r[0][0] - r[1][1] ) * 2.0f;
+		pQuat->w = ( r[0][1] - r[1][0] ) / s;
+		pQuat->x = ( r[2][0] + r[0][2] ) / s;
+		pQuat->y = ( r[1][2] + r[2][1] ) / s;
+		pQuat->z = 0.25f * s;
+	}
+}
+
+static void NormaliseClipQuaternion ( GGQUATERNION* pQuat )
+{
+	float fLength = sqrtf ( pQuat->x * pQuat->x + pQuat->y * pQuat->y + pQuat->z * pQuat->z + pQuat->w * pQuat->w );
+	if ( fLength < 0.000001f )
+	{
+		pQuat->x = 0.0f; pQuat->y = 0.0f; pQuat->z = 0.0f; pQuat->w = 1.0f;
+		return;
+	}
+	float fInv = 1.0f / fLength;
+	pQuat->x *= fInv; pQuat->y *= fInv; pQuat->z *= fInv; pQuat->w *= fInv;
+}
+
+static void ComposeClipMatrix ( GGMATRIX* pMatrix, const GGQUATERNION* pQuat, const float* pScale, const float* pPos )
+{
+	// same result as scaling * rotation quaternion * translation
+	GGMatrixRotationQuaternion ( pMatrix, pQuat );
+	pMatrix->_11 *= pScale[0]; pMatrix->_12 *= pScale[0]; pMatrix->_13 *= pScale[0];
+	pMatrix->_21 *= pScale[1]; pMatrix->_22 *= pScale[1]; pMatrix->_23 *= pScale[1];
+	pMatrix->_31 *= pScale[2]; pMatrix->_32 *= pScale[2]; pMatrix->_33 *= pScale[2];
+	pMatrix->_41 = pPos[0]; pMatrix->_42 = pPos[1]; pMatrix->_43 = pPos[2];
+}
+
+static bool DecomposeClipMatrix ( const GGMATRIX* pMatrix, GGQUATERNION* pQuat, float* pScale, float* pPos )
+{
+	// only matrices made of scale, rotation and translation can be baked
+	if ( fabsf ( pMatrix->_14 ) > 0.00001f || fabsf ( pMatrix->_24 ) > 0.00001f || fabsf ( pMatrix->_34 ) > 0.00001f ) return false;
+	if ( fabsf ( pMatrix->_44 - 1.0f ) > 0.00001f ) return false;
+
+	float r[3][3] = { { pMatrix->_11, pMatrix->_12, pMatrix->_13 }, { pMatrix->_21, pMatrix->_22, pMatrix->_23 }, { pMatrix->_31, pMatrix->_32, pMatrix->_33 } };
+	for ( int i = 0; i < 3; i++ )
+	{
+		pScale[i] = sqrtf ( r[i][0] * r[i][0] + r[i][1] * r[i][1] + r[i][2] * r[i][2] );
+		if ( pScale[i] < 0.00001f ) return false;
+	}
+
+	// a mirrored matrix keeps a proper rotation by flipping the first axis
+	float fDet = r[0][0] * ( r[1][1] * r[2][2] - r[1][2] * r[2][1] ) - r[0][1] * ( r[1][0] * r[2][2] - r[1][2] * r[2][0] ) + r[0][2] * ( r[1][0] * r[2][1] - r[1][1] * r[2][0] );
+	if ( fDet < 0.0f ) pScale[0] = -pScale[0];
+	for ( int i = 0; i < 3; i++ )
+		for ( int j = 0; j < 3; j++ )
+			r[i][j] /= pScale[i];
+
+	QuaternionFromRotation ( pQuat, r );
+	NormaliseClipQuaternion ( pQuat );
+	pPos[0] = pMatrix->_41; pPos[1] = pMatrix->_42; pPos[2] = pMatrix->_43;
+
+	// sheared matrices do not survive the round trip
+	GGMATRIX matRebuilt;
+	ComposeClipMatrix ( &matRebuilt, pQuat, pScale, pPos );
+	float fLargest = fabsf ( pScale[0] );
+	if ( fabsf ( pScale[1] ) > fLargest ) fLargest = fabsf ( pScale[1] );
+	if ( fabsf ( pScale[2] ) > fLargest ) fLargest = fabsf ( pScale[2] );
+	float fTolerance = ANIMCLIP_MATRIX_TOLERANCE * ( fLargest > 1.0f ? fLargest : 1.0f );
+	const float* pA = &matRebuilt._11;
+	const float* pB = &pMatrix->_11;
+	for ( int i = 0; i < 12; i++ )
+		if ( fabsf ( pA[i] - pB[i] ) > fTolerance )
+			return false;
+
+	return true;
+}
+
+static bool SampleAnimationClipTrack ( sAnimation* pSource, int iKind, float fTime, GGQUATERNION* pQuat, float* pScale, float* pPos )
+{
+	// read the keys at this time through the same functions the frame update uses
+	pQuat->x = 0.0f; pQuat->y = 0.0f; pQuat->z = 0.0f; pQuat->w = 1.0f;
+	pScale[0] = 1.0f; pScale[1] = 1.0f; pScale[2] = 1.0f;
+	pPos[0] = 0.0f; pPos[1] = 0.0f; pPos[2] = 0.0f;
+	if ( iKind == ANIMCLIP_TRACK_MATRIX )
+	{
+		GGMATRIX matKey;
+		GetMatrixFromKey ( &matKey, pSource, fTime );
+		return DecomposeClipMatrix ( &matKey, pQuat, pScale, pPos );
+	}
+	if ( pSource->dwNumScaleKeys && pSource->pScaleKeys )
+	{
+		GGVECTOR3 vecScale;
+		GetScaleVectorFromKey ( &vecScale, pSource, fTime );
+		pScale[0] = vecScale.x; pScale[1] = vecScale.y; pScale[2] = vecScale.z;
+	}
+	if ( pSource->dwNumRotateKeys && pSource->pRotateKeys )
+	{
+		GetRotationQuaternionFromKey ( pQuat, pSource, fTime );
+		NormaliseClipQuaternion ( pQuat );
+	}
+	if ( pSource->dwNumPositionKeys && pSource->pPositionKeys )
+	{
+		GGVECTOR3 vecPos;
+		DWORD dwLast = pSource->dwNumPositionKeys - 1;
+		if ( pSource->bLinear==TRUE )
+			GetPositionVectorFromKey ( &vecPos, pSource, fTime );
+		else if ( fTime >= (float)pSource->pPositionKeys [ dwLast ].dwTime )
+			vecPos = pSource->pPositionKeys [ dwLast ].vecPos;
+		else
+			GetPositionVectorFromKeySpline ( &vecPos, pSource, fTime );
+		pPos[0] = vecPos.x; pPos[1] = vecPos.y; pPos[2] = vecPos.z;
+	}
+	return true;
+}
+
+static void StoreAnimationClipVectors ( std::vector<unsigned short>& store, const std::vector<float>& values, DWORD dwSampleCount, DWORD* pdwFirst, DWORD* pdwCount, float* pfMin, float* pfStep )
+{
+	// each axis is stored as a fraction of its range over the clip
+	float fMax [ 3 ];
+	for ( int a = 0; a < 3; a++ )
+	{
+		pfMin[a] = values[a];
+		fMax[a] = values[a];
+	}
+	for ( DWORD s = 1; s < dwSampleCount; s++ )
+	{
+		for ( int a = 0; a < 3; a++ )
+		{
+			float fValue = values [ s * 3 + a ];
+			if ( fValue < pfMin[a] ) pfMin[a] = fValue;
+			if ( fValue > fMax[a] ) fMax[a] = fValue;
+		}
+	}
+	bool bConstant = true;
+	for ( int a = 0; a < 3; a++ )
+	{
+		pfStep[a] = ( fMax[a] - pfMin[a] ) / 65535.0f;
+		if ( pfStep[a] > 0.0f ) bConstant = false;
+	}
+
+	// a value that never changes needs only the one sample
+	*pdwFirst = (DWORD)store.size();
+	*pdwCount = bConstant ? 1 : dwSampleCount;
+	for ( DWORD s = 0; s < *pdwCount; s++ )
+	{
+		for ( int a = 0; a < 3; a++ )
+		{
+			unsigned short wValue = 0;
+			if ( pfStep[a] > 0.0f ) wValue = (unsigned short)floorf ( ( values [ s * 3 + a ] - pfMin[a] ) / pfStep[a] + 0.5f );
+			store.push_back ( wValue );
+		}
+	}
+}
+
+static void StoreAnimationClipRotations ( std::vector<short>& store, std::vector<float>& values, DWORD dwSampleCount, DWORD* pdwFirst, DWORD* pdwCount )
+{
+	// neighbouring samples are kept in the same hemisphere so blending between them takes the short way
+	for ( DWORD s = 1; s < dwSampleCount; s++ )
+	{
+		float* q0 = &values [ ( s - 1 ) * 4 ];
+		float* q1 = &values [ s * 4 ];
+		if ( q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3] < 0.0f )
+			for ( int c = 0; c < 4; c++ ) q1[c] = -q1[c];
+	}
+
+	std::vector<short> quantised ( dwSampleCount * 4 );
+	bool bConstant = true;
+	for ( DWORD s = 0; s < dwSampleCount; s++ )
+	{
+		for ( int c = 0; c < 4; c++ )
+		{
+			float fValue = values [ s * 4 + c ];
+			if ( fValue > 1.0f ) fValue = 1.0f;
+			if ( fValue < -1.0f ) fValue = -1.0f;
+			quantised [ s * 4 + c ] = (short)floorf ( fValue * 32767.0f + 0.5f );
+			if ( quantised [ s * 4 + c ] != quantised [ c ] ) bConstant = false;
+		}
+	}
+
+	*pdwFirst = (DWORD)store.size();
+	*pdwCount = bConstant ? 1 : dwSampleCount;
+	store.insert ( store.end(), quantised.begin(), quantised.begin() + ( *pdwCount * 4 ) );
+}
+
+static void SampleAnimationClip ( sAnimationClip* pClip, sAnimationClipTrack* pTrack, float fTime, GGQUATERNION* pQuat, float* pScale, float* pPos )
+{
+	// scale, rotation and position of a baked track at this time
+	// the two samples either side of the time, held at either end
+	float fSample = ( fTime - pClip->fStart ) * pClip->fInvStep;
+	DWORD dwSample = 0;
+	float fBlend = 0.0f;
+	if ( fSample > 0.0f )
+	{
+		dwSample = (DWORD)fSample;
+		fBlend = fSample - dwSample;
+		if ( dwSample >= pClip->dwSampleCount - 1 )
+		{
+			dwSample = pClip->dwSampleCount - 1;
+			fBlend = 0.0f;
+		}
+	}
+	DWORD dwNext = fBlend > 0.0f ? dwSample + 1 : dwSample;
+
+	// rotation is blended linearly and renormalised, samples are close enough for that to track slerp
+	const short* q0 = &pClip->rotations [ pTrack->dwRotation ];
+	const short* q1 = q0;
+	if ( pTrack->dwRotationCount > 1 )
+	{
+		q0 += dwSample * 4;
+		q1 = q0 + ( dwNext - dwSample ) * 4;
+	}
+	pQuat->x = q0[0] + ( q1[0] - q0[0] ) * fBlend;
+	pQuat->y = q0[1] + ( q1[1] - q0[1] ) * fBlend;
+	pQuat->z = q0[2] + ( q1[2] - q0[2] ) * fBlend;
+	pQuat->w = q0[3] + ( q1[3] - q0[3] ) * fBlend;
+	NormaliseClipQuaternion ( pQuat );
+
+	const unsigned short* s0 = &pClip->scales [ pTrack->dwScale ];
+	const unsigned short* s1 = s0;
+	if ( pTrack->dwScaleCount > 1 )
+	{
+		s0 += dwSample * 3;
+		s1 = s0 + ( dwNext - dwSample ) * 3;
+	}
+	const unsigned short* p0 = &pClip->positions [ pTrack->dwPosition ];
+	const unsigned short* p1 = p0;
+	if ( pTrack->dwPositionCount > 1 )
+	{
+		p0 += dwSample * 3;
+		p1 = p0 + ( dwNext - dwSample ) * 3;
+	}
+	for ( int a = 0; a < 3; a++ )
+	{
+		pScale[a] = pTrack->fScaleMin[a] + ( s0[a] + ( (float)s1[a] - s0[a] ) * fBlend ) * pTrack->fScaleStep[a];
+		pPos[a] = pTrack->fPositionMin[a] + ( p0[a] + ( (float)p1[a] - p0[a] ) * fBlend ) * pTrack->fPositionStep[a];
+	}
+}
+
+static sAnimationClip* BakeAnimationClip ( sAnimation* pHead, sAnimation* pAnimList )
+{
+	// time span of the whole set and the smallest gap between keys
+	float fStart = 1e30f, fEnd = -1e30f, fStep = 1e30f;
+	DWORD dwTrackCount = 0;
+	for ( sAnimation* pAnim = pAnimList; pAnim != NULL; pAnim = pAnim->pNext )
+	{
+		AnimationClipKeyRange ( GetAnimationClipSource ( pAnim ), &fStart, &fEnd, &fStep );
+		dwTrackCount++;
+	}
+	DWORD dwSampleCount = 1;
+	if ( fEnd > fStart )
+	{
+		if ( fStep > fEnd - fStart ) fStep = fEnd - fStart;
+		float fSamples = ( fEnd - fStart ) / fStep + 1.5f;
+		dwSampleCount = fSamples > ANIMCLIP_MAX_SAMPLES ? ANIMCLIP_MAX_SAMPLES : (DWORD)fSamples;
+		if ( dwSampleCount < 2 ) dwSampleCount = 2;
+		fStep = ( fEnd - fStart ) / ( dwSampleCount - 1 );
+	}
+	else
+	{
+		if ( fStart > fEnd ) fStart = 0.0f;
+		fStep = 1.0f;
+	}
+
+	sAnimationClip* pClip = new sAnimationClip;
+	pClip->pHead = pHead;
+	pClip->dwTrackCount = dwTrackCount;
+	pClip->dwSampleCount = dwSampleCount;
+	pClip->fStart = fStart;
+	pClip->fStep = fStep;
+	pClip->fInvStep = 1.0f / fStep;
+	pClip->tracks.resize ( dwTrackCount );
+
+	std::vector<float> rotations ( dwSampleCount * 4 );
+	std::vector<float> scales ( dwSampleCount * 3 );
+	std::vector<float> positions ( dwSampleCount * 3 );
+	DWORD dwTrack = 0;
+	for ( sAnimation* pAnim = pAnimList; pAnim != NULL; pAnim = pAnim->pNext, dwTrack++ )
+	{
+		sAnimationClipTrack* pTrack = &pClip->tracks [ dwTrack ];
+		memset ( pTrack, 0, sizeof ( sAnimationClipTrack ) );
+		sAnimation* pSource = GetAnimationClipSource ( pAnim );
+		pTrack->pSource = pSource;
+		pTrack->dwNumPositionKeys = pSource->dwNumPositionKeys;
+		pTrack->dwNumRotateKeys = pSource->dwNumRotateKeys;
+		pTrack->dwNumScaleKeys = pSource->dwNumScaleKeys;
+		pTrack->dwNumMatrixKeys = pSource->dwNumMatrixKeys;
+
+		// matrix keys are applied after the user matrix, the others before, so a
+		// track with both cannot be expressed as one local transform
+		bool bSRT = ( pSource->dwNumPositionKeys && pSource->pPositionKeys ) || ( pSource->dwNumRotateKeys && pSource->pRotateKeys ) || ( pSource->dwNumScaleKeys && pSource->pScaleKeys );
+		bool bMatrix = pSource->dwNumMatrixKeys && pSource->pMatrixKeys;
+		if ( bSRT && bMatrix )
+			pTrack->iKind = ANIMCLIP_TRACK_RAW;
+		else if ( bSRT )
+			pTrack->iKind = ANIMCLIP_TRACK_SRT;
+		else if ( bMatrix )
+			pTrack->iKind = ANIMCLIP_TRACK_MATRIX;
+		else
+			pTrack->iKind = ANIMCLIP_TRACK_NONE;
+		if ( pTrack->iKind == ANIMCLIP_TRACK_NONE || pTrack->iKind == ANIMCLIP_TRACK_RAW )
+			continue;
+
+		bool bBaked = true;
+		for ( DWORD s = 0; s < dwSampleCount && bBaked; s++ )
+		{
+			float fTime = fStart + s * fStep;
+			if ( s == dwSampleCount - 1 && dwSampleCount > 1 ) fTime = fEnd;
+			GGQUATERNION quat;
+			bBaked = SampleAnimationClipTrack ( pSource, pTrack->iKind, fTime, &quat, &scales [ s * 3 ], &positions [ s * 3 ] );
+			rotations [ s * 4 + 0 ] = quat.x;
+			rotations [ s * 4 + 1 ] = quat.y;
+			rotations [ s * 4 + 2 ] = quat.z;
+			rotations [ s * 4 + 3 ] = quat.w;
+		}
+		if ( bBaked == false )
+		{
+			pTrack->iKind = ANIMCLIP_TRACK_RAW;
+			continue;
+		}
+		StoreAnimationClipRotations ( pClip->rotations, rotations, dwSampleCount, &pTrack->dwRotation, &pTrack->dwRotationCount );
+		StoreAnimationClipVectors ( pClip->positions, positions, dwSampleCount, &pTrack->dwPosition, &pTrack->dwPositionCount, pTrack->fPositionMin, pTrack->fPositionStep );
+		StoreAnimationClipVectors ( pClip->scales, scales, dwSampleCount, &pTrack->dwScale, &pTrack->dwScaleCount, pTrack->fScaleMin, pTrack->fScaleStep );
+	}
+
+	// drop the slack left by constant tracks
+	std::vector<short> ( pClip->rotations ).swap ( pClip->rotations );
+	std::vector<unsigned short> ( pClip->positions ).swap ( pClip->positions );
+	std::vector<unsigned short> ( pClip->scales ).swap ( pClip->scales );
+	return pClip;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// CLIP FUNCTIONS ////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+DARKSDK_DLL sAnimationClip* GetAnimationClip ( sAnimationSet* pAnimSet )
+{
+	// the clip for this set, baked the first time it is asked for and again if the keys have changed
+	if ( pAnimSet == NULL || pAnimSet->pAnimation == NULL )
+		return NULL;
+
+	sAnimation* pHead = GetAnimationClipSource ( pAnimSet->pAnimation );
+	std::unordered_map< sAnimation*, sAnimationClip* >::iterator it = g_AnimationClips.find ( pHead );
+	if ( it != g_AnimationClips.end() )
+	{
+		if ( AnimationClipMatches ( it->second, pAnimSet->pAnimation ) )
+			return it->second;
+		ForgetAnimationClipPoses ( it->second );
+		delete it->second;
+		g_AnimationClips.erase ( it );
+	}
+	sAnimationClip* pClip = BakeAnimationClip ( pHead, pAnimSet->pAnimation );
+	g_AnimationClips [ pHead ] = pClip;
+	return pClip;
+}
+
+DARKSDK_DLL void FreeAnimationClip ( sAnimationSet* pAnimSet )
+{
+	// only the set owning the key data owns the clip, clones leave it for the others
+	if ( pAnimSet == NULL || pAnimSet->pAnimation == NULL || pAnimSet->pAnimation->pSharedReadAnim )
+		return;
+	std::unordered_map< sAnimation*, sAnimationClip* >::iterator it = g_AnimationClips.find ( pAnimSet->pAnimation );
+	if ( it == g_AnimationClips.end() )
+		return;
+	ForgetAnimationClipPoses ( it->second );
+	delete it->second;
+	g_AnimationClips.erase ( it );
+}
+
+DARKSDK_DLL DWORD GetAnimationClipMemory ( sAnimationClip* pClip )
+{
+	if ( pClip == NULL ) return 0;
+	DWORD dwSize = sizeof ( sAnimationClip );
+	dwSize += (DWORD)( pClip->tracks.capacity() * sizeof ( sAnimationClipTrack ) );
+	dwSize += (DWORD)( pClip->rotations.capacity() * sizeof ( short ) );
+	dwSize += (DWORD)( pClip->positions.capacity() * sizeof ( unsigned short ) );
+	dwSize += (DWORD)( pClip->scales.capacity() * sizeof ( unsigned short ) );
+	return dwSize;
+}
+
+DARKSDK_DLL bool EvaluateAnimationClipTrack ( sAnimationClip* pClip, DWORD dwTrack, float fTime, GGMATRIX* pLocal )
+{
+	// local transform of one track at this time, false for tracks that were not baked
+	sAnimationClipTrack* pTrack = &pClip->tracks [ dwTrack ];
+	if ( pTrack->iKind == ANIMCLIP_TRACK_RAW )
+		return false;
+	if ( pTrack->iKind == ANIMCLIP_TRACK_NONE )
+	{
+		GGMatrixIdentity ( pLocal );
+		return true;
+	}
+	GGQUATERNION quat;
+	float fScale [ 3 ], fPos [ 3 ];
+	SampleAnimationClip ( pClip, pTrack, fTime, &quat, fScale, fPos );
+	ComposeClipMatrix ( pLocal, &quat, fScale, fPos );
+	return true;
+}
+
+DARKSDK_DLL void EvaluateAnimationClip ( sAnimationClip* pClip, float fTime, GGMATRIX* pLocals )
+{
+	// whole pose into one array in track order, tracks that were not baked are left as identity
+	for ( DWORD dwTrack = 0; dwTrack < pClip->dwTrackCount; dwTrack++ )
+		if ( EvaluateAnimationClipTrack ( pClip, dwTrack, fTime, &pLocals [ dwTrack ] ) == false )
+			GGMatrixIdentity ( &pLocals [ dwTrack ] );
+}
+
+DARKSDK_DLL void ApplyAnimationClipTrack ( sAnimationClip* pClip, DWORD dwTrack, sAnimation* pAnim, const GGMATRIX* pLocal, float fTime )
+{
+	// the frame transform UpdateAnimationData would have produced from the keys
+	if ( pAnim == NULL || pAnim->pFrame == NULL )
+		return;
+	sFrame* pFrame = pAnim->pFrame;
+	switch ( pClip->tracks [ dwTrack ].iKind )
+	{
+		case ANIMCLIP_TRACK_NONE :
+			pFrame->matTransformed = pFrame->matUserMatrix;
+			pFrame->bVectorsCalculated = false;
+			break;
+
+		case ANIMCLIP_TRACK_SRT :
+			GGMatrixMultiply ( &pFrame->matTransformed, &pFrame->matUserMatrix, pLocal );
+			pFrame->bVectorsCalculated = false;
+			break;
+
+		case ANIMCLIP_TRACK_MATRIX :
+			GGMatrixMultiply ( &pFrame->matTransformed, pLocal, &pFrame->matUserMatrix );
+			pFrame->bVectorsCalculated = false;
+			break;
+
+		default :
+			UpdateAnimationData ( pAnim, fTime );
+			break;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// POSE CACHE FUNCTIONS //////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+static int QuantiseAnimationPoseTime ( float fTime )
+{
+	// times within the same quantum share a pose, with no quantum only identical times do
+	if ( g_fAnimationPoseCacheQuantum > 0.0f )
+		return (int)floorf ( fTime / g_fAnimationPoseCacheQuantum + 0.5f );
+	int iBits;
+	memcpy ( &iBits, &fTime, sizeof ( iBits ) );
+	return iBits;
+}
+
+static float AnimationPoseTime ( int iTime )
+{
+	if ( g_fAnimationPoseCacheQuantum > 0.0f )
+		return iTime * g_fAnimationPoseCacheQuantum;
+	float fTime;
+	memcpy ( &fTime, &iTime, sizeof ( fTime ) );
+	return fTime;
+}
+
+static void ForgetAnimationClipPoses ( sAnimationClip* pClip )
+{
+	std::unordered_map< sAnimationPoseKey, std::vector<GGMATRIX>, sAnimationPoseKeyHash >::iterator it = g_AnimationPoses.begin();
+	while ( it != g_AnimationPoses.end() )
+	{
+		if ( it->first.pClip == pClip )
+			it = g_AnimationPoses.erase ( it );
+		else
+			++it;
+	}
+}
+
+DARKSDK_DLL void EvaluateAnimationClipBlend ( sAnimationClip* pClip, float fTimeA, float fTimeB, float fBlend, GGMATRIX* pLocals )
+{
+	// pose part way from time A to time B, the manual slerp between two frames
+	for ( DWORD dwTrack = 0; dwTrack < pClip->dwTrackCount; dwTrack++ )
+	{
+		sAnimationClipTrack* pTrack = &pClip->tracks [ dwTrack ];
+		if ( pTrack->iKind == ANIMCLIP_TRACK_RAW || pTrack->iKind == ANIMCLIP_TRACK_NONE )
+		{
+			GGMatrixIdentity ( &pLocals [ dwTrack ] );
+			continue;
+		}
+		GGQUATERNION quatA, quatB;
+		float fScaleA [ 3 ], fScaleB [ 3 ], fPosA [ 3 ], fPosB [ 3 ];
+		SampleAnimationClip ( pClip, pTrack, fTimeA, &quatA, fScaleA, fPosA );
+		SampleAnimationClip ( pClip, pTrack, fTimeB, &quatB, fScaleB, fPosB );
+		if ( quatA.x * quatB.x + quatA.y * quatB.y + quatA.z * quatB.z + quatA.w * quatB.w < 0.0f )
+		{
+			quatB.x = -quatB.x; quatB.y = -quatB.y; quatB.z = -quatB.z; quatB.w = -quatB.w;
+		}
+		quatA.x += ( quatB.x - quatA.x ) * fBlend;
+		quatA.y += ( quatB.y - quatA.y ) * fBlend;
+		quatA.z += ( quatB.z - quatA.z ) * fBlend;
+		quatA.w += ( quatB.w - quatA.w ) * fBlend;
+		NormaliseClipQuaternion ( &quatA );
+		for ( int a = 0; a < 3; a++ )
+		{
+			fScaleA[a] += ( fScaleB[a] - fScaleA[a] ) * fBlend;
+			fPosA[a] += ( fPosB[a] - fPosA[a] ) * fBlend;
+		}
+		ComposeClipMatrix ( &pLocals [ dwTrack ], &quatA, fScaleA, fPosA );
+	}
+}
+
+DARKSDK_DLL const GGMATRIX* GetAnimationPose ( sAnimationClip* pClip, float fTimeA, float fTimeB, float fBlend )
+{
+	// local pose in track order, evaluated by the first object to ask for it. Tracks
+	// that were not baked are identity and left to the caller
+	sAnimationPoseKey key;
+	key.pClip = pClip;
+	key.iTimeA = QuantiseAnimationPoseTime ( fTimeA );
+	key.iTimeB = key.iTimeA;
+	key.iBlend = 0;
+	if ( fBlend > 0.0f )
+	{
+		key.iTimeB = QuantiseAnimationPoseTime ( fTimeB );
+		key.iBlend = (int)floorf ( fBlend * ANIMPOSE_BLEND_STEPS + 0.5f );
+		if ( key.iBlend >= ANIMPOSE_BLEND_STEPS )
+		{
+			key.iTimeA = key.iTimeB;
+			key.iBlend = 0;
+		}
+		if ( key.iBlend == 0 ) key.iTimeB = key.iTimeA;
+	}
+
+	std::unordered_map< sAnimationPoseKey, std::vector<GGMATRIX>, sAnimationPoseKeyHash >::iterator it = g_AnimationPoses.find ( key );
+	if ( it != g_AnimationPoses.end() )
+	{
+		g_dwAnimationPoseStats [ ANIMPOSE_STAT_HITS ]++;
+		return &it->second [ 0 ];
+	}
+	g_dwAnimationPoseStats [ ANIMPOSE_STAT_MISSES ]++;
+	if ( pClip->dwTrackCount == 0 )
+		return NULL;
+
+	std::vector<GGMATRIX>& pose = g_AnimationPoses [ key ];
+	pose.resize ( pClip->dwTrackCount );
+	if ( key.iBlend == 0 )
+		EvaluateAnimationClip ( pClip, AnimationPoseTime ( key.iTimeA ), &pose [ 0 ] );
+	else
+		EvaluateAnimationClipBlend ( pClip, AnimationPoseTime ( key.iTimeA ), AnimationPoseTime ( key.iTimeB ), (float)key.iBlend / ANIMPOSE_BLEND_STEPS, &pose [ 0 ] );
+	return &pose [ 0 ];
+}
+
+DARKSDK_DLL void NewAnimationPoseCacheFrame ( void )
+{
+	// poses stay valid while their clip lives, they are only let go once too many build up
+	g_dwAnimationPoseStats [ ANIMPOSE_STAT_LASTHITS ] = g_dwAnimationPoseStats [ ANIMPOSE_STAT_HITS ];
+	g_dwAnimationPoseStats [ ANIMPOSE_STAT_LASTMISSES ] = g_dwAnimationPoseStats [ ANIMPOSE_STAT_MISSES ];
+	g_dwAnimationPoseStats [ ANIMPOSE_STAT_TOTALHITS ] += g_dwAnimationPoseStats [ ANIMPOSE_STAT_HITS ];
+	g_dwAnimationPoseStats [ ANIMPOSE_STAT_TOTALMISSES ] += g_dwAnimationPoseStats [ ANIMPOSE_STAT_MISSES ];
+	g_dwAnimationPoseStats [ ANIMPOSE_STAT_HITS ] = 0;
+	g_dwAnimationPoseStats [ ANIMPOSE_STAT_MISSES ] = 0;
+	if ( g_AnimationPoses.size() > ANIMPOSE_CACHE_LIMIT )
+		g_AnimationPoses.clear();
+	g_dwAnimationPoseStats [ ANIMPOSE_STAT_POSES ] = (DWORD)g_AnimationPoses.size();
+}
+
+DARKSDK_DLL void ClearAnimationPoseCache ( void )
+{
+	g_AnimationPoses.clear();
+	memset ( g_dwAnimationPoseStats, 0, sizeof ( g_dwAnimationPoseStats ) );
+}
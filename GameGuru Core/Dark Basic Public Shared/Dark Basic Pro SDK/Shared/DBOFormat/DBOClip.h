@@ -0,0 +1,98 @@
+//
+// DBOClip Functions Header
+//
+
+#pragma once
+
+#include "DBOFormat.h"
+
+#include "preprocessor-flags.h"
+#include "global.h"
+
+#include <vector>
+
+// how a baked track is put back together with the frame user matrix
+#define ANIMCLIP_TRACK_NONE				0			// no keys, frame keeps its user matrix
+#define ANIMCLIP_TRACK_SRT				1			// scale, rotate and position keys, user * local
+#define ANIMCLIP_TRACK_MATRIX			2			// matrix keys, local * user
+#define ANIMCLIP_TRACK_RAW				3			// could not be baked, evaluated from the keys as before
+
+struct sAnimationClipTrack
+{
+	// what the track was baked from, a change in any of these means a rebake
+	sAnimation*						pSource;									// anim the keys were read from (the shared one for clones)
+	DWORD							dwNumPositionKeys;
+	DWORD							dwNumRotateKeys;
+	DWORD							dwNumScaleKeys;
+	DWORD							dwNumMatrixKeys;
+
+	int								iKind;										// ANIMCLIP_TRACK_ value
+
+	// each stream holds one sample when constant over the clip, else one per clip sample
+	DWORD							dwRotation;									// first of four shorts per sample in rotations
+	DWORD							dwRotationCount;
+	DWORD							dwPosition;									// first of three words per sample in positions
+	DWORD							dwPositionCount;
+	DWORD							dwScale;									// first of three words per sample in scales
+	DWORD							dwScaleCount;
+	float							fPositionMin [ 3 ];							// word 0 decodes to min, 65535 to min + range
+	float							fPositionStep [ 3 ];						// range / 65535
+	float							fScaleMin [ 3 ];
+	float							fScaleStep [ 3 ];
+};
+
+struct sAnimationClip
+{
+	// animation set resampled at a fixed step so any time finds its samples directly,
+	// rotations kept as 16 bit quaternions and positions and scales as 16 bit values
+	// within the range of each track. Tracks follow the order of the sAnimation list
+	sAnimation*						pHead;										// first source anim, the cache key
+	DWORD							dwTrackCount;
+	DWORD							dwSampleCount;
+	float							fStart;										// time of sample zero
+	float							fStep;										// time between samples
+	float							fInvStep;
+
+	std::vector<sAnimationClipTrack>	tracks;
+	std::vector<short>					rotations;
+	std::vector<unsigned short>			positions;
+	std::vector<unsigned short>			scales;
+};
+
+// set with SetAnimationClipMode, objects animate from baked clips when not zero
+extern int							g_iAnimationClipMode;
+
+// set with SetAnimationPoseCache, objects playing the same clip share poses when not zero
+extern int							g_iAnimationPoseCacheMode;
+extern float						g_fAnimationPoseCacheQuantum;				// frames that round to one pose, zero for exact times only
+extern DWORD						g_dwAnimationPoseStats [ ];
+
+// pose cache sizes
+#define ANIMPOSE_BLEND_STEPS			64			// slerp weights are rounded to this many steps
+#define ANIMPOSE_CACHE_LIMIT			2048		// poses held before the cache is emptied at the next frame
+
+// pose cache statistics
+#define ANIMPOSE_STAT_HITS				0			// so far this frame
+#define ANIMPOSE_STAT_MISSES			1
+#define ANIMPOSE_STAT_LASTHITS			2			// over the last whole frame
+#define ANIMPOSE_STAT_LASTMISSES		3
+#define ANIMPOSE_STAT_TOTALHITS			4			// since the cache was last cleared
+#define ANIMPOSE_STAT_TOTALMISSES		5
+#define ANIMPOSE_STAT_POSES				6			// poses held
+#define ANIMPOSE_STAT_COUNT				7
+
+// Clip Functions
+
+DARKSDK_DLL sAnimationClip*	GetAnimationClip			( sAnimationSet* pAnimSet );
+DARKSDK_DLL void			FreeAnimationClip			( sAnimationSet* pAnimSet );
+DARKSDK_DLL DWORD			GetAnimationClipMemory		( sAnimationClip* pClip );
+DARKSDK_DLL bool			EvaluateAnimationClipTrack	( sAnimationClip* pClip, DWORD dwTrack, float fTime, GGMATRIX* pLocal );
+DARKSDK_DLL void			EvaluateAnimationClip		( sAnimationClip* pClip, float fTime, GGMATRIX* pLocals );
+DARKSDK_DLL void			ApplyAnimationClipTrack		( sAnimationClip* pClip, DWORD dwTrack, sAnimation* pAnim, const GGMATRIX* pLocal, float fTime );
+
+// Pose Cache Functions
+
+DARKSDK_DLL void			EvaluateAnimationClipBlend	( sAnimationClip* pClip, float fTimeA, float fTimeB, float fBlend, GGMATRIX* pLocals );
+DARKSDK_DLL const GGMATRIX*	GetAnimationPose			( sAnimationClip* pClip, float fTimeA, float fTimeB, float fBlend );
+DARKSDK_DLL void			NewAnimationPoseCacheFrame	( void );
+DARKSDK_DLL void			ClearAnimationPoseCache		( void );
@@ -1,4 +1,5 @@
 #include "DBOBlock.h"
+#include "..\..\..\Include\SceneBVH.h"
 
 // Externals for DBO/Manager relationship
 #include <vector>
@@ -6,6 +7,9 @@ extern std::vector< sMesh* >		g_vRefreshMeshList;
 extern std::vector< sObject* >		g_vAnimatableObjectList;
 extern int							g_iSortedObjectCount;
 extern sObject**					g_ppSortedObjectList;
+void								FreeBoneMeshSkinning ( sMesh* pMesh );
+void								FreeAnimationClip ( sAnimationSet* pAnimSet );
+void								FreeFrameHierarchy ( sFrame* pRoot );
 
 sBone::sBone ( )
 {
@@ -132,6 +136,10 @@ sMesh::sMesh ( )
 
 sMesh::~sMesh ( )
 {
+	// any ray query tree or skinning layout built for this mesh goes with it
+	MeshBVH::release ( this );
+	FreeBoneMeshSkinning ( this );
+
 	// ensure we remove this mesh from any refresh list as it wont be ther by the time we try to refresh it
 	if ( !g_vRefreshMeshList.empty() )
     {
@@ -156,8 +164,8 @@ sMesh::~sMesh ( )
 
 	// delete all previously created memory
 	SAFE_DELETE_ARRAY ( pOriginalVertexData );
-	SAFE_DELETE_ARRAY ( pVertexData );
-	SAFE_DELETE_ARRAY ( pIndices );
+	DeleteMeshVertexData ( this );
+	DeleteMeshIndexData ( this );
 	SAFE_DELETE_ARRAY ( pBones );
 	SAFE_DELETE_ARRAY ( pFrameRef );
 	SAFE_DELETE_ARRAY ( pFrameMatrices );
@@ -169,6 +177,38 @@ sMesh::~sMesh ( )
 	SAFE_DELETE_ARRAY ( pAttributeWorkData );
 }
 
+static void ReleaseMeshMappedFile ( sMesh* pMesh )
+{
+	// the file is held while either array still points into it
+	if ( pMesh->pMappedFile && !pMesh->bVertexDataMapped && !pMesh->bIndexDataMapped )
+	{
+		DBOReleaseMappedFile ( pMesh->pMappedFile );
+		pMesh->pMappedFile = NULL;
+	}
+}
+
+void DeleteMeshVertexData ( sMesh* pMesh )
+{
+	if ( pMesh->bVertexDataMapped )
+	{
+		pMesh->pVertexData = NULL;
+		pMesh->bVertexDataMapped = false;
+		ReleaseMeshMappedFile ( pMesh );
+	}
+	SAFE_DELETE_ARRAY ( pMesh->pVertexData );
+}
+
+void DeleteMeshIndexData ( sMesh* pMesh )
+{
+	if ( pMesh->bIndexDataMapped )
+	{
+		pMesh->pIndices = NULL;
+		pMesh->bIndexDataMapped = false;
+		ReleaseMeshMappedFile ( pMesh );
+	}
+	SAFE_DELETE_ARRAY ( pMesh->pIndices );
+}
+
 sFrame::sFrame ( )
 {
 	// clear out structure
@@ -201,6 +241,9 @@ sFrame::sFrame ( )
 
 sFrame::~sFrame ( )
 {
+	// any flattened tree held for this frame goes with it
+	FreeFrameHierarchy ( this );
+
 	// recursive delete causes stack overflow on large linklists, do old fashioned way
 	sFrame* pThis = this;
 	while ( pThis )
@@ -283,6 +326,9 @@ sAnimationSet::sAnimationSet ( )
 
 sAnimationSet::~sAnimationSet ( )
 {
+	// a baked clip of this set goes with its key data
+	FreeAnimationClip ( this );
+
 	SAFE_DELETE		  ( pvecBoundMin );
 	SAFE_DELETE		  ( pvecBoundMax );
 	SAFE_DELETE		  ( pvecBoundCenter );
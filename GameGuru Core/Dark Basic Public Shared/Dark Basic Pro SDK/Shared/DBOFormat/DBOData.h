@@ -17,6 +17,7 @@ struct sFrame;				// frame
 struct sAnimation;			// animation
 struct sTexture;			// texture
 struct sMeshGroup;
+struct sDBOMappedFile;		// mapped dbo file
 
 // delete callback - used for external DLLs
 typedef void ( *ON_OBJECT_DELETE_CALLBACK ) ( int Id, int userData );
@@ -541,6 +542,11 @@ struct sMesh : public sMeshFVF,
 	float							fLastAlphaOverride;							// 220720 - so can skip applying same alpha over and over
 	DWORD							dwReservedM3;								// reserved - maintain plugin compat.
 
+	// vertex or index data loaded in place from a mapped DBO file, freed with
+	// DeleteMeshVertexData and DeleteMeshIndexData rather than delete
+	sDBOMappedFile*					pMappedFile;
+	bool							bVertexDataMapped;
+	bool							bIndexDataMapped;
 
 	// constructor and destructor
 	sMesh  ( );
@@ -1046,6 +1052,9 @@ struct sObject : public sObjectData,
 	LPGGTEXTURE pLodTexture[4];
 	LPGGSHADERRESOURCEVIEW pLodTextureView[4];
 
+	// limb LOD level chosen by the game LOD manager, -1 to pick from fCamDistance
+	int iLODManagedLevel = -1;
+
 	// Dave - added for character creator
 	sObjectCharacterCreator*		pCharacterCreator;
 	int CachedNearestLightId[MAXDYNLIGHTS];
@@ -1070,4 +1079,8 @@ struct sImposter
 	bool pAdjustUV;
 };
 
+// frees vertex or index data whether allocated or mapped
+void DeleteMeshVertexData ( sMesh* pMesh );
+void DeleteMeshIndexData ( sMesh* pMesh );
+
 #endif _DBODATA_H_
@@ -12,6 +12,7 @@
 #include "..\Objects\CommonC.h"
 #include "DBOAssImp.h"
 #include "CFileC.h"
+#include "..\..\..\Include\SceneBVH.h"
 
 // 291116 - Defined in DBDLLCORE to improve timer precision
 DARKSDK float timeGetSecond ( void );
@@ -1715,6 +1716,9 @@ DARKSDK_DLL bool CalcObjectWorld ( sObject* pObject )
 
 DARKSDK_DLL bool CalculateObjectWorld ( sObject* pObject, sFrame* pGluedToFramePtr )
 {
+	// ray queries refit this object before they next use it
+	g_SceneBVH.markDirty ( pObject );
+
 	if ( pObject->position.bCustomWorldMatrix == true )
 	{
 		// return with success
@@ -2215,7 +2219,7 @@ DARKSDK_DLL LPGGMESH LocalMeshToDXMesh ( sMesh* pMesh, CONST LPGGVERTEXELEMENT p
 			for ( DWORD dwI=0; dwI<pMesh->dwIndexCount; dwI++ )
 				pDWORDPtr [ dwI ] = pMesh->pIndices[dwI];
 			// 281114 - changed to SAFE_DELETE_ARRAY
-			SAFE_DELETE_ARRAY(pMesh->pIndices);
+			DeleteMeshIndexData ( pMesh );
 			pMesh->pIndices = (WORD*)pDWORDPtr;
 		}
 
@@ -2459,7 +2463,7 @@ DARKSDK_DLL void ConvertLocalMeshToFVF ( sMesh* pMesh, DWORD dwFVF )
 				*(GGVECTOR2*)( ( float* ) pNewVertexData + offsetMapNew.dwTU[1] + ( offsetMapNew.dwSize * iCurrentVertex ) ) = vecTex;
 			}
 		}
-		SAFE_DELETE ( pMesh->pVertexData );
+		DeleteMeshVertexData ( pMesh );
 		pMesh->pVertexData = (BYTE*)pNewVertexData;
 		pMesh->dwFVF = dwFVF;
 		pMesh->dwFVFSize = dwNewFVFSize;
@@ -2549,8 +2553,8 @@ DARKSDK_DLL void ConvertLocalMeshToVertsOnly ( sMesh* pMesh, bool bIs32BitIndexD
 
 			// delete index data and old vertex data
 			// 281114 - changed to SAFE_DELETE_ARRAY
-			SAFE_DELETE_ARRAY(pMesh->pIndices);
-			SAFE_DELETE_ARRAY(pMesh->pVertexData);
+			DeleteMeshIndexData ( pMesh );
+			DeleteMeshVertexData ( pMesh );
 
 			// replace mesh ptrs
 			pMesh->dwIndexCount = 0;
@@ -2642,7 +2646,7 @@ DARKSDK_DLL bool ConvertLocalMeshToTriList ( sMesh* pMesh )
 
 		// delete old index data
 		// 281114 - changed to SAFE_DELETE_ARRAY
-		SAFE_DELETE_ARRAY(pMesh->pIndices);
+		DeleteMeshIndexData ( pMesh );
 
 		// replace mesh ptrs
 		pMesh->iPrimitiveType = 4;
@@ -2685,7 +2689,7 @@ DARKSDK_DLL bool ConvertLocalMeshToTriList ( sMesh* pMesh )
 
 		// delete old index data
 		// 281114 - changed to SAFE_DELETE_ARRAY
-		SAFE_DELETE_ARRAY(pMesh->pIndices);
+		DeleteMeshIndexData ( pMesh );
 
 		// replace mesh ptrs
 		pMesh->iPrimitiveType = 4;
@@ -3023,8 +3027,8 @@ DARKSDK_DLL LPGGMESH ComputeTangentBasisEx ( LPGGMESH gMasterMesh, bool bMakeNor
 	DWORD dwNewFaceCount = index.size()/3;
 
 	// create mesh from new declaration
-	SAFE_DELETE(gMasterMesh->pVertexData);
-	SAFE_DELETE(gMasterMesh->pIndices);
+	DeleteMeshVertexData ( gMasterMesh );
+	DeleteMeshIndexData ( gMasterMesh );
 	gMasterMesh->dwFVFOriginal = gMasterMesh->dwFVF;
 	gMasterMesh->dwFVF = 0;
 	gMasterMesh->dwFVFSize = 12+12+8+12+12;
@@ -3657,7 +3661,7 @@ DARKSDK_DLL void ComputeBoneDataInsideVertex ( sMesh* pMesh, LPGGMESH pVertexSha
 	}
 
 	// now copy new vertex data to mesh
-	SAFE_DELETE(pMesh->pVertexData);
+	DeleteMeshVertexData ( pMesh );
 	pMesh->dwFVFSize = dwNewFVFSize;
 	pMesh->pVertexData = pNewVertexData;
 
@@ -6356,6 +6360,9 @@ DARKSDK_DLL bool CalculateAllBounds ( sObject* pObject, bool bNotUsed )
 		}
 	}
 
+	// collision bounds feed the ray query tree
+	g_SceneBVH.markDirty ( pObject );
+
 	// okay
 	return true;
 }
@@ -6373,8 +6380,8 @@ DARKSDK_DLL bool SetupMeshData ( sMesh* pMesh, DWORD dwVertexCount, DWORD dwInde
 
 	// ensure we free old data
 	// 281114 - changed to SAFE_DELETE_ARRAY
-	SAFE_DELETE_ARRAY(pMesh->pVertexData);
-	SAFE_DELETE_ARRAY(pMesh->pIndices);
+	DeleteMeshVertexData ( pMesh );
+	DeleteMeshIndexData ( pMesh );
 
 	// setup mesh properties
 	pMesh->dwVertexCount	= dwVertexCount;									// vertex count assigned
@@ -7342,6 +7349,7 @@ DARKSDK_DLL bool LoadDBODataBlock ( LPSTR pFilename, DWORD* pdwBlockSize, void**
 }
 
 enumScalingMode g_eLoadScalingMode = eScalingMode_Off;
+int g_iDBOMappedLoadMode = 0;
 bool g_bOverrideXCacheWhenUsingImporter = false;
 
 DARKSDK_DLL void SetLoadScale ( enumScalingMode eScaleMode )
@@ -7519,6 +7527,23 @@ DARKSDK_DLL bool LoadDBO ( LPSTR pPassedInFilename, sObject** ppObject, char* pO
 				}
 			}
 		}
+		if (pDataBlockFromPreload == NULL && g_iDBOMappedLoadMode == 1)
+		{
+			// mapped load, meshes use aligned vertex and index data where it lies in the
+			// file and keep it mapped while they do, anything else is copied out as before
+			sDBOMappedFile* pMappedFile = NULL;
+			if (DBOMapBlockFile(pFilename, &pMappedFile))
+			{
+				bool bConverted = DBOConvertMappedFileToObject(pMappedFile, ppObject);
+				DBOReleaseMappedFile(pMappedFile);
+				if (!bConverted)
+				{
+					RunTimeError(RUNTIMEERROR_B3DOBJECTLOADFAILED, pFilename);
+					return false;
+				}
+				return true;
+			}
+		}
 		if (pDataBlockFromPreload == NULL)
 		{
 			if (LoadDBODataBlock(pFilename, &dwBlockSize, &pDBOBlock) == false)
@@ -7606,6 +7631,36 @@ DARKSDK_DLL bool SaveDBO ( LPSTR pFilename, sObject* pObject )
 	return true;
 }
 
+DARKSDK_DLL bool AlignDBO ( LPSTR pFilename, LPSTR pNewFilename )
+{
+	// rewrites a DBO so its vertex and index data start on the payload boundary
+	// a mapped load needs, the object is saved exactly as it was read
+	DWORD dwBlockSize = 0;
+	void* pDBOBlock = NULL;
+	if ( !DBOLoadBlockFile ( pFilename, &pDBOBlock, &dwBlockSize ) )
+	{
+		RunTimeError ( RUNTIMEERROR_B3DOBJECTLOADFAILED, pFilename );
+		return false;
+	}
+	sObject* pObject = NULL;
+	bool bConverted = DBOConvertBlockToObject ( pDBOBlock, dwBlockSize, &pObject );
+	SAFE_DELETE_ARRAY ( pDBOBlock );
+	if ( !bConverted )
+	{
+		SAFE_DELETE ( pObject );
+		RunTimeError ( RUNTIMEERROR_B3DOBJECTLOADFAILED, pFilename );
+		return false;
+	}
+
+	// the source is fully read so it can also be the destination
+	bool bSaved = false;
+	if ( DBOConvertObjectToBlock ( pObject, &pDBOBlock, &dwBlockSize ) )
+		bSaved = DBOSaveBlockFile ( pNewFilename, pDBOBlock, dwBlockSize );
+	SAFE_DELETE_ARRAY ( pDBOBlock );
+	SAFE_DELETE ( pObject );
+	return bSaved;
+}
+
 DARKSDK_DLL bool CloneDBO ( sObject** ppDestObject, sObject* pSrcObject )
 {
 	// DBOBlock ptr
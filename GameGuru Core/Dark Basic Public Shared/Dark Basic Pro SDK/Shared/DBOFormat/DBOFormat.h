@@ -35,10 +35,14 @@ struct sPreLoadedObjectData
 };
 extern std::vector<sPreLoadedObjectData> g_object_outputv;
 
+// 1-load DBO files through a copy-on-write mapping, 0-read them into memory
+extern int g_iDBOMappedLoadMode;
+
 DARKSDK void		DBOCalculateLoaderTempFolder		( void );
 DARKSDK bool		LoadDBODataBlock					( LPSTR pFilename, DWORD* pdwBlockSize, void** ppDBOBlock );
 DARKSDK bool		LoadDBO								( LPSTR pFilename, sObject** ppObject, char* pOrgFilename = NULL );
 DARKSDK bool		SaveDBO								( LPSTR pFilename, sObject* pObject );
+DARKSDK bool		AlignDBO							( LPSTR pFilename, LPSTR pNewFilename );
 DARKSDK bool		CloneDBO							( sObject** ppDestObject, sObject* pSrcObject );
 
 DARKSDK bool		GetMeshCount						( sFrame* pFrame, int* piCount );
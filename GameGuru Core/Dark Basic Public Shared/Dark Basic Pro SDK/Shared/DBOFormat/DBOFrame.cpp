@@ -10,16 +10,43 @@
 #include "DBOFrame.h"
 #include "DBOMesh.h"
 #include "DBOFile.h"
+#include "DBOClip.h"
+#include "..\..\..\Include\cThreadPool.h"
+#include <unordered_map>
 
 // Externals for DBO/Manager relationship
 #include <vector>
 extern std::vector< sMesh* >		g_vRefreshMeshList;
+extern cThreadPool*					g_pThreadPool;
+
+// frame tree laid out as an array in the order UpdateFrame visits it, each frame
+// after its parent, so combined matrices are made in one pass over the array
+struct sFrameHierarchy
+{
+	sFrame*							pRoot;
+	bool							bRebuild;									// the tree no longer matches the array
+	bool							bUpdated;									// the last matrices below are known
+	DWORD							dwStamp;									// last UpdateFrameHierarchies pass to take it
+	GGMATRIX						matParent;									// matrix the root frames were last combined with
+
+	std::vector<sFrame*>			frames;
+	std::vector<int>				parents;									// index into frames, -1 for the root and its siblings
+	std::vector<sFrame*>			links;										// child and sibling of each frame when built
+	std::vector<GGMATRIX>			transformed;								// matTransformed and matCombined of each frame when
+	std::vector<GGMATRIX>			combined;									// last combined, unchanged frames are skipped
+	std::vector<char>				changed;
+};
+std::unordered_map< sFrame*, sFrameHierarchy* > g_FrameHierarchies;
+DWORD g_dwFrameHierarchyStamp = 0;
+
+// trees this small gain nothing from being flattened
+#define FRAMEHIERARCHY_MIN_FRAMES	4
 
 //////////////////////////////////////////////////////////////////////////////////
 // INTERNAL FRAME FUNCTIONS //////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
-DARKSDK_DLL bool UpdateFrame ( sFrame *pFrame, GGMATRIX *pMatrix )
+static bool UpdateFrameRecursive ( sFrame *pFrame, const GGMATRIX *pMatrix )
 {
 	// validate
 	SAFE_MEMORY ( pFrame  );
@@ -32,15 +59,161 @@ DARKSDK_DLL bool UpdateFrame ( sFrame *pFrame, GGMATRIX *pMatrix )
 	if ( pFrame->matCombined._44==0.0f ) pFrame->matCombined._44 = 1.0f;
 
 	// update child frames
-	UpdateFrame ( pFrame->pChild, &pFrame->matCombined );
+	UpdateFrameRecursive ( pFrame->pChild, &pFrame->matCombined );
 
 	// update sibling frames
-	UpdateFrame ( pFrame->pSibling, pMatrix );
+	UpdateFrameRecursive ( pFrame->pSibling, pMatrix );
 
 	// okay
 	return true;
 }
 
+static void BuildFrameHierarchy ( sFrameHierarchy* pHierarchy )
+{
+	// depth first from the root, children before siblings as the recursion went
+	pHierarchy->frames.clear();
+	pHierarchy->parents.clear();
+	pHierarchy->links.clear();
+	std::vector< std::pair<sFrame*,int> > stack;
+	stack.push_back ( std::pair<sFrame*,int> ( pHierarchy->pRoot, -1 ) );
+	while ( !stack.empty() )
+	{
+		sFrame* pFrame = stack.back().first;
+		int iParent = stack.back().second;
+		stack.pop_back();
+		int iIndex = (int)pHierarchy->frames.size();
+		pHierarchy->frames.push_back ( pFrame );
+		pHierarchy->parents.push_back ( iParent );
+		pHierarchy->links.push_back ( pFrame->pChild );
+		pHierarchy->links.push_back ( pFrame->pSibling );
+		if ( pFrame->pSibling ) stack.push_back ( std::pair<sFrame*,int> ( pFrame->pSibling, iParent ) );
+		if ( pFrame->pChild ) stack.push_back ( std::pair<sFrame*,int> ( pFrame->pChild, iIndex ) );
+	}
+	size_t count = pHierarchy->frames.size();
+	pHierarchy->transformed.resize ( count );
+	pHierarchy->combined.resize ( count );
+	pHierarchy->changed.resize ( count );
+	pHierarchy->bRebuild = false;
+	pHierarchy->bUpdated = false;
+}
+
+DARKSDK_DLL sFrameHierarchy* GetFrameHierarchy ( sFrame* pRoot )
+{
+	// the flattened tree below this frame (and its siblings), built the first time it
+	// is asked for and again once the tree has changed, NULL for small trees
+	if ( pRoot == NULL )
+		return NULL;
+	sFrameHierarchy* pHierarchy = NULL;
+	std::unordered_map< sFrame*, sFrameHierarchy* >::iterator it = g_FrameHierarchies.find ( pRoot );
+	if ( it != g_FrameHierarchies.end() )
+	{
+		pHierarchy = it->second;
+		if ( pHierarchy->bRebuild == false )
+			return pHierarchy->frames.size() >= FRAMEHIERARCHY_MIN_FRAMES ? pHierarchy : NULL;
+	}
+	else
+	{
+		pHierarchy = new sFrameHierarchy;
+		pHierarchy->pRoot = pRoot;
+		pHierarchy->dwStamp = 0;
+		g_FrameHierarchies [ pRoot ] = pHierarchy;
+	}
+	BuildFrameHierarchy ( pHierarchy );
+	return pHierarchy->frames.size() >= FRAMEHIERARCHY_MIN_FRAMES ? pHierarchy : NULL;
+}
+
+DARKSDK_DLL void FreeFrameHierarchy ( sFrame* pRoot )
+{
+	if ( g_FrameHierarchies.empty() )
+		return;
+	std::unordered_map< sFrame*, sFrameHierarchy* >::iterator it = g_FrameHierarchies.find ( pRoot );
+	if ( it == g_FrameHierarchies.end() )
+		return;
+	delete it->second;
+	g_FrameHierarchies.erase ( it );
+}
+
+DARKSDK_DLL void UpdateFrameHierarchy ( sFrameHierarchy* pHierarchy, const GGMATRIX* pMatrix )
+{
+	// same matrices as the recursive walk. Only this tree is touched, so different
+	// trees can be updated on different threads
+	bool bParentChanged = pHierarchy->bUpdated == false || memcmp ( &pHierarchy->matParent, pMatrix, sizeof ( GGMATRIX ) ) != 0;
+	pHierarchy->matParent = *pMatrix;
+	int iCount = (int)pHierarchy->frames.size();
+	for ( int i = 0; i < iCount; i++ )
+	{
+		sFrame* pFrame = pHierarchy->frames [ i ];
+
+		// frames relinked since the array was built, finish the old way and rebuild next time
+		if ( pFrame->pChild != pHierarchy->links [ i * 2 ] || pFrame->pSibling != pHierarchy->links [ i * 2 + 1 ] )
+		{
+			pHierarchy->bRebuild = true;
+			pHierarchy->bUpdated = false;
+			UpdateFrameRecursive ( pHierarchy->pRoot, pMatrix );
+			return;
+		}
+
+		// a frame whose transform and parent have not changed, and whose combined
+		// matrix has not been set elsewhere, already holds the right result
+		int iParent = pHierarchy->parents [ i ];
+		bool bChanged = iParent < 0 ? bParentChanged : pHierarchy->changed [ iParent ] != 0;
+		if ( bChanged == false )
+		{
+			if ( memcmp ( &pFrame->matTransformed, &pHierarchy->transformed [ i ], sizeof ( GGMATRIX ) ) != 0 ) bChanged = true;
+			else if ( memcmp ( &pFrame->matCombined, &pHierarchy->combined [ i ], sizeof ( GGMATRIX ) ) != 0 ) bChanged = true;
+		}
+		pHierarchy->changed [ i ] = bChanged ? 1 : 0;
+		if ( bChanged == false )
+			continue;
+
+		const GGMATRIX* pParentMatrix = iParent < 0 ? pMatrix : &pHierarchy->frames [ iParent ]->matCombined;
+		GGMatrixMultiply ( &pFrame->matCombined, &pFrame->matTransformed, pParentMatrix );
+		if ( pFrame->matCombined._44==0.0f ) pFrame->matCombined._44 = 1.0f;
+		pHierarchy->transformed [ i ] = pFrame->matTransformed;
+		pHierarchy->combined [ i ] = pFrame->matCombined;
+	}
+	pHierarchy->bUpdated = true;
+}
+
+DARKSDK_DLL void UpdateFrameHierarchies ( sFrameHierarchy** ppHierarchies, int iCount, const GGMATRIX* pMatrix )
+{
+	// each tree once, spread over the thread pool when there is one
+	g_dwFrameHierarchyStamp++;
+	int iUnique = 0;
+	for ( int i = 0; i < iCount; i++ )
+	{
+		if ( ppHierarchies [ i ] == NULL || ppHierarchies [ i ]->dwStamp == g_dwFrameHierarchyStamp ) continue;
+		ppHierarchies [ i ]->dwStamp = g_dwFrameHierarchyStamp;
+		ppHierarchies [ iUnique++ ] = ppHierarchies [ i ];
+	}
+	auto updateHierarchy = [ppHierarchies, pMatrix]( int i )
+	{
+		UpdateFrameHierarchy ( ppHierarchies [ i ], pMatrix );
+	};
+	if ( g_pThreadPool && iUnique > 1 )
+		g_pThreadPool->parallel_for ( 0, iUnique, 4, updateHierarchy );
+	else
+		for ( int i = 0; i < iUnique; i++ ) updateHierarchy ( i );
+}
+
+DARKSDK_DLL bool UpdateFrame ( sFrame *pFrame, GGMATRIX *pMatrix )
+{
+	// validate
+	SAFE_MEMORY ( pFrame  );
+	SAFE_MEMORY ( pMatrix );
+
+	// combine the whole tree in one pass over its flattened form
+	sFrameHierarchy* pHierarchy = GetFrameHierarchy ( pFrame );
+	if ( pHierarchy )
+	{
+		UpdateFrameHierarchy ( pHierarchy, pMatrix );
+		return true;
+	}
+
+	// small trees are walked directly
+	return UpdateFrameRecursive ( pFrame, pMatrix );
+}
+
 void ResetFrameMatrices ( sFrame* pFrame )
 {
 	// validate
@@ -178,25 +351,18 @@ DWORD FindPositionKey ( sAnimation* pAnim, float fTime )
 	return dwKey;
 }
 
-DWORD dwKey;	
-DWORD dwKeyMax;
-int keyMin=0;	
-int keyMax;
-int keyDiff;
-int keyCentre;
-
 DWORD FindRotationKey ( sAnimation* pAnim, float fTime )
 {
 	// NOTE: Further optimization can be made by retaining the previous dwKey and quickly checking if it has advanced in sequence
 	// Subdivision search to find correct key frame based on time value
-	dwKey=0;	
-	dwKeyMax=pAnim->dwNumRotateKeys;
-	keyMin=0;	
+	DWORD dwKey=0;
+	DWORD dwKeyMax=pAnim->dwNumRotateKeys;
+	int keyMin=0;
 	//Dave - put this in then took it out as once with fries testing he had no animations, once is enough to worry!
 	//if ( pAnim->pRotateKeys[pAnim->dwLastRotateKey].dwTime < fTime ) keyMin = pAnim->dwLastRotateKey;
-	keyMax=(int)dwKeyMax;
-	keyDiff = keyMax-keyMin;
-	keyCentre = (int)(keyMin+((keyDiff)/2.0));
+	int keyMax=(int)dwKeyMax;
+	int keyDiff = keyMax-keyMin;
+	int keyCentre = (int)(keyMin+((keyDiff)/2.0));
 	for(;keyDiff>2;)
 	{
 		// the divisions are not yet too small; ie, there's still nothing definite to choose from
@@ -810,7 +976,17 @@ DARKSDK_DLL bool UpdateAllFrameData ( sObject* pObject, float fTime )
 	// if model slerping via interpolation
 	if ( pObject->bAnimManualSlerp )
 	{
+		// the blended pose can come from the pose cache, shared with any object making the same blend
+		sAnimationClip* pClip = NULL;
+		const GGMATRIX* pPose = NULL;
+		if ( g_iAnimationPoseCacheMode && pAnim )
+		{
+			pClip = GetAnimationClip ( pObject->pAnimationSet );
+			if ( pClip ) pPose = GetAnimationPose ( pClip, pObject->fAnimSlerpStartFrame, pObject->fAnimSlerpEndFrame, pObject->fAnimSlerpTime );
+		}
+
 		// run through all animations and perform manual slerp
+		DWORD dwTrack = 0;
 		while ( pAnim != NULL )
 		{
 			float fUseTime = -1.0f;
@@ -831,18 +1007,32 @@ DARKSDK_DLL bool UpdateAllFrameData ( sObject* pObject, float fTime )
 			else
 			{
 				// slerp animation data
-				SlerpAnimationData ( pAnim, pObject->fAnimSlerpStartFrame, pObject->fAnimSlerpEndFrame, pObject->fAnimSlerpTime );
+				if ( pPose && pClip->tracks [ dwTrack ].iKind != ANIMCLIP_TRACK_RAW )
+					ApplyAnimationClipTrack ( pClip, dwTrack, pAnim, &pPose [ dwTrack ], fUseTime );
+				else
+					SlerpAnimationData ( pAnim, pObject->fAnimSlerpStartFrame, pObject->fAnimSlerpEndFrame, pObject->fAnimSlerpTime );
 			}
 
 			// move to the next sequence
 			pAnim = pAnim->pNext;
+			dwTrack++;
 		}
 	}
 	else
 	{
+		// baked clips replace the key searches when enabled, and with the pose cache
+		// the pose at this time is evaluated once for every object playing the clip
+		sAnimationClip* pClip = NULL;
+		const GGMATRIX* pPose = NULL;
+		if ( ( g_iAnimationClipMode || g_iAnimationPoseCacheMode ) && pAnim )
+			pClip = GetAnimationClip ( pObject->pAnimationSet );
+		if ( pClip && g_iAnimationPoseCacheMode && fTime>=0.0f )
+			pPose = GetAnimationPose ( pClip, fTime, fTime, 0.0f );
+
 		// run through all animations and update them
 		if ( pAnim )
 		{
+			DWORD dwTrack = 0;
 			while ( pAnim != NULL )
 			{
 				// U75 - 240909 - can override per frame animation frame
@@ -861,11 +1051,23 @@ DARKSDK_DLL bool UpdateAllFrameData ( sObject* pObject, float fTime )
 				if ( fUseTime>=0.0f )
 				{
 					// update animation data (if not entire disabled with -2.0)
-					UpdateAnimationData ( pAnim, fUseTime );
+					if ( pPose && fUseTime==fTime )
+					{
+						ApplyAnimationClipTrack ( pClip, dwTrack, pAnim, &pPose [ dwTrack ], fUseTime );
+					}
+					else if ( pClip )
+					{
+						GGMATRIX matLocal;
+						EvaluateAnimationClipTrack ( pClip, dwTrack, fUseTime, &matLocal );
+						ApplyAnimationClipTrack ( pClip, dwTrack, pAnim, &matLocal, fUseTime );
+					}
+					else
+						UpdateAnimationData ( pAnim, fUseTime );
 				}
 
 				// move to the next sequence
 				pAnim = pAnim->pNext;
+				dwTrack++;
 			}
 		}
 	}
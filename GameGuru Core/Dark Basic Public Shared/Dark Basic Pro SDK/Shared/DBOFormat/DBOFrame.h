@@ -7,9 +7,16 @@
 
 #include "DBOFormat.h"
 
+// flattened frame tree, see DBOFrame.cpp
+struct sFrameHierarchy;
+
 // Internal Frame Update Functions
 
 DARKSDK_DLL bool	UpdateFrame					( sFrame *pFrame, GGMATRIX *pMatrix );
+DARKSDK_DLL sFrameHierarchy*	GetFrameHierarchy		( sFrame* pRoot );
+DARKSDK_DLL void	FreeFrameHierarchy			( sFrame* pRoot );
+DARKSDK_DLL void	UpdateFrameHierarchy		( sFrameHierarchy* pHierarchy, const GGMATRIX* pMatrix );
+DARKSDK_DLL void	UpdateFrameHierarchies		( sFrameHierarchy** ppHierarchies, int iCount, const GGMATRIX* pMatrix );
 DARKSDK_DLL void	ResetFrameMatrices			( sFrame* pFrame );
 DARKSDK_DLL bool	UpdateAllFrameData			( sObject* pObject, float fTime );
 DARKSDK_DLL void	UpdateRealtimeFrameVectors	( sObject* pObject, sFrame* pFrame );
@@ -20,6 +27,15 @@ DARKSDK_DLL void	UpdateUserMatrix			( sFrame* pFrame );
 DARKSDK_DLL void    CopyFrameAnimToUserFrame	( sObject* pObject, float fAnimFrame );
 DARKSDK_DLL void    SlerpFrameAnimToUserFrame	( sObject* pObject, float fAnimFrame, float fInterpolationTime );
 
+// Internal Animation Key Functions
+
+DARKSDK_DLL void	GetPositionVectorFromKey		( GGVECTOR3* pvecPos, sAnimation* pAnim, float fTime );
+DARKSDK_DLL void	GetPositionVectorFromKeySpline	( GGVECTOR3* pvecPos, sAnimation* pAnim, float fTime );
+DARKSDK_DLL void	GetRotationQuaternionFromKey	( GGQUATERNION* pquatSlerp, sAnimation* pAnim, float fTime );
+DARKSDK_DLL void	GetScaleVectorFromKey			( GGVECTOR3* pvecScale, sAnimation* pAnim, float fTime );
+DARKSDK_DLL void	GetMatrixFromKey				( GGMATRIX* pResultMatrix, sAnimation* pAnim, float fTime );
+DARKSDK_DLL bool	UpdateAnimationData				( sAnimation* pAnim, float fTime );
+
 // Frame Basic Functions
 
 DARKSDK_DLL void	Offset						( sFrame* pFrame, float fX, float fY, float fZ );
@@ -12,11 +12,15 @@
 #include "stdio.h"
 #include <mmsystem.h>			// multimedia functions
 #include "..\..\..\Include\CImageC.h"
+#include "..\..\..\Include\cThreadPool.h"
+#include <xmmintrin.h>
+#include <unordered_map>
 
 
 // Externals for DBO/Manager relationship
 #include <vector>
 extern std::vector< sMesh* >		g_vRefreshMeshList;
+extern cThreadPool*					g_pThreadPool;
 
 // Prototypes
 DARKSDK void ConvertToFVF				( sMesh* pMesh, DWORD dwFVF );
@@ -1390,8 +1394,8 @@ DARKSDK_DLL bool DeleteMeshFromData ( sMesh* pMesh, int iVertex1, int iVertex2,
 			pThisIndexData[i]=pThisIndexData[i]-wVGap;
 
 	// remove old arraus
-	SAFE_DELETE_ARRAY(pMesh->pVertexData);
-	SAFE_DELETE_ARRAY(pMesh->pIndices);
+	DeleteMeshVertexData ( pMesh );
+	DeleteMeshIndexData ( pMesh );
 
 	// replace with new arrays
 	pMesh->dwVertexCount = dwNewVertexCount;
@@ -2873,6 +2877,164 @@ DARKSDK_DLL void AnimateBoneMeshMDX ( sObject* pObject, sFrame* pFrame )
 	g_vRefreshMeshList.push_back ( pMesh );
 }
 
+// bone influences of a mesh gathered per vertex, built once from pBones so each
+// skinned vertex is read once and written once instead of once per bone
+#define BONESKINNING_PARALLEL_VERTICES	4096
+#define BONESKINNING_BLOCK_VERTICES		1024
+
+struct sBoneMeshSkinning
+{
+	// what the layout was built from
+	sBone* pBones;
+	DWORD dwBoneCount;
+	DWORD dwVertexCount;
+	DWORD dwBoneSignature;
+
+	std::vector<DWORD> vertices;			// vertices with at least one influence, in order
+	std::vector<DWORD> firstInfluence;		// per entry in vertices plus one past the last
+	std::vector<DWORD> influenceBone;		// in the order the bone loop used to add them
+	std::vector<float> influenceWeight;
+	std::vector<GGMATRIX> matrices;			// bone matrices, kept between calls
+};
+std::unordered_map< sMesh*, sBoneMeshSkinning* > g_BoneMeshSkinning;
+
+static DWORD BoneMeshSkinningSignature ( sMesh* pMesh )
+{
+	DWORD dwHash = 2166136261u;
+	for ( DWORD dwBone = 0; dwBone < pMesh->dwBoneCount; dwBone++ )
+	{
+		DWORD dwValues[3] = { (DWORD)(size_t)pMesh->pBones [ dwBone ].pVertices, (DWORD)(size_t)pMesh->pBones [ dwBone ].pWeights, pMesh->pBones [ dwBone ].dwNumInfluences };
+		for ( int i = 0; i < 3; i++ ) dwHash = ( dwHash ^ dwValues [ i ] ) * 16777619u;
+	}
+	return dwHash;
+}
+
+static sBoneMeshSkinning* GetBoneMeshSkinning ( sMesh* pMesh )
+{
+	// the layout is rebuilt should the bones of the mesh be replaced
+	DWORD dwSignature = BoneMeshSkinningSignature ( pMesh );
+	sBoneMeshSkinning* pSkin = NULL;
+	std::unordered_map< sMesh*, sBoneMeshSkinning* >::iterator it = g_BoneMeshSkinning.find ( pMesh );
+	if ( it != g_BoneMeshSkinning.end() )
+	{
+		pSkin = it->second;
+		if ( pSkin->pBones == pMesh->pBones && pSkin->dwBoneCount == pMesh->dwBoneCount && pSkin->dwVertexCount == pMesh->dwVertexCount && pSkin->dwBoneSignature == dwSignature )
+			return pSkin;
+	}
+	else
+	{
+		pSkin = new sBoneMeshSkinning;
+		g_BoneMeshSkinning [ pMesh ] = pSkin;
+	}
+	pSkin->pBones = pMesh->pBones;
+	pSkin->dwBoneCount = pMesh->dwBoneCount;
+	pSkin->dwVertexCount = pMesh->dwVertexCount;
+	pSkin->dwBoneSignature = dwSignature;
+
+	// count the influences on each vertex
+	std::vector<DWORD> counts ( pMesh->dwVertexCount + 1, 0 );
+	for ( DWORD dwBone = 0; dwBone < pMesh->dwBoneCount; dwBone++ )
+		for ( DWORD dwLoop = 0; dwLoop < pMesh->pBones [ dwBone ].dwNumInfluences; dwLoop++ )
+			if ( pMesh->pBones [ dwBone ].pVertices [ dwLoop ] < pMesh->dwVertexCount )
+				counts [ pMesh->pBones [ dwBone ].pVertices [ dwLoop ] ]++;
+
+	// then place them, bone by bone so each vertex adds its influences up in the same order as before
+	pSkin->vertices.clear();
+	pSkin->firstInfluence.clear();
+	std::vector<DWORD> next ( pMesh->dwVertexCount, 0 );
+	DWORD dwTotal = 0;
+	for ( DWORD dwVertex = 0; dwVertex < pMesh->dwVertexCount; dwVertex++ )
+	{
+		if ( counts [ dwVertex ] == 0 ) continue;
+		next [ dwVertex ] = dwTotal;
+		pSkin->vertices.push_back ( dwVertex );
+		pSkin->firstInfluence.push_back ( dwTotal );
+		dwTotal += counts [ dwVertex ];
+	}
+	pSkin->firstInfluence.push_back ( dwTotal );
+	pSkin->influenceBone.resize ( dwTotal );
+	pSkin->influenceWeight.resize ( dwTotal );
+	for ( DWORD dwBone = 0; dwBone < pMesh->dwBoneCount; dwBone++ )
+	{
+		for ( DWORD dwLoop = 0; dwLoop < pMesh->pBones [ dwBone ].dwNumInfluences; dwLoop++ )
+		{
+			DWORD dwVertex = pMesh->pBones [ dwBone ].pVertices [ dwLoop ];
+			if ( dwVertex >= pMesh->dwVertexCount ) continue;
+			DWORD dwSlot = next [ dwVertex ]++;
+			pSkin->influenceBone [ dwSlot ] = dwBone;
+			pSkin->influenceWeight [ dwSlot ] = pMesh->pBones [ dwBone ].pWeights [ dwLoop ];
+		}
+	}
+	pSkin->matrices.resize ( pMesh->dwBoneCount );
+	return pSkin;
+}
+
+void FreeBoneMeshSkinning ( sMesh* pMesh )
+{
+	if ( g_BoneMeshSkinning.empty() )
+		return;
+	std::unordered_map< sMesh*, sBoneMeshSkinning* >::iterator it = g_BoneMeshSkinning.find ( pMesh );
+	if ( it == g_BoneMeshSkinning.end() )
+		return;
+	delete it->second;
+	g_BoneMeshSkinning.erase ( it );
+}
+
+static void SkinBoneMeshVertices ( sMesh* pMesh, const sBoneMeshSkinning* pSkin, int iFirst, int iLast, bool bNormals )
+{
+	// the multiplies and adds are done in the same order as MultiplyVectorAndMatrix and
+	// GGVec3TransformNormal, one lane per component, so results match the old scalar loop
+	DWORD dwStride = pMesh->dwFVFSize;
+	for ( int i = iFirst; i < iLast; i++ )
+	{
+		DWORD dwVertex = pSkin->vertices [ i ];
+		const float* pVertexBase = (const float*)(pMesh->pOriginalVertexData + ( dwStride * dwVertex ));
+		float* pDestVertexBase = (float*)(pMesh->pVertexData + ( dwStride * dwVertex ));
+
+		__m128 vx = _mm_set1_ps ( pVertexBase [ 0 ] );
+		__m128 vy = _mm_set1_ps ( pVertexBase [ 1 ] );
+		__m128 vz = _mm_set1_ps ( pVertexBase [ 2 ] );
+		__m128 nx = _mm_setzero_ps(), ny = _mm_setzero_ps(), nz = _mm_setzero_ps();
+		if ( bNormals )
+		{
+			nx = _mm_set1_ps ( pVertexBase [ 3 ] );
+			ny = _mm_set1_ps ( pVertexBase [ 4 ] );
+			nz = _mm_set1_ps ( pVertexBase [ 5 ] );
+		}
+		__m128 pos = _mm_setzero_ps();
+		__m128 norm = _mm_setzero_ps();
+		for ( DWORD n = pSkin->firstInfluence [ i ]; n < pSkin->firstInfluence [ i + 1 ]; n++ )
+		{
+			const float* m = (const float*)&pSkin->matrices [ pSkin->influenceBone [ n ] ];
+			__m128 r0 = _mm_loadu_ps ( m + 0 );
+			__m128 r1 = _mm_loadu_ps ( m + 4 );
+			__m128 r2 = _mm_loadu_ps ( m + 8 );
+			__m128 r3 = _mm_loadu_ps ( m + 12 );
+			__m128 w = _mm_set1_ps ( pSkin->influenceWeight [ n ] );
+			__m128 p = _mm_add_ps ( _mm_add_ps ( _mm_add_ps ( _mm_mul_ps ( vx, r0 ), _mm_mul_ps ( vy, r1 ) ), _mm_mul_ps ( vz, r2 ) ), r3 );
+			pos = _mm_add_ps ( pos, _mm_mul_ps ( p, w ) );
+			if ( bNormals )
+			{
+				__m128 q = _mm_add_ps ( _mm_add_ps ( _mm_mul_ps ( nx, r0 ), _mm_mul_ps ( ny, r1 ) ), _mm_mul_ps ( nz, r2 ) );
+				norm = _mm_add_ps ( norm, _mm_mul_ps ( q, w ) );
+			}
+		}
+
+		float fResult[4];
+		_mm_storeu_ps ( fResult, pos );
+		pDestVertexBase [ 0 ] = fResult [ 0 ];
+		pDestVertexBase [ 1 ] = fResult [ 1 ];
+		pDestVertexBase [ 2 ] = fResult [ 2 ];
+		if ( bNormals )
+		{
+			_mm_storeu_ps ( fResult, norm );
+			pDestVertexBase [ 3 ] = fResult [ 0 ];
+			pDestVertexBase [ 4 ] = fResult [ 1 ];
+			pDestVertexBase [ 5 ] = fResult [ 2 ];
+		}
+	}
+}
+
 void AnimateBoneMeshBONE ( sObject* pObject, sFrame* pFrame, sMesh* pMesh )
 {
 	// first time around, copy vertex data to original-store
@@ -2884,79 +3046,43 @@ void AnimateBoneMeshBONE ( sObject* pObject, sFrame* pFrame, sMesh* pMesh )
 		memcpy ( pMesh->pOriginalVertexData, pMesh->pVertexData, dwTotalVertSize );
 	}
 
+	#ifdef PRODUCTCLASSIC
+	//PE: This is needed in classic or animations like skeleton.dbo ... do not work.
 	// 010303 - new vertex blending for bones (to take advantage of multiple weights)
-	GGMATRIX* matrices = new GGMATRIX [ pMesh->dwBoneCount ];
-	BYTE* weighttable = new BYTE [ pMesh->dwVertexCount ];
-	memset ( weighttable, 0, pMesh->dwVertexCount );
+	sBoneMeshSkinning* pSkin = GetBoneMeshSkinning ( pMesh );
 
 	// update all bone matrices
 	for ( DWORD dwMatrixIndex = 0; dwMatrixIndex < pMesh->dwBoneCount; dwMatrixIndex++ )
 	{
 		if ( pMesh->pFrameMatrices [ dwMatrixIndex ] ) // lee - 180406 - u6rc10 - not all bones connect to animating frame
-			GGMatrixMultiply ( &matrices [ dwMatrixIndex ], &pMesh->pBones [ dwMatrixIndex ].matTranslation, pMesh->pFrameMatrices [ dwMatrixIndex ] );
+			GGMatrixMultiply ( &pSkin->matrices [ dwMatrixIndex ], &pMesh->pBones [ dwMatrixIndex ].matTranslation, pMesh->pFrameMatrices [ dwMatrixIndex ] );
 		else
-			memcpy ( &matrices [ dwMatrixIndex ], &pMesh->pBones [ dwMatrixIndex ].matTranslation, sizeof(GGMATRIX) );
+			memcpy ( &pSkin->matrices [ dwMatrixIndex ], &pMesh->pBones [ dwMatrixIndex ].matTranslation, sizeof(GGMATRIX) );
 	}
 
-	#ifdef PRODUCTCLASSIC
-	//PE: This is needed in classic or animations like skeleton.dbo ... do not work.
-	// run through all bones
-	for ( int iBone = 0; iBone < ( int ) pMesh->dwBoneCount; iBone++ )
+	// normals are taken to follow the position, as they always have been, so long as the vertex has room for them
+	bool bNormals = pMesh->dwFVFSize >= 24;
+
+	// large meshes are split across the thread pool (not when already on a pool thread)
+	int iCount = (int)pSkin->vertices.size();
+	cThreadPoolWorkerInfo& worker = cThreadPoolCurrentWorker();
+	if ( g_pThreadPool && worker.pool != g_pThreadPool && iCount >= BONESKINNING_PARALLEL_VERTICES )
 	{
-		// go through all influenced bones
-		for ( int iLoop = 0; iLoop < ( int ) pMesh->pBones [ iBone ].dwNumInfluences; iLoop++ )
+		int iBlocks = ( iCount + BONESKINNING_BLOCK_VERTICES - 1 ) / BONESKINNING_BLOCK_VERTICES;
+		auto skinBlock = [pMesh, pSkin, iCount, bNormals] ( int iBlock )
 		{
-			// get the correct vertex and weight
-			int iOffset = pMesh->pBones [ iBone ].pVertices [ iLoop ];
-			float fWeight = pMesh->pBones [ iBone ].pWeights [ iLoop ];
-
-			// Vertex Data Ptrs
-			float* pDestVertexBase = (float*)(pMesh->pVertexData + ( pMesh->dwFVFSize * iOffset ));
-			float* pVertexBase = (float*)(pMesh->pOriginalVertexData + ( pMesh->dwFVFSize * iOffset ));
-
-			// clear new vertex if changing it
-			if ( weighttable [ iOffset ]==0 )
-			{
-				memset ( pDestVertexBase, 0, 12 );
-				if ( pMesh->dwFVF | GGFVF_NORMAL )
-					memset ( pDestVertexBase+3, 0, 12 );
-			}
-			weighttable [ iOffset ] = 1;
-			
-			// get original vertex position
-			GGVECTOR3 vec = GGVECTOR3 ( *(pVertexBase+0), *(pVertexBase+1), *(pVertexBase+2) );
-
-			// multiply the vector and the bone matrix with weight
-			GGVECTOR3 newVec = MultiplyVectorAndMatrix ( vec, matrices [ iBone ] ) * fWeight;
-			
-			// accumilate vertex for final result
-			*(pDestVertexBase+0) += newVec.x;
-			*(pDestVertexBase+1) += newVec.y;
-			*(pDestVertexBase+2) += newVec.z;
-
-			// transform and normalise the normals vector (if present)
-			if ( pMesh->dwFVF | GGFVF_NORMAL )
-			{
-				GGVECTOR3 norm = GGVECTOR3 ( *(pVertexBase+3), *(pVertexBase+4), *(pVertexBase+5) );
-				GGVECTOR3 newNorm;
-				GGVec3TransformNormal ( &newNorm, &norm, &matrices [ iBone ] );
-				newNorm = newNorm * fWeight;
-					
-				// update the normal with the new normal values
-				*(pDestVertexBase+3) += newNorm.x;
-				*(pDestVertexBase+4) += newNorm.y;
-				*(pDestVertexBase+5) += newNorm.z;
-			}
-		}
+			int iFirst = iBlock * BONESKINNING_BLOCK_VERTICES;
+			int iLast = iFirst + BONESKINNING_BLOCK_VERTICES < iCount ? iFirst + BONESKINNING_BLOCK_VERTICES : iCount;
+			SkinBoneMeshVertices ( pMesh, pSkin, iFirst, iLast, bNormals );
+		};
+		g_pThreadPool->parallel_for ( 0, iBlocks, 1, skinBlock );
+	}
+	else
+	{
+		SkinBoneMeshVertices ( pMesh, pSkin, 0, iCount, bNormals );
 	}
-	#endif
-
-	// free matrix bank
-	SAFE_DELETE_ARRAY ( matrices );
-	SAFE_DELETE_ARRAY ( weighttable );
 
 	// trigger mesh to VB update
-	#ifdef PRODUCTCLASSIC
 	pMesh->bVBRefreshRequired = true;
 	g_vRefreshMeshList.push_back ( pMesh );
 	#endif
@@ -106,6 +106,7 @@ DARKSDK void  SetNoPixelShader			( sMesh* pMesh );
 bool  AnimateBoneMesh					( sObject* pObject, sFrame* pFrame );
 bool  AnimateBoneMesh					( sObject* pObject, sFrame* pFrame, sMesh* pMesh );
 void  AnimateBoneMeshBONE				( sObject* pObject, sFrame* pFrame, sMesh* pMesh );
+void  FreeBoneMeshSkinning				( sMesh* pMesh );
 void  ResetVertexDataInMeshPerMesh		( sMesh* pMesh );
 void  CollectOriginalVertexData			( sMesh* pMesh );
 void  ResetVertexDataInMesh				( sObject* pObject );
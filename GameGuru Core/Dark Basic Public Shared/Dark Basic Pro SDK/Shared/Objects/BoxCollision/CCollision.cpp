@@ -5,6 +5,7 @@
 #include "CCollision.h"
 #include "CCameraC.h"
 #include "CObjectsC.h"
+#include "SceneBVH.h"
 
 bool						g_bGlobalCollisionActive		= true;
 bool						g_bAutoColStarted				= false;
@@ -214,7 +215,57 @@ bool GetRayCollisionEx ( sObject* pObject, float fX, float fY, float fZ, float f
 
 				// Check for intersect with triangle in mesh
 				BYTE* Ptr = pMesh->pVertexData;
-				if ( Ptr )
+				MeshBVH* pMeshBVH = NULL;
+				if ( bRejectCulledPolysPointAway==false ) pMeshBVH = MeshBVH::get ( pMesh );
+				if ( Ptr && pMeshBVH )
+				{
+					// larger meshes only visit triangles near the ray, the tree picks the same hit as the loops below
+					float fRayStart[3] = { StartVector.x, StartVector.y, StartVector.z };
+					float fRayDir[3] = { DirVector.x, DirVector.y, DirVector.z };
+					int iTriangle;
+					float fThisDistance;
+					if ( pMeshBVH->intersect ( pMesh, fRayStart, fRayDir, fDistanceModifier, fDistToIntersect, iTriangle, fThisDistance ) )
+					{
+						// triangle indices
+						DWORD v0 = iTriangle*3+0;
+						DWORD v1 = iTriangle*3+1;
+						DWORD v2 = iTriangle*3+2;
+						if ( pMesh->pIndices )
+						{
+							v0 = pMesh->pIndices [ v0 ];
+							v1 = pMesh->pIndices [ v1 ];
+							v2 = pMesh->pIndices [ v2 ];
+						}
+
+						// triangle vertice ptrs
+						float* pV = (float*)Ptr;
+						DWORD dwSizeInFloats = (DWORD)(pMesh->dwFVFSize/4);
+						GGVECTOR3* pVec0 = (GGVECTOR3*)(pV+((v0*dwSizeInFloats)));
+						GGVECTOR3* pVec1 = (GGVECTOR3*)(pV+((v1*dwSizeInFloats)));
+						GGVECTOR3* pVec2 = (GGVECTOR3*)(pV+((v2*dwSizeInFloats)));
+
+						// store useful info
+						fDistToIntersect = fThisDistance;
+						iFrameCollision = iFrame;
+						pMeshThatHasBeenHitRef = pMesh;
+						dwVertex0IndexOfHitPoly = v0;
+						dwVertex1IndexOfHitPoly = v1;
+						dwVertex2IndexOfHitPoly = v2;
+						vec0Hit = *pVec0;
+						vec1Hit = *pVec1;
+						vec2Hit = *pVec2;
+						dwArbValueDetected = pMesh->Collision.dwArbitaryValue;
+
+						// work out normal for surface direction
+						GGVECTOR3 vNormal;
+						GGVec3Cross ( &vNormal, &( *pVec2 - *pVec1 ), &( *pVec0 - *pVec1 ) );
+						GGVec3Normalize ( &vNormal, &vNormal );
+						vecSurfaceNormal.x = vNormal.x;
+						vecSurfaceNormal.y = vNormal.y;
+						vecSurfaceNormal.z = vNormal.z;
+					}
+				}
+				else if ( Ptr )
 				{
 					// vertex data vars
 					float* pV = (float*)Ptr;
@@ -1503,7 +1554,7 @@ int	CheckLimbHit ( int iObjectA, int iLimbA, int iObjectB, int iLimbB )
 	return iHitEvent;
 }
 
-float CheckIntersectObject ( sObject* pObject, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ, int iIgnoreAllButLastFrame )
+void PrepareIntersectObject ( sObject* pObject )
 {
 	// ensure all meshes of object are tri-lists
 	if ( pObject->ppFrameList )
@@ -1529,6 +1580,12 @@ float CheckIntersectObject ( sObject* pObject, float fX, float fY, float fZ, flo
 		if ( bIfObjChanged )
 			m_ObjectManager.RenewReplacedMeshes ( pObject );
 	}
+}
+
+float CheckIntersectObject ( sObject* pObject, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ, int iIgnoreAllButLastFrame )
+{
+	// ensure all meshes of object are tri-lists
+	PrepareIntersectObject ( pObject );
 
 	// actual intersect test
 	float fDistance=0.0f;
@@ -1562,6 +1619,122 @@ float CheckIntersectObject ( sObject* pObject, float fX, float fY, float fZ, flo
 	return fDistance;
 }
 
+bool CaptureRayCollisionFrames ( sObject* pObject, std::vector<sRayCollisionFrame>& frames )
+{
+	// call after CalcObjectWorld and PrepareIntersectObject on the object. Box first and bone
+	// animated objects use shared tables so are left to CheckIntersectObject
+	sObject* pActualObject = pObject;
+	if ( pActualObject->pInstanceOfObject )
+		pActualObject = pActualObject->pInstanceOfObject;
+	if ( RayCollisionDoBoxCheckFirst == true )
+		return false;
+	if ( pActualObject->pAnimationSet && pObject->bIgnoreDefAnim==false )
+		return false;
+
+	// the frames the traditional polygon test in GetRayCollisionEx visits, with their matrices
+	for ( int iFrame=0; iFrame<pActualObject->iFrameCount; iFrame++ )
+	{
+		sFrame* pFrame = pActualObject->ppFrameList[iFrame];
+		sMesh* pMesh = pFrame->pMesh;
+		if ( pMesh==NULL )
+			continue;
+		if ( pObject->pInstanceMeshVisible )
+			if ( pObject->pInstanceMeshVisible [ iFrame ]==false )
+				continue;
+
+		ConvertLocalMeshToTriList ( pMesh );
+		CalculateAbsoluteWorldMatrix ( pObject, pFrame, pMesh );
+
+		sRayCollisionFrame frame;
+		frame.pMesh = pMesh;
+		frame.pMeshBVH = MeshBVH::get ( pMesh );
+		frame.matWorld = pFrame->matAbsoluteWorld;
+		GGMatrixInverse ( &frame.matInv, NULL, &frame.matWorld );
+		frames.push_back ( frame );
+	}
+	return true;
+}
+
+float GetRayCollisionCaptured ( const sRayCollisionFrame* pFrames, int iFrameCount, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ, GGVECTOR3* pvecNormal )
+{
+	// the traditional polygon test of GetRayCollisionEx on frames from CaptureRayCollisionFrames,
+	// it only reads so many rays can be tested at once, and gives the same distance and normal
+	float fDistToIntersect = 0.0f;
+	GGVECTOR3 vecSurfaceNormal = GGVECTOR3 ( 0, 0, 0 );
+	for ( int iFrame=0; iFrame<iFrameCount; iFrame++ )
+	{
+		const sRayCollisionFrame& frame = pFrames [ iFrame ];
+		sMesh* pMesh = frame.pMesh;
+
+		// ray in mesh space
+		GGVECTOR3 StartVector = GGVECTOR3( fX, fY, fZ );
+		GGVECTOR3 EndVector = GGVECTOR3( fNewX, fNewY, fNewZ );
+		GGVECTOR3 OriginalVector = EndVector - StartVector;
+		float fOriginalLength = GGVec3Length ( &OriginalVector );
+		GGVec3TransformCoord( &StartVector, &StartVector, &frame.matInv );
+		GGVec3TransformCoord( &EndVector, &EndVector, &frame.matInv );
+		GGVECTOR3 DirVector = EndVector - StartVector;
+		float fOrientedLength = GGVec3Length ( &DirVector );
+		GGVec3Normalize( &DirVector, &DirVector );
+		float fDistanceModifier = fOriginalLength/fOrientedLength;
+
+		float* pV = (float*)pMesh->pVertexData;
+		DWORD dwSizeInFloats = (DWORD)(pMesh->dwFVFSize/4);
+		int iHitTriangle = -1;
+		if ( pV && frame.pMeshBVH )
+		{
+			float fRayStart[3] = { StartVector.x, StartVector.y, StartVector.z };
+			float fRayDir[3] = { DirVector.x, DirVector.y, DirVector.z };
+			float fThisDistance;
+			if ( frame.pMeshBVH->intersect ( pMesh, fRayStart, fRayDir, fDistanceModifier, fDistToIntersect, iHitTriangle, fThisDistance ) )
+				fDistToIntersect = fThisDistance;
+			else
+				iHitTriangle = -1;
+		}
+		else if ( pV )
+		{
+			for ( int i = 0; i < pMesh->iDrawPrimitives; i++ )
+			{
+				DWORD v0 = i*3+0, v1 = i*3+1, v2 = i*3+2;
+				if ( pMesh->pIndices ) { v0 = pMesh->pIndices [ v0 ]; v1 = pMesh->pIndices [ v1 ]; v2 = pMesh->pIndices [ v2 ]; }
+				GGVECTOR3* pVec0 = (GGVECTOR3*)(pV+((v0*dwSizeInFloats)));
+				GGVECTOR3* pVec1 = (GGVECTOR3*)(pV+((v1*dwSizeInFloats)));
+				GGVECTOR3* pVec2 = (GGVECTOR3*)(pV+((v2*dwSizeInFloats)));
+				float fU, fV, fThisDistance;
+				if ( GGIntersectTri(pVec0,pVec1,pVec2,&StartVector,&DirVector,&fU,&fV,&fThisDistance) == TRUE )
+				{
+					fThisDistance *= fDistanceModifier;
+					if ( fThisDistance > 0.0f )
+					{
+						if ( fDistToIntersect == 0.0f || fThisDistance < fDistToIntersect )
+						{
+							fDistToIntersect = fThisDistance;
+							iHitTriangle = i;
+						}
+					}
+				}
+			}
+		}
+
+		// normal of the nearest triangle so far
+		if ( iHitTriangle >= 0 )
+		{
+			DWORD v0 = iHitTriangle*3+0, v1 = iHitTriangle*3+1, v2 = iHitTriangle*3+2;
+			if ( pMesh->pIndices ) { v0 = pMesh->pIndices [ v0 ]; v1 = pMesh->pIndices [ v1 ]; v2 = pMesh->pIndices [ v2 ]; }
+			GGVECTOR3* pVec0 = (GGVECTOR3*)(pV+((v0*dwSizeInFloats)));
+			GGVECTOR3* pVec1 = (GGVECTOR3*)(pV+((v1*dwSizeInFloats)));
+			GGVECTOR3* pVec2 = (GGVECTOR3*)(pV+((v2*dwSizeInFloats)));
+			GGVec3Cross ( &vecSurfaceNormal, &( *pVec2 - *pVec1 ), &( *pVec0 - *pVec1 ) );
+			GGVec3Normalize ( &vecSurfaceNormal, &vecSurfaceNormal );
+		}
+
+		// as GetRayCollisionEx, the normal is taken through each mesh visited from the hit onwards
+		GGVec3TransformNormal( &vecSurfaceNormal, &vecSurfaceNormal, &frame.matWorld );
+	}
+	if ( pvecNormal ) *pvecNormal = vecSurfaceNormal;
+	return fDistToIntersect;
+}
+
 float GetColRadius ( sObject* pObject )
 {
 	// radius multiplied by average of scale
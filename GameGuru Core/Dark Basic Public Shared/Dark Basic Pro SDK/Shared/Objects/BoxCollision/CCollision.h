@@ -11,6 +11,9 @@
 //////////////////////////////////////////////////////////////////////////////////
 #include "..\\CommonC.h"
 #include "cBoxCol.h"
+#include <vector>
+
+class MeshBVH;
 
 //////////////////////////////////////////////////////////////////////////////////
 // Internal Data ////////////////////////////////////////////////////////////////
@@ -34,6 +37,16 @@ struct sMegaCollisionFeedback
 };
 extern sMegaCollisionFeedback MegaCollisionFeedback;
 
+// one mesh of an object as GetRayCollisionEx sees it, captured on the main thread
+// so rays can afterwards be tested against the object from any thread
+struct sRayCollisionFrame
+{
+	sMesh* pMesh;
+	MeshBVH* pMeshBVH;
+	GGMATRIX matWorld;
+	GGMATRIX matInv;
+};
+
 //////////////////////////////////////////////////////////////////////////////////
 // Internal Commands ////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
@@ -59,6 +72,9 @@ void		GlobalColOn					( void );
 void		GlobalColOff				( void );
 
 float		CheckIntersectObject		( sObject* pObject, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ, int iIgnoreAllButLastFrame );
+void		PrepareIntersectObject		( sObject* pObject );
+bool		CaptureRayCollisionFrames	( sObject* pObject, std::vector<sRayCollisionFrame>& frames );
+float		GetRayCollisionCaptured		( const sRayCollisionFrame* pFrames, int iFrameCount, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ, GGVECTOR3* pvecNormal );
 int			CheckCol					( int iObjectA, int iObjectB );
 int			CheckHit					( int iObjectA, int iObjectB );
 int			CheckLimbCol				( int iObjectA, int iLimbA, int iObjectB, int iLimbB );
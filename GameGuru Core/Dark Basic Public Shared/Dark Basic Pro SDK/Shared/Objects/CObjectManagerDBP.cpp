@@ -9,6 +9,10 @@
 #include "Occlusion\cOcclusion.h"
 #include "CObjectsC.h"
 #include "CGfxC.h"
+#include "SceneBVH.h"
+#include ".\..\DBOFormat\DBOClip.h"
+#include "VisibilityCull.h"
+#include "RenderQueue.h"
 #include <algorithm>
 
 #define SupportTechniqueOutLine (1 << 31)
@@ -104,61 +108,13 @@ extern LPGG			m_pDX;
 extern COcclusion			g_Occlusion;
 #endif
 
-namespace
+// limb visibility LOD level, the game LOD manager decides when it tracks the object
+static int GetObjectLimbLOD ( sObject* pObject )
 {
-    // Structures for sorting using the STL sort
-    // Used for sorting the m_ppSortedObjectList, m_pDepthSortedList
-    struct OrderByReverseCameraDistance
-    {
-        bool operator()(sObject* pObjectA, sObject* pObjectB)
-        {
-            if (pObjectA->position.fCamDistance > pObjectB->position.fCamDistance)
-                return true;
-            if (pObjectA->position.fCamDistance == pObjectB->position.fCamDistance)
-                return (pObjectA->dwObjectNumber < pObjectB->dwObjectNumber);
-            return false;
-        }
-    };
-    struct OrderByTexture
-    {
-        bool operator()(sObject* pObjectA, sObject* pObjectB)
-        {
-            int iImageA = 0;
-            int iImageB = 0;
-
-            // Calculate order by object number now,
-            // just in case it's needed and to avoid getting incorrect results
-            // if instances are involved.
-            bool bObjectOrder = pObjectA->dwObjectNumber < pObjectB->dwObjectNumber;
-
-            // Get the image id for object a
-		    if ( pObjectA->pInstanceOfObject )
-			    pObjectA = pObjectA->pInstanceOfObject;
-		    if ( pObjectA->ppMeshList && pObjectA->ppMeshList [ 0 ]->pTextures)
-                iImageA = pObjectA->ppMeshList [ 0 ]->pTextures [ 0 ].iImageID;
-
-            // Get the image id for object b
-		    if ( pObjectB->pInstanceOfObject )
-			    pObjectB = pObjectB->pInstanceOfObject;
-		    if ( pObjectB->ppMeshList && pObjectB->ppMeshList [ 0 ]->pTextures)
-                iImageB = pObjectB->ppMeshList [ 0 ]->pTextures [ 0 ].iImageID;
-
-            if (iImageA < iImageB)
-                return true;
-            if (iImageA > iImageB)
-                return false;
-
-            // Same images, so order by object id
-            return bObjectOrder;
-        }
-    };
-    struct OrderByObject
-    {
-        bool operator()(sObject* pObjectA, sObject* pObjectB)
-        {
-            return (pObjectA->dwObjectNumber < pObjectB->dwObjectNumber);
-        }
-    };
+	if ( pObject->iLODManagedLevel >= 0 ) return pObject->iLODManagedLevel;
+	if ( pObject->position.fCamDistance > pObject->fLODDistance[1] ) return 2;
+	if ( pObject->position.fCamDistance > pObject->fLODDistance[0] ) return 1;
+	return 0;
 }
 
 // move these into cpp file for debugging
@@ -292,6 +248,8 @@ bool CObjectManager::Setup ( void )
 	m_ppSortedObjectVisibleList = 0;
 	m_pVertexDataList = 0;
 	m_pIndexDataList = 0;
+	m_RenderQueue.Clear();
+	m_vAnimatableObjectIDs.clear();
 
 	// Reset member vars
 	m_bGlobalShadows				= false;
@@ -1450,113 +1408,194 @@ void CObjectManager::RemoveTextureRefFromAllObjects ( LPGGTEXTURE pTextureRef )
 	}
 }
 
-bool CObjectManager::SortTextureList ( void )
+// draw key for an object in the sorted list, see RenderQueue.h
+static ULONGLONG GetObjectRenderKey ( cRenderQueue& queue, sObject* pObject, sObject* pRenderObject )
 {
-    // If the object list size hasn't changed and no textures have changed, then nothing to do here.
-	//Dave Performance, can force an update with g_ForceTextureListUpdate flag set to true, to take into account ignored objects
-	if ( !g_ForceTextureListUpdate )
+	// the layer SortVisibilityList will put the object in
+	ULONGLONG key = RENDERKEY_LAYER_STANDARD;
+	if ( pObject->bVeryEarlyObject == true )
+		key = RENDERKEY_LAYER_EARLY;
+	else if ( pObject->bNewZLayerObject || pObject->bLockedObject )
+		key = RENDERKEY_LAYER_NOZDEPTH;
+	else if ( pObject->bGhostedObject || pObject->bTransparentObject )
+		key = RENDERKEY_LAYER_TRANSPARENT;
+	key <<= RENDERKEY_LAYER_SHIFT;
+
+	switch(g_eGlobalSortOrder)
 	{
-		if ( m_iLastCount == g_iObjectListRefCount && m_bUpdateTextureList==false )
-			return true;
+		case E_SORT_BY_TEXTURE:
+		{
+			// as OrderByTexture, with objects sharing an effect kept together first
+			sMesh* pMesh = pRenderObject->ppMeshList [ 0 ];
+			ULONGLONG dwEffect = queue.GetEffectRank ( pMesh->pVertexShaderEffect );
+			int iImage = pMesh->pTextures [ 0 ].iImageID;
+			if ( iImage < 0 ) iImage = 0;
+			if ( iImage > RENDERKEY_TEXTURE_LIMIT ) iImage = RENDERKEY_TEXTURE_LIMIT;
+			key |= ( dwEffect << RENDERKEY_EFFECT_SHIFT ) | ( (ULONGLONG)iImage << RENDERKEY_TEXTURE_SHIFT ) | pObject->dwObjectNumber;
+			break;
+		}
+		case E_SORT_BY_OBJECT:
+			key |= pObject->dwObjectNumber;
+			break;
+		default:
+			// depth is sorted once the visible objects are known, so like no sort keep list order
+			key |= queue.GetSequence ( pObject->dwObjectNumber );
+			break;
 	}
+	return key;
+}
 
-    // Reset ready for next time
-    m_iLastCount         = g_iObjectListRefCount;
-    m_bUpdateTextureList = false;
+void CObjectManager::QueueObject ( int iObjectID )
+{
+    // Actual object or instance of object
+    sObject* pOriginalObject = g_ObjectList [ iObjectID ];
+    if ( ! pOriginalObject )
+        return;
 
-    // make sure the lists we're using are valid
-    SAFE_MEMORY ( g_ppSortedObjectList );
-    SAFE_MEMORY ( m_ppSortedObjectVisibleList );
+	// quick reject objects which have a sync mask of ZERO
+	if ( pOriginalObject->dwCameraMaskBits==0 )
+		return;
 
-    // reset all data so we can build the list from scratch
-    g_iSortedObjectCount = 0;
-    g_bRenderVeryEarlyObjects = false;
+	//Dave Performance - do not add ignored objects into the list
+	if ( pOriginalObject->bIgnored )
+		return;
 
-	// at same time, collect object lists that DO NOT change from cycle to cycle
-	g_vAnimatableObjectList.clear();
+	// 210214 - quick reject objects which are excluded
+	if ( pOriginalObject->bExcluded )
+		return;
 
-    // run through all known items and put them into render list ready for sorting
-    for ( int iShortList = 0; iShortList < g_iObjectListRefCount; iShortList++ )
+	// lee - 300914 - if this object holds some animation data, add to animatable list (done once per texture sort for speed!)
+	if ( pOriginalObject->pAnimationSet ) 
+	{
+		g_vAnimatableObjectList.push_back ( pOriginalObject );
+		m_vAnimatableObjectIDs.push_back ( iObjectID );
+	}
+
+	// get the object we would render
+    sObject* pRenderObject = pOriginalObject;
+    if ( pRenderObject->pInstanceOfObject )
+	    pRenderObject = pRenderObject->pInstanceOfObject;
+
+    // See if we have enough information to render this object
+    // A (possibly instanced) object with a mesh list and with mesh 0 having a texture.
+    if ( pRenderObject && pRenderObject->ppMeshList && pRenderObject->ppMeshList[0]->pTextures)
     {
-	    // Get an object id from shortlist
-	    int iObjectID = g_ObjectListRef [ iShortList ];
+        // Add the original object into the render queue
+		m_RenderQueue.Insert ( GetObjectRenderKey ( m_RenderQueue, pOriginalObject, pRenderObject ), pOriginalObject, iObjectID );
 
-	    // Actual object or instance of object
-	    sObject* pOriginalObject = g_ObjectList [ iObjectID ];
-        if ( ! pOriginalObject )
-            continue;
+        // If we are sorting by distance, calculate the distance ready for sorting
+        if ( g_eGlobalSortOrder == E_SORT_BY_DEPTH )
+	    {
+		    if ( pOriginalObject->bVeryEarlyObject == true )
+		    {
+                // very early objects are placed at extreme distance
+			    pOriginalObject->position.fCamDistance = 9999999.9f;
+		    }
+		    else
+		    {
+			    pOriginalObject->position.fCamDistance = CalculateObjectDistanceFromCamera ( pOriginalObject );
+		    }
+        }
+    }
+}
 
-		// quick reject objects which have a sync mask of ZERO
-		if ( pOriginalObject->dwCameraMaskBits==0 )
-			continue;
+void CObjectManager::AddToRenderQueue ( int iObjectID )
+{
+	// sorted in at the next SortTextureList
+	m_RenderQueue.AddObject ( iObjectID );
+}
 
-		//Dave Performance - do not add ignored objects into the list
-		if ( pOriginalObject->bIgnored )
-			continue;
+void CObjectManager::RemoveFromRenderQueue ( int iObjectID )
+{
+	// the object may already be freed, so it leaves the animatable list now by number
+	m_RenderQueue.MarkObject ( iObjectID );
+	std::vector<int> ids ( 1, iObjectID );
+	RemoveFromAnimatableList ( ids );
+}
 
-		// 210214 - quick reject objects which are excluded
-		if ( pOriginalObject->bExcluded )
+void CObjectManager::RemoveFromAnimatableList ( const std::vector<int>& ids )
+{
+	for ( int i = 0; i < (int)ids.size(); i++ )
+	{
+		if ( ids [ i ] >= (int)m_vAnimatableObjectMarks.size() ) m_vAnimatableObjectMarks.resize ( ids [ i ] + 1, 0 );
+		m_vAnimatableObjectMarks [ ids [ i ] ] = 1;
+	}
+	int iKept = 0;
+	for ( int i = 0; i < (int)m_vAnimatableObjectIDs.size(); i++ )
+	{
+		int iObjectID = m_vAnimatableObjectIDs [ i ];
+		if ( iObjectID < (int)m_vAnimatableObjectMarks.size() && m_vAnimatableObjectMarks [ iObjectID ] )
 			continue;
+		g_vAnimatableObjectList [ iKept ] = g_vAnimatableObjectList [ i ];
+		m_vAnimatableObjectIDs [ iKept++ ] = iObjectID;
+	}
+	g_vAnimatableObjectList.resize ( iKept );
+	m_vAnimatableObjectIDs.resize ( iKept );
+	for ( int i = 0; i < (int)ids.size(); i++ )
+		m_vAnimatableObjectMarks [ ids [ i ] ] = 0;
+}
+
+bool CObjectManager::SortTextureList ( void )
+{
+	// objects added, removed or changed since the last sort are keyed and merged
+	// into the render queue, anything else that affects the order rebuilds it all
+	//Dave Performance, can force an update with g_ForceTextureListUpdate flag set to true, to take into account ignored objects
+	bool bRebuild = g_ForceTextureListUpdate || m_bUpdateTextureList;
+	if ( m_iLastCount != g_iObjectListRefCount && !m_RenderQueue.IsPending() )
+		bRebuild = true;
+	if ( g_vAnimatableObjectList.size() != m_vAnimatableObjectIDs.size() )
+		bRebuild = true;
+	if ( !bRebuild && !m_RenderQueue.IsPending() )
+		return true;
+
+    // Reset ready for next time
+    m_iLastCount         = g_iObjectListRefCount;
+    m_bUpdateTextureList = false;
+
+    // make sure the lists we're using are valid
+    SAFE_MEMORY ( g_ppSortedObjectList );
+    SAFE_MEMORY ( m_ppSortedObjectVisibleList );
+
+	if ( bRebuild )
+	{
+		// at same time, collect object lists that DO NOT change from cycle to cycle
+		g_vAnimatableObjectList.clear();
+		m_vAnimatableObjectIDs.clear();
 
-		// lee - 300914 - if this object holds some animation data, add to animatable list (done once per texture sort for speed!)
-		if ( pOriginalObject->pAnimationSet ) 
+		// run through all known items and put them into the render queue ready for sorting
+		m_RenderQueue.Clear();
+		for ( int iShortList = 0; iShortList < g_iObjectListRefCount; iShortList++ )
 		{
-			g_vAnimatableObjectList.push_back ( pOriginalObject );
+			int iObjectID = g_ObjectListRef [ iShortList ];
+			m_RenderQueue.SetSequence ( iObjectID, iShortList );
+			QueueObject ( iObjectID );
 		}
+	}
+	else
+	{
+		// drop what changed and put back the ones still to be drawn
+		m_RenderQueue.Begin ( m_vRenderQueueIDs );
+		RemoveFromAnimatableList ( m_vRenderQueueIDs );
+		for ( int i = 0; i < (int)m_vRenderQueueIDs.size(); i++ )
+			QueueObject ( m_vRenderQueueIDs [ i ] );
+	}
+	m_RenderQueue.Finish();
 
-		// get the object we would render
-        sObject* pRenderObject = pOriginalObject;
-        if ( pRenderObject->pInstanceOfObject )
-		    pRenderObject = pRenderObject->pInstanceOfObject;
+	// copy the queue into the sorted list
+    g_iSortedObjectCount = 0;
+    g_bRenderVeryEarlyObjects = false;
+	const sRenderQueueEntry* pEntries = m_RenderQueue.GetEntries();
+	for ( int iEntry = 0; iEntry < m_RenderQueue.GetCount(); iEntry++ )
+	{
+		sObject* pObject = pEntries [ iEntry ].pObject;
+		g_ppSortedObjectList [ g_iSortedObjectCount++ ] = pObject;
 
-	    // See if we have enough information to render this object
-        // A (possibly instanced) object with a mesh list and with mesh 0 having a texture.
-        if ( pRenderObject && pRenderObject->ppMeshList && pRenderObject->ppMeshList[0]->pTextures)
+        // Check to see if there is an early draw object
+        if ( pObject->bVeryEarlyObject == true )
 	    {
-            // Add the original object into the render list
-            g_ppSortedObjectList [ g_iSortedObjectCount++ ] = pOriginalObject;
-
-            // If we are sorting by distance, calculate the distance ready for sorting
-            if ( g_eGlobalSortOrder == E_SORT_BY_DEPTH )
-		    {
-			    if ( pOriginalObject->bVeryEarlyObject == true )
-			    {
-                    // very early objects are placed at extreme distance
-				    pOriginalObject->position.fCamDistance = 9999999.9f;
-			    }
-			    else
-			    {
-				    pOriginalObject->position.fCamDistance = CalculateObjectDistanceFromCamera ( pOriginalObject );
-			    }
-            }
-            
-            // Check to see if there is an early draw object
-            if ( pOriginalObject->bVeryEarlyObject == true )
-		    {
-			    // If this object is an early draw, set global flag to show we have one in the scene
-                g_bRenderVeryEarlyObjects = true;
-            }
-	    }
-    }
-
-    // Now sort the list appropriately
-    switch(g_eGlobalSortOrder)
-    {
-		case E_SORT_BY_TEXTURE:
-			std::sort(g_ppSortedObjectList, g_ppSortedObjectList + g_iSortedObjectCount, OrderByTexture() );
-			break;
-		case E_SORT_BY_OBJECT:
-			std::sort(g_ppSortedObjectList, g_ppSortedObjectList + g_iSortedObjectCount, OrderByObject() );
-			break;
-		case E_SORT_BY_DEPTH:
-			// Delay sort until the visibility list is generated
-			// This increases the accuracy of the sorting for depth.
-			break;
-		case E_SORT_BY_NONE:
-			// No sort needed
-			break;
-		default:
-			break;
+		    // If this object is an early draw, set global flag to show we have one in the scene
+            g_bRenderVeryEarlyObjects = true;
+        }
 	}
 
 	// return back to caller
@@ -1566,6 +1605,7 @@ bool CObjectManager::SortTextureList ( void )
 //Dave Performance - used for shadows to ignore objects that are far away (relative to size) to stop them being considered for shadows
 extern bool g_bIgnoreFarObjects;
 extern int g_HideDistantShadows;
+extern cThreadPool* g_pThreadPool;
 bool waited = false;
 
 bool CObjectManager::SortVisibilityList ( void )
@@ -1591,7 +1631,10 @@ bool CObjectManager::SortVisibilityList ( void )
 
     // when the textures have been sorted we have a counter which stores
 	// the number of sorted objects, this is m_iSortedObjectCount, we now
-	// run through the sorted texture list and find which objects are visible
+	// run through the sorted texture list and gather the bounds of the objects
+	// that could be visible, the frustum and distance tests then run over
+	// all of them at once
+	m_VisibilityCullList.Clear();
 	for ( int iSort = 0; iSort < g_iSortedObjectCount; iSort++ )
 	{
 		// get a pointer to the object from the sorted draw list
@@ -1605,43 +1648,29 @@ bool CObjectManager::SortVisibilityList ( void )
 		// Dave Performance - this is used when sorting the list for shadow maps
 		// If the objects are a certain size and certain distance away we skip their shadow
 		// Smaller objects will drop their shadow earlier than larger ones
+		bool bColCenterUpdated = false;
 		if ( g_bIgnoreFarObjects )
 		{
 			// ensure have latest object center
 			if ( !pObject->bIsStatic )
 			{
 				if ( pObject->bUniverseVisible )
+				{
 					UpdateColCenter ( pObject );
+					bColCenterUpdated = true;
+				}
 				else
 					continue;
 			}
-
-			// get center of the object
-			GGVECTOR3 vecRealCenter = pObject->position.vecPosition + pObject->collision.vecColCenter;
-
-			// work out distance and recommended disappearance distance
-			float dx = CameraPositionX( g_pGlob->dwCurrentSetCameraID ) - vecRealCenter.x;
-			float dy = CameraPositionY( g_pGlob->dwCurrentSetCameraID ) - vecRealCenter.y;
-			float dz = CameraPositionZ( g_pGlob->dwCurrentSetCameraID ) - vecRealCenter.z;
-			float dist = sqrtf ( dx*dx + dy*dy + dz*dz );
-			float dmax = 1000;
-			if ( g_HideDistantShadows == 1 )
-			{
-				// default from V1.14 small and large entity shadows culled from vis list
-				if ( pObject->collision.fScaledLargestRadius > 100 ) dmax = 1500;
-				if ( pObject->collision.fScaledLargestRadius > 300 ) dmax = 2500; // 070216 - was 150
-				if ( pObject->collision.fScaledLargestRadius > 500 ) dmax = 4000;
-			}
-			if ( g_HideDistantShadows == 2 )
-			{
-				// protect larger structures from being removed from vis list
-				if ( pObject->collision.fScaledLargestRadius > 200 ) dmax = 8000;
-			}
-			if ( dist > dmax ) continue;
 		}
 
+		// get center of the object for the distance rule
+		GGVECTOR3 vecDistanceCenter = pObject->position.vecPosition + pObject->collision.vecColCenter;
+
 		// VISIBILITY CULLING CHECK PROCESS
-		bool bIsVisible=false;
+		int iCullFlags = 0;
+		GGVECTOR3 vecRealCenter = GGVECTOR3 ( 0, 0, 0 );
+		float fFinalRadiusForVisCull = 0.0f;
 
 		// 20120307 IRM
 		// If the object is a parent to an instance and is animating, then always
@@ -1649,7 +1678,7 @@ bool CObjectManager::SortVisibilityList ( void )
 		// This is true even if the object is off-screen, hidden or even excluded.
 		if (pObject->position.bParentOfInstance && pObject->bAnimPlaying)
 		{
-			bIsVisible = true;
+			iCullFlags = VISCULL_ALWAYS_VISIBLE;
 		}
 		else
 		{
@@ -1673,30 +1702,31 @@ bool CObjectManager::SortVisibilityList ( void )
 						pObject->position.bGlued		= false;
 						pObject->position.iGluedToObj	= 0;
 						pObject->position.iGluedToMesh	= 0;
+						g_SceneBVH.markDirty ( pObject );
 					}
 				}
 
 				// locked objects and glued are visible
-				bIsVisible=true;
+				iCullFlags = VISCULL_ALWAYS_VISIBLE;
 			}
 			else
 			{
-				// send the position of the object and it's radius to the "CheckSphere" function, if this returns true the object will be visible
+				// the position of the object and it's radius go to the frustum test, as CheckSphere
 				float fScaledRadius = pObject->collision.fScaledLargestRadius;
 				if ( fScaledRadius<=0.0f )
 				{
 					// objects with no mesh scope are visible
-					bIsVisible=true;
+					iCullFlags = VISCULL_ALWAYS_VISIBLE;
 				}
 				else
 				{
 					// ensure have latest object center
 					// only do this is the object is not static
-					if ( !pObject->bIsStatic )
+					if ( !pObject->bIsStatic && !bColCenterUpdated )
 						UpdateColCenter ( pObject );
 
 					// get center of the object
-					GGVECTOR3 vecRealCenter = pObject->position.vecPosition + pObject->collision.vecColCenter;
+					vecRealCenter = pObject->position.vecPosition + pObject->collision.vecColCenter;
 
 					// leeadd - 100805 - add in offset from first frame (limb zero), as this moves whole object render)
 					if ( pActualObject->ppFrameList )
@@ -1716,20 +1746,41 @@ bool CObjectManager::SortVisibilityList ( void )
 					}
 
 					// to avoid ugly clipping issues, double radius for objects that are anim-shifted
-					float fFinalRadiusForVisCull = fScaledRadius * 2.0f;
-
-					// objects within frustrum are visible
-					if ( CheckSphere ( vecRealCenter.x, vecRealCenter.y, vecRealCenter.z, fFinalRadiusForVisCull ) )
-						bIsVisible=true;
+					// plus the epsilon CheckSphere adds so the object does not disappear too early
+					fFinalRadiusForVisCull = fScaledRadius * 2.0f;
+					fFinalRadiusForVisCull *= 1.25f;
 				}
 			}
 		}
 
-		// determine visiblity
-
 		// MIKE - 021203 - added in second part of if statement for external objects, physics DLL
-		if ( bIsVisible || pObject->bDisableTransform == true )
+		if ( pObject->bDisableTransform == true )
+			iCullFlags |= VISCULL_ALWAYS_VISIBLE;
+
+		float fCenter [ 3 ] = { vecRealCenter.x, vecRealCenter.y, vecRealCenter.z };
+		float fDistanceCenter [ 3 ] = { vecDistanceCenter.x, vecDistanceCenter.y, vecDistanceCenter.z };
+		m_VisibilityCullList.Add ( pObject, fCenter, fFinalRadiusForVisCull, fDistanceCenter, pObject->collision.fScaledLargestRadius, iCullFlags );
+	}
+
+	// frustum of this camera and, when sorting for shadows, the distance each object drops its shadow at
+	sVisibilityCullView view;
+	float fCameraX = 0.0f, fCameraY = 0.0f, fCameraZ = 0.0f;
+	if ( g_bIgnoreFarObjects )
+	{
+		fCameraX = CameraPositionX( g_pGlob->dwCurrentSetCameraID );
+		fCameraY = CameraPositionY( g_pGlob->dwCurrentSetCameraID );
+		fCameraZ = CameraPositionZ( g_pGlob->dwCurrentSetCameraID );
+	}
+	SetVisibilityCullView ( &view, g_Planes [ 0 ], fCameraX, fCameraY, fCameraZ, g_bIgnoreFarObjects, g_HideDistantShadows );
+	CullVisibilityList ( m_VisibilityCullList, &view, 1, &m_vVisibilityCullResults, g_pThreadPool );
+
+	// determine visiblity
+	for ( int iCull = 0; iCull < m_VisibilityCullList.iCount; iCull++ )
+	{
+		if ( m_vVisibilityCullResults [ iCull ] )
 		{
+			sObject* pObject = m_VisibilityCullList.objects [ iCull ];
+
 			// save a pointer to the object and place it in the new drawlist
 			m_ppSortedObjectVisibleList [ m_iVisibleObjectCount++ ] = pObject;
 
@@ -1773,9 +1824,9 @@ bool CObjectManager::SortVisibilityList ( void )
     {
         // No ghost/transparent sort just yet - still need to take into account water -
         //but do need to sort everything else.
-        std::sort( m_vVisibleObjectEarly.begin(), m_vVisibleObjectEarly.end(), OrderByReverseCameraDistance() );
-        std::sort( m_vVisibleObjectNoZDepth.begin(), m_vVisibleObjectNoZDepth.end(), OrderByReverseCameraDistance() );
-        std::sort( m_vVisibleObjectStandard.begin(), m_vVisibleObjectStandard.end(), OrderByReverseCameraDistance() );
+        m_RenderQueue.SortByReverseDistance ( m_vVisibleObjectEarly );
+        m_RenderQueue.SortByReverseDistance ( m_vVisibleObjectNoZDepth );
+        m_RenderQueue.SortByReverseDistance ( m_vVisibleObjectStandard );
     }
 
 	// all went okay
@@ -1786,12 +1837,20 @@ bool CObjectManager::UpdateTextures ( void )
 {
 	// clear tep list immediately as now invalid
 	g_vAnimatableObjectList.clear();
+	m_vAnimatableObjectIDs.clear();
 
 	// triggers texture list update
 	m_bUpdateTextureList=true;
 	return true;
 }
 
+bool CObjectManager::UpdateTextures ( sObject* pObject )
+{
+	// sorted back in at the next SortTextureList
+	if ( pObject ) m_RenderQueue.MarkObject ( pObject->dwObjectNumber );
+	return true;
+}
+
 void CObjectManager::UpdateAnimationCyclePerObject ( sObject* pObject )
 {
 	// simply control animation frame
@@ -1858,6 +1917,7 @@ void CObjectManager::UpdateAnimationCyclePerObject ( sObject* pObject )
 				pObject->collision.vecMax = pObject->pAnimationSet->pvecBoundMax [ iThisKeyFrame ];
 				pObject->collision.vecCentre = pObject->pAnimationSet->pvecBoundCenter [ iThisKeyFrame ];
 				pObject->collision.fRadius = pObject->pAnimationSet->pfBoundRadius [ iThisKeyFrame ];
+				g_SceneBVH.markDirty ( pObject );
 			}
 		}
 		if ( pObject->ppMeshList )
@@ -1872,6 +1932,9 @@ void CObjectManager::UpdateAnimationCyclePerObject ( sObject* pObject )
 
 bool CObjectManager::UpdateAnimationCycle ( void )
 {
+	// start a new frame of pose cache statistics
+	NewAnimationPoseCacheFrame ( );
+
 	// lee - 300914 - new way only runs through object list of known objects with animations
 	if ( !g_vAnimatableObjectList.empty() )
     {
@@ -1936,6 +1999,12 @@ void CObjectManager::UpdateOneVisibleObject ( sObject* pObject )
 		if ( pObject->position.bCustomBoneMatrix==false ) UpdateFrame ( pObject->pFrame, &matrix );
 	}
 
+	// animate meshes from the new frame matrices
+	UpdateOneVisibleObjectAnimation ( pObject );
+}
+
+void CObjectManager::UpdateOneVisibleObjectAnimation ( sObject* pObject )
+{
 	// moved this code to DBOFormat.cpp - handle vertex level animation (even if not animating)
 	// instances that use animating objects must animate them indirectly
 	sObject* pActualObject = pObject;
@@ -1966,6 +2035,7 @@ bool CObjectManager::UpdateOnlyVisible ( void )
 	// lee - 300914 - this may MISS some objects such as manually limb adjusted objects down the road!
 	if ( !g_vAnimatableObjectList.empty() )
     {
+		m_vFrameUpdateList.clear();
         for ( DWORD iIndex = 0; iIndex < g_vAnimatableObjectList.size(); ++iIndex )
         {
 			// get mesh to refresh
@@ -1979,9 +2049,44 @@ bool CObjectManager::UpdateOnlyVisible ( void )
 				if ( pObject->bVisible==false || pObject->bUniverseVisible==false ) //|| pObject->bExcludedEarly )
 					continue;
 			}
+			m_vFrameUpdateList.push_back ( pObject );
+		}
 
-			// go and update object frames
-			UpdateOneVisibleObject ( pObject );
+		// bring all frame data up to date first so the frame trees of every object can
+		// be combined together across the thread pool. Spine center objects move their
+		// limbs between two frame updates so are still done one at a time below
+		m_vFrameHierarchyList.clear();
+		for ( DWORD iIndex = 0; iIndex < m_vFrameUpdateList.size(); ++iIndex )
+		{
+			sObject* pObject = m_vFrameUpdateList [ iIndex ];
+			if ( pObject->bUseSpineCenterSystem == true ) continue;
+			UpdateAllFrameData ( pObject, pObject->fAnimFrame );
+			if ( pObject->position.bCustomBoneMatrix==true ) continue;
+			sFrameHierarchy* pHierarchy = GetFrameHierarchy ( pObject->pFrame );
+			if ( pHierarchy )
+				m_vFrameHierarchyList.push_back ( pHierarchy );
+			else
+			{
+				GGMATRIX matrix;
+				GGMatrixIdentity ( &matrix );
+				UpdateFrame ( pObject->pFrame, &matrix );
+			}
+		}
+		if ( !m_vFrameHierarchyList.empty() )
+		{
+			GGMATRIX matrix;
+			GGMatrixIdentity ( &matrix );
+			UpdateFrameHierarchies ( &m_vFrameHierarchyList [ 0 ], (int)m_vFrameHierarchyList.size(), &matrix );
+		}
+
+		// go and update object frames
+		for ( DWORD iIndex = 0; iIndex < m_vFrameUpdateList.size(); ++iIndex )
+		{
+			sObject* pObject = m_vFrameUpdateList [ iIndex ];
+			if ( pObject->bUseSpineCenterSystem == true )
+				UpdateOneVisibleObject ( pObject );
+			else
+				UpdateOneVisibleObjectAnimation ( pObject );
 		}
 	}
 
@@ -4755,14 +4860,15 @@ bool CObjectManager::DrawObject ( sObject* pObject, bool bFrustrumCullMeshes, bo
 				pObject->pInstanceMeshVisible [ pObject->iLOD0LimbIndex ] = false;
 				pObject->pInstanceMeshVisible [ pObject->iLOD1LimbIndex ] = false;
 				pObject->pInstanceMeshVisible [ pObject->iLOD2LimbIndex ] = false;
-				if ( pObject->position.fCamDistance > pObject->fLODDistance[1] )
+				int iLimbLOD = GetObjectLimbLOD ( pObject );
+				if ( iLimbLOD==2 )
 				{
 					// furthest
 					pObject->pInstanceMeshVisible [ pObject->iLOD2LimbIndex ] = true;
 				}
 				else
 				{
-					if ( pObject->position.fCamDistance > pObject->fLODDistance[0] )
+					if ( iLimbLOD==1 )
 					{
 						// mid-way
 						pObject->pInstanceMeshVisible [ pObject->iLOD1LimbIndex ] = true;
@@ -4854,14 +4960,15 @@ bool CObjectManager::DrawObject ( sObject* pObject, bool bFrustrumCullMeshes, bo
 							if ( pMeshLOD0 ) pMeshLOD0->bVisible = false;
 							if ( pMeshLOD1 ) pMeshLOD1->bVisible = false;
 							if ( pMeshLOD2 ) pMeshLOD2->bVisible = false;
-							if ( pObject->position.fCamDistance > pObject->fLODDistance[1] )
+							int iLimbLOD = GetObjectLimbLOD ( pObject );
+							if ( iLimbLOD==2 )
 							{
 								// furthest
 								if ( pMeshLOD2) pMeshLOD2->bVisible = true;
 							}
 							else
 							{
-								if ( pObject->position.fCamDistance > pObject->fLODDistance[0] )
+								if ( iLimbLOD==1 )
 								{
 									// mid-way
 									if ( pMeshLOD1 ) pMeshLOD1->bVisible = true;
@@ -5397,6 +5504,7 @@ float CObjectManager::CalculateObjectCenterDistanceFromCamera(sObject* pObject)
 		{
 			// Glued to an object that does not exist, so break the chain
 			pObject->position.iGluedToObj = 0;
+			g_SceneBVH.markDirty ( pObject );
 			break;
 		}
 
@@ -5458,6 +5566,7 @@ float CObjectManager::CalculateObjectDistanceFromCamera ( sObject* pObject )
         {
             // Glued to an object that does not exist, so break the chain
             pObject->position.iGluedToObj = 0;
+            g_SceneBVH.markDirty ( pObject );
             break;
         }
 
@@ -5701,8 +5810,8 @@ bool CObjectManager::UpdateLayerInner ( int iLayer )
 					pObject->position.fCamDistance += pObject->fArtificialDistanceOffset;
 				}
 
-				// u74b7 - sort objects by distance, replaced bubblesort with STL sort
-				std::sort(m_vVisibleObjectTransparent.begin(), m_vVisibleObjectTransparent.end(), OrderByReverseCameraDistance());
+				// u74b7 - sort objects by distance, replaced bubblesort with STL sort, now radix sorted draw keys
+				m_RenderQueue.SortByReverseDistance ( m_vVisibleObjectTransparent );
 			}
 
             // draw in correct back to front order
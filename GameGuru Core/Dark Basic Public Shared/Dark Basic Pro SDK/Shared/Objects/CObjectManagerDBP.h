@@ -10,6 +10,8 @@
 //////////////////////////////////////////////////////////////////////////////////
 #include "cObjectDataC.h"
 #include ".\..\Camera\cCameraDataC.h"
+#include "VisibilityCull.h"
+#include "RenderQueue.h"
 #include <vector>
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -149,6 +151,14 @@ class CObjectManager
         std::vector< sObject* >     m_vVisibleObjectTransparent;
         std::vector< sObject* >     m_vVisibleObjectNoZDepth;
         std::vector< sObject* >     m_vVisibleObjectStandard;
+        std::vector< sObject* >     m_vFrameUpdateList;				// objects UpdateOnlyVisible is updating
+        std::vector< sFrameHierarchy* > m_vFrameHierarchyList;		// their frame trees, combined together
+        sVisibilityCullList         m_VisibilityCullList;			// objects SortVisibilityList is testing
+        std::vector< unsigned char > m_vVisibilityCullResults;		// and which of them are visible
+        cRenderQueue                m_RenderQueue;					// g_ppSortedObjectList in draw key order
+        std::vector< int >          m_vRenderQueueIDs;				// objects being sorted back in
+        std::vector< int >          m_vAnimatableObjectIDs;			// numbers of g_vAnimatableObjectList
+        std::vector< unsigned char > m_vAnimatableObjectMarks;
 
 		sRenderStates				m_RenderStates;					// global render state settings
 		bool						m_bGlobalShadows;				// not used any more
@@ -160,6 +170,8 @@ class CObjectManager
 		sIndexData*		FindIndexBuffer			( DWORD dwIndexCount, bool bUsesItsOwnBuffers );
 		void			ResetIBRef				(void);
 		bool			SortTextureList			( void );
+		void			QueueObject				( int iObjectID );
+		void			RemoveFromAnimatableList ( const std::vector<int>& ids );
 		bool			SortVisibilityList		( void );
 		bool			PreSceneSettings		( void );
 		bool			PreDrawSettings			( void );
@@ -229,9 +241,13 @@ class CObjectManager
 
 		bool UpdateObjectListSize			( int iSize );				// updates object list size
 		bool UpdateTextures					( void );
+		bool UpdateTextures					( sObject* pObject );		// only this object and its instances need sorting again
+		void AddToRenderQueue				( int iObjectID );
+		void RemoveFromRenderQueue			( int iObjectID );
 		void UpdateAnimationCyclePerObject	( sObject* pObject );
 		bool UpdateAnimationCycle			( void );
 		void UpdateOneVisibleObject			( sObject* pObject );
+		void UpdateOneVisibleObjectAnimation	( sObject* pObject );
 		bool UpdateOnlyVisible				( void );
 
 		void SetGlobalShadowsOn				( void );
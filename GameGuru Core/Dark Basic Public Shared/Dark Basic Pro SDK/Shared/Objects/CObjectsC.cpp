@@ -13,6 +13,9 @@
 #include <algorithm>
 #include "ShadowMapping\cShadowMaps.h"
 #include "CFileC.h"
+#include "SceneBVH.h"
+#include "cThreadPool.h"
+#include ".\..\DBOFormat\DBOClip.h"
 
 #ifndef DX11
 // Occlusion object global
@@ -48,6 +51,8 @@ struct OrderByCamDistance
     }
 };
 std::vector< sObject* > g_pIntersectShortList;
+std::vector< int > g_pIntersectCandidates;
+extern cThreadPool* g_pThreadPool;
 
 // Global to store a second range of objects for IntersectAll special mode
 int g_iIntersectAllSecondStart = 0;
@@ -956,6 +961,21 @@ DARKSDK_DLL void SaveObject (LPSTR szFilename, int iID)
 	SaveObjectEx (szFilename, iID, false);
 }
 
+DARKSDK_DLL void SetObjectLoadMapped ( int iMode )
+{
+	// 1-DBO files are mapped and meshes use aligned vertex and index data in place,
+	// holding the file open while they do, 0-files are read into memory and copied
+	g_iDBOMappedLoadMode = iMode;
+}
+
+DARKSDK_DLL void AlignObjectFile ( LPSTR szFilename, LPSTR szNewFilename )
+{
+	// rewrite an existing DBO with aligned data so mapped loads can use it in place
+	if ( szFilename==NULL || szNewFilename==NULL )
+		return;
+	AlignDBO ( szFilename, szNewFilename );
+}
+
 DARKSDK_DLL void SetDeleteCallBack ( int iID, ON_OBJECT_DELETE_CALLBACK pfn, int userData )
 {
 	// mike - 050803 - delete object override
@@ -1073,8 +1093,7 @@ DARKSDK_DLL void DeleteObject ( int iID )
 		m_ObjectManager.AddFlaggedObjectsBackToBuffers ();
 	}
 
-	// update
-	m_ObjectManager.UpdateTextures();
+	// the render queue was told when the object left the list
 }
 
 DARKSDK_DLL void DeleteObjects ( int iFrom, int iTo )
@@ -1111,8 +1130,7 @@ DARKSDK_DLL void DeleteObjects ( int iFrom, int iTo )
 	// upon buffer removal, some object where flagged for re-creation
 	m_ObjectManager.AddFlaggedObjectsBackToBuffers ();
 
-	// update texture list when introduce new object(s)
-	m_ObjectManager.UpdateTextures();
+	// the render queue was told when the objects left the list
 }
 
 DARKSDK_DLL void ClearObjectsOfTextureRef ( LPGGTEXTURE pTextureRef )
@@ -3309,6 +3327,48 @@ DARKSDK_DLL void SetObjectAnimationMode ( int iID, int iMode )
 	RunTimeError(RUNTIMEERROR_COMMANDNOWOBSOLETE);
 }
 
+DARKSDK_DLL void SetAnimationClipMode ( int iMode )
+{
+	// 1-animate objects from baked clips (resampled, compressed), 0-read the original keys
+	g_iAnimationClipMode = iMode;
+}
+
+DARKSDK_DLL void SetAnimationPoseCache ( int iMode, float fFrameQuantum )
+{
+	// 1-objects playing the same clip at frames within fFrameQuantum share one evaluated pose
+	// (uses baked clips), 0-each object evaluates its own. Quantum 0 shares only identical frames
+	if ( fFrameQuantum < 0.0f ) fFrameQuantum = 0.0f;
+	if ( g_fAnimationPoseCacheQuantum != fFrameQuantum || iMode == 0 ) ClearAnimationPoseCache ( );
+	g_iAnimationPoseCacheMode = iMode;
+	g_fAnimationPoseCacheQuantum = fFrameQuantum;
+}
+
+DARKSDK_DLL int GetAnimationPoseCacheStat ( int iIndex )
+{
+	// see ANIMPOSE_STAT_ values in DBOClip.h
+	if ( iIndex < 0 || iIndex >= ANIMPOSE_STAT_COUNT ) return 0;
+	return (int)g_dwAnimationPoseStats [ iIndex ];
+}
+
+DARKSDK_DLL int GetAnimationPoseCacheHitRate ( void )
+{
+	// percentage of pose requests served from the cache since it was last cleared
+	DWORD dwHits = g_dwAnimationPoseStats [ ANIMPOSE_STAT_TOTALHITS ] + g_dwAnimationPoseStats [ ANIMPOSE_STAT_HITS ];
+	DWORD dwMisses = g_dwAnimationPoseStats [ ANIMPOSE_STAT_TOTALMISSES ] + g_dwAnimationPoseStats [ ANIMPOSE_STAT_MISSES ];
+	if ( dwHits + dwMisses == 0 ) return 0;
+	return (int)( ( (double)dwHits * 100.0 ) / ( dwHits + dwMisses ) );
+}
+
+DARKSDK_DLL int GetObjectAnimationClipMemory ( int iID )
+{
+	// size in bytes of the baked clip for this object, shared with its clones
+	if ( !ConfirmObjectInstance ( iID ) )
+		return 0;
+	sObject* pObject = g_ObjectList [ iID ];
+	if ( pObject->pInstanceOfObject ) pObject = pObject->pInstanceOfObject;
+	return (int)GetAnimationClipMemory ( GetAnimationClip ( pObject->pAnimationSet ) );
+}
+
 // Visual Commands
 
 DARKSDK_DLL void AddVisibilityListMask ( int iID )
@@ -3520,6 +3580,8 @@ DARKSDK_DLL void UnGlueObject ( int iSource )
 		}
 	}
 
+	// glued objects are range checked from their parent by intersect all
+	g_SceneBVH.markDirty ( pSourceObject );
 }
 
 DARKSDK_DLL void UnGlueAllObjects ( void )
@@ -3564,6 +3626,7 @@ DARKSDK_DLL void UnGlueAllObjects ( void )
 				pSourceObject->position.bGlued			= false;
 				pSourceObject->position.iGluedToObj		= 0;
 				pSourceObject->position.iGluedToMesh	= 0;
+				g_SceneBVH.markDirty ( pSourceObject );
 			}
 		}
 	}
@@ -3987,7 +4050,7 @@ DARKSDK_DLL void TextureObject ( int iID, int iImage )
 	
 	// trigger a ew-new and re-sort
 	m_ObjectManager.RenewReplacedMeshes ( pObject );
-	m_ObjectManager.UpdateTextures ( );
+	m_ObjectManager.UpdateTextures ( pObject );
 	g_pGlob->dwInternalFunctionCode=12002;
 
 }
@@ -4015,7 +4078,7 @@ DARKSDK_DLL void SetObjectTextureStageEx ( int iID, int iStage, int iImage, int
 	m_ObjectManager.RenewReplacedMeshes ( pObject );
 
 	// res-sort textures only if flagged
-	if ( iDoNotSortTextures==0 ) m_ObjectManager.UpdateTextures ( );
+	if ( iDoNotSortTextures==0 ) m_ObjectManager.UpdateTextures ( pObject );
 	g_pGlob->dwInternalFunctionCode=11023;
 
 }
@@ -4050,7 +4113,7 @@ DARKSDK_DLL void TextureObjectMesh(int iID, int iStage, int iImage, int iDoNotSo
 	m_ObjectManager.RenewReplacedMeshes(pObject);
 
 	// res-sort textures only if flagged
-	if (iDoNotSortTextures == 0) m_ObjectManager.UpdateTextures();
+	if (iDoNotSortTextures == 0) m_ObjectManager.UpdateTextures(pObject);
 	g_pGlob->dwInternalFunctionCode = 11023;
 }
 
@@ -7182,6 +7245,114 @@ DARKSDK_DLL int IntersectAll_OLD ( int iPrimaryStart, int iPrimaryEnd, float fX,
 	return iHitValue;
 }
 
+// the checks IntersectAllEx makes on each object before testing its polygons, true when the
+// object can be hit and the ray passes through its collision box (expanded in the Y)
+static bool IntersectAllShortListCheck ( sObject* pObject, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ, float fDistanceBetweenPoints, int iIgnoreObjNo, bool bIgnoreCollisionProperty )
+{
+	// check if object is excluded
+	// check if object in dead state (non collisin detectable)
+	if ( bIgnoreCollisionProperty == true)
+	{
+		// do not reject based on collision property if this flag set
+		if (pObject->dwObjectNumber == iIgnoreObjNo || !pObject->bVisible)
+			return false;
+	}
+	else
+	{
+		if (pObject->dwObjectNumber == iIgnoreObjNo || pObject->collision.dwCollisionPropertyValue == 1 || !pObject->bVisible)
+			return false;
+	}
+
+	// check if object in same 'region' as ray
+	float fDX=0, fDY=0, fDZ=0;
+	if ( pObject->position.iGluedToObj>0 )
+	{
+		// use parent object instead
+		sObject* pParentObject = g_ObjectList [ pObject->position.iGluedToObj ];
+		if ( pParentObject )
+		{
+			fDX = pParentObject->position.vecPosition.x - fX;
+			fDY = pParentObject->position.vecPosition.y - fY;
+			fDZ = pParentObject->position.vecPosition.z - fZ;
+		}
+	}
+	else
+	{
+		fDX = pObject->position.vecPosition.x - fX;
+		fDY = pObject->position.vecPosition.y - fY;
+		fDZ = pObject->position.vecPosition.z - fZ;
+	}
+	float fDist = sqrt((fDX*fDX)+(fDY*fDY)+(fDZ*fDZ));
+	if ( fDist <= ((pObject->collision.fLargestRadius*3)+fDistanceBetweenPoints) )
+	{
+		// 110919 - ensure any offset applied to frame zero is accounted for (OFFSETX/Y/Z)
+		GGMATRIX matWorldWithFrameOffset = pObject->position.matWorld;
+
+		//PE: ppFrameList[0]->matAbsoluteWorld is wrong on some objects.
+		//sObject* pActualObj = pObject;
+
+		//PE: @Lee how do i extract the Offset x,y,z and what is it used for ?
+		//PE: We cant use matAbsoluteWorld as it has inverse settings -1 (on some objects), and the collision check dont work.
+		//if (pObject->pInstanceOfObject) pActualObj = pObject->pInstanceOfObject;
+		//if (pActualObj->ppFrameList[0]) {
+		//	matWorldWithFrameOffset = pActualObj->ppFrameList[0]->matAbsoluteWorld;
+		//}
+
+		// Please validate this will fix, https://github.com/TheGameCreators/GameGuruRepo/issues/724#issuecomment-606155967
+		// PE: @Lee , why do we need matWorldWithFrameOffset = pActualObj->ppFrameList[0]->matAbsoluteWorld; ?? ? ??
+		// PE: We need the original object position to generate the correct vecFrom
+		// LB: Looks good!
+
+		matWorldWithFrameOffset._41 = pObject->position.matWorld._41;
+		matWorldWithFrameOffset._42 = pObject->position.matWorld._42;
+		matWorldWithFrameOffset._43 = pObject->position.matWorld._43;
+
+		// instead of transforming box to object world orientation, transform ray
+		// on a per object basis back into object space, for quicker box checking
+		float fDet;
+		GGMATRIX matInvWorld;
+		GGMatrixInverse(&matInvWorld,&fDet,&matWorldWithFrameOffset);//pObject->position.matWorld);
+		GGVECTOR3 vecFrom = GGVECTOR3(fX,fY,fZ);
+		GGVECTOR3 vecTo = GGVECTOR3(fNewX,fNewY,fNewZ);
+		GGVec3TransformCoord(&vecFrom,&vecFrom,&matInvWorld);
+		GGVec3TransformCoord(&vecTo,&vecTo,&matInvWorld);
+		IntersectRay transformedray;
+		transformedray.origin[0] = vecFrom.x;
+		transformedray.origin[1] = vecFrom.y;
+		transformedray.origin[2] = vecFrom.z;
+		transformedray.direction[0] = vecTo.x-vecFrom.x;
+		transformedray.direction[1] = vecTo.y-vecFrom.y;
+		transformedray.direction[2] = vecTo.z-vecFrom.z;
+		transformedray.direction[0] /= fDistanceBetweenPoints;
+		transformedray.direction[1] /= fDistanceBetweenPoints;
+		transformedray.direction[2] /= fDistanceBetweenPoints;
+
+		// get half height size of object bounds to create larger bounbox detection area in the Y
+		float fHeightSize = pObject->collision.vecMax.y - pObject->collision.vecMin.y;
+		if ( fHeightSize < 0 ) fHeightSize = -fHeightSize;
+		fHeightSize *= 0.5f;
+
+		// check if ray intersects object bound box (ray vs box) [using object space]
+		IntersectBox box;
+		box.min[0] = pObject->collision.vecMin.x;
+		// 010318 - seems my code to expand the boundbox does not work if min is 30 and max is 52!
+		//box.min[1] = pObject->collision.vecMin.y * 2; // 240817 - object global bounds for some characters can be off, so increase to compensate
+		box.min[1] = pObject->collision.vecMin.y-fHeightSize; // 240817 - object global bounds for some characters can be off, so increase to compensate
+		box.min[2] = pObject->collision.vecMin.z;
+		box.max[0] = pObject->collision.vecMax.x;
+		// 010318 - seems my code to expand the boundbox does not work if min is 30 and max is 52!
+		//box.max[1] = pObject->collision.vecMax.y * 2; // 240817 - object global bounds for some characters can be off, so increase to compensate
+		box.max[1] = pObject->collision.vecMax.y+fHeightSize; // 240817 - object global bounds for some characters can be off, so increase to compensate
+		box.max[2] = pObject->collision.vecMax.z;
+		int tnear, tfar;
+		if ( intersectRayAABox2(transformedray, box, tnear, tfar)==true )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 //Dave Performance
 //Previous intersect all is above, incase of issues
 //This version combines the orignal method with the shortlist of boxes checked to provide the best of both versions
@@ -7261,120 +7432,38 @@ DARKSDK_DLL int IntersectAllEx ( int iPrimaryStart, int iPrimaryEnd, float fX, f
 	// go through all objects and collect a shortlist of boxes intersected by ray
 	// DAVE: Good point :D
 	g_pIntersectShortList.clear();
+
+	// the scene tree narrows the objects down to those the ray could reach, the
+	// checks below are still made on each of them so the shortlist is unchanged
+	if ( g_SceneBVH.getObjectCount() != g_iObjectListRefCount )
+		g_SceneBVH.sync ( g_ObjectListRef, g_iObjectListRefCount );
+	float fRayStart[3] = { fX, fY, fZ };
+	float fRayEnd[3] = { fNewX, fNewY, fNewZ };
+	g_pIntersectCandidates.clear();
+	bool bUseSceneBVH = g_SceneBVH.gatherCandidates ( fRayStart, fRayEnd, g_pIntersectCandidates );
+	if ( bUseSceneBVH ) std::sort ( g_pIntersectCandidates.begin(), g_pIntersectCandidates.end() );
+
 	for ( int iPass=0; iPass<3; iPass++ )
 	{
 		int iStart, iEnd;
 		if ( iPass==0 ) { iStart=iPrimaryStart; iEnd=iPrimaryEnd; }
 		if ( iPass==1 ) { iStart=g_iIntersectAllSecondStart; iEnd=g_iIntersectAllSecondEnd; }
 		if ( iPass==2 ) { iStart=g_iIntersectAllThirdStart; iEnd=g_iIntersectAllThirdEnd; if ( iStart == 0 ) break; }
-		for ( int iObjectID = iStart; iObjectID <= iEnd; iObjectID++ )
+		int iCount = bUseSceneBVH ? (int)g_pIntersectCandidates.size() : (iEnd-iStart)+1;
+		for ( int iIndex = 0; iIndex < iCount; iIndex++ )
 		{
+			int iObjectID = bUseSceneBVH ? g_pIntersectCandidates [ iIndex ] : iStart+iIndex;
+			if ( iObjectID < iStart || iObjectID > iEnd )
+				continue;
+
 			// make sure we have a valid object
 			sObject* pObject = g_ObjectList [ iObjectID ];
 			if ( !pObject ) 
 				continue;
 
-			// check if object is excluded
-			// check if object in dead state (non collisin detectable)
-			if ( g_bIgnoreCollisionPropertyOnce == true)
-			{
-				// do not reject based on collision property if this flag set
-				if (pObject->dwObjectNumber == iIgnoreObjNo || !pObject->bVisible)
-					continue;
-			}
-			else
-			{
-				if (pObject->dwObjectNumber == iIgnoreObjNo || pObject->collision.dwCollisionPropertyValue == 1 || !pObject->bVisible)
-					continue;
-			}
-
-			// check if object in same 'region' as ray
-			float fDX=0, fDY=0, fDZ=0;
-			if ( pObject->position.iGluedToObj>0 )
-			{
-				// use parent object instead
-				sObject* pParentObject = g_ObjectList [ pObject->position.iGluedToObj ];
-				if ( pParentObject )
-				{
-					fDX = pParentObject->position.vecPosition.x - fX;
-					fDY = pParentObject->position.vecPosition.y - fY;
-					fDZ = pParentObject->position.vecPosition.z - fZ;
-				}
-			}
-			else
-			{
-				fDX = pObject->position.vecPosition.x - fX;
-				fDY = pObject->position.vecPosition.y - fY;
-				fDZ = pObject->position.vecPosition.z - fZ;
-			}
-			float fDist = sqrt((fDX*fDX)+(fDY*fDY)+(fDZ*fDZ));
-			if ( fDist <= ((pObject->collision.fLargestRadius*3)+fDistanceBetweenPoints) )
-			{
-				// 110919 - ensure any offset applied to frame zero is accounted for (OFFSETX/Y/Z)
-				GGMATRIX matWorldWithFrameOffset = pObject->position.matWorld;
-
-				//PE: ppFrameList[0]->matAbsoluteWorld is wrong on some objects.
-				//sObject* pActualObj = pObject;
-
-				//PE: @Lee how do i extract the Offset x,y,z and what is it used for ?
-				//PE: We cant use matAbsoluteWorld as it has inverse settings -1 (on some objects), and the collision check dont work.
-				//if (pObject->pInstanceOfObject) pActualObj = pObject->pInstanceOfObject;
-				//if (pActualObj->ppFrameList[0]) {
-				//	matWorldWithFrameOffset = pActualObj->ppFrameList[0]->matAbsoluteWorld;
-				//}
-
-				// Please validate this will fix, https://github.com/TheGameCreators/GameGuruRepo/issues/724#issuecomment-606155967
-				// PE: @Lee , why do we need matWorldWithFrameOffset = pActualObj->ppFrameList[0]->matAbsoluteWorld; ?? ? ??
-				// PE: We need the original object position to generate the correct vecFrom
-				// LB: Looks good!
-
-				matWorldWithFrameOffset._41 = pObject->position.matWorld._41;
-				matWorldWithFrameOffset._42 = pObject->position.matWorld._42;
-				matWorldWithFrameOffset._43 = pObject->position.matWorld._43;
-
-				// instead of transforming box to object world orientation, transform ray
-				// on a per object basis back into object space, for quicker box checking
-				float fDet;
-				GGMATRIX matInvWorld;
-				GGMatrixInverse(&matInvWorld,&fDet,&matWorldWithFrameOffset);//pObject->position.matWorld);
-				GGVECTOR3 vecFrom = GGVECTOR3(fX,fY,fZ);
-				GGVECTOR3 vecTo = GGVECTOR3(fNewX,fNewY,fNewZ);
-				GGVec3TransformCoord(&vecFrom,&vecFrom,&matInvWorld);
-				GGVec3TransformCoord(&vecTo,&vecTo,&matInvWorld);
-				IntersectRay transformedray;
-				transformedray.origin[0] = vecFrom.x;
-				transformedray.origin[1] = vecFrom.y;
-				transformedray.origin[2] = vecFrom.z;
-				transformedray.direction[0] = vecTo.x-vecFrom.x;
-				transformedray.direction[1] = vecTo.y-vecFrom.y;
-				transformedray.direction[2] = vecTo.z-vecFrom.z;
-				transformedray.direction[0] /= fDistanceBetweenPoints;
-				transformedray.direction[1] /= fDistanceBetweenPoints;
-				transformedray.direction[2] /= fDistanceBetweenPoints;
-
-				// get half height size of object bounds to create larger bounbox detection area in the Y
-				float fHeightSize = pObject->collision.vecMax.y - pObject->collision.vecMin.y;
-				if ( fHeightSize < 0 ) fHeightSize = -fHeightSize;
-				fHeightSize *= 0.5f;
-
-				// check if ray intersects object bound box (ray vs box) [using object space]
-				IntersectBox box;
-				box.min[0] = pObject->collision.vecMin.x;
-				// 010318 - seems my code to expand the boundbox does not work if min is 30 and max is 52!
-				//box.min[1] = pObject->collision.vecMin.y * 2; // 240817 - object global bounds for some characters can be off, so increase to compensate
-				box.min[1] = pObject->collision.vecMin.y-fHeightSize; // 240817 - object global bounds for some characters can be off, so increase to compensate
-				box.min[2] = pObject->collision.vecMin.z;
-				box.max[0] = pObject->collision.vecMax.x;
-				// 010318 - seems my code to expand the boundbox does not work if min is 30 and max is 52!
-				//box.max[1] = pObject->collision.vecMax.y * 2; // 240817 - object global bounds for some characters can be off, so increase to compensate
-				box.max[1] = pObject->collision.vecMax.y+fHeightSize; // 240817 - object global bounds for some characters can be off, so increase to compensate
-				box.max[2] = pObject->collision.vecMax.z;
-				int tnear, tfar;
-				if ( intersectRayAABox2(transformedray, box, tnear, tfar)==true )
-				{
-					g_pIntersectShortList.push_back ( pObject );
-				}
-			}
+			// collect objects whose box is touched by the ray
+			if ( IntersectAllShortListCheck ( pObject, fX, fY, fZ, fNewX, fNewY, fNewZ, fDistanceBetweenPoints, iIgnoreObjNo, g_bIgnoreCollisionPropertyOnce ) )
+				g_pIntersectShortList.push_back ( pObject );
 		}
 	}
 
@@ -7508,6 +7597,298 @@ DARKSDK_DLL int IntersectAll(int iPrimaryStart, int iPrimaryEnd, float fX, float
 	return IntersectAllEx(iPrimaryStart, iPrimaryEnd, fX, fY, fZ, fNewX, fNewY, fNewZ, iIgnoreObjNo, 0);
 }
 
+// Ray batches
+
+// working data for the rays of a batch, kept between batches to reuse the memory
+struct sRayBatchObject
+{
+	sObject* pObject;
+	bool bCaptured;
+	int iFirstFrame;
+	int iFrameCount;
+};
+struct sRayBatchHit
+{
+	int iObject;			// into g_RayBatchObjects
+	float fDistance;
+	GGVECTOR3 vecNormal;
+};
+struct sRayBatchScratch
+{
+	std::vector< int > candidates;
+	std::vector< int > traversal;
+};
+std::vector< int > g_RayBatchOrder;
+std::vector< DWORD > g_RayBatchKeys;
+std::vector< std::vector< sObject* > > g_RayBatchShortLists;
+std::vector< std::vector< sRayBatchHit > > g_RayBatchHits;
+std::vector< sRayBatchObject > g_RayBatchObjects;
+std::vector< int > g_RayBatchObjectOfID;
+std::vector< sRayCollisionFrame > g_RayBatchFrames;
+std::vector< sRayBatchScratch > g_RayBatchScratch;
+
+// rays submitted for the next flush and the results of the last one
+std::vector< sRayBatchQuery > g_RayBatchPending;
+std::vector< sRayBatchQuery > g_RayBatchFlushed;
+std::vector< sRayBatchResult > g_RayBatchResults;
+int g_iRayBatchNextTicket = 0;
+int g_iRayBatchFirstResultTicket = 0;
+
+static DWORD RayBatchCoherenceKey ( const sRayBatchQuery& query )
+{
+	// direction octant then a coarse cell of the ray start, rays sharing a key
+	// walk much the same nodes and meshes so they are given to the same worker
+	DWORD dwOctant = 0;
+	if ( query.fNewX < query.fX ) dwOctant |= 1;
+	if ( query.fNewY < query.fY ) dwOctant |= 2;
+	if ( query.fNewZ < query.fZ ) dwOctant |= 4;
+	DWORD dwCellX = (DWORD)(int)floorf ( query.fX / 500.0f ) & 0x3FF;
+	DWORD dwCellZ = (DWORD)(int)floorf ( query.fZ / 500.0f ) & 0x3FF;
+	return ( dwOctant << 20 ) | ( dwCellX << 10 ) | dwCellZ;
+}
+
+static bool RayBatchFilter ( const sRayBatchQuery& query, sObject* pObject )
+{
+	// false when the filters of the ray pass over the object
+	if ( query.iIgnoreSecondObjNo > 0 && (int)pObject->dwObjectNumber == query.iIgnoreSecondObjNo )
+		return false;
+	if ( ( query.dwFlags & RAYBATCH_SKIPGLUED ) && pObject->position.iGluedToObj > 0 )
+		return false;
+	if ( query.dwFlags & RAYBATCH_SKIPANIMATED )
+	{
+		sObject* pActualObject = pObject->pInstanceOfObject ? pObject->pInstanceOfObject : pObject;
+		if ( pActualObject->pAnimationSet && pObject->bIgnoreDefAnim==false )
+			return false;
+	}
+	return true;
+}
+
+template<class F>
+static void RayBatchParallel ( int iCount, int iGrain, F& func )
+{
+	// the editor runs without a thread pool
+	if ( g_pThreadPool )
+		g_pThreadPool->parallel_for ( 0, iCount, iGrain, func );
+	else
+		for ( int i = 0; i < iCount; i++ ) func ( i );
+}
+
+static sRayBatchScratch& RayBatchScratch ( void )
+{
+	// slot 0 is the calling thread, then one per pool worker
+	int iSlot = 0;
+	cThreadPoolWorkerInfo& worker = cThreadPoolCurrentWorker();
+	if ( g_pThreadPool && worker.pool == g_pThreadPool ) iSlot = worker.index + 1;
+	return g_RayBatchScratch [ iSlot ];
+}
+
+DARKSDK_DLL void IntersectAllBatch ( const sRayBatchQuery* pQueries, int iCount, sRayBatchResult* pResults )
+{
+	// Each ray gives the same object, distance and hit as IntersectAllEx would. The box checks and
+	// the polygon tests against static objects run on the thread pool, animated objects and objects
+	// using the box first check are tested on the calling thread as before
+	if ( iCount <= 0 )
+		return;
+
+	// bring the scene tree up to date so it can be queried from every thread
+	if ( g_SceneBVH.getObjectCount() != g_iObjectListRefCount )
+		g_SceneBVH.sync ( g_ObjectListRef, g_iObjectListRefCount );
+	g_SceneBVH.refit();
+
+	int iThreads = g_pThreadPool ? (int)g_pThreadPool->size() + 1 : 1;
+	if ( (int)g_RayBatchScratch.size() < iThreads ) g_RayBatchScratch.resize ( iThreads );
+	if ( (int)g_RayBatchShortLists.size() < iCount ) g_RayBatchShortLists.resize ( iCount );
+	if ( (int)g_RayBatchHits.size() < iCount ) g_RayBatchHits.resize ( iCount );
+
+	// coherent rays next to each other
+	g_RayBatchOrder.resize ( iCount );
+	g_RayBatchKeys.resize ( iCount );
+	for ( int i = 0; i < iCount; i++ )
+	{
+		g_RayBatchOrder [ i ] = i;
+		g_RayBatchKeys [ i ] = RayBatchCoherenceKey ( pQueries [ i ] );
+	}
+	std::sort ( g_RayBatchOrder.begin(), g_RayBatchOrder.end(), [] ( int a, int b )
+	{
+		if ( g_RayBatchKeys [ a ] != g_RayBatchKeys [ b ] ) return g_RayBatchKeys [ a ] < g_RayBatchKeys [ b ];
+		return a < b;
+	});
+
+	// shortlist of objects for each ray, as the first half of IntersectAllEx
+	auto buildShortList = [pQueries] ( int iOrder )
+	{
+		int iRay = g_RayBatchOrder [ iOrder ];
+		const sRayBatchQuery& query = pQueries [ iRay ];
+		std::vector< sObject* >& shortlist = g_RayBatchShortLists [ iRay ];
+		shortlist.clear();
+
+		GGVECTOR3 vec3value = GGVECTOR3(query.fX,query.fY,query.fZ) - GGVECTOR3(query.fNewX,query.fNewY,query.fNewZ);
+		float fDistanceBetweenPoints = GGVec3Length(&vec3value);
+		bool bIgnoreCollisionProperty = ( query.dwFlags & RAYBATCH_IGNORECOLLISIONPROPERTY ) != 0;
+
+		sRayBatchScratch& scratch = RayBatchScratch();
+		float fRayStart[3] = { query.fX, query.fY, query.fZ };
+		float fRayEnd[3] = { query.fNewX, query.fNewY, query.fNewZ };
+		scratch.candidates.clear();
+		bool bUseSceneBVH = g_SceneBVH.query ( fRayStart, fRayEnd, scratch.candidates, scratch.traversal );
+		if ( bUseSceneBVH ) std::sort ( scratch.candidates.begin(), scratch.candidates.end() );
+
+		for ( int iPass=0; iPass<3; iPass++ )
+		{
+			int iStart, iEnd;
+			if ( iPass==0 ) { iStart=query.iStart; iEnd=query.iEnd; }
+			if ( iPass==1 ) { iStart=query.iSecondStart; iEnd=query.iSecondEnd; if ( iStart == 0 ) continue; }
+			if ( iPass==2 ) { iStart=query.iThirdStart; iEnd=query.iThirdEnd; if ( iStart == 0 ) continue; }
+			int iRangeCount = bUseSceneBVH ? (int)scratch.candidates.size() : (iEnd-iStart)+1;
+			for ( int iIndex = 0; iIndex < iRangeCount; iIndex++ )
+			{
+				int iObjectID = bUseSceneBVH ? scratch.candidates [ iIndex ] : iStart+iIndex;
+				if ( iObjectID < iStart || iObjectID > iEnd || iObjectID >= g_iObjectListCount )
+					continue;
+				sObject* pObject = g_ObjectList [ iObjectID ];
+				if ( !pObject ) 
+					continue;
+				if ( !RayBatchFilter ( query, pObject ) )
+					continue;
+				if ( IntersectAllShortListCheck ( pObject, query.fX, query.fY, query.fZ, query.fNewX, query.fNewY, query.fNewZ, fDistanceBetweenPoints, query.iIgnoreObjNo, bIgnoreCollisionProperty ) )
+					shortlist.push_back ( pObject );
+			}
+		}
+		std::sort ( shortlist.begin(), shortlist.end(), OrderByCamDistance() );
+	};
+	RayBatchParallel ( iCount, 8, buildShortList );
+
+	// each shortlisted object is prepared once, as IntersectObjectCore would for every ray
+	g_RayBatchObjects.clear();
+	g_RayBatchFrames.clear();
+	for ( int iRay = 0; iRay < iCount; iRay++ )
+	{
+		std::vector< sObject* >& shortlist = g_RayBatchShortLists [ iRay ];
+		std::vector< sRayBatchHit >& hits = g_RayBatchHits [ iRay ];
+		hits.resize ( shortlist.size() );
+		for ( size_t i = 0; i < shortlist.size(); i++ )
+		{
+			sObject* pObject = shortlist [ i ];
+			if ( pObject->dwObjectNumber >= g_RayBatchObjectOfID.size() ) g_RayBatchObjectOfID.resize ( pObject->dwObjectNumber + 1, -1 );
+			int& iObject = g_RayBatchObjectOfID [ pObject->dwObjectNumber ];
+			if ( iObject < 0 )
+			{
+				CalcObjectWorld ( pObject );
+				PrepareIntersectObject ( pObject );
+				sRayBatchObject object;
+				object.pObject = pObject;
+				object.bCaptured = false;
+				object.iFirstFrame = 0;
+				object.iFrameCount = 0;
+				iObject = (int)g_RayBatchObjects.size();
+				g_RayBatchObjects.push_back ( object );
+			}
+			hits [ i ].iObject = iObject;
+			hits [ i ].fDistance = 0.0f;
+			hits [ i ].vecNormal = GGVECTOR3 ( 0, 0, 0 );
+		}
+	}
+
+	// then static objects have their frames captured so their polygons can be tested from any thread
+	for ( size_t i = 0; i < g_RayBatchObjects.size(); i++ )
+	{
+		sRayBatchObject& object = g_RayBatchObjects [ i ];
+		g_RayBatchObjectOfID [ object.pObject->dwObjectNumber ] = -1;
+		object.iFirstFrame = (int)g_RayBatchFrames.size();
+		object.bCaptured = CaptureRayCollisionFrames ( object.pObject, g_RayBatchFrames );
+		object.iFrameCount = (int)g_RayBatchFrames.size() - object.iFirstFrame;
+	}
+
+	// polygon tests against the static objects
+	auto testStaticObjects = [pQueries] ( int iOrder )
+	{
+		int iRay = g_RayBatchOrder [ iOrder ];
+		const sRayBatchQuery& query = pQueries [ iRay ];
+		std::vector< sRayBatchHit >& hits = g_RayBatchHits [ iRay ];
+		for ( size_t i = 0; i < hits.size(); i++ )
+		{
+			const sRayBatchObject& object = g_RayBatchObjects [ hits [ i ].iObject ];
+			if ( object.bCaptured == false || object.iFrameCount == 0 )
+				continue;
+			const sRayCollisionFrame* pFrames = &g_RayBatchFrames [ object.iFirstFrame ];
+			hits [ i ].fDistance = GetRayCollisionCaptured ( pFrames, object.iFrameCount, query.fX, query.fY, query.fZ, query.fNewX, query.fNewY, query.fNewZ, &hits [ i ].vecNormal );
+		}
+	};
+	RayBatchParallel ( iCount, 4, testStaticObjects );
+
+	// the rest, then pick the hit for each ray as IntersectAllEx does
+	for ( int iRay = 0; iRay < iCount; iRay++ )
+	{
+		const sRayBatchQuery& query = pQueries [ iRay ];
+		std::vector< sRayBatchHit >& hits = g_RayBatchHits [ iRay ];
+		GGVECTOR3 vecStart = GGVECTOR3 ( query.fX, query.fY, query.fZ );
+		GGVECTOR3 vecDir = GGVECTOR3 ( query.fNewX, query.fNewY, query.fNewZ ) - vecStart;
+		float fDistanceBetweenPoints = GGVec3Length ( &vecDir );
+		GGVec3Normalize ( &vecDir, &vecDir );
+
+		sRayBatchResult& result = pResults [ iRay ];
+		memset ( &result, 0, sizeof(result) );
+		float fBestDistance = 999999.9f;
+		for ( size_t i = 0; i < hits.size(); i++ )
+		{
+			const sRayBatchObject& object = g_RayBatchObjects [ hits [ i ].iObject ];
+			if ( object.bCaptured == false )
+			{
+				hits [ i ].fDistance = IntersectObjectCore ( object.pObject, query.fX, query.fY, query.fZ, query.fNewX, query.fNewY, query.fNewZ, 0 );
+				if ( hits [ i ].fDistance > 0 ) hits [ i ].vecNormal = MegaCollisionFeedback.vecNormal;
+			}
+			float fDistance = hits [ i ].fDistance;
+			if ( fDistance > 0 && fDistance < fBestDistance && fDistance <= fDistanceBetweenPoints )
+			{
+				fBestDistance = fDistance;
+				GGVECTOR3 vecHit = vecStart + ( vecDir * fDistance );
+				result.iHitObj = object.pObject->dwObjectNumber;
+				result.fDistance = fDistance;
+				result.fHitX = vecHit.x;
+				result.fHitY = vecHit.y;
+				result.fHitZ = vecHit.z;
+				result.fNormalX = hits [ i ].vecNormal.x;
+				result.fNormalY = hits [ i ].vecNormal.y;
+				result.fNormalZ = hits [ i ].vecNormal.z;
+			}
+		}
+	}
+}
+
+DARKSDK_DLL int IntersectAllBatchSubmit ( const sRayBatchQuery* pQuery )
+{
+	// queue a ray for the next IntersectAllBatchFlush, the ticket collects its result afterwards
+	g_RayBatchPending.push_back ( *pQuery );
+	return g_iRayBatchNextTicket++;
+}
+
+DARKSDK_DLL void IntersectAllBatchFlush ( void )
+{
+	// results of the previous flush are replaced by those of the rays queued since
+	g_iRayBatchFirstResultTicket = g_iRayBatchNextTicket - (int)g_RayBatchPending.size();
+	g_RayBatchFlushed.swap ( g_RayBatchPending );
+	g_RayBatchPending.clear();
+	g_RayBatchResults.resize ( g_RayBatchFlushed.size() );
+	if ( g_RayBatchFlushed.size() > 0 )
+		IntersectAllBatch ( &g_RayBatchFlushed [ 0 ], (int)g_RayBatchFlushed.size(), &g_RayBatchResults [ 0 ] );
+}
+
+DARKSDK_DLL bool IntersectAllBatchResult ( int iTicket, sRayBatchResult* pResult )
+{
+	// false if the ray has not been flushed yet or a later flush has replaced its result
+	int iIndex = iTicket - g_iRayBatchFirstResultTicket;
+	if ( iIndex < 0 || iIndex >= (int)g_RayBatchResults.size() )
+		return false;
+	*pResult = g_RayBatchResults [ iIndex ];
+	return true;
+}
+
+DARKSDK_DLL bool IntersectAllBatchPending ( int iTicket )
+{
+	// true while the ray waits for the next flush
+	return iTicket >= g_iRayBatchNextTicket - (int)g_RayBatchPending.size() && iTicket < g_iRayBatchNextTicket;
+}
+
 DARKSDK void SetObjectCollisionProperty ( int iObjectID, int iPropertyValue )
 {
 	// check the object exists
@@ -10447,6 +10828,7 @@ DARKSDK_DLL void SetWorldMatrix ( int iID, GGMATRIX* pMatrix )
 	sObject* pObject = g_ObjectList [ iID ];
 	memcpy ( &pObject->position.matWorld, pMatrix, sizeof ( GGMATRIX ) );
 	pObject->position.bCustomWorldMatrix = true;
+	g_SceneBVH.markDirty ( pObject );
 }
 
 // mike - 040903 - updates a structure
@@ -10517,7 +10899,8 @@ DARKSDK_DLL void ExcludeOn ( int iID )
 	pObject->bExcluded = true;
 	if ( pObject->pInstanceOfObject ) pObject->pInstanceOfObject->bExcluded = true; // 131107 - added as seemd to be missing?
 
-	m_ObjectManager.UpdateTextures ( );
+	m_ObjectManager.UpdateTextures ( pObject );
+	m_ObjectManager.UpdateTextures ( pObject->pInstanceOfObject );
 }
 
 DARKSDK_DLL void ExcludeOff ( int iID )
@@ -10529,7 +10912,8 @@ DARKSDK_DLL void ExcludeOff ( int iID )
 	pObject->bExcluded = false;
 	if ( pObject->pInstanceOfObject ) pObject->pInstanceOfObject->bExcluded = false;
 
-	m_ObjectManager.UpdateTextures ( );
+	m_ObjectManager.UpdateTextures ( pObject );
+	m_ObjectManager.UpdateTextures ( pObject->pInstanceOfObject );
 }
 
 DARKSDK_DLL void ExcludeLimbOn ( int iID, int iLimbID )
@@ -10739,7 +11123,7 @@ DARKSDK void SetObjectMask ( int iID, int iMASK, int iShadowMASK, int iCubeMapMA
 	}
 
 	// 210214 - the mask flag can remove object from sorted list (effectively removing it from all engine render considerations)
-	m_ObjectManager.UpdateTextures();
+	m_ObjectManager.UpdateTextures ( pObject );
 }
 
 
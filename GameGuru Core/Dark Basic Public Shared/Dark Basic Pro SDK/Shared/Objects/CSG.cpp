@@ -127,8 +127,8 @@ bool cCSG::Union ( sMesh* pMeshA, GGMATRIX OriginalMatA, sMesh* pMeshB, GGMATRIX
 
 		// replace mesh data directly!
 		sOffsetMap offsetMap;
-		SAFE_DELETE_ARRAY ( pMeshA->pVertexData );
-		SAFE_DELETE_ARRAY ( pMeshA->pIndices );
+		DeleteMeshVertexData ( pMeshA );
+		DeleteMeshIndexData ( pMeshA );
 		GetFVFOffsetMap ( pMeshA, &offsetMap );
 		SetupMeshFVFData ( pMeshA, pMeshA->dwFVF, iVertexCount, iIndexCount );
 		for ( int iIndex = 0; iIndex < iIndexCount; iIndex++ )
@@ -554,8 +554,8 @@ void cCSG::BuildVertexAndIndexList ( cCompiler* pA, cCompiler* pB, sMesh* pMesh
 	iIndexCount  = indexListFinal.size  ( );
 	
 	// delete original data
-	SAFE_DELETE_ARRAY ( pMesh->pVertexData );
-	SAFE_DELETE_ARRAY ( pMesh->pIndices );
+	DeleteMeshVertexData ( pMesh );
+	DeleteMeshIndexData ( pMesh );
 
 	// create new data
 	SetupMeshFVFData ( pMesh, pMesh->dwFVF, iVertexCount, iIndexCount );
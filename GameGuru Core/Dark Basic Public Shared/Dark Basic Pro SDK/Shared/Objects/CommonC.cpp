@@ -5,6 +5,7 @@
 #include ".\..\Core\SteamCheckForWorkshop.h"
 
 #include "CFileC.h"
+#include "SceneBVH.h"
 
 // Object Manager and Renderer
 DBPRO_GLOBAL CObjectManager					m_ObjectManager;
@@ -115,6 +116,7 @@ DARKSDK_DLL void Basic3DPassCoreData ( LPVOID pGlobPtr )
 {
 	// allocate the list of pointers
 	g_iObjectListRefCount=0;
+	g_SceneBVH.clear();
 	g_ObjectListRef = new int [ g_iObjectListCount ];
 	g_ObjectList = new sObject* [ g_iObjectListCount ];
 
@@ -596,6 +598,8 @@ DARKSDK_DLL void AddObjectToObjectListRef ( int iID )
 	// add new entry
 	g_ObjectListRef [ g_iObjectListRefCount ] = iID;
 	g_iObjectListRefCount++;
+	g_SceneBVH.addObject ( iID );
+	m_ObjectManager.AddToRenderQueue ( iID );
 
 	// update global arrays for shortlist entry expansion
 	m_ObjectManager.UpdateObjectListSize ( g_iObjectListRefCount );
@@ -612,6 +616,8 @@ DARKSDK_DLL void  RemoveObjectFromObjectListRef ( int iID )
 			DWORD dwSize = (g_iObjectListRefCount-iIndex)-1;
 			if ( dwSize > 0 ) memcpy ( &g_ObjectListRef[iIndex], &g_ObjectListRef[iIndex+1], dwSize*sizeof(int) );
 			g_iObjectListRefCount--;
+			g_SceneBVH.removeObject ( iID );
+			m_ObjectManager.RemoveFromRenderQueue ( iID );
 			return;
 		}
 	}
@@ -1072,13 +1078,10 @@ DARKSDK_DLL bool DeleteObjectSpecial ( int iID )
 	if ( !DeleteMesh ( &g_ObjectList [ iID ] ) )
 		return false;
 
-	// clear item from list perminantly
+	// clear item from list perminantly, which also takes it out of the render queue and temp lists
 	RemoveObjectFromObjectListRef ( iID );
 	g_ObjectList [ iID ] = NULL;
 
-	// ensure temp lists are cleared as this object no longer exists
-	m_ObjectManager.UpdateTextures();
-
 	// object deleted okay
 	return true;
 }
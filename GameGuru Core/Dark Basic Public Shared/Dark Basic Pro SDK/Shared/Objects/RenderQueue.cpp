@@ -0,0 +1,197 @@
+//
+// Render Queue
+//
+
+#include "RenderQueue.h"
+#include <algorithm>
+
+namespace
+{
+	struct OrderByRenderKey
+	{
+		bool operator()(const sRenderQueueEntry& a, const sRenderQueueEntry& b) const
+		{
+			return a.key < b.key;
+		}
+	};
+}
+
+cRenderQueue::cRenderQueue ( )
+{
+	m_dwNextSequence = 0;
+}
+
+void cRenderQueue::AddObject ( int iID )
+{
+	SetSequence ( iID, m_dwNextSequence );
+	MarkObject ( iID );
+}
+
+void cRenderQueue::MarkObject ( int iID )
+{
+	if ( iID <= 0 ) return;
+	if ( iID >= (int)m_vMarked.size() ) m_vMarked.resize ( iID + 1, 0 );
+	if ( m_vMarked [ iID ] ) return;
+	m_vMarked [ iID ] = 1;
+	m_vPending.push_back ( iID );
+}
+
+void cRenderQueue::Clear ( void )
+{
+	m_vEntries.clear();
+	m_vBatch.clear();
+	for ( size_t i = 0; i < m_vPending.size(); i++ )
+		m_vMarked [ m_vPending [ i ] ] = 0;
+	m_vPending.clear();
+	m_EffectRanks.clear();
+}
+
+void cRenderQueue::Begin ( std::vector<int>& ids )
+{
+	// marked objects may have been freed so are matched by number before anything is read,
+	// the rest are still alive and an instance goes with the object it draws
+	ids = m_vPending;
+	int iKept = 0;
+	for ( int i = 0; i < (int)m_vEntries.size(); i++ )
+	{
+		const sRenderQueueEntry& entry = m_vEntries [ i ];
+		if ( entry.iID < (int)m_vMarked.size() && m_vMarked [ entry.iID ] )
+			continue;
+		sObject* pInstanceOf = entry.pObject->pInstanceOfObject;
+		if ( pInstanceOf )
+		{
+			int iMasterID = (int)pInstanceOf->dwObjectNumber;
+			if ( iMasterID < (int)m_vMarked.size() && m_vMarked [ iMasterID ] )
+			{
+				ids.push_back ( entry.iID );
+				continue;
+			}
+		}
+		m_vEntries [ iKept++ ] = entry;
+	}
+	m_vEntries.resize ( iKept );
+
+	for ( size_t i = 0; i < m_vPending.size(); i++ )
+		m_vMarked [ m_vPending [ i ] ] = 0;
+	m_vPending.clear();
+	m_vBatch.clear();
+}
+
+void cRenderQueue::Insert ( ULONGLONG key, sObject* pObject, int iID )
+{
+	sRenderQueueEntry entry;
+	entry.key = key;
+	entry.pObject = pObject;
+	entry.iID = iID;
+	m_vBatch.push_back ( entry );
+}
+
+void cRenderQueue::Finish ( void )
+{
+	if ( m_vBatch.empty() ) return;
+	RadixSortRenderKeys ( &m_vBatch [ 0 ], (int)m_vBatch.size(), m_vScratch );
+	if ( m_vEntries.empty() )
+	{
+		m_vEntries.swap ( m_vBatch );
+	}
+	else
+	{
+		m_vScratch.resize ( m_vEntries.size() + m_vBatch.size() );
+		std::merge ( m_vEntries.begin(), m_vEntries.end(), m_vBatch.begin(), m_vBatch.end(), m_vScratch.begin(), OrderByRenderKey() );
+		m_vEntries.swap ( m_vScratch );
+	}
+	m_vBatch.clear();
+}
+
+DWORD cRenderQueue::GetEffectRank ( void* pEffect )
+{
+	if ( pEffect==NULL ) return 0;
+	std::unordered_map<void*, DWORD>::iterator it = m_EffectRanks.find ( pEffect );
+	if ( it != m_EffectRanks.end() ) return it->second;
+
+	// past the limit effects share the last rank, still grouped by texture within it
+	DWORD dwRank = (DWORD)m_EffectRanks.size() + 1;
+	if ( dwRank > RENDERKEY_EFFECT_LIMIT ) dwRank = RENDERKEY_EFFECT_LIMIT;
+	m_EffectRanks [ pEffect ] = dwRank;
+	return dwRank;
+}
+
+DWORD cRenderQueue::GetSequence ( int iID )
+{
+	if ( iID < 0 || iID >= (int)m_vSequence.size() ) return 0;
+	return m_vSequence [ iID ];
+}
+
+void cRenderQueue::SetSequence ( int iID, DWORD dwSequence )
+{
+	if ( iID < 0 ) return;
+	if ( iID >= (int)m_vSequence.size() ) m_vSequence.resize ( iID + 1, 0 );
+	m_vSequence [ iID ] = dwSequence;
+	if ( dwSequence >= m_dwNextSequence ) m_dwNextSequence = dwSequence + 1;
+}
+
+void cRenderQueue::SortByReverseDistance ( std::vector<sObject*>& objects )
+{
+	if ( objects.size() < 2 ) return;
+	m_vDistance.resize ( objects.size() );
+	for ( size_t i = 0; i < objects.size(); i++ )
+	{
+		// float bits flipped so they order as unsigned, then inverted for furthest first
+		float fDistance = objects [ i ]->position.fCamDistance;
+		if ( fDistance == 0.0f ) fDistance = 0.0f;
+		DWORD dwBits = *(DWORD*)&fDistance;
+		dwBits = ( dwBits & 0x80000000 ) ? ~dwBits : ( dwBits | 0x80000000 );
+		m_vDistance [ i ].key = ( (ULONGLONG)(DWORD)~dwBits << 32 ) | objects [ i ]->dwObjectNumber;
+		m_vDistance [ i ].pObject = objects [ i ];
+		m_vDistance [ i ].iID = (int)objects [ i ]->dwObjectNumber;
+	}
+	RadixSortRenderKeys ( &m_vDistance [ 0 ], (int)m_vDistance.size(), m_vScratch );
+	for ( size_t i = 0; i < objects.size(); i++ )
+		objects [ i ] = m_vDistance [ i ].pObject;
+}
+
+DARKSDK_DLL void RadixSortRenderKeys ( sRenderQueueEntry* pEntries, int iCount, std::vector<sRenderQueueEntry>& scratch )
+{
+	// least significant byte first, one counting pass for all eight digits
+	if ( iCount < 2 ) return;
+	if ( iCount < 64 )
+	{
+		std::sort ( pEntries, pEntries + iCount, OrderByRenderKey() );
+		return;
+	}
+	DWORD dwCounts [ 8 ][ 256 ];
+	memset ( dwCounts, 0, sizeof(dwCounts) );
+	for ( int i = 0; i < iCount; i++ )
+	{
+		ULONGLONG key = pEntries [ i ].key;
+		for ( int iDigit = 0; iDigit < 8; iDigit++ )
+			dwCounts [ iDigit ][ ( key >> ( iDigit * 8 ) ) & 0xFF ]++;
+	}
+
+	scratch.resize ( iCount );
+	sRenderQueueEntry* pFrom = pEntries;
+	sRenderQueueEntry* pTo = &scratch [ 0 ];
+	for ( int iDigit = 0; iDigit < 8; iDigit++ )
+	{
+		// a digit every key shares leaves the order as it is
+		DWORD* pCount = dwCounts [ iDigit ];
+		int iShift = iDigit * 8;
+		if ( pCount [ ( pFrom [ 0 ].key >> iShift ) & 0xFF ] == (DWORD)iCount )
+			continue;
+
+		DWORD dwOffset = 0;
+		for ( int iBucket = 0; iBucket < 256; iBucket++ )
+		{
+			DWORD dwBucketCount = pCount [ iBucket ];
+			pCount [ iBucket ] = dwOffset;
+			dwOffset += dwBucketCount;
+		}
+		for ( int i = 0; i < iCount; i++ )
+			pTo [ pCount [ ( pFrom [ i ].key >> iShift ) & 0xFF ]++ ] = pFrom [ i ];
+		sRenderQueueEntry* pSwap = pFrom;
+		pFrom = pTo;
+		pTo = pSwap;
+	}
+	if ( pFrom != pEntries )
+		memcpy ( pEntries, pFrom, sizeof(sRenderQueueEntry) * iCount );
+}
@@ -0,0 +1,86 @@
+//
+// Render Queue Header
+//
+
+#pragma once
+
+#include ".\..\DBOFormat\DBOFormat.h"
+
+#include "preprocessor-flags.h"
+#include "global.h"
+
+#include <vector>
+#include <unordered_map>
+
+// draw key layout, the highest fields sort first
+#define RENDERKEY_LAYER_SHIFT			62			// RENDERKEY_LAYER_ value, two bits
+#define RENDERKEY_EFFECT_SHIFT			52			// effect rank, ten bits
+#define RENDERKEY_TEXTURE_SHIFT			32			// image of the first texture, twenty bits
+#define RENDERKEY_EFFECT_LIMIT			0x3FF
+#define RENDERKEY_TEXTURE_LIMIT			0xFFFFF
+
+// draw key layers, in the order SortVisibilityList splits them
+#define RENDERKEY_LAYER_EARLY			0
+#define RENDERKEY_LAYER_NOZDEPTH		1
+#define RENDERKEY_LAYER_TRANSPARENT		2
+#define RENDERKEY_LAYER_STANDARD		3
+
+struct sRenderQueueEntry
+{
+	ULONGLONG						key;
+	sObject*						pObject;
+	int								iID;										// object number, still valid once the object is freed
+};
+
+// objects in draw key order, built once and then kept in order as objects are
+// added, removed or changed by sorting just the changed ones and merging them in.
+// The keys are made by the object manager, the queue only orders them
+class cRenderQueue
+{
+	public:
+
+		cRenderQueue ( );
+
+		// pending changes, by object number so they can be given after the object is freed
+		void	AddObject				( int iID );
+		void	MarkObject				( int iID );
+		bool	IsPending				( void ) { return !m_vPending.empty(); }
+		void	Clear					( void );
+
+		// drops the entries of marked objects and of instances of them, and returns
+		// every object number that needs a new key. Insert is then called for those
+		// still to be drawn and Finish merges them back in
+		void	Begin					( std::vector<int>& ids );
+		void	Insert					( ULONGLONG key, sObject* pObject, int iID );
+		void	Finish					( void );
+
+		int								GetCount	( void ) { return (int)m_vEntries.size(); }
+		const sRenderQueueEntry*		GetEntries	( void ) { return m_vEntries.empty() ? NULL : &m_vEntries [ 0 ]; }
+
+		// stable rank of an effect for the key, NULL is zero
+		DWORD	GetEffectRank			( void* pEffect );
+
+		// order an object joined the list in, for the unsorted modes, given by AddObject
+		// or set in list order when everything is rebuilt
+		DWORD	GetSequence				( int iID );
+		void	SetSequence				( int iID, DWORD dwSequence );
+
+		// in place of OrderByReverseCameraDistance, furthest first then by object number
+		void	SortByReverseDistance	( std::vector<sObject*>& objects );
+
+	private:
+
+		std::vector<sRenderQueueEntry>	m_vEntries;
+		std::vector<sRenderQueueEntry>	m_vBatch;
+		std::vector<sRenderQueueEntry>	m_vScratch;
+		std::vector<sRenderQueueEntry>	m_vDistance;
+		std::vector<int>				m_vPending;
+		std::vector<unsigned char>		m_vMarked;									// indexed by object number
+		std::vector<DWORD>				m_vSequence;
+		DWORD							m_dwNextSequence;
+		std::unordered_map<void*, DWORD> m_EffectRanks;
+};
+
+// Render Queue Functions
+
+DARKSDK_DLL void	RadixSortRenderKeys		( sRenderQueueEntry* pEntries, int iCount, std::vector<sRenderQueueEntry>& scratch );
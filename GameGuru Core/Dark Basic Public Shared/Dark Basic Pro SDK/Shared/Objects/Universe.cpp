@@ -636,7 +636,7 @@ void cUniverse::LeesTestFPSCQuadRemover ( void )
 		}
 
 		// remove old arraus
-		SAFE_DELETE_ARRAY(pMesh->pVertexData);
+		DeleteMeshVertexData ( pMesh );
 
 		// replace with new arrays
 		pMesh->dwVertexCount = dwNewVertexCount;
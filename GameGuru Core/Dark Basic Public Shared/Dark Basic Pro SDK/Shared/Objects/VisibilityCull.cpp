@@ -0,0 +1,178 @@
+//
+// Visibility Culling
+//
+
+#include "VisibilityCull.h"
+#include "..\..\..\Include\cThreadPool.h"
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+void sVisibilityCullList::Clear ( void )
+{
+	objects.clear();
+	centreX.clear();
+	centreY.clear();
+	centreZ.clear();
+	radius.clear();
+	distanceX.clear();
+	distanceY.clear();
+	distanceZ.clear();
+	largestRadius.clear();
+	flags.clear();
+	iCount = 0;
+}
+
+void sVisibilityCullList::Add ( sObject* pObject, const float* pCentre, float fRadius, const float* pDistanceCentre, float fLargestRadius, int iFlags )
+{
+	// any padding from the last cull goes first
+	if ( (int)objects.size() > iCount )
+	{
+		objects.resize ( iCount );
+		centreX.resize ( iCount );
+		centreY.resize ( iCount );
+		centreZ.resize ( iCount );
+		radius.resize ( iCount );
+		distanceX.resize ( iCount );
+		distanceY.resize ( iCount );
+		distanceZ.resize ( iCount );
+		largestRadius.resize ( iCount );
+		flags.resize ( iCount );
+	}
+	objects.push_back ( pObject );
+	centreX.push_back ( pCentre [ 0 ] );
+	centreY.push_back ( pCentre [ 1 ] );
+	centreZ.push_back ( pCentre [ 2 ] );
+	radius.push_back ( fRadius );
+	distanceX.push_back ( pDistanceCentre [ 0 ] );
+	distanceY.push_back ( pDistanceCentre [ 1 ] );
+	distanceZ.push_back ( pDistanceCentre [ 2 ] );
+	largestRadius.push_back ( fLargestRadius );
+	flags.push_back ( iFlags );
+	iCount++;
+}
+
+void sVisibilityCullList::Pad ( void )
+{
+	// whole groups only, the padding is never reported
+	while ( objects.size() % VISCULL_GROUP )
+	{
+		objects.push_back ( NULL );
+		centreX.push_back ( 0.0f );
+		centreY.push_back ( 0.0f );
+		centreZ.push_back ( 0.0f );
+		radius.push_back ( 0.0f );
+		distanceX.push_back ( 0.0f );
+		distanceY.push_back ( 0.0f );
+		distanceZ.push_back ( 0.0f );
+		largestRadius.push_back ( 0.0f );
+		flags.push_back ( 0 );
+	}
+}
+
+DARKSDK_DLL void SetVisibilityCullView ( sVisibilityCullView* pView, const GGPLANE* pPlanes, float fCameraX, float fCameraY, float fCameraZ, bool bDistanceRule, int iHideDistantShadows )
+{
+	for ( int iPlaneIndex = 0; iPlaneIndex < NUM_CULLPLANES; iPlaneIndex++ )
+	{
+		pView->fPlanes [ iPlaneIndex ][ 0 ] = pPlanes [ iPlaneIndex ].a;
+		pView->fPlanes [ iPlaneIndex ][ 1 ] = pPlanes [ iPlaneIndex ].b;
+		pView->fPlanes [ iPlaneIndex ][ 2 ] = pPlanes [ iPlaneIndex ].c;
+		pView->fPlanes [ iPlaneIndex ][ 3 ] = pPlanes [ iPlaneIndex ].d;
+	}
+	pView->fCameraX = fCameraX;
+	pView->fCameraY = fCameraY;
+	pView->fCameraZ = fCameraZ;
+	pView->bDistanceRule = bDistanceRule;
+	pView->iHideDistantShadows = iHideDistantShadows;
+}
+
+static inline __m128 SelectCull ( __m128 mask, __m128 a, __m128 b )
+{
+	return _mm_or_ps ( _mm_and_ps ( mask, a ), _mm_andnot_ps ( mask, b ) );
+}
+
+// four objects from iFirst, each test is worked in the same order as CheckSphere
+// and the distance rule of SortVisibilityList so the answers match exactly
+static inline int CullFour ( const sVisibilityCullList& list, const sVisibilityCullView& view, int iFirst )
+{
+	__m128 x = _mm_loadu_ps ( &list.centreX [ iFirst ] );
+	__m128 y = _mm_loadu_ps ( &list.centreY [ iFirst ] );
+	__m128 z = _mm_loadu_ps ( &list.centreZ [ iFirst ] );
+	__m128 negRadius = _mm_sub_ps ( _mm_setzero_ps(), _mm_loadu_ps ( &list.radius [ iFirst ] ) );
+
+	// inside unless wholly behind one of the planes
+	__m128 visible = _mm_castsi128_ps ( _mm_set1_epi32 ( -1 ) );
+	for ( int iPlaneIndex = 0; iPlaneIndex < NUM_CULLPLANES; iPlaneIndex++ )
+	{
+		const float* pPlane = view.fPlanes [ iPlaneIndex ];
+		__m128 d = _mm_add_ps ( _mm_mul_ps ( _mm_set1_ps ( pPlane [ 0 ] ), x ), _mm_mul_ps ( _mm_set1_ps ( pPlane [ 1 ] ), y ) );
+		d = _mm_add_ps ( d, _mm_mul_ps ( _mm_set1_ps ( pPlane [ 2 ] ), z ) );
+		d = _mm_add_ps ( d, _mm_set1_ps ( pPlane [ 3 ] ) );
+		visible = _mm_and_ps ( visible, _mm_cmpnlt_ps ( d, negRadius ) );
+	}
+
+	// some objects skip the frustum
+	__m128i always = _mm_and_si128 ( _mm_loadu_si128 ( (const __m128i*)&list.flags [ iFirst ] ), _mm_set1_epi32 ( VISCULL_ALWAYS_VISIBLE ) );
+	visible = _mm_or_ps ( visible, _mm_castsi128_ps ( _mm_cmpeq_epi32 ( always, _mm_set1_epi32 ( VISCULL_ALWAYS_VISIBLE ) ) ) );
+
+	// and all of them the shadow distance
+	if ( view.bDistanceRule )
+	{
+		__m128 dx = _mm_sub_ps ( _mm_set1_ps ( view.fCameraX ), _mm_loadu_ps ( &list.distanceX [ iFirst ] ) );
+		__m128 dy = _mm_sub_ps ( _mm_set1_ps ( view.fCameraY ), _mm_loadu_ps ( &list.distanceY [ iFirst ] ) );
+		__m128 dz = _mm_sub_ps ( _mm_set1_ps ( view.fCameraZ ), _mm_loadu_ps ( &list.distanceZ [ iFirst ] ) );
+		__m128 dist = _mm_add_ps ( _mm_add_ps ( _mm_mul_ps ( dx, dx ), _mm_mul_ps ( dy, dy ) ), _mm_mul_ps ( dz, dz ) );
+		dist = _mm_sqrt_ps ( dist );
+		__m128 largest = _mm_loadu_ps ( &list.largestRadius [ iFirst ] );
+		__m128 dmax = _mm_set1_ps ( 1000.0f );
+		if ( view.iHideDistantShadows == 1 )
+		{
+			dmax = SelectCull ( _mm_cmpgt_ps ( largest, _mm_set1_ps ( 100.0f ) ), _mm_set1_ps ( 1500.0f ), dmax );
+			dmax = SelectCull ( _mm_cmpgt_ps ( largest, _mm_set1_ps ( 300.0f ) ), _mm_set1_ps ( 2500.0f ), dmax );
+			dmax = SelectCull ( _mm_cmpgt_ps ( largest, _mm_set1_ps ( 500.0f ) ), _mm_set1_ps ( 4000.0f ), dmax );
+		}
+		if ( view.iHideDistantShadows == 2 )
+		{
+			dmax = SelectCull ( _mm_cmpgt_ps ( largest, _mm_set1_ps ( 200.0f ) ), _mm_set1_ps ( 8000.0f ), dmax );
+		}
+		visible = _mm_and_ps ( visible, _mm_cmpngt_ps ( dist, dmax ) );
+	}
+
+	return _mm_movemask_ps ( visible );
+}
+
+static void CullRange ( const sVisibilityCullList& list, const sVisibilityCullView& view, int iFirst, int iLast, unsigned char* pResults )
+{
+	for ( int i = iFirst; i < iLast; i += VISCULL_GROUP )
+	{
+		int iMask = CullFour ( list, view, i ) | ( CullFour ( list, view, i + 4 ) << 4 );
+		for ( int j = 0; j < VISCULL_GROUP; j++ )
+			pResults [ i + j ] = (unsigned char)( ( iMask >> j ) & 1 );
+	}
+}
+
+DARKSDK_DLL void CullVisibilityList ( sVisibilityCullList& list, const sVisibilityCullView* pViews, int iViewCount, std::vector<unsigned char>* pResults, cThreadPool* pPool )
+{
+	// fills pResults [ view ] with one for each visible object in list order
+	list.Pad();
+	int iPadded = (int)list.objects.size();
+	for ( int iView = 0; iView < iViewCount; iView++ )
+		pResults [ iView ].resize ( iPadded );
+	if ( iPadded == 0 ) return;
+
+	// every view split into jobs of whole groups
+	int iJobsPerView = ( iPadded + VISCULL_JOB_GRAIN - 1 ) / VISCULL_JOB_GRAIN;
+	auto cull = [&] ( int iJob )
+	{
+		int iView = iJob / iJobsPerView;
+		int iFirst = ( iJob % iJobsPerView ) * VISCULL_JOB_GRAIN;
+		int iLast = iFirst + VISCULL_JOB_GRAIN < iPadded ? iFirst + VISCULL_JOB_GRAIN : iPadded;
+		CullRange ( list, pViews [ iView ], iFirst, iLast, &pResults [ iView ][ 0 ] );
+	};
+	if ( pPool )
+		pPool->parallel_for ( 0, iViewCount * iJobsPerView, 1, cull );
+	else
+		for ( int iJob = 0; iJob < iViewCount * iJobsPerView; iJob++ ) cull ( iJob );
+
+	for ( int iView = 0; iView < iViewCount; iView++ )
+		pResults [ iView ].resize ( list.iCount );
+}
@@ -0,0 +1,61 @@
+//
+// Visibility Culling Header
+//
+
+#pragma once
+
+#include ".\..\DBOFormat\DBOFormat.h"
+
+#include "preprocessor-flags.h"
+#include "global.h"
+
+#include <vector>
+
+class cThreadPool;
+
+// objects are culled in groups of this many, the lists are padded to match
+#define VISCULL_GROUP				8
+
+// objects culled by one job
+#define VISCULL_JOB_GRAIN			2048
+
+// sVisibilityCullList flags
+#define VISCULL_ALWAYS_VISIBLE		1			// locked, glued, unbounded or animating parent, skips the frustum
+
+// one view to cull for, a camera or a shadow cascade
+struct sVisibilityCullView
+{
+	float							fPlanes [ 6 ][ 4 ];							// frustum planes as a b c d, inside when positive
+	float							fCameraX;									// where the distance rule measures from
+	float							fCameraY;
+	float							fCameraZ;
+	bool							bDistanceRule;								// hide objects beyond their shadow distance
+	int								iHideDistantShadows;						// g_HideDistantShadows mode for those distances
+};
+
+// object bounds and flags in one array per field so whole groups of objects
+// can be tested at once, filled by SortVisibilityList in draw order
+struct sVisibilityCullList
+{
+	std::vector<sObject*>			objects;
+	std::vector<float>				centreX;									// frustum sphere
+	std::vector<float>				centreY;
+	std::vector<float>				centreZ;
+	std::vector<float>				radius;
+	std::vector<float>				distanceX;									// point the distance rule uses
+	std::vector<float>				distanceY;
+	std::vector<float>				distanceZ;
+	std::vector<float>				largestRadius;								// picks the shadow distance
+	std::vector<int>				flags;
+	int								iCount;
+
+	sVisibilityCullList ( ) : iCount ( 0 ) { }
+	void Clear ( void );
+	void Add ( sObject* pObject, const float* pCentre, float fRadius, const float* pDistanceCentre, float fLargestRadius, int iFlags );
+	void Pad ( void );
+};
+
+// Visibility Functions
+
+DARKSDK_DLL void	SetVisibilityCullView	( sVisibilityCullView* pView, const GGPLANE* pPlanes, float fCameraX, float fCameraY, float fCameraZ, bool bDistanceRule, int iHideDistantShadows );
+DARKSDK_DLL void	CullVisibilityList		( sVisibilityCullList& list, const sVisibilityCullView* pViews, int iViewCount, std::vector<unsigned char>* pResults, cThreadPool* pPool );
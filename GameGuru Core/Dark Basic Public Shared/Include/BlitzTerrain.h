@@ -52,6 +52,7 @@ unsigned long BT_GetSectorCollumn(unsigned long terrainid,unsigned long LODLevel
 void BT_SetCurrentCamera(unsigned long CameraID);
 void BT_UpdateTerrainLOD(unsigned long TerrainID);
 void BT_UpdateTerrainCull(unsigned long TerrainID);
+void BT_UpdateTerrainRegion(unsigned long TerrainID,unsigned long TVrow,unsigned long TVcol,unsigned long Rows,unsigned long Cols);
 void BT_UpdateTerrain(unsigned long TerrainID);
 void BT_RenderTerrain(unsigned long TerrainID);
 void BT_NoRenderTerrain(unsigned long TerrainID);
@@ -70,3 +71,5 @@ void BTRTTMSDestructor();
 void BT_RaiseTerrain(unsigned long TerrainID,float X,float Z,float Radius,float Amount);
 void BT_RaiseTerrain(unsigned long TerrainID,float X,float Z,float Radius,float Amount,float capheight);
 void BT_SetPointHeight(unsigned long TerrainID,unsigned long TVrow,unsigned long TVcol,float Height);
+void BT_GetPointHeights(unsigned long TerrainID,unsigned long TVrow,unsigned long TVcol,unsigned long Rows,unsigned long Cols,float* Heights);
+void BT_SetPointHeights(unsigned long TerrainID,unsigned long TVrow,unsigned long TVcol,unsigned long Rows,unsigned long Cols,const float* Heights);
@@ -18,6 +18,31 @@ struct IntersectBox
 	float max[3];
 };
 
+// one ray of an IntersectAllBatch, the ranges and ignored object are those of IntersectAllEx
+// with the second and third ranges given per ray (a zero start skips them). dwFlags is a mask
+// of the filters below, objects they pass over are never hit
+#define RAYBATCH_IGNORECOLLISIONPROPERTY	1	// objects with collision switched off can still be hit
+#define RAYBATCH_SKIPANIMATED				2	// bone animated objects such as characters are passed over
+#define RAYBATCH_SKIPGLUED					4	// objects glued to another such as held weapons are passed over
+struct sRayBatchQuery
+{
+	float fX, fY, fZ;
+	float fNewX, fNewY, fNewZ;
+	int iStart, iEnd;
+	int iSecondStart, iSecondEnd;
+	int iThirdStart, iThirdEnd;
+	int iIgnoreObjNo;
+	int iIgnoreSecondObjNo;	// a second object passed over, zero for none
+	DWORD dwFlags;
+};
+struct sRayBatchResult
+{
+	int iHitObj;			// zero when nothing was hit
+	float fDistance;
+	float fHitX, fHitY, fHitZ;
+	float fNormalX, fNormalY, fNormalZ;
+};
+
 // Internal functions (not actual commands)
 DARKSDK void RefreshMeshShortList ( sMesh* pMesh );
 DARKSDK void ConvertToFVF ( sMesh* pMesh, DWORD dwFVF );
@@ -46,6 +71,8 @@ DARKSDK void LoadObject				( LPSTR szFilename, int iID, int iDBProMode, int iDiv
 DARKSDK void EnsureObjectDBOIsFVF	( int iID, LPSTR pFileToLoad, DWORD dwRequiredFVF );
 DARKSDK void SaveObjectEx			( LPSTR szFilename, int iID, bool bCompactOBJ);
 DARKSDK void SaveObject				( LPSTR szFilename, int iID );
+DARKSDK void SetObjectLoadMapped		( int iMode );
+DARKSDK void AlignObjectFile			( LPSTR szFilename, LPSTR szNewFilename );
 DARKSDK void DeleteObject			( int iID );
 DARKSDK bool DeleteObjectSpecial	( int iID );
 DARKSDK void SetObject				( int iID, SDK_BOOL bWireframe, SDK_BOOL bTransparency, SDK_BOOL bCull );
@@ -266,6 +293,11 @@ DARKSDK void AppendObjectAnimation		( int iID, LPSTR pFilename );
 DARKSDK void ClearAllKeyFrames			( int iID );
 DARKSDK void ClearKeyFrame				( int iID, int iFrame );
 DARKSDK void SetObjectKeyFrame			( int iID, int iFrame );
+DARKSDK void SetAnimationClipMode		( int iMode );
+DARKSDK int GetObjectAnimationClipMemory	( int iID );
+DARKSDK void SetAnimationPoseCache		( int iMode, float fFrameQuantum );
+DARKSDK int GetAnimationPoseCacheStat	( int iIndex );
+DARKSDK int GetAnimationPoseCacheHitRate	( void );
 
 DARKSDK int ObjectBlocking				( int iID, float X1, float Y1, float Z1, float X2, float Y2, float Z2 );
 
@@ -293,6 +325,11 @@ DARKSDK void SetSphereRadius			( int iID, float fRadius );
 DARKSDK float IntersectObject			( int iObjectID, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ );
 DARKSDK int IntersectAllEx				( int iStart, int iEnd, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ, int iIgnoreObjNo, int iStaticOnly );
 DARKSDK int IntersectAll				( int iStart, int iEnd, float fX, float fY, float fZ, float fNewX, float fNewY, float fNewZ, int iIgnoreObjNo );
+DARKSDK void IntersectAllBatch			( const sRayBatchQuery* pQueries, int iCount, sRayBatchResult* pResults );
+DARKSDK int IntersectAllBatchSubmit		( const sRayBatchQuery* pQuery );
+DARKSDK void IntersectAllBatchFlush		( void );
+DARKSDK bool IntersectAllBatchResult	( int iTicket, sRayBatchResult* pResult );
+DARKSDK bool IntersectAllBatchPending	( int iTicket );
 DARKSDK void SetObjectCollisionProperty ( int iObjectID, int iPropertyValue );
 DARKSDK void AutomaticObjectCollision	( int iObjectID, float fRadius, int iResponse );
 DARKSDK void AutomaticCameraCollision	( int iCameraID, float fRadius, int iResponse, int iStandGroundMode );
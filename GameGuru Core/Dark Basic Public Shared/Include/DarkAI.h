@@ -70,6 +70,7 @@ DLLEXPORT void 		AIMakePathBetweenPoints ( int iPathID, int iContainerID, float
 DLLEXPORT void 		AIMakePathBetweenPoints ( int iPathID, int iContainerID, float x, float z, float x2, float z2 );
 DLLEXPORT void 		AIMakePathBetweenPoints ( int iPathID, float x, float z, float x2, float z2 );
 DLLEXPORT void 		AIMakePathFromClosestWaypoints ( int iPathID, int iContainerID, float x, float z );
+DLLEXPORT int 		AIMakePathsBetweenPoints ( int iCount, int* pPathIDs, int* pContainerIDs, float* pPoints, int* pDestContainers, float fMaxEdgeCost );
 DLLEXPORT void 		AIEntityAssignPatrolPath ( int iEntityID, int iPathID );
 DLLEXPORT void		AIEntityAddTarget( int iEntityID, int iTargetID );
 DLLEXPORT void		AIEntityRemoveTarget( int iEntityID, int iTargetID );
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+struct sObject;
+struct sMesh;
+
+// two level bounding volume hierarchy for ray queries against scene objects.
+// The top level holds one box per object, made from its collision bounds in
+// world space, and is refitted as objects move with a full rebuild only once
+// enough objects have come and gone. The bottom level is a triangle tree per
+// mesh, built on first use and shared by every instance of that mesh. Changes
+// to either level are made from the main thread, once refitted the tree can be
+// queried from any number of threads (see IntersectAllBatch)
+class SceneBVH
+{
+public:
+    SceneBVH();
+    ~SceneBVH();
+
+    void addObject(int objectID);
+    void removeObject(int objectID);
+    // called whenever the world matrix, collision bounds or glue of an object change
+    void markDirty(sObject* pObject);
+    // brings the tree in line with the object list should an add or remove have been missed
+    void sync(const int* objectIDs, int count);
+    void clear();
+
+    int getObjectCount() const { return liveCount; }
+
+    // collects every object IntersectAllEx could accept along the ray from start
+    // to end, objects the tree cannot bound (glued, degenerate matrix) are always
+    // collected. Returns false for a ray the tree cannot handle (zero length)
+    bool gatherCandidates(const float start[3], const float end[3], std::vector<int>& objectIDs);
+
+    // the two halves of gatherCandidates. refit brings the tree up to date with
+    // any objects marked dirty, query then only reads the tree and walks it with
+    // the caller's traversal stack so it is safe to call from several threads at once
+    void refit();
+    bool query(const float start[3], const float end[3], std::vector<int>& objectIDs, std::vector<int>& traversal) const;
+
+private:
+    struct Item
+    {
+        int objectID;
+        int leaf;               // -1 until the next rebuild
+        bool dirty;
+        bool loose;             // tested by every query rather than through the tree
+        bool removed;
+        bool keyValid;
+        float bmin[3];
+        float bmax[3];
+        float centre[3];
+        float reach;            // how far past the end of a ray the box can still matter
+        float key[26];          // matWorld, collision box, radius and position when last refitted
+        int gluedTo;
+    };
+
+    struct Node
+    {
+        float bmin[3];
+        float bmax[3];
+        float reach;
+        int left;               // -1 for a leaf
+        int right;
+        int first;              // leaf range in order
+        int count;
+        int parent;
+    };
+
+    void rebuild();
+    int buildNode(int first, int count, int parent);
+    bool refitItem(int item);
+    void refitNode(int node);
+
+    std::vector<Item> items;
+    std::vector<Node> nodes;
+    std::vector<int> order;
+    std::vector<int> slotOfObject;      // indexed by object number, -1 when not held
+    std::vector<int> dirtyItems;
+    std::vector<int> looseItems;
+    std::vector<int> stack;
+    bool looseChanged;
+    int liveCount;
+    int treeCount;
+    int outsideTreeCount;
+    int removedCount;
+};
+
+// triangle tree for one mesh, used by GetRayCollisionEx in place of testing
+// every triangle of larger static meshes
+class MeshBVH
+{
+public:
+    // the tree for a mesh, built the first time it is asked for and rebuilt if
+    // the mesh data has changed since, NULL for meshes too small to need one
+    static MeshBVH* get(sMesh* pMesh);
+    static void release(sMesh* pMesh);
+
+    // closest triangle along the ray following the linear loop in GetRayCollisionEx,
+    // distances are multiplied by distanceScale before comparing, only hits beyond
+    // zero and nearer than bestDistance (when not zero) count and equal distances
+    // go to the lowest triangle. Reads only, so a tree can be shared by threads
+    bool intersect(sMesh* pMesh, const float origin[3], const float direction[3], float distanceScale, float bestDistance, int& triangle, float& distance) const;
+
+private:
+    struct Node
+    {
+        float bmin[3];
+        float bmax[3];
+        int right;              // left child is the next node, -1 for a leaf
+        int first;
+        int count;
+    };
+
+    MeshBVH();
+    bool build(sMesh* pMesh);
+    int buildNode(sMesh* pMesh, std::vector<float>& centres, int first, int count);
+    bool matches(sMesh* pMesh);
+    static unsigned int hashVertices(sMesh* pMesh, bool full);
+
+    std::vector<Node> nodes;
+    std::vector<int> triangles;         // triangle numbers in leaf order
+
+    // what the tree was built from, a change in any of these means a rebuild
+    const void* vertexData;
+    const void* indexData;
+    int primitiveCount;
+    unsigned int vertexCount;
+    unsigned int vertexSize;
+    unsigned int sampleHash;
+    unsigned int fullHash;
+
+    static std::unordered_map<sMesh*, MeshBVH*> cache;
+};
+
+extern SceneBVH g_SceneBVH;
@@ -15,6 +15,9 @@ CPU3D Clear
 // Do the Occluding
 CPU3D Occlude
 
+// Use the tiled occlusion rasterizer and batch occludee tests (0 off, 1 on)
+CPU3D Set Rasterizer mode
+
 */
 
 #ifndef __CPU3DCULLING__
@@ -38,6 +41,7 @@ void CPU3DShow( int show );
 void CPU3DOcclude ();
 void CPU3DDoOcclude ();
 void CPU3DSetCameraFar ( float f );
+void CPU3DSetRasterizer ( int mode );
 
 extern HANDLE   g_hOccluderBegin;
 extern HANDLE   g_hOccluderEnd;
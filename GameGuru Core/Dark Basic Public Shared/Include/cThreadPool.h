@@ -1,7 +1,7 @@
 #pragma once
 
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -9,54 +9,360 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <atomic>
+#include <type_traits>
 
+// a job is a plain function and payload pointer so scheduling never allocates,
+// the optional counter is decremented once the job has run
+struct cThreadPoolJob {
+    void (*func)(void*);
+    void* data;
+    std::atomic<int>* counter;
+};
+
+// bump allocator for task payloads that only live until the end of the frame,
+// allocation is lock free until the buffer is exhausted, then falls back to the
+// heap and the buffer is grown to the high water mark on the next reset
+class cFrameAllocator {
+public:
+    cFrameAllocator(size_t capacity);
+    ~cFrameAllocator();
+    void* alloc(size_t size);
+    template<class T> T* alloc_array(size_t count) { return static_cast<T*>(alloc(sizeof(T) * count)); }
+    // must only be called when no task still references frame memory
+    void reset();
+private:
+    char* buffer;
+    size_t capacity;
+    std::atomic<size_t> offset;
+    std::mutex overflow_mutex;
+    std::vector<char*> overflow;
+};
+
+inline cFrameAllocator::cFrameAllocator(size_t capacity)
+    :   buffer(new char[capacity]), capacity(capacity), offset(0)
+{
+}
+
+inline cFrameAllocator::~cFrameAllocator()
+{
+    reset();
+    delete [] buffer;
+}
+
+inline void* cFrameAllocator::alloc(size_t size)
+{
+    size = (size + 15) & ~(size_t)15;
+    size_t start = offset.fetch_add(size, std::memory_order_relaxed);
+    if(start + size <= capacity)
+        return buffer + start;
+
+    std::unique_lock<std::mutex> lock(overflow_mutex);
+    char* block = new char[size];
+    overflow.push_back(block);
+    return block;
+}
+
+inline void cFrameAllocator::reset()
+{
+    size_t used = offset.load(std::memory_order_relaxed);
+    if(used > capacity)
+    {
+        while(capacity < used) capacity *= 2;
+        delete [] buffer;
+        buffer = new char[capacity];
+    }
+    for(char* block: overflow)
+        delete [] block;
+    overflow.clear();
+    offset.store(0, std::memory_order_relaxed);
+}
+
+// work stealing pool, each worker owns a deque it pops from the back of while
+// idle workers and waiting threads steal from the front of the others. Jobs
+// added from outside the pool are spread round robin over the worker deques
 class cThreadPool {
 public:
     cThreadPool(size_t);
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
+    // calls func(i) for every i in [begin,end), split into jobs of grain
+    // indices, the calling thread helps and returns once all have run
+    template<class F>
+    void parallel_for(int begin, int end, int grain, F&& func);
+    // runs queued jobs on the calling thread until counter reaches zero
+    void wait(std::atomic<int>* counter);
+    size_t size() const { return workers.size(); }
+    // frame memory belongs to the thread that resets it once a frame, other
+    // threads never take from it so a reset can not pull memory from under them
+    cFrameAllocator& frame() { return frame_allocator; }
+    void frame_reset() { frame_allocator.reset(); frame_owner = std::this_thread::get_id(); }
+    bool in_frame() const { return std::this_thread::get_id() == frame_owner.load(); }
     ~cThreadPool();
 private:
+    struct worker_queue {
+        std::mutex lock;
+        std::deque<cThreadPoolJob> jobs;
+    };
+    template<class F>
+    struct range_data {
+        F* func;
+        int begin;
+        int end;
+    };
+    template<class F>
+    static void run_range(void* data);
+    template<class R>
+    static void run_task(void* data);
+
+    void push(const cThreadPoolJob* jobs, int count);
+    bool try_pop(int index, cThreadPoolJob& job);
+    void execute(cThreadPoolJob& job);
+    int worker_index();
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std.queue< std::function<void()> > tasks;
+    // one deque per worker
+    std::vector< std::unique_ptr<worker_queue> > queues;
+    std::atomic<unsigned int> next_queue;
+    std::atomic<int> pending;
+    cFrameAllocator frame_allocator;
+    std::atomic<std::thread::id> frame_owner;
 
-    // synchronization
-    std::mutex queue_mutex;
+    // idle workers sleep here until something is pushed
+    std::mutex sleep_mutex;
     std::condition_variable condition;
-    bool stop;
+    std::atomic<int> sleeping;
+    std::atomic<bool> stop;
+};
+
+// which pool and deque the current thread works for
+struct cThreadPoolWorkerInfo {
+    cThreadPool* pool;
+    int index;
 };
 
+inline cThreadPoolWorkerInfo& cThreadPoolCurrentWorker()
+{
+    static thread_local cThreadPoolWorkerInfo info = { NULL, -1 };
+    return info;
+}
+
 // the constructor just launches some amount of workers
 inline cThreadPool::cThreadPool(size_t threads)
-    :   stop(false)
+    :   next_queue(0), pending(0), frame_allocator(64 * 1024), frame_owner(std::thread::id()), sleeping(0), stop(false)
 {
+    for(size_t i = 0;i<threads;++i)
+        queues.emplace_back(new worker_queue());
+
     for(size_t i = 0;i<threads;++i)
         workers.emplace_back(
-            [this]
+            [this, i]
             {
+                cThreadPoolCurrentWorker().pool = this;
+                cThreadPoolCurrentWorker().index = (int)i;
+
                 for(;;)
                 {
-                    std::function<void()> task;
-
+                    cThreadPoolJob job;
+                    if(this->try_pop((int)i, job))
                     {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
+                        this->execute(job);
+                        continue;
                     }
 
-                    task();
+                    std::unique_lock<std::mutex> lock(this->sleep_mutex);
+                    ++this->sleeping;
+                    this->condition.wait(lock,
+                        [this]{ return this->stop || this->pending.load() > 0; });
+                    --this->sleeping;
+                    if(this->stop && this->pending.load() == 0)
+                        return;
                 }
             }
         );
 }
 
+inline int cThreadPool::worker_index()
+{
+    cThreadPoolWorkerInfo& info = cThreadPoolCurrentWorker();
+    return info.pool == this ? info.index : -1;
+}
+
+inline void cThreadPool::push(const cThreadPoolJob* jobs, int count)
+{
+    if(count <= 0) return;
+
+    // no workers, run in place
+    if(queues.empty())
+    {
+        for(int j = 0; j < count; ++j)
+        {
+            cThreadPoolJob job = jobs[j];
+            execute(job);
+        }
+        return;
+    }
+
+    int index = worker_index();
+    if(index >= 0)
+    {
+        // nested work goes on our own deque, others will steal it
+        std::unique_lock<std::mutex> lock(queues[index]->lock);
+        queues[index]->jobs.insert(queues[index]->jobs.end(), jobs, jobs + count);
+    }
+    else
+    {
+        // split into one contiguous run per deque so each lock is taken once
+        int numqueues = (int)queues.size();
+        int per = (count + numqueues - 1) / numqueues;
+        unsigned int first = next_queue.fetch_add(1, std::memory_order_relaxed);
+        for(int start = 0, q = 0; start < count; start += per, ++q)
+        {
+            int stop_at = start + per < count ? start + per : count;
+            worker_queue* queue = queues[(first + q) % numqueues].get();
+            std::unique_lock<std::mutex> lock(queue->lock);
+            queue->jobs.insert(queue->jobs.end(), jobs + start, jobs + stop_at);
+        }
+    }
+
+    pending.fetch_add(count);
+    if(sleeping.load() > 0)
+    {
+        { std::unique_lock<std::mutex> lock(sleep_mutex); }
+        if(count == 1) condition.notify_one();
+        else condition.notify_all();
+    }
+}
+
+inline bool cThreadPool::try_pop(int index, cThreadPoolJob& job)
+{
+    int numqueues = (int)queues.size();
+    if(numqueues == 0 || pending.load(std::memory_order_relaxed) <= 0)
+        return false;
+
+    // newest local job first, it is most likely still in cache
+    if(index >= 0)
+    {
+        worker_queue* queue = queues[index].get();
+        std::unique_lock<std::mutex> lock(queue->lock);
+        if(!queue->jobs.empty())
+        {
+            job = queue->jobs.back();
+            queue->jobs.pop_back();
+            pending.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // steal the oldest job from another deque
+    int start = index >= 0 ? index + 1 : (int)(next_queue.load(std::memory_order_relaxed) % numqueues);
+    for(int n = 0; n < numqueues; ++n)
+    {
+        worker_queue* queue = queues[(start + n) % numqueues].get();
+        std::unique_lock<std::mutex> lock(queue->lock, std::try_to_lock);
+        if(!lock.owns_lock() || queue->jobs.empty())
+            continue;
+        job = queue->jobs.front();
+        queue->jobs.pop_front();
+        pending.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+inline void cThreadPool::execute(cThreadPoolJob& job)
+{
+    job.func(job.data);
+    if(job.counter)
+        job.counter->fetch_sub(1, std::memory_order_release);
+}
+
+inline void cThreadPool::wait(std::atomic<int>* counter)
+{
+    int index = worker_index();
+    while(counter->load(std::memory_order_acquire) > 0)
+    {
+        cThreadPoolJob job;
+        if(try_pop(index, job))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+template<class F>
+void cThreadPool::run_range(void* data)
+{
+    range_data<F>* range = static_cast<range_data<F>*>(data);
+    for(int i = range->begin; i < range->end; ++i)
+        (*range->func)(i);
+}
+
+template<class R>
+void cThreadPool::run_task(void* data)
+{
+    std::shared_ptr< std::packaged_task<R()> >* task = static_cast<std::shared_ptr< std::packaged_task<R()> >*>(data);
+    (**task)();
+    delete task;
+}
+
+template<class F>
+void cThreadPool::parallel_for(int begin, int end, int grain, F&& func)
+{
+    typedef typename std::remove_reference<F>::type func_type;
+
+    if(end <= begin) return;
+    if(grain < 1) grain = 1;
+
+    int chunks = (end - begin + grain - 1) / grain;
+    if(chunks == 1 || workers.empty())
+    {
+        for(int i = begin; i < end; ++i)
+            func(i);
+        return;
+    }
+
+    // small loops keep their payloads on the stack, larger ones use frame memory
+    // on the frame thread and otherwise a block freed when the loop returns
+    const int local_chunks = 64;
+    range_data<func_type> local_ranges[local_chunks];
+    cThreadPoolJob local_jobs[local_chunks];
+    range_data<func_type>* ranges = local_ranges;
+    cThreadPoolJob* jobs = local_jobs;
+    std::unique_ptr<char[]> scoped;
+    if(chunks > local_chunks)
+    {
+        if(in_frame())
+        {
+            ranges = frame_allocator.alloc_array< range_data<func_type> >(chunks);
+            jobs = frame_allocator.alloc_array<cThreadPoolJob>(chunks);
+        }
+        else
+        {
+            size_t range_bytes = (sizeof(range_data<func_type>) * chunks + 15) & ~(size_t)15;
+            scoped.reset(new char[range_bytes + sizeof(cThreadPoolJob) * chunks]);
+            ranges = reinterpret_cast<range_data<func_type>*>(scoped.get());
+            jobs = reinterpret_cast<cThreadPoolJob*>(scoped.get() + range_bytes);
+        }
+    }
+
+    std::atomic<int> counter(chunks);
+    for(int c = 0; c < chunks; ++c)
+    {
+        ranges[c].func = &func;
+        ranges[c].begin = begin + c * grain;
+        ranges[c].end = ranges[c].begin + grain < end ? ranges[c].begin + grain : end;
+        jobs[c].func = &run_range<func_type>;
+        jobs[c].data = &ranges[c];
+        jobs[c].counter = &counter;
+    }
+
+    push(jobs, chunks);
+    wait(&counter);
+}
+
 // add new work item to the pool
 template<class F, class... Args>
 auto cThreadPool::enqueue(F&& f, Args&&... args)
@@ -69,24 +375,24 @@ auto cThreadPool::enqueue(F&& f, Args&&... args)
         );
 
     std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
 
-        // don't allow enqueueing after stopping the pool
-        if(stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+    // don't allow enqueueing after stopping the pool
+    if(stop)
+        throw std::runtime_error("enqueue on stopped ThreadPool");
 
-        tasks.emplace([task](){ (*task)(); });
-    }
-    condition.notify_one();
+    cThreadPoolJob job;
+    job.func = &run_task<return_type>;
+    job.data = new std::shared_ptr< std::packaged_task<return_type()> >(task);
+    job.counter = NULL;
+    push(&job, 1);
     return res;
 }
 
-// the destructor joins all threads
+// the destructor joins all threads, queued jobs are drained first
 inline cThreadPool::~cThreadPool()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         stop = true;
     }
     condition.notify_all();
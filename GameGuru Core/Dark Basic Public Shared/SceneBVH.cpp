@@ -0,0 +1,862 @@
+#include "SceneBVH.h"
+#include "CObjectsC.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// objects (top level) and triangles (bottom level) held per leaf
+#define SCENEBVH_LEAF_SIZE 4
+#define MESHBVH_LEAF_SIZE 4
+// meshes with fewer triangles than this are quicker to test in full
+#define MESHBVH_MIN_TRIANGLES 64
+
+SceneBVH g_SceneBVH;
+std::unordered_map<sMesh*, MeshBVH*> MeshBVH::cache;
+
+static inline bool IsFinite(float value)
+{
+    return value == value && value <= FLT_MAX && value >= -FLT_MAX;
+}
+
+// slab test of the part of a ray from 0 to limit against a box, entry is where
+// the ray enters it. Nearly parallel axes are treated as parallel, the boxes are
+// padded to more than cover the difference
+static inline bool RayBoxRange(const float origin[3], const float direction[3], const float inverse[3], const float bmin[3], const float bmax[3], float limit, float& entry)
+{
+    if (bmin[0] > bmax[0])
+        return false;
+
+    float tNear = 0.0f;
+    float tFar = limit;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (fabsf(direction[i]) < 1e-12f)
+        {
+            if (origin[i] < bmin[i] || origin[i] > bmax[i])
+                return false;
+            continue;
+        }
+        float t1 = (bmin[i] - origin[i]) * inverse[i];
+        float t2 = (bmax[i] - origin[i]) * inverse[i];
+        if (t1 > t2)
+            std::swap(t1, t2);
+        if (t1 > tNear) tNear = t1;
+        if (t2 < tFar) tFar = t2;
+        if (tNear > tFar)
+            return false;
+    }
+    entry = tNear;
+    return true;
+}
+
+static inline void EmptyBox(float bmin[3], float bmax[3])
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        bmin[i] = FLT_MAX;
+        bmax[i] = -FLT_MAX;
+    }
+}
+
+static inline void GrowBox(float bmin[3], float bmax[3], const float pmin[3], const float pmax[3])
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (pmin[i] < bmin[i]) bmin[i] = pmin[i];
+        if (pmax[i] > bmax[i]) bmax[i] = pmax[i];
+    }
+}
+
+//
+// SceneBVH
+//
+
+SceneBVH::SceneBVH()
+{
+    looseChanged = false;
+    liveCount = 0;
+    treeCount = 0;
+    outsideTreeCount = 0;
+    removedCount = 0;
+}
+
+SceneBVH::~SceneBVH()
+{
+}
+
+void SceneBVH::clear()
+{
+    items.clear();
+    nodes.clear();
+    order.clear();
+    slotOfObject.clear();
+    dirtyItems.clear();
+    looseItems.clear();
+    looseChanged = false;
+    liveCount = 0;
+    treeCount = 0;
+    outsideTreeCount = 0;
+    removedCount = 0;
+}
+
+void SceneBVH::addObject(int objectID)
+{
+    if (objectID <= 0)
+        return;
+
+    if (objectID >= (int)slotOfObject.size())
+        slotOfObject.resize(objectID + 1, -1);
+
+    // an object number reused by a new object keeps its slot
+    int slot = slotOfObject[objectID];
+    if (slot < 0)
+    {
+        Item item;
+        memset(&item, 0, sizeof(Item));
+        item.objectID = objectID;
+        item.leaf = -1;
+        EmptyBox(item.bmin, item.bmax);
+
+        slot = (int)items.size();
+        items.push_back(item);
+        slotOfObject[objectID] = slot;
+        liveCount++;
+        outsideTreeCount++;
+        looseChanged = true;
+    }
+
+    Item& item = items[slot];
+    item.keyValid = false;
+    if (!item.dirty)
+    {
+        item.dirty = true;
+        dirtyItems.push_back(slot);
+    }
+}
+
+void SceneBVH::removeObject(int objectID)
+{
+    if (objectID <= 0 || objectID >= (int)slotOfObject.size())
+        return;
+    int slot = slotOfObject[objectID];
+    if (slot < 0)
+        return;
+
+    Item& item = items[slot];
+    item.removed = true;
+    slotOfObject[objectID] = -1;
+    liveCount--;
+    removedCount++;
+    if (item.loose || item.leaf < 0)
+        looseChanged = true;
+    if (item.leaf >= 0)
+        refitNode(item.leaf);
+    else
+        outsideTreeCount--;
+}
+
+void SceneBVH::markDirty(sObject* pObject)
+{
+    if (pObject == NULL)
+        return;
+
+    int objectID = (int)pObject->dwObjectNumber;
+    if (objectID <= 0 || objectID >= (int)slotOfObject.size())
+        return;
+    int slot = slotOfObject[objectID];
+    if (slot < 0)
+        return;
+
+    // world matrices are also calculated for temporary objects that borrow a number
+    if (objectID >= g_iObjectListCount || g_ObjectList[objectID] != pObject)
+        return;
+
+    Item& item = items[slot];
+    if (!item.dirty)
+    {
+        item.dirty = true;
+        dirtyItems.push_back(slot);
+    }
+}
+
+void SceneBVH::sync(const int* objectIDs, int count)
+{
+    std::vector<char> present(slotOfObject.size(), 0);
+    for (int i = 0; i < count; ++i)
+    {
+        int objectID = objectIDs[i];
+        if (objectID <= 0)
+            continue;
+        addObject(objectID);
+        if (objectID >= (int)present.size())
+            present.resize(objectID + 1, 0);
+        present[objectID] = 1;
+    }
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (!items[i].removed && !present[items[i].objectID])
+            removeObject(items[i].objectID);
+    }
+}
+
+bool SceneBVH::refitItem(int slot)
+{
+    Item& item = items[slot];
+    item.dirty = false;
+    if (item.removed)
+        return false;
+
+    sObject* pObject = NULL;
+    if (item.objectID < g_iObjectListCount)
+        pObject = g_ObjectList[item.objectID];
+    if (pObject == NULL)
+    {
+        // nothing to bound, queries skip missing objects themselves
+        bool wasLoose = item.loose;
+        item.keyValid = false;
+        item.loose = false;
+        item.reach = 0.0f;
+        EmptyBox(item.bmin, item.bmax);
+        if (wasLoose)
+            looseChanged = true;
+        return true;
+    }
+
+    // most objects flagged each frame have not actually changed
+    const GGMATRIX& matWorld = pObject->position.matWorld;
+    float key[26];
+    memcpy(key, &matWorld, sizeof(float) * 16);
+    key[16] = pObject->collision.vecMin.x;
+    key[17] = pObject->collision.vecMin.y;
+    key[18] = pObject->collision.vecMin.z;
+    key[19] = pObject->collision.vecMax.x;
+    key[20] = pObject->collision.vecMax.y;
+    key[21] = pObject->collision.vecMax.z;
+    key[22] = pObject->collision.fLargestRadius;
+    key[23] = pObject->position.vecPosition.x;
+    key[24] = pObject->position.vecPosition.y;
+    key[25] = pObject->position.vecPosition.z;
+    if (item.keyValid && item.gluedTo == pObject->position.iGluedToObj && memcmp(key, item.key, sizeof(key)) == 0)
+        return false;
+    memcpy(item.key, key, sizeof(key));
+    item.keyValid = true;
+    item.gluedTo = pObject->position.iGluedToObj;
+
+    // the same box IntersectAllEx tests, grown in Y by half its height. The slab
+    // test there treats a box with min above max as the box between them
+    float fHeightSize = fabsf(key[20] - key[17]) * 0.5f;
+    float boxA[3] = { key[16], key[17] - fHeightSize, key[18] };
+    float boxB[3] = { key[19], key[20] + fHeightSize, key[21] };
+    float lo[3], hi[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        lo[i] = boxA[i] < boxB[i] ? boxA[i] : boxB[i];
+        hi[i] = boxA[i] < boxB[i] ? boxB[i] : boxA[i];
+    }
+
+    // glued objects are range checked from their parent, and a box can only be
+    // bounded in world space through an affine matrix that can be inverted
+    bool loose = item.gluedTo > 0;
+    if (matWorld._14 != 0.0f || matWorld._24 != 0.0f || matWorld._34 != 0.0f || matWorld._44 != 1.0f)
+        loose = true;
+    float fDet = matWorld._11 * (matWorld._22 * matWorld._33 - matWorld._23 * matWorld._32)
+               - matWorld._12 * (matWorld._21 * matWorld._33 - matWorld._23 * matWorld._31)
+               + matWorld._13 * (matWorld._21 * matWorld._32 - matWorld._22 * matWorld._31);
+    if (!(fabsf(fDet) > 1e-12f) || !IsFinite(fDet))
+        loose = true;
+
+    float bmin[3], bmax[3];
+    EmptyBox(bmin, bmax);
+    float position[3] = { key[23], key[24], key[25] };
+    float furthest = 0.0f;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        float x = (corner & 1) ? hi[0] : lo[0];
+        float y = (corner & 2) ? hi[1] : lo[1];
+        float z = (corner & 4) ? hi[2] : lo[2];
+        float world[3] = {
+            x * matWorld._11 + y * matWorld._21 + z * matWorld._31 + matWorld._41,
+            x * matWorld._12 + y * matWorld._22 + z * matWorld._32 + matWorld._42,
+            x * matWorld._13 + y * matWorld._23 + z * matWorld._33 + matWorld._43 };
+        GrowBox(bmin, bmax, world, world);
+        float dx = world[0] - position[0];
+        float dy = world[1] - position[1];
+        float dz = world[2] - position[2];
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+        if (distance > furthest) furthest = distance;
+    }
+
+    // a box entered past the end of the ray can still be accepted by the range
+    // check, which allows three times the largest radius beyond the ray length,
+    // so the ray is followed that far plus the furthest corner from the position
+    float reach = key[22] * 3.0f + furthest;
+    if (reach < 0.0f) reach = 0.0f;
+
+    float largest = 1.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!IsFinite(bmin[i]) || !IsFinite(bmax[i]) || !IsFinite(position[i]))
+            loose = true;
+        largest = std::max(largest, std::max(fabsf(bmin[i]), fabsf(bmax[i])));
+    }
+    if (!IsFinite(reach))
+        loose = true;
+
+    // the tree tests in world space what IntersectAllEx tests in object space,
+    // pad so rounding between the two can only add candidates
+    float pad = largest * 1e-5f;
+    for (int i = 0; i < 3; ++i)
+    {
+        item.bmin[i] = bmin[i] - pad;
+        item.bmax[i] = bmax[i] + pad;
+        item.centre[i] = IsFinite(position[i]) ? position[i] : 0.0f;
+    }
+    item.reach = reach + pad;
+
+    if (loose)
+    {
+        EmptyBox(item.bmin, item.bmax);
+        item.reach = 0.0f;
+    }
+    if (loose != item.loose)
+    {
+        item.loose = loose;
+        looseChanged = true;
+    }
+    return true;
+}
+
+void SceneBVH::refitNode(int index)
+{
+    while (index >= 0)
+    {
+        float bmin[3], bmax[3];
+        float reach = 0.0f;
+        EmptyBox(bmin, bmax);
+
+        Node& node = nodes[index];
+        if (node.left < 0)
+        {
+            for (int i = 0; i < node.count; ++i)
+            {
+                const Item& item = items[order[node.first + i]];
+                if (item.removed || item.loose || item.bmin[0] > item.bmax[0])
+                    continue;
+                GrowBox(bmin, bmax, item.bmin, item.bmax);
+                if (item.reach > reach) reach = item.reach;
+            }
+        }
+        else
+        {
+            const Node& left = nodes[node.left];
+            const Node& right = nodes[node.right];
+            if (left.bmin[0] <= left.bmax[0])
+                GrowBox(bmin, bmax, left.bmin, left.bmax);
+            if (right.bmin[0] <= right.bmax[0])
+                GrowBox(bmin, bmax, right.bmin, right.bmax);
+            reach = std::max(left.reach, right.reach);
+        }
+
+        // parents only need touching while the bounds keep changing
+        if (memcmp(bmin, node.bmin, sizeof(bmin)) == 0 && memcmp(bmax, node.bmax, sizeof(bmax)) == 0 && reach == node.reach)
+            return;
+        memcpy(node.bmin, bmin, sizeof(bmin));
+        memcpy(node.bmax, bmax, sizeof(bmax));
+        node.reach = reach;
+        index = node.parent;
+    }
+}
+
+int SceneBVH::buildNode(int first, int count, int parent)
+{
+    int index = (int)nodes.size();
+    Node node;
+    memset(&node, 0, sizeof(Node));
+    node.parent = parent;
+    node.left = -1;
+    node.right = -1;
+    EmptyBox(node.bmin, node.bmax);
+    nodes.push_back(node);
+
+    if (count <= SCENEBVH_LEAF_SIZE)
+    {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        for (int i = 0; i < count; ++i)
+            items[order[first + i]].leaf = index;
+    }
+    else
+    {
+        // split at the median along the widest spread of positions
+        float cmin[3], cmax[3];
+        EmptyBox(cmin, cmax);
+        for (int i = 0; i < count; ++i)
+        {
+            const float* centre = items[order[first + i]].centre;
+            GrowBox(cmin, cmax, centre, centre);
+        }
+        int axis = 0;
+        if (cmax[1] - cmin[1] > cmax[axis] - cmin[axis]) axis = 1;
+        if (cmax[2] - cmin[2] > cmax[axis] - cmin[axis]) axis = 2;
+
+        int half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+            [this, axis](int a, int b) { return items[a].centre[axis] < items[b].centre[axis]; });
+
+        int left = buildNode(first, half, index);
+        int right = buildNode(first + half, count - half, index);
+        nodes[index].left = left;
+        nodes[index].right = right;
+    }
+
+    // children are complete so this only has to do the one node
+    int keepParent = nodes[index].parent;
+    nodes[index].parent = -1;
+    refitNode(index);
+    nodes[index].parent = keepParent;
+    return index;
+}
+
+void SceneBVH::rebuild()
+{
+    // drop removed objects and renumber the slots
+    std::vector<Item> kept;
+    kept.reserve(liveCount);
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (items[i].removed)
+            continue;
+        slotOfObject[items[i].objectID] = (int)kept.size();
+        kept.push_back(items[i]);
+        kept.back().leaf = -1;
+    }
+    items.swap(kept);
+
+    int count = (int)items.size();
+    order.resize(count);
+    for (int i = 0; i < count; ++i)
+        order[i] = i;
+
+    nodes.clear();
+    nodes.reserve(count * 2);
+    if (count > 0)
+        buildNode(0, count, -1);
+
+    treeCount = count;
+    outsideTreeCount = 0;
+    removedCount = 0;
+    looseChanged = true;
+}
+
+void SceneBVH::refit()
+{
+    for (size_t i = 0; i < dirtyItems.size(); ++i)
+    {
+        int slot = dirtyItems[i];
+        if (refitItem(slot) && items[slot].leaf >= 0)
+            refitNode(items[slot].leaf);
+    }
+    dirtyItems.clear();
+
+    // refitting keeps queries correct but new objects are tested outside the
+    // tree and removed ones leave holes, so rebuild once either has built up
+    if (outsideTreeCount > 16 + treeCount / 8 || removedCount > 16 + treeCount / 4)
+        rebuild();
+
+    if (looseChanged)
+    {
+        looseItems.clear();
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            const Item& item = items[i];
+            if (!item.removed && (item.loose || item.leaf < 0))
+                looseItems.push_back((int)i);
+        }
+        looseChanged = false;
+    }
+}
+
+bool SceneBVH::gatherCandidates(const float start[3], const float end[3], std::vector<int>& objectIDs)
+{
+    refit();
+    return query(start, end, objectIDs, stack);
+}
+
+bool SceneBVH::query(const float start[3], const float end[3], std::vector<int>& objectIDs, std::vector<int>& traversal) const
+{
+    float direction[3] = { end[0] - start[0], end[1] - start[1], end[2] - start[2] };
+    float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    if (!(length > 0.0f) || !IsFinite(length) || !IsFinite(start[0]) || !IsFinite(start[1]) || !IsFinite(start[2]))
+        return false;
+
+    float inverse[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        direction[i] /= length;
+        inverse[i] = fabsf(direction[i]) < 1e-12f ? 0.0f : 1.0f / direction[i];
+    }
+
+    traversal.clear();
+    if (!nodes.empty())
+        traversal.push_back(0);
+    while (!traversal.empty())
+    {
+        int index = traversal.back();
+        traversal.pop_back();
+
+        const Node& node = nodes[index];
+        float entry;
+        if (!RayBoxRange(start, direction, inverse, node.bmin, node.bmax, length + node.reach, entry))
+            continue;
+
+        if (node.left >= 0)
+        {
+            traversal.push_back(node.right);
+            traversal.push_back(node.left);
+            continue;
+        }
+        for (int i = 0; i < node.count; ++i)
+        {
+            const Item& item = items[order[node.first + i]];
+            if (item.removed || item.loose)
+                continue;
+            if (RayBoxRange(start, direction, inverse, item.bmin, item.bmax, length + item.reach, entry))
+                objectIDs.push_back(item.objectID);
+        }
+    }
+
+    for (size_t i = 0; i < looseItems.size(); ++i)
+        objectIDs.push_back(items[looseItems[i]].objectID);
+    return true;
+}
+
+//
+// MeshBVH
+//
+
+// vertex and triangle addressing exactly as the linear loop in GetRayCollisionEx
+static inline GGVECTOR3* MeshBVHVertex(sMesh* pMesh, DWORD dwVertex)
+{
+    return (GGVECTOR3*)((float*)pMesh->pVertexData + dwVertex * (pMesh->dwFVFSize / 4));
+}
+
+static inline void MeshBVHTriangle(sMesh* pMesh, int iTriangle, DWORD dwVertex[3])
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (pMesh->pIndices)
+            dwVertex[i] = pMesh->pIndices[iTriangle * 3 + i];
+        else
+            dwVertex[i] = iTriangle * 3 + i;
+    }
+}
+
+MeshBVH::MeshBVH()
+{
+    vertexData = NULL;
+    indexData = NULL;
+    primitiveCount = 0;
+    vertexCount = 0;
+    vertexSize = 0;
+    sampleHash = 0;
+    fullHash = 0;
+}
+
+MeshBVH* MeshBVH::get(sMesh* pMesh)
+{
+    if (pMesh == NULL || pMesh->pVertexData == NULL || pMesh->iDrawPrimitives < MESHBVH_MIN_TRIANGLES)
+        return NULL;
+
+    MeshBVH* pTree = NULL;
+    std::unordered_map<sMesh*, MeshBVH*>::iterator it = cache.find(pMesh);
+    if (it != cache.end())
+    {
+        pTree = it->second;
+        if (!pTree->matches(pMesh))
+        {
+            delete pTree;
+            cache.erase(it);
+            pTree = NULL;
+        }
+    }
+    if (pTree == NULL)
+    {
+        pTree = new MeshBVH();
+        pTree->build(pMesh);
+        cache[pMesh] = pTree;
+    }
+
+    // a mesh that could not be built is remembered so it is not retried every ray
+    return pTree->nodes.empty() ? NULL : pTree;
+}
+
+void MeshBVH::release(sMesh* pMesh)
+{
+    if (cache.empty())
+        return;
+    std::unordered_map<sMesh*, MeshBVH*>::iterator it = cache.find(pMesh);
+    if (it != cache.end())
+    {
+        delete it->second;
+        cache.erase(it);
+    }
+}
+
+unsigned int MeshBVH::hashVertices(sMesh* pMesh, bool full)
+{
+    // positions only, a sample of them unless asked for all
+    DWORD dwStep = 1;
+    if (!full && pMesh->dwVertexCount > 32)
+        dwStep = pMesh->dwVertexCount / 32;
+    unsigned int hash = 2166136261u;
+    for (DWORD v = 0; v < pMesh->dwVertexCount; v += dwStep)
+    {
+        const unsigned char* pBytes = (const unsigned char*)MeshBVHVertex(pMesh, v);
+        for (int b = 0; b < (int)sizeof(GGVECTOR3); ++b)
+            hash = (hash ^ pBytes[b]) * 16777619u;
+    }
+    return hash;
+}
+
+bool MeshBVH::matches(sMesh* pMesh)
+{
+    if (vertexData != pMesh->pVertexData || indexData != pMesh->pIndices)
+        return false;
+    if (primitiveCount != pMesh->iDrawPrimitives || vertexCount != pMesh->dwVertexCount || vertexSize != pMesh->dwFVFSize)
+        return false;
+    if (sampleHash != hashVertices(pMesh, false))
+        return false;
+
+    // vertex data written in place flags the mesh for a refresh, which is the
+    // only time it is worth checking every vertex
+    if (pMesh->bVBRefreshRequired && fullHash != hashVertices(pMesh, true))
+        return false;
+    return true;
+}
+
+bool MeshBVH::build(sMesh* pMesh)
+{
+    vertexData = pMesh->pVertexData;
+    indexData = pMesh->pIndices;
+    primitiveCount = pMesh->iDrawPrimitives;
+    vertexCount = pMesh->dwVertexCount;
+    vertexSize = pMesh->dwFVFSize;
+    sampleHash = hashVertices(pMesh, false);
+    fullHash = hashVertices(pMesh, true);
+    nodes.clear();
+    triangles.clear();
+
+    // the linear loop reads whatever the counts say, only build a tree when
+    // every triangle lies within the mesh data
+    if (pMesh->dwFVFSize < sizeof(GGVECTOR3))
+        return false;
+    DWORD dwCorners = (DWORD)primitiveCount * 3;
+    if (pMesh->pIndices)
+    {
+        if (dwCorners > pMesh->dwIndexCount)
+            return false;
+        for (DWORD i = 0; i < dwCorners; ++i)
+            if (pMesh->pIndices[i] >= pMesh->dwVertexCount)
+                return false;
+    }
+    else if (dwCorners > pMesh->dwVertexCount)
+    {
+        return false;
+    }
+
+    std::vector<float> centres(primitiveCount * 3);
+    triangles.resize(primitiveCount);
+    for (int t = 0; t < primitiveCount; ++t)
+    {
+        DWORD dwVertex[3];
+        MeshBVHTriangle(pMesh, t, dwVertex);
+        GGVECTOR3* pVec0 = MeshBVHVertex(pMesh, dwVertex[0]);
+        GGVECTOR3* pVec1 = MeshBVHVertex(pMesh, dwVertex[1]);
+        GGVECTOR3* pVec2 = MeshBVHVertex(pMesh, dwVertex[2]);
+        float centre[3] = {
+            (pVec0->x + pVec1->x + pVec2->x) / 3.0f,
+            (pVec0->y + pVec1->y + pVec2->y) / 3.0f,
+            (pVec0->z + pVec1->z + pVec2->z) / 3.0f };
+        for (int i = 0; i < 3; ++i)
+            centres[t * 3 + i] = IsFinite(centre[i]) ? centre[i] : 0.0f;
+        triangles[t] = t;
+    }
+
+    nodes.reserve((primitiveCount / MESHBVH_LEAF_SIZE) * 2 + 1);
+    buildNode(pMesh, centres, 0, primitiveCount);
+
+    // pad every node so hits GGIntersectTri finds on the edge of a box are not culled
+    float largest = 1.0f;
+    for (int i = 0; i < 3; ++i)
+        largest = std::max(largest, std::max(fabsf(nodes[0].bmin[i]), fabsf(nodes[0].bmax[i])));
+    float pad = largest * 1e-4f;
+    for (size_t n = 0; n < nodes.size(); ++n)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            nodes[n].bmin[i] -= pad;
+            nodes[n].bmax[i] += pad;
+        }
+    }
+    return true;
+}
+
+int MeshBVH::buildNode(sMesh* pMesh, std::vector<float>& centres, int first, int count)
+{
+    int index = (int)nodes.size();
+    Node node;
+    node.right = -1;
+    node.first = first;
+    node.count = count;
+    EmptyBox(node.bmin, node.bmax);
+    nodes.push_back(node);
+
+    if (count <= MESHBVH_LEAF_SIZE)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            DWORD dwVertex[3];
+            MeshBVHTriangle(pMesh, triangles[first + i], dwVertex);
+            for (int c = 0; c < 3; ++c)
+            {
+                const float* pPosition = (const float*)MeshBVHVertex(pMesh, dwVertex[c]);
+                GrowBox(nodes[index].bmin, nodes[index].bmax, pPosition, pPosition);
+            }
+        }
+        return index;
+    }
+
+    // split at the median along the widest spread of triangle centres
+    float cmin[3], cmax[3];
+    EmptyBox(cmin, cmax);
+    for (int i = 0; i < count; ++i)
+    {
+        const float* centre = &centres[triangles[first + i] * 3];
+        GrowBox(cmin, cmax, centre, centre);
+    }
+    int axis = 0;
+    if (cmax[1] - cmin[1] > cmax[axis] - cmin[axis]) axis = 1;
+    if (cmax[2] - cmin[2] > cmax[axis] - cmin[axis]) axis = 2;
+
+    int half = count / 2;
+    std::nth_element(triangles.begin() + first, triangles.begin() + first + half, triangles.begin() + first + count,
+        [&centres, axis](int a, int b) { return centres[a * 3 + axis] < centres[b * 3 + axis]; });
+
+    buildNode(pMesh, centres, first, half);
+    int right = buildNode(pMesh, centres, first + half, count - half);
+    const Node& leftNode = nodes[index + 1];
+    const Node& rightNode = nodes[right];
+    nodes[index].right = right;
+    nodes[index].count = 0;
+    GrowBox(nodes[index].bmin, nodes[index].bmax, leftNode.bmin, leftNode.bmax);
+    GrowBox(nodes[index].bmin, nodes[index].bmax, rightNode.bmin, rightNode.bmax);
+    return index;
+}
+
+bool MeshBVH::intersect(sMesh* pMesh, const float origin[3], const float direction[3], float distanceScale, float bestDistance, int& triangle, float& distance) const
+{
+    GGVECTOR3 vecOrigin = GGVECTOR3(origin[0], origin[1], origin[2]);
+    GGVECTOR3 vecDirection = GGVECTOR3(direction[0], direction[1], direction[2]);
+    int iBestTriangle = -1;
+    float fBestDistance = 0.0f;
+
+    auto testTriangle = [&](int iTriangle)
+    {
+        DWORD dwVertex[3];
+        MeshBVHTriangle(pMesh, iTriangle, dwVertex);
+        GGVECTOR3* pVec0 = MeshBVHVertex(pMesh, dwVertex[0]);
+        GGVECTOR3* pVec1 = MeshBVHVertex(pMesh, dwVertex[1]);
+        GGVECTOR3* pVec2 = MeshBVHVertex(pMesh, dwVertex[2]);
+        float fU, fV, fThisDistance;
+        if (GGIntersectTri(pVec0, pVec1, pVec2, &vecOrigin, &vecDirection, &fU, &fV, &fThisDistance) == TRUE)
+        {
+            fThisDistance *= distanceScale;
+            if (fThisDistance > 0.0f)
+            {
+                if (iBestTriangle < 0 || fThisDistance < fBestDistance || (fThisDistance == fBestDistance && iTriangle < iBestTriangle))
+                {
+                    iBestTriangle = iTriangle;
+                    fBestDistance = fThisDistance;
+                }
+            }
+        }
+    };
+
+    bool bFinite = IsFinite(distanceScale) && distanceScale > 0.0f;
+    for (int i = 0; i < 3; ++i)
+        bFinite = bFinite && IsFinite(origin[i]) && IsFinite(direction[i]);
+    if (!bFinite)
+    {
+        // nothing sensible to cull with, test every triangle in order
+        for (int t = 0; t < primitiveCount; ++t)
+            testTriangle(t);
+    }
+    else
+    {
+        float inverse[3];
+        for (int i = 0; i < 3; ++i)
+            inverse[i] = fabsf(direction[i]) < 1e-12f ? 0.0f : 1.0f / direction[i];
+
+        int stack[128];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            // nodes are culled against the nearest hit so far, with some slack so
+            // a triangle at exactly that distance is still reached
+            float limit = FLT_MAX;
+            float nearest = bestDistance;
+            if (iBestTriangle >= 0 && (nearest == 0.0f || fBestDistance < nearest)) nearest = fBestDistance;
+            if (nearest > 0.0f) limit = (nearest / distanceScale) * 1.001f;
+
+            int index = stack[--stackSize];
+            const Node& node = nodes[index];
+            float entry;
+            if (!RayBoxRange(origin, direction, inverse, node.bmin, node.bmax, limit, entry))
+                continue;
+
+            if (node.right < 0)
+            {
+                for (int i = 0; i < node.count; ++i)
+                    testTriangle(triangles[node.first + i]);
+                continue;
+            }
+
+            // nearer child on top of the stack
+            int left = index + 1;
+            int right = node.right;
+            float leftEntry, rightEntry;
+            bool bLeft = RayBoxRange(origin, direction, inverse, nodes[left].bmin, nodes[left].bmax, limit, leftEntry);
+            bool bRight = RayBoxRange(origin, direction, inverse, nodes[right].bmin, nodes[right].bmax, limit, rightEntry);
+            if (bLeft && bRight)
+            {
+                if (leftEntry <= rightEntry)
+                {
+                    stack[stackSize++] = right;
+                    stack[stackSize++] = left;
+                }
+                else
+                {
+                    stack[stackSize++] = left;
+                    stack[stackSize++] = right;
+                }
+            }
+            else if (bLeft)
+            {
+                stack[stackSize++] = left;
+            }
+            else if (bRight)
+            {
+                stack[stackSize++] = right;
+            }
+        }
+    }
+
+    if (iBestTriangle < 0)
+        return false;
+    if (bestDistance != 0.0f && !(fBestDistance < bestDistance))
+        return false;
+    triangle = iBestTriangle;
+    distance = fBestDistance;
+    return true;
+}
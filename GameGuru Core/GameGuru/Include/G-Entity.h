@@ -4,9 +4,30 @@
 
 #include "cstr.h"
 
+// side effects found by entity_loop_thread, run in entity order by entity_loop_commands
+#define ENTITYLOOP_CMD_PROMPT2D				0x0001
+#define ENTITYLOOP_CMD_PROMPT3DHIDE			0x0002
+#define ENTITYLOOP_CMD_PROMPT3DUPDATE		0x0004
+#define ENTITYLOOP_CMD_RAGDOLLFORCE			0x0008
+#define ENTITYLOOP_CMD_PUSHPLAYER			0x0010
+#define ENTITYLOOP_CMD_FLINCHLIMB			0x0020
+#define ENTITYLOOP_CMD_NONTHREEDEESOUND		0x0040
+#define ENTITYLOOP_CMD_CHARACTERHEAD		0x0080
+#define ENTITYLOOP_CMD_PORTAL				0x0100
+#define ENTITYLOOP_CMD_DESTROY				0x0200
+
 struct entity_thread_data
 {
 	int e;
+
+	// per entity context filled by entity_loop_thread
+	int obj;
+	float dist;
+	unsigned int commands;
+	float ragdollforce;
+	float pushangle;
+	int flinchlimb;
+	int flinchsegment;
 };
 
 struct entity_init_thread_data
@@ -26,6 +47,7 @@ void entity_resumeanimations ( void );
 void entity_loop ( void );
 void entity_loopanim ( void );
 void entity_loop_thread(entity_thread_data* pData);
+void entity_loop_commands(entity_thread_data* pData);
 void entity_controlrecalcdist ( void );
 void entity_getmaxfreezedistance ( void );
 void entity_updatepos ( void );
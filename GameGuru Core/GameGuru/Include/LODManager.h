@@ -3,21 +3,57 @@
 #include <vector>
 #include "cVectorC.h"
 
+// distance based LOD selection for entity objects. Objects are held as
+// parallel arrays padded to a multiple of four so update() can compare
+// squared camera distances four at a time, and sObject is only written
+// when an object crosses into a new level
 class LODManager
 {
 public:
     LODManager();
     ~LODManager();
 
-    void addObject(int objectID);
+    // registers an object (or refreshes it if already known), distances and
+    // position are read from the object, dynamic objects are re-read each update
+    void addObject(int objectID, bool dynamic);
+    // called whenever the LOD distances of an object are recalculated
+    void setDistances(int objectID, float lod1Distance, float lod2Distance);
+    // stops tracking one object, the last slot moves into its place
+    void removeObject(int objectID);
+    void clear();
+
+    // fraction of the LOD distance an object must pass beyond a boundary
+    // before switching, stops objects flickering when sat on a boundary
+    void setHysteresis(float fraction);
+
     void update(const cVector3& cameraPosition);
 
 private:
-    struct LODObject
-    {
-        int objectID;
-        int lodLevel;
-    };
+    void grow(int count);
+    void setThresholds(int slot, float lod1Distance, float lod2Distance);
+    void refreshPosition(int slot);
+    void applyLevel(int slot);
+
+    int count;
+    float hysteresis;
+    int staticRefresh;
 
-    std::vector<LODObject> objects;
+    // one entry per slot, slot count is always a multiple of four
+    std::vector<int> objectID;
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> posZ;
+    std::vector<float> lod1Distance;
+    std::vector<float> lod2Distance;
+    std::vector<float> lod1Near;        // squared, used when at level 1 or above
+    std::vector<float> lod1Far;         // squared, used when below level 1
+    std::vector<float> lod2Near;
+    std::vector<float> lod2Far;
+    std::vector<int> level;
+    std::vector<unsigned char> isDynamic;
+
+    std::vector<int> slotOfObject;      // indexed by object number, -1 when not held
+    std::vector<int> dynamicSlots;
 };
+
+extern LODManager* g_pLODManager;
@@ -5,6 +5,13 @@
 #include "cstr.h"
 #include "types.h"
 
+// element list version this build writes to map.ele and map.elb
+#ifdef VRTECH
+#define ENTITYELEMENTVERSION	313
+#else
+#define ENTITYELEMENTVERSION	312
+#endif
+
 void entity_addtoselection_core ( void );
 void entity_addtoselection ( void );
 void entity_adduniqueentity ( bool bAllowDuplicates );
@@ -20,10 +27,13 @@ void entity_updatetextureandeffectfromgrideleprof ( void );
 void entity_getgunidandflakid ( void );
 void entity_loadtexturesandeffect ( void );
 void entity_saveelementsdata ( void );
+void entity_saveelementsbinary ( void );
 void entity_savebank ( void );
 void entity_savebank_ebe ( void );
 void entity_loadbank ( void );
 void entity_loadelementsdata ( void );
+void entity_loadelementsdata_finish ( void );
+int entity_loadelementsbinary ( void );
 void entity_loadentitiesnow ( void );
 void entity_deletebank ( void );
 void entity_deleteelementsdata ( void );
@@ -18,6 +18,11 @@ int mapfile_savestandalone_continue ( void );
 float mapfile_savestandalone_getprogress ( void );
 void mapfile_savestandalone_finish ( void );
 void mapfile_savestandalone_restoreandclose ( void );
+void mapfile_savestandalone_loadmanifest ( void );
+void mapfile_savestandalone_savemanifest ( void );
+void mapfile_savestandalone_copycollection ( void );
+void mapfile_savestandalone_prefetchscans ( void );
+void mapfile_savestandalone_endscans ( void );
 //void mapfile_savestandalone ( void );
 void scanscriptfileandaddtocollection ( char* tfile_s );
 bool addtocollection ( char* file_s );
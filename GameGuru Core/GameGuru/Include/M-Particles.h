@@ -28,6 +28,7 @@ void ravey_particles_set_scale           ( int iID, float fStartMin, float fStar
 void ravey_particles_set_alpha           ( int iID, float fStartMin, float fStartMax, float fEndMin, float fEndMax );
 void ravey_particles_set_life            ( int iID, int iSpawnRate, float iLifeMin, float iLifeMax, int iMaxParticles, int iOnDeathAction, int iMaxPerFrame );
 void ravey_particles_set_wind_vector     ( float fwindX, float fwindZ );
+void ravey_particles_set_batched         ( int iMode );
 void update_env_particles				 ( void );
 void reset_env_particles				 ( void );
 void delete_env_particles				 ( void );
@@ -23,6 +23,14 @@ void terrain_editcontrol ( void );
 void terrain_recordbuffer ( void );
 void terrain_undo ( void );
 void terrain_redo ( void );
+void terrain_setundohistory ( int iSteps, int iMegabytes );
+void terrain_clearundohistory ( void );
+bool terrain_undohistoryactive ( void );
+bool terrain_canundo ( void );
+bool terrain_canredo ( void );
+void terrain_endundostep ( void );
+void terrain_recordundotiles ( void );
+void terrain_applyundostep ( int iLayers );
 void terrain_editcontrol_auxiliary ( void );
 void terrain_paintterrain ( void );
 void terrain_cursor ( void );
@@ -62,6 +70,9 @@ void terrain_quickupdateheightmapfromheightdata ( void );
 void terrain_generatetextureselect ( void );
 void terrain_generatesupertexture ( bool bForceRecalcOfPalette );
 void terrain_generateshadows ( void );
+void terrain_markshadows ( int iX1, int iZ1, int iX2, int iZ2 );
+void terrain_updateshadows ( void );
+void terrain_followshadowsun ( void );
 void generate_terrain ( int seed, int scale, int mchunk_size );
 void DiamondSquare(unsigned x1, unsigned y1, unsigned x2, unsigned y2, float range, unsigned level) ;
 void terrain_start_play ( void );
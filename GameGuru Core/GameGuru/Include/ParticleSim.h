@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+
+class cThreadPool;
+
+// particles simulated or built into quads by one job
+#define PARTICLESIM_JOB_GRAIN 4096
+
+// ParticlePool flags
+#define PARTICLESIM_ANIMATED 1
+#define PARTICLESIM_LOOPING 2
+#define PARTICLESIM_SECONDIMAGE 4       // drawn with the emitter's second image
+
+// a new particle, values have the same meaning as their travey_particle fields
+struct ParticleSpawn
+{
+    float x, y, z;
+    float speedX, speedY, speedZ;
+    float life;
+    float scaleStart, scaleEnd;
+    float alphaStart, alphaEnd;
+    float gravityStart, gravityEnd;
+    float rotZ, rotateSpeedZ;
+    float startFrame, endFrame;
+    float animationSpeed;
+    float frameDivide;                  // atlas cells along each side, one for the whole image
+    int flags;
+};
+
+// one emitter's particles as parallel arrays. Live particles are packed at
+// the front in spawn order and the arrays are padded to a multiple of four
+// so the update can work four particles at a time with no remainder
+struct ParticlePool
+{
+    ParticlePool();
+
+    int count;
+    bool noWind;
+    bool recordDeaths;                  // keep where particles died, for emitters that split on death
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> speedX;
+    std::vector<float> speedY;
+    std::vector<float> speedZ;
+    std::vector<float> age;
+    std::vector<float> life;
+    std::vector<float> scaleStart;
+    std::vector<float> scaleEnd;
+    std::vector<float> alphaStart;
+    std::vector<float> alphaEnd;
+    std::vector<float> gravityStart;
+    std::vector<float> gravityEnd;
+    std::vector<float> rotZ;
+    std::vector<float> rotateSpeedZ;
+    std::vector<float> frame;
+    std::vector<float> startFrame;
+    std::vector<float> endFrame;
+    std::vector<float> animationSpeed;
+    std::vector<float> frameDivide;
+    std::vector<float> scale;           // world size of the quad, from the last update
+    std::vector<float> alpha;           // zero to one hundred, from the last update
+    std::vector<int> flags;
+    std::vector<int> alive;             // one or zero, from the last update
+
+    // positions of the particles that died in the last update, in order
+    std::vector<float> deathX;
+    std::vector<float> deathY;
+    std::vector<float> deathZ;
+    int deaths;
+};
+
+// where buildQuads writes each vertex field, counted in floats from the start
+// of the vertex. Alpha is written as zero to one
+struct ParticleVertexLayout
+{
+    int stride;
+    int position;
+    int alpha;
+    int uv;
+};
+
+// structure of arrays particle simulation with one pool per emitter. Pools
+// are updated together in fixed size jobs on the thread pool with SSE, dead
+// particles are then packed out of each pool without branching, and each
+// pool can be written out as camera facing quads for a single draw
+class ParticleSim
+{
+public:
+    ParticleSim();
+    ~ParticleSim();
+
+    void clear();
+
+    // pools are made on first use, one per emitter number
+    ParticlePool& getPool(int emitter);
+    int getPoolCount() const { return (int)pools.size(); }
+    int getCount(int emitter) const;
+    int getTotalCount() const;
+    void resetPool(int emitter);
+    void spawn(int emitter, const ParticleSpawn& particle);
+
+    // advances every pool by dt milliseconds with the given wind, particles
+    // past their life are removed. Gravity is scaled so that at sixty updates
+    // a second it falls as far as the per object particles did
+    void update(float dt, float windX, float windZ, cThreadPool* pThreadPool);
+
+    // six vertices for each particle whose flags masked by flagMask equal
+    // flagValue, turned to face the camera and rolled by their rotation, with
+    // positions relative to origin. Returns the number of quads written
+    int buildQuads(int emitter, const ParticleVertexLayout& layout, float* vertices, int maxQuads,
+                   const float* camera, const float* origin, int flagMask, int flagValue, cThreadPool* pThreadPool);
+
+private:
+    struct Job
+    {
+        int pool;
+        int begin;
+        int end;
+        int firstDead;
+    };
+
+    void grow(ParticlePool& pool, int count);
+    void simulate(Job& job, float dt, float windX, float windZ);
+    void compact(ParticlePool& pool, int firstDead);
+
+    std::vector<ParticlePool> pools;
+    std::vector<Job> jobs;
+    std::vector<int> poolFirstDead;
+    std::vector<int> quadOffsets;
+};
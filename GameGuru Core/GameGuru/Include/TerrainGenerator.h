@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+class cThreadPool;
+
+// rows of heights made or eroded by one job
+#define TERRAINGENERATOR_JOB_ROWS 16
+
+// layers of noise at most
+#define TERRAINGENERATOR_MAX_OCTAVES 16
+
+struct TerrainGeneratorSettings
+{
+    TerrainGeneratorSettings();
+
+    unsigned int seed;
+    int octaves;            // layers of noise, each twice the frequency and half the height of the one before
+    float frequency;        // hills across the map in the first layer
+    float height;           // height of the first layer, heights come out about this far either side of zero
+    float ridged;           // zero for rolling hills, one for sharp ridges, or a blend of the two
+    int erosionPasses;      // thermal erosion passes over the grid being made
+    float talus;            // rise over run past which ground slides downhill
+    float erosionRate;      // part of the ground past the talus moved each pass, no more than 0.25
+    float mapSize;          // width of the map in world units, for the talus
+};
+
+// procedural heightfield of fBm and ridged noise, then thermal erosion.
+// The noise at a point depends only on the seed and where the point is on
+// the map, so a seed gives the same heights at any tiling or thread count,
+// and a small preview shows the same land as the full size map. Erosion works
+// on the grid being made, so a preview only comes close to the eroded map
+class TerrainGenerator
+{
+public:
+    // size by size heights written to the caller's buffer, rows of size one after another
+    void generate(const TerrainGeneratorSettings& settings, float* heights, int size, cThreadPool* pThreadPool);
+
+private:
+    void noiseRows(const TerrainGeneratorSettings& settings, float* heights, int size, int z1, int z2);
+    void erodeRows(const float* from, float* to, int size, int z1, int z2, float talus, float rate);
+
+    std::vector<float> work[2];
+    int workStride;
+};
+
+// counter based random number, the same for the same arguments in any order on any thread
+unsigned int TerrainGeneratorHash(unsigned int seed, unsigned int stream, int x, int z);
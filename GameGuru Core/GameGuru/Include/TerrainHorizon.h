@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+class cThreadPool;
+
+// cells along each side of an occlusion job, and lanes in each step of the sun sweep
+#define TERRAINHORIZON_TILE 64
+
+// directions the occlusion horizon is found in, along the axes and the diagonals
+#define TERRAINHORIZON_DIRECTIONS 8
+
+// bakes a sun shadow and ambient occlusion mask from a heightfield.
+// Shadow is swept across the map away from the sun a row at a time, each cell
+// carrying the highest line of shadow that reaches it, so a cell costs the same
+// however low the sun is. Occlusion is the horizon angle in eight directions out
+// to a fixed reach. Changed heights bake again only the cells they can reach,
+// with the same result as baking everything
+class TerrainHorizon
+{
+public:
+    TerrainHorizon();
+
+    // heights are spacing apart and occlusion looks reach cells out, everything
+    // is baked on the next bake
+    void setSize(int width, int height, float spacing, int reach);
+
+    // direction towards the sun, a new direction bakes everything again
+    void setSun(float x, float y, float z);
+    bool isSun(float x, float y, float z) const { return x == sunX && y == sunY && z == sunZ; }
+
+    // rows of width heights one after another, clamped to the map. The
+    // rectangle is baked on the next bake
+    void setHeights(int x, int z, int width, int height, const float* data);
+
+    // bakes what changed since the last bake and gives the inclusive rectangle
+    // of cells written, false when there was nothing to do
+    bool isDirty() const { return bakeAll || dirtyX1 <= dirtyX2; }
+    bool bake(cThreadPool* pThreadPool, int& x1, int& z1, int& x2, int& z2);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // a byte a cell, rows of width. Light is 255 in full sun and occlusion is
+    // 255 where the sky is open all round
+    const unsigned char* getLight() const { return light.empty() ? NULL : &light[0]; }
+    const unsigned char* getOcclusion() const { return occlusion.empty() ? NULL : &occlusion[0]; }
+
+private:
+    void setupSweep();
+    float* lineRow(int i) { return i < 0 ? &open[2] : &lines[(size_t)i * lineStride + 2]; }
+    const float* heightRow(int row) const;
+    void sweepRect(int i1, int i2, int lane1, int lane2, int& x1, int& z1, int& x2, int& z2) const;
+
+    void sweepAll(cThreadPool* pThreadPool);
+    void sweepRegion(int x1, int z1, int x2, int z2, int& outX1, int& outZ1, int& outX2, int& outZ2);
+    void sweepRow(int i, int lane1, int lane2);
+    void occlude(cThreadPool* pThreadPool, int x1, int z1, int x2, int z2);
+    void occludeRow(int z, int x1, int x2);
+
+    int width;
+    int height;
+    float spacing;
+    int reach;
+
+    // heights with a border of reach and more on every side, so the occlusion
+    // can read past the edge, and again with x and z swapped for sweeps along x
+    std::vector<float> padded;
+    std::vector<float> transposed;
+    int border;
+    int paddedStride;
+
+    // sun sweep, rows are taken nearest the sun first and each reads the shadow
+    // line of the row before at lane plus shift, blended towards the next lane
+    float sunX, sunY, sunZ;
+    int sunMode;
+    bool alongX;
+    bool forward;
+    int rows;
+    int lanes;
+    int shift;
+    float blend;
+    float drop;
+
+    // highest shadow line per cell in sweep order, two lanes of no shadow either side
+    std::vector<float> lines;
+    std::vector<float> open;
+    std::vector<float> before;
+    int lineStride;
+
+    std::vector<float> reachScale;   // one over the distance of each step, per direction
+    std::vector<unsigned char> light;
+    std::vector<unsigned char> occlusion;
+
+    bool bakeAll;
+    int dirtyX1, dirtyZ1, dirtyX2, dirtyZ2;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <stddef.h>
+
+// cells along each side of a tile
+#define TERRAINUNDO_TILE 64
+
+// layers, a bit each in the masks undo and redo return
+#define TERRAINUNDO_HEIGHT 0
+#define TERRAINUNDO_PAINT 1
+#define TERRAINUNDO_LAYERS 2
+
+// copy a rectangle of cells out of or into a layer, rows of width cells one
+// after another, each cell the layer's cell size in bytes
+typedef void(*TerrainUndoRead)(int x, int z, int width, int height, unsigned char* data);
+typedef void(*TerrainUndoWrite)(int x, int z, int width, int height, const unsigned char* data);
+
+// undo history for terrain edits. A step holds only the tiles a stroke
+// touched, each kept as the compressed difference between the tile before
+// and after the stroke, so the same data takes the terrain either way.
+// Steps past the step or memory limit are dropped oldest first
+class TerrainUndo
+{
+public:
+    TerrainUndo();
+
+    void setLayer(int layer, int width, int height, int cellSize, TerrainUndoRead read, TerrainUndoWrite write);
+    void setLimits(int maxSteps, size_t maxBytes);
+    void clear();
+
+    // a stroke is begun, each area about to change is touched before it is
+    // changed, and the step is ended once the stroke is over. Cells are
+    // inclusive and clamped to the layer
+    void beginStep();
+    void touch(int layer, int x1, int z1, int x2, int z2);
+    void endStep();
+    bool isRecording() const { return recording; }
+
+    // both return a mask of the layers written to, zero when there was nothing to do
+    bool canUndo() const { return applied > 0; }
+    bool canRedo() const { return applied < (int)steps.size(); }
+    int undo();
+    int redo();
+
+    int getStepCount() const { return (int)steps.size(); }
+    size_t getMemoryUsed() const { return bytesUsed; }
+
+private:
+    struct Layer
+    {
+        int width;
+        int height;
+        int cellSize;
+        int tilesX;
+        int tilesZ;
+        TerrainUndoRead read;
+        TerrainUndoWrite write;
+    };
+
+    struct Tile
+    {
+        int layer;
+        int tileX;
+        int tileZ;
+        std::vector<unsigned char> data;    // raw tile while the step is open, compressed difference after
+    };
+
+    struct Step
+    {
+        std::vector<Tile> tiles;
+        size_t bytes;
+    };
+
+    void tileRect(const Tile& tile, int& x, int& z, int& width, int& height) const;
+    int apply(const Step& step);
+    void trim();
+
+    Layer layers[TERRAINUNDO_LAYERS];
+    std::vector<unsigned char> touched[TERRAINUNDO_LAYERS];
+    Step pending;
+    bool recording;
+
+    std::deque<Step> steps;
+    int applied;
+    int maxSteps;
+    size_t maxBytes;
+    size_t bytesUsed;
+
+    std::vector<unsigned char> current;
+    std::vector<unsigned char> delta;
+    std::vector<unsigned char> packed;
+};
+
+// difference coding used by the history, exposed so it can be checked on its own.
+// Cells are split into byte planes before packing so the bytes that change
+// together sit together, then runs of zero and repeats are packed
+void TerrainUndoPack(const unsigned char* data, int size, int cellSize, std::vector<unsigned char>& out);
+bool TerrainUndoUnpack(const unsigned char* data, int size, int cellSize, unsigned char* out, int outSize);
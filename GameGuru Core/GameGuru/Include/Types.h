@@ -117,6 +117,10 @@
 
 #define RAVEY_PARTICLES_MAX 2000
 
+// batched emitters draw as one object each, numbered on from the particle objects,
+// and the vertex space of one grows from this many quads
+#define RAVEY_PARTICLES_BATCH_MIN_QUADS 64
+
 #define RAVEY_PARTICLES_MAX_SPAWNED_AT_ONCE_BY_AN_EMITTER 50
 #define RAVEY_PARTICLES_IMAGETYPE_FLARE      0
 #define RAVEY_PARTICLES_IMAGETYPE_LIGHTSMOKE 1
@@ -3312,6 +3316,13 @@ struct globalstype
 	float realshadowdistance;
 	float realshadowdistancehigh;
 	int editorusemediumshadows;
+	int terrainundosteps;
+	int terrainundomegabytes;
+	int batchedparticles;
+	int mappedobjectloading;
+	int animationposecache;
+	int animationposequantum;
+	int animationclips;
 
 	// Constructor
 	globalstype ( )
@@ -3319,6 +3330,13 @@ struct globalstype
 		 realshadowdistance = 5000.0f;
 		 realshadowdistancehigh = 5000.0f;
 		 editorusemediumshadows = 1;
+		 terrainundosteps = 0;
+		 terrainundomegabytes = 64;
+		 batchedparticles = 0;
+		 mappedobjectloading = 0;
+		 animationposecache = 0;
+		 animationposequantum = 25;
+		 animationclips = 0;
 
 		 realshadowsize[0] = 0;
 		 realshadowsize[1] = 0;
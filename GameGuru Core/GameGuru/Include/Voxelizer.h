@@ -1,21 +1,56 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 #include "cVectorC.h"
 
+// conservative voxelizer for object meshes. Every voxel a triangle touches is
+// set, found with a separating axis triangle/box test, and the grid is stored
+// sparsely as 8x8x8 bit bricks so only occupied space costs memory. Meshes are
+// voxelized in parallel on the thread pool into per-thread bricks which are
+// merged once all meshes are done
 class Voxelizer
 {
 public:
     Voxelizer(int resolution);
     ~Voxelizer();
 
+    // world space corner of voxel 0,0,0 and the edge length of one voxel
+    void setBounds(const GGVECTOR3& minimum, float voxelSize);
+    void clear();
     void voxelize(const std::vector<int>& objectIDs);
-    const std::vector<int>& getVoxelData() const { return voxelData; }
+
+    int getResolution() const { return resolution; }
+    bool isOccupied(int x, int y, int z) const;
+    int getBrickCount() const { return (int)voxels.bricks.size(); }
+    size_t getMemoryUsage() const;
 
 private:
-    void rasterizeTriangle(const cVector3& v0, const cVector3& v1, const cVector3& v2);
-    bool isPointInTriangle(const cVector3& point, const cVector3& v0, const cVector3& v1, const cVector3& v2);
+    struct Brick
+    {
+        unsigned long long bits[8];     // one word per z slice, bit is x + y * 8
+    };
+
+    struct BrickSet
+    {
+        std::unordered_map<unsigned int, int> index;
+        std::vector<Brick> bricks;
+
+        void set(int x, int y, int z);
+        bool get(int x, int y, int z) const;
+        void merge(const BrickSet& other);
+        void clear();
+    };
+
+    void rasterizeTriangle(BrickSet& target, const GGVECTOR3& v0, const GGVECTOR3& v1, const GGVECTOR3& v2);
+    static bool triangleBoxOverlap(const GGVECTOR3& boxCentre, const GGVECTOR3& v0, const GGVECTOR3& v1, const GGVECTOR3& v2);
 
     int resolution;
-    std::vector<int> voxelData;
+    GGVECTOR3 origin;
+    float voxelSize;
+
+    BrickSet voxels;
+    std::vector<BrickSet> threadVoxels;     // slot 0 is the calling thread, then one per pool worker
 };
+
+extern Voxelizer* g_pVoxelizer;
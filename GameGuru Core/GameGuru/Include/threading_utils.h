@@ -2,17 +2,13 @@
 
 #include "gameguru.h"
 
-struct entity_thread_data
-{
-	int e;
-};
+// entity_thread_data and entity_init_thread_data are declared in G-Entity.h
 
-struct entity_init_thread_data
-{
-	int e;
-};
+class cThreadPool;
+extern cThreadPool* g_pThreadPool;
 
 void entity_loop_thread(entity_thread_data* pData);
+void entity_loop_commands(entity_thread_data* pData);
 void entity_init_thread_part1(entity_init_thread_data* pData);
 void entity_init_thread_part2(entity_init_thread_data* pData);
 void entity_init_thread(entity_init_thread_data* pData);
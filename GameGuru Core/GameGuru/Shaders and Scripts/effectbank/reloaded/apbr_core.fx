@@ -415,7 +415,7 @@ struct Attributes
   Texture2D HighlighterSampler : register( t3 );
   Texture2D NormalMap : register( t4 );
   Texture2D MetalnessMap : register( t5 );
-  Texture2D Unused1Map : register( t7 );
+  Texture2D BakedShadowMap : register( t7 ); // red sun shadow, green sky occlusion, baked from the terrain heights
  #else
   Texture2D AlbedoMap : register( t0 );
   #ifdef AOISAGED
@@ -1680,6 +1680,11 @@ float4 PSMainCore(in VSOutput input, uniform int fullshadowsoreditor)
 #endif
 #endif
 
+#ifdef PBRTERRAIN
+   float4 BakedShadow = BakedShadowMap.Sample(SampleWrap,attributes.uv/500.0f);
+   fShadow = max ( fShadow, BakedShadow.r );
+#endif
+
    float visibility =  max ( 1.0f - fShadow, 0 );
 
    DirectionalLight gDirLight;
@@ -1707,7 +1712,7 @@ float4 PSMainCore(in VSOutput input, uniform int fullshadowsoreditor)
      float rawaovalue = 1.0f;
     #else
      #ifdef PBRTERRAIN
-      float rawaovalue = 1.0f;
+      float rawaovalue = 1.0f - BakedShadow.g;
      #else 
 	  #ifdef AOISAGED
 	   float rawaovalue = AGEDMap.Sample(SampleWrap,attributes.uv).x;
@@ -137,7 +137,7 @@ Texture2D HighlighterSampler : register( t3 );
 Texture2D NormalMapSampler : register( t4 );
 Texture2D Reserved1Map : register( t5 );
 Texture2D Reserved2Map : register( t6 );
-Texture2D Reserved3Map : register( t7 );
+Texture2D BakedShadowMap : register( t7 ); // red sun shadow, green sky occlusion, baked from the terrain heights
 
 SamplerState SampleWrap
 {
@@ -795,6 +795,9 @@ float4 mainlightPS_highest(vertexOutput IN) : COLOR
  	  // Shadows
  	  int iCurrentCascadeIndex = 0;
 	  float fShadow = GetShadow ( IN.vDepth, IN.WPos, IN.WorldNormal, normalize(LightSource.xyz), iCurrentCascadeIndex );
+      float4 BakedShadow = BakedShadowMap.Sample(SampleWrap,IN.TexCoord/500.0f);
+      fShadow = max ( fShadow, BakedShadow.r );
+      ambContrib.xyz = ambContrib.xyz * (1.0f-BakedShadow.g);
          
       // paint
       float fInvShadow = 1.0-fShadow;
@@ -990,6 +993,8 @@ float4 mainlightPS_medium(vertexOutput_low IN) : COLOR
  	  // Shadows
  	  int iCurrentCascadeIndex = 0;
 	  float fShadow = GetShadow ( IN.vDepth, IN.WPos, IN.WorldNormal, normalize(LightSource.xyz), iCurrentCascadeIndex );
+      float4 BakedShadow = BakedShadowMap.Sample(SampleWrap,IN.TexCoord/500.0f);
+      fShadow = max ( fShadow, BakedShadow.r );
       fShadow = fShadow * 0.675f * ShadowStrength;
 
 
@@ -1017,6 +1022,7 @@ float4 mainlightPS_medium(vertexOutput_low IN) : COLOR
       float3 bouncelightcolor = lerp(FloorColor,SkyColor,fSkyFloorRatio).xyz * diffusemap.xyz * 0.8;
       bouncelightcolor = bouncelightcolor + (diffusemap.xyz * 0.2);
       float4 ambContrib = float4(bouncelightcolor,1) * (AmbiColor) * AmbiColorOverride * 2;
+      ambContrib.xyz = ambContrib.xyz * (1.0f-BakedShadow.g);
          
       // paint lighting in
       dynamicContrib.xyz = dynamicContrib.xyz + (diffusemap.xyz*float3(flashlight,flashlight,flashlight));
@@ -1148,6 +1154,8 @@ float4 mainlightPS_lowest(vertexOutput_low IN) : COLOR
 
       // cheap terrain shadow
       float fShadow = GetShadowCascade ( 7, IN.WPos, IN.WorldNormal, normalize(LightSource.xyz) );
+      float4 BakedShadow = BakedShadowMap.Sample(SampleWrap,IN.TexCoord/500.0f);
+      fShadow = max ( fShadow, BakedShadow.r );
       fShadow = fShadow * 0.675f * ShadowStrength;
    
       // CHEAPEST flash light system (flash light control carried in SpotFlashColor.w )
@@ -1159,6 +1167,7 @@ float4 mainlightPS_lowest(vertexOutput_low IN) : COLOR
       float3 bouncelightcolor = lerp(FloorColor,SkyColor,fSkyFloorRatio).xyz * diffusemap.xyz * 0.8;
       bouncelightcolor = bouncelightcolor + (diffusemap.xyz * 0.2);
       float4 ambContrib = float4(bouncelightcolor,1) * AmbiColor * AmbiColorOverride * 2;
+      ambContrib.xyz = ambContrib.xyz * (1.0f-BakedShadow.g);
          
       // paint lighting in
       float4 diffuseContrib = SurfColor * diffusemap * lighting.y * GlobalSurfaceIntensity;
@@ -2045,8 +2045,8 @@ void FPSC_LoadSETUPINI ( bool bUseMySystemFolder )
 					t.tryfield_s = "memorydetector" ; if (  t.field_s == t.tryfield_s  )  g.globals.memorydetector = t.value1;
 
 					// DOCDOC: occlusionmode = Enables the use of the occlusion system to skip rendering of hidden entities
-					//t.tryfield_s = "occlusionmode"; if (t.field_s == t.tryfield_s)  g.globals.occlusionmode = t.value1;
-					g.globals.occlusionmode = 0; //LB: 32 bit work saw that this relied on CPU rendering using 32 bit ASM - no longer supported for now
+					//LB: 32 bit work saw that this relied on CPU rendering using 32 bit ASM, the occlusion rasterizer has no such dependency
+					t.tryfield_s = "occlusionmode"; if (t.field_s == t.tryfield_s)  g.globals.occlusionmode = t.value1;
 
 					// DOCDOC: occlusionsize = Sets the size of the margins around occluders to occlude less of the scene
 					t.tryfield_s = "occlusionsize" ; if (  t.field_s == t.tryfield_s  )  g.globals.occlusionsize = t.value1;
@@ -2069,6 +2069,30 @@ void FPSC_LoadSETUPINI ( bool bUseMySystemFolder )
 					t.tryfield_s = "terrainshadows" ; if (  t.field_s == t.tryfield_s  ) g.globals.terrainshadows = t.value1;
 					#endif
 
+					// DOCDOC: bakedterrainshadows = Bakes sun shadow and sky occlusion from the terrain heights into a mask image, baked again where the terrain is sculpted
+					t.tryfield_s = "bakedterrainshadows" ; if (  t.field_s == t.tryfield_s  ) t.terrain.generateterrainshadows = t.value1;
+
+					// DOCDOC: animationclips = Animates characters from baked, compressed clips sampled directly instead of searching the original keyframes
+					t.tryfield_s = "animationclips" ; if (  t.field_s == t.tryfield_s  ) g.globals.animationclips = t.value1;
+
+					// DOCDOC: animationposecache = Instances playing the same animation at nearly the same frame share one evaluated pose (uses baked animation clips)
+					t.tryfield_s = "animationposecache" ; if (  t.field_s == t.tryfield_s  ) g.globals.animationposecache = t.value1;
+
+					// DOCDOC: animationposequantum = Hundredths of a frame within which instances share one cached animation pose. Default is 25, zero shares only identical frames
+					t.tryfield_s = "animationposequantum" ; if (  t.field_s == t.tryfield_s  ) g.globals.animationposequantum = t.value1;
+
+					// DOCDOC: mappedobjectloading = Loads DBO model files memory mapped, using their vertex and index data in place where it is aligned. Standalone builds align the DBO files they copy
+					t.tryfield_s = "mappedobjectloading" ; if (  t.field_s == t.tryfield_s  ) g.globals.mappedobjectloading = t.value1;
+
+					// DOCDOC: batchedparticles = Set to 1 to draw the particles of each emitter in one batch object rather than one object per particle
+					t.tryfield_s = "batchedparticles" ; if (  t.field_s == t.tryfield_s  ) g.globals.batchedparticles = t.value1;
+
+					// DOCDOC: terrainundomegabytes = Memory in megabytes kept for terrain sculpt undo steps
+					t.tryfield_s = "terrainundomegabytes" ; if (  t.field_s == t.tryfield_s  ) g.globals.terrainundomegabytes = t.value1;
+
+					// DOCDOC: terrainundosteps = Number of terrain sculpt steps that can be undone, 0 keeps the single undo buffer
+					t.tryfield_s = "terrainundosteps" ; if (  t.field_s == t.tryfield_s  ) g.globals.terrainundosteps = t.value1;
+
 					// DOCDOC: realshadowresolution = Size of the texture plate dimension to render the shadow onto. Default is 2048.
 					t.tryfield_s = "realshadowresolution" ; if (  t.field_s == t.tryfield_s  ) g.globals.realshadowresolution = t.value1;
           
@@ -3825,6 +3849,18 @@ void FPSC_Setup ( void )
 	else
 		SetDefaultCPUAnimState ( 0 );
 
+	// animation from baked clips
+	SetAnimationClipMode ( g.globals.animationclips );
+
+	// shared poses for instances playing the same clip
+	SetAnimationPoseCache ( g.globals.animationposecache, g.globals.animationposequantum / 100.0f );
+
+	// memory mapped model loading
+	SetObjectLoadMapped ( g.globals.mappedobjectloading );
+
+	// terrain sculpt undo history
+	terrain_setundohistory ( g.globals.terrainundosteps, g.globals.terrainundomegabytes );
+
 	// set adapter ordinal for next time display mode is set (below)
 	if ( g.gadapterordinal>0 ) 
 	{
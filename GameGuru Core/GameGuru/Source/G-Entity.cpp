@@ -118,13 +118,7 @@ void entity_init ( void )
 {
 	//  pre-create element data (load from eleprof)
 	timestampactivity(0,"Configure entity instances for use");
-	std::vector< std::future<void> > results;
-	for ( t.e = 1 ; t.e<=  g.entityelementlist; t.e++ )
-	{
-		results.emplace_back(g_pThreadPool->enqueue(entity_init_thread, t.e));
-	}
-	for (auto && result : results)
-		result.get();
+	g_pThreadPool->parallel_for(1, g.entityelementlist + 1, 1, [](int e) { entity_init_thread(e); });
 
 	//  activate all entities and perform any pre-test game setup
 	timestampactivity(0,"Configure entity attachments and AI obstacles");
@@ -577,6 +571,9 @@ void entity_reset_defaults(void)
 }
 void entity_delete ( void )
 {
+	//  all entity objects are about to go
+	if ( g_pLODManager ) g_pLODManager->clear();
+
 	//  delete all entities
 	for ( t.e = 1 ; t.e<=  g.entityelementlist; t.e++ )
 	{
@@ -655,19 +652,25 @@ void entity_resumeanimations ( void )
 
 void entity_loop_thread(entity_thread_data* pData)
 {
+	// runs on worker threads, so only entity e's own element and pData may be
+	// written here and nothing in the shared t. scratch is touched. Anything
+	// that reaches engine, physics, sound, lua or player state is recorded in
+	// pData->commands and carried out by entity_loop_commands afterwards
 	int e = pData->e;
+	pData->commands = 0;
 
 	// only handle DYNAMIC entities
-	t.entid = t.entityelement[e].bankindex;
-	if (t.entid > 0)
+	int entid = t.entityelement[e].bankindex;
+	if (entid > 0)
 	{
 		//  Entity object
-		t.tobj = t.entityelement[e].obj;
+		int tobj = t.entityelement[e].obj;
+		pData->obj = tobj;
 
 		//  Entity Prompt Local
 		if (t.entityelement[e].overprompttimer > 0)
 		{
-			if (ObjectExist(t.tobj) == 1)
+			if (ObjectExist(tobj) == 1)
 			{
 #ifdef VRTECH
 				if (Timer() > (int)t.entityelement[e].overprompttimer)
@@ -675,22 +678,14 @@ void entity_loop_thread(entity_thread_data* pData)
 					if (t.entityelement[e].overpromptuse3D == false)
 						t.entityelement[e].overprompttimer = 0;
 					else
-						lua_hideperentity3d(e);
+						pData->commands |= ENTITYLOOP_CMD_PROMPT3DHIDE;
 				}
 				else
 				{
 					if (t.entityelement[e].overpromptuse3D == false)
-					{
-						if (GetInScreen(t.tobj) == 1)
-						{
-							t.t_s = t.entityelement[e].overprompt_s; t.twidth = getbitmapfontwidth(t.t_s.Get(), 1) / 2;
-							pastebitmapfont(t.t_s.Get(), GetScreenX(t.tobj) - t.twidth, GetScreenY(t.tobj), 1, 255);
-						}
-					}
+						pData->commands |= ENTITYLOOP_CMD_PROMPT2D;
 					else
-					{
-						lua_updateperentity3d(e, t.entityelement[e].overprompt_s.Get(), t.entityelement[e].overprompt3dX, t.entityelement[e].overprompt3dY, t.entityelement[e].overprompt3dZ, t.entityelement[e].overprompt3dAY, t.entityelement[e].overprompt3dFaceCamera);
-					}
+						pData->commands |= ENTITYLOOP_CMD_PROMPT3DUPDATE;
 				}
 #else
 				if (Timer() > (int)t.entityelement[e].overprompttimer)
@@ -699,22 +694,19 @@ void entity_loop_thread(entity_thread_data* pData)
 				}
 				else
 				{
-					if (GetInScreen(t.tobj) == 1)
-					{
-						t.t_s = t.entityelement[e].overprompt_s; t.twidth = getbitmapfontwidth(t.t_s.Get(), 1) / 2;
-						pastebitmapfont(t.t_s.Get(), GetScreenX(t.tobj) - t.twidth, GetScreenY(t.tobj), 1, 255);
-					}
+					pData->commands |= ENTITYLOOP_CMD_PROMPT2D;
 				}
 #endif
 			}
 		}
 
 		// if ragdoll and has force, apply it repeatedly
-		if (t.tobj > 0)
+		if (tobj > 0)
 		{
 			if (t.entityelement[e].ragdollified == 1 && t.entityelement[e].ragdollifiedforcevalue_f > 1.0)
 			{
-				BPhys_RagDollApplyForce(t.tobj, t.entityelement[e].ragdollifiedforcelimb, 0, 0, 0, t.entityelement[e].ragdollifiedforcex_f, t.entityelement[e].ragdollifiedforcey_f, t.entityelement[e].ragdollifiedforcez_f, t.entityelement[e].ragdollifiedforcevalue_f);
+				pData->commands |= ENTITYLOOP_CMD_RAGDOLLFORCE;
+				pData->ragdollforce = t.entityelement[e].ragdollifiedforcevalue_f;
 				t.entityelement[e].ragdollifiedforcevalue_f = t.entityelement[e].ragdollifiedforcevalue_f*0.75;
 				if (t.entityelement[e].ragdollifiedforcevalue_f <= 1.0)
 				{
@@ -723,13 +715,24 @@ void entity_loop_thread(entity_thread_data* pData)
 			}
 		}
 
-		//  obtain distance from camera/player
-		entity_controlrecalcdist();
-		if (abs(t.entityelement[e].plrdist - t.dist_f) > 10)
+		//  obtain distance from camera/player (same as entity_controlrecalcdist)
+		float dist = 9999999;
+		if (tobj > 0 && (t.entityelement[e].active != 0 || t.entityelement[e].eleprof.phyalways != 0))
+		{
+			if (ObjectExist(tobj) == 1)
+			{
+				float distx = CameraPositionX(0) - ObjectPositionX(tobj);
+				float disty = CameraPositionY(0) - ObjectPositionY(tobj);
+				float distz = CameraPositionZ(0) - ObjectPositionZ(tobj);
+				dist = Sqrt(abs(distx*distx) + abs(disty*disty) + abs(distz*distz));
+			}
+		}
+		pData->dist = dist;
+		if (abs(t.entityelement[e].plrdist - dist) > 10)
 		{
 			t.entityelement[e].lua.flagschanged = 1;
 		}
-		t.entityelement[e].plrdist = t.dist_f;
+		t.entityelement[e].plrdist = dist;
 
 		// control immunity for entities
 		if (t.entityelement[e].briefimmunity > 0)
@@ -738,9 +741,9 @@ void entity_loop_thread(entity_thread_data* pData)
 		}
 
 		// in all active states, must repell player to avoid penetration
-		if (t.tobj > 0)
+		if (tobj > 0)
 		{
-			if (t.entityprofile[t.entid].ischaracter == 1 || t.entityprofile[t.entid].collisionmode == 21)
+			if (t.entityprofile[entid].ischaracter == 1 || t.entityprofile[entid].collisionmode == 21)
 			{
 				if (t.entityelement[e].health > 0 && t.entityelement[e].usingphysicsnow == 1)
 				{
@@ -748,15 +751,14 @@ void entity_loop_thread(entity_thread_data* pData)
 					if (t.playercontrol.thirdperson.enabled == 1 && t.playercontrol.thirdperson.charactere == e) bThirdPersonPlayer = true;
 					if (bThirdPersonPlayer == false)
 					{
-						t.tplrproxx_f = ObjectPositionX(t.aisystem.objectstartindex) - ObjectPositionX(t.tobj);
-						t.tplrproyy_f = ObjectPositionY(t.aisystem.objectstartindex) - ObjectPositionY(t.tobj);
-						t.tplrproxz_f = ObjectPositionZ(t.aisystem.objectstartindex) - ObjectPositionZ(t.tobj);
-						t.tplrproxd_f = Sqrt(abs(t.tplrproxx_f*t.tplrproxx_f) + abs(t.tplrproyy_f*t.tplrproyy_f) + abs(t.tplrproxz_f*t.tplrproxz_f));
-						t.tplrproxa_f = atan2deg(t.tplrproxx_f, t.tplrproxz_f);
-						if (t.tplrproxd_f < t.entityprofile[t.entid].fatness)
+						float proxx = ObjectPositionX(t.aisystem.objectstartindex) - ObjectPositionX(tobj);
+						float proxy = ObjectPositionY(t.aisystem.objectstartindex) - ObjectPositionY(tobj);
+						float proxz = ObjectPositionZ(t.aisystem.objectstartindex) - ObjectPositionZ(tobj);
+						float proxd = Sqrt(abs(proxx*proxx) + abs(proxy*proxy) + abs(proxz*proxz));
+						if (proxd < t.entityprofile[entid].fatness)
 						{
-							t.playercontrol.pushforce_f = 1.0;
-							t.playercontrol.pushangle_f = t.tplrproxa_f;
+							pData->commands |= ENTITYLOOP_CMD_PUSHPLAYER;
+							pData->pushangle = atan2deg(proxx, proxz);
 						}
 					}
 				}
@@ -767,234 +769,294 @@ void entity_loop_thread(entity_thread_data* pData)
 		if (t.entityelement[e].limbhurt > 0 && t.entityelement[e].health > 0)
 		{
 			//  known limbs
-			t.headlimbofcharacter = t.entityprofile[t.entityelement[e].bankindex].headlimb;
-			t.spine2limbofcharacter = t.entityprofile[t.entityelement[e].bankindex].spine2;
+			int headlimb = t.entityprofile[t.entityelement[e].bankindex].headlimb;
+			int spine2limb = t.entityprofile[t.entityelement[e].bankindex].spine2;
 			//  determine which segment the limb belongs
-			t.tsegmenttoflinch = 0;
-			if (t.entityelement[e].limbhurt == t.headlimbofcharacter)  t.tsegmenttoflinch = 1;
+			int segment = 0;
+			if (t.entityelement[e].limbhurt == headlimb) segment = 1;
 			//  degrade flinch value until finished
-			t.tsmoothspeed_f = 3.0 / g.timeelapsed_f;
-			t.entityelement[e].limbhurta_f = CurveValue(0, t.entityelement[e].limbhurta_f, t.tsmoothspeed_f);
+			float smoothspeed = 3.0 / g.timeelapsed_f;
+			t.entityelement[e].limbhurta_f = CurveValue(0, t.entityelement[e].limbhurta_f, smoothspeed);
 			if (abs(t.entityelement[e].limbhurta_f) < 1.0)
 			{
 				t.entityelement[e].limbhurta_f = 0;
 				t.entityelement[e].limbhurt = 0;
 			}
 			//  modify character limbs based on segment hurt
-			if (t.tobj > 0)
+			if (tobj > 0)
 			{
-				if (ObjectExist(t.tobj) == 1)
-				{
-					if (t.tsegmenttoflinch == 0)
-					{
-						if (t.spine2limbofcharacter > 0)
-						{
-							if (LimbExist(t.tobj, t.spine2limbofcharacter) == 1)
-							{
-								RotateLimb(t.tobj, t.spine2limbofcharacter, t.entityelement[e].limbhurta_f / 3.0, t.entityelement[e].limbhurta_f*-1, 0);
-							}
-						}
-					}
-					if (t.tsegmenttoflinch == 1)
-					{
-						if (t.headlimbofcharacter > 0)
-						{
-							if (LimbExist(t.tobj, t.headlimbofcharacter) == 1)
-							{
-								RotateLimb(t.tobj, t.headlimbofcharacter, t.entityelement[e].limbhurta_f, LimbAngleY(t.tobj, t.headlimbofcharacter), LimbAngleZ(t.tobj, t.headlimbofcharacter));
-							}
-						}
-					}
-				}
+				pData->flinchsegment = segment;
+				pData->flinchlimb = segment == 1 ? headlimb : spine2limb;
+				if (pData->flinchlimb > 0) pData->commands |= ENTITYLOOP_CMD_FLINCHLIMB;
 			}
 		}
 
 		// if entity using non-3d sound, needs to update based on camera position
-		// (can also be used for moving entities that LoopSound ( later) )
-		if (t.entityelement[e].soundisnonthreedee == 1)
+		if (t.entityelement[e].soundisnonthreedee == 1) pData->commands |= ENTITYLOOP_CMD_NONTHREEDEESOUND;
+
+		// character creator object
+		if (t.entityprofile[entid].ischaractercreator == 1) pData->commands |= ENTITYLOOP_CMD_CHARACTERHEAD;
+
+		// handle particle emitter entity (for when in game)
+
+		// if entity is a portal, add it to the portal renderer
+		if (t.entityprofile[entid].isportal == 1) pData->commands |= ENTITYLOOP_CMD_PORTAL;
+
+		// flag to destroy entity dead (can be set from LUA command or explosion trigger)
+		if (t.entityelement[e].destroyme == 1) pData->commands |= ENTITYLOOP_CMD_DESTROY;
+	}
+}
+
+void entity_loop_commands(entity_thread_data* pData)
+{
+	// main thread only, expects t.e to be the entity and carries out the
+	// side effects entity_loop_thread recorded in the same order the serial
+	// entity loop used to
+	int e = pData->e;
+	t.entid = t.entityelement[e].bankindex;
+	t.tobj = pData->obj;
+	t.dist_f = pData->dist;
+
+	//  Entity Prompt Local
+	if (pData->commands & ENTITYLOOP_CMD_PROMPT2D)
+	{
+		if (GetInScreen(t.tobj) == 1)
+		{
+			t.t_s = t.entityelement[e].overprompt_s; t.twidth = getbitmapfontwidth(t.t_s.Get(), 1) / 2;
+			pastebitmapfont(t.t_s.Get(), GetScreenX(t.tobj) - t.twidth, GetScreenY(t.tobj), 1, 255);
+		}
+	}
+#ifdef VRTECH
+	if (pData->commands & ENTITYLOOP_CMD_PROMPT3DHIDE)
+	{
+		lua_hideperentity3d(e);
+	}
+	if (pData->commands & ENTITYLOOP_CMD_PROMPT3DUPDATE)
+	{
+		lua_updateperentity3d(e, t.entityelement[e].overprompt_s.Get(), t.entityelement[e].overprompt3dX, t.entityelement[e].overprompt3dY, t.entityelement[e].overprompt3dZ, t.entityelement[e].overprompt3dAY, t.entityelement[e].overprompt3dFaceCamera);
+	}
+#endif
+
+	// if ragdoll and has force, apply it repeatedly
+	if (pData->commands & ENTITYLOOP_CMD_RAGDOLLFORCE)
+	{
+		BPhys_RagDollApplyForce(t.tobj, t.entityelement[e].ragdollifiedforcelimb, 0, 0, 0, t.entityelement[e].ragdollifiedforcex_f, t.entityelement[e].ragdollifiedforcey_f, t.entityelement[e].ragdollifiedforcez_f, pData->ragdollforce);
+	}
+
+	// in all active states, must repell player to avoid penetration
+	if (pData->commands & ENTITYLOOP_CMD_PUSHPLAYER)
+	{
+		t.playercontrol.pushforce_f = 1.0;
+		t.playercontrol.pushangle_f = pData->pushangle;
+	}
+
+	//  modify character limbs based on segment hurt
+	if (pData->commands & ENTITYLOOP_CMD_FLINCHLIMB)
+	{
+		if (ObjectExist(t.tobj) == 1)
 		{
-			t.entityelement[e].soundisnonthreedee = 0;
-			if (t.entityelement[e].soundset > 0)
+			if (LimbExist(t.tobj, pData->flinchlimb) == 1)
 			{
-				PositionSound(t.entityelement[e].soundset, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
-				if (SoundPlaying(t.entityelement[e].soundset) == 1)
+				if (pData->flinchsegment == 0)
 				{
-					t.entityelement[e].soundisnonthreedee = 1;
+					RotateLimb(t.tobj, pData->flinchlimb, t.entityelement[e].limbhurta_f / 3.0, t.entityelement[e].limbhurta_f*-1, 0);
 				}
-			}
-			if (t.entityelement[e].soundset1 > 0)
-			{
-				PositionSound(t.entityelement[e].soundset1, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
-				if (SoundPlaying(t.entityelement[e].soundset1) == 1)
+				else
 				{
-					t.entityelement[e].soundisnonthreedee = 1;
+					RotateLimb(t.tobj, pData->flinchlimb, t.entityelement[e].limbhurta_f, LimbAngleY(t.tobj, pData->flinchlimb), LimbAngleZ(t.tobj, pData->flinchlimb));
 				}
 			}
-			if (t.entityelement[e].soundset2 > 0)
+		}
+	}
+
+	// if entity using non-3d sound, needs to update based on camera position
+	// (can also be used for moving entities that LoopSound ( later) )
+	if (pData->commands & ENTITYLOOP_CMD_NONTHREEDEESOUND)
+	{
+		t.entityelement[e].soundisnonthreedee = 0;
+		if (t.entityelement[e].soundset > 0)
+		{
+			PositionSound(t.entityelement[e].soundset, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
+			if (SoundPlaying(t.entityelement[e].soundset) == 1)
 			{
-				PositionSound(t.entityelement[e].soundset2, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
-				if (SoundPlaying(t.entityelement[e].soundset2) == 1)
-				{
-					t.entityelement[e].soundisnonthreedee = 1;
-				}
+				t.entityelement[e].soundisnonthreedee = 1;
 			}
-			if (t.entityelement[e].soundset3 > 0)
+		}
+		if (t.entityelement[e].soundset1 > 0)
+		{
+			PositionSound(t.entityelement[e].soundset1, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
+			if (SoundPlaying(t.entityelement[e].soundset1) == 1)
 			{
-				PositionSound(t.entityelement[e].soundset3, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
-				if (SoundPlaying(t.entityelement[e].soundset3) == 1)
-				{
-					t.entityelement[e].soundisnonthreedee = 1;
-				}
+				t.entityelement[e].soundisnonthreedee = 1;
 			}
-			if (t.entityelement[e].soundset4 > 0)
+		}
+		if (t.entityelement[e].soundset2 > 0)
+		{
+			PositionSound(t.entityelement[e].soundset2, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
+			if (SoundPlaying(t.entityelement[e].soundset2) == 1)
 			{
-				PositionSound(t.entityelement[e].soundset4, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
-				if (SoundPlaying(t.entityelement[e].soundset4) == 1)
-				{
-					t.entityelement[e].soundisnonthreedee = 1;
-				}
+				t.entityelement[e].soundisnonthreedee = 1;
 			}
 		}
+		if (t.entityelement[e].soundset3 > 0)
+		{
+			PositionSound(t.entityelement[e].soundset3, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
+			if (SoundPlaying(t.entityelement[e].soundset3) == 1)
+			{
+				t.entityelement[e].soundisnonthreedee = 1;
+			}
+		}
+		if (t.entityelement[e].soundset4 > 0)
+		{
+			PositionSound(t.entityelement[e].soundset4, CameraPositionX(0), CameraPositionY(0), CameraPositionZ(0));
+			if (SoundPlaying(t.entityelement[e].soundset4) == 1)
+			{
+				t.entityelement[e].soundisnonthreedee = 1;
+			}
+		}
+	}
 
-		// character creator object
-		if (t.entityprofile[t.entid].ischaractercreator == 1)
+	// character creator object
+	if (pData->commands & ENTITYLOOP_CMD_CHARACTERHEAD)
+	{
+		t.tccobj = g.charactercreatorrmodelsoffset + ((e*3) - t.characterkitcontrol.offset);
+		if (ObjectExist(t.tccobj) == 1)
 		{
-			t.tccobj = g.charactercreatorrmodelsoffset + ((e*3) - t.characterkitcontrol.offset);
-			if (ObjectExist(t.tccobj) == 1)
+			// only glue head if enemy is visible
+			t.tconstantlygluehead = 0;
+			if (t.tobj > 0) { if (GetVisible(t.tobj) == 1) { t.tconstantlygluehead = 1; } }
+			if (t.game.runasmultiplayer == 1)
 			{
-				// only glue head if enemy is visible
-				t.tconstantlygluehead = 0;
-				if (t.tobj > 0) { if (GetVisible(t.tobj) == 1) { t.tconstantlygluehead = 1; } }
-				if (t.game.runasmultiplayer == 1)
+				// deal with multiplayer issues - if ( its me, ) only show me when im dead
+				if (t.characterkitcontrol.showmyhead == 1 && e == t.mp_playerEntityID[g.mp.me])
 				{
-					// deal with multiplayer issues - if ( its me, ) only show me when im dead
-					if (t.characterkitcontrol.showmyhead == 1 && e == t.mp_playerEntityID[g.mp.me])
-					{
-						t.tconstantlygluehead = 1;
-					}
-					// if other players are dead and transitioning to a new spawn postion
-					for (t.ttemploop = 0; t.ttemploop <= MP_MAX_NUMBER_OF_PLAYERS; t.ttemploop++)
+					t.tconstantlygluehead = 1;
+				}
+				// if other players are dead and transitioning to a new spawn postion
+				for (t.ttemploop = 0; t.ttemploop <= MP_MAX_NUMBER_OF_PLAYERS; t.ttemploop++)
+				{
+					if (t.ttemploop != g.mp.me)
 					{
-						if (t.ttemploop != g.mp.me)
-						{
 #ifdef PHOTONMP
-							int iAlive = PhotonGetPlayerAlive(t.ttemploop);
+						int iAlive = PhotonGetPlayerAlive(t.ttemploop);
 #else
-							int iAlive = SteamGetPlayerAlive(t.ttemploop);
+						int iAlive = SteamGetPlayerAlive(t.ttemploop);
 #endif
-							if (e == t.mp_playerEntityID[t.ttemploop] && t.mp_forcePosition[t.ttemploop] > 0 && iAlive == 1)
-							{
-								t.tconstantlygluehead = 0;
-							}
+						if (e == t.mp_playerEntityID[t.ttemploop] && t.mp_forcePosition[t.ttemploop] > 0 && iAlive == 1)
+						{
+							t.tconstantlygluehead = 0;
 						}
 					}
 				}
-				// if head is flagged to by glued, attach to body now
-				if (t.tconstantlygluehead == 1)
+			}
+			// if head is flagged to by glued, attach to body now
+			if (t.tconstantlygluehead == 1)
+			{
+				// NOTE; re-searching for head limb is a performance hit
+				t.tSourcebip01_head = getlimbbyname(t.entityelement[e].obj, "Bip01_Head");
+				if (t.tSourcebip01_head > 0)
 				{
-					// NOTE; re-searching for head limb is a performance hit
-					t.tSourcebip01_head = getlimbbyname(t.entityelement[e].obj, "Bip01_Head");
-					if (t.tSourcebip01_head > 0)
+					//Dave - fix to heads being backwards for characters when switched off (3000 units away)
+					float tdx = CameraPositionX(0) - ObjectPositionX(t.entityelement[e].obj);
+					float tdy = CameraPositionY(0) - ObjectPositionY(t.entityelement[e].obj);
+					float tdz = CameraPositionZ(0) - ObjectPositionZ(t.entityelement[e].obj);
+					float tdist = sqrt(tdx*tdx + tdy * tdy + tdz * tdz);
+					t.te = e; entity_getmaxfreezedistance();
+					if (tdist > t.maximumnonefreezedistance)
 					{
-						//Dave - fix to heads being backwards for characters when switched off (3000 units away)
-						float tdx = CameraPositionX(0) - ObjectPositionX(t.entityelement[e].obj);
-						float tdy = CameraPositionY(0) - ObjectPositionY(t.entityelement[e].obj);
-						float tdz = CameraPositionZ(0) - ObjectPositionZ(t.entityelement[e].obj);
-						float tdist = sqrt(tdx*tdx + tdy * tdy + tdz * tdz);
-						t.te = e; entity_getmaxfreezedistance();
-						if (tdist > t.maximumnonefreezedistance)
-						{
-							YRotateObject(t.tccobj, ObjectAngleY(t.entityelement[e].obj) - 180);
-						}
-						else
-						{
-							YRotateObject(t.tccobj, 0);
-						}
-						GlueObjectToLimbEx(t.tccobj, t.entityelement[e].obj, t.tSourcebip01_head, 2);
+						YRotateObject(t.tccobj, ObjectAngleY(t.entityelement[e].obj) - 180);
 					}
-				}
-				else
-				{
-					//  else unglue and hide the head
-					UnGlueObject(t.tccobj);
-					PositionObject(t.tccobj, 100000, 100000, 100000);
+					else
+					{
+						YRotateObject(t.tccobj, 0);
+					}
+					GlueObjectToLimbEx(t.tccobj, t.entityelement[e].obj, t.tSourcebip01_head, 2);
 				}
 			}
+			else
+			{
+				//  else unglue and hide the head
+				UnGlueObject(t.tccobj);
+				PositionObject(t.tccobj, 100000, 100000, 100000);
+			}
 		}
+	}
 
-		// handle particle emitter entity (for when in game)
+	// if entity is a portal, add it to the portal renderer
+	if (pData->commands & ENTITYLOOP_CMD_PORTAL)
+	{
+		g_pPortalRenderer->addPortal(
+			t.entityelement[e].eleprof.portal.p1,
+			t.entityelement[e].eleprof.portal.p2,
+			t.entityelement[e].eleprof.portal.p3,
+			t.entityelement[e].eleprof.portal.p4
+		);
+	}
 
-		// if entity is a portal, add it to the portal renderer
-		if (t.entityprofile[t.entid].isportal == 1)
+	// flag to destroy entity dead (can be set from LUA command or explosion trigger)
+	if (pData->commands & ENTITYLOOP_CMD_DESTROY)
+	{
+		// remove entity from game play
+		t.entityelement[e].destroyme = 0;
+		t.entityelement[e].active = 0;
+		t.entityelement[e].health = 0;
+		t.entityelement[e].lua.flagschanged = 2;
+		if (t.game.runasmultiplayer == 1)
 		{
-			g_pPortalRenderer->addPortal(
-				t.entityelement[e].eleprof.portal.p1,
-				t.entityelement[e].eleprof.portal.p2,
-				t.entityelement[e].eleprof.portal.p3,
-				t.entityelement[e].eleprof.portal.p4
-			);
+			mp_addDestroyedObject();
 		}
-
-		// flag to destroy entity dead (can be set from LUA command or explosion trigger)
-		if (t.entityelement[e].destroyme == 1)
+		t.obj = t.entityelement[e].obj;
+		if (t.obj > 0)
 		{
-			// remove entity from game play
-			t.entityelement[e].destroyme = 0;
-			t.entityelement[e].active = 0;
-			t.entityelement[e].health = 0;
-			t.entityelement[e].lua.flagschanged = 2;
-			if (t.game.runasmultiplayer == 1)
-			{
-				mp_addDestroyedObject();
-			}
-			t.obj = t.entityelement[e].obj;
-			if (t.obj > 0)
+			if (ObjectExist(t.obj) == 1)
 			{
-				if (ObjectExist(t.obj) == 1)
-				{
-					HideObject(t.obj);
-				}
+				HideObject(t.obj);
 			}
+		}
 
-			//  attempt to remove collision object
-			entity_lua_collisionoff();
+		//  attempt to remove collision object
+		entity_lua_collisionoff();
 
-			//  possible remove character
-			entity_lua_findcharanimstate();
-			if (t.tcharanimindex != -1)
-			{
-				//  deactivate DarkA.I for this dead entity
-				darkai_killai();
+		//  possible remove character
+		entity_lua_findcharanimstate();
+		if (t.tcharanimindex != -1)
+		{
+			//  deactivate DarkA.I for this dead entity
+			darkai_killai();
 
-				//  Convert object back to instance and hide it
-				darkai_character_remove();
-				t.charanimstates[t.tcharanimindex] = t.charanimstate;
-			}
-			else
-			{
-				//  can still have non-character ragdoll (zombie), so remove ragdoll if so
-				t.tphyobj = t.obj; ragdoll_destroy();
-			}
+			//  Convert object back to instance and hide it
+			darkai_character_remove();
+			t.charanimstates[t.tcharanimindex] = t.charanimstate;
+		}
+		else
+		{
+			//  can still have non-character ragdoll (zombie), so remove ragdoll if so
+			t.tphyobj = t.obj; ragdoll_destroy();
 		}
 	}
 }
 
 void entity_loop ( void )
 {
-	//  Handle all entities in level
-	std::vector< std::future<void> > results;
-	for (t.e = 1; t.e <= g.entityelementlist; t.e++)
-	{
+	//  Handle all entities in level, each entity updates its own context in parallel
+	static std::vector<entity_thread_data> entitythreaddata;
+	if ((int)entitythreaddata.size() < g.entityelementlist + 1) entitythreaddata.resize(g.entityelementlist + 1);
+	g_pThreadPool->parallel_for(1, g.entityelementlist + 1, 32, [](int e)
+	{
+		entity_thread_data* pData = &entitythreaddata[e];
+		pData->e = e;
+		pData->commands = 0;
 		// 011016 - scenes with LARGE number of static entities hitting perf hard
-		if (t.entityelement[t.e].staticflag == 1 && t.entityelement[t.e].eleprof.phyalways == 0) continue;
+		if (t.entityelement[e].staticflag == 1 && t.entityelement[e].eleprof.phyalways == 0) return;
 		// NOTE: Determine essential tasks static needs (i.e. plrdist??)
-		entity_thread_data* pData = new entity_thread_data();
-		pData->e = t.e;
-		results.emplace_back(g_pThreadPool->enqueue(entity_loop_thread, pData));
-	}
+		entity_loop_thread(pData);
+	});
 
-	for (auto && result : results)
-		result.get();
+	//  then side effects are applied on this thread in entity order
+	for (t.e = 1; t.e <= g.entityelementlist; t.e++)
+	{
+		if (entitythreaddata[t.e].commands != 0) entity_loop_commands(&entitythreaddata[t.e]);
+	}
 
 	//  handle explosion triggers in separate loop as they call
 	//  other subroutines that use E and other entity calls (i.e. physics_explodesphere)
@@ -2970,10 +3032,12 @@ void entity_createobj ( void )
 		//  SetObject (  properties )
 		t.tobj=t.obj ; t.tte=t.tupdatee ; entity_prepareobj ( );
 
-		// Add object to LOD manager
+		// Add object to LOD manager, static entities only have their position refreshed occasionally
 		if (g_pLODManager)
 		{
-			g_pLODManager->addObject(t.obj);
+			bool bDynamic = true;
+			if ( t.tupdatee != -1 && t.entityelement[t.tupdatee].staticflag == 1 ) bDynamic = false;
+			g_pLODManager->addObject(t.obj, bDynamic);
 		}
 
 		//  check if a character creator entity
@@ -3174,19 +3238,25 @@ void entity_prepareobj ( void )
 void entity_calculateentityLODdistances ( int tentid, int tobj, int iModifier )
 {
 	float fLODModifier = (100+iModifier)/100.0f;
+	float fLOD1Distance, fLOD2Distance;
 	if ( t.entityprofile[tentid].lod1distance==0 )
 	{
 		// default LOD distances a product of scale of object
 		float fRelativeScale = ObjectSize ( tobj, 1 ) / 100.0f;
-		SetObjectLOD ( tobj, 1, 400.0f * fRelativeScale * fLODModifier );
-		SetObjectLOD ( tobj, 2, 800.0f * fRelativeScale * fLODModifier );
+		fLOD1Distance = 400.0f * fRelativeScale * fLODModifier;
+		fLOD2Distance = 800.0f * fRelativeScale * fLODModifier;
 	}
 	else
 	{
 		// otherwise its specified by the FPE
-		SetObjectLOD ( tobj, 1, (float)t.entityprofile[tentid].lod1distance * fLODModifier );
-		SetObjectLOD ( tobj, 2, (float)t.entityprofile[tentid].lod2distance * fLODModifier );
+		fLOD1Distance = (float)t.entityprofile[tentid].lod1distance * fLODModifier;
+		fLOD2Distance = (float)t.entityprofile[tentid].lod2distance * fLODModifier;
 	}
+	SetObjectLOD ( tobj, 1, fLOD1Distance );
+	SetObjectLOD ( tobj, 2, fLOD2Distance );
+
+	// keep any LOD manager entry in step with the new distances
+	if ( g_pLODManager ) g_pLODManager->setDistances ( tobj, fLOD1Distance, fLOD2Distance );
 }
 
 void entity_setupcharobjsettings ( void )
@@ -2,46 +2,276 @@
 #include "gameguru.h"
 #include "LODManager.h"
 #include "CObjectsC.h"
+#include <emmintrin.h>
+#include <float.h>
+
+// static objects have their position re-read in a rolling window of this many slots per update
+#define LODMANAGER_STATIC_REFRESH 256
 
 LODManager::LODManager()
 {
+    count = 0;
+    hysteresis = 0.05f;
+    staticRefresh = 0;
 }
 
 LODManager::~LODManager()
 {
 }
 
-void LODManager::addObject(int objectID)
+void LODManager::clear()
 {
-    LODObject lodObject;
-    lodObject.objectID = objectID;
-    lodObject.lodLevel = 0;
-    objects.push_back(lodObject);
+    count = 0;
+    staticRefresh = 0;
+    objectID.clear();
+    posX.clear();
+    posY.clear();
+    posZ.clear();
+    lod1Distance.clear();
+    lod2Distance.clear();
+    lod1Near.clear();
+    lod1Far.clear();
+    lod2Near.clear();
+    lod2Far.clear();
+    level.clear();
+    isDynamic.clear();
+    slotOfObject.clear();
+    dynamicSlots.clear();
+}
+
+void LODManager::grow(int newCount)
+{
+    // pad lanes never change level, so the SIMD loop needs no remainder
+    int slots = (newCount + 3) & ~3;
+    if (slots <= (int)objectID.size())
+        return;
+
+    objectID.resize(slots, 0);
+    posX.resize(slots, 0.0f);
+    posY.resize(slots, 0.0f);
+    posZ.resize(slots, 0.0f);
+    lod1Distance.resize(slots, 0.0f);
+    lod2Distance.resize(slots, 0.0f);
+    lod1Near.resize(slots, FLT_MAX);
+    lod1Far.resize(slots, FLT_MAX);
+    lod2Near.resize(slots, FLT_MAX);
+    lod2Far.resize(slots, FLT_MAX);
+    level.resize(slots, 0);
+    isDynamic.resize(slots, 0);
+}
+
+void LODManager::setThresholds(int slot, float lod1, float lod2)
+{
+    float nearScale = 1.0f - hysteresis;
+    float farScale = 1.0f + hysteresis;
+    lod1Distance[slot] = lod1;
+    lod2Distance[slot] = lod2;
+    lod1Near[slot] = (lod1 * nearScale) * (lod1 * nearScale);
+    lod1Far[slot] = (lod1 * farScale) * (lod1 * farScale);
+    lod2Near[slot] = (lod2 * nearScale) * (lod2 * nearScale);
+    lod2Far[slot] = (lod2 * farScale) * (lod2 * farScale);
+}
+
+void LODManager::refreshPosition(int slot)
+{
+    sObject* pObject = GetObjectData(objectID[slot]);
+    if (pObject)
+    {
+        posX[slot] = pObject->position.vecPosition.x;
+        posY[slot] = pObject->position.vecPosition.y;
+        posZ[slot] = pObject->position.vecPosition.z;
+    }
+}
+
+void LODManager::addObject(int id, bool dynamic)
+{
+    sObject* pObject = GetObjectData(id);
+    if (id <= 0 || pObject == NULL)
+        return;
+
+    if (id >= (int)slotOfObject.size())
+        slotOfObject.resize(id + 1, -1);
+
+    // an object number reused by a new object keeps its slot
+    int slot = slotOfObject[id];
+    if (slot < 0)
+    {
+        slot = count++;
+        grow(count);
+        slotOfObject[id] = slot;
+        objectID[slot] = id;
+    }
+
+    if (dynamic && !isDynamic[slot])
+    {
+        dynamicSlots.push_back(slot);
+    }
+    else if (!dynamic && isDynamic[slot])
+    {
+        for (size_t i = 0; i < dynamicSlots.size(); i++)
+        {
+            if (dynamicSlots[i] == slot)
+            {
+                dynamicSlots[i] = dynamicSlots.back();
+                dynamicSlots.pop_back();
+                break;
+            }
+        }
+    }
+    isDynamic[slot] = dynamic ? 1 : 0;
+
+    refreshPosition(slot);
+    setThresholds(slot, pObject->fLODDistance[0], pObject->fLODDistance[1]);
+
+    // let the first update decide and apply the level
+    level[slot] = -1;
+}
+
+void LODManager::removeObject(int id)
+{
+    if (id <= 0 || id >= (int)slotOfObject.size())
+        return;
+    int slot = slotOfObject[id];
+    if (slot < 0)
+        return;
+    slotOfObject[id] = -1;
+
+    for (size_t i = 0; i < dynamicSlots.size(); i++)
+    {
+        if (dynamicSlots[i] == slot)
+        {
+            dynamicSlots[i] = dynamicSlots.back();
+            dynamicSlots.pop_back();
+            break;
+        }
+    }
+
+    int last = --count;
+    if (slot != last)
+    {
+        objectID[slot] = objectID[last];
+        posX[slot] = posX[last];
+        posY[slot] = posY[last];
+        posZ[slot] = posZ[last];
+        lod1Distance[slot] = lod1Distance[last];
+        lod2Distance[slot] = lod2Distance[last];
+        lod1Near[slot] = lod1Near[last];
+        lod1Far[slot] = lod1Far[last];
+        lod2Near[slot] = lod2Near[last];
+        lod2Far[slot] = lod2Far[last];
+        level[slot] = level[last];
+        isDynamic[slot] = isDynamic[last];
+        slotOfObject[objectID[slot]] = slot;
+        for (size_t i = 0; i < dynamicSlots.size(); i++)
+        {
+            if (dynamicSlots[i] == last)
+            {
+                dynamicSlots[i] = slot;
+                break;
+            }
+        }
+    }
+
+    // the freed slot becomes a pad lane again, which never changes level
+    objectID[last] = 0;
+    posX[last] = 0.0f;
+    posY[last] = 0.0f;
+    posZ[last] = 0.0f;
+    lod1Distance[last] = 0.0f;
+    lod2Distance[last] = 0.0f;
+    lod1Near[last] = FLT_MAX;
+    lod1Far[last] = FLT_MAX;
+    lod2Near[last] = FLT_MAX;
+    lod2Far[last] = FLT_MAX;
+    level[last] = 0;
+    isDynamic[last] = 0;
+}
+
+void LODManager::setDistances(int id, float lod1, float lod2)
+{
+    if (id <= 0 || id >= (int)slotOfObject.size())
+        return;
+    int slot = slotOfObject[id];
+    if (slot >= 0)
+        setThresholds(slot, lod1, lod2);
+}
+
+void LODManager::setHysteresis(float fraction)
+{
+    if (fraction < 0.0f) fraction = 0.0f;
+    if (fraction > 0.5f) fraction = 0.5f;
+    hysteresis = fraction;
+    for (int slot = 0; slot < count; slot++)
+        setThresholds(slot, lod1Distance[slot], lod2Distance[slot]);
+}
+
+void LODManager::applyLevel(int slot)
+{
+    sObject* pObject = GetObjectData(objectID[slot]);
+    if (pObject == NULL)
+        return;
+
+    // limb style LOD objects render the level chosen here rather than
+    // comparing against the camera distance themselves
+    int newLodLevel = level[slot];
+    pObject->iLODManagedLevel = newLodLevel;
+    if (pObject->pLodTexture[newLodLevel])
+    {
+        pObject->pTextures[0].pTexture = pObject->pLodTexture[newLodLevel];
+    }
 }
 
 void LODManager::update(const cVector3& cameraPosition)
 {
-    for (auto& lodObject : objects)
+    if (count == 0)
+        return;
+
+    // moving objects every frame, the rest a few at a time
+    for (size_t i = 0; i < dynamicSlots.size(); i++)
+        refreshPosition(dynamicSlots[i]);
+    int refresh = count < LODMANAGER_STATIC_REFRESH ? count : LODMANAGER_STATIC_REFRESH;
+    for (int i = 0; i < refresh; i++)
+    {
+        if (staticRefresh >= count) staticRefresh = 0;
+        if (!isDynamic[staticRefresh]) refreshPosition(staticRefresh);
+        staticRefresh++;
+    }
+
+    const __m128 camX = _mm_set1_ps(cameraPosition.x);
+    const __m128 camY = _mm_set1_ps(cameraPosition.y);
+    const __m128 camZ = _mm_set1_ps(cameraPosition.z);
+    const __m128i levelOne = _mm_set1_epi32(1);
+    const __m128i levelTwo = _mm_set1_epi32(2);
+
+    int slots = (int)objectID.size();
+    for (int i = 0; i < slots; i += 4)
     {
-        sObject* pObject = GetObjectData(lodObject.objectID);
-        if (pObject)
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&posX[i]), camX);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&posY[i]), camY);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&posZ[i]), camZ);
+        __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        // an object already past a boundary uses the near threshold to come back,
+        // one still inside it uses the far threshold to cross
+        __m128i oldLevel = _mm_loadu_si128((const __m128i*)&level[i]);
+        __m128 atLevel1 = _mm_castsi128_ps(_mm_cmpgt_epi32(oldLevel, _mm_setzero_si128()));
+        __m128 atLevel2 = _mm_castsi128_ps(_mm_cmpgt_epi32(oldLevel, levelOne));
+        __m128 threshold1 = _mm_or_ps(_mm_and_ps(atLevel1, _mm_loadu_ps(&lod1Near[i])), _mm_andnot_ps(atLevel1, _mm_loadu_ps(&lod1Far[i])));
+        __m128 threshold2 = _mm_or_ps(_mm_and_ps(atLevel2, _mm_loadu_ps(&lod2Near[i])), _mm_andnot_ps(atLevel2, _mm_loadu_ps(&lod2Far[i])));
+
+        // same order as the renderer, beyond LOD2 wins even if LOD1 is further
+        __m128i beyond1 = _mm_castps_si128(_mm_cmpgt_ps(distanceSq, threshold1));
+        __m128i beyond2 = _mm_castps_si128(_mm_cmpgt_ps(distanceSq, threshold2));
+        __m128i newLevel = _mm_or_si128(_mm_and_si128(beyond2, levelTwo), _mm_andnot_si128(beyond2, _mm_and_si128(beyond1, levelOne)));
+
+        int unchanged = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(newLevel, oldLevel)));
+        if (unchanged != 0xF)
         {
-            float distance = (pObject->position.vecPosition - cameraPosition).Length();
-            int newLodLevel = 0;
-            if (distance > 1000.0f)
-                newLodLevel = 1;
-            if (distance > 2000.0f)
-                newLodLevel = 2;
-            if (distance > 4000.0f)
-                newLodLevel = 3;
-
-            if (newLodLevel != lodObject.lodLevel)
+            _mm_storeu_si128((__m128i*)&level[i], newLevel);
+            for (int lane = 0; lane < 4; lane++)
             {
-                lodObject.lodLevel = newLodLevel;
-                if (pObject->pLodTexture[newLodLevel])
-                {
-                    pObject->pTextures[0].pTexture = pObject->pLodTexture[newLodLevel];
-                }
+                if ((unchanged & (1 << lane)) == 0)
+                    applyLevel(i + lane);
             }
         }
     }
@@ -3962,11 +3962,7 @@ void c_entity_loadelementsdata ( void )
 
 	// load entity element list
 	t.failedtoload=0;
-	#ifdef VRTECH
-	t.versionnumbersupported = 313;
-	#else
-	t.versionnumbersupported = 312;
-	#endif
+	t.versionnumbersupported = ENTITYELEMENTVERSION;
 
 	if ( FileExist(t.elementsfilename_s.Get()) == 1 ) 
 	{
@@ -4418,65 +4414,75 @@ void c_entity_loadelementsdata ( void )
 		}
 		c_CloseFile (  1 );
 
-		// 050416 - remove any weapons from start marker if parental control, no weapon, no violence
-		if ( g.quickparentalcontrolmode == 2 )
+		//  keep a binary copy so the next load of this map.ele can skip parsing
+		if ( t.failedtoload == 0 ) entity_saveelementsbinary ( );
+
+		//  parental control, replacements and invalid profiles
+		entity_loadelementsdata_finish ( );
+	}
+}
+#endif
+void entity_loadelementsdata_finish ( void )
+{
+	//  Common to map.ele and binary element loading once the elements are in place
+	// 050416 - remove any weapons from start marker if parental control, no weapon, no violence
+	if ( g.quickparentalcontrolmode == 2 )
+	{
+		for ( t.e = 1 ; t.e <= g.entityelementlist; t.e++ )
 		{
-			for ( t.e = 1 ; t.e <= g.entityelementlist; t.e++ )
+			t.entid = t.entityelement[t.e].bankindex;
+			if (  t.entityprofile[t.entid].ismarker == 1 ) 
 			{
-				t.entid = t.entityelement[t.e].bankindex;
-				if (  t.entityprofile[t.entid].ismarker == 1 ) 
-				{
-					//  Player Start Marker Settings
-					t.entityelement[t.e].eleprof.hasweapon_s = "";
-					t.entityelement[t.e].eleprof.hasweapon = 0;
-					t.entityelement[t.e].eleprof.quantity = 0;
-					t.entityelement[t.e].eleprof.isviolent = 0;
-				}
+				//  Player Start Marker Settings
+				t.entityelement[t.e].eleprof.hasweapon_s = "";
+				t.entityelement[t.e].eleprof.hasweapon = 0;
+				t.entityelement[t.e].eleprof.quantity = 0;
+				t.entityelement[t.e].eleprof.isviolent = 0;
 			}
 		}
+	}
 
-		//  If replacement file active, can swap in new SCRIPT and SOUND references
-		if (  Len(t.editor.replacefilepresent_s.Get())>1 ) 
+	//  If replacement file active, can swap in new SCRIPT and SOUND references
+	if (  Len(t.editor.replacefilepresent_s.Get())>1 ) 
+	{
+		//  now go through ELEPROF enrties to update any SCRIPTBANK references and SOUNDSET references
+		for ( t.e = 1 ; t.e<=  g.entityelementlist; t.e++ )
 		{
-			//  now go through ELEPROF enrties to update any SCRIPTBANK references and SOUNDSET references
-			for ( t.e = 1 ; t.e<=  g.entityelementlist; t.e++ )
+			for ( t.tcheck = 1 ; t.tcheck <= 6; t.tcheck++ )
 			{
-				for (t.tcheck = 1; t.tcheck <= 6; t.tcheck++)
+				if (  t.tcheck == 1  )  t.tcheck_s = t.entityelement[t.e].eleprof.aimain_s;
+				if (  t.tcheck == 2  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset_s;
+				if (  t.tcheck == 3  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset1_s;
+				if (  t.tcheck == 4  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset2_s;
+				if (  t.tcheck == 5  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset3_s;
+				if (  t.tcheck == 6  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset4_s;
+				t.ttry_s="";
+				for ( t.nn = 1 ; t.nn<=  Len(t.tcheck_s.Get()); t.nn++ )
 				{
-					if (  t.tcheck == 1  )  t.tcheck_s = t.entityelement[t.e].eleprof.aimain_s;
-					if (  t.tcheck == 2  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset_s;
-					if (  t.tcheck == 3  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset1_s;
-					if (  t.tcheck == 4  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset2_s;
-					if (  t.tcheck == 5  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset3_s;
-					if (  t.tcheck == 6  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset4_s;
-					t.ttry_s="";
-					for ( t.nn = 1 ; t.nn<=  Len(t.tcheck_s.Get()); t.nn++ )
-					{
-						t.ttry_s=t.ttry_s+Mid(t.tcheck_s.Get(),t.nn);
-						if (  (cstr(Mid(t.tcheck_s.Get(),t.nn)) == "\\" && cstr(Mid(t.tcheck_s.Get(),t.nn+1)) == "\\") || (cstr(Mid(t.tcheck_s.Get(),t.nn)) == "/" && cstr(Mid(t.tcheck_s.Get(),t.nn+1)) == "/") ) 
-						{
-							++t.nn;
-						}
+					t.ttry_s=t.ttry_s+Mid(t.tcheck_s.Get(),t.nn);
+					if (  (cstr(Mid(t.tcheck_s.Get(),t.nn)) == "\\" && cstr(Mid(t.tcheck_s.Get(),t.nn+1)) == "\\") || (cstr(Mid(t.tcheck_s.Get(),t.nn)) == "/" && cstr(Mid(t.tcheck_s.Get(),t.nn+1)) == "/") ) 
+					{
+						++t.nn;
 					}
-					t.ttry_s=Lower(t.ttry_s.Get());
-					for ( t.tt = 1 ; t.tt<=  t.treplacementmax; t.tt++ )
+				}
+				t.ttry_s=Lower(t.ttry_s.Get());
+				for ( t.tt = 1 ; t.tt<=  t.treplacementmax; t.tt++ )
+				{
+					if (  t.replacements_s[t.tt][0] == t.ttry_s ) 
 					{
-						if (  t.replacements_s[t.tt][0] == t.ttry_s ) 
-						{
-							//  found entry we can replace
-							if (  t.tcheck == 1 ) { t.entityelement[t.e].eleprof.aimain_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 2 ) { t.entityelement[t.e].eleprof.soundset_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 3 ) { t.entityelement[t.e].eleprof.soundset1_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 4 ) { t.entityelement[t.e].eleprof.soundset2_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 5 ) { t.entityelement[t.e].eleprof.soundset3_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 6 ) { t.entityelement[t.e].eleprof.soundset4_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-						}
+						//  found entry we can replace
+						if (  t.tcheck == 1 ) { t.entityelement[t.e].eleprof.aimain_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
+						if (  t.tcheck == 2 ) { t.entityelement[t.e].eleprof.soundset_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
+						if (  t.tcheck == 3 ) { t.entityelement[t.e].eleprof.soundset1_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
+						if (  t.tcheck == 4 ) { t.entityelement[t.e].eleprof.soundset2_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
+						if (  t.tcheck == 5 ) { t.entityelement[t.e].eleprof.soundset3_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
+						if (  t.tcheck == 6 ) { t.entityelement[t.e].eleprof.soundset4_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
 					}
 				}
 			}
-			//  free usages
-			UnDim (  t.replacements_s );
 		}
+		//  free usages
+		UnDim (  t.replacements_s );
 	}
 
 	// and erase any elements that DO NOT have a valid profile (file moved/deleted)
@@ -4512,9 +4518,12 @@ void c_entity_loadelementsdata ( void )
 		}
 	}
 }
-#endif
+
 void entity_loadelementsdata ( void )
 {
+	//  binary element copy is used when it was made from the current map.ele
+	if ( entity_loadelementsbinary ( ) == 1 ) return;
+
 	#ifdef USEFASTLOADING
 	c_entity_loadelementsdata();
 	return;
@@ -4527,11 +4536,7 @@ void entity_loadelementsdata ( void )
 
 	// load entity element list
 	t.failedtoload=0;
-	#ifdef VRTECH
-	t.versionnumbersupported = 313;
-	#else
-	t.versionnumbersupported = 312;
-	#endif
+	t.versionnumbersupported = ENTITYELEMENTVERSION;
 
 	if ( FileExist(t.elementsfilename_s.Get()) == 1 ) 
 	{
@@ -4951,98 +4956,11 @@ void entity_loadelementsdata ( void )
 		}
 		CloseFile (  1 );
 
-		// 050416 - remove any weapons from start marker if parental control, no weapon, no violence
-		if ( g.quickparentalcontrolmode == 2 )
-		{
-			for ( t.e = 1 ; t.e <= g.entityelementlist; t.e++ )
-			{
-				t.entid = t.entityelement[t.e].bankindex;
-				if (  t.entityprofile[t.entid].ismarker == 1 ) 
-				{
-					//  Player Start Marker Settings
-					t.entityelement[t.e].eleprof.hasweapon_s = "";
-					t.entityelement[t.e].eleprof.hasweapon = 0;
-					t.entityelement[t.e].eleprof.quantity = 0;
-					t.entityelement[t.e].eleprof.isviolent = 0;
-				}
-			}
-		}
+		//  keep a binary copy so the next load of this map.ele can skip parsing
+		if ( t.failedtoload == 0 ) entity_saveelementsbinary ( );
 
-		//  If replacement file active, can swap in new SCRIPT and SOUND references
-		if (  Len(t.editor.replacefilepresent_s.Get())>1 ) 
-		{
-			//  now go through ELEPROF enrties to update any SCRIPTBANK references and SOUNDSET references
-			for ( t.e = 1 ; t.e<=  g.entityelementlist; t.e++ )
-			{
-				for ( t.tcheck = 1 ; t.tcheck <= 6; t.tcheck++ )
-				{
-					if (  t.tcheck == 1  )  t.tcheck_s = t.entityelement[t.e].eleprof.aimain_s;
-					if (  t.tcheck == 2  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset_s;
-					if (  t.tcheck == 3  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset1_s;
-					if (  t.tcheck == 4  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset2_s;
-					if (  t.tcheck == 5  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset3_s;
-					if (  t.tcheck == 6  )  t.tcheck_s = t.entityelement[t.e].eleprof.soundset4_s;
-					t.ttry_s="";
-					for ( t.nn = 1 ; t.nn<=  Len(t.tcheck_s.Get()); t.nn++ )
-					{
-						t.ttry_s=t.ttry_s+Mid(t.tcheck_s.Get(),t.nn);
-						if (  (cstr(Mid(t.tcheck_s.Get(),t.nn)) == "\\" && cstr(Mid(t.tcheck_s.Get(),t.nn+1)) == "\\") || (cstr(Mid(t.tcheck_s.Get(),t.nn)) == "/" && cstr(Mid(t.tcheck_s.Get(),t.nn+1)) == "/") ) 
-						{
-							++t.nn;
-						}
-					}
-					t.ttry_s=Lower(t.ttry_s.Get());
-					for ( t.tt = 1 ; t.tt<=  t.treplacementmax; t.tt++ )
-					{
-						if (  t.replacements_s[t.tt][0] == t.ttry_s ) 
-						{
-							//  found entry we can replace
-							if (  t.tcheck == 1 ) { t.entityelement[t.e].eleprof.aimain_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 2 ) { t.entityelement[t.e].eleprof.soundset_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 3 ) { t.entityelement[t.e].eleprof.soundset1_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 4 ) { t.entityelement[t.e].eleprof.soundset2_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 5 ) { t.entityelement[t.e].eleprof.soundset3_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-							if (  t.tcheck == 6 ) { t.entityelement[t.e].eleprof.soundset4_s = t.replacements_s[t.tt][1]  ; t.tt = t.treplacementmax+1; }
-						}
-					}
-				}
-			}
-			//  free usages
-			UnDim (  t.replacements_s );
-		}
-	}
-
-	// and erase any elements that DO NOT have a valid profile (file moved/deleted)
-	if ( t.failedtoload == 1 ) 
-	{
-		//  FPGC - 270410 - if entity binary from X10 (or just not supported), ensure NO entities!
-		g.entityelementlist=0;
-		g.entityelementmax=0;
-	}
-	else
-	{
-		for ( t.e = 1 ; t.e <= g.entityelementlist; t.e++ )
-		{
-			t.entid=t.entityelement[t.e].bankindex;
-			if (  t.entid>0 ) 
-			{
-				if (  t.entid>ArrayCount(t.entitybank_s) ) 
-				{
-					t.entityelement[t.e].bankindex=0;
-				}
-				else
-				{
-					if (  Len(t.entitybank_s[t.entid].Get()) == 0 ) 
-					{
-						//  030715 - but only erase if entity not a marker
-						if (  t.entityprofile[t.entid].ismarker == 0 ) 
-						{
-							t.entityelement[t.e].bankindex=0;
-						}
-					}
-				}
-			}
-		}
+		//  parental control, replacements and invalid profiles
+		entity_loadelementsdata_finish ( );
 	}
 }
 
@@ -5060,11 +4978,7 @@ void entity_saveelementsdata ( void )
 	g.entityelementlist=t.e;
 
 	//  Save entity element list
-	#ifdef VRTECH
-	t.versionnumbersave = 313;
-	#else
-	t.versionnumbersave = 312;
-	#endif
+	t.versionnumbersave = ENTITYELEMENTVERSION;
 	if ( FileExist(t.elementsfilename_s.Get()) == 1  )  DeleteAFile ( t.elementsfilename_s.Get() );
 	OpenToWrite (  1,t.elementsfilename_s.Get() );
 	WriteLong (  1,t.versionnumbersave );
@@ -5351,6 +5265,327 @@ void entity_saveelementsdata ( void )
 		}
 	}
 	CloseFile (  1 );
+
+	//  and the binary copy that loads without parsing
+	entity_saveelementsbinary ( );
+}
+
+//  Binary element data (map.elb), a fixed layout copy of map.ele that is memory mapped
+//  and copied straight into entityelement. It records the size and checksum of the
+//  map.ele it was made from so any change to map.ele makes it ignored and rebuilt
+
+#define ELEMENTBINARYMAGIC		0x42454747
+#define ELEMENTBINARYVERSION	2
+#define ELEMENTBINARYMAXLONGS	96
+#define ELEMENTBINARYMAXFLOATS	20
+#define ELEMENTBINARYMAXSTRINGS	16
+
+struct sEntityElementBinaryHeader
+{
+	DWORD dwMagic;
+	DWORD dwVersion;
+	DWORD dwElementVersion;
+	DWORD dwSourceSize;
+	DWORD dwSourceChecksum;
+	DWORD dwSourceTimeLow;
+	DWORD dwSourceTimeHigh;
+	DWORD dwCount;
+	DWORD dwRecordSize;
+	DWORD dwStringTableSize;
+};
+
+struct sEntityElementBinaryRecord
+{
+	int iLong[ELEMENTBINARYMAXLONGS];
+	float fFloat[ELEMENTBINARYMAXFLOATS];
+	DWORD dwString[ELEMENTBINARYMAXSTRINGS];
+};
+
+cstr entity_elementsbinaryfilename ( void )
+{
+	// map.ele becomes map.elb
+	cstr binaryfilename_s = Left(t.elementsfilename_s.Get(), Len(t.elementsfilename_s.Get()) - 4);
+	binaryfilename_s = binaryfilename_s + ".elb";
+	return binaryfilename_s;
+}
+
+bool entity_elementsfilestamp ( LPSTR pFilename, DWORD* pdwSize, FILETIME* pWriteTime )
+{
+	// size and last write time, cheap enough to check on every load
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if ( GetFileAttributesEx ( pFilename, GetFileExInfoStandard, &data ) == 0 ) return false;
+	if ( data.nFileSizeHigh != 0 ) return false;
+	*pdwSize = data.nFileSizeLow;
+	*pWriteTime = data.ftLastWriteTime;
+	return true;
+}
+
+bool entity_elementsfilechecksum ( LPSTR pFilename, DWORD* pdwSize, DWORD* pdwChecksum )
+{
+	HANDLE hFile = GG_CreateFile ( pFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE ) return false;
+	DWORD dwSize = GetFileSize ( hFile, NULL );
+	DWORD dwChecksum = 2166136261;
+	if ( dwSize > 0 )
+	{
+		HANDLE hMap = CreateFileMapping ( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+		LPBYTE pData = hMap ? (LPBYTE)MapViewOfFile ( hMap, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+		if ( pData == NULL )
+		{
+			if ( hMap ) CloseHandle ( hMap );
+			CloseHandle ( hFile );
+			return false;
+		}
+		for ( DWORD n = 0; n < dwSize; n++ )
+		{
+			dwChecksum = ( dwChecksum ^ pData[n] ) * 16777619;
+		}
+		UnmapViewOfFile ( pData );
+		CloseHandle ( hMap );
+	}
+	CloseHandle ( hFile );
+	*pdwSize = dwSize;
+	*pdwChecksum = dwChecksum;
+	return true;
+}
+
+void entity_transferelementbinary ( int e, sEntityElementBinaryRecord* pRecord, bool bToRecord, std::vector<char>* pStringTable, const char* pStrings, DWORD dwStringsSize )
+{
+	// one list of fields for both directions, so the record layout cannot drift between save and load,
+	// values are stored as map.ele would give them back (colour alpha and scale are fixed up there)
+	int iL = 0, iF = 0, iS = 0;
+	#define ELB_LONG(v) { if ( bToRecord ) pRecord->iLong[iL] = (int)(v); else v = pRecord->iLong[iL]; iL++; }
+	#define ELB_FLOAT(v) { if ( bToRecord ) pRecord->fFloat[iF] = (float)(v); else v = pRecord->fFloat[iF]; iF++; }
+	#define ELB_COLOR(v) { if ( bToRecord ) pRecord->iLong[iL] = (int)((((DWORD)(v)<<8)>>8) + 0xFF000000); else v = (DWORD)pRecord->iLong[iL]; iL++; }
+	#define ELB_SCALE(v) { if ( bToRecord ) pRecord->fFloat[iF] = (v) > 1e8 ? 0 : (float)(v); else v = pRecord->fFloat[iF]; iF++; }
+	#define ELB_STRING(v) { if ( bToRecord ) { pRecord->dwString[iS] = (DWORD)pStringTable->size(); LPSTR pStr = (v).Get(); pStringTable->insert ( pStringTable->end(), pStr, pStr + strlen(pStr) + 1 ); } else v = pRecord->dwString[iS] < dwStringsSize ? pStrings + pRecord->dwString[iS] : ""; iS++; }
+	entitytype& ele = t.entityelement[e];
+	ELB_LONG ( ele.maintype ); ELB_LONG ( ele.bankindex ); ELB_LONG ( ele.staticflag );
+	ELB_FLOAT ( ele.x ); ELB_FLOAT ( ele.y ); ELB_FLOAT ( ele.z );
+	ELB_FLOAT ( ele.rx ); ELB_FLOAT ( ele.ry ); ELB_FLOAT ( ele.rz );
+	ELB_STRING ( ele.eleprof.name_s ); ELB_STRING ( ele.eleprof.aimain_s );
+	ELB_LONG ( ele.eleprof.isobjective );
+	ELB_STRING ( ele.eleprof.usekey_s ); ELB_STRING ( ele.eleprof.ifused_s );
+	ELB_LONG ( ele.eleprof.uniqueelement );
+	ELB_STRING ( ele.eleprof.texd_s ); ELB_STRING ( ele.eleprof.texaltd_s ); ELB_STRING ( ele.eleprof.effect_s );
+	ELB_LONG ( ele.eleprof.transparency ); ELB_LONG ( ele.editorfixed );
+	ELB_STRING ( ele.eleprof.soundset_s ); ELB_STRING ( ele.eleprof.soundset1_s );
+	ELB_LONG ( ele.eleprof.spawnmax ); ELB_LONG ( ele.eleprof.spawndelay ); ELB_LONG ( ele.eleprof.spawnqty );
+	ELB_LONG ( ele.eleprof.hurtfall ); ELB_LONG ( ele.eleprof.castshadow ); ELB_LONG ( ele.eleprof.reducetexture );
+	ELB_LONG ( ele.eleprof.speed );
+	ELB_STRING ( ele.eleprof.hasweapon_s );
+	ELB_LONG ( ele.eleprof.lives ); ELB_LONG ( ele.spawn.max ); ELB_LONG ( ele.spawn.delay ); ELB_LONG ( ele.spawn.qty );
+	ELB_FLOAT ( ele.eleprof.scale ); ELB_FLOAT ( ele.eleprof.coneheight ); ELB_FLOAT ( ele.eleprof.coneangle );
+	ELB_LONG ( ele.eleprof.strength ); ELB_LONG ( ele.eleprof.isimmobile ); ELB_LONG ( ele.eleprof.cantakeweapon );
+	ELB_LONG ( ele.eleprof.quantity ); ELB_LONG ( ele.eleprof.markerindex );
+	ELB_COLOR ( ele.eleprof.light.color ); ELB_LONG ( ele.eleprof.light.range );
+	ELB_LONG ( ele.eleprof.trigger.stylecolor ); ELB_LONG ( ele.eleprof.trigger.waypointzoneindex );
+	ELB_LONG ( ele.eleprof.rateoffire ); ELB_LONG ( ele.eleprof.damage ); ELB_LONG ( ele.eleprof.accuracy );
+	ELB_LONG ( ele.eleprof.reloadqty ); ELB_LONG ( ele.eleprof.fireiterations ); ELB_LONG ( ele.eleprof.lifespan );
+	ELB_FLOAT ( ele.eleprof.throwspeed ); ELB_FLOAT ( ele.eleprof.throwangle );
+	ELB_LONG ( ele.eleprof.bounceqty ); ELB_LONG ( ele.eleprof.explodeonhit ); ELB_LONG ( ele.eleprof.weaponisammo );
+	ELB_LONG ( ele.eleprof.spawnupto ); ELB_LONG ( ele.eleprof.spawnafterdelay ); ELB_LONG ( ele.eleprof.spawnwhendead );
+	#ifdef PRODUCTCLASSIC
+	ELB_LONG ( ele.eleprof.spare1 );
+	#else
+	ELB_LONG ( ele.eleprof.perentityflags );
+	#endif
+	ELB_LONG ( ele.eleprof.physics ); ELB_LONG ( ele.eleprof.phyweight ); ELB_LONG ( ele.eleprof.phyfriction );
+	ELB_LONG ( ele.eleprof.phyforcedamage ); ELB_LONG ( ele.eleprof.rotatethrow ); ELB_LONG ( ele.eleprof.explodable );
+	ELB_LONG ( ele.eleprof.explodedamage ); ELB_LONG ( ele.eleprof.phyalways );
+	ELB_LONG ( ele.eleprof.spawndelayrandom ); ELB_LONG ( ele.eleprof.spawnqtyrandom ); ELB_LONG ( ele.eleprof.spawnvel );
+	ELB_LONG ( ele.eleprof.spawnvelrandom ); ELB_LONG ( ele.eleprof.spawnangle ); ELB_LONG ( ele.eleprof.spawnanglerandom );
+	ELB_LONG ( ele.eleprof.spawnatstart ); ELB_LONG ( ele.eleprof.spawnlife ); ELB_LONG ( ele.eleprof.light.index );
+	ELB_LONG ( ele.eleprof.particleoverride ); ELB_LONG ( ele.eleprof.particle.offsety ); ELB_LONG ( ele.eleprof.particle.scale );
+	ELB_LONG ( ele.eleprof.particle.randomstartx ); ELB_LONG ( ele.eleprof.particle.randomstarty ); ELB_LONG ( ele.eleprof.particle.randomstartz );
+	ELB_LONG ( ele.eleprof.particle.linearmotionx ); ELB_LONG ( ele.eleprof.particle.linearmotiony ); ELB_LONG ( ele.eleprof.particle.linearmotionz );
+	ELB_LONG ( ele.eleprof.particle.randommotionx ); ELB_LONG ( ele.eleprof.particle.randommotiony ); ELB_LONG ( ele.eleprof.particle.randommotionz );
+	ELB_LONG ( ele.eleprof.particle.mirrormode ); ELB_LONG ( ele.eleprof.particle.camerazshift ); ELB_LONG ( ele.eleprof.particle.scaleonlyx );
+	ELB_LONG ( ele.eleprof.particle.lifeincrement ); ELB_LONG ( ele.eleprof.particle.alphaintensity ); ELB_LONG ( ele.eleprof.particle.animated );
+	ELB_STRING ( ele.eleprof.aimainname_s );
+	ELB_LONG ( ele.eleprof.animspeed ); ELB_FLOAT ( ele.eleprof.conerange );
+	ELB_SCALE ( ele.scalex ); ELB_SCALE ( ele.scaley ); ELB_SCALE ( ele.scalez );
+	ELB_LONG ( ele.eleprof.range ); ELB_LONG ( ele.eleprof.dropoff );
+	ELB_LONG ( ele.eleprof.isviolent ); ELB_LONG ( ele.eleprof.teamfield ); ELB_LONG ( ele.eleprof.usespotlighting );
+	ELB_LONG ( ele.eleprof.lodmodifier );
+	ELB_LONG ( ele.eleprof.isocluder ); ELB_LONG ( ele.eleprof.isocludee ); ELB_LONG ( ele.eleprof.colondeath );
+	ELB_LONG ( ele.eleprof.parententityindex ); ELB_LONG ( ele.eleprof.parentlimbindex );
+	ELB_STRING ( ele.eleprof.soundset2_s ); ELB_STRING ( ele.eleprof.soundset3_s ); ELB_STRING ( ele.eleprof.soundset4_s );
+	ELB_FLOAT ( ele.eleprof.specularperc );
+	ELB_LONG ( ele.iHasParentIndex );
+	#ifdef VRTECH
+	ELB_STRING ( ele.eleprof.voiceset_s ); ELB_LONG ( ele.eleprof.voicerate );
+	#endif
+	#undef ELB_LONG
+	#undef ELB_FLOAT
+	#undef ELB_COLOR
+	#undef ELB_SCALE
+	#undef ELB_STRING
+}
+
+void entity_saveelementsbinary ( void )
+{
+	// write map.elb from the elements as they would read back from the map.ele beside it
+	cstr binaryfilename_s = entity_elementsbinaryfilename ( );
+	sEntityElementBinaryHeader header;
+	memset ( &header, 0, sizeof(header) );
+	if ( entity_elementsfilechecksum ( t.elementsfilename_s.Get(), &header.dwSourceSize, &header.dwSourceChecksum ) == false ) return;
+	FILETIME sourcetime;
+	DWORD dwStampSize = 0;
+	if ( entity_elementsfilestamp ( t.elementsfilename_s.Get(), &dwStampSize, &sourcetime ) == false ) return;
+	header.dwSourceTimeLow = sourcetime.dwLowDateTime;
+	header.dwSourceTimeHigh = sourcetime.dwHighDateTime;
+	header.dwMagic = ELEMENTBINARYMAGIC;
+	header.dwVersion = ELEMENTBINARYVERSION;
+	header.dwElementVersion = ENTITYELEMENTVERSION;
+	header.dwCount = g.entityelementlist;
+	header.dwRecordSize = sizeof(sEntityElementBinaryRecord);
+
+	std::vector<sEntityElementBinaryRecord> records ( g.entityelementlist );
+	std::vector<char> stringtable;
+	stringtable.reserve ( g.entityelementlist * 64 );
+	for ( int e = 1; e <= g.entityelementlist; e++ )
+	{
+		sEntityElementBinaryRecord* pRecord = &records[e-1];
+		memset ( pRecord, 0, sizeof(sEntityElementBinaryRecord) );
+		entity_transferelementbinary ( e, pRecord, true, &stringtable, NULL, 0 );
+	}
+	header.dwStringTableSize = (DWORD)stringtable.size();
+
+	HANDLE hFile = GG_CreateFile ( binaryfilename_s.Get(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE ) return;
+	DWORD dwWritten = 0;
+	bool bOK = WriteFile ( hFile, &header, sizeof(header), &dwWritten, NULL ) != 0;
+	if ( bOK && records.size() > 0 ) bOK = WriteFile ( hFile, &records[0], (DWORD)(records.size() * sizeof(sEntityElementBinaryRecord)), &dwWritten, NULL ) != 0;
+	if ( bOK && stringtable.size() > 0 ) bOK = WriteFile ( hFile, &stringtable[0], (DWORD)stringtable.size(), &dwWritten, NULL ) != 0;
+	CloseHandle ( hFile );
+
+	// a partial file must never be trusted
+	if ( bOK == false ) DeleteAFile ( binaryfilename_s.Get() );
+}
+
+int entity_loadelementsbinary ( void )
+{
+	// returns 1 if map.elb was current and the elements were taken from it
+	if ( t.elementsfilename_s == "" ) t.elementsfilename_s = g.mysystem.levelBankTestMap_s+"map.ele";
+	t.versionnumbersupported = ENTITYELEMENTVERSION;
+	cstr binaryfilename_s = entity_elementsbinaryfilename ( );
+	if ( FileExist(t.elementsfilename_s.Get()) == 0 || FileExist(binaryfilename_s.Get()) == 0 ) return 0;
+
+	// must have been made from this exact map.ele, size and write time are checked first
+	DWORD dwSourceSize = 0;
+	FILETIME sourcetime;
+	if ( entity_elementsfilestamp ( t.elementsfilename_s.Get(), &dwSourceSize, &sourcetime ) == false ) return 0;
+
+	HANDLE hFile = GG_CreateFile ( binaryfilename_s.Get(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE ) return 0;
+	DWORD dwFileSize = GetFileSize ( hFile, NULL );
+	HANDLE hMap = NULL;
+	LPBYTE pData = NULL;
+	if ( dwFileSize >= sizeof(sEntityElementBinaryHeader) )
+	{
+		hMap = CreateFileMapping ( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+		if ( hMap ) pData = (LPBYTE)MapViewOfFile ( hMap, FILE_MAP_READ, 0, 0, 0 );
+	}
+	bool bValid = false;
+	bool bRestamp = false;
+	sEntityElementBinaryHeader* pHeader = (sEntityElementBinaryHeader*)pData;
+	if ( pHeader )
+	{
+		unsigned __int64 iExpectedSize = sizeof(sEntityElementBinaryHeader) + ((unsigned __int64)pHeader->dwCount * sizeof(sEntityElementBinaryRecord)) + pHeader->dwStringTableSize;
+		if ( pHeader->dwMagic == ELEMENTBINARYMAGIC && pHeader->dwVersion == ELEMENTBINARYVERSION
+		&&   pHeader->dwElementVersion == (DWORD)t.versionnumbersupported && pHeader->dwRecordSize == sizeof(sEntityElementBinaryRecord)
+		&&   pHeader->dwSourceSize == dwSourceSize
+		&&   iExpectedSize == dwFileSize )
+		{
+			// string table must end in a terminator so no string can run off the end
+			bValid = pHeader->dwStringTableSize == 0 || pData[dwFileSize-1] == 0;
+		}
+		if ( bValid == true && ( pHeader->dwSourceTimeLow != sourcetime.dwLowDateTime || pHeader->dwSourceTimeHigh != sourcetime.dwHighDateTime ) )
+		{
+			// map.ele was touched (copied, or extracted from an fpm), only now read it all to see if the content changed
+			DWORD dwChecksumSize = 0, dwSourceChecksum = 0;
+			if ( entity_elementsfilechecksum ( t.elementsfilename_s.Get(), &dwChecksumSize, &dwSourceChecksum ) == false || pHeader->dwSourceChecksum != dwSourceChecksum )
+				bValid = false;
+			else
+				bRestamp = true;
+		}
+	}
+	if ( bValid == false )
+	{
+		if ( pData ) UnmapViewOfFile ( pData );
+		if ( hMap ) CloseHandle ( hMap );
+		CloseHandle ( hFile );
+		return 0;
+	}
+
+	//  Free any old elements
+	entity_deleteelementsdata ( );
+	t.failedtoload = 0;
+	t.versionnumberload = pHeader->dwElementVersion;
+	g.entityelementlist = pHeader->dwCount;
+
+	sEntityElementBinaryRecord* pRecords = (sEntityElementBinaryRecord*)(pData + sizeof(sEntityElementBinaryHeader));
+	const char* pStrings = (const char*)(pRecords + pHeader->dwCount);
+	if ( g.entityelementlist > 0 )
+	{
+		UnDim ( t.entityelement );
+		#ifdef VRTECH
+		UnDim2 ( t.entityshadervar );
+		UnDim ( t.entitydebug_s );
+		#endif
+		g.entityelementmax = g.entityelementlist;
+		Dim ( t.entityelement, g.entityelementmax );
+		#ifdef VRTECH
+		Dim2 ( t.entityshadervar, g.entityelementmax, g.globalselectedshadermax );
+		Dim ( t.entitydebug_s, g.entityelementmax );
+		#endif
+		for ( t.e = 1 ; t.e <= g.entityelementlist; t.e++ )
+		{
+			#ifdef VRTECH
+			if ( t.game.runasmultiplayer == 1 ) mp_refresh ( );
+			#endif
+			entity_transferelementbinary ( t.e, &pRecords[t.e-1], false, NULL, pStrings, pHeader->dwStringTableSize );
+
+			// same per element steps as a map.ele load of the current version
+			t.entityelement[t.e].eleprof.aimainname_lower_s = t.entityelement[t.e].eleprof.aimainname_s.Lower();
+			t.ttentid = t.entityelement[t.e].bankindex;
+			if ( t.ttentid >= t.entityprofile.size() )
+			{
+				t.ttentid = 0;
+				t.entityelement[t.e].bankindex = 0;
+				#ifndef VRTECH
+				t.entityelement[t.e].entitydammult_f = 1.0;
+				t.entityelement[t.e].entityacc = 1.0;
+				#endif
+				continue;
+			}
+			t.entityelement[t.e].entitydammult_f = 1.0;
+			t.entityelement[t.e].entityacc = 1.0;
+			t.entityelement[t.e].eleprof.transparency = t.entityprofile[t.ttentid].transparency;
+		}
+	}
+	UnmapViewOfFile ( pData );
+	CloseHandle ( hMap );
+	CloseHandle ( hFile );
+
+	// same content under a new write time, record it so the next load skips the checksum
+	if ( bRestamp == true )
+	{
+		hFile = GG_CreateFile ( binaryfilename_s.Get(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+		if ( hFile != INVALID_HANDLE_VALUE )
+		{
+			DWORD dwStamp[2] = { sourcetime.dwLowDateTime, sourcetime.dwHighDateTime };
+			DWORD dwWritten = 0;
+			SetFilePointer ( hFile, offsetof(sEntityElementBinaryHeader, dwSourceTimeLow), NULL, FILE_BEGIN );
+			WriteFile ( hFile, dwStamp, sizeof(dwStamp), &dwWritten, NULL );
+			CloseHandle ( hFile );
+		}
+	}
+
+	//  parental control, replacements and invalid profiles
+	entity_loadelementsdata_finish ( );
+	return 1;
 }
 
 void entity_savebank ( void )
@@ -5834,6 +6069,9 @@ void entity_deleteelementsdata ( void )
 
 void entity_deleteelements ( void )
 {
+	//  LOD manager only tracks element objects
+	if ( g_pLODManager ) g_pLODManager->clear();
+
 	//  Quick deletes
 	if ( g.entityelementlist > 0 ) 
 	{
@@ -6144,6 +6382,9 @@ void entity_deleteentityfrommap ( void )
 		lighting_refresh ( );
 	}
 
+	// the object is about to go, so stop choosing a LOD level for it
+	if ( g_pLODManager ) g_pLODManager->removeObject ( t.entityelement[t.tupdatee].obj );
+
 	// update real ent obj (.obj=0 inside)
 	entity_updateentityobj ( );
 }
@@ -93,6 +93,11 @@ void gameexecutable_finish(void)
 		delete g_pDynamicResolution;
 		g_pDynamicResolution = NULL;
 	}
+	if (g_pLODManager)
+	{
+		delete g_pLODManager;
+		g_pLODManager = NULL;
+	}
 	if (g_pVoxelizer)
 	{
 		delete g_pVoxelizer;
@@ -3087,6 +3092,8 @@ void game_preparelevel_finally ( void )
 		// 110416 - commented out again, turns out when occluder in THREAD is flagged to end, it clears the occluder list
 		//CPU3DClear(); // 260316 - dont know why the clear was commented out, it is ESSENTIAL to ensure levels dont mess each other up
 		CPU3DSetCameraIndex (  0 );
+		//  occlusionmode only selects the occlusion rasterizer, not the legacy render list
+		CPU3DSetRasterizer ( 1 );
 		//  Occlusion poly list can have a variable size to help performance
 		CPU3DSetPolyCount ( t.visuals.occlusionvalue );
 		//  Add terrain LOD1s as occluders
@@ -3742,6 +3749,9 @@ extern int NumberOfObjectsShown;
 
 void game_main_loop ( void )
 {	
+	//  Task payloads from the previous frame are no longer referenced
+	if ( g_pThreadPool ) g_pThreadPool->frame_reset ( );
+
 	//  Timer (  based movement )
 	if ( g.gproducelogfiles == 2 ) timestampactivity(0,"calling game_timeelapsed");
 	game_timeelapsed ( );
@@ -4087,6 +4097,9 @@ void game_main_loop ( void )
 			t.ttempoverallaiperftimerstamp=PerformanceTimer();
 			if (  t.hardwareinfoglobals.noai == 0 ) 
 			{
+				// rays queued with IntersectAllBatchSubmit last frame, results ready for this frames logic
+				IntersectAllBatchFlush ( );
+
 				// LUA and Entity Logic
 				lua_loop ( );
 				t.game.perf.ai1 += PerformanceTimer()-g.gameperftimestamp ; g.gameperftimestamp=PerformanceTimer();
@@ -4384,8 +4397,7 @@ void game_main_loop ( void )
 				{
 					for (int x = 0; x < 128; ++x)
 					{
-						int index = x + y * 128 + z * 128 * 128;
-						if (g_pVoxelizer->getVoxelData()[index] == 1)
+						if (g_pVoxelizer->isOccupied(x, y, z))
 						{
 							SetPixel(x, y + z * 128, Rgb(255, 255, 255));
 						}
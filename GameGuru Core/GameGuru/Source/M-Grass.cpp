@@ -547,6 +547,9 @@ void grass_editcontrol(void)
 		//	terrain_recordbuffer ( );
 		//}
 
+		// grass strokes only go into the terrain undo history, the single buffer never held them
+		if ( t.mc != 0 && terrain_undohistoryactive() ) terrain_recordbuffer ( );
+
 		// Paint grass
 		//if ( t.terrain.terrainpaintermode >= 6 && t.terrain.terrainpaintermode <= 10 ) 
 		if (t.terrain.terrainpaintermode == 10)
@@ -603,6 +606,11 @@ void grass_editcontrol(void)
 
 		// allows second sculpt/paint to erase first undo buffer
 		//if ( t.mc == 0  )  t.terrainundo.mode = 0;
+		if ( t.mc == 0 && terrain_undohistoryactive() )
+		{
+			t.terrainundo.mode = 0;
+			terrain_endundostep ( );
+		}
 	}
 }
 
@@ -13,6 +13,8 @@
 #ifdef VRTECH
 //Windows Mixed Reality Support
 #include "GGVR.h"
+#include "threading_utils.h"
+#include "cThreadPool.h"
 #endif
 
 #ifdef ENABLEIMGUI
@@ -931,6 +933,9 @@ void gridedit_setsmartobjectvisibilityinrubberband(bool bVisible)
 
 void mapeditorexecutable_loop(void)
 {
+	// editor frames free task payloads too, the game loop does its own
+	if ( g_pThreadPool ) g_pThreadPool->frame_reset ( );
+
 	#ifdef ENABLEIMGUI
 	bSmallVideoFrameStart = true;
 	// special modes used when in test game or standalone game
@@ -14512,6 +14517,15 @@ void editor_undo ( void )
 			editor_undoredoprojectstate ( );
 			t.entityundo.undoperformed=1;
 		}
+		else
+		{
+			// terrain undo history can keep stepping back
+			if ( terrain_canundo ( ) )
+			{
+				terrain_undo ( );
+				editor_undoredoprojectstate ( );
+			}
+		}
 	}
 }
 
@@ -14531,6 +14545,14 @@ void editor_redo ( void )
 			editor_undoredoprojectstate ( );
 			t.entityundo.undoperformed=0;
 		}
+		else
+		{
+			if ( terrain_canredo ( ) )
+			{
+				terrain_redo ( );
+				editor_undoredoprojectstate ( );
+			}
+		}
 	}
 }
 
@@ -16858,6 +16880,7 @@ void gridedit_new_map ( void )
 	t.entityundo.undoperformed=0;
 	t.terrainundo.bufferfilled=0;
 	t.terrainundo.mode=0;
+	terrain_clearundohistory ( );
 
 
 	//  Finished new map
@@ -17027,6 +17050,7 @@ void gridedit_new_map_quick(void)
 	t.entityundo.undoperformed = 0;
 	t.terrainundo.bufferfilled = 0;
 	t.terrainundo.mode = 0;
+	terrain_clearundohistory ( );
 
 
 	//  Finished new map
@@ -135,6 +135,9 @@ void entity_lua_collisionoff ( void )
 	}
 }
 
+// sight ray of each element queued for the next ray batch flush, -1 before the first
+std::vector<int> g_EntityPlrVisibleTicket;
+
 void entity_lua_getentityplrvisible ( void )
 {
 	t.tobj=t.entityelement[t.e].obj;
@@ -155,44 +158,54 @@ void entity_lua_getentityplrvisible ( void )
 				t.ty2_f=t.ty2_f+ObjectSizeY(t.tsrcobj,1)*0.5;
 			}
 
+			// the sight ray, with the static and lightmapped objects as its second range
+			sRayBatchQuery query;
+			query.fX = t.tx1_f; query.fY = t.ty1_f; query.fZ = t.tz1_f;
+			query.fNewX = t.tx2_f; query.fNewY = t.ty2_f; query.fNewZ = t.tz2_f;
+			query.iStart = g.entityviewstartobj;
+			query.iEnd = g.entityviewendobj;
 			if (g.lightmappedobjectoffset >= g.lightmappedobjectoffsetfinish)
-				t.ttt = IntersectAll(87000, 87000 + g.merged_new_objects - 1, 0, 0, 0, 0, 0, 0, -123);
+			{
+				query.iSecondStart = 87000;
+				query.iSecondEnd = 87000 + g.merged_new_objects - 1;
+			}
 			else
-				t.ttt=IntersectAll(g.lightmappedobjectoffset,g.lightmappedobjectoffsetfinish,t.tx1_f,t.ty1_f,t.tz1_f,0,0,0,-123);
-
+			{
+				query.iSecondStart = g.lightmappedobjectoffset;
+				query.iSecondEnd = g.lightmappedobjectoffsetfinish;
+			}
+			query.iThirdStart = 0;
+			query.iThirdEnd = 0;
+			query.iIgnoreObjNo = t.tobj;
+			query.iIgnoreSecondObjNo = 0;
+			query.dwFlags = 0;
 
 			//PE: door.lua , we are hitting t.entityelement[t.playercontrol.thirdperson.charactere].obj
 			//PE: Disable t.entityelement[t.playercontrol.thirdperson.charactere].obj from check.
 			//https://github.com/TheGameCreators/GameGuruRepo/issues/619
-
-			bool reneableThirdperson = false;
-			sObject* pObjectThirdperson = NULL;
 			if (t.playercontrol.thirdperson.enabled == 1)
 			{
-				//Hide TPP or we will hit it.
-				int thirdpersonObj = t.entityelement[t.playercontrol.thirdperson.charactere].obj;
-				if (thirdpersonObj > 0)
-				{
-					pObjectThirdperson = g_ObjectList[thirdpersonObj];
-					if (pObjectThirdperson->bVisible)
-					{
-						pObjectThirdperson->bVisible = false;
-						reneableThirdperson = true;
-					}
-				}
+				query.iIgnoreSecondObjNo = t.entityelement[t.playercontrol.thirdperson.charactere].obj;
 			}
 
-			if ( IntersectAll(g.entityviewstartobj,g.entityviewendobj,t.tx1_f,t.ty1_f,t.tz1_f,t.tx2_f,t.ty2_f,t.tz2_f,t.tobj) > 0 )
+			// scripts asking every frame are answered by the ray batched last frame, the first
+			// ask and any that missed the last flush are tested now, then the next is queued
+			if ( (int)g_EntityPlrVisibleTicket.size() <= t.e ) g_EntityPlrVisibleTicket.resize ( t.e+1, -1 );
+			int& iTicket = g_EntityPlrVisibleTicket[t.e];
+			if ( iTicket < 0 || IntersectAllBatchPending ( iTicket ) == false )
 			{
- 					t.entityelement[t.e].plrvisible=0;
-			}
-			else
-			{
-				t.entityelement[t.e].plrvisible=1;
-			}
-
-			if (reneableThirdperson && pObjectThirdperson) {
-				pObjectThirdperson->bVisible = true;
+				sRayBatchResult result;
+				if ( iTicket < 0 || IntersectAllBatchResult ( iTicket, &result ) == false )
+					IntersectAllBatch ( &query, 1, &result );
+				if ( result.iHitObj > 0 )
+				{
+					t.entityelement[t.e].plrvisible=0;
+				}
+				else
+				{
+					t.entityelement[t.e].plrvisible=1;
+				}
+				iTicket = IntersectAllBatchSubmit ( &query );
 			}
 
 			t.entityelement[t.e].lua.flagschanged=1;
@@ -6,6 +6,12 @@
 #include "stdafx.h"
 #include "gameguru.h"
 #include "Common-Keys.h"
+#include "cThreadPool.h"
+#include "threading_utils.h"
+#include "sha1.h"
+#include <map>
+#include <unordered_map>
+#include "..\..\Dark Basic Public Shared\Dark Basic Pro SDK\Shared\Core\SteamCheckForWorkshop.h"
 
 #ifdef ENABLEIMGUI
 #include "..\Imgui\imgui.h"
@@ -29,6 +35,7 @@ std::vector<cstr> g_mapfile_fppFilesToRemoveList;
 cstr g_mapfile_mapbankpath;
 cstr g_mapfile_levelpathfolder;
 bool g_bAllowBackwardCompatibleConversion = false;
+bool g_bStandaloneManifestActive = false;
 
 #ifdef ENABLEIMGUI
 bool restore_old_map = false;
@@ -510,6 +517,8 @@ void mapfile_saveproject_fpm ( void )
 	AddFileToBlock (  1, "cfg.cfg" );
 	// entity and waypoint files
 	AddFileToBlock (  1, "map.ele" );
+	if ( FileExist ( "map.elb" ) == 1 ) 
+		AddFileToBlock ( 1, "map.elb" );
 	AddFileToBlock (  1, "map.ent" );
 	AddFileToBlock (  1, "map.way" );
 	// darkai obstacle data (container zero)
@@ -1982,6 +1991,9 @@ void mapfile_savestandalone_start ( void )
 	g_mapfile_fppFoldersToRemoveList.clear();
 	g_mapfile_fppFilesToRemoveList.clear();
 
+	// what the last build of this standalone copied and scanned
+	mapfile_savestandalone_loadmanifest();
+
 	// process in stages
 	g_mapfile_iStage = 1;
 	g_mapfile_fProgress = 0.0f;
@@ -2156,6 +2168,9 @@ int mapfile_savestandalone_stage2b ( void )
 		addtocollection("skybank\\cloudportal.dds");
 		addfoldertocollection(cstr(cstr("vegbank\\")+g.vegstyle_s).Get() );
 
+		// read ahead the files the entity scan parses
+		mapfile_savestandalone_prefetchscans();
+
 		// start for loop
 		t.e = 1;
 		g_mapfile_fProgressSpan = g_mapfile_iNumberOfEntitiesAcrossAllLevels;
@@ -2404,29 +2419,12 @@ int mapfile_savestandalone_stage2c ( void )
 			// also include textures specified by textureref entries (from importer export)
 			cstr tFPEFilePath = g.fpscrootdir_s+"\\Files\\";
 			tFPEFilePath += t.tentityname1_s;
-			FILE* tFPEFile = GG_fopen ( tFPEFilePath.Get() , "r" );
-			if ( tFPEFile )
+			std::vector<std::string> texturerefs;
+			collectionscan_refs ( 'f', tFPEFilePath.Get(), texturerefs );
+			for ( size_t n = 0; n < texturerefs.size(); n++ )
 			{
-				char tTempLine[2048];
-				while ( !feof(tFPEFile) )
-				{
-					fgets ( tTempLine , 2047 , tFPEFile );
-					if ( strstr ( tTempLine , "textureref" ) )
-					{
-						char* pToFilename = strstr ( tTempLine , "=" );
-						if ( pToFilename )
-						{
-							while ( *pToFilename == '=' || *pToFilename == 32 ) pToFilename++;
-							if ( pToFilename[strlen(pToFilename)-1] == 13 ) pToFilename[strlen(pToFilename)-1] = 0;
-							if ( pToFilename[strlen(pToFilename)-1] == 10 ) pToFilename[strlen(pToFilename)-1] = 0;
-							if ( pToFilename[strlen(pToFilename)-1] == 13 ) pToFilename[strlen(pToFilename)-1] = 0;
-							if ( pToFilename[strlen(pToFilename)-1] == 10 ) pToFilename[strlen(pToFilename)-1] = 0;
-							cstr tTextureFile = cstr( t.tentityfolder_s + cstr(pToFilename) );
-							addtocollection ( tTextureFile.Get() );
-						}
-					}
-				}
-				fclose ( tFPEFile );
+				cstr tTextureFile = cstr( t.tentityfolder_s + cstr(texturerefs[n].c_str()) );
+				addtocollection ( tTextureFile.Get() );
 			}
 
 			//  shader file
@@ -2701,21 +2699,9 @@ void mapfile_savestandalone_stage4 ( void )
 	// restore dir before proceeding
 	SetDir(t.told_s.Get());
 
-	//  CopyAFile (  collection to exe folder )
+	//  CopyAFile (  collection to exe folder ), only what changed since the last build
 	t.filesmax = g.filecollectionmax;
-	for ( t.fileindex = 1 ; t.fileindex <= t.filesmax; t.fileindex++ )
-	{
-		t.src_s=t.filecollection_s[t.fileindex];
-		char pRealSrc[MAX_PATH];
-		strcpy(pRealSrc, t.src_s.Get());
-		GG_GetRealPath(pRealSrc, 0);
-		if ( FileExist(pRealSrc) == 1 ) 
-		{
-			t.dest_s = t.exepath_s+t.exename_s+"\\Files\\"+t.src_s;
-			if ( FileExist(t.dest_s.Get()) == 1 ) DeleteAFile ( t.dest_s.Get() );
-			CopyAFile ( pRealSrc, t.dest_s.Get() );
-		}
-	}
+	mapfile_savestandalone_copycollection();
 
 	// switch to original root to copy exe files and dependencies
 	SetDir ( g.originalrootdir_s.Get() );
@@ -2791,6 +2777,11 @@ void mapfile_savestandalone_stage4 ( void )
 	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "smoothcamerakeys="+Str(g.globals.smoothcamerakeys) ; ++t.i;
 	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "occlusionmode="+Str(g.globals.occlusionmode) ; ++t.i;
 	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "occlusionsize="+Str(g.globals.occlusionsize) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "batchedparticles="+Str(g.globals.batchedparticles) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "mappedobjectloading="+Str(g.globals.mappedobjectloading) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "animationposecache="+Str(g.globals.animationposecache) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "animationposequantum="+Str(g.globals.animationposequantum) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "animationclips="+Str(g.globals.animationclips) ; ++t.i;
 	if ( g.vrqcontrolmode != 0 )
 	{
 		t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "hidelowfpswarning=1" ; ++t.i;
@@ -3067,6 +3058,9 @@ void mapfile_savestandalone_finish ( void )
 		}
 	}
 
+	// record the finished output so the next build can skip what has not changed
+	mapfile_savestandalone_savemanifest();
+
 	//  if not tignorelevelbankfiles, copy unencrypted files
 	if (  t.tignorelevelbankfiles == 0 ) 
 	{
@@ -3150,6 +3144,8 @@ void mapfile_savestandalone_restoreandclose ( void )
 
 	// no longer making standalone
 	t.levelsforstandalone = 0;
+	g_bStandaloneManifestActive = false;
+	mapfile_savestandalone_endscans();
 }
 #else
 void mapfile_savestandalone_start ( void )
@@ -3377,6 +3373,9 @@ void mapfile_savestandalone_start ( void )
 	g_mapfile_fppFoldersToRemoveList.clear();
 	g_mapfile_fppFilesToRemoveList.clear();
 
+	// what the last build of this standalone copied and scanned
+	mapfile_savestandalone_loadmanifest();
+
 	// process in stages
 	g_mapfile_iStage = 1;
 	g_mapfile_fProgress = 0.0f;
@@ -3552,6 +3551,9 @@ int mapfile_savestandalone_stage2b ( void )
 		//add lutbank
 		addfoldertocollection("lutbank\\");
 
+		// read ahead the files the entity scan parses
+		mapfile_savestandalone_prefetchscans();
+
 		// start for loop
 		t.e = 1;
 		#ifdef ENABLEIMGUI
@@ -3831,29 +3833,12 @@ int mapfile_savestandalone_stage2c ( void )
 			// also include textures specified by textureref entries (from importer export)
 			cstr tFPEFilePath = g.fpscrootdir_s+"\\Files\\";
 			tFPEFilePath += t.tentityname1_s;
-			FILE* tFPEFile = GG_fopen ( tFPEFilePath.Get() , "r" );
-			if ( tFPEFile )
+			std::vector<std::string> texturerefs;
+			collectionscan_refs ( 'f', tFPEFilePath.Get(), texturerefs );
+			for ( size_t n = 0; n < texturerefs.size(); n++ )
 			{
-				char tTempLine[2048];
-				while ( !feof(tFPEFile) )
-				{
-					fgets ( tTempLine , 2047 , tFPEFile );
-					if ( strstr ( tTempLine , "textureref" ) )
-					{
-						char* pToFilename = strstr ( tTempLine , "=" );
-						if ( pToFilename )
-						{
-							while ( *pToFilename == '=' || *pToFilename == 32 ) pToFilename++;
-							if ( pToFilename[strlen(pToFilename)-1] == 13 ) pToFilename[strlen(pToFilename)-1] = 0;
-							if ( pToFilename[strlen(pToFilename)-1] == 10 ) pToFilename[strlen(pToFilename)-1] = 0;
-							if ( pToFilename[strlen(pToFilename)-1] == 13 ) pToFilename[strlen(pToFilename)-1] = 0;
-							if ( pToFilename[strlen(pToFilename)-1] == 10 ) pToFilename[strlen(pToFilename)-1] = 0;
-							cstr tTextureFile = cstr( t.tentityfolder_s + cstr(pToFilename) );
-							addtocollection ( tTextureFile.Get() );
-						}
-					}
-				}
-				fclose ( tFPEFile );
+				cstr tTextureFile = cstr( t.tentityfolder_s + cstr(texturerefs[n].c_str()) );
+				addtocollection ( tTextureFile.Get() );
 			}
 
 			//  shader file
@@ -4112,17 +4097,8 @@ void mapfile_savestandalone_stage4 ( void )
 	// prompt
 	//popup_text_change("Saving Standalone Game : Copying Files");
 
-	//  CopyAFile (  collection to exe folder )
-	for ( t.fileindex = 1 ; t.fileindex<=  t.filesmax; t.fileindex++ )
-	{
-		t.src_s=t.filecollection_s[t.fileindex];
-		if (  FileExist(t.src_s.Get()) == 1 ) 
-		{
-			t.dest_s=t.exepath_s+t.exename_s+"\\Files\\"+t.src_s;
-			if (  FileExist(t.dest_s.Get()) == 1  )  DeleteAFile (  t.dest_s.Get() );
-			CopyAFile (  t.src_s.Get(),t.dest_s.Get() );
-		}
-	}
+	//  CopyAFile (  collection to exe folder ), only what changed since the last build
+	mapfile_savestandalone_copycollection();
 
 	// switch to original root to copy exe files and dependencies
 	SetDir ( g.originalrootdir_s.Get() );
@@ -4178,6 +4154,11 @@ void mapfile_savestandalone_stage4 ( void )
 	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "smoothcamerakeys="+Str(g.globals.smoothcamerakeys) ; ++t.i;
 	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "occlusionmode="+Str(g.globals.occlusionmode) ; ++t.i;
 	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "occlusionsize="+Str(g.globals.occlusionsize) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "batchedparticles="+Str(g.globals.batchedparticles) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "mappedobjectloading="+Str(g.globals.mappedobjectloading) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "animationposecache="+Str(g.globals.animationposecache) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "animationposequantum="+Str(g.globals.animationposequantum) ; ++t.i;
+	t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "animationclips="+Str(g.globals.animationclips) ; ++t.i;
 	if ( g.vrqcontrolmode != 0 )
 	{
 		t.setuparr_s[t.i] = ""; t.setuparr_s[t.i] = t.setuparr_s[t.i] + "hidelowfpswarning=1" ; ++t.i;
@@ -4464,6 +4445,9 @@ void mapfile_savestandalone_finish ( void )
 		}
 	}
 
+	// record the finished output so the next build can skip what has not changed
+	mapfile_savestandalone_savemanifest();
+
 	//  if not tignorelevelbankfiles, copy unencrypted files
 	if (  t.tignorelevelbankfiles == 0 ) 
 	{
@@ -4546,148 +4530,671 @@ void mapfile_savestandalone_restoreandclose ( void )
 
 	// no longer making standalone
 	t.levelsforstandalone = 0;
+	g_bStandaloneManifestActive = false;
+	mapfile_savestandalone_endscans();
 }
 #endif
 
-void scanscriptfileandaddtocollection ( char* tfile_s )
+//
+// Standalone build manifest, remembers what each collected file looked like when it
+// was last copied and what each script or model scan found, so the next build of the
+// same standalone only rescans and recopies what has changed
+//
+
+struct sStandaloneFileState
 {
-	cstr tscriptname_s =  "";
-	cstr tlinethis_s =  "";
-	int lookforlen = 0;
-	cstr lookfor_s =  "";
-	int lookforlen2 = 0;
-	cstr lookfor2_s = "";
-	cstr lookfor3_s = "";
-	cstr tline_s =  "";
-	int l = 0;
-	int c = 0;
-	int tt = 0;
-	std::vector <cstr> scriptpage_s; //Allow us to run recursively
-	Dim (  scriptpage_s,10000  );
-	if (  FileExist(tfile_s) == 1 ) 
-	{
-		LoadArray (  tfile_s,scriptpage_s );
+	unsigned long long size;
+	unsigned long long mtime;
+	unsigned int sha1[5];
+};
+
+struct sStandaloneCopiedFile
+{
+	sStandaloneFileState source;
+	unsigned long long outputsize;		// the file the standalone holds for it, after any encryption
+	unsigned long long outputmtime;
+	bool bInThisBuild;
+};
+
+struct sStandaloneScannedFile
+{
+	sStandaloneFileState source;
+	std::vector<std::string> deps;
+};
+
+cstr g_standaloneManifestFile_s = "";
+cstr g_standaloneManifestOutput_s = "";
+cstr g_standaloneManifestMode_s = "";
+std::map<std::string,sStandaloneCopiedFile> g_standaloneCopied;
+std::map<std::string,sStandaloneScannedFile> g_standaloneScanned;
+std::vector<std::string>* g_pStandaloneRecordDeps = NULL;
+
+static bool standalonemanifest_statfile ( LPSTR pRealFile, unsigned long long* pSize, unsigned long long* pMTime )
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if ( GetFileAttributesExA ( pRealFile, GetFileExInfoStandard, &data ) == 0 ) return false;
+	if ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) return false;
+	*pSize = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	*pMTime = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+static bool standalonemanifest_hashfile ( LPSTR pRealFile, unsigned int* pDigest )
+{
+	FILE* pFile = fopen ( pRealFile, "rb" );
+	if ( pFile == NULL ) return false;
+	SHA1 sha;
+	std::vector<unsigned char> buffer ( 65536 );
+	size_t iRead;
+	while ( (iRead = fread ( buffer.data(), 1, buffer.size(), pFile )) > 0 )
+		sha.Input ( buffer.data(), (unsigned)iRead );
+	fclose ( pFile );
+	return sha.Result ( pDigest );
+}
+
+// true if the file still matches the recorded state, a changed time with the same
+// size is settled by the SHA-1 so files that were only touched are not redone
+static bool standalonemanifest_unchanged ( LPSTR pRealFile, sStandaloneFileState& recorded )
+{
+	unsigned long long size, mtime;
+	if ( standalonemanifest_statfile ( pRealFile, &size, &mtime ) == false ) return false;
+	if ( size != recorded.size ) return false;
+	if ( mtime == recorded.mtime ) return true;
+	unsigned int digest[5];
+	if ( standalonemanifest_hashfile ( pRealFile, digest ) == false ) return false;
+	if ( memcmp ( digest, recorded.sha1, sizeof(digest) ) != 0 ) return false;
+	recorded.mtime = mtime;
+	return true;
+}
+
+static bool standalonemanifest_readstate ( LPSTR pRealFile, sStandaloneFileState& state )
+{
+	if ( standalonemanifest_statfile ( pRealFile, &state.size, &state.mtime ) == false ) return false;
+	return standalonemanifest_hashfile ( pRealFile, state.sha1 );
+}
+
+static void standalonemanifest_outputfile ( LPSTR pDest, LPSTR pOutput )
+{
+	// encryption replaces name.ext with _e_name.ext in the same folder
+	strcpy ( pOutput, pDest );
+	if ( GetFileAttributesA ( pOutput ) != INVALID_FILE_ATTRIBUTES ) return;
+	LPSTR pName = strrchr ( pDest, '\\' );
+	pName = pName ? pName + 1 : pDest;
+	strcpy ( pOutput + (pName - pDest), "_e_" );
+	strcat ( pOutput, pName );
+}
 
-		lookfor_s=Lower("Include(") ; lookforlen=Len(lookfor_s.Get());
-		lookfor2_s = Lower("require \""); lookforlen2 = Len(lookfor2_s.Get());
-		lookfor3_s = Lower("Include (");
+void mapfile_savestandalone_loadmanifest ( void )
+{
+	// one manifest per standalone, kept with the user files rather than shipped with the game
+	g_standaloneCopied.clear();
+	g_standaloneScanned.clear();
+	g_pStandaloneRecordDeps = NULL;
+	// encrypted and plain builds leave different files behind, so the mode is part of the output
+	g_standaloneManifestOutput_s = Lower ( cstr(t.exepath_s+t.exename_s).Get() );
+	g_standaloneManifestMode_s = cstr(Str(g.gexportassets));
+	g_standaloneManifestFile_s = g.myownrootdir_s + "\\" + t.exename_s + "-standalone.manifest";
+	g_bStandaloneManifestActive = true;
+
+	FILE* pFile = fopen ( g_standaloneManifestFile_s.Get(), "r" );
+	if ( pFile == NULL ) return;
+	char pLine[2048];
+	bool bValid = false;
+	if ( fgets ( pLine, sizeof(pLine), pFile ) && strncmp ( pLine, "GGSTANDALONEMANIFEST 1", 22 ) == NULL )
+	{
+		// a manifest written for another output folder is of no use
+		if ( fgets ( pLine, sizeof(pLine), pFile ) )
+		{
+			pLine[strcspn(pLine, "\r\n")] = 0;
+			cstr expected_s = cstr("output\t") + g_standaloneManifestOutput_s + "\t" + g_standaloneManifestMode_s;
+			bValid = stricmp ( pLine, expected_s.Get() ) == NULL;
+		}
+	}
+	sStandaloneScannedFile* pScan = NULL;
+	while ( bValid && fgets ( pLine, sizeof(pLine), pFile ) )
+	{
+		pLine[strcspn(pLine, "\r\n")] = 0;
+		LPSTR pFields[8];
+		int iFields = 0;
+		for ( LPSTR pField = strtok ( pLine, "\t" ); pField && iFields < 8; pField = strtok ( NULL, "\t" ) )
+			pFields[iFields++] = pField;
+		if ( iFields < 2 ) continue;
 
-		for ( l = 0 ; l < scriptpage_s.size() ; l++ )
+		sStandaloneFileState state;
+		memset ( &state, 0, sizeof(state) );
+		if ( iFields >= 5 )
+		{
+			state.size = _strtoui64 ( pFields[2], NULL, 16 );
+			state.mtime = _strtoui64 ( pFields[3], NULL, 16 );
+			sscanf ( pFields[4], "%08x%08x%08x%08x%08x", &state.sha1[0], &state.sha1[1], &state.sha1[2], &state.sha1[3], &state.sha1[4] );
+		}
+		if ( strcmp ( pFields[0], "copy" ) == NULL && iFields == 7 )
+		{
+			sStandaloneCopiedFile& copied = g_standaloneCopied[pFields[1]];
+			copied.source = state;
+			copied.outputsize = _strtoui64 ( pFields[5], NULL, 16 );
+			copied.outputmtime = _strtoui64 ( pFields[6], NULL, 16 );
+			copied.bInThisBuild = false;
+		}
+		else if ( strcmp ( pFields[0], "scan" ) == NULL && iFields == 5 )
+		{
+			pScan = &g_standaloneScanned[pFields[1]];
+			pScan->source = state;
+			pScan->deps.clear();
+		}
+		else if ( strcmp ( pFields[0], "dep" ) == NULL && pScan )
 		{
-			tline_s=Lower(scriptpage_s[l].Get());
+			pScan->deps.push_back ( pFields[1] );
+		}
+	}
+	fclose ( pFile );
+	timestampactivity ( 0, cstr(cstr("Standalone manifest has ")+Str((int)g_standaloneCopied.size())+" copied and "+Str((int)g_standaloneScanned.size())+" scanned files").Get() );
+}
+
+void mapfile_savestandalone_savemanifest ( void )
+{
+	if ( g_bStandaloneManifestActive == false ) return;
+	g_bStandaloneManifestActive = false;
+
+	FILE* pFile = fopen ( g_standaloneManifestFile_s.Get(), "w" );
+	if ( pFile == NULL ) return;
+	fprintf ( pFile, "GGSTANDALONEMANIFEST 1\noutput\t%s\t%s\n", g_standaloneManifestOutput_s.Get(), g_standaloneManifestMode_s.Get() );
+	for ( std::map<std::string,sStandaloneCopiedFile>::iterator it = g_standaloneCopied.begin(); it != g_standaloneCopied.end(); ++it )
+	{
+		// record what the standalone ended up holding, only files copied by this build are kept
+		if ( it->second.bInThisBuild == false ) continue;
+		char pDest[MAX_PATH], pOutput[MAX_PATH];
+		sprintf ( pDest, "%s\\Files\\%s", g_standaloneManifestOutput_s.Get(), it->first.c_str() );
+		standalonemanifest_outputfile ( pDest, pOutput );
+		if ( standalonemanifest_statfile ( pOutput, &it->second.outputsize, &it->second.outputmtime ) == false ) continue;
+		const sStandaloneFileState& s = it->second.source;
+		fprintf ( pFile, "copy\t%s\t%llx\t%llx\t%08x%08x%08x%08x%08x\t%llx\t%llx\n", it->first.c_str(), s.size, s.mtime, s.sha1[0], s.sha1[1], s.sha1[2], s.sha1[3], s.sha1[4], it->second.outputsize, it->second.outputmtime );
+	}
+	for ( std::map<std::string,sStandaloneScannedFile>::iterator it = g_standaloneScanned.begin(); it != g_standaloneScanned.end(); ++it )
+	{
+		const sStandaloneFileState& s = it->second.source;
+		fprintf ( pFile, "scan\t%s\t%llx\t%llx\t%08x%08x%08x%08x%08x\n", it->first.c_str(), s.size, s.mtime, s.sha1[0], s.sha1[1], s.sha1[2], s.sha1[3], s.sha1[4] );
+		for ( size_t d = 0; d < it->second.deps.size(); d++ )
+			fprintf ( pFile, "dep\t%s\n", it->second.deps[d].c_str() );
+	}
+	fclose ( pFile );
+}
+
+// returns 1 with ppScan set if the deps recorded for an unchanged file can be replayed,
+// 0 if the file must be scanned (its deps are recorded until standalonemanifest_endscan),
+// or -1 if there is no manifest in use
+static int standalonemanifest_beginscan ( LPSTR pFile, LPSTR pKey, sStandaloneScannedFile** ppScan, std::vector<std::string>** ppPreviousRecord )
+{
+	if ( g_bStandaloneManifestActive == false ) return -1;
+	char pRealFile[MAX_PATH];
+	strcpy ( pRealFile, pFile );
+	GG_GetRealPath ( pRealFile, 0 );
+	std::string key = Lower(pKey);
+	std::map<std::string,sStandaloneScannedFile>::iterator it = g_standaloneScanned.find ( key );
+	if ( it != g_standaloneScanned.end() && standalonemanifest_unchanged ( pRealFile, it->second.source ) )
+	{
+		*ppScan = &it->second;
+		return 1;
+	}
+	sStandaloneScannedFile& scan = g_standaloneScanned[key];
+	scan.deps.clear();
+	if ( standalonemanifest_readstate ( pRealFile, scan.source ) == false )
+	{
+		g_standaloneScanned.erase ( key );
+		return -1;
+	}
+	*ppPreviousRecord = g_pStandaloneRecordDeps;
+	g_pStandaloneRecordDeps = &scan.deps;
+	return 0;
+}
+
+static void standalonemanifest_endscan ( std::vector<std::string>* pPreviousRecord )
+{
+	g_pStandaloneRecordDeps = pPreviousRecord;
+}
 
-			for (c = 0; c <= Len(tline_s.Get()) - lookforlen2 - 1; c++)
+void mapfile_savestandalone_copycollection ( void )
+{
+	// DBP file commands are not thread safe, so resolve paths and decide the work here
+	struct sCopyJob
+	{
+		std::string src;
+		std::string dest;
+		sStandaloneCopiedFile* pCopied;
+		bool bCopied;
+	};
+	std::vector<sCopyJob> jobs;
+	for ( int fileindex = 1 ; fileindex <= g.filecollectionmax; fileindex++ )
+	{
+		cstr src_s = t.filecollection_s[fileindex];
+		if ( src_s.Len() == 0 ) continue;
+		char pRealSrc[MAX_PATH];
+		strcpy ( pRealSrc, src_s.Get() );
+		GG_GetRealPath ( pRealSrc, 0 );
+		if ( FileExist(pRealSrc) == 1 ) 
+		{
+			// workers must not depend on the current folder
+			char pFullSrc[MAX_PATH];
+			if ( GetFullPathNameA ( pRealSrc, MAX_PATH, pFullSrc, NULL ) == 0 ) strcpy ( pFullSrc, pRealSrc );
+			sCopyJob job;
+			job.src = pFullSrc;
+			job.dest = cstr(t.exepath_s+t.exename_s+"\\Files\\"+src_s).Get();
+			std::map<std::string,sStandaloneCopiedFile>::iterator it = g_standaloneCopied.find ( src_s.Get() );
+			if ( it == g_standaloneCopied.end() )
 			{
-				tlinethis_s = Right(tline_s.Get(), Len(tline_s.Get()) - c);
+				sStandaloneCopiedFile blank;
+				memset ( &blank, 0, sizeof(blank) );
+				blank.outputsize = ~0ULL;
+				it = g_standaloneCopied.insert ( std::make_pair ( std::string(src_s.Get()), blank ) ).first;
+			}
+			job.pCopied = &it->second;
+			job.pCopied->bInThisBuild = true;
+			job.bCopied = false;
+			jobs.push_back ( job );
+		}
+	}
+
+	// compare, hash and copy in parallel, skipping files whose source and output are as last built
+	std::atomic<int> iCopied ( 0 );
+	std::atomic<int> iSkipped ( 0 );
+	auto copyFile = [&jobs, &iCopied, &iSkipped]( int j )
+	{
+		sCopyJob& job = jobs[j];
+		char pOutput[MAX_PATH];
+		standalonemanifest_outputfile ( (LPSTR)job.dest.c_str(), pOutput );
+		unsigned long long outputsize, outputmtime;
+		if ( standalonemanifest_statfile ( pOutput, &outputsize, &outputmtime ) 
+		&&   outputsize == job.pCopied->outputsize && outputmtime == job.pCopied->outputmtime 
+		&&   standalonemanifest_unchanged ( (LPSTR)job.src.c_str(), job.pCopied->source ) )
+		{
+			++iSkipped;
+			return;
+		}
+		if ( standalonemanifest_readstate ( (LPSTR)job.src.c_str(), job.pCopied->source ) == false ) return;
+		SetFileAttributesA ( job.dest.c_str(), FILE_ATTRIBUTE_NORMAL );
+		if ( CopyFileA ( job.src.c_str(), job.dest.c_str(), FALSE ) ) 
+		{
+			job.bCopied = true;
+			++iCopied;
+		}
+		else
+			job.pCopied->bInThisBuild = false;
+	};
+	if ( g_pThreadPool )
+	{
+		g_pThreadPool->parallel_for ( 0, (int)jobs.size(), 8, copyFile );
+	}
+	else
+	{
+		cThreadPool pool ( std::thread::hardware_concurrency() );
+		pool.parallel_for ( 0, (int)jobs.size(), 8, copyFile );
+	}
+	timestampactivity ( 0, cstr(cstr("Standalone copied ")+Str(iCopied.load())+" files, "+Str(iSkipped.load())+" unchanged").Get() );
 
-				// ignore commented out lines
-				if (cstr(Left(tlinethis_s.Get(), 2)) == "--") break;
+	// a standalone that maps its models gets them aligned so their data is used in place,
+	// the manifest records the output after this so unchanged models are not aligned again
+	if ( g.globals.mappedobjectloading == 1 )
+	{
+		for ( size_t j = 0; j < jobs.size(); j++ )
+		{
+			sCopyJob& job = jobs[j];
+			if ( job.bCopied == false || job.dest.size() < 4 ) continue;
+			if ( _stricmp ( job.dest.c_str() + job.dest.size() - 4, ".dbo" ) != 0 ) continue;
+			AlignObjectFile ( (LPSTR)job.dest.c_str(), (LPSTR)job.dest.c_str() );
+		}
+	}
+}
 
-				if (cstr(Left(tlinethis_s.Get(), lookforlen2)) == lookfor2_s.Get() || cstr(Left(tlinethis_s.Get(), lookforlen2)) == lookfor3_s.Get())
-				{
-					//  found script has included ANOTHER script
-					// skip spaces and quotes 
-					int i = lookforlen2 + 1;
+// lowercased file to its slot in t.filecollection_s, so adding to a collection of thousands
+// of files no longer searches it. The collection is reset in many places by setting
+// g.filecollectionmax back to zero, so the index rebuilds itself when it sees it shrink
+std::unordered_map<std::string,int> g_filecollectionIndex;
+int g_iFilecollectionIndexed = 0;
 
-					while (i < Len(tlinethis_s.Get()) &&
-						(cstr(Mid(tlinethis_s.Get(), i)) == " " ||
-							cstr(Mid(tlinethis_s.Get(), i)) == "\""))
-					{
-						i++;
-					};
+static void filecollection_syncindex ( void )
+{
+	if ( g.filecollectionmax < g_iFilecollectionIndexed )
+	{
+		g_filecollectionIndex.clear();
+		g_iFilecollectionIndexed = 0;
+	}
+	while ( g_iFilecollectionIndexed < g.filecollectionmax )
+	{
+		++g_iFilecollectionIndexed;
+		LPSTR pFile = t.filecollection_s[g_iFilecollectionIndexed].Get();
+		if ( pFile && *pFile ) g_filecollectionIndex.insert ( std::make_pair ( std::string(pFile), g_iFilecollectionIndexed ) );
+	}
+}
 
-					// if couldn't find the script name skip this line
-					if (i == Len(tlinethis_s.Get())) break;
+static int filecollection_find ( LPSTR pLowerFile )
+{
+	filecollection_syncindex();
+	std::unordered_map<std::string,int>::iterator it = g_filecollectionIndex.find ( pLowerFile );
+	if ( it == g_filecollectionIndex.end() ) return 0;
+	// entries removed from the collection are blanked in place
+	if ( it->second <= g.filecollectionmax && t.filecollection_s[it->second] == pLowerFile ) return it->second;
+	g_filecollectionIndex.erase ( it );
+	return 0;
+}
 
-					tscriptname_s = Right(tline_s.Get(), Len(tline_s.Get()) - c - i + 1);
+// references found in the scripts, entity profiles and models the collection reads. They are
+// parsed on the thread pool before the entity scan, which still adds them one by one in the
+// order it reads them, so the collection (and anything written from it) comes out the same
+struct sCollectionScanFile
+{
+	char cKind;				// 's' script includes, 'f' fpe texturerefs, 'm' model textures
+	std::string path;
+	bool bParsed;
+	std::vector<std::string> refs;
+};
+std::unordered_map<std::string,sCollectionScanFile> g_collectionScanCache;
+bool g_bCollectionScanCacheActive = false;
+
+static void collectionscan_scriptincludes ( const std::string& line, LPCSTR pLookFor, LPCSTR pLookForAlt, bool bRequire, std::vector<std::string>& refs )
+{
+	int lookforlen = strlen ( pLookFor );
+	int linelen = line.size();
+	for ( int c = 0; c <= linelen - lookforlen - 1; c++ )
+	{
+		LPCSTR pThis = line.c_str() + c;
 
-					for (int il = Len(tscriptname_s.Get()); il > 0; il--) {
-						if (cstr(Mid(tscriptname_s.Get(), il)) == "\"") {
-							tscriptname_s = Left(tscriptname_s.Get(), il-1);
-							break;
-						}
-					}
+		// ignore commented out lines
+		if ( strncmp ( pThis, "--", 2 ) == NULL ) break;
 
-					std::string script_name = tscriptname_s.Get();
-					replaceAll(script_name, "\\\\", "\\");
-					replaceAll(script_name, "scriptbank\\", "");
-					tscriptname_s = script_name.c_str();
+		if ( strncmp ( pThis, pLookFor, lookforlen ) != NULL && ( pLookForAlt == NULL || strncmp ( pThis, pLookForAlt, lookforlen ) != NULL ) ) continue;
 
-					if( !pestrcasestr(tscriptname_s.Get(),".lua"))
-						tscriptname_s += ".lua";
+		// skip spaces and quotes 
+		int thislen = linelen - c;
+		int i = lookforlen + 1;
+		while ( i < thislen && ( pThis[i-1] == ' ' || pThis[i-1] == '"' ) ) i++;
 
-					for (tt = Len(tscriptname_s.Get()); tt >= 4; tt += -1)
-					{
-						if (cstr(Mid(tscriptname_s.Get(), tt - 0)) == "a" && cstr(Mid(tscriptname_s.Get(), tt - 1)) == "u" && cstr(Mid(tscriptname_s.Get(), tt - 2)) == "l" && cstr(Mid(tscriptname_s.Get(), tt - 3)) == ".")
-						{
-							break;
-						}
-					}
-					tscriptname_s = Left(tscriptname_s.Get(), tt);
+		// if couldn't find the script name skip this line
+		if ( i == thislen ) break;
 
-					if (addtocollection(cstr(cstr("scriptbank\\") + tscriptname_s).Get()) == true) {
-						//Newly added , also scan this entry.
-						scanscriptfileandaddtocollection(cstr(cstr("scriptbank\\") + tscriptname_s).Get());
-					}
+		std::string script_name = line.substr ( c + i - 1 );
+		if ( bRequire )
+		{
+			for ( int il = script_name.size(); il > 0; il-- )
+			{
+				if ( script_name[il-1] == '"' )
+				{
+					script_name.resize ( il - 1 );
+					break;
 				}
 			}
+			replaceAll ( script_name, "\\\\", "\\" );
+			replaceAll ( script_name, "scriptbank\\", "" );
+			if ( strstr ( script_name.c_str(), ".lua" ) == NULL ) script_name += ".lua";
+		}
+
+		// drop whatever follows the .lua
+		int tt;
+		for ( tt = script_name.size(); tt >= 4; tt-- )
+		{
+			if ( script_name[tt-1] == 'a' && script_name[tt-2] == 'u' && script_name[tt-3] == 'l' && script_name[tt-4] == '.' ) break;
+		}
+		if ( tt < (int)script_name.size() ) script_name.resize ( tt );
+
+		refs.push_back ( std::string("scriptbank\\") + script_name );
+	}
+}
+
+static bool collectionscan_parsescript ( LPCSTR pFile, std::vector<std::string>& refs )
+{
+	FILE* pScriptFile = GG_fopen ( pFile, "r" );
+	if ( pScriptFile == NULL ) return false;
+	char pLine[2048];
+	while ( fgets ( pLine, 2047, pScriptFile ) )
+	{
+		int len = strlen ( pLine );
+		if ( len > 0 && pLine[len-1] == '\n' ) pLine[len-1] = 0;
+		std::string line = pLine;
+		for ( size_t n = 0; n < line.size(); n++ ) line[n] = tolower ( (unsigned char)line[n] );
+		collectionscan_scriptincludes ( line, "require \"", "include (", true, refs );
+		collectionscan_scriptincludes ( line, "include(", NULL, false, refs );
+	}
+	fclose ( pScriptFile );
+	return true;
+}
 
-			for ( c = 0 ; c<=  Len(tline_s.Get())-lookforlen-1; c++ )
+static bool collectionscan_parsefpe ( LPCSTR pFile, std::vector<std::string>& refs )
+{
+	FILE* pFPEFile = GG_fopen ( pFile, "r" );
+	if ( pFPEFile == NULL ) return false;
+	char pLine[2048];
+	while ( fgets ( pLine, 2047, pFPEFile ) )
+	{
+		if ( strstr ( pLine, "textureref" ) == NULL ) continue;
+		char* pToFilename = strstr ( pLine, "=" );
+		if ( pToFilename == NULL ) continue;
+		while ( *pToFilename == '=' || *pToFilename == 32 ) pToFilename++;
+		for ( int n = 0; n < 4; n++ )
+		{
+			int len = strlen ( pToFilename );
+			if ( len > 0 && ( pToFilename[len-1] == 13 || pToFilename[len-1] == 10 ) ) pToFilename[len-1] = 0;
+		}
+		refs.push_back ( pToFilename );
+	}
+	fclose ( pFPEFile );
+	return true;
+}
+
+static bool collectionscan_parsemodel ( LPCSTR pFile, std::vector<std::string>& refs )
+{
+	// model files name their textures, look for .tga .jpg .dds .bmp .png and .psd (from the
+	// building pack) and track back to the start of the name
+	FILE* pModelFile = GG_fopen ( pFile, "rb" );
+	if ( pModelFile == NULL ) return false;
+	fseek ( pModelFile, 0, SEEK_END );
+	int filesize = ftell ( pModelFile );
+	fseek ( pModelFile, 0, SEEK_SET );
+	std::vector<unsigned char> data ( filesize > 0 ? filesize : 0 );
+	if ( filesize > 0 ) filesize = fread ( &data[0], 1, filesize, pModelFile );
+	fclose ( pModelFile );
+
+	static const char* pExtensions[] = { "tga", "jpg", "dds", "bmp", "png", "psd" };
+	for ( int b = 0; b <= filesize - 4; b++ )
+	{
+		if ( data[b] != '.' ) continue;
+		bool bFoundPiccy = false;
+		for ( int x = 0; x < 6; x++ )
+		{
+			if ( (data[b+1] | 0x20) == pExtensions[x][0] && (data[b+2] | 0x20) == pExtensions[x][1] && (data[b+3] | 0x20) == pExtensions[x][2] )
 			{
-				tlinethis_s=Right(tline_s.Get(),Len(tline_s.Get())-c);
+				bFoundPiccy = true;
+				break;
+			}
+		}
+		if ( bFoundPiccy == false ) continue;
+		int c;
+		for ( c = b; c >= b - 255; c-- )
+		{
+			if ( c < 0 || data[c] < ' ' || data[c] > 'z' || data[c] == 34 ) break;
+		}
+		std::string texfile;
+		for ( int d = c + 1; d <= b + 3; d++ ) texfile += (char)tolower ( data[d] );
+		refs.push_back ( texfile );
+		b += 4;
+	}
+	return true;
+}
 
-				// ignore commented out lines
-				if ( cstr( Left( tlinethis_s.Get(), 2 )) == "--" ) break;
+static bool collectionscan_parse ( sCollectionScanFile& scan )
+{
+	scan.refs.clear();
+	if ( scan.cKind == 's' ) return collectionscan_parsescript ( scan.path.c_str(), scan.refs );
+	if ( scan.cKind == 'f' ) return collectionscan_parsefpe ( scan.path.c_str(), scan.refs );
+	return collectionscan_parsemodel ( scan.path.c_str(), scan.refs );
+}
 
-				if (  cstr( Left( tlinethis_s.Get(), lookforlen )) == lookfor_s.Get() )
-				{
-					//  found script has included ANOTHER script
-					// skip spaces and quotes 
-					int i = lookforlen + 1;
+// works out the file a scan reads, false when there is nothing to read
+static bool collectionscan_resolve ( sCollectionScanFile& scan, LPSTR pFile )
+{
+	if ( scan.cKind != 'f' && FileExist ( pFile ) == 0 ) return false;
+	char pPath[MAX_PATH];
+	strcpy ( pPath, pFile );
+	if ( scan.cKind == 's' ) CheckForWorkshopFile ( pPath );
+	scan.path = pPath;
+	return true;
+}
 
-					while ( i < Len( tlinethis_s.Get() ) &&
-						   ( cstr( Mid( tlinethis_s.Get(), i )) == " " ||
-						     cstr( Mid( tlinethis_s.Get(), i )) == "\"" ) ) 
-					{
-						i++;
-					};
-			
-					// if couldn't find the script name skip this line
-					if (i == Len(tlinethis_s.Get())) break;
-
-					tscriptname_s=Right(tline_s.Get(),Len(tline_s.Get())-c-i+1);
-					for (tt = Len(tscriptname_s.Get()); tt >= 4; tt += -1)
-					{
-						if (cstr(Mid(tscriptname_s.Get(), tt - 0)) == "a" && cstr(Mid(tscriptname_s.Get(), tt - 1)) == "u" && cstr(Mid(tscriptname_s.Get(), tt - 2)) == "l" && cstr(Mid(tscriptname_s.Get(), tt - 3)) == ".")
-						{
-							break;
-						}
-					}
-					tscriptname_s = Left(tscriptname_s.Get(), tt);
+static std::string collectionscan_key ( char cKind, LPSTR pFile )
+{
+	std::string key = pFile;
+	for ( size_t n = 0; n < key.size(); n++ ) key[n] = tolower ( (unsigned char)key[n] );
+	return std::string(1,cKind) + "|" + key;
+}
 
-					if (addtocollection(cstr(cstr("scriptbank\\") + tscriptname_s).Get()) == true) {
-						//Newly added , also scan this entry.
-						scanscriptfileandaddtocollection(cstr(cstr("scriptbank\\") + tscriptname_s).Get());
-					}
-				}
+static void collectionscan_queue ( char cKind, LPSTR pFile, std::vector<sCollectionScanFile*>& jobs )
+{
+	std::string key = collectionscan_key ( cKind, pFile );
+	if ( g_collectionScanCache.find ( key ) != g_collectionScanCache.end() ) return;
+	sCollectionScanFile& scan = g_collectionScanCache[key];
+	scan.cKind = cKind;
+	scan.bParsed = false;
+	if ( collectionscan_resolve ( scan, pFile ) == false )
+	{
+		// a missing file adds nothing
+		scan.bParsed = true;
+		return;
+	}
+	jobs.push_back ( &scan );
+}
+
+// the references a file makes, parsed ahead when the prefetch found it
+static void collectionscan_refs ( char cKind, LPSTR pFile, std::vector<std::string>& refs )
+{
+	refs.clear();
+	if ( g_bCollectionScanCacheActive )
+	{
+		std::unordered_map<std::string,sCollectionScanFile>::iterator it = g_collectionScanCache.find ( collectionscan_key ( cKind, pFile ) );
+		if ( it != g_collectionScanCache.end() && it->second.bParsed )
+		{
+			refs = it->second.refs;
+			return;
+		}
+	}
+	sCollectionScanFile scan;
+	scan.cKind = cKind;
+	if ( collectionscan_resolve ( scan, pFile ) == false ) return;
+	if ( collectionscan_parse ( scan ) ) refs.swap ( scan.refs );
+}
+
+void mapfile_savestandalone_prefetchscans ( void )
+{
+	// the scripts, profiles and models the entity scan of this level is about to read
+	g_bCollectionScanCacheActive = true;
+	std::vector<sCollectionScanFile*> jobs;
+	for ( int e = 1; e <= g.entityelementlist; e++ )
+	{
+		int entid = t.entityelement[e].bankindex;
+		if ( entid <= 0 ) continue;
+		collectionscan_queue ( 's', cstr(cstr("scriptbank\\")+t.entityelement[e].eleprof.aimain_s).Get(), jobs );
+		cstr entityname_s = cstr("entitybank\\")+t.entitybank_s[entid];
+		collectionscan_queue ( 'f', cstr(g.fpscrootdir_s+"\\Files\\"+entityname_s).Get(), jobs );
+
+		// same model files (and the dbo in place of an x file) the scan collects
+		cstr entityfolder_s = entityname_s;
+		for ( int n = Len(entityname_s.Get()); n >= 1; n-- )
+		{
+			if ( cstr(Mid(entityname_s.Get(),n)) == "\\" || cstr(Mid(entityname_s.Get(),n)) == "/" ) 
+			{
+				entityfolder_s = Left(entityname_s.Get(),n);
+				break;
 			}
 		}
+		int iModelAppendFileCount = t.entityprofile[entid].appendanimmax;
+		if ( Len ( t.entityappendanim[entid][0].filename.Get() ) > 0 ) iModelAppendFileCount = 0;
+		for ( int iModels = -1; iModels <= iModelAppendFileCount; iModels++ )
+		{
+			LPSTR pModelFile = iModels == -1 ? t.entityprofile[entid].model_s.Get() : t.entityappendanim[entid][iModels].filename.Get();
+			cstr model_s = pModelFile;
+			if ( strchr ( pModelFile, '\\' ) == NULL && strchr ( pModelFile, '/' ) == NULL ) model_s = entityfolder_s + pModelFile;
+			cstr dbo_s = cstr(Left(model_s.Get(),Len(model_s.Get())-2))+".dbo";
+			if ( FileExist( cstr(g.fpscrootdir_s+"\\Files\\"+dbo_s).Get() ) == 1 ) model_s = dbo_s;
+			collectionscan_queue ( 'm', model_s.Get(), jobs );
+		}
+	}
+
+	// parse in waves, the scripts included by one wave are parsed in the next
+	int iParsed = 0;
+	while ( jobs.size() > 0 )
+	{
+		auto parseFile = [&jobs]( int j )
+		{
+			jobs[j]->bParsed = collectionscan_parse ( *jobs[j] );
+		};
+		if ( g_pThreadPool )
+		{
+			g_pThreadPool->parallel_for ( 0, (int)jobs.size(), 1, parseFile );
+		}
+		else
+		{
+			cThreadPool pool ( std::thread::hardware_concurrency() );
+			pool.parallel_for ( 0, (int)jobs.size(), 1, parseFile );
+		}
+		iParsed += jobs.size();
+
+		std::vector<sCollectionScanFile*> included;
+		for ( size_t j = 0; j < jobs.size(); j++ )
+		{
+			if ( jobs[j]->cKind != 's' || jobs[j]->bParsed == false ) continue;
+			for ( size_t r = 0; r < jobs[j]->refs.size(); r++ )
+				collectionscan_queue ( 's', (LPSTR)jobs[j]->refs[r].c_str(), included );
+		}
+		jobs.swap ( included );
 	}
-	UnDim (  scriptpage_s );
+	timestampactivity ( 0, cstr(cstr("Standalone scanned ")+Str(iParsed)+" files ahead of collection").Get() );
+}
+
+void mapfile_savestandalone_endscans ( void )
+{
+	g_bCollectionScanCacheActive = false;
+	g_collectionScanCache.clear();
+}
+
+void scanscriptfileandaddtocollection ( char* tfile_s )
+{
+	// an unchanged script includes the same scripts it did last build
+	sStandaloneScannedFile* pManifestScan = NULL;
+	std::vector<std::string>* pPreviousRecord = NULL;
+	int iManifestScan = standalonemanifest_beginscan ( tfile_s, tfile_s, &pManifestScan, &pPreviousRecord );
+	if ( iManifestScan == 1 )
+	{
+		std::vector<std::string> deps = pManifestScan->deps;
+		std::vector<std::string>* pStoreRecord = g_pStandaloneRecordDeps;
+		g_pStandaloneRecordDeps = NULL;
+		for ( size_t d = 0; d < deps.size(); d++ )
+		{
+			if ( addtocollection ( (LPSTR)deps[d].c_str() ) == true )
+				scanscriptfileandaddtocollection ( (LPSTR)deps[d].c_str() );
+		}
+		g_pStandaloneRecordDeps = pStoreRecord;
+		return;
+	}
+
+	// scripts this one includes, in the order they appear
+	std::vector<std::string> includes;
+	collectionscan_refs ( 's', tfile_s, includes );
+	for ( size_t i = 0; i < includes.size(); i++ )
+	{
+		if ( addtocollection ( (LPSTR)includes[i].c_str() ) == true )
+		{
+			//Newly added , also scan this entry.
+			scanscriptfileandaddtocollection ( (LPSTR)includes[i].c_str() );
+		}
+	}
+	if ( iManifestScan == 0 ) standalonemanifest_endscan ( pPreviousRecord );
 }
 
 bool addtocollection ( char* file_s )
 {
 	int tarrsize = 0;
 	int tfound = 0;
-	int f = 0;
 	file_s=Lower(file_s);
+	if ( g_pStandaloneRecordDeps ) g_pStandaloneRecordDeps->push_back ( file_s );
 	//  Ensure this entry is not already present
-	tfound=0;
-	for ( f = 1 ; f<=  g.filecollectionmax; f++ )
-	{
-		if (  t.filecollection_s[f] == cstr(file_s)  )  tfound = 1;
-	}
+	tfound=filecollection_find(file_s);
 	if (  tfound == 0 ) 
 	{
 		//  Expand file collection array if nearly full
@@ -4695,9 +5202,10 @@ bool addtocollection ( char* file_s )
 		tarrsize=ArrayCount(t.filecollection_s);
 		if (  g.filecollectionmax>tarrsize-10 ) 
 		{
-			Dim (  t.filecollection_s,tarrsize+50  );
+			Dim (  t.filecollection_s,tarrsize*2  );
 		}
 		t.filecollection_s[g.filecollectionmax]=file_s;
+		filecollection_syncindex();
 		return true;
 	}
 	return false;
@@ -4707,9 +5215,7 @@ void removefromcollection ( char* file_s )
 {
 	int tfound = 0;
 	file_s=Lower(file_s);
-	for ( int f = 1 ; f <= g.filecollectionmax; f++ )
-		if ( t.filecollection_s[f] == cstr(file_s)  )  
-			tfound = f;
+	tfound = filecollection_find(file_s);
 	if ( tfound > 0 ) 
 	{
 		// remove from consideration
@@ -4853,224 +5359,137 @@ void createallfoldersincollection ( void )
 
 void findalltexturesinmodelfile ( char* file_s, char* folder_s, char* texpath_s )
 {
-	cstr returntexfile_s =  "";
-	int tfoundpiccy = 0;
 	cstr texfile_s =  "";
-	int filesize = 0;
-	int mbi = 0;
-	int a = 0;
-	int b = 0;
-	int c = 0;
-	int d = 0;
-	//  To determine if a model file requires texture files, we scan the file for a
-	//  match to the Text (  .TGA or .JPG (and use texfile$) )
-	returntexfile_s="";
-	if (  FileExist(file_s) == 1 ) 
-	{
-		filesize=FileSize(file_s);
-		mbi=255;
-		OpenToRead (  11,file_s );
-		MakeMemblockFromFile (  mbi,11 );
-		CloseFile (  11 );
-		for ( b = 0 ; b <= filesize-4; b++ )
-		{
-			if (  ReadMemblockByte(mbi,b+0) == Asc(".") ) 
+	// an unchanged model found in the same folder refers to the same textures as last build
+	sStandaloneScannedFile* pManifestScan = NULL;
+	std::vector<std::string>* pPreviousRecord = NULL;
+	cstr manifestkey_s = cstr(file_s) + "|" + folder_s + "|" + texpath_s;
+	int iManifestScan = standalonemanifest_beginscan ( file_s, manifestkey_s.Get(), &pManifestScan, &pPreviousRecord );
+	if ( iManifestScan == 1 )
+	{
+		std::vector<std::string>* pStoreRecord = g_pStandaloneRecordDeps;
+		g_pStandaloneRecordDeps = NULL;
+		for ( size_t d = 0; d < pManifestScan->deps.size(); d++ )
+			addtocollection ( (LPSTR)pManifestScan->deps[d].c_str() );
+		g_pStandaloneRecordDeps = pStoreRecord;
+		return;
+	}
+
+	//  To determine if a model file requires texture files, we scan the file for
+	//  texture names (.TGA .JPG .DDS .BMP .PNG .PSD)
+	std::vector<std::string> textures;
+	collectionscan_refs ( 'm', file_s, textures );
+	for ( size_t n = 0; n < textures.size(); n++ )
+	{
+		texfile_s=textures[n].c_str();
+		if ( strnicmp ( texfile_s.Get(), "effectbank\\", 11 ) == NULL )
+		{
+			addtocollection(texfile_s.Get() );
+		}
+		else
+		{
+			// detect PBR texture set
+			bool bDetectedPBRTextureSetName = false;
+			cstr texfilenoext_s=cstr(Left(texfile_s.Get(),Len(texfile_s.Get())-4));
+			if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 6 , "_color", 6 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-6); bDetectedPBRTextureSetName = true; }
+			if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 7 , "_normal", 7 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-7); bDetectedPBRTextureSetName = true; }
+			if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 10 , "_metalness", 10 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-10); bDetectedPBRTextureSetName = true; }
+			if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 10 , "_roughness", 10 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-10); bDetectedPBRTextureSetName = true; }
+			if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 6 , "_gloss", 6 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-6); bDetectedPBRTextureSetName = true; }
+			if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 3 , "_ao", 3 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-3); bDetectedPBRTextureSetName = true; }
+			if ( bDetectedPBRTextureSetName == true )
 			{
-				tfoundpiccy=0;
-				if (  ReadMemblockByte(mbi,b+1) == Asc("T") || ReadMemblockByte(mbi,b+1) == Asc("t") ) 
-				{
-					if (  ReadMemblockByte(mbi,b+2) == Asc("G") || ReadMemblockByte(mbi,b+2) == Asc("g") ) 
-					{
-						if (  ReadMemblockByte(mbi,b+3) == Asc("A") || ReadMemblockByte(mbi,b+3) == Asc("a") ) 
-						{
-							tfoundpiccy=1;
-						}
-					}
-				}
-				if (  ReadMemblockByte(mbi,b+1) == Asc("J") || ReadMemblockByte(mbi,b+1) == Asc("j") ) 
-				{
-					if (  ReadMemblockByte(mbi,b+2) == Asc("P") || ReadMemblockByte(mbi,b+2) == Asc("p") ) 
-					{
-						if (  ReadMemblockByte(mbi,b+3) == Asc("G") || ReadMemblockByte(mbi,b+3) == Asc("g") ) 
-						{
-							tfoundpiccy=1;
-						}
-					}
+				//PE: Need to check filename only and current object folder.
+				bool tex_found = false;
+				int pos = 0;
+				for (pos = texfilenoext_s.Len(); pos > 0; pos--) {
+					if (cstr(Mid(texfilenoext_s.Get(), pos)) == "\\" || cstr(Mid(texfilenoext_s.Get(), pos)) == "/")
+						break;
 				}
-				if (  ReadMemblockByte(mbi,b+1) == Asc("D") || ReadMemblockByte(mbi,b+1) == Asc("d") ) 
-				{
-					if (  ReadMemblockByte(mbi,b+2) == Asc("D") || ReadMemblockByte(mbi,b+2) == Asc("d") ) 
-					{
-						if (  ReadMemblockByte(mbi,b+3) == Asc("S") || ReadMemblockByte(mbi,b+3) == Asc("s") ) 
-						{
-							tfoundpiccy=1;
-						}
+				if (pos > 0) {
+					cstr directfile = Right(texfilenoext_s.Get(), texfilenoext_s.Len() - pos);
+
+					cstr tmp = cstr(cstr(folder_s) + directfile + "_color.dds").Get();
+					if (FileExist(tmp.Get())) {
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_normal.dds").Get();
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_metalness.dds").Get();
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_gloss.dds").Get();
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_ao.dds").Get();
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_illumination.dds").Get();
+						addtocollection(tmp.Get());
+						tex_found = true;
 					}
-				}
-				if (  ReadMemblockByte(mbi,b+1) == Asc("B") || ReadMemblockByte(mbi,b+1) == Asc("b") ) 
-				{
-					if (  ReadMemblockByte(mbi,b+2) == Asc("M") || ReadMemblockByte(mbi,b+2) == Asc("m") ) 
-					{
-						if (  ReadMemblockByte(mbi,b+3) == Asc("P") || ReadMemblockByte(mbi,b+3) == Asc("p") ) 
-						{
-							tfoundpiccy=1;
-						}
-					}
-				}
-				if (ReadMemblockByte(mbi, b + 1) == Asc("P") || ReadMemblockByte(mbi, b + 1) == Asc("p"))
-				{
-					if (ReadMemblockByte(mbi, b + 2) == Asc("N") || ReadMemblockByte(mbi, b + 2) == Asc("n"))
-					{
-						if (ReadMemblockByte(mbi, b + 3) == Asc("G") || ReadMemblockByte(mbi, b + 3) == Asc("g"))
-						{
-							tfoundpiccy = 1;
-						}
+					tmp = cstr(cstr(folder_s) + directfile + "_color.png").Get();
+					if (FileExist(tmp.Get())) {
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_normal.png").Get();
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_metalness.png").Get();
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_gloss.png").Get();
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_ao.png").Get();
+						addtocollection(tmp.Get());
+						tmp = cstr(cstr(folder_s) + directfile + "_illumination.png").Get();
+						addtocollection(tmp.Get());
+						tex_found = true;
 					}
+
 				}
-				//PE: mainly from the building pack they are recorded as psd.
-				if (ReadMemblockByte(mbi, b + 1) == Asc("P") || ReadMemblockByte(mbi, b + 1) == Asc("p"))
+
+				//PE: We get some strange folder created in the standalone from here.
+				// add other PBR textures just in case not detected in model data
+				if (!tex_found)
 				{
-					if (ReadMemblockByte(mbi, b + 2) == Asc("S") || ReadMemblockByte(mbi, b + 2) == Asc("s"))
-					{
-						if (ReadMemblockByte(mbi, b + 3) == Asc("D") || ReadMemblockByte(mbi, b + 3) == Asc("d"))
-						{
-							tfoundpiccy = 1;
-						}
+					cstr texfileColor_s = texfilenoext_s + "_color.dds";
+					//Only if the src is exists.
+					if (FileExist(cstr(cstr(folder_s) + texpath_s + texfileColor_s).Get()) || FileExist(cstr(cstr(folder_s) + texfileColor_s).Get())) {
+
+						addtocollection(cstr(cstr(folder_s) + texpath_s + texfileColor_s).Get());
+						addtocollection(cstr(cstr(folder_s) + texfileColor_s).Get());
+						cstr texfileNormal_s = texfilenoext_s + "_normal.dds";
+						addtocollection(cstr(cstr(folder_s) + texpath_s + texfileNormal_s).Get());
+						addtocollection(cstr(cstr(folder_s) + texfileNormal_s).Get());
+						cstr texfileMetalness_s = texfilenoext_s + "_metalness.dds";
+						addtocollection(cstr(cstr(folder_s) + texpath_s + texfileMetalness_s).Get());
+						addtocollection(cstr(cstr(folder_s) + texfileMetalness_s).Get());
+						cstr texfileGloss_s = texfilenoext_s + "_gloss.dds";
+						addtocollection(cstr(cstr(folder_s) + texpath_s + texfileGloss_s).Get());
+						addtocollection(cstr(cstr(folder_s) + texfileGloss_s).Get());
+						cstr texfileAO_s = texfilenoext_s + "_ao.dds";
+						addtocollection(cstr(cstr(folder_s) + texpath_s + texfileAO_s).Get());
+						addtocollection(cstr(cstr(folder_s) + texfileAO_s).Get());
+						cstr texfileIllumination_s = texfilenoext_s + "_illumination.dds";
+						addtocollection(cstr(cstr(folder_s) + texpath_s + texfileIllumination_s).Get());
+						addtocollection(cstr(cstr(folder_s) + texfileIllumination_s).Get());
 					}
 				}
-				if (  tfoundpiccy == 1 ) 
-				{
-					//  track back
-					for ( c = b ; c >= b-255 ; c+= -1 )
-					{
-						if (  ReadMemblockByte(mbi,c) >= Asc(" ") && ReadMemblockByte(mbi,c) <= Asc("z") && ReadMemblockByte(mbi,c) != 34 ) 
-						{
-							//  part of filename
-						}
-						else
-						{
-							//  no more filename
-							break;
-						}
-					}
-					texfile_s="";
-					for ( d = c+1 ; d<=  b+3; d++ )
-					{
-						texfile_s=texfile_s+Chr(ReadMemblockByte(mbi,d));
-					}
-					texfile_s=Lower(texfile_s.Get());
-					if ( strnicmp ( texfile_s.Get(), "effectbank\\", 11 ) == NULL )
-					{
-						addtocollection(texfile_s.Get() );
-					}
-					else
-					{
-						// detect PBR texture set
-						bool bDetectedPBRTextureSetName = false;
-						cstr texfilenoext_s=cstr(Left(texfile_s.Get(),Len(texfile_s.Get())-4));
-						if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 6 , "_color", 6 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-6); bDetectedPBRTextureSetName = true; }
-						if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 7 , "_normal", 7 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-7); bDetectedPBRTextureSetName = true; }
-						if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 10 , "_metalness", 10 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-10); bDetectedPBRTextureSetName = true; }
-						if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 10 , "_roughness", 10 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-10); bDetectedPBRTextureSetName = true; }
-						if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 6 , "_gloss", 6 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-6); bDetectedPBRTextureSetName = true; }
-						if ( strnicmp ( texfilenoext_s.Get() + strlen(texfilenoext_s.Get()) - 3 , "_ao", 3 ) == NULL ) { texfilenoext_s = Left(texfilenoext_s.Get(),strlen(texfilenoext_s.Get())-3); bDetectedPBRTextureSetName = true; }
-						if ( bDetectedPBRTextureSetName == true )
-						{
-							//PE: Need to check filename only and current object folder.
-							bool tex_found = false;
-							int pos = 0;
-							for (pos = texfilenoext_s.Len(); pos > 0; pos--) {
-								if (cstr(Mid(texfilenoext_s.Get(), pos)) == "\\" || cstr(Mid(texfilenoext_s.Get(), pos)) == "/")
-									break;
-							}
-							if (pos > 0) {
-								cstr directfile = Right(texfilenoext_s.Get(), texfilenoext_s.Len() - pos);
-
-								cstr tmp = cstr(cstr(folder_s) + directfile + "_color.dds").Get();
-								if (FileExist(tmp.Get())) {
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_normal.dds").Get();
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_metalness.dds").Get();
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_gloss.dds").Get();
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_ao.dds").Get();
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_illumination.dds").Get();
-									addtocollection(tmp.Get());
-									tex_found = true;
-								}
-								tmp = cstr(cstr(folder_s) + directfile + "_color.png").Get();
-								if (FileExist(tmp.Get())) {
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_normal.png").Get();
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_metalness.png").Get();
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_gloss.png").Get();
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_ao.png").Get();
-									addtocollection(tmp.Get());
-									tmp = cstr(cstr(folder_s) + directfile + "_illumination.png").Get();
-									addtocollection(tmp.Get());
-									tex_found = true;
-								}
-
-							}
-
-							//PE: We get some strange folder created in the standalone from here.
-							// add other PBR textures just in case not detected in model data
-							if (!tex_found)
-							{
-								cstr texfileColor_s = texfilenoext_s + "_color.dds";
-								//Only if the src is exists.
-								if (FileExist(cstr(cstr(folder_s) + texpath_s + texfileColor_s).Get()) || FileExist(cstr(cstr(folder_s) + texfileColor_s).Get())) {
-
-									addtocollection(cstr(cstr(folder_s) + texpath_s + texfileColor_s).Get());
-									addtocollection(cstr(cstr(folder_s) + texfileColor_s).Get());
-									cstr texfileNormal_s = texfilenoext_s + "_normal.dds";
-									addtocollection(cstr(cstr(folder_s) + texpath_s + texfileNormal_s).Get());
-									addtocollection(cstr(cstr(folder_s) + texfileNormal_s).Get());
-									cstr texfileMetalness_s = texfilenoext_s + "_metalness.dds";
-									addtocollection(cstr(cstr(folder_s) + texpath_s + texfileMetalness_s).Get());
-									addtocollection(cstr(cstr(folder_s) + texfileMetalness_s).Get());
-									cstr texfileGloss_s = texfilenoext_s + "_gloss.dds";
-									addtocollection(cstr(cstr(folder_s) + texpath_s + texfileGloss_s).Get());
-									addtocollection(cstr(cstr(folder_s) + texfileGloss_s).Get());
-									cstr texfileAO_s = texfilenoext_s + "_ao.dds";
-									addtocollection(cstr(cstr(folder_s) + texpath_s + texfileAO_s).Get());
-									addtocollection(cstr(cstr(folder_s) + texfileAO_s).Get());
-									cstr texfileIllumination_s = texfilenoext_s + "_illumination.dds";
-									addtocollection(cstr(cstr(folder_s) + texpath_s + texfileIllumination_s).Get());
-									addtocollection(cstr(cstr(folder_s) + texfileIllumination_s).Get());
-								}
-							}
-						}
+			}
 
-						if (FileExist(cstr(cstr(folder_s) + texpath_s + texfile_s).Get()))
-							addtocollection( cstr(cstr(folder_s)+texpath_s+texfile_s).Get() );
-						if (FileExist(cstr(cstr(folder_s) + texfile_s).Get()))
-							addtocollection( cstr(cstr(folder_s)+texfile_s).Get() );
+			if (FileExist(cstr(cstr(folder_s) + texpath_s + texfile_s).Get()))
+				addtocollection( cstr(cstr(folder_s)+texpath_s+texfile_s).Get() );
+			if (FileExist(cstr(cstr(folder_s) + texfile_s).Get()))
+				addtocollection( cstr(cstr(folder_s)+texfile_s).Get() );
 
-						if (  cstr(Right(texfile_s.Get(),4)) != ".dds" ) 
-						{
-							//  also convert to DDS and add those too
-							if (FileExist(cstr(cstr(folder_s) + texfile_s + ".png").Get()))
-								addtocollection( cstr(cstr(folder_s)+texfile_s+".png").Get() );
-							texfile_s=cstr(Left(texfile_s.Get(),Len(texfile_s.Get())-4))+".dds";
-							if (FileExist(cstr(cstr(folder_s) + texpath_s + texfile_s).Get()))
-								addtocollection( cstr(cstr(folder_s)+texpath_s+texfile_s).Get() );
-							if (FileExist(cstr(cstr(folder_s) + texfile_s).Get()))
-								addtocollection( cstr(cstr(folder_s)+texfile_s).Get() );
-						}
-					}
-					b += 4;
-				}
+			if (  cstr(Right(texfile_s.Get(),4)) != ".dds" ) 
+			{
+				//  also convert to DDS and add those too
+				if (FileExist(cstr(cstr(folder_s) + texfile_s + ".png").Get()))
+					addtocollection( cstr(cstr(folder_s)+texfile_s+".png").Get() );
+				texfile_s=cstr(Left(texfile_s.Get(),Len(texfile_s.Get())-4))+".dds";
+				if (FileExist(cstr(cstr(folder_s) + texpath_s + texfile_s).Get()))
+					addtocollection( cstr(cstr(folder_s)+texpath_s+texfile_s).Get() );
+				if (FileExist(cstr(cstr(folder_s) + texfile_s).Get()))
+					addtocollection( cstr(cstr(folder_s)+texfile_s).Get() );
 			}
 		}
-		DeleteMemblock (  mbi );
 	}
+	if ( iManifestScan == 0 ) standalonemanifest_endscan ( pPreviousRecord );
 }
 
 #ifdef VRTECH
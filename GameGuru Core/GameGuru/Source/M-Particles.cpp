@@ -4,6 +4,8 @@
 
 #include "stdafx.h"
 #include "gameguru.h"
+#include "ParticleSim.h"
+#include "threading_utils.h"
 
 
 float fwindVectX, fwindVectZ = 0.0f;
@@ -14,6 +16,60 @@ void ravey_particles_set_wind_vector(float fwindX, float fwindZ)
 	fwindVectZ = fwindZ;
 }
 
+// batched mode keeps the particles of each emitter in a ParticleSim pool and draws
+// them as one object per emitter image, emitters with their own shader or a fixed
+// angle still use an object per particle
+static int g_iRaveyParticlesBatched = 0;
+static int g_iRaveyParticlesBatchEffect = 0;
+static ParticleSim g_RaveyParticleSim;
+static int g_iRaveyParticlesBatchQuads[ RAVEY_PARTICLE_EMITTERS_MAX * 2 ];
+static int g_iRaveyParticlesBatchImage[ RAVEY_PARTICLE_EMITTERS_MAX * 2 ];
+static std::vector<int> g_RaveyParticlesBatchCounts;
+
+static void ravey_particles_update_batched ( void );
+static void ravey_particles_draw_batches ( void );
+
+static int ravey_particles_batch_object ( int iEmitter, int iImage )
+{
+	return g.raveyparticlesobjectoffset + RAVEY_PARTICLES_MAX + ( iImage * RAVEY_PARTICLE_EMITTERS_MAX ) + iEmitter;
+}
+
+static bool ravey_particles_is_batched ( travey_particle_emitter* this_emitter )
+{
+	if ( g_iRaveyParticlesBatched == 0 || g_iRaveyParticlesBatchEffect == 0 ) return false;
+	if ( this_emitter->useAngle ) return false;
+	if ( this_emitter->effectId != g.decaleffectoffset ) return false;
+	return true;
+}
+
+static void ravey_particles_free_batches ( void )
+{
+	// particles still in the pools are taken off their emitters
+	for ( int i = 0; i < g_RaveyParticleSim.getPoolCount() && i < RAVEY_PARTICLE_EMITTERS_MAX; i++ )
+	{
+		t.ravey_particle_emitters[ i ].numParticles -= g_RaveyParticleSim.getCount( i );
+	}
+	g_RaveyParticleSim.clear();
+	for ( int i = 0; i < RAVEY_PARTICLE_EMITTERS_MAX * 2; i++ )
+	{
+		int obj = ravey_particles_batch_object( i % RAVEY_PARTICLE_EMITTERS_MAX, i / RAVEY_PARTICLE_EMITTERS_MAX );
+		if ( ObjectExist( obj ) == 1 ) DeleteObject( obj );
+		g_iRaveyParticlesBatchQuads[ i ] = 0;
+		g_iRaveyParticlesBatchImage[ i ] = 0;
+	}
+}
+
+void ravey_particles_set_batched ( int iMode )
+{
+	if ( iMode == g_iRaveyParticlesBatched ) return;
+	if ( g_iRaveyParticlesBatched == 1 ) ravey_particles_free_batches();
+	g_iRaveyParticlesBatched = iMode;
+	if ( g_iRaveyParticlesBatched == 1 && g_iRaveyParticlesBatchEffect == 0 )
+	{
+		g_iRaveyParticlesBatchEffect = loadinternaleffect( "effectbank\\reloaded\\decal_batch.fx" );
+	}
+}
+
 
 void ravey_particles_init ( void )
 {
@@ -69,6 +125,14 @@ void ravey_particles_init ( void )
 
 	}
 
+	//  batched emitters start empty, batchedparticles in setup.ini turns them on
+	ravey_particles_free_batches();
+	ravey_particles_set_batched ( g.globals.batchedparticles );
+	if ( g_iRaveyParticlesBatched == 1 )
+	{
+		g_iRaveyParticlesBatchEffect = loadinternaleffect( "effectbank\\reloaded\\decal_batch.fx" );
+	}
+
 	//  reset emitters
 	for ( int i = 0 ; i < RAVEY_PARTICLE_EMITTERS_MAX; i++ )
 	{
@@ -264,8 +328,11 @@ void ravey_particles_update ( void )
 	{
 		g.ravey_particles_old_time = Timer();
 	}
+	if ( g_iRaveyParticlesBatched == 1 ) ravey_particles_update_batched();
 	
 	ravey_particles_update_emitters();
+
+	if ( g_iRaveyParticlesBatched == 1 ) ravey_particles_draw_batches();
 }
 
 inline float doCalc(float A, float B)
@@ -496,6 +563,104 @@ void generateParticle( travey_particle_emitter* this_emitter, int tfound )
 	//  end of new particle	
 }
 
+void generateBatchedParticle( travey_particle_emitter* this_emitter )
+{
+	// values drawn in the same order as generateParticle so an emitter looks the same either way
+	ParticleSpawn particle;
+	this_emitter->numParticles++;
+
+	float fX = this_emitter->xPos;
+	float fY = this_emitter->yPos;
+	float fZ = this_emitter->zPos;
+	if ( this_emitter->parentObject > 0 && ( this_emitter->onDeathAction != 1 || this_emitter->firstParticle ) )
+	{
+		if ( this_emitter->parentLimb == 0 )
+		{
+			fX = ObjectPositionX( this_emitter->parentObject );
+			fY = ObjectPositionY( this_emitter->parentObject );
+			fZ = ObjectPositionZ( this_emitter->parentObject );
+		}
+		else
+		{
+			fX = LimbPositionX( this_emitter->parentObject, this_emitter->parentLimb );
+			fY = LimbPositionY( this_emitter->parentObject, this_emitter->parentLimb );
+			fZ = LimbPositionZ( this_emitter->parentObject, this_emitter->parentLimb );
+		}
+	}
+	particle.x = fX + doCalc( this_emitter->offsetMinX, this_emitter->offsetMaxX );
+	particle.y = fY + doCalc( this_emitter->offsetMinY, this_emitter->offsetMaxY );
+	particle.z = fZ + doCalc( this_emitter->offsetMinZ, this_emitter->offsetMaxZ );
+	this_emitter->firstParticle = FALSE;
+
+	particle.speedX = doCalc( this_emitter->movementSpeedMinX, this_emitter->movementSpeedMaxX );
+	particle.speedY = doCalc( this_emitter->movementSpeedMinY, this_emitter->movementSpeedMaxY );
+	particle.speedZ = doCalc( this_emitter->movementSpeedMinZ, this_emitter->movementSpeedMaxZ );
+	particle.rotateSpeedZ = doCalc( this_emitter->rotateSpeedMinZ, this_emitter->rotateSpeedMaxZ );
+	particle.scaleStart = doCalc( this_emitter->scaleStartMin, this_emitter->scaleStartMax );
+	particle.scaleEnd = doCalc( this_emitter->scaleEndMin, this_emitter->scaleEndMax );
+	particle.life = doCalc( this_emitter->lifeMin, this_emitter->lifeMax );
+	particle.alphaStart = doCalc( this_emitter->alphaStartMin, this_emitter->alphaStartMax );
+	particle.alphaEnd = doCalc( this_emitter->alphaEndMin, this_emitter->alphaEndMax );
+	particle.flags = 0;
+
+	#ifdef VRTECH
+	if ( this_emitter->imageNumberSecond > 0 && Rnd(1) == 0 ) particle.flags |= PARTICLESIM_SECONDIMAGE;
+	#endif
+
+	//  animation, a random still frame is animated at no speed as generateParticle does
+	int iAnimated = this_emitter->isAnimated;
+	#ifdef VRTECH
+	if ( this_emitter->animationSpeed == 0.0 && this_emitter->frameCount > 0 && this_emitter->useAtlas )
+	#else
+	if ( this_emitter->animationSpeed == 0.0 && this_emitter->frameCount > 0 )
+	#endif
+	{
+		particle.startFrame = (float) Rnd( this_emitter->frameCount );
+		particle.endFrame   = particle.startFrame;
+		iAnimated = 1;
+	}
+	else
+	{
+		particle.startFrame = (float) this_emitter->startFrame;
+		particle.endFrame   = (float) this_emitter->endFrame;
+	}
+	particle.animationSpeed = this_emitter->animationSpeed;
+
+	// the atlas cell drawn, whole image, frame grid, or the first of an 8x8 grid when still
+	#ifdef VRTECH
+	if ( !this_emitter->useAtlas )
+	{
+		particle.frameDivide = 1.0f;
+		particle.startFrame = 0.0f;
+		particle.endFrame = 0.0f;
+	}
+	else if ( iAnimated == 1 )
+	#else
+	if ( iAnimated == 1 )
+	#endif
+	{
+		particle.frameDivide = this_emitter->frameDivide;
+		particle.flags |= PARTICLESIM_ANIMATED;
+		if ( this_emitter->isLooping == 1 ) particle.flags |= PARTICLESIM_LOOPING;
+	}
+	else
+	{
+		particle.frameDivide = 8.0f;
+		particle.startFrame = 0.0f;
+		particle.endFrame = 0.0f;
+	}
+
+	particle.gravityStart = this_emitter->startGravity;
+	particle.gravityEnd   = this_emitter->endGravity;
+
+	if ( this_emitter->startsOffRandomAngle == 0 )
+		particle.rotZ = 0;
+	else
+		particle.rotZ = (float)Rnd( 360 );
+
+	g_RaveyParticleSim.spawn( this_emitter->id, particle );
+}
+
 void ravey_particles_generate_particle( int iID, float fPosX, float fPosY, float fPosZ )
 {
 	if ( t.ravey_particle_emitters[ iID ].inUse == 1 )
@@ -504,6 +669,21 @@ void ravey_particles_generate_particle( int iID, float fPosX, float fPosY, float
 
 		if ( this_emitter->numParticles >= this_emitter->maxParticles ) return;
 
+		if ( ravey_particles_is_batched( this_emitter ) )
+		{
+			if ( this_emitter->parentObject == 0 )
+			{
+				if ( fPosX + fPosY + fPosZ > 0.0 )
+				{
+					this_emitter->xPos = fPosX;
+					this_emitter->yPos = fPosY;
+					this_emitter->zPos = fPosZ;
+				}
+			}
+			generateBatchedParticle( this_emitter );
+			return;
+		}
+
 		// now find a spare particle to use with required shader effect
 		int tfound = -1;
 		for ( int i = 0; i < RAVEY_PARTICLES_MAX; i++ )
@@ -579,6 +759,13 @@ void ravey_particles_update_emitters( void )
 
 				for ( int tNewParticleCount = 0; tNewParticleCount < tAmountToMake; tNewParticleCount++ )
 				{
+					if ( ravey_particles_is_batched( this_emitter ) )
+					{
+						generateBatchedParticle( this_emitter );
+						if ( this_emitter->numParticles >= this_emitter->maxParticles ) break;
+						continue;
+					}
+
 					int tfound = -1;
 					for ( int i = 0; i < RAVEY_PARTICLES_MAX; i++ )
 					{
@@ -830,6 +1017,177 @@ bool ravey_particles_update_particles( void )
 	return TRUE;
 }
 
+static float g_fRaveyParticlesBatchOldTime = 0;
+
+static void ravey_particles_update_batched ( void )
+{
+	// own clock, every pool moves on by the whole frame with no per particle throttle
+	float fNow = Timer();
+	float fTimePassed = 0;
+	if ( g_fRaveyParticlesBatchOldTime > 0 ) fTimePassed = fNow - g_fRaveyParticlesBatchOldTime;
+	g_fRaveyParticlesBatchOldTime = fNow;
+
+	int iPoolCount = g_RaveyParticleSim.getPoolCount();
+	if ( iPoolCount > RAVEY_PARTICLE_EMITTERS_MAX ) iPoolCount = RAVEY_PARTICLE_EMITTERS_MAX;
+	g_RaveyParticlesBatchCounts.resize( iPoolCount );
+	for ( int i = 0; i < iPoolCount; i++ )
+	{
+		travey_particle_emitter* this_emitter = &t.ravey_particle_emitters[ i ];
+		ParticlePool& pool = g_RaveyParticleSim.getPool( i );
+		pool.noWind = this_emitter->noWind ? true : false;
+		pool.recordDeaths = this_emitter->onDeathAction == 1;
+		g_RaveyParticlesBatchCounts[ i ] = pool.count;
+	}
+
+	g_RaveyParticleSim.update( fTimePassed, fwindVectX, fwindVectZ, g_pThreadPool );
+
+	// deaths taken off the emitters, and split emitters move to where each died
+	for ( int i = 0; i < iPoolCount; i++ )
+	{
+		travey_particle_emitter* this_emitter = &t.ravey_particle_emitters[ i ];
+		ParticlePool& pool = g_RaveyParticleSim.getPool( i );
+		this_emitter->numParticles -= g_RaveyParticlesBatchCounts[ i ] - pool.count;
+		for ( int d = 0; d < pool.deaths; d++ )
+		{
+			int numPts = Rnd( 3 );
+			if ( numPts > 0 )
+			{
+				this_emitter->xPos = pool.deathX[ d ];
+				this_emitter->yPos = pool.deathY[ d ];
+				this_emitter->zPos = pool.deathZ[ d ];
+				this_emitter->maxParticles += ( numPts - 1 );
+			}
+			else
+			{
+				if ( this_emitter->maxParticles > 1 ) this_emitter->maxParticles--;
+			}
+		}
+	}
+}
+
+static void ravey_particles_make_batch_object ( int obj, int iQuads )
+{
+	// same settings as the per particle objects in ravey_particles_init
+	if ( ObjectExist( obj ) == 1 ) DeleteObject( obj );
+	if ( MakeNewObjectPanel( obj, iQuads ) == 0 ) return;
+	FinishObjectPanel( obj, 100, 100 );
+	SetObjectTransparency( obj, 6 );
+	SetObjectCollisionOff( obj );
+	DisableObjectZWrite( obj );
+	SetObjectTextureMode( obj, 0, 0 );
+	SetObjectLight( obj, 0 );
+	#ifdef VRTECH
+	if ( g.vrglobals.GGVREnabled > 0 )
+		SetObjectMask ( obj, (1<<6) + (1<<7) + 1 );
+	else
+		SetObjectMask ( obj, 1 );
+	#else
+	SetObjectMask ( obj, 1 );
+	#endif
+	SetObjectEffect( obj, g_iRaveyParticlesBatchEffect );
+	SetObjectCull( obj, 0 );
+
+	// the quads move every frame so the object is never culled on its first bounds
+	SetSphereRadius( obj, 0 );
+}
+
+static void ravey_particles_draw_batch ( int iEmitter, int iImage )
+{
+	travey_particle_emitter* this_emitter = &t.ravey_particle_emitters[ iEmitter ];
+	int iSlot = ( iImage * RAVEY_PARTICLE_EMITTERS_MAX ) + iEmitter;
+	int obj = ravey_particles_batch_object( iEmitter, iImage );
+	int iCount = g_RaveyParticleSim.getCount( iEmitter );
+	#ifdef VRTECH
+	if ( iImage == 1 && this_emitter->imageNumberSecond == 0 ) iCount = 0;
+	#endif
+	if ( iCount == 0 )
+	{
+		if ( ObjectExist( obj ) == 1 ) HideObject( obj );
+		return;
+	}
+
+	// room for the whole pool, doubled as it grows
+	if ( g_iRaveyParticlesBatchQuads[ iSlot ] < iCount || ObjectExist( obj ) == 0 )
+	{
+		int iQuads = g_iRaveyParticlesBatchQuads[ iSlot ];
+		if ( iQuads < RAVEY_PARTICLES_BATCH_MIN_QUADS ) iQuads = RAVEY_PARTICLES_BATCH_MIN_QUADS;
+		while ( iQuads < iCount ) iQuads *= 2;
+		ravey_particles_make_batch_object( obj, iQuads );
+		if ( ObjectExist( obj ) == 0 ) return;
+		g_iRaveyParticlesBatchQuads[ iSlot ] = iQuads;
+		g_iRaveyParticlesBatchImage[ iSlot ] = 0;
+	}
+
+	int iImgId = this_emitter->imageNumber;
+	int iFlagValue = 0;
+	#ifdef VRTECH
+	if ( iImage == 1 )
+	{
+		iImgId = this_emitter->imageNumberSecond;
+		iFlagValue = PARTICLESIM_SECONDIMAGE;
+	}
+	#endif
+	sObject* pObject = g_ObjectList[ obj ];
+	if ( g_iRaveyParticlesBatchImage[ iSlot ] != iImgId )
+	{
+		for ( int iMesh = 0; iMesh < pObject->iMeshCount; iMesh++ )
+			SetBaseTextureStage( pObject->ppMeshList[ iMesh ], 0, iImgId );
+		g_iRaveyParticlesBatchImage[ iSlot ] = iImgId;
+	}
+
+	// the effect can change the vertex layout so it is looked up each time
+	BYTE* pVertices = NULL;
+	DWORD dwVertexCount = 0;
+	int* piDrawCount = NULL;
+	GetEmitterData( obj, &pVertices, &dwVertexCount, &piDrawCount );
+	if ( pVertices == NULL || piDrawCount == NULL ) return;
+	sOffsetMap offsetMap;
+	GetFVFOffsetMap( pObject->pFrame->pMesh, &offsetMap );
+	ParticleVertexLayout layout;
+	layout.stride = offsetMap.dwSize;
+	layout.position = offsetMap.dwX;
+	layout.alpha = ( offsetMap.dwFVF & GGFVF_DIFFUSE ) ? offsetMap.dwDiffuse : -1;
+	layout.uv = offsetMap.dwTU[0];
+
+	// quads are made about the emitter so the object sorts with the other transparent objects by it
+	float fCamera[3] = { CameraPositionX(), CameraPositionY(), CameraPositionZ() };
+	float fOrigin[3] = { this_emitter->xPos, this_emitter->yPos, this_emitter->zPos };
+	if ( this_emitter->parentObject > 0 && ObjectExist( this_emitter->parentObject ) == 1 )
+	{
+		fOrigin[0] = ObjectPositionX( this_emitter->parentObject );
+		fOrigin[1] = ObjectPositionY( this_emitter->parentObject );
+		fOrigin[2] = ObjectPositionZ( this_emitter->parentObject );
+	}
+	int iMaxQuads = (int)dwVertexCount / 6;
+	int iFlagMask = 0;
+	#ifdef VRTECH
+	iFlagMask = PARTICLESIM_SECONDIMAGE;
+	#endif
+	int iQuads = g_RaveyParticleSim.buildQuads( iEmitter, layout, (float*)pVertices, iMaxQuads, fCamera, fOrigin, iFlagMask, iFlagValue, g_pThreadPool );
+	*piDrawCount = iQuads * 2;
+	if ( iQuads == 0 )
+	{
+		HideObject( obj );
+		return;
+	}
+	PositionObject( obj, fOrigin[0], fOrigin[1], fOrigin[2] );
+	ShowObject( obj );
+	UpdateEmitter( obj );
+}
+
+static void ravey_particles_draw_batches ( void )
+{
+	int iPoolCount = g_RaveyParticleSim.getPoolCount();
+	if ( iPoolCount > RAVEY_PARTICLE_EMITTERS_MAX ) iPoolCount = RAVEY_PARTICLE_EMITTERS_MAX;
+	for ( int i = 0; i < iPoolCount; i++ )
+	{
+		ravey_particles_draw_batch( i, 0 );
+		#ifdef VRTECH
+		ravey_particles_draw_batch( i, 1 );
+		#endif
+	}
+}
+
 void ravey_particles_free ( void )
 {
 	for ( int i = 0 ; i <  RAVEY_PARTICLES_MAX; i++ )
@@ -838,6 +1196,7 @@ void ravey_particles_free ( void )
 		if ( ObjectExist( obj ) == 1  ) DeleteObject ( obj );
 		t.ravey_particles[i].inUse = 0;
 	}
+	ravey_particles_free_batches();
 }
 
 void ravey_particles_add_emitter( void )
@@ -957,6 +1316,7 @@ void ravey_particles_add_emitter( void )
 void ravey_particles_delete_emitter ( void )
 {
 	t.ravey_particle_emitters[t.tRaveyParticlesEmitterID].inUse = 0;
+	g_RaveyParticleSim.resetPool( t.tRaveyParticlesEmitterID );
 }
 
 void ravey_particles_delete_all_emitters ( void )
@@ -964,6 +1324,7 @@ void ravey_particles_delete_all_emitters ( void )
 	for ( int i = 0 ; i <  RAVEY_PARTICLE_EMITTERS_MAX; i++ )
 	{
 		t.ravey_particle_emitters[ i ].inUse = 0;
+		g_RaveyParticleSim.resetPool( i );
 	}
 }
 
@@ -1778,5 +2139,16 @@ void delete_env_particles(void)
 			}
 		}
 	}
+
+	// and the same for batched emitters
+	for (int i = 0; i < g_RaveyParticleSim.getPoolCount() && i < RAVEY_PARTICLE_EMITTERS_MAX; i++)
+	{
+		travey_particle_emitter* this_emitter = &t.ravey_particle_emitters[i];
+		if (!this_emitter->useAtlas)
+		{
+			this_emitter->numParticles -= g_RaveyParticleSim.getCount(i);
+			g_RaveyParticleSim.resetPool(i);
+		}
+	}
 }
 #endif
@@ -6,6 +6,10 @@
 #include "..\..\Dark Basic Public Shared\Dark Basic Pro SDK\Shared\Objects\ShadowMapping\cShadowMaps.h"
 #include "DirectXTex.h"
 #include "wincodec.h"
+#include "TerrainUndo.h"
+#include "TerrainHorizon.h"
+#include "TerrainGenerator.h"
+#include "threading_utils.h"
 
 #ifdef ENABLEIMGUI
 //PE: GameGuru IMGUI.
@@ -117,6 +121,12 @@ bool bDisableAllTerrainSprites = false;
 int iTerrainPaintMode = 1;
 bool bVegHasChanged = false;
 
+// multi-level undo of heights and paint, the single undo buffer is used until this is made
+static TerrainUndo* g_pTerrainUndo = NULL;
+
+// sun shadow and occlusion baked from the heights, made when first baked or marked
+static TerrainHorizon* g_pTerrainHorizon = NULL;
+
 void terrain_initstyles ( void )
 {
 	// Init terrain work bitmap (so save level does not crash due to memory creation)
@@ -251,6 +261,7 @@ void terrain_setupedit ( void )
 	// Reset undo buffer
 	t.terrainundo.bufferfilled=0;
 	t.terrainundo.mode=0;
+	terrain_clearundohistory ( );
 
 	// Initial quick test player position
 	t.terrain.playerx_f=25000;
@@ -2691,6 +2702,8 @@ void terrain_editcontrol ( void )
 				if (  t.terrain.dirtyz1<0  )  t.terrain.dirtyz1 = 0;
 				if (  t.terrain.dirtyx2>1023  )  t.terrain.dirtyx2 = 1023;
 				if (  t.terrain.dirtyz2>1023  )  t.terrain.dirtyz2 = 1023;
+				// baked shadow follows the heights, baked when the stroke ends
+				if ( t.terrain.generateterrainshadows == 1 ) terrain_markshadows ( t.terrain.dirtyx1, t.terrain.dirtyz1, t.terrain.dirtyx2+1, t.terrain.dirtyz2+1 );
 				// now we need to raise the grass to this new terrain height
 				t.terrain.grassupdateafterterrain = 1;
 				t.terrain.grassregionx1 = t.terrain.dirtyx1;
@@ -2793,6 +2806,8 @@ void terrain_editcontrol ( void )
 
 		// allows second sculpt/paint to erase first undo buffer
 		if ( t.mc == 0  )  t.terrainundo.mode = 0;
+		if ( t.mc == 0  )  terrain_endundostep ( );
+		if ( t.mc == 0 && t.terrain.generateterrainshadows == 1 ) terrain_updateshadows ( );
 	}
 }
 
@@ -2812,7 +2827,11 @@ void ConvertVegMemblock ( int grassmemblock )
 
 void terrain_recordbuffer ( void )
 {
-	if (  1 ) 
+	if ( g_pTerrainUndo )
+	{
+		terrain_recordundotiles ( );
+	}
+	else
 	{
 		if (  t.terrainundo.mode == 0 ) 
 		{
@@ -2863,6 +2882,12 @@ void terrain_recordbuffer ( void )
 
 void terrain_undo ( void )
 {
+	if ( g_pTerrainUndo )
+	{
+		// the history steps back on each undo, not only after a fresh edit
+		if ( t.terrainundo.bufferfilled == 1 ) terrain_applyundostep ( g_pTerrainUndo->undo() );
+		return;
+	}
 	if (  t.entityundo.undoperformed == 0 ) 
 	{
 		if (  t.terrainundo.bufferfilled == 1 ) 
@@ -2910,6 +2935,12 @@ void terrain_undo ( void )
 
 void terrain_redo ( void )
 {
+	if ( g_pTerrainUndo )
+	{
+		if ( t.terrainundo.bufferfilled == 1 ) terrain_applyundostep ( g_pTerrainUndo->redo() );
+		return;
+	}
+
 	//  310315 - can only redo if something in buffer (cannot redo if NO terrain activity yet)
 	if (  t.entityundo.undoperformed == 1 && t.terrainundo.bufferfilled == 1 ) 
 	{
@@ -2963,6 +2994,131 @@ void terrain_redo ( void )
 	}
 }
 
+// terrain undo history, tiles are read and written through the layer functions below
+
+static void terrain_readundoheights ( int x, int z, int width, int height, unsigned char* data )
+{
+	BT_GetPointHeights ( t.terrain.TerrainID, x, z, width, height, (float*)data );
+}
+
+static void terrain_writeundoheights ( int x, int z, int width, int height, const unsigned char* data )
+{
+	BT_SetPointHeights ( t.terrain.TerrainID, x, z, width, height, (const float*)data );
+}
+
+static void terrain_readundopaint ( int x, int z, int width, int height, unsigned char* data )
+{
+	// paint and grass share memblock 123, one DWORD a texel after the twelve byte header.
+	// Loading terrain deletes it, the image it came from still holds the paint
+	if ( MemblockExist(123) == 0 ) CreateMemblockFromImage ( 123, t.terrain.imagestartindex+2 );
+	LPSTR pTexels = GetMemblockPtr ( 123 ) + 12;
+	int iPitch = ReadMemblockDWord ( 123, 0 ) * 4;
+	for ( int iRow = 0; iRow < height; iRow++ )
+		memcpy ( data + (iRow*width*4), pTexels + ((z+iRow)*iPitch) + (x*4), width*4 );
+}
+
+static void terrain_writeundopaint ( int x, int z, int width, int height, const unsigned char* data )
+{
+	if ( MemblockExist(123) == 0 ) CreateMemblockFromImage ( 123, t.terrain.imagestartindex+2 );
+	LPSTR pTexels = GetMemblockPtr ( 123 ) + 12;
+	int iPitch = ReadMemblockDWord ( 123, 0 ) * 4;
+	for ( int iRow = 0; iRow < height; iRow++ )
+		memcpy ( pTexels + ((z+iRow)*iPitch) + (x*4), data + (iRow*width*4), width*4 );
+}
+
+void terrain_setundohistory ( int iSteps, int iMegabytes )
+{
+	// zero steps goes back to the single undo buffer
+	if ( iSteps <= 0 )
+	{
+		if ( g_pTerrainUndo ) delete g_pTerrainUndo;
+		g_pTerrainUndo = NULL;
+	}
+	else
+	{
+		if ( g_pTerrainUndo == NULL ) g_pTerrainUndo = new TerrainUndo();
+		g_pTerrainUndo->setLimits ( iSteps, (size_t)iMegabytes * 1024 * 1024 );
+	}
+	t.terrainundo.bufferfilled = 0;
+	t.terrainundo.mode = 0;
+}
+
+void terrain_clearundohistory ( void )
+{
+	if ( g_pTerrainUndo ) g_pTerrainUndo->clear();
+}
+
+bool terrain_undohistoryactive ( void )
+{
+	return g_pTerrainUndo != NULL;
+}
+
+bool terrain_canundo ( void )
+{
+	return g_pTerrainUndo && t.terrainundo.bufferfilled == 1 && ( g_pTerrainUndo->isRecording() || g_pTerrainUndo->canUndo() );
+}
+
+bool terrain_canredo ( void )
+{
+	return g_pTerrainUndo && t.terrainundo.bufferfilled == 1 && g_pTerrainUndo->canRedo();
+}
+
+void terrain_endundostep ( void )
+{
+	if ( g_pTerrainUndo ) g_pTerrainUndo->endStep();
+}
+
+void terrain_recordundotiles ( void )
+{
+	// the paint memblock is made here if painting has not made it yet, so the first stroke has a before
+	if ( MemblockExist(123) == 0 ) CreateMemblockFromImage ( 123, t.terrain.imagestartindex+2 );
+	if ( t.terrainundo.mode == 0 )
+	{
+		g_pTerrainUndo->setLayer ( TERRAINUNDO_HEIGHT, 1025, 1025, 4, terrain_readundoheights, terrain_writeundoheights );
+		if ( MemblockExist(123) == 1 )
+			g_pTerrainUndo->setLayer ( TERRAINUNDO_PAINT, ReadMemblockDWord(123,0), ReadMemblockDWord(123,4), 4, terrain_readundopaint, terrain_writeundopaint );
+		g_pTerrainUndo->beginStep();
+		t.terrainundo.mode = 1;
+	}
+
+	// keep the tiles the brush can reach this frame before it changes them
+	t.turadius = t.terrain.RADIUS_f/50.0;
+	int iX1 = (t.terrain.X_f/50.0)-1-t.turadius;
+	int iX2 = (t.terrain.X_f/50.0)+1+t.turadius;
+	int iZ1 = (t.terrain.Y_f/50.0)-1-t.turadius;
+	int iZ2 = (t.terrain.Y_f/50.0)+1+t.turadius;
+	g_pTerrainUndo->touch ( TERRAINUNDO_HEIGHT, iX1, iZ1, iX2, iZ2 );
+	if ( MemblockExist(123) == 1 )
+	{
+		// terrain_paintterrain and grass_paint draw RADIUS/35 texels about X/25+1
+		int iRad = (t.terrain.RADIUS_f/35.0)+1;
+		int iCentreX = int(t.terrain.X_f/25.0)+1;
+		int iCentreZ = int(t.terrain.Y_f/25.0)+1;
+		g_pTerrainUndo->touch ( TERRAINUNDO_PAINT, iCentreX-iRad, iCentreZ-iRad, iCentreX+iRad, iCentreZ+iRad );
+	}
+	t.terrainundo.bufferfilled = 1;
+
+	// 161115 - need this flag to ensure undo can happen again
+	t.entityundo.undoperformed = 0;
+}
+
+void terrain_applyundostep ( int iLayers )
+{
+	// heights went straight into the terrain sectors, paint needs its image remade
+	if ( ( iLayers & (1<<TERRAINUNDO_HEIGHT) ) && t.terrain.generateterrainshadows == 1 )
+	{
+		terrain_markshadows ( 0, 0, 1024, 1024 );
+		terrain_updateshadows ( );
+	}
+	if ( ( iLayers & (1<<TERRAINUNDO_PAINT) ) && MemblockExist(123) == 1 )
+	{
+		CreateImageFromMemblock ( t.terrain.imagestartindex+2, 123 );
+		TextureObject ( t.terrain.terrainobjectindex, 0, t.terrain.imagestartindex+2 );
+		t.terrain.generatedsupertexture = 0;
+		bVegHasChanged = true;
+	}
+}
+
 void terrain_editcontrol_auxiliary ( void )
 {
 	//  some terrain controls are triggered by entity placement
@@ -3093,6 +3249,7 @@ void terrain_editcontrol_auxiliary ( void )
 			//  only once
 			t.terrain.X_f=-1000000 ; t.terrain.Y_f=-1000000;
 			t.terrain.terrainpainteroneshot=2;
+			terrain_endundostep ( );
 
 		}
 		else
@@ -3391,6 +3548,7 @@ void terrain_applyshader ( void )
 			TextureObject ( t.terrain.terrainobjectindex, 6, t.terrain.imagestartindex+31 );//EnvironmentMap
 			if (g.memskipibr == 0) TextureObject ( t.terrain.terrainobjectindex, 8, t.terrain.imagestartindex+32 );//GlossCurveMap
 		}
+		if ( ImageExist ( t.terrain.imagestartindex+11 ) == 1 ) TextureObject ( t.terrain.terrainobjectindex, 7, t.terrain.imagestartindex+11 );//BakedShadowMap
 	}
 }
 
@@ -3709,6 +3867,7 @@ void terrain_load ( void )
 			ExitPrompt (  "Memblock 1 already exists!","Terrain"  ); ExitProcess ( 0 );
 		}
 		CloseFile (  1 );
+		if ( t.terrain.generateterrainshadows == 1 ) terrain_generateshadows ( );
 	}
 }
 
@@ -3928,6 +4087,12 @@ void terrain_delete ( void )
 		BT_DeleteTerrain (  t.terrain.TerrainID );
 		t.terrain.TerrainID=0;
 	}
+	if ( g_pTerrainHorizon )
+	{
+		delete g_pTerrainHorizon;
+		g_pTerrainHorizon = NULL;
+	}
+	if ( MemblockExist(126) == 1 ) DeleteMemblock ( 126 );
 	if (  t.terrain.terrainshaderindex>0 ) 
 	{
 		if (  GetEffectExist(t.terrain.terrainshaderindex) == 1  )  DeleteEffect (  t.terrain.terrainshaderindex );
@@ -3945,6 +4110,9 @@ void dynamic_sun_position(int effectid)
 
 void terrain_shadowupdate ( void )
 {
+	// baked terrain shadow follows the sun
+	if ( t.terrain.generateterrainshadows == 1 ) terrain_followshadowsun ( );
+
 	// Shadow Mapping ; Activate cascade shadow mapping for terrain
 	if ( t.visuals.shadowmode>0 ) 
 	{
@@ -4444,28 +4612,23 @@ void terrain_updaterealheights ( void )
 {
 	if (  t.terrain.TerrainID>0 ) 
 	{
-		//  sculp terrain from existing height data
-		for ( t.z = 1 ; t.z<=  1023; t.z++ )
+		//  sculp terrain from existing height data, with the edges capped (the first corner is left as it is)
+		//  and handed over as one region so only the sectors that change are rebuilt, all at once
+		static std::vector<float> heights;
+		heights.resize ( 1025*1025 );
+		BT_GetPointHeights ( t.terrain.TerrainID, 0, 0, 1, 1, &heights[0] );
+		for ( t.z = 0 ; t.z<=  1024; t.z++ )
 		{
-			for ( t.x = 1 ; t.x<=  1023; t.x++ )
+			for ( t.x = 0 ; t.x<=  1024; t.x++ )
 			{
-				t.h_f=t.terrainmatrix[t.x][t.z];
+				if ( t.x == 0 && t.z == 0 ) continue;
+				t.h_f = 0;
+				if ( t.x >= 1 && t.x <= 1023 && t.z >= 1 && t.z <= 1023 ) t.h_f=t.terrainmatrix[t.x][t.z];
 				if (  t.h_f<0  )  t.h_f = 0;
-				BT_SetPointHeight (  t.terrain.TerrainID,t.x,t.z,t.h_f );
+				heights[t.z*1025+t.x] = t.h_f;
 			}
 		}
-
-		//  cap edges
-		for ( t.z = 1 ; t.z<=  1024; t.z++ )
-		{
-			BT_SetPointHeight (  t.terrain.TerrainID,0,t.z,0 );
-			BT_SetPointHeight (  t.terrain.TerrainID,1024,t.z,0 );
-		}
-		for ( t.x = 1 ; t.x<=  1024; t.x++ )
-		{
-			BT_SetPointHeight (  t.terrain.TerrainID,t.x,0,0 );
-			BT_SetPointHeight (  t.terrain.TerrainID,t.x,1024,0 );
-		}
+		BT_SetPointHeights ( t.terrain.TerrainID, 0, 0, 1025, 1025, &heights[0] );
 
 		// after amending terrain, update height map
 		BT_SetCurrentCamera (  0 );
@@ -4475,6 +4638,9 @@ void terrain_updaterealheights ( void )
 
 		//  update terrain internals and empty queue (was SyncOn (  260115) )
 		BT_Intern_Render( );
+
+		//  all heights are new, so bake the shadow mask again
+		if ( t.terrain.generateterrainshadows == 1 ) terrain_generateshadows ( );
 	}
 }
 
@@ -5049,247 +5215,133 @@ void terrain_generatesupertexture ( bool bForceRecalcOfPalette )
 	TextureObject (  t.terrain.terrainobjectindex,3,t.terrain.imagestartindex+17 );
 }
 
-void terrain_generateshadows ( void )
+static bool terrain_starthorizon ( void )
 {
-	/*      
-	//  NOTE; need to fix from 4096 to MAXTEXTURESIZE
-	//  shadow light setup
-	t.terrain.lightrange_f=2500;
-	t.terrain.ldirx_f=-0.25*(-1*t.terrain.lightrange_f);
-	t.terrain.ldiry_f=-0.5*(-1*t.terrain.lightrange_f);
-	t.terrain.ldirz_f=-0.25*(-1*t.terrain.lightrange_f);
-	t.terrain.ldirnx_f=t.terrain.ldirx_f/t.terrain.lightrange_f;
-	t.terrain.ldirny_f=t.terrain.ldiry_f/t.terrain.lightrange_f;
-	t.terrain.ldirnz_f=t.terrain.ldirz_f/t.terrain.lightrange_f;
-	//  paint shadows to map
-	if (  BitmapExist(g.terrainworkbitmapindex) == 1  )  DeleteBitmapEx (  g.terrainworkbitmapindex );
-	if (  BitmapExist(g.terrainworkbitmapindex) == 0 ) 
-	{
-		CreateBitmap (  g.terrainworkbitmapindex,MAXTEXTURESIZE,MAXTEXTURESIZE );
-		PasteImage (  t.terrain.imagestartindex+2,0,0 );
-		LockPixels (  );
-		//  slope
-		lightslope_f=abs(t.terrain.ldiry_f)/1024.0;
-		//  paint shadow pixels
-		for ( t.z = (MAXTEXTURESIZE/2)-200 ; t.z<=  (MAXTEXTURESIZE/2)+600; t.z++ )
-		{
-			for ( t.x = (MAXTEXTURESIZE/2)-200 ; t.x<=  (MAXTEXTURESIZE/2)+600; t.x++ )
-			{
-				t.x_f=(t.x-(MAXTEXTURESIZE/2))*12.5;
-				t.z_f=(t.z-(MAXTEXTURESIZE/2))*12.5;
-				//  interpolate correct height
-				t.nx_f=t.x;
-				t.nz_f=t.z;
-				t.nx=t.nx_f/(0.0+MAXTEXTURESIZEMULTIPLIER);
-				t.nz=t.nz_f/(0.0+MAXTEXTURESIZEMULTIPLIER);
-				t.nxb_f=(t.nx_f-(t.nx*MAXTEXTURESIZEMULTIPLIER))/(0.0+MAXTEXTURESIZEMULTIPLIER);
-				t.nzb_f=(t.nz_f-(t.nz*MAXTEXTURESIZEMULTIPLIER))/(0.0+MAXTEXTURESIZEMULTIPLIER);
-				t.h1_f=t.terrainmatrix[t.nx][t.nz];
-				t.h2_f=t.terrainmatrix[t.nx+1][t.nz];
-				t.h3_f=t.terrainmatrix[t.nx][t.nz+1];
-				t.h4_f=t.terrainmatrix[t.nx+1][t.nz+1];
-				//  can get normal from four height corners, and produce normal for Dot (  against light direction )
-				t.h_f=99999.9;
-				if (  t.h1_f<t.h_f  )  t.h_f = t.h1_f;
-				if (  t.h2_f<t.h_f  )  t.h_f = t.h2_f;
-				if (  t.h3_f<t.h_f  )  t.h_f = t.h3_f;
-				if (  t.h4_f<t.h_f  )  t.h_f = t.h4_f;
-				hn1_f=t.h1_f-t.h_f;
-				hn2_f=t.h2_f-t.h_f;
-				hn3_f=t.h3_f-t.h_f;
-				hn4_f=t.h4_f-t.h_f;
-				terraintilesize_f=12.5*MAXTEXTURESIZEMULTIPLIER;
-				thisnormalx_f=(((hn1_f-hn2_f)/terraintilesize_f)+((hn3_f-hn4_f)/terraintilesize_f))/2.0;
-				thisnormalz_f=(((hn1_f-hn3_f)/terraintilesize_f)+((hn2_f-hn4_f)/terraintilesize_f))/2.0;
-				thisnormaly_f=1.0-thisnormalx_f-thisnormalz_f;
-				thisdot_f=(thisnormalx_f*t.terrain.ldirnx_f)+(thisnormaly_f*t.terrain.ldirny_f)+(thisnormalz_f*t.terrain.ldirnz_f);
-				//  trace from terrain GetPoint (  towards sun )
-				//  stepping up the ray slope, and if
-				//  any terrain height is HIGHER, then
-				//  the sun has been blocked by terrain
-				t.ha_f=t.h1_f+((t.h2_f-t.h1_f)*t.nxb_f);
-				t.hb_f=t.h3_f+((t.h4_f-t.h3_f)*t.nxb_f);
-				t.h_f=t.ha_f+((t.hb_f-t.ha_f)*t.nzb_f);
-				t.d=0;
-				dleadup=0;
-				t.nx_f=t.x;
-				ny_f=t.h_f;
-				t.nz_f=t.z;
-				for ( t.n = 0 ; t.n<=  MAXTEXTURESIZE-1; t.n++ )
-				{
-					t.nx_f=t.nx_f+(t.terrain.ldirnx_f*5.0);
-					ny_f=ny_f+(t.terrain.ldirny_f*5.0);
-					t.nz_f=t.nz_f+(t.terrain.ldirnz_f*5.0);
-					t.nx=t.nx_f/4;
-					t.nz=t.nz_f/4;
-					if (  t.nx>0 && t.nx<1024 && t.nz>0 && t.nz<1024 ) 
-					{
-						//  interpolate between the four corner heights
-						t.nxb_f=(t.nx_f-(t.nx*4))/4.0;
-						t.nzb_f=(t.nz_f-(t.nz*4))/4.0;
-						t.h1_f=t.terrainmatrix[t.nx][t.nz];
-						t.h2_f=t.terrainmatrix[t.nx+1][t.nz];
-						t.h3_f=t.terrainmatrix[t.nx][t.nz+1];
-						t.h4_f=t.terrainmatrix[t.nx+1][t.nz+1];
-						t.ha_f=t.h1_f+((t.h2_f-t.h1_f)*t.nxb_f);
-						t.hb_f=t.h3_f+((t.h4_f-t.h3_f)*t.nxb_f);
-						t.h_f=t.ha_f+((t.hb_f-t.ha_f)*t.nzb_f);
-						if (  t.h_f>ny_f ) 
-						{
-							//  terrain blocked sun ray = shadow!
-							dleadupsize=dleadup;
-							inc t.d ; if (  t.d >= 16  )  break;
-						}
-						inc dleadup;
-						if (  ny_f>5500.0 ) 
-						{
-							//  ray cleared highest peek
-							break;
-						}
-					}
-					else
-					{
-						//  ray left map
-						break;
-					}
-				}
-				t.col=GetPoint(t.x,t.z);
-				colr=RgbR(t.col);
-				colg=RgbG(t.col);
-				colb=RgbB(t.col);
-				colg=colg+abs(thisdot_f)*64;
-				colgbase=colg;
-				if (  t.d == 0 ) 
-				{
-					//  can skip, no change, in full light
-				}
-				else
-				{
-					castshadowstr=(t.d*12);
-					castshadowstr=castshadowstr-(dleadupsize);
-					colg=colg+castshadowstr;
-				}
-				if (  colg<colgbase  )  colg = colgbase;
-				if (  colg>255  )  colg = 255;
-				Dot (  t.x,t.z,Rgb(colr,colg,colb) );
-			}
-		}
-		//  blue step to smooth in strange step artefacts?!?
-		if (  0 ) 
-		{
-		for ( t.z = 2048-200 ; t.z<=  2048+200; t.z++ )
-		{
-			for ( t.x = 2048-200 ; t.x<=  2048+200; t.x++ )
-			{
-				t.col=GetPoint(t.x,t.z);
-				colr=RgbR(t.col);
-				colg=RgbG(t.col);
-				colb=RgbB(t.col);
-				if (  colg>0 ) 
-				{
-					//  back
-					colgstore=colg/2;
-					t.col=GetPoint(t.x-1,t.z);
-					colr=RgbR(t.col);
-					colg=RgbG(t.col)+colgstore;
-					colb=RgbB(t.col);
-					if (  colg>255  )  colg = 255;
-					Dot (  t.x-1,t.z,Rgb(colr,colg,colb) );
-					//  up
-					t.col=GetPoint(t.x,t.z-1);
-					colr=RgbR(t.col);
-					colg=RgbG(t.col)+colgstore;
-					colb=RgbB(t.col);
-					if (  colg>255  )  colg = 255;
-					Dot (  t.x,t.z-1,Rgb(colr,colg,colb) );
-					//  further blur
-					colgstore=colgstore/2;
-					t.col=GetPoint(t.x-1,t.z-1);
-					colr=RgbR(t.col);
-					colg=RgbG(t.col)+colgstore;
-					colb=RgbB(t.col);
-					if (  colg>255  )  colg = 255;
-					Dot (  t.x-1,t.z-1,Rgb(colr,colg,colb) );
-					t.col=GetPoint(t.x-2,t.z);
-					colr=RgbR(t.col);
-					colg=RgbG(t.col)+colgstore;
-					colb=RgbB(t.col);
-					if (  colg>255  )  colg = 255;
-					Dot (  t.x-2,t.z,Rgb(colr,colg,colb) );
-					t.col=GetPoint(t.x,t.z-2);
-					colr=RgbR(t.col);
-					colg=RgbG(t.col)+colgstore;
-					colb=RgbB(t.col);
-					if (  colg>255  )  colg = 255;
-					Dot (  t.x,t.z-2,Rgb(colr,colg,colb) );
-				}
-			}
-		}
-		}
-		UnlockPixels (  );
-		GrabImage (  t.terrain.imagestartindex+2,0,0,MAXTEXTURESIZE,MAXTEXTURESIZE );
-		TextureObject (  t.terrain.objectstartindex+1,t.terrain.imagestartindex+2 );
-		ShowObject (  t.terrain.objectstartindex+1 );
-		DeleteBitmapEx (  g.terrainworkbitmapindex );
-	}
-	else
+	// a new horizon takes every height, so flat, random and loaded maps all start baked in full
+	if ( t.terrain.TerrainID == 0 ) return false;
+	if ( g_pTerrainHorizon == NULL )
 	{
-			"Bitmap "+Str(g.terrainworkbitmapindex)+" already exists!","Terrain" ; end;
+		g_pTerrainHorizon = new TerrainHorizon();
+		g_pTerrainHorizon->setSize ( 1025, 1025, 50.0f, 16 );
+		static std::vector<float> heights;
+		heights.resize ( 1025*1025 );
+		BT_GetPointHeights ( t.terrain.TerrainID, 0, 0, 1025, 1025, &heights[0] );
+		g_pTerrainHorizon->setHeights ( 0, 0, 1025, 1025, &heights[0] );
 	}
-	*/ 
+	return true;
 }
 
-void generate_terrain ( int seed, int scale, int mchunk_size )
+static void terrain_bakeshadows ( void )
 {
-	// restored to original method
-	// diamond-square algorithm - thanks to Lewis999 from the DBP 20 liner challenge forum!
-	Randomize(seed);
-	int s = scale;
-	// generates the main point on the line z=0 for the first matrix 
-	for ( int x = 2^s; x <= mchunk_size; x += 2^s )
-	{
-		t.terrainmatrix[x][0] = t.terrainmatrix[x-2^s][0] + Rnd((2^s)*10)-((2^s)*10)/2;
-	}
-	//generates the main point on theline y=0 for the first matrix 
-	for ( int y = 2^s; y <= mchunk_size; y += 2^s )
+	// the mask image is 1024 square, red is sun shadow and green is sky occlusion
+	// so an unbound stage reads as no shadow, the last row and column of heights are left off
+	int iX1, iZ1, iX2, iZ2;
+	if ( g_pTerrainHorizon->bake ( g_pThreadPool, iX1, iZ1, iX2, iZ2 ) == false ) return;
+	if ( MemblockExist(126) == 0 )
 	{
-		t.terrainmatrix[0][y] = t.terrainmatrix[0][y-2^s] + Rnd((2^s)*10)-((2^s)*10)/2;
+		MakeMemblock ( 126, 4+4+4+(1024*1024*4) );
+		WriteMemblockDWord ( 126, 0, 1024 );
+		WriteMemblockDWord ( 126, 4, 1024 );
+		WriteMemblockDWord ( 126, 8, 32 );
 	}
-	//generates the rest of the main points for the first matrix
-	for ( int y = 2^s; y <= mchunk_size; y += 2^s )
+	DWORD* pTexels = (DWORD*)( GetMemblockPtr ( 126 ) + 12 );
+	const unsigned char* pLight = g_pTerrainHorizon->getLight();
+	const unsigned char* pOcclusion = g_pTerrainHorizon->getOcclusion();
+	if ( iX2 > 1023 ) iX2 = 1023;
+	if ( iZ2 > 1023 ) iZ2 = 1023;
+	for ( int z = iZ1; z <= iZ2; z++ )
 	{
-		for ( int x = 2^s; x <= mchunk_size; x += 2^s )
+		for ( int x = iX1; x <= iX2; x++ )
 		{
-			t.terrainmatrix[x][y] = (t.terrainmatrix[x-2^s][y] + t.terrainmatrix[x][y-2^s])/2 + Rnd((2^s)*10)-((2^s)*10)/2;
+			int i = z*1025+x;
+			pTexels[z*1024+x] = 0xFF000000 | ( (255-pLight[i]) << 16 ) | ( (255-pOcclusion[i]) << 8 );
 		}
 	}
-	//calculates the rest of the points based on the main points
-	for ( int o = 1; o <=s; o++ )
+
+	// the first bake makes the image and binds it, after that only the baked rectangle goes up
+	int iImageID = t.terrain.imagestartindex+11;
+	if ( ImageExist ( iImageID ) == 0 )
 	{
-		int p = s-o+1;
-		int pow = powf(2,p); // replaces 2^p
-		for ( int y = 0; y <=mchunk_size; y += pow )
-		{
-			for ( int x = pow/2; x <= mchunk_size; x += pow )
-			{
-				t.terrainmatrix[x][y] = (t.terrainmatrix[x-(pow/2)][y] + t.terrainmatrix[x+(pow/2)][y])/2 + Rnd(pow*2)-pow;
-			}
-		}
-		for ( int y = pow/2; y <= mchunk_size; y += pow )
-		{
-			for ( int x = 0; x <= mchunk_size; x += pow )
-			{
-				t.terrainmatrix[x][y] = (t.terrainmatrix[x][y-(pow/2)] + t.terrainmatrix[x][y+(pow/2)])/2 + Rnd(pow*2)-pow;
-			}
-		}
-		for ( int y = pow/2; y <= mchunk_size; y += pow )
-		{
-			for ( int x = pow/2; x <= mchunk_size; x += pow )
-			{
-				t.terrainmatrix[x][y] = (t.terrainmatrix[x][y-(pow/2)] + t.terrainmatrix[x][y+(pow/2)] + t.terrainmatrix[x-(pow/2)][y] + t.terrainmatrix[x+(pow/2)][y])/4 + Rnd(pow*2)-pow;
-			}
-		}
+		CreateImageFromMemblock ( iImageID, 126 );
+		TextureObject ( t.terrain.terrainobjectindex, 7, iImageID );
+		return;
 	}
+	#ifdef DX11
+	LPGGTEXTURE pTexture = GetImagePointer ( iImageID );
+	if ( pTexture )
+	{
+		D3D11_BOX box = { (UINT)iX1, (UINT)iZ1, 0, (UINT)iX2+1, (UINT)iZ2+1, 1 };
+		m_pImmediateContext->UpdateSubresource ( pTexture, 0, &box, &pTexels[iZ1*1024+iX1], 1024*4, 0 );
+	}
+	#else
+	CreateImageFromMemblock ( iImageID, 126 );
+	#endif
+}
+
+void terrain_generateshadows ( void )
+{
+	// bake the whole map, replacing the old per texel ray march
+	if ( g_pTerrainHorizon )
+	{
+		delete g_pTerrainHorizon;
+		g_pTerrainHorizon = NULL;
+	}
+	if ( terrain_starthorizon ( ) == false ) return;
+	g_pTerrainHorizon->setSun ( t.terrain.sundirectionx_f, t.terrain.sundirectiony_f, t.terrain.sundirectionz_f );
+	terrain_bakeshadows ( );
+}
+
+void terrain_markshadows ( int iX1, int iZ1, int iX2, int iZ2 )
+{
+	// hand edited heights to the baker, they are baked once the stroke is over
+	if ( terrain_starthorizon ( ) == false ) return;
+	if ( iX1 < 0 ) iX1 = 0;
+	if ( iZ1 < 0 ) iZ1 = 0;
+	if ( iX2 > 1024 ) iX2 = 1024;
+	if ( iZ2 > 1024 ) iZ2 = 1024;
+	if ( iX1 > iX2 || iZ1 > iZ2 ) return;
+	static std::vector<float> heights;
+	heights.resize ( (iX2-iX1+1)*(iZ2-iZ1+1) );
+	BT_GetPointHeights ( t.terrain.TerrainID, iX1, iZ1, iX2-iX1+1, iZ2-iZ1+1, &heights[0] );
+	g_pTerrainHorizon->setHeights ( iX1, iZ1, iX2-iX1+1, iZ2-iZ1+1, &heights[0] );
+}
+
+void terrain_updateshadows ( void )
+{
+	// bake again only what the marked heights can reach, or everything when the sun has moved
+	if ( terrain_starthorizon ( ) == false ) return;
+	g_pTerrainHorizon->setSun ( t.terrain.sundirectionx_f, t.terrain.sundirectiony_f, t.terrain.sundirectionz_f );
+	if ( g_pTerrainHorizon->isDirty() ) terrain_bakeshadows ( );
+}
+
+void terrain_followshadowsun ( void )
+{
+	// called every frame, so a sky or sun change bakes at once rather than when the next stroke ends
+	if ( g_pTerrainHorizon == NULL || t.terrain.TerrainID == 0 ) return;
+	if ( g_pTerrainHorizon->isSun ( t.terrain.sundirectionx_f, t.terrain.sundirectiony_f, t.terrain.sundirectionz_f ) ) return;
+	terrain_updateshadows ( );
+}
+
+void generate_terrain ( int seed, int scale, int mchunk_size )
+{
+	// seeded noise and erosion in place of the diamond-square walk, the same seed
+	// always makes the same land whatever the thread count. Scale 5 to 8 gives
+	// more and taller hills
+	TerrainGeneratorSettings settings;
+	settings.seed = (unsigned int)seed;
+	settings.frequency = 4.0f + (scale - 5);
+	settings.height = scale * 80.0f;
+	settings.ridged = 0.5f;
+	settings.erosionPasses = 8;
+	settings.mapSize = mchunk_size * 50.0f;
+	int size = mchunk_size + 1;
+	static std::vector<float> heights;
+	heights.resize ( size*size );
+	TerrainGenerator generator;
+	generator.generate ( settings, &heights[0], size, g_pThreadPool );
+	for ( int z = 0; z < size; z++ )
+		for ( int x = 0; x < size; x++ )
+			t.terrainmatrix[x][z] = 100 + heights[z*size+x];
 }
 
 void generate_terrain_dave ( int seed, int scale, int mchunk_size )
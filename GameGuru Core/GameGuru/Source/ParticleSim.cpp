@@ -0,0 +1,439 @@
+#include "stdafx.h"
+#include "ParticleSim.h"
+#include "cThreadPool.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <limits.h>
+
+// gravity was taken off once per update at sixty updates a second, per millisecond that is
+#define PARTICLESIM_GRAVITY_PER_MS 0.06f
+
+// pool arrays moved together when dead particles are packed out
+static std::vector<float> ParticlePool::* const packedFields[] =
+{
+    &ParticlePool::x, &ParticlePool::y, &ParticlePool::z,
+    &ParticlePool::speedX, &ParticlePool::speedY, &ParticlePool::speedZ,
+    &ParticlePool::age, &ParticlePool::life,
+    &ParticlePool::scaleStart, &ParticlePool::scaleEnd,
+    &ParticlePool::alphaStart, &ParticlePool::alphaEnd,
+    &ParticlePool::gravityStart, &ParticlePool::gravityEnd,
+    &ParticlePool::rotZ, &ParticlePool::rotateSpeedZ,
+    &ParticlePool::frame, &ParticlePool::startFrame, &ParticlePool::endFrame,
+    &ParticlePool::animationSpeed, &ParticlePool::frameDivide,
+    &ParticlePool::scale, &ParticlePool::alpha,
+};
+static const int packedFieldCount = sizeof(packedFields) / sizeof(packedFields[0]);
+
+ParticlePool::ParticlePool()
+{
+    count = 0;
+    noWind = false;
+    recordDeaths = false;
+    deaths = 0;
+}
+
+ParticleSim::ParticleSim()
+{
+}
+
+ParticleSim::~ParticleSim()
+{
+}
+
+void ParticleSim::clear()
+{
+    pools.clear();
+    jobs.clear();
+    poolFirstDead.clear();
+    quadOffsets.clear();
+}
+
+ParticlePool& ParticleSim::getPool(int emitter)
+{
+    if (emitter >= (int)pools.size())
+        pools.resize(emitter + 1);
+    return pools[emitter];
+}
+
+int ParticleSim::getCount(int emitter) const
+{
+    if (emitter < 0 || emitter >= (int)pools.size())
+        return 0;
+    return pools[emitter].count;
+}
+
+int ParticleSim::getTotalCount() const
+{
+    int total = 0;
+    for (size_t i = 0; i < pools.size(); i++)
+        total += pools[i].count;
+    return total;
+}
+
+void ParticleSim::resetPool(int emitter)
+{
+    if (emitter < 0 || emitter >= (int)pools.size())
+        return;
+    pools[emitter].count = 0;
+    pools[emitter].deaths = 0;
+}
+
+void ParticleSim::grow(ParticlePool& pool, int newCount)
+{
+    int slots = (newCount + 3) & ~3;
+    if (slots <= (int)pool.x.size())
+        return;
+
+    // doubled so spawning stays cheap, pad lanes start with no life and are never read back
+    int size = (int)pool.x.size() * 2;
+    if (size < 64) size = 64;
+    while (size < slots) size *= 2;
+    for (int i = 0; i < packedFieldCount; i++)
+        (pool.*packedFields[i]).resize(size, 0.0f);
+    pool.flags.resize(size, 0);
+    pool.alive.resize(size, 0);
+}
+
+void ParticleSim::spawn(int emitter, const ParticleSpawn& particle)
+{
+    ParticlePool& pool = getPool(emitter);
+    grow(pool, pool.count + 1);
+
+    int i = pool.count++;
+    pool.x[i] = particle.x;
+    pool.y[i] = particle.y;
+    pool.z[i] = particle.z;
+    pool.speedX[i] = particle.speedX;
+    pool.speedY[i] = particle.speedY;
+    pool.speedZ[i] = particle.speedZ;
+    pool.age[i] = 0.0f;
+    pool.life[i] = particle.life;
+    pool.scaleStart[i] = particle.scaleStart;
+    pool.scaleEnd[i] = particle.scaleEnd;
+    pool.alphaStart[i] = particle.alphaStart;
+    pool.alphaEnd[i] = particle.alphaEnd;
+    pool.gravityStart[i] = particle.gravityStart;
+    pool.gravityEnd[i] = particle.gravityEnd;
+    pool.rotZ[i] = particle.rotZ;
+    pool.rotateSpeedZ[i] = particle.rotateSpeedZ;
+    pool.frame[i] = particle.startFrame;
+    pool.startFrame[i] = particle.startFrame;
+    pool.endFrame[i] = particle.endFrame;
+    pool.animationSpeed[i] = particle.animationSpeed;
+    pool.frameDivide[i] = particle.frameDivide > 0.0f ? particle.frameDivide : 1.0f;
+    pool.flags[i] = particle.flags;
+
+    // drawn as it was made until the next update
+    pool.scale[i] = particle.scaleStart > 0.0f ? particle.scaleStart : 0.0f;
+    pool.alpha[i] = particle.alphaStart;
+    pool.alive[i] = 1;
+}
+
+static inline __m128 selectPs(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 floorPs(__m128 v)
+{
+    // truncate then step down for negatives, particle values stay well inside int range
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.0f)));
+}
+
+void ParticleSim::simulate(Job& job, float dt, float windX, float windZ)
+{
+    // same steps and order as ravey_particles_update_particles, four particles at a time
+    ParticlePool& pool = pools[job.pool];
+    if (pool.noWind)
+    {
+        windX = 0.0f;
+        windZ = 0.0f;
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 hundred = _mm_set1_ps(100.0f);
+    const __m128 dt4 = _mm_set1_ps(dt);
+    const __m128 gravityDt = _mm_set1_ps(dt * PARTICLESIM_GRAVITY_PER_MS);
+    const __m128 windX4 = _mm_set1_ps(windX * dt);
+    const __m128 windZ4 = _mm_set1_ps(windZ * dt);
+    const __m128 full = _mm_set1_ps(360.0f);
+    const __m128 perFull = _mm_set1_ps(1.0f / 360.0f);
+    const __m128i animatedBit = _mm_set1_epi32(PARTICLESIM_ANIMATED);
+    const __m128i loopingBit = _mm_set1_epi32(PARTICLESIM_LOOPING);
+    const __m128i oneInt = _mm_set1_epi32(1);
+
+    int firstDead = INT_MAX;
+    for (int i = job.begin; i < job.end; i += 4)
+    {
+        __m128 age = _mm_add_ps(_mm_loadu_ps(&pool.age[i]), dt4);
+        __m128 life = _mm_loadu_ps(&pool.life[i]);
+        __m128 dead = _mm_cmpgt_ps(age, life);
+        _mm_storeu_ps(&pool.age[i], age);
+
+        // a zero life gives NaN here, max takes the zero
+        __m128 perc = _mm_min_ps(_mm_max_ps(_mm_div_ps(age, life), zero), one);
+
+        __m128 a0 = _mm_loadu_ps(&pool.alphaStart[i]);
+        __m128 alpha = _mm_add_ps(a0, _mm_mul_ps(perc, _mm_sub_ps(_mm_loadu_ps(&pool.alphaEnd[i]), a0)));
+        _mm_storeu_ps(&pool.alpha[i], _mm_min_ps(_mm_max_ps(alpha, zero), hundred));
+
+        __m128 s0 = _mm_loadu_ps(&pool.scaleStart[i]);
+        __m128 scale = _mm_add_ps(s0, _mm_mul_ps(perc, _mm_sub_ps(_mm_loadu_ps(&pool.scaleEnd[i]), s0)));
+        _mm_storeu_ps(&pool.scale[i], _mm_max_ps(scale, zero));
+
+        // atlas frame, held at the start, and at the end unless looping back to the start
+        __m128i flags = _mm_loadu_si128((const __m128i*)&pool.flags[i]);
+        __m128 animated = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(flags, animatedBit), animatedBit));
+        __m128 looping = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(flags, loopingBit), loopingBit));
+        __m128 frame = _mm_loadu_ps(&pool.frame[i]);
+        __m128 startFrame = _mm_loadu_ps(&pool.startFrame[i]);
+        __m128 endFrame = _mm_loadu_ps(&pool.endFrame[i]);
+        __m128 next = _mm_add_ps(frame, _mm_mul_ps(_mm_loadu_ps(&pool.animationSpeed[i]), dt4));
+        next = _mm_max_ps(next, startFrame);
+        next = selectPs(_mm_cmpgt_ps(next, endFrame), selectPs(looping, startFrame, endFrame), next);
+        _mm_storeu_ps(&pool.frame[i], selectPs(animated, next, frame));
+
+        // a particle that dies keeps where it was, split emitters spawn from there
+        __m128 g0 = _mm_loadu_ps(&pool.gravityStart[i]);
+        __m128 gravity = _mm_add_ps(g0, _mm_mul_ps(perc, _mm_sub_ps(_mm_loadu_ps(&pool.gravityEnd[i]), g0)));
+        __m128 x = _mm_loadu_ps(&pool.x[i]);
+        __m128 y = _mm_loadu_ps(&pool.y[i]);
+        __m128 z = _mm_loadu_ps(&pool.z[i]);
+        __m128 nx = _mm_add_ps(x, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&pool.speedX[i]), dt4), windX4));
+        __m128 ny = _mm_sub_ps(_mm_add_ps(y, _mm_mul_ps(_mm_loadu_ps(&pool.speedY[i]), dt4)), _mm_mul_ps(gravity, gravityDt));
+        __m128 nz = _mm_add_ps(z, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&pool.speedZ[i]), dt4), windZ4));
+        _mm_storeu_ps(&pool.x[i], selectPs(dead, x, nx));
+        _mm_storeu_ps(&pool.y[i], selectPs(dead, y, ny));
+        _mm_storeu_ps(&pool.z[i], selectPs(dead, z, nz));
+
+        // roll wrapped into 0 to 360
+        __m128 rot = _mm_add_ps(_mm_loadu_ps(&pool.rotZ[i]), _mm_mul_ps(_mm_loadu_ps(&pool.rotateSpeedZ[i]), dt4));
+        rot = _mm_sub_ps(rot, _mm_mul_ps(full, floorPs(_mm_mul_ps(rot, perFull))));
+        _mm_storeu_ps(&pool.rotZ[i], rot);
+
+        __m128i deadInt = _mm_castps_si128(dead);
+        _mm_storeu_si128((__m128i*)&pool.alive[i], _mm_andnot_si128(deadInt, oneInt));
+
+        // lanes past the pool count are padding
+        int deadMask = _mm_movemask_ps(dead);
+        if (i + 4 > pool.count)
+            deadMask &= (1 << (pool.count - i)) - 1;
+        if (deadMask && firstDead == INT_MAX)
+        {
+            unsigned long lane = 0;
+            while (!(deadMask & (1 << lane))) lane++;
+            firstDead = i + (int)lane;
+        }
+    }
+    job.firstDead = firstDead;
+}
+
+void ParticleSim::compact(ParticlePool& pool, int firstDead)
+{
+    // every array packed in turn, the write index only moves on for live particles
+    const int* alive = &pool.alive[0];
+    int count = pool.count;
+    int kept = firstDead;
+    if (pool.recordDeaths)
+    {
+        pool.deathX.resize(count);
+        pool.deathY.resize(count);
+        pool.deathZ.resize(count);
+        int deaths = 0;
+        for (int i = firstDead; i < count; i++)
+        {
+            pool.deathX[deaths] = pool.x[i];
+            pool.deathY[deaths] = pool.y[i];
+            pool.deathZ[deaths] = pool.z[i];
+            deaths += 1 - alive[i];
+        }
+        pool.deaths = deaths;
+    }
+    for (int field = 0; field < packedFieldCount; field++)
+    {
+        float* data = &(pool.*packedFields[field])[0];
+        kept = firstDead;
+        for (int i = firstDead; i < count; i++)
+        {
+            data[kept] = data[i];
+            kept += alive[i];
+        }
+    }
+    int* flags = &pool.flags[0];
+    kept = firstDead;
+    for (int i = firstDead; i < count; i++)
+    {
+        flags[kept] = flags[i];
+        kept += alive[i];
+    }
+    pool.count = kept;
+}
+
+void ParticleSim::update(float dt, float windX, float windZ, cThreadPool* pThreadPool)
+{
+    // jobs never cross pools and always cover whole groups of four
+    jobs.clear();
+    for (int p = 0; p < (int)pools.size(); p++)
+    {
+        ParticlePool& pool = pools[p];
+        pool.deaths = 0;
+        int padded = (pool.count + 3) & ~3;
+        for (int begin = 0; begin < padded; begin += PARTICLESIM_JOB_GRAIN)
+        {
+            Job job;
+            job.pool = p;
+            job.begin = begin;
+            job.end = begin + PARTICLESIM_JOB_GRAIN < padded ? begin + PARTICLESIM_JOB_GRAIN : padded;
+            job.firstDead = INT_MAX;
+            jobs.push_back(job);
+        }
+    }
+    if (jobs.empty())
+        return;
+
+    auto simulateJob = [&](int j) { simulate(jobs[j], dt, windX, windZ); };
+    if (pThreadPool)
+        pThreadPool->parallel_for(0, (int)jobs.size(), 1, simulateJob);
+    else
+        for (int j = 0; j < (int)jobs.size(); j++) simulateJob(j);
+
+    // only pools that lost particles are packed, from the first one lost
+    poolFirstDead.assign(pools.size(), INT_MAX);
+    for (size_t j = 0; j < jobs.size(); j++)
+    {
+        if (jobs[j].firstDead < poolFirstDead[jobs[j].pool])
+            poolFirstDead[jobs[j].pool] = jobs[j].firstDead;
+    }
+    auto compactPool = [&](int p)
+    {
+        if (poolFirstDead[p] != INT_MAX)
+            compact(pools[p], poolFirstDead[p]);
+    };
+    if (pThreadPool)
+        pThreadPool->parallel_for(0, (int)pools.size(), 1, compactPool);
+    else
+        for (int p = 0; p < (int)pools.size(); p++) compactPool(p);
+}
+
+static void buildQuadRange(const ParticlePool& pool, const ParticleVertexLayout& layout, float* vertices,
+                           int begin, int end, int quad, const float* camera, const float* origin, int flagMask, int flagValue)
+{
+    const float degToRad = 3.14159265f / 180.0f;
+    for (int i = begin; i < end; i++)
+    {
+        if ((pool.flags[i] & flagMask) != flagValue)
+            continue;
+
+        // faces the camera with no roll as GetAngleFromPoint does, right is flat
+        // and up follows the view, straight up or down falls back to world x
+        float px = pool.x[i] - origin[0];
+        float py = pool.y[i] - origin[1];
+        float pz = pool.z[i] - origin[2];
+        float fx = pool.x[i] - camera[0];
+        float fy = pool.y[i] - camera[1];
+        float fz = pool.z[i] - camera[2];
+        float length = sqrtf(fx * fx + fy * fy + fz * fz);
+        float flat = sqrtf(fx * fx + fz * fz);
+        float rx = 1.0f, rz = 0.0f;
+        if (flat > 0.0001f * length && flat > 0.0f)
+        {
+            rx = fz / flat;
+            rz = -fx / flat;
+        }
+        if (length > 0.0f)
+        {
+            fx /= length;
+            fy /= length;
+            fz /= length;
+        }
+        float ux = fy * rz;
+        float uy = fz * rx - fx * rz;
+        float uz = -fy * rx;
+
+        float angle = pool.rotZ[i] * degToRad;
+        float c = cosf(angle);
+        float s = sinf(angle);
+        float half = pool.scale[i] * 0.5f;
+        float ax = (c * rx + s * ux) * half;
+        float ay = (s * uy) * half;
+        float az = (c * rz + s * uz) * half;
+        float bx = (c * ux - s * rx) * half;
+        float by = (c * uy) * half;
+        float bz = (c * uz - s * rz) * half;
+
+        // atlas cell of the current frame
+        float divide = pool.frameDivide[i];
+        float cell = 1.0f / divide;
+        float frame = floorf(pool.frame[i]);
+        float row = floorf(frame / divide);
+        float column = frame - row * divide;
+        float u0 = column * cell, u1 = u0 + cell;
+        float v0 = row * cell, v1 = v0 + cell;
+        float alpha = pool.alpha[i] * 0.01f;
+
+        // top left, top right, bottom left, then top right, bottom right, bottom left
+        const float cornerX[6] = { -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f };
+        const float cornerY[6] = { 1.0f, 1.0f, -1.0f, 1.0f, -1.0f, -1.0f };
+        const float cornerU[6] = { u0, u1, u0, u1, u1, u0 };
+        const float cornerV[6] = { v0, v0, v1, v0, v1, v1 };
+        float* v = vertices + (size_t)quad * 6 * layout.stride;
+        for (int k = 0; k < 6; k++, v += layout.stride)
+        {
+            v[layout.position + 0] = px + cornerX[k] * ax + cornerY[k] * bx;
+            v[layout.position + 1] = py + cornerX[k] * ay + cornerY[k] * by;
+            v[layout.position + 2] = pz + cornerX[k] * az + cornerY[k] * bz;
+            if (layout.alpha >= 0) v[layout.alpha] = alpha;
+            v[layout.uv + 0] = cornerU[k];
+            v[layout.uv + 1] = cornerV[k];
+        }
+        quad++;
+    }
+}
+
+int ParticleSim::buildQuads(int emitter, const ParticleVertexLayout& layout, float* vertices, int maxQuads,
+                            const float* camera, const float* origin, int flagMask, int flagValue, cThreadPool* pThreadPool)
+{
+    if (emitter < 0 || emitter >= (int)pools.size())
+        return 0;
+    const ParticlePool& pool = pools[emitter];
+    int count = pool.count;
+    if (count == 0)
+        return 0;
+
+    // each job writes from where the matching particles before it end
+    int chunks = (count + PARTICLESIM_JOB_GRAIN - 1) / PARTICLESIM_JOB_GRAIN;
+    quadOffsets.resize(chunks + 1);
+    for (int c = 0; c < chunks; c++)
+    {
+        int begin = c * PARTICLESIM_JOB_GRAIN;
+        int end = begin + PARTICLESIM_JOB_GRAIN < count ? begin + PARTICLESIM_JOB_GRAIN : count;
+        int matching = end - begin;
+        if (flagMask)
+        {
+            matching = 0;
+            for (int i = begin; i < end; i++)
+                matching += (pool.flags[i] & flagMask) == flagValue;
+        }
+        quadOffsets[c + 1] = matching;
+    }
+    quadOffsets[0] = 0;
+    for (int c = 0; c < chunks; c++)
+        quadOffsets[c + 1] += quadOffsets[c];
+    if (quadOffsets[chunks] > maxQuads)
+        return 0;
+
+    auto buildChunk = [&](int c)
+    {
+        int begin = c * PARTICLESIM_JOB_GRAIN;
+        int end = begin + PARTICLESIM_JOB_GRAIN < count ? begin + PARTICLESIM_JOB_GRAIN : count;
+        buildQuadRange(pool, layout, vertices, begin, end, quadOffsets[c], camera, origin, flagMask, flagValue);
+    };
+    if (pThreadPool)
+        pThreadPool->parallel_for(0, chunks, 1, buildChunk);
+    else
+        for (int c = 0; c < chunks; c++) buildChunk(c);
+
+    return quadOffsets[chunks];
+}
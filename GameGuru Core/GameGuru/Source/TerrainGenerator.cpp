@@ -0,0 +1,279 @@
+#include "stdafx.h"
+#include "TerrainGenerator.h"
+#include "cThreadPool.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+
+// the ridged layers weight each layer by the one before, sharpening the ridge tops
+#define TERRAINGENERATOR_RIDGE_GAIN 2.0f
+
+// gradients of the noise lattice, sixteen directions round the circle
+static const float gradientX[16] =
+{
+    1.0f, 0.92388f, 0.70711f, 0.38268f, 0.0f, -0.38268f, -0.70711f, -0.92388f,
+    -1.0f, -0.92388f, -0.70711f, -0.38268f, 0.0f, 0.38268f, 0.70711f, 0.92388f
+};
+static const float gradientZ[16] =
+{
+    0.0f, 0.38268f, 0.70711f, 0.92388f, 1.0f, 0.92388f, 0.70711f, 0.38268f,
+    0.0f, -0.38268f, -0.70711f, -0.92388f, -1.0f, -0.92388f, -0.70711f, -0.38268f
+};
+
+TerrainGeneratorSettings::TerrainGeneratorSettings()
+{
+    seed = 0;
+    octaves = 8;
+    frequency = 4.0f;
+    height = 1000.0f;
+    ridged = 0.0f;
+    erosionPasses = 0;
+    talus = 0.8f;
+    erosionRate = 0.2f;
+    mapSize = 51200.0f;
+}
+
+unsigned int TerrainGeneratorHash(unsigned int seed, unsigned int stream, int x, int z)
+{
+    // each value folded in and mixed so nearby counters share no bits
+    unsigned int h = seed * 0x9E3779B9u ^ stream * 0x85EBCA6Bu;
+    h ^= (unsigned int)x * 0xC2B2AE35u;
+    h ^= h >> 16; h *= 0x7FEB352Du; h ^= h >> 15; h *= 0x846CA68Bu; h ^= h >> 16;
+    h ^= (unsigned int)z * 0x27D4EB2Fu;
+    h ^= h >> 16; h *= 0x7FEB352Du; h ^= h >> 15; h *= 0x846CA68Bu; h ^= h >> 16;
+    return h;
+}
+
+static inline __m128 floorPs(__m128 v)
+{
+    // truncate then step down for negatives, lattice coordinates stay well inside int range
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.0f)));
+}
+
+static inline __m128 absPs(__m128 v)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+void TerrainGenerator::generate(const TerrainGeneratorSettings& settings, float* heights, int size, cThreadPool* pThreadPool)
+{
+    if (heights == NULL || size < 2) return;
+
+    int jobs = (size + TERRAINGENERATOR_JOB_ROWS - 1) / TERRAINGENERATOR_JOB_ROWS;
+    auto noiseJob = [&](int job)
+    {
+        int z1 = job * TERRAINGENERATOR_JOB_ROWS;
+        int z2 = z1 + TERRAINGENERATOR_JOB_ROWS < size ? z1 + TERRAINGENERATOR_JOB_ROWS : size;
+        noiseRows(settings, heights, size, z1, z2);
+    };
+    if (pThreadPool)
+        pThreadPool->parallel_for(0, jobs, 1, noiseJob);
+    else
+        for (int job = 0; job < jobs; job++)
+            noiseJob(job);
+
+    if (settings.erosionPasses <= 0) return;
+
+    // a border of one cell a side copied from the edge, so no ground leaves the map,
+    // and room for four lanes to run past the last cell
+    workStride = size + 5;
+    for (int i = 0; i < 2; i++)
+        work[i].assign((size_t)workStride * (size + 2), 0.0f);
+    for (int z = 0; z < size; z++)
+        memcpy(&work[0][(size_t)(z + 1) * workStride + 1], heights + (size_t)z * size, size * sizeof(float));
+
+    float talus = settings.talus * settings.mapSize / (size - 1);
+    float rate = settings.erosionRate < 0.25f ? settings.erosionRate : 0.25f;
+    int from = 0;
+    for (int pass = 0; pass < settings.erosionPasses; pass++)
+    {
+        std::vector<float>& edge = work[from];
+        for (int z = 1; z <= size; z++)
+        {
+            edge[(size_t)z * workStride] = edge[(size_t)z * workStride + 1];
+            edge[(size_t)z * workStride + size + 1] = edge[(size_t)z * workStride + size];
+        }
+        memcpy(&edge[0], &edge[workStride], workStride * sizeof(float));
+        memcpy(&edge[(size_t)(size + 1) * workStride], &edge[(size_t)size * workStride], workStride * sizeof(float));
+
+        // each pass reads one buffer and writes the other, so jobs never see each other's rows
+        const float* fromWork = &work[from][0];
+        float* toWork = &work[1 - from][0];
+        auto erodeJob = [&](int job)
+        {
+            int z1 = job * TERRAINGENERATOR_JOB_ROWS;
+            int z2 = z1 + TERRAINGENERATOR_JOB_ROWS < size ? z1 + TERRAINGENERATOR_JOB_ROWS : size;
+            erodeRows(fromWork, toWork, size, z1, z2, talus, rate);
+        };
+        if (pThreadPool)
+            pThreadPool->parallel_for(0, jobs, 1, erodeJob);
+        else
+            for (int job = 0; job < jobs; job++)
+                erodeJob(job);
+        from = 1 - from;
+    }
+
+    for (int z = 0; z < size; z++)
+        memcpy(heights + (size_t)z * size, &work[from][(size_t)(z + 1) * workStride + 1], size * sizeof(float));
+}
+
+void TerrainGenerator::noiseRows(const TerrainGeneratorSettings& settings, float* heights, int size, int z1, int z2)
+{
+    int octaves = settings.octaves < 1 ? 1 : settings.octaves;
+    if (octaves > TERRAINGENERATOR_MAX_OCTAVES) octaves = TERRAINGENERATOR_MAX_OCTAVES;
+    float span = 1.0f / (size - 1);
+    float ridged = settings.ridged < 0.0f ? 0.0f : settings.ridged > 1.0f ? 1.0f : settings.ridged;
+
+    // each layer starts somewhere else on the lattice so the layers do not line up at the corner
+    float frequency[TERRAINGENERATOR_MAX_OCTAVES];
+    float amplitude[TERRAINGENERATOR_MAX_OCTAVES];
+    float offsetX[TERRAINGENERATOR_MAX_OCTAVES];
+    float offsetZ[TERRAINGENERATOR_MAX_OCTAVES];
+    int firstColumn[TERRAINGENERATOR_MAX_OCTAVES];
+    int columnCount[TERRAINGENERATOR_MAX_OCTAVES];
+    int columnStart[TERRAINGENERATOR_MAX_OCTAVES];
+    float ridgeMiddle = 0.0f;
+    int columns = 0;
+    for (int o = 0; o < octaves; o++)
+    {
+        frequency[o] = settings.frequency * (float)(1 << o);
+        amplitude[o] = settings.height / (float)(1 << o);
+        offsetX[o] = (float)(TerrainGeneratorHash(settings.seed, o, -1, 0) & 0xFF);
+        offsetZ[o] = (float)(TerrainGeneratorHash(settings.seed, o, 0, -1) & 0xFF);
+        firstColumn[o] = (int)offsetX[o];
+        columnCount[o] = (int)floorf(frequency[o] + offsetX[o]) - firstColumn[o] + 2;
+        columnStart[o] = columns;
+        columns += columnCount[o];
+        ridgeMiddle += amplitude[o] * 0.5f;
+    }
+
+    // a row sits between the same two lattice rows all the way along, so the
+    // gradients of those are looked up once a row and each lane reads its column
+    std::vector<float> gradients(columns * 4);
+    float fade[TERRAINGENERATOR_MAX_OCTAVES];
+    float across[TERRAINGENERATOR_MAX_OCTAVES];
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 six = _mm_set1_ps(6.0f);
+    const __m128 fifteen = _mm_set1_ps(15.0f);
+    const __m128 ten = _mm_set1_ps(10.0f);
+    const __m128 unit = _mm_set1_ps(1.41421f);
+    const __m128 ridgeGain = _mm_set1_ps(TERRAINGENERATOR_RIDGE_GAIN);
+    const __m128 ridged4 = _mm_set1_ps(ridged);
+    const __m128 ridgeMiddle4 = _mm_set1_ps(ridgeMiddle);
+    const __m128 span4 = _mm_set1_ps(span);
+    const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+
+    for (int z = z1; z < z2; z++)
+    {
+        float v = z * span;
+        for (int o = 0; o < octaves; o++)
+        {
+            float pz = v * frequency[o] + offsetZ[o];
+            int iz = (int)floorf(pz);
+            float fz = pz - iz;
+            across[o] = fz;
+            fade[o] = fz * fz * fz * (fz * (fz * 6.0f - 15.0f) + 10.0f);
+            float* g = &gradients[columnStart[o] * 4];
+            for (int c = 0; c < columnCount[o]; c++)
+            {
+                unsigned int nearHash = TerrainGeneratorHash(settings.seed, o, firstColumn[o] + c, iz) & 15;
+                unsigned int farHash = TerrainGeneratorHash(settings.seed, o, firstColumn[o] + c, iz + 1) & 15;
+                g[c * 4 + 0] = gradientX[nearHash];
+                g[c * 4 + 1] = gradientZ[nearHash];
+                g[c * 4 + 2] = gradientX[farHash];
+                g[c * 4 + 3] = gradientZ[farHash];
+            }
+        }
+
+        // four cells at a time, lanes past the end are worked out and left unwritten
+        float* row = heights + (size_t)z * size;
+        for (int x = 0; x < size; x += 4)
+        {
+            __m128 u = _mm_min_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), lanes), span4), one);
+            __m128 smooth = zero;
+            __m128 ridge = zero;
+            __m128 weight = one;
+            for (int o = 0; o < octaves; o++)
+            {
+                __m128 px = _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(frequency[o])), _mm_set1_ps(offsetX[o]));
+                __m128 ix = floorPs(px);
+                __m128 fx = _mm_sub_ps(px, ix);
+                __m128 fx1 = _mm_sub_ps(fx, one);
+                __m128 fz = _mm_set1_ps(across[o]);
+                __m128 fz1 = _mm_sub_ps(fz, one);
+                int column[4];
+                _mm_storeu_si128((__m128i*)column, _mm_cvttps_epi32(ix));
+                const float* g[4];
+                for (int l = 0; l < 4; l++)
+                    g[l] = &gradients[(columnStart[o] + column[l] - firstColumn[o]) * 4];
+
+                // dot of each corner's gradient with the way to the cell
+                __m128 nearLeft = _mm_add_ps(_mm_mul_ps(_mm_set_ps(g[3][0], g[2][0], g[1][0], g[0][0]), fx),
+                                             _mm_mul_ps(_mm_set_ps(g[3][1], g[2][1], g[1][1], g[0][1]), fz));
+                __m128 farLeft = _mm_add_ps(_mm_mul_ps(_mm_set_ps(g[3][2], g[2][2], g[1][2], g[0][2]), fx),
+                                            _mm_mul_ps(_mm_set_ps(g[3][3], g[2][3], g[1][3], g[0][3]), fz1));
+                __m128 nearRight = _mm_add_ps(_mm_mul_ps(_mm_set_ps(g[3][4], g[2][4], g[1][4], g[0][4]), fx1),
+                                              _mm_mul_ps(_mm_set_ps(g[3][5], g[2][5], g[1][5], g[0][5]), fz));
+                __m128 farRight = _mm_add_ps(_mm_mul_ps(_mm_set_ps(g[3][6], g[2][6], g[1][6], g[0][6]), fx1),
+                                             _mm_mul_ps(_mm_set_ps(g[3][7], g[2][7], g[1][7], g[0][7]), fz1));
+
+                __m128 sx = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(fx, fx), fx),
+                                       _mm_add_ps(_mm_mul_ps(fx, _mm_sub_ps(_mm_mul_ps(fx, six), fifteen)), ten));
+                __m128 sz = _mm_set1_ps(fade[o]);
+                __m128 nearRow = _mm_add_ps(nearLeft, _mm_mul_ps(_mm_sub_ps(nearRight, nearLeft), sx));
+                __m128 farRow = _mm_add_ps(farLeft, _mm_mul_ps(_mm_sub_ps(farRight, farLeft), sx));
+                __m128 n = _mm_add_ps(nearRow, _mm_mul_ps(_mm_sub_ps(farRow, nearRow), sz));
+
+                __m128 amplitude4 = _mm_set1_ps(amplitude[o]);
+                smooth = _mm_add_ps(smooth, _mm_mul_ps(n, amplitude4));
+
+                // ridges where the noise crosses zero, each layer held down where the one before was low
+                __m128 crest = _mm_max_ps(_mm_sub_ps(one, absPs(_mm_mul_ps(n, unit))), zero);
+                crest = _mm_mul_ps(_mm_mul_ps(crest, crest), weight);
+                weight = _mm_min_ps(_mm_mul_ps(crest, ridgeGain), one);
+                ridge = _mm_add_ps(ridge, _mm_mul_ps(crest, amplitude4));
+            }
+            __m128 h = _mm_add_ps(smooth, _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(ridge, ridgeMiddle4), smooth), ridged4));
+            float h4[4];
+            _mm_storeu_ps(h4, h);
+            for (int l = 0; l < 4 && x + l < size; l++)
+                row[x + l] = h4[l];
+        }
+    }
+}
+
+void TerrainGenerator::erodeRows(const float* from, float* to, int size, int z1, int z2, float talus, float rate)
+{
+    // ground slides to each lower neighbour past the talus, worked out the same way
+    // from both sides of a pair so nothing is made or lost
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 talus4 = _mm_set1_ps(talus);
+    const __m128 rate4 = _mm_set1_ps(rate);
+    for (int z = z1; z < z2; z++)
+    {
+        const float* row = from + (size_t)(z + 1) * workStride + 1;
+        const float* above = row - workStride;
+        const float* below = row + workStride;
+        float* out = to + (size_t)(z + 1) * workStride + 1;
+        for (int x = 0; x < size; x += 4)
+        {
+            __m128 c = _mm_loadu_ps(row + x);
+            __m128 neighbour[4] =
+            {
+                _mm_loadu_ps(row + x - 1), _mm_loadu_ps(row + x + 1),
+                _mm_loadu_ps(above + x), _mm_loadu_ps(below + x)
+            };
+            __m128 net = zero;
+            for (int n = 0; n < 4; n++)
+            {
+                __m128 gain = _mm_max_ps(_mm_sub_ps(_mm_sub_ps(neighbour[n], c), talus4), zero);
+                __m128 loss = _mm_max_ps(_mm_sub_ps(_mm_sub_ps(c, neighbour[n]), talus4), zero);
+                net = _mm_add_ps(net, _mm_sub_ps(gain, loss));
+            }
+            _mm_storeu_ps(out + x, _mm_add_ps(c, _mm_mul_ps(net, rate4)));
+        }
+    }
+}
@@ -0,0 +1,415 @@
+#include "stdafx.h"
+#include "TerrainHorizon.h"
+#include "cThreadPool.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+// height read past the edge of the map, below anything that can cast shadow
+#define TERRAINHORIZON_NONE -1.0e9f
+
+// shadow fades in over this much height under the shadow line, as a part of the spacing
+#define TERRAINHORIZON_SOFTNESS 0.25f
+
+// sunMode
+#define TERRAINHORIZON_SUN_SWEEP 0
+#define TERRAINHORIZON_SUN_OVERHEAD 1       // nothing casts shadow
+#define TERRAINHORIZON_SUN_DOWN 2           // everything is in shadow
+
+static const int directionX[TERRAINHORIZON_DIRECTIONS] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int directionZ[TERRAINHORIZON_DIRECTIONS] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+TerrainHorizon::TerrainHorizon()
+{
+    width = 0;
+    height = 0;
+    spacing = 1.0f;
+    reach = 1;
+    border = 0;
+    paddedStride = 0;
+    sunX = 0.0f;
+    sunY = 1.0f;
+    sunZ = 0.0f;
+    sunMode = TERRAINHORIZON_SUN_OVERHEAD;
+    alongX = false;
+    forward = true;
+    rows = 0;
+    lanes = 0;
+    shift = 0;
+    blend = 0.0f;
+    drop = 0.0f;
+    lineStride = 0;
+    bakeAll = false;
+    dirtyX1 = dirtyZ1 = 0;
+    dirtyX2 = dirtyZ2 = -1;
+}
+
+void TerrainHorizon::setSize(int width, int height, float spacing, int reach)
+{
+    this->width = width > 0 ? width : 0;
+    this->height = height > 0 ? height : 0;
+    this->spacing = spacing > 0.0f ? spacing : 1.0f;
+    this->reach = reach > 0 ? reach : 1;
+
+    // the occlusion reads four lanes at a time, which can run three past the last cell
+    border = this->reach + 4;
+    paddedStride = this->width + border * 2;
+    padded.assign((size_t)paddedStride * (this->height + border * 2), TERRAINHORIZON_NONE);
+    for (int z = 0; z < this->height; z++)
+        memset(&padded[(size_t)(z + border) * paddedStride + border], 0, this->width * sizeof(float));
+    transposed.assign((size_t)this->width * this->height, 0.0f);
+    light.assign((size_t)this->width * this->height, 255);
+    occlusion.assign((size_t)this->width * this->height, 255);
+
+    reachScale.resize(TERRAINHORIZON_DIRECTIONS * this->reach);
+    for (int d = 0; d < TERRAINHORIZON_DIRECTIONS; d++)
+    {
+        float length = (directionX[d] && directionZ[d]) ? this->spacing * sqrtf(2.0f) : this->spacing;
+        for (int k = 0; k < this->reach; k++)
+            reachScale[d * this->reach + k] = 1.0f / (length * (k + 1));
+    }
+
+    setupSweep();
+    bakeAll = true;
+    dirtyX1 = dirtyZ1 = 0;
+    dirtyX2 = dirtyZ2 = -1;
+}
+
+void TerrainHorizon::setSun(float x, float y, float z)
+{
+    if (x == sunX && y == sunY && z == sunZ) return;
+    sunX = x;
+    sunY = y;
+    sunZ = z;
+    setupSweep();
+    bakeAll = true;
+}
+
+void TerrainHorizon::setupSweep()
+{
+    float flat = sqrtf(sunX * sunX + sunZ * sunZ);
+    if (sunY <= 0.0f)
+        sunMode = TERRAINHORIZON_SUN_DOWN;
+    else if (flat <= sunY * 0.0001f)
+        sunMode = TERRAINHORIZON_SUN_OVERHEAD;
+    else
+        sunMode = TERRAINHORIZON_SUN_SWEEP;
+    if (sunMode != TERRAINHORIZON_SUN_SWEEP || width == 0 || height == 0)
+    {
+        rows = lanes = 0;
+        lines.clear();
+        return;
+    }
+
+    // rows run across the way the sun shines so each lane moves at most one lane a row
+    alongX = fabsf(sunX) > fabsf(sunZ);
+    float along = alongX ? sunX : sunZ;
+    float across = alongX ? sunZ : sunX;
+    rows = alongX ? width : height;
+    lanes = alongX ? height : width;
+    forward = along < 0.0f;
+    float step = across / fabsf(along);
+    shift = (int)floorf(step);
+    blend = step - shift;
+    drop = (sunY / flat) * spacing * sqrtf(1.0f + step * step);
+
+    lineStride = lanes + 4;
+    lines.assign((size_t)rows * lineStride, TERRAINHORIZON_NONE);
+    open.assign(lineStride, TERRAINHORIZON_NONE);
+    before.resize(lineStride);
+}
+
+void TerrainHorizon::setHeights(int x, int z, int width, int height, const float* data)
+{
+    int x1 = x < 0 ? 0 : x;
+    int z1 = z < 0 ? 0 : z;
+    int x2 = x + width - 1 < this->width - 1 ? x + width - 1 : this->width - 1;
+    int z2 = z + height - 1 < this->height - 1 ? z + height - 1 : this->height - 1;
+    if (x1 > x2 || z1 > z2) return;
+
+    for (int row = z1; row <= z2; row++)
+    {
+        const float* in = data + (size_t)(row - z) * width - x;
+        float* out = &padded[(size_t)(row + border) * paddedStride + border];
+        for (int col = x1; col <= x2; col++)
+        {
+            out[col] = in[col];
+            transposed[(size_t)col * this->height + row] = in[col];
+        }
+    }
+
+    if (dirtyX1 > dirtyX2)
+    {
+        dirtyX1 = x1;
+        dirtyZ1 = z1;
+        dirtyX2 = x2;
+        dirtyZ2 = z2;
+    }
+    else
+    {
+        if (x1 < dirtyX1) dirtyX1 = x1;
+        if (z1 < dirtyZ1) dirtyZ1 = z1;
+        if (x2 > dirtyX2) dirtyX2 = x2;
+        if (z2 > dirtyZ2) dirtyZ2 = z2;
+    }
+}
+
+bool TerrainHorizon::bake(cThreadPool* pThreadPool, int& x1, int& z1, int& x2, int& z2)
+{
+    if (width == 0 || height == 0 || !isDirty()) return false;
+
+    if (bakeAll)
+    {
+        if (sunMode == TERRAINHORIZON_SUN_SWEEP)
+            sweepAll(pThreadPool);
+        else
+            memset(&light[0], sunMode == TERRAINHORIZON_SUN_OVERHEAD ? 255 : 0, light.size());
+        occlude(pThreadPool, 0, 0, width - 1, height - 1);
+        x1 = z1 = 0;
+        x2 = width - 1;
+        z2 = height - 1;
+    }
+    else
+    {
+        // occlusion looks reach cells out, so that far round the change sees it
+        x1 = dirtyX1 - reach < 0 ? 0 : dirtyX1 - reach;
+        z1 = dirtyZ1 - reach < 0 ? 0 : dirtyZ1 - reach;
+        x2 = dirtyX2 + reach > width - 1 ? width - 1 : dirtyX2 + reach;
+        z2 = dirtyZ2 + reach > height - 1 ? height - 1 : dirtyZ2 + reach;
+        occlude(pThreadPool, x1, z1, x2, z2);
+
+        if (sunMode == TERRAINHORIZON_SUN_SWEEP)
+        {
+            int sx1, sz1, sx2, sz2;
+            sweepRegion(dirtyX1, dirtyZ1, dirtyX2, dirtyZ2, sx1, sz1, sx2, sz2);
+            if (sx1 < x1) x1 = sx1;
+            if (sz1 < z1) z1 = sz1;
+            if (sx2 > x2) x2 = sx2;
+            if (sz2 > z2) z2 = sz2;
+        }
+    }
+
+    bakeAll = false;
+    dirtyX1 = dirtyZ1 = 0;
+    dirtyX2 = dirtyZ2 = -1;
+    return true;
+}
+
+const float* TerrainHorizon::heightRow(int row) const
+{
+    if (alongX) return &transposed[(size_t)row * height];
+    return &padded[(size_t)(row + border) * paddedStride + border];
+}
+
+void TerrainHorizon::sweepRect(int i1, int i2, int lane1, int lane2, int& x1, int& z1, int& x2, int& z2) const
+{
+    int row1 = forward ? i1 : rows - 1 - i2;
+    int row2 = forward ? i2 : rows - 1 - i1;
+    x1 = alongX ? row1 : lane1;
+    x2 = alongX ? row2 : lane2;
+    z1 = alongX ? lane1 : row1;
+    z2 = alongX ? lane2 : row2;
+}
+
+void TerrainHorizon::sweepRow(int i, int lane1, int lane2)
+{
+    // a cell's shadow line is the line of the cell towards the sun dropped by
+    // the sun's slope over one step, or the cell itself if that is higher
+    int row = forward ? i : rows - 1 - i;
+    const float* prev = lineRow(i - 1) + shift;
+    float* line = lineRow(i);
+    const float* heights = heightRow(row);
+    unsigned char* out = alongX ? &light[row] : &light[(size_t)row * width];
+    int outStep = alongX ? width : 1;
+    float softness = 1.0f / (spacing * TERRAINHORIZON_SOFTNESS);
+
+    const __m128 blend4 = _mm_set1_ps(blend);
+    const __m128 drop4 = _mm_set1_ps(drop);
+    const __m128 softness4 = _mm_set1_ps(softness);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 full = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    int c = lane1;
+    for (; c + 3 <= lane2; c += 4)
+    {
+        __m128 a = _mm_loadu_ps(prev + c);
+        __m128 b = _mm_loadu_ps(prev + c + 1);
+        __m128 shadow = _mm_sub_ps(_mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), blend4)), drop4);
+        __m128 h = _mm_loadu_ps(heights + c);
+        _mm_storeu_ps(line + c, _mm_max_ps(h, shadow));
+        __m128 shade = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(shadow, h), softness4), zero), one);
+        __m128i lit = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(one, shade), full), half));
+        int lit4[4];
+        _mm_storeu_si128((__m128i*)lit4, lit);
+        for (int l = 0; l < 4; l++)
+            out[(size_t)(c + l) * outStep] = (unsigned char)lit4[l];
+    }
+
+    // the same steps one lane at a time, so a region matches a full sweep
+    for (; c <= lane2; c++)
+    {
+        float a = prev[c];
+        float b = prev[c + 1];
+        float shadow = (a + (b - a) * blend) - drop;
+        float h = heights[c];
+        line[c] = h > shadow ? h : shadow;
+        float shade = (shadow - h) * softness;
+        shade = shade > 0.0f ? shade : 0.0f;
+        shade = shade < 1.0f ? shade : 1.0f;
+        out[(size_t)c * outStep] = (unsigned char)(int)((1.0f - shade) * 255.0f + 0.5f);
+    }
+}
+
+void TerrainHorizon::sweepAll(cThreadPool* pThreadPool)
+{
+    // rows are handed out nearest the sun first and each follows the row before
+    // it a step of lanes behind, the lane after a step being the last one read
+    std::vector< std::atomic<int> > progress(rows);
+    for (int i = 0; i < rows; i++)
+        progress[i].store(0);
+    std::atomic<int> nextRow(0);
+    auto sweepRows = [&](int)
+    {
+        for (;;)
+        {
+            int i = nextRow.fetch_add(1);
+            if (i >= rows) break;
+            for (int lane = 0; lane < lanes; lane += TERRAINHORIZON_TILE)
+            {
+                int last = lane + TERRAINHORIZON_TILE < lanes ? lane + TERRAINHORIZON_TILE - 1 : lanes - 1;
+                if (i > 0)
+                {
+                    int ready = last + 3 < lanes ? last + 3 : lanes;
+                    while (progress[i - 1].load(std::memory_order_acquire) < ready)
+                        std::this_thread::yield();
+                }
+                sweepRow(i, lane, last);
+                progress[i].store(last + 1, std::memory_order_release);
+            }
+        }
+    };
+    if (pThreadPool)
+        pThreadPool->parallel_for(0, (int)pThreadPool->size() + 1, 1, sweepRows);
+    else
+        sweepRows(0);
+}
+
+void TerrainHorizon::sweepRegion(int x1, int z1, int x2, int z2, int& outX1, int& outZ1, int& outX2, int& outZ2)
+{
+    // rows before the change are as they were. From the first changed row on,
+    // lanes are swept again while the change is under them or their shadow
+    // line reads a lane whose line moved, stopping once past the change with
+    // no line moved
+    int row1 = alongX ? x1 : z1;
+    int row2 = alongX ? x2 : z2;
+    int lane1 = alongX ? z1 : x1;
+    int lane2 = alongX ? z2 : x2;
+    int first = forward ? row1 : rows - 1 - row2;
+    int last = forward ? row2 : rows - 1 - row1;
+
+    int lo = lane1;
+    int hi = lane2;
+    int doneLo = lane1;
+    int doneHi = lane2;
+    int doneLast = first;
+    for (int i = first; i < rows; i++)
+    {
+        if (i <= last)
+        {
+            if (lane1 < lo) lo = lane1;
+            if (lane2 > hi) hi = lane2;
+        }
+        if (lo < 0) lo = 0;
+        if (hi > lanes - 1) hi = lanes - 1;
+        if (lo > hi) break;
+
+        float* line = lineRow(i);
+        memcpy(&before[lo], &line[lo], (hi - lo + 1) * sizeof(float));
+        sweepRow(i, lo, hi);
+        if (lo < doneLo) doneLo = lo;
+        if (hi > doneHi) doneHi = hi;
+        doneLast = i;
+
+        int moved1 = hi + 1;
+        int moved2 = lo - 1;
+        for (int c = lo; c <= hi; c++)
+        {
+            if (memcmp(&line[c], &before[c], sizeof(float)) == 0) continue;
+            if (c < moved1) moved1 = c;
+            moved2 = c;
+        }
+        if (moved1 > moved2)
+        {
+            if (i >= last) break;
+            lo = lanes;
+            hi = -1;
+            continue;
+        }
+
+        // lanes whose two reads take in a moved lane
+        lo = moved1 - shift - 1;
+        hi = moved2 - shift;
+    }
+    sweepRect(first, doneLast, doneLo, doneHi, outX1, outZ1, outX2, outZ2);
+}
+
+void TerrainHorizon::occlude(cThreadPool* pThreadPool, int x1, int z1, int x2, int z2)
+{
+    int tilesX = (x2 - x1) / TERRAINHORIZON_TILE + 1;
+    int tilesZ = (z2 - z1) / TERRAINHORIZON_TILE + 1;
+    auto occludeTile = [&](int tile)
+    {
+        int tx1 = x1 + (tile % tilesX) * TERRAINHORIZON_TILE;
+        int tz1 = z1 + (tile / tilesX) * TERRAINHORIZON_TILE;
+        int tx2 = tx1 + TERRAINHORIZON_TILE - 1 < x2 ? tx1 + TERRAINHORIZON_TILE - 1 : x2;
+        int tz2 = tz1 + TERRAINHORIZON_TILE - 1 < z2 ? tz1 + TERRAINHORIZON_TILE - 1 : z2;
+        for (int z = tz1; z <= tz2; z++)
+            occludeRow(z, tx1, tx2);
+    };
+    if (pThreadPool)
+        pThreadPool->parallel_for(0, tilesX * tilesZ, 1, occludeTile);
+    else
+        for (int tile = 0; tile < tilesX * tilesZ; tile++)
+            occludeTile(tile);
+}
+
+void TerrainHorizon::occludeRow(int z, int x1, int x2)
+{
+    // the steepest rise in each direction gives the sine of its horizon, the
+    // average of those is how much sky is hidden
+    const float* row = &padded[(size_t)(z + border) * paddedStride + border];
+    unsigned char* out = &occlusion[(size_t)z * width];
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 directions = _mm_set1_ps((float)TERRAINHORIZON_DIRECTIONS);
+    const __m128 scale = _mm_set1_ps(255.0f / TERRAINHORIZON_DIRECTIONS);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (int x = x1; x <= x2; x += 4)
+    {
+        __m128 h = _mm_loadu_ps(row + x);
+        __m128 hidden = zero;
+        for (int d = 0; d < TERRAINHORIZON_DIRECTIONS; d++)
+        {
+            const float* scales = &reachScale[d * reach];
+            int step = directionZ[d] * paddedStride + directionX[d];
+            const float* p = row + x;
+            __m128 rise = zero;
+            for (int k = 0; k < reach; k++)
+            {
+                p += step;
+                rise = _mm_max_ps(rise, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p), h), _mm_set1_ps(scales[k])));
+            }
+            hidden = _mm_add_ps(hidden, _mm_div_ps(rise, _mm_sqrt_ps(_mm_add_ps(one, _mm_mul_ps(rise, rise)))));
+        }
+        __m128i open = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(directions, hidden), scale), half));
+        int open4[4];
+        _mm_storeu_si128((__m128i*)open4, open);
+        for (int l = 0; l < 4 && x + l <= x2; l++)
+            out[x + l] = (unsigned char)open4[l];
+    }
+}
@@ -0,0 +1,341 @@
+#include "stdafx.h"
+#include "TerrainUndo.h"
+#include <string.h>
+
+// packed stream tokens, the low bits of the token byte carry a length
+#define TERRAINUNDO_LITERAL 0x00            // 0x00-0x7F, one to 128 bytes copied as they are
+#define TERRAINUNDO_ZEROS 0x80              // 0x80-0xBF and a second length byte, one to 16384 zero bytes
+#define TERRAINUNDO_MATCH 0xC0              // 0xC0-0xFF and a two byte distance, four to 67 bytes copied from earlier output
+
+#define TERRAINUNDO_MAX_LITERAL 128
+#define TERRAINUNDO_MAX_ZEROS 16384
+#define TERRAINUNDO_MIN_MATCH 4
+#define TERRAINUNDO_MAX_MATCH 67
+#define TERRAINUNDO_MAX_DISTANCE 65535
+#define TERRAINUNDO_HASH_BITS 12
+
+TerrainUndo::TerrainUndo()
+{
+    memset(layers, 0, sizeof(layers));
+    recording = false;
+    applied = 0;
+    maxSteps = 64;
+    maxBytes = 64 * 1024 * 1024;
+    bytesUsed = 0;
+    pending.bytes = 0;
+}
+
+void TerrainUndo::setLayer(int layer, int width, int height, int cellSize, TerrainUndoRead read, TerrainUndoWrite write)
+{
+    if (layer < 0 || layer >= TERRAINUNDO_LAYERS) return;
+
+    // steps made against the old size would no longer line up
+    Layer& l = layers[layer];
+    if (l.width != width || l.height != height || l.cellSize != cellSize) clear();
+    l.width = width;
+    l.height = height;
+    l.cellSize = cellSize;
+    l.tilesX = (width + TERRAINUNDO_TILE - 1) / TERRAINUNDO_TILE;
+    l.tilesZ = (height + TERRAINUNDO_TILE - 1) / TERRAINUNDO_TILE;
+    l.read = read;
+    l.write = write;
+    touched[layer].assign(l.tilesX * l.tilesZ, 0);
+}
+
+void TerrainUndo::setLimits(int maxSteps, size_t maxBytes)
+{
+    this->maxSteps = maxSteps < 1 ? 1 : maxSteps;
+    this->maxBytes = maxBytes;
+    trim();
+}
+
+void TerrainUndo::clear()
+{
+    for (size_t i = 0; i < pending.tiles.size(); i++)
+    {
+        const Tile& tile = pending.tiles[i];
+        touched[tile.layer][tile.tileZ * layers[tile.layer].tilesX + tile.tileX] = 0;
+    }
+    pending.tiles.clear();
+    pending.bytes = 0;
+    recording = false;
+    steps.clear();
+    applied = 0;
+    bytesUsed = 0;
+}
+
+void TerrainUndo::beginStep()
+{
+    if (recording) endStep();
+    recording = true;
+}
+
+void TerrainUndo::touch(int layer, int x1, int z1, int x2, int z2)
+{
+    if (!recording || layer < 0 || layer >= TERRAINUNDO_LAYERS) return;
+    const Layer& l = layers[layer];
+    if (l.read == NULL) return;
+    if (x1 < 0) x1 = 0;
+    if (z1 < 0) z1 = 0;
+    if (x2 > l.width - 1) x2 = l.width - 1;
+    if (z2 > l.height - 1) z2 = l.height - 1;
+    if (x1 > x2 || z1 > z2) return;
+
+    // the first touch of a tile keeps it as it was before the stroke
+    for (int tileZ = z1 / TERRAINUNDO_TILE; tileZ <= z2 / TERRAINUNDO_TILE; tileZ++)
+    {
+        for (int tileX = x1 / TERRAINUNDO_TILE; tileX <= x2 / TERRAINUNDO_TILE; tileX++)
+        {
+            unsigned char& flag = touched[layer][tileZ * l.tilesX + tileX];
+            if (flag) continue;
+            flag = 1;
+            pending.tiles.push_back(Tile());
+            Tile& tile = pending.tiles.back();
+            tile.layer = layer;
+            tile.tileX = tileX;
+            tile.tileZ = tileZ;
+            int x, z, width, height;
+            tileRect(tile, x, z, width, height);
+            tile.data.resize(width * height * l.cellSize);
+            l.read(x, z, width, height, &tile.data[0]);
+        }
+    }
+}
+
+void TerrainUndo::endStep()
+{
+    if (!recording) return;
+    recording = false;
+
+    // tiles the stroke passed over without changing are left out
+    Step step;
+    step.bytes = sizeof(Step);
+    for (size_t i = 0; i < pending.tiles.size(); i++)
+    {
+        Tile& tile = pending.tiles[i];
+        const Layer& l = layers[tile.layer];
+        touched[tile.layer][tile.tileZ * l.tilesX + tile.tileX] = 0;
+
+        int x, z, width, height;
+        tileRect(tile, x, z, width, height);
+        int size = (int)tile.data.size();
+        current.resize(size);
+        l.read(x, z, width, height, &current[0]);
+        bool changed = false;
+        for (int b = 0; b < size; b++)
+        {
+            tile.data[b] ^= current[b];
+            if (tile.data[b]) changed = true;
+        }
+        if (!changed) continue;
+
+        TerrainUndoPack(&tile.data[0], size, l.cellSize, packed);
+        step.tiles.push_back(Tile());
+        Tile& kept = step.tiles.back();
+        kept.layer = tile.layer;
+        kept.tileX = tile.tileX;
+        kept.tileZ = tile.tileZ;
+        kept.data.assign(packed.begin(), packed.end());
+        step.bytes += sizeof(Tile) + kept.data.size();
+    }
+    pending.tiles.clear();
+    if (step.tiles.empty()) return;
+
+    // a new step ends any redo
+    while ((int)steps.size() > applied)
+    {
+        bytesUsed -= steps.back().bytes;
+        steps.pop_back();
+    }
+    bytesUsed += step.bytes;
+    steps.push_back(Step());
+    steps.back().tiles.swap(step.tiles);
+    steps.back().bytes = step.bytes;
+    applied++;
+    trim();
+}
+
+int TerrainUndo::undo()
+{
+    if (recording) endStep();
+    if (!canUndo()) return 0;
+    applied--;
+    return apply(steps[applied]);
+}
+
+int TerrainUndo::redo()
+{
+    if (recording) endStep();
+    if (!canRedo()) return 0;
+    int mask = apply(steps[applied]);
+    applied++;
+    return mask;
+}
+
+void TerrainUndo::tileRect(const Tile& tile, int& x, int& z, int& width, int& height) const
+{
+    const Layer& l = layers[tile.layer];
+    x = tile.tileX * TERRAINUNDO_TILE;
+    z = tile.tileZ * TERRAINUNDO_TILE;
+    width = l.width - x < TERRAINUNDO_TILE ? l.width - x : TERRAINUNDO_TILE;
+    height = l.height - z < TERRAINUNDO_TILE ? l.height - z : TERRAINUNDO_TILE;
+}
+
+int TerrainUndo::apply(const Step& step)
+{
+    // the difference turns the tile as it is now into how it was at the other end of the step
+    int mask = 0;
+    for (size_t i = 0; i < step.tiles.size(); i++)
+    {
+        const Tile& tile = step.tiles[i];
+        const Layer& l = layers[tile.layer];
+        int x, z, width, height;
+        tileRect(tile, x, z, width, height);
+        int size = width * height * l.cellSize;
+        current.resize(size);
+        delta.resize(size);
+        if (!TerrainUndoUnpack(&tile.data[0], (int)tile.data.size(), l.cellSize, &delta[0], size)) continue;
+        l.read(x, z, width, height, &current[0]);
+        for (int b = 0; b < size; b++)
+            current[b] ^= delta[b];
+        l.write(x, z, width, height, &current[0]);
+        mask |= 1 << tile.layer;
+    }
+    return mask;
+}
+
+void TerrainUndo::trim()
+{
+    // the newest step is always kept, even when it is over the limit on its own
+    while (steps.size() > 1 && ((int)steps.size() > maxSteps || bytesUsed > maxBytes))
+    {
+        bytesUsed -= steps.front().bytes;
+        steps.pop_front();
+        if (applied > 0) applied--;
+    }
+}
+
+void TerrainUndoPack(const unsigned char* data, int size, int cellSize, std::vector<unsigned char>& out)
+{
+    // byte planes, so the high bytes of heights that barely moved line up as zeros
+    std::vector<unsigned char> planes;
+    planes.resize(size);
+    int cells = size / cellSize;
+    for (int p = 0; p < cellSize; p++)
+        for (int c = 0; c < cells; c++)
+            planes[p * cells + c] = data[c * cellSize + p];
+
+    int hash[1 << TERRAINUNDO_HASH_BITS];
+    for (int i = 0; i < (1 << TERRAINUNDO_HASH_BITS); i++)
+        hash[i] = -1;
+
+    out.clear();
+    const unsigned char* in = planes.empty() ? NULL : &planes[0];
+    int literalStart = 0;
+    int pos = 0;
+    while (pos < size)
+    {
+        int zeros = 0;
+        while (pos + zeros < size && in[pos + zeros] == 0 && zeros < TERRAINUNDO_MAX_ZEROS)
+            zeros++;
+
+        int matchLength = 0;
+        int matchDistance = 0;
+        if (zeros < TERRAINUNDO_MIN_MATCH && pos + TERRAINUNDO_MIN_MATCH <= size)
+        {
+            unsigned int key = (in[pos] | (in[pos + 1] << 8) | (in[pos + 2] << 16) | (in[pos + 3] << 24)) * 2654435761u;
+            key >>= 32 - TERRAINUNDO_HASH_BITS;
+            int candidate = hash[key];
+            hash[key] = pos;
+            if (candidate >= 0 && pos - candidate <= TERRAINUNDO_MAX_DISTANCE)
+            {
+                while (pos + matchLength < size && matchLength < TERRAINUNDO_MAX_MATCH
+                    && in[candidate + matchLength] == in[pos + matchLength])
+                    matchLength++;
+                matchDistance = pos - candidate;
+            }
+        }
+
+        int run = 0;
+        if (zeros >= 3) run = zeros;
+        else if (matchLength >= TERRAINUNDO_MIN_MATCH) run = matchLength;
+        if (run == 0)
+        {
+            pos++;
+            if (pos - literalStart == TERRAINUNDO_MAX_LITERAL || pos == size)
+            {
+                out.push_back((unsigned char)(TERRAINUNDO_LITERAL | (pos - literalStart - 1)));
+                out.insert(out.end(), in + literalStart, in + pos);
+                literalStart = pos;
+            }
+            continue;
+        }
+
+        if (pos > literalStart)
+        {
+            out.push_back((unsigned char)(TERRAINUNDO_LITERAL | (pos - literalStart - 1)));
+            out.insert(out.end(), in + literalStart, in + pos);
+        }
+        if (run == zeros)
+        {
+            out.push_back((unsigned char)(TERRAINUNDO_ZEROS | ((zeros - 1) >> 8)));
+            out.push_back((unsigned char)((zeros - 1) & 0xFF));
+        }
+        else
+        {
+            out.push_back((unsigned char)(TERRAINUNDO_MATCH | (matchLength - TERRAINUNDO_MIN_MATCH)));
+            out.push_back((unsigned char)(matchDistance & 0xFF));
+            out.push_back((unsigned char)(matchDistance >> 8));
+        }
+        pos += run;
+        literalStart = pos;
+    }
+}
+
+bool TerrainUndoUnpack(const unsigned char* data, int size, int cellSize, unsigned char* out, int outSize)
+{
+    std::vector<unsigned char> planes;
+    planes.resize(outSize);
+    unsigned char* dst = planes.empty() ? NULL : &planes[0];
+    int pos = 0;
+    int read = 0;
+    while (read < size)
+    {
+        int token = data[read++];
+        if (token < TERRAINUNDO_ZEROS)
+        {
+            int length = (token & 0x7F) + 1;
+            if (read + length > size || pos + length > outSize) return false;
+            memcpy(dst + pos, data + read, length);
+            read += length;
+            pos += length;
+        }
+        else if (token < TERRAINUNDO_MATCH)
+        {
+            if (read + 1 > size) return false;
+            int length = (((token & 0x3F) << 8) | data[read++]) + 1;
+            if (pos + length > outSize) return false;
+            memset(dst + pos, 0, length);
+            pos += length;
+        }
+        else
+        {
+            if (read + 2 > size) return false;
+            int length = (token & 0x3F) + TERRAINUNDO_MIN_MATCH;
+            int distance = data[read] | (data[read + 1] << 8);
+            read += 2;
+            if (distance == 0 || distance > pos || pos + length > outSize) return false;
+
+            // overlapping copies repeat the bytes just written, so byte by byte
+            for (int i = 0; i < length; i++, pos++)
+                dst[pos] = dst[pos - distance];
+        }
+    }
+    if (pos != outSize) return false;
+
+    int cells = outSize / cellSize;
+    for (int p = 0; p < cellSize; p++)
+        for (int c = 0; c < cells; c++)
+            out[c * cellSize + p] = dst[p * cells + c];
+    return true;
+}
@@ -2,90 +2,286 @@
 #include "gameguru.h"
 #include "Voxelizer.h"
 #include "CObjectsC.h"
+#include "cThreadPool.h"
+#include "threading_utils.h"
+#include <math.h>
+
+// one voxelize job per mesh, vertices are taken to grid space with this matrix
+struct sVoxelizeMesh
+{
+    sMesh* pMesh;
+    GGMATRIX matWorld;
+};
 
 Voxelizer::Voxelizer(int resolution)
 {
+    // brick coordinates are packed into 10 bits each
+    if (resolution < 8) resolution = 8;
+    if (resolution > 8192) resolution = 8192;
     this->resolution = resolution;
-    voxelData.resize(resolution * resolution * resolution);
+    origin = GGVECTOR3(0.0f, 0.0f, 0.0f);
+    voxelSize = 1.0f;
 }
 
 Voxelizer::~Voxelizer()
 {
 }
 
+void Voxelizer::setBounds(const GGVECTOR3& minimum, float size)
+{
+    origin = minimum;
+    voxelSize = size > 0.0f ? size : 1.0f;
+    clear();
+}
+
+void Voxelizer::clear()
+{
+    voxels.clear();
+    for (size_t i = 0; i < threadVoxels.size(); ++i)
+        threadVoxels[i].clear();
+}
+
+static inline unsigned int BrickKey(int x, int y, int z)
+{
+    return (unsigned int)(x >> 3) | ((unsigned int)(y >> 3) << 10) | ((unsigned int)(z >> 3) << 20);
+}
+
+void Voxelizer::BrickSet::set(int x, int y, int z)
+{
+    unsigned int key = BrickKey(x, y, z);
+    std::unordered_map<unsigned int, int>::iterator it = index.find(key);
+    int brick;
+    if (it == index.end())
+    {
+        brick = (int)bricks.size();
+        Brick empty = { { 0, 0, 0, 0, 0, 0, 0, 0 } };
+        bricks.push_back(empty);
+        index[key] = brick;
+    }
+    else
+    {
+        brick = it->second;
+    }
+    bricks[brick].bits[z & 7] |= 1ULL << ((x & 7) | ((y & 7) << 3));
+}
+
+bool Voxelizer::BrickSet::get(int x, int y, int z) const
+{
+    std::unordered_map<unsigned int, int>::const_iterator it = index.find(BrickKey(x, y, z));
+    if (it == index.end())
+        return false;
+    return (bricks[it->second].bits[z & 7] & (1ULL << ((x & 7) | ((y & 7) << 3)))) != 0;
+}
+
+void Voxelizer::BrickSet::merge(const BrickSet& other)
+{
+    for (std::unordered_map<unsigned int, int>::const_iterator it = other.index.begin(); it != other.index.end(); ++it)
+    {
+        std::unordered_map<unsigned int, int>::iterator mine = index.find(it->first);
+        int brick;
+        if (mine == index.end())
+        {
+            brick = (int)bricks.size();
+            bricks.push_back(other.bricks[it->second]);
+            index[it->first] = brick;
+            continue;
+        }
+        brick = mine->second;
+        for (int w = 0; w < 8; ++w)
+            bricks[brick].bits[w] |= other.bricks[it->second].bits[w];
+    }
+}
+
+void Voxelizer::BrickSet::clear()
+{
+    index.clear();
+    bricks.clear();
+}
+
+bool Voxelizer::isOccupied(int x, int y, int z) const
+{
+    if (x < 0 || y < 0 || z < 0 || x >= resolution || y >= resolution || z >= resolution)
+        return false;
+    return voxels.get(x, y, z);
+}
+
+size_t Voxelizer::getMemoryUsage() const
+{
+    // brick payload plus an estimate of the hash map nodes and buckets
+    size_t nodeSize = sizeof(unsigned int) + sizeof(int) + 2 * sizeof(void*);
+    return voxels.bricks.capacity() * sizeof(Brick) + voxels.index.size() * nodeSize + voxels.index.bucket_count() * sizeof(void*);
+}
+
 void Voxelizer::voxelize(const std::vector<int>& objectIDs)
 {
+    // gather every mesh with the matrix taking it from object space to grid space
+    GGMATRIX matToGrid;
+    GGMatrixTranslation(&matToGrid, -origin.x, -origin.y, -origin.z);
+    GGMATRIX matScale;
+    GGMatrixScaling(&matScale, 1.0f / voxelSize, 1.0f / voxelSize, 1.0f / voxelSize);
+    GGMatrixMultiply(&matToGrid, &matToGrid, &matScale);
+
+    std::vector<sVoxelizeMesh> meshes;
     for (int objectID : objectIDs)
     {
         sObject* pObject = GetObjectData(objectID);
-        if (pObject)
+        if (pObject == NULL)
+            continue;
+
+        // instances share the mesh data of the object they instance
+        sObject* pRealObject = pObject;
+        if (pObject->pInstanceOfObject) pRealObject = pObject->pInstanceOfObject;
+        for (int f = 0; f < pRealObject->iFrameCount; ++f)
         {
-            for (int i = 0; i < pObject->iMeshCount; ++i)
+            sFrame* pFrame = pRealObject->ppFrameList[f];
+            if (pFrame == NULL || pFrame->pMesh == NULL || pFrame->pMesh->pVertexData == NULL)
+                continue;
+
+            sVoxelizeMesh mesh;
+            mesh.pMesh = pFrame->pMesh;
+            GGMatrixMultiply(&mesh.matWorld, &pFrame->matCombined, &pObject->position.matWorld);
+            GGMatrixMultiply(&mesh.matWorld, &mesh.matWorld, &matToGrid);
+            meshes.push_back(mesh);
+        }
+    }
+
+    clear();
+    int threads = g_pThreadPool ? (int)g_pThreadPool->size() + 1 : 1;
+    if ((int)threadVoxels.size() < threads)
+        threadVoxels.resize(threads);
+
+    auto voxelizeMesh = [this, &meshes](int m)
+    {
+        // each thread writes only its own bricks
+        int slot = 0;
+        cThreadPoolWorkerInfo& worker = cThreadPoolCurrentWorker();
+        if (g_pThreadPool && worker.pool == g_pThreadPool) slot = worker.index + 1;
+        BrickSet& target = threadVoxels[slot];
+
+        sMesh* pMesh = meshes[m].pMesh;
+        std::vector<GGVECTOR3> vertices(pMesh->dwVertexCount);
+        for (DWORD v = 0; v < pMesh->dwVertexCount; ++v)
+        {
+            GGVECTOR3* pPosition = (GGVECTOR3*)(pMesh->pVertexData + v * pMesh->dwFVFSize);
+            GGVec3TransformCoord(&vertices[v], pPosition, &meshes[m].matWorld);
+        }
+
+        if (pMesh->pIndices && pMesh->dwIndexCount > 0)
+        {
+            for (DWORD i = 0; i + 2 < pMesh->dwIndexCount; i += 3)
             {
-                sMesh* pMesh = pObject->ppMeshList[i];
-                for (int j = 0; j < pMesh->dwIndexCount; j += 3)
-                {
-                    sVertex* pVertex1 = (sVertex*)((BYTE*)pMesh->pVertexData + pMesh->pIndices[j] * pMesh->dwFVFSize);
-                    sVertex* pVertex2 = (sVertex*)((BYTE*)pMesh->pVertexData + pMesh->pIndices[j + 1] * pMesh->dwFVFSize);
-                    sVertex* pVertex3 = (sVertex*)((BYTE*)pMesh->pVertexData + pMesh->pIndices[j + 2] * pMesh->dwFVFSize);
-                    rasterizeTriangle(cVector3(pVertex1->x, pVertex1->y, pVertex1->z),
-                                      cVector3(pVertex2->x, pVertex2->y, pVertex2->z),
-                                      cVector3(pVertex3->x, pVertex3->y, pVertex3->z));
-                }
+                WORD i0 = pMesh->pIndices[i], i1 = pMesh->pIndices[i + 1], i2 = pMesh->pIndices[i + 2];
+                if (i0 >= pMesh->dwVertexCount || i1 >= pMesh->dwVertexCount || i2 >= pMesh->dwVertexCount)
+                    continue;
+                rasterizeTriangle(target, vertices[i0], vertices[i1], vertices[i2]);
             }
         }
+        else
+        {
+            for (DWORD v = 0; v + 2 < pMesh->dwVertexCount; v += 3)
+                rasterizeTriangle(target, vertices[v], vertices[v + 1], vertices[v + 2]);
+        }
+    };
+    if (g_pThreadPool)
+        g_pThreadPool->parallel_for(0, (int)meshes.size(), 1, voxelizeMesh);
+    else
+        for (int m = 0; m < (int)meshes.size(); ++m) voxelizeMesh(m);
+
+    for (int i = 0; i < threads; ++i)
+    {
+        voxels.merge(threadVoxels[i]);
+        threadVoxels[i].clear();
     }
 }
 
-void Voxelizer::rasterizeTriangle(const cVector3& v0, const cVector3& v1, const cVector3& v2)
+void Voxelizer::rasterizeTriangle(BrickSet& target, const GGVECTOR3& v0, const GGVECTOR3& v1, const GGVECTOR3& v2)
 {
-    // Find the bounding box of the triangle.
-    cVector3 min = v0;
-    cVector3 max = v0;
-    min.Min(v1);
-    min.Min(v2);
-    max.Max(v1);
-    max.Max(v2);
-
-    // Iterate over the voxels in the bounding box.
-    for (int z = (int)min.z; z <= (int)max.z; ++z)
+    // voxels overlapping the triangle bounds, clamped to the grid
+    float minX = v0.x, minY = v0.y, minZ = v0.z;
+    float maxX = v0.x, maxY = v0.y, maxZ = v0.z;
+    if (v1.x < minX) minX = v1.x; if (v1.x > maxX) maxX = v1.x;
+    if (v1.y < minY) minY = v1.y; if (v1.y > maxY) maxY = v1.y;
+    if (v1.z < minZ) minZ = v1.z; if (v1.z > maxZ) maxZ = v1.z;
+    if (v2.x < minX) minX = v2.x; if (v2.x > maxX) maxX = v2.x;
+    if (v2.y < minY) minY = v2.y; if (v2.y > maxY) maxY = v2.y;
+    if (v2.z < minZ) minZ = v2.z; if (v2.z > maxZ) maxZ = v2.z;
+    if (maxX < 0.0f || maxY < 0.0f || maxZ < 0.0f) return;
+    if (minX >= resolution || minY >= resolution || minZ >= resolution) return;
+
+    int x0 = minX > 0.0f ? (int)minX : 0;
+    int y0 = minY > 0.0f ? (int)minY : 0;
+    int z0 = minZ > 0.0f ? (int)minZ : 0;
+    int x1 = maxX < resolution - 1 ? (int)maxX : resolution - 1;
+    int y1 = maxY < resolution - 1 ? (int)maxY : resolution - 1;
+    int z1 = maxZ < resolution - 1 ? (int)maxZ : resolution - 1;
+
+    // a triangle inside a single voxel needs no testing
+    if (x0 == x1 && y0 == y1 && z0 == z1)
+    {
+        target.set(x0, y0, z0);
+        return;
+    }
+
+    for (int z = z0; z <= z1; ++z)
     {
-        for (int y = (int)min.y; y <= (int)max.y; ++y)
+        for (int y = y0; y <= y1; ++y)
         {
-            for (int x = (int)min.x; x <= (int)max.x; ++x)
+            for (int x = x0; x <= x1; ++x)
             {
-                // For each voxel, check if it is inside the triangle.
-                cVector3 voxelCenter(x + 0.5f, y + 0.5f, z + 0.5f);
-                if (isPointInTriangle(voxelCenter, v0, v1, v2))
-                {
-                    // If the voxel is inside the triangle, set the corresponding value in the voxel data to 1.
-                    int index = x + y * resolution + z * resolution * resolution;
-                    voxelData[index] = 1;
-                }
+                GGVECTOR3 centre(x + 0.5f, y + 0.5f, z + 0.5f);
+                if (triangleBoxOverlap(centre, v0, v1, v2))
+                    target.set(x, y, z);
             }
         }
     }
 }
 
-bool Voxelizer::isPointInTriangle(const cVector3& point, const cVector3& v0, const cVector3& v1, const cVector3& v2)
+// separating axis test of a triangle against a voxel (half size 0.5), after
+// Akenine-Moller. The box face axes are already covered by the bounds loop
+bool Voxelizer::triangleBoxOverlap(const GGVECTOR3& boxCentre, const GGVECTOR3& t0, const GGVECTOR3& t1, const GGVECTOR3& t2)
 {
-    // Compute vectors
-    cVector3 v0v1 = v1 - v0;
-    cVector3 v0v2 = v2 - v0;
-    cVector3 pv0 = point - v0;
-
-    // Compute dot products
-    float dot00 = v0v1.Dot(v0v1);
-    float dot01 = v0v1.Dot(v0v2);
-    float dot02 = v0v1.Dot(pv0);
-    float dot11 = v0v2.Dot(v0v2);
-    float dot12 = v0v2.Dot(pv0);
-
-    // Compute barycentric coordinates
-    float invDenom = 1 / (dot00 * dot11 - dot01 * dot01);
-    float u = (dot11 * dot02 - dot01 * dot12) * invDenom;
-    float v = (dot00 * dot12 - dot01 * dot02) * invDenom;
-
-    // Check if point is in triangle
-    return (u >= 0) && (v >= 0) && (u + v < 1);
+    const float h = 0.5f;
+    float v[3][3] = {
+        { t0.x - boxCentre.x, t0.y - boxCentre.y, t0.z - boxCentre.z },
+        { t1.x - boxCentre.x, t1.y - boxCentre.y, t1.z - boxCentre.z },
+        { t2.x - boxCentre.x, t2.y - boxCentre.y, t2.z - boxCentre.z } };
+    float e[3][3];
+    for (int i = 0; i < 3; ++i)
+    {
+        int n = (i + 1) % 3;
+        e[i][0] = v[n][0] - v[i][0];
+        e[i][1] = v[n][1] - v[i][1];
+        e[i][2] = v[n][2] - v[i][2];
+    }
+
+    // nine axes from the box axes crossed with the triangle edges
+    for (int i = 0; i < 3; ++i)
+    {
+        float axes[3][3] = {
+            { 0.0f, -e[i][2], e[i][1] },
+            { e[i][2], 0.0f, -e[i][0] },
+            { -e[i][1], e[i][0], 0.0f } };
+        for (int a = 0; a < 3; ++a)
+        {
+            const float* axis = axes[a];
+            float p0 = axis[0] * v[0][0] + axis[1] * v[0][1] + axis[2] * v[0][2];
+            float p1 = axis[0] * v[1][0] + axis[1] * v[1][1] + axis[2] * v[1][2];
+            float p2 = axis[0] * v[2][0] + axis[1] * v[2][1] + axis[2] * v[2][2];
+            float pMin = p0, pMax = p0;
+            if (p1 < pMin) pMin = p1; if (p1 > pMax) pMax = p1;
+            if (p2 < pMin) pMin = p2; if (p2 > pMax) pMax = p2;
+            float r = h * (fabsf(axis[0]) + fabsf(axis[1]) + fabsf(axis[2]));
+            if (pMin > r || pMax < -r)
+                return false;
+        }
+    }
+
+    // triangle plane against the box
+    float normal[3] = {
+        e[0][1] * e[1][2] - e[0][2] * e[1][1],
+        e[0][2] * e[1][0] - e[0][0] * e[1][2],
+        e[0][0] * e[1][1] - e[0][1] * e[1][0] };
+    float d = normal[0] * v[0][0] + normal[1] * v[0][1] + normal[2] * v[0][2];
+    float r = h * (fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]));
+    return fabsf(d) <= r;
 }
@@ -0,0 +1,19 @@
+//
+// Guru-Tests - standalone checks and benchmarks for engine modules that run without a device
+//
+
+#pragma once
+
+// every test prints its results and returns how many checks failed
+int OcclusionRasterizerTest ( void );
+int ParticleSimTest ( void );
+int TerrainUndoTest ( void );
+int TerrainSmoothingTest ( void );
+int TerrainHorizonTest ( void );
+int TerrainGeneratorTest ( void );
+
+// prints the check and returns 1 if it failed, so results can be summed
+int GuruCheck ( bool bPassed, const char* pDescription );
+
+// milliseconds from an arbitrary start, for timings
+double GuruTimeMS ( void );
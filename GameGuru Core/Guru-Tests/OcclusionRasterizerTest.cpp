@@ -0,0 +1,228 @@
+//
+// Occlusion Rasterizer Test
+//
+
+#include "stdafx.h"
+#include "GuruTests.h"
+#include "OcclusionRasterizer.h"
+#include "cThreadPool.h"
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// a grid of buildings seen from a street corner, and scattered props to cull behind them
+#define OCCTEST_GRID			60
+#define OCCTEST_SPACING			60.0f
+#define OCCTEST_BOXES			20000
+#define OCCTEST_WIDTH			512
+#define OCCTEST_HEIGHT			288
+#define OCCTEST_FRAMES			50
+#define OCCTEST_THREADS			4
+
+namespace
+{
+	float RandomFloat ( void )
+	{
+		return rand ( ) / (float) RAND_MAX;
+	}
+
+	void Normalize ( float* v )
+	{
+		float fLength = sqrtf ( v[0]*v[0] + v[1]*v[1] + v[2]*v[2] );
+		v[0] /= fLength; v[1] /= fLength; v[2] /= fLength;
+	}
+
+	void Cross ( const float* a, const float* b, float* out )
+	{
+		out[0] = a[1]*b[2] - a[2]*b[1];
+		out[1] = a[2]*b[0] - a[0]*b[2];
+		out[2] = a[0]*b[1] - a[1]*b[0];
+	}
+
+	// left handed look at times perspective, row vectors as the rasterizer expects
+	void ViewProjection ( const float* eye, const float* at, float fFOV, float fAspect, float fNear, float fFar, float* out )
+	{
+		float up[3] = { 0, 1, 0 };
+		float z[3] = { at[0]-eye[0], at[1]-eye[1], at[2]-eye[2] };
+		Normalize ( z );
+		float x[3];
+		Cross ( up, z, x );
+		Normalize ( x );
+		float y[3];
+		Cross ( z, x, y );
+		float view[16] =
+		{
+			x[0], y[0], z[0], 0,
+			x[1], y[1], z[1], 0,
+			x[2], y[2], z[2], 0,
+			-(x[0]*eye[0] + x[1]*eye[1] + x[2]*eye[2]), -(y[0]*eye[0] + y[1]*eye[1] + y[2]*eye[2]), -(z[0]*eye[0] + z[1]*eye[1] + z[2]*eye[2]), 1
+		};
+		float fYScale = 1.0f / tanf ( fFOV / 2 );
+		float fXScale = fYScale / fAspect;
+		float proj[16] =
+		{
+			fXScale, 0, 0, 0,
+			0, fYScale, 0, 0,
+			0, 0, fFar / (fFar - fNear), 1,
+			0, 0, -fNear * fFar / (fFar - fNear), 0
+		};
+		for ( int r = 0; r < 4; r++ )
+		{
+			for ( int c = 0; c < 4; c++ )
+			{
+				out[r*4+c] = 0;
+				for ( int k = 0; k < 4; k++ ) out[r*4+c] += view[r*4+k] * proj[k*4+c];
+			}
+		}
+	}
+
+	// twelve triangles, clockwise seen from outside
+	void AddBoxTriangles ( const float* box, std::vector<float>& triangles )
+	{
+		float corner[8][3];
+		for ( int i = 0; i < 8; i++ )
+		{
+			corner[i][0] = box[(i & 1) ? 3 : 0];
+			corner[i][1] = box[(i & 2) ? 4 : 1];
+			corner[i][2] = box[(i & 4) ? 5 : 2];
+		}
+		static const int face[6][4] = { {0,2,3,1}, {4,5,7,6}, {0,1,5,4}, {2,6,7,3}, {0,4,6,2}, {1,3,7,5} };
+		for ( int f = 0; f < 6; f++ )
+		{
+			const int tri[2][3] = { { face[f][0], face[f][1], face[f][2] }, { face[f][0], face[f][2], face[f][3] } };
+			for ( int t = 0; t < 2; t++ )
+				for ( int k = 0; k < 3; k++ )
+					triangles.insert ( triangles.end(), corner[tri[t][k]], corner[tri[t][k]] + 3 );
+		}
+	}
+
+	// projects the corners and scans every pixel of the screen rectangle, no blocks or early outs
+	int BruteForceTestBox ( const float* box, const float* m, const float* pDepth, int iPitch )
+	{
+		float fMinX = 1e9f, fMaxX = -1e9f, fMinY = 1e9f, fMaxY = -1e9f, fNearest = 0;
+		for ( int c = 0; c < 8; c++ )
+		{
+			float p[3] = { box[(c & 1) ? 3 : 0], box[(c & 2) ? 4 : 1], box[(c & 4) ? 5 : 2] };
+			float x = p[0]*m[0] + p[1]*m[4] + p[2]*m[8] + m[12];
+			float y = p[0]*m[1] + p[1]*m[5] + p[2]*m[9] + m[13];
+			float w = p[0]*m[3] + p[1]*m[7] + p[2]*m[11] + m[15];
+			if ( w < 1.0f ) return -1;
+			float sx = ( x / w + 1 ) * OCCTEST_WIDTH / 2;
+			float sy = ( 1 - y / w ) * OCCTEST_HEIGHT / 2;
+			fMinX = fminf ( fMinX, sx ); fMaxX = fmaxf ( fMaxX, sx );
+			fMinY = fminf ( fMinY, sy ); fMaxY = fmaxf ( fMaxY, sy );
+			fNearest = fmaxf ( fNearest, 1 / w );
+		}
+		int x0 = fMinX < 0 ? 0 : (int) fMinX;
+		int x1 = fMaxX > OCCTEST_WIDTH - 1 ? OCCTEST_WIDTH - 1 : (int) fMaxX;
+		int y0 = fMinY < 0 ? 0 : (int) fMinY;
+		int y1 = fMaxY > OCCTEST_HEIGHT - 1 ? OCCTEST_HEIGHT - 1 : (int) fMaxY;
+		for ( int y = y0; y <= y1; y++ )
+			for ( int x = x0; x <= x1; x++ )
+				if ( pDepth[y * iPitch + x] < fNearest ) return OCCLUSION_VISIBLE;
+		return OCCLUSION_HIDDEN;
+	}
+}
+
+int OcclusionRasterizerTest ( void )
+{
+	int iFailed = 0;
+	srand ( 1 );
+
+	std::vector<float> triangles;
+	int iOccluders = 0;
+	for ( int gx = 0; gx < OCCTEST_GRID; gx++ )
+	{
+		for ( int gz = 0; gz < OCCTEST_GRID; gz++ )
+		{
+			float fX = gx * OCCTEST_SPACING - 1800.0f;
+			float fZ = gz * OCCTEST_SPACING - 1800.0f;
+			float fHeight = 20.0f + RandomFloat ( ) * 150.0f;
+			float fWidth = 20.0f + RandomFloat ( ) * 25.0f;
+			float box[6] = { fX, 0, fZ, fX + fWidth, fHeight, fZ + fWidth };
+			AddBoxTriangles ( box, triangles );
+			iOccluders++;
+		}
+	}
+	int iTriangles = (int) triangles.size ( ) / 9;
+
+	std::vector<float> boxes;
+	for ( int i = 0; i < OCCTEST_BOXES; i++ )
+	{
+		float fX = RandomFloat ( ) * 3600.0f - 1800.0f;
+		float fZ = RandomFloat ( ) * 3600.0f - 1800.0f;
+		float fSize = 1.0f + RandomFloat ( ) * 6.0f;
+		float box[6] = { fX, 0, fZ, fX + fSize, fSize, fZ + fSize };
+		boxes.insert ( boxes.end ( ), box, box + 6 );
+	}
+
+	float eye[3] = { -1500, 120, -1400 };
+	float at[3] = { 0, 0, 0 };
+	float matrix[16];
+	ViewProjection ( eye, at, 1.0f, OCCTEST_WIDTH / (float) OCCTEST_HEIGHT, 1.0f, 5000.0f, matrix );
+
+	cOcclusionRasterizer raster;
+	raster.setResolution ( OCCTEST_WIDTH, OCCTEST_HEIGHT );
+
+	// closed boxes give the same depth whether back faces are culled or not
+	raster.begin ( matrix, 1.0f );
+	raster.addTriangles ( &triangles[0], iTriangles );
+	raster.render ( NULL );
+	std::vector<float> culledDepth ( raster.getDepth ( ), raster.getDepth ( ) + raster.getDepthPitch ( ) * OCCTEST_HEIGHT );
+	raster.setBackfaceCulling ( false );
+	raster.begin ( matrix, 1.0f );
+	raster.addTriangles ( &triangles[0], iTriangles );
+	raster.render ( NULL );
+	int iDepthDiffs = 0;
+	for ( size_t i = 0; i < culledDepth.size ( ); i++ )
+		if ( fabsf ( culledDepth[i] - raster.getDepth ( )[i] ) > 1e-6f * fabsf ( culledDepth[i] ) + 1e-9f ) iDepthDiffs++;
+	iFailed += GuruCheck ( iDepthDiffs == 0, "back face culling leaves the depth buffer unchanged" );
+
+	// every box result agrees with a full scan of its screen rectangle
+	raster.setBackfaceCulling ( true );
+	raster.begin ( matrix, 1.0f );
+	raster.addTriangles ( &triangles[0], iTriangles );
+	raster.render ( NULL );
+	std::vector<unsigned char> results ( OCCTEST_BOXES );
+	raster.testBoxes ( &boxes[0], OCCTEST_BOXES, &results[0], NULL );
+	int iMismatches = 0;
+	for ( int i = 0; i < OCCTEST_BOXES; i++ )
+	{
+		if ( results[i] == OCCLUSION_OUTSIDE ) continue;
+		int iExpected = BruteForceTestBox ( &boxes[i*6], matrix, raster.getDepth ( ), raster.getDepthPitch ( ) );
+		if ( iExpected >= 0 && iExpected != results[i] ) iMismatches++;
+	}
+	unsigned int dwHidden = raster.getStat ( OCCLUSION_STAT_HIDDEN );
+	unsigned int dwOutside = raster.getStat ( OCCLUSION_STAT_OUTSIDE );
+	printf ( "  %d boxes, %u hidden, %u outside\n", OCCTEST_BOXES, dwHidden, dwOutside );
+	iFailed += GuruCheck ( iMismatches == 0, "box tests match a brute force pixel scan" );
+	iFailed += GuruCheck ( dwHidden > 0, "some boxes are hidden behind the occluders" );
+
+	// timings serial and pooled, the pool must give the same results
+	cThreadPool pool ( OCCTEST_THREADS );
+	std::vector<unsigned char> pooledResults ( OCCTEST_BOXES );
+	for ( int iPass = 0; iPass < 2; iPass++ )
+	{
+		cThreadPool* pPool = iPass == 0 ? NULL : &pool;
+		double fStart = GuruTimeMS ( );
+		for ( int f = 0; f < OCCTEST_FRAMES; f++ )
+		{
+			raster.begin ( matrix, 1.0f );
+			raster.addTriangles ( &triangles[0], iTriangles );
+			raster.render ( pPool );
+		}
+		double fRendered = GuruTimeMS ( );
+		for ( int f = 0; f < OCCTEST_FRAMES; f++ )
+			raster.testBoxes ( &boxes[0], OCCTEST_BOXES, &pooledResults[0], pPool );
+		double fTested = GuruTimeMS ( );
+		double fRenderMS = ( fRendered - fStart ) / OCCTEST_FRAMES;
+		double fTestMS = ( fTested - fRendered ) / OCCTEST_FRAMES;
+		printf ( "  %s: %.2f ms to render %d occluders (%.0f per ms), %.2f ms to test %d boxes (%.0f per ms)\n",
+			pPool ? "pooled" : "serial", fRenderMS, iOccluders, iOccluders / fRenderMS, fTestMS, OCCTEST_BOXES, OCCTEST_BOXES / fTestMS );
+		iFailed += GuruCheck ( memcmp ( &results[0], &pooledResults[0], OCCTEST_BOXES ) == 0, pPool ? "pooled results match" : "repeated results match" );
+	}
+
+	return iFailed;
+}
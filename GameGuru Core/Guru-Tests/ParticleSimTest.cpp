@@ -0,0 +1,249 @@
+//
+// Particle Simulation Test
+//
+
+#include "stdafx.h"
+#include "GuruTests.h"
+#include "ParticleSim.h"
+#include "cThreadPool.h"
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// a mixed emitter checked step by step, and four full pools for the timings
+#define PARTTEST_PARTICLES		1000
+#define PARTTEST_STEPS			300
+#define PARTTEST_STEPMS			16.7f
+#define PARTTEST_WINDX			0.01f
+#define PARTTEST_WINDZ			-0.02f
+#define PARTTEST_TOLERANCE		1e-2
+#define PARTTEST_BENCHPOOLS		4
+#define PARTTEST_BENCHSIZE		50000
+#define PARTTEST_FRAMES			200
+#define PARTTEST_QUADFRAMES		20
+#define PARTTEST_THREADS		4
+
+namespace
+{
+	float RandomRange ( float fMin, float fMax )
+	{
+		return fMin + ( fMax - fMin ) * rand ( ) / (float) RAND_MAX;
+	}
+
+	// one particle as the per object path updated it, kept in spawn order
+	struct sReferenceParticle
+	{
+		ParticleSpawn spawn;
+		float fAge;
+		float fFrame;
+		float fScale;
+		float fAlpha;
+	};
+
+	float Clamp ( float v, float fMin, float fMax )
+	{
+		return v < fMin ? fMin : ( v > fMax ? fMax : v );
+	}
+
+	// scalar update, the simulator must give the same particles, deaths and values
+	void ReferenceUpdate ( std::vector<sReferenceParticle>& particles, float dt, float fWindX, float fWindZ, std::vector<float>& deathX )
+	{
+		std::vector<sReferenceParticle> survivors;
+		deathX.clear ( );
+		for ( size_t i = 0; i < particles.size ( ); i++ )
+		{
+			sReferenceParticle q = particles[i];
+			ParticleSpawn& p = q.spawn;
+			q.fAge += dt;
+			if ( q.fAge > p.life )
+			{
+				deathX.push_back ( p.x );
+				continue;
+			}
+			float fPerc = Clamp ( q.fAge / p.life, 0, 1 );
+			q.fAlpha = Clamp ( p.alphaStart + fPerc * ( p.alphaEnd - p.alphaStart ), 0, 100 );
+			q.fScale = std::max ( p.scaleStart + fPerc * ( p.scaleEnd - p.scaleStart ), 0.0f );
+			if ( p.flags & PARTICLESIM_ANIMATED )
+			{
+				q.fFrame += p.animationSpeed * dt;
+				if ( q.fFrame < p.startFrame ) q.fFrame = p.startFrame;
+				if ( q.fFrame > p.endFrame ) q.fFrame = ( p.flags & PARTICLESIM_LOOPING ) ? p.startFrame : p.endFrame;
+			}
+			float fGravity = p.gravityStart + fPerc * ( p.gravityEnd - p.gravityStart );
+			p.x += p.speedX * dt + fWindX * dt;
+			p.y += p.speedY * dt - fGravity * dt * 0.06f;
+			p.z += p.speedZ * dt + fWindZ * dt;
+			p.rotZ += p.rotateSpeedZ * dt;
+			p.rotZ -= 360.0f * floorf ( p.rotZ / 360.0f );
+			survivors.push_back ( q );
+		}
+		particles.swap ( survivors );
+	}
+
+	void FillBenchPools ( ParticleSim& sim )
+	{
+		srand ( 2 );
+		for ( int e = 0; e < PARTTEST_BENCHPOOLS; e++ )
+		{
+			for ( int i = 0; i < PARTTEST_BENCHSIZE; i++ )
+			{
+				ParticleSpawn p;
+				memset ( &p, 0, sizeof(p) );
+				p.x = RandomRange ( -5, 5 );
+				p.speedY = 0.1f;
+				p.life = RandomRange ( 1000, 100000 );
+				p.scaleStart = 10;
+				p.scaleEnd = 40;
+				p.alphaStart = 100;
+				p.frameDivide = 8;
+				p.endFrame = 63;
+				p.animationSpeed = 0.03f;
+				p.flags = PARTICLESIM_ANIMATED | PARTICLESIM_LOOPING;
+				p.rotateSpeedZ = 0.1f;
+				sim.spawn ( e, p );
+			}
+		}
+	}
+}
+
+int ParticleSimTest ( void )
+{
+	int iFailed = 0;
+	srand ( 1 );
+
+	// every kind of particle in one emitter, animated, looping, growing, shrinking and fading
+	ParticleSim sim;
+	std::vector<sReferenceParticle> reference;
+	for ( int i = 0; i < PARTTEST_PARTICLES; i++ )
+	{
+		ParticleSpawn p;
+		p.x = RandomRange ( -5, 5 ); p.y = RandomRange ( 0, 5 ); p.z = RandomRange ( -5, 5 );
+		p.speedX = RandomRange ( -1, 1 ) * 0.06f; p.speedY = RandomRange ( 0, 2 ) * 0.06f; p.speedZ = RandomRange ( -1, 1 ) * 0.06f;
+		p.life = RandomRange ( 100, 3000 );
+		p.scaleStart = RandomRange ( 10, 50 ); p.scaleEnd = RandomRange ( -10, 100 );
+		p.alphaStart = RandomRange ( 0, 120 ); p.alphaEnd = RandomRange ( -20, 100 );
+		p.gravityStart = RandomRange ( 0, 1 ); p.gravityEnd = RandomRange ( 0, 2 );
+		p.rotZ = RandomRange ( 0, 360 ); p.rotateSpeedZ = RandomRange ( -5, 5 );
+		p.startFrame = 3; p.endFrame = 12; p.animationSpeed = 0.03f; p.frameDivide = 4;
+		p.flags = ( i % 3 == 0 ? PARTICLESIM_ANIMATED : 0 ) | ( i % 2 ? PARTICLESIM_LOOPING : 0 );
+		sim.spawn ( 0, p );
+		sReferenceParticle q;
+		q.spawn = p;
+		q.fAge = 0;
+		q.fFrame = p.startFrame;
+		q.fScale = 0;
+		q.fAlpha = 0;
+		reference.push_back ( q );
+	}
+	sim.getPool ( 0 ).recordDeaths = true;
+
+	// compare every step against the scalar update
+	int iCountMismatches = 0;
+	int iTotalDeaths = 0;
+	double fMaxError = 0;
+	std::vector<float> deathX;
+	for ( int iStep = 0; iStep < PARTTEST_STEPS; iStep++ )
+	{
+		sim.update ( PARTTEST_STEPMS, PARTTEST_WINDX, PARTTEST_WINDZ, NULL );
+		ReferenceUpdate ( reference, PARTTEST_STEPMS, PARTTEST_WINDX, PARTTEST_WINDZ, deathX );
+		const ParticlePool& pool = sim.getPool ( 0 );
+		if ( pool.count != (int) reference.size ( ) || pool.deaths != (int) deathX.size ( ) )
+		{
+			iCountMismatches++;
+			break;
+		}
+		for ( int d = 0; d < pool.deaths; d++ )
+			fMaxError = std::max ( fMaxError, (double) fabsf ( pool.deathX[d] - deathX[d] ) );
+		for ( int i = 0; i < pool.count; i++ )
+		{
+			const sReferenceParticle& q = reference[i];
+			float fErrors[7] =
+			{
+				pool.x[i] - q.spawn.x, pool.y[i] - q.spawn.y, pool.z[i] - q.spawn.z,
+				pool.alpha[i] - q.fAlpha, pool.scale[i] - q.fScale, pool.frame[i] - q.fFrame, pool.rotZ[i] - q.spawn.rotZ
+			};
+			for ( int e = 0; e < 7; e++ ) fMaxError = std::max ( fMaxError, (double) fabsf ( fErrors[e] ) );
+		}
+		iTotalDeaths += pool.deaths;
+	}
+	printf ( "  %d deaths over %d steps, largest difference %g\n", iTotalDeaths, PARTTEST_STEPS, fMaxError );
+	iFailed += GuruCheck ( iCountMismatches == 0, "live and dead counts match the scalar update every step" );
+	iFailed += GuruCheck ( iTotalDeaths == PARTTEST_PARTICLES, "every particle died in order" );
+	iFailed += GuruCheck ( fMaxError < PARTTEST_TOLERANCE, "positions, alpha, scale, frame and roll match the scalar update" );
+
+	// quads are only written for particles whose flags match, with the alpha scaled to one
+	ParticleSim quadSim;
+	for ( int i = 0; i < 10; i++ )
+	{
+		ParticleSpawn p;
+		memset ( &p, 0, sizeof(p) );
+		p.x = (float) i;
+		p.life = 100;
+		p.scaleStart = 2;
+		p.scaleEnd = 2;
+		p.alphaStart = 50;
+		p.alphaEnd = 50;
+		p.frameDivide = 2;
+		p.startFrame = 3;
+		p.flags = ( i & 1 ) ? PARTICLESIM_SECONDIMAGE : 0;
+		quadSim.spawn ( 0, p );
+	}
+	quadSim.update ( 1, 0, 0, NULL );
+	ParticleVertexLayout layout = { 9, 0, 6, 7 };
+	std::vector<float> quadVertices ( layout.stride * 6 * 10 );
+	float camera[3] = { 0, 0, -10 };
+	float origin[3] = { 0, 0, 0 };
+	int iQuads = quadSim.buildQuads ( 0, layout, &quadVertices[0], 10, camera, origin, PARTICLESIM_SECONDIMAGE, PARTICLESIM_SECONDIMAGE, NULL );
+	bool bQuadValues = true;
+	for ( int v = 0; v < iQuads * 6; v++ )
+	{
+		const float* pVertex = &quadVertices[v * layout.stride];
+		if ( fabsf ( pVertex[layout.alpha] - 0.5f ) > 1e-6f ) bQuadValues = false;
+		if ( pVertex[layout.uv] < 0.5f || pVertex[layout.uv] > 1.0f ) bQuadValues = false;
+		if ( pVertex[layout.uv+1] < 0.5f || pVertex[layout.uv+1] > 1.0f ) bQuadValues = false;
+	}
+	iFailed += GuruCheck ( iQuads == 5, "only the second image particles are built" );
+	iFailed += GuruCheck ( bQuadValues, "quad alpha and frame cell uvs are right" );
+	iFailed += GuruCheck ( quadSim.buildQuads ( 0, layout, &quadVertices[0], 4, camera, origin, PARTICLESIM_SECONDIMAGE, PARTICLESIM_SECONDIMAGE, NULL ) == 0, "nothing is built when the quads do not fit" );
+
+	// timings serial and pooled, the pool must give the same particles and quads
+	cThreadPool threadPool ( PARTTEST_THREADS );
+	ParticleVertexLayout benchLayout = { 9, 0, 6, 7 };
+	float benchCamera[3] = { 0, 10, -50 };
+	std::vector<float> serialVertices;
+	std::vector<float> serialX;
+	for ( int iPass = 0; iPass < 2; iPass++ )
+	{
+		cThreadPool* pPool = iPass == 0 ? NULL : &threadPool;
+		ParticleSim bench;
+		FillBenchPools ( bench );
+		double fStart = GuruTimeMS ( );
+		for ( int f = 0; f < PARTTEST_FRAMES; f++ )
+			bench.update ( PARTTEST_STEPMS, PARTTEST_WINDX, 0, pPool );
+		double fUpdated = GuruTimeMS ( );
+		std::vector<float> vertices ( (size_t) PARTTEST_BENCHPOOLS * PARTTEST_BENCHSIZE * 6 * benchLayout.stride );
+		for ( int f = 0; f < PARTTEST_QUADFRAMES; f++ )
+			for ( int e = 0; e < PARTTEST_BENCHPOOLS; e++ )
+				bench.buildQuads ( e, benchLayout, &vertices[(size_t) e * PARTTEST_BENCHSIZE * 6 * benchLayout.stride], PARTTEST_BENCHSIZE, benchCamera, origin, 0, 0, pPool );
+		double fBuilt = GuruTimeMS ( );
+		printf ( "  %s: %.3f ms to update %d particles, %.3f ms to build their quads\n",
+			pPool ? "pooled" : "serial", ( fUpdated - fStart ) / PARTTEST_FRAMES, bench.getTotalCount ( ), ( fBuilt - fUpdated ) / PARTTEST_QUADFRAMES );
+		const ParticlePool& pool = bench.getPool ( 0 );
+		if ( pPool == NULL )
+		{
+			serialVertices.swap ( vertices );
+			serialX.assign ( pool.x.begin ( ), pool.x.begin ( ) + pool.count );
+		}
+		else
+		{
+			bool bSameParticles = pool.count == (int) serialX.size ( ) && memcmp ( &pool.x[0], &serialX[0], serialX.size ( ) * sizeof(float) ) == 0;
+			iFailed += GuruCheck ( bSameParticles, "pooled update matches serial" );
+			iFailed += GuruCheck ( vertices == serialVertices, "pooled quads match serial" );
+		}
+	}
+
+	return iFailed;
+}
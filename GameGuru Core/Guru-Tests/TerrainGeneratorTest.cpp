@@ -0,0 +1,117 @@
+//
+// Terrain Generator Test
+//
+
+#include "stdafx.h"
+#include "GuruTests.h"
+#include "TerrainGenerator.h"
+#include "cThreadPool.h"
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+// the full size map and the preview the generator panel draws
+#define GENTEST_SIZE			1025
+#define GENTEST_PREVIEW			129
+#define GENTEST_EROSION			20
+#define GENTEST_SEEDS			4
+#define GENTEST_THREADS			3
+
+namespace
+{
+	// checksums of the heights with default settings and ridged set to a quarter of the seed,
+	// any change to the noise or erosion that moves a single height changes these. The rolling
+	// hills of seed one are under the talus everywhere, so erosion leaves them as they are
+	struct sGolden
+	{
+		unsigned int dwSeed;
+		unsigned int dwHeights;
+		unsigned int dwEroded;
+	};
+
+	const sGolden g_Golden[GENTEST_SEEDS] =
+	{
+		{ 1, 0x1d1de966, 0x1d1de966 },
+		{ 2, 0x8635fb21, 0xe2987371 },
+		{ 3, 0xf45031df, 0x44c17ced },
+		{ 4, 0xf0185a91, 0x4ab2fbdf },
+	};
+
+	unsigned int Checksum ( const std::vector<float>& heights )
+	{
+		const unsigned char* pBytes = (const unsigned char*) &heights[0];
+		unsigned int dwHash = 2166136261u;
+		for ( size_t i = 0; i < heights.size ( ) * sizeof(float); i++ )
+		{
+			dwHash ^= pBytes[i];
+			dwHash *= 16777619u;
+		}
+		return dwHash;
+	}
+
+	bool AllFinite ( const std::vector<float>& heights )
+	{
+		for ( size_t i = 0; i < heights.size ( ); i++ )
+			if ( heights[i] != heights[i] || heights[i] > 1e30f || heights[i] < -1e30f ) return false;
+		return true;
+	}
+}
+
+int TerrainGeneratorTest ( void )
+{
+	int iFailed = 0;
+	cThreadPool pool ( GENTEST_THREADS );
+	TerrainGenerator generator;
+	std::vector<float> serial ( GENTEST_SIZE*GENTEST_SIZE );
+	std::vector<float> pooled ( GENTEST_SIZE*GENTEST_SIZE );
+	std::vector<float> preview ( GENTEST_PREVIEW*GENTEST_PREVIEW );
+	int iStep = ( GENTEST_SIZE - 1 ) / ( GENTEST_PREVIEW - 1 );
+
+	for ( int s = 0; s < GENTEST_SEEDS; s++ )
+	{
+		char pDescription[128];
+		TerrainGeneratorSettings settings;
+		settings.seed = g_Golden[s].dwSeed;
+		settings.ridged = g_Golden[s].dwSeed / 4.0f;
+
+		// noise alone, serial and pooled must be the same heights as always
+		double fStart = GuruTimeMS ( );
+		generator.generate ( settings, &serial[0], GENTEST_SIZE, NULL );
+		double fSerialMS = GuruTimeMS ( ) - fStart;
+		fStart = GuruTimeMS ( );
+		generator.generate ( settings, &pooled[0], GENTEST_SIZE, &pool );
+		double fPooledMS = GuruTimeMS ( ) - fStart;
+		unsigned int dwHeights = Checksum ( serial );
+		printf ( "  seed %u: heights %08x, %.1f ms serial, %.1f ms pooled\n", settings.seed, dwHeights, fSerialMS, fPooledMS );
+		sprintf ( pDescription, "seed %u heights match the golden checksum", settings.seed );
+		iFailed += GuruCheck ( dwHeights == g_Golden[s].dwHeights, pDescription );
+		sprintf ( pDescription, "seed %u pooled heights match serial", settings.seed );
+		iFailed += GuruCheck ( serial == pooled, pDescription );
+
+		// the preview is the same land at every eighth point
+		generator.generate ( settings, &preview[0], GENTEST_PREVIEW, NULL );
+		int iPreviewMismatches = 0;
+		for ( int z = 0; z < GENTEST_PREVIEW; z++ )
+			for ( int x = 0; x < GENTEST_PREVIEW; x++ )
+				if ( preview[z*GENTEST_PREVIEW+x] != serial[z*iStep*GENTEST_SIZE+x*iStep] ) iPreviewMismatches++;
+		sprintf ( pDescription, "seed %u preview matches the full map", settings.seed );
+		iFailed += GuruCheck ( iPreviewMismatches == 0, pDescription );
+
+		// eroded, the same again and nothing blows up
+		settings.erosionPasses = GENTEST_EROSION;
+		fStart = GuruTimeMS ( );
+		generator.generate ( settings, &serial[0], GENTEST_SIZE, NULL );
+		fSerialMS = GuruTimeMS ( ) - fStart;
+		fStart = GuruTimeMS ( );
+		generator.generate ( settings, &pooled[0], GENTEST_SIZE, &pool );
+		fPooledMS = GuruTimeMS ( ) - fStart;
+		unsigned int dwEroded = Checksum ( serial );
+		printf ( "  seed %u: eroded %08x, %.1f ms serial, %.1f ms pooled\n", settings.seed, dwEroded, fSerialMS, fPooledMS );
+		sprintf ( pDescription, "seed %u eroded heights match the golden checksum", settings.seed );
+		iFailed += GuruCheck ( dwEroded == g_Golden[s].dwEroded, pDescription );
+		sprintf ( pDescription, "seed %u pooled erosion matches serial and stays finite", settings.seed );
+		iFailed += GuruCheck ( serial == pooled && AllFinite ( serial ), pDescription );
+	}
+
+	return iFailed;
+}
@@ -0,0 +1,148 @@
+//
+// Terrain Horizon Test
+//
+
+#include "stdafx.h"
+#include "GuruTests.h"
+#include "TerrainHorizon.h"
+#include "cThreadPool.h"
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// a 1025 map of rolling hills, baked for suns from every side and overhead
+#define HORIZONTEST_SIZE		1025
+#define HORIZONTEST_SPACING		50.0f
+#define HORIZONTEST_REACH		16
+#define HORIZONTEST_SUNS		8
+#define HORIZONTEST_BRUSHES		5
+#define HORIZONTEST_RADIUS		10
+#define HORIZONTEST_RAYS		20000
+#define HORIZONTEST_AGREEMENT	0.95
+#define HORIZONTEST_THREADS		4
+
+namespace
+{
+	void MakeHills ( std::vector<float>& heights, bool bNoise )
+	{
+		heights.resize ( HORIZONTEST_SIZE*HORIZONTEST_SIZE );
+		for ( int z = 0; z < HORIZONTEST_SIZE; z++ )
+			for ( int x = 0; x < HORIZONTEST_SIZE; x++ )
+				heights[z*HORIZONTEST_SIZE+x] = 600 + 400*sinf(x*0.013f)*cosf(z*0.021f) + 300*sinf((x+z)*0.041f) + ( bNoise ? rand ( ) % 100 : 0 );
+	}
+
+	void FullBake ( TerrainHorizon& horizon, const float* pSun, const std::vector<float>& heights, cThreadPool* pPool )
+	{
+		int x1, z1, x2, z2;
+		horizon.setSize ( HORIZONTEST_SIZE, HORIZONTEST_SIZE, HORIZONTEST_SPACING, HORIZONTEST_REACH );
+		horizon.setSun ( pSun[0], pSun[1], pSun[2] );
+		horizon.setHeights ( 0, 0, HORIZONTEST_SIZE, HORIZONTEST_SIZE, &heights[0] );
+		horizon.bake ( pPool, x1, z1, x2, z2 );
+	}
+
+	bool SameMasks ( const TerrainHorizon& a, const TerrainHorizon& b )
+	{
+		size_t size = HORIZONTEST_SIZE*HORIZONTEST_SIZE;
+		return memcmp ( a.getLight ( ), b.getLight ( ), size ) == 0 && memcmp ( a.getOcclusion ( ), b.getOcclusion ( ), size ) == 0;
+	}
+
+	// marches from the cell towards the sun in quarter cell steps, as the old per texel bake did
+	bool RayMarchShadowed ( const std::vector<float>& heights, int x, int z, const float* pSun )
+	{
+		float fFlat = sqrtf ( pSun[0]*pSun[0] + pSun[2]*pSun[2] );
+		float fDirX = pSun[0] / fFlat, fDirZ = pSun[2] / fFlat, fRise = pSun[1] / fFlat;
+		float fStart = heights[z*HORIZONTEST_SIZE+x];
+		for ( float d = 0.25f; ; d += 0.25f )
+		{
+			float px = x + fDirX*d, pz = z + fDirZ*d;
+			if ( px < 0 || pz < 0 || px >= HORIZONTEST_SIZE-1 || pz >= HORIZONTEST_SIZE-1 ) return false;
+			int ix = (int) px, iz = (int) pz;
+			float fx = px - ix, fz = pz - iz;
+			const float* pRow = &heights[iz*HORIZONTEST_SIZE+ix];
+			float fHeight = ( pRow[0]*(1-fx) + pRow[1]*fx ) * (1-fz) + ( pRow[HORIZONTEST_SIZE]*(1-fx) + pRow[HORIZONTEST_SIZE+1]*fx ) * fz;
+			if ( fHeight > fStart + fRise*d*HORIZONTEST_SPACING + 1 ) return true;
+		}
+	}
+}
+
+int TerrainHorizonTest ( void )
+{
+	int iFailed = 0;
+	srand ( 1 );
+	std::vector<float> heights;
+	MakeHills ( heights, true );
+	cThreadPool pool ( HORIZONTEST_THREADS );
+	const float fSuns[HORIZONTEST_SUNS][3] =
+	{
+		{ 0.3f, 0.2f, 0.9f }, { -0.9f, 0.15f, 0.2f }, { 0.5f, 0.1f, -0.5f }, { -0.4f, 0.3f, -0.7f },
+		{ 1, 0.05f, 0 }, { 0, 0.2f, -1 }, { 0, 1, 0 }, { 0.2f, -1, 0 }
+	};
+
+	// for every sun the pooled bake matches the serial one, and brush edits baked
+	// a region at a time end up the same as baking the edited map from scratch
+	int iPoolMismatches = 0;
+	int iRegionMismatches = 0;
+	for ( int s = 0; s < HORIZONTEST_SUNS; s++ )
+	{
+		TerrainHorizon pooled, serial;
+		double fStart = GuruTimeMS ( );
+		FullBake ( pooled, fSuns[s], heights, &pool );
+		double fFullMS = GuruTimeMS ( ) - fStart;
+		FullBake ( serial, fSuns[s], heights, NULL );
+		if ( SameMasks ( pooled, serial ) == false ) iPoolMismatches++;
+
+		std::vector<float> edited ( heights );
+		double fBrushMS = 0;
+		for ( int e = 0; e < HORIZONTEST_BRUSHES; e++ )
+		{
+			const int r = HORIZONTEST_RADIUS;
+			int bx = 50 + rand ( ) % 900, bz = 50 + rand ( ) % 900;
+			std::vector<float> patch ( (2*r+1)*(2*r+1) );
+			for ( int z = -r; z <= r; z++ )
+			{
+				for ( int x = -r; x <= r; x++ )
+				{
+					float& fHeight = edited[(bz+z)*HORIZONTEST_SIZE+bx+x];
+					fHeight += ( e & 1 ? -1 : 1 ) * std::max ( 0.0f, (float) ( r*r - x*x - z*z ) ) * 8;
+					patch[(z+r)*(2*r+1)+x+r] = fHeight;
+				}
+			}
+			pooled.setHeights ( bx-r, bz-r, 2*r+1, 2*r+1, &patch[0] );
+			int x1, z1, x2, z2;
+			fStart = GuruTimeMS ( );
+			pooled.bake ( &pool, x1, z1, x2, z2 );
+			fBrushMS += GuruTimeMS ( ) - fStart;
+		}
+		TerrainHorizon fresh;
+		FullBake ( fresh, fSuns[s], edited, NULL );
+		if ( SameMasks ( pooled, fresh ) == false ) iRegionMismatches++;
+		printf ( "  sun %5.2f %5.2f %5.2f: %.2f ms to bake the map, %.3f ms a brush\n", fSuns[s][0], fSuns[s][1], fSuns[s][2], fFullMS, fBrushMS / HORIZONTEST_BRUSHES );
+	}
+	iFailed += GuruCheck ( iPoolMismatches == 0, "pooled bakes match serial bakes" );
+	iFailed += GuruCheck ( iRegionMismatches == 0, "region bakes after brush edits match a full bake" );
+
+	// the sweep agrees with marching a ray to the sun from each cell
+	std::vector<float> smooth;
+	MakeHills ( smooth, false );
+	const float fSun[3] = { 0.3f, 0.2f, 0.9f };
+	TerrainHorizon horizon;
+	FullBake ( horizon, fSun, smooth, NULL );
+	int iAgree = 0;
+	for ( int t = 0; t < HORIZONTEST_RAYS; t++ )
+	{
+		int x = rand ( ) % HORIZONTEST_SIZE, z = rand ( ) % HORIZONTEST_SIZE;
+		bool bShadowed = horizon.getLight ( )[z*HORIZONTEST_SIZE+x] < 128;
+		if ( RayMarchShadowed ( smooth, x, z, fSun ) == bShadowed ) iAgree++;
+	}
+	printf ( "  %.2f%% of cells agree with a ray march\n", 100.0 * iAgree / HORIZONTEST_RAYS );
+	iFailed += GuruCheck ( iAgree >= HORIZONTEST_RAYS * HORIZONTEST_AGREEMENT, "sun shadow agrees with a ray march" );
+
+	// nothing to do once baked
+	int x1, z1, x2, z2;
+	iFailed += GuruCheck ( horizon.isDirty ( ) == false && horizon.bake ( NULL, x1, z1, x2, z2 ) == false, "a clean map bakes nothing" );
+
+	return iFailed;
+}
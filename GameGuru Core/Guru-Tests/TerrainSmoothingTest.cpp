@@ -0,0 +1,73 @@
+//
+// Terrain Smoothing Test
+//
+
+#include "stdafx.h"
+#include "GuruTests.h"
+#include "smoothing.h"
+#include "cThreadPool.h"
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a 1024 heightmap with four passes, as BT_BuildTerrain smooths it
+#define SMOOTHTEST_SIZE			1024
+#define SMOOTHTEST_LEVELS		4
+
+namespace
+{
+	// the point at a time loop the wavefront replaced
+	void SerialSmooth ( float* pHeights, long lSize, unsigned long dwLevels )
+	{
+		for ( unsigned long dwLevel = 0; dwLevel < dwLevels; dwLevel++ )
+		{
+			for ( long y = 1; y < lSize-1; y++ )
+			{
+				for ( long x = 1; x < lSize-1; x++ )
+				{
+					float fCornerAverage = ( pHeights[(x-1)+(y-1)*lSize] + pHeights[(x+1)+(y-1)*lSize] + pHeights[(x-1)+(y+1)*lSize] + pHeights[(x+1)+(y+1)*lSize] ) / 4.0f;
+					float fNeighborAverage = ( fCornerAverage + pHeights[(x-1)+y*lSize] + pHeights[(x+1)+y*lSize] + pHeights[x+(y-1)*lSize] + pHeights[x+(y+1)*lSize] ) / 5.0f;
+					pHeights[x+y*lSize] = ( pHeights[x+y*lSize] + fNeighborAverage ) / 2.0f;
+				}
+			}
+		}
+	}
+}
+
+int TerrainSmoothingTest ( void )
+{
+	int iFailed = 0;
+	srand ( 1 );
+	std::vector<float> source ( SMOOTHTEST_SIZE*SMOOTHTEST_SIZE );
+	for ( size_t i = 0; i < source.size ( ); i++ ) source[i] = ( rand ( ) % 65536 ) / 16.0f;
+
+	std::vector<float> expected ( source );
+	double fStart = GuruTimeMS ( );
+	SerialSmooth ( &expected[0], SMOOTHTEST_SIZE, SMOOTHTEST_LEVELS );
+	printf ( "  serial loop: %.2f ms\n", GuruTimeMS ( ) - fStart );
+
+	// bit identical with no pool and any number of workers
+	const int iWorkerCounts[] = { 0, 1, 3, 7 };
+	for ( int w = 0; w < 4; w++ )
+	{
+		cThreadPool* pPool = iWorkerCounts[w] > 0 ? new cThreadPool ( iWorkerCounts[w] ) : NULL;
+		std::vector<float> heights ( source );
+		fStart = GuruTimeMS ( );
+		BT_Intern_SmoothHeights ( &heights[0], SMOOTHTEST_SIZE, SMOOTHTEST_LEVELS, pPool );
+		double fMS = GuruTimeMS ( ) - fStart;
+		char pDescription[64];
+		sprintf ( pDescription, "wavefront with %d workers matches the serial loop", iWorkerCounts[w] );
+		printf ( "  %d workers: %.2f ms\n", iWorkerCounts[w], fMS );
+		iFailed += GuruCheck ( memcmp ( &heights[0], &expected[0], heights.size ( ) * sizeof(float) ) == 0, pDescription );
+		delete pPool;
+	}
+
+	// no levels or too small a map leaves the heights alone
+	std::vector<float> untouched ( source );
+	BT_Intern_SmoothHeights ( &untouched[0], SMOOTHTEST_SIZE, 0, NULL );
+	BT_Intern_SmoothHeights ( &untouched[0], 2, SMOOTHTEST_LEVELS, NULL );
+	iFailed += GuruCheck ( untouched == source, "nothing is smoothed with no levels or a two point map" );
+
+	return iFailed;
+}
@@ -0,0 +1,198 @@
+//
+// Terrain Undo Test
+//
+
+#include "stdafx.h"
+#include "GuruTests.h"
+#include "TerrainUndo.h"
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// a 1025 square height map and a 2048 square paint map as the editor keeps them
+#define UNDOTEST_HEIGHTSIZE		1025
+#define UNDOTEST_PAINTSIZE		2048
+#define UNDOTEST_PACKRUNS		20000
+#define UNDOTEST_STROKES		500
+#define UNDOTEST_DABS			20
+
+namespace
+{
+	std::vector<float> g_Heights;
+	std::vector<unsigned int> g_Paint;
+
+	void ReadHeights ( int x, int z, int width, int height, unsigned char* data )
+	{
+		for ( int r = 0; r < height; r++ ) memcpy ( data + r*width*4, &g_Heights[(z+r)*UNDOTEST_HEIGHTSIZE+x], width*4 );
+	}
+
+	void WriteHeights ( int x, int z, int width, int height, const unsigned char* data )
+	{
+		for ( int r = 0; r < height; r++ ) memcpy ( &g_Heights[(z+r)*UNDOTEST_HEIGHTSIZE+x], data + r*width*4, width*4 );
+	}
+
+	void ReadPaint ( int x, int z, int width, int height, unsigned char* data )
+	{
+		for ( int r = 0; r < height; r++ ) memcpy ( data + r*width*4, &g_Paint[(z+r)*UNDOTEST_PAINTSIZE+x], width*4 );
+	}
+
+	void WritePaint ( int x, int z, int width, int height, const unsigned char* data )
+	{
+		for ( int r = 0; r < height; r++ ) memcpy ( &g_Paint[(z+r)*UNDOTEST_PAINTSIZE+x], data + r*width*4, width*4 );
+	}
+
+	unsigned long long Hash ( const void* pData, size_t size )
+	{
+		const unsigned char* pBytes = (const unsigned char*) pData;
+		unsigned long long hash = 1469598103934665603ULL;
+		for ( size_t i = 0; i < size; i++ )
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	unsigned long long HashTerrain ( void )
+	{
+		return Hash ( &g_Heights[0], g_Heights.size ( ) * 4 ) ^ ( Hash ( &g_Paint[0], g_Paint.size ( ) * 4 ) * 31 );
+	}
+
+	// a wandering brush that either raises a mound or blends red into the paint
+	void Stroke ( TerrainUndo& undo )
+	{
+		int cx = rand ( ) % UNDOTEST_HEIGHTSIZE;
+		int cz = rand ( ) % UNDOTEST_HEIGHTSIZE;
+		int r = 2 + rand ( ) % 12;
+		bool bPaint = ( rand ( ) % 2 ) == 1;
+		for ( int k = 0; k < UNDOTEST_DABS; k++ )
+		{
+			cx += ( rand ( ) % 5 ) - 2;
+			cz += ( rand ( ) % 5 ) - 2;
+			if ( bPaint == false )
+			{
+				undo.touch ( TERRAINUNDO_HEIGHT, cx-r-1, cz-r-1, cx+r+1, cz+r+1 );
+				for ( int z = cz-r; z <= cz+r; z++ )
+				{
+					for ( int x = cx-r; x <= cx+r; x++ )
+					{
+						if ( x < 0 || z < 0 || x >= UNDOTEST_HEIGHTSIZE || z >= UNDOTEST_HEIGHTSIZE ) continue;
+						float d = sqrtf ( (float) ( (x-cx)*(x-cx) + (z-cz)*(z-cz) ) );
+						if ( d < r ) g_Heights[z*UNDOTEST_HEIGHTSIZE+x] += ( r - d ) * 0.7f;
+					}
+				}
+			}
+			else
+			{
+				undo.touch ( TERRAINUNDO_PAINT, 2*cx-2*r-2, 2*cz-2*r-2, 2*cx+2*r+2, 2*cz+2*r+2 );
+				for ( int z = 2*cz-2*r; z <= 2*cz+2*r; z++ )
+				{
+					for ( int x = 2*cx-2*r; x <= 2*cx+2*r; x++ )
+					{
+						if ( x < 0 || z < 0 || x >= UNDOTEST_PAINTSIZE || z >= UNDOTEST_PAINTSIZE ) continue;
+						unsigned int& dwTexel = g_Paint[z*UNDOTEST_PAINTSIZE+x];
+						unsigned int dwRed = (unsigned int) ( ( dwTexel & 0xFF ) * 0.85f + 255 * 0.15f );
+						dwTexel = ( dwTexel & ~0xFFu ) | dwRed;
+					}
+				}
+			}
+		}
+	}
+}
+
+int TerrainUndoTest ( void )
+{
+	int iFailed = 0;
+
+	// the difference coding must give back every kind of tile, noise, sparse changes and repeats
+	srand ( 5 );
+	int iBadPacks = 0;
+	for ( int iRun = 0; iRun < UNDOTEST_PACKRUNS; iRun++ )
+	{
+		int iCellSize = 1 + rand ( ) % 4;
+		int iSize = ( 1 + rand ( ) % 4096 ) * iCellSize;
+		int iMode = rand ( ) % 3;
+		std::vector<unsigned char> data ( iSize ), unpacked ( iSize ), packed;
+		for ( int i = 0; i < iSize; i++ )
+		{
+			if ( iMode == 0 ) data[i] = (unsigned char) rand ( );
+			else if ( iMode == 1 ) data[i] = (unsigned char) ( rand ( ) % 10 == 0 ? rand ( ) : 0 );
+			else data[i] = (unsigned char) ( i % 7 );
+		}
+		TerrainUndoPack ( &data[0], iSize, iCellSize, packed );
+		if ( TerrainUndoUnpack ( packed.empty ( ) ? NULL : &packed[0], (int) packed.size ( ), iCellSize, &unpacked[0], iSize ) == false || unpacked != data )
+			iBadPacks++;
+	}
+	iFailed += GuruCheck ( iBadPacks == 0, "packed differences unpack to the same bytes" );
+
+	// record strokes, keeping a hash of the terrain after each step
+	g_Heights.resize ( UNDOTEST_HEIGHTSIZE*UNDOTEST_HEIGHTSIZE );
+	for ( size_t i = 0; i < g_Heights.size ( ); i++ ) g_Heights[i] = 600 + 50 * sinf ( i * 0.001f );
+	g_Paint.assign ( UNDOTEST_PAINTSIZE*UNDOTEST_PAINTSIZE, 0xFF204060 );
+	TerrainUndo undo;
+	undo.setLayer ( TERRAINUNDO_HEIGHT, UNDOTEST_HEIGHTSIZE, UNDOTEST_HEIGHTSIZE, 4, ReadHeights, WriteHeights );
+	undo.setLayer ( TERRAINUNDO_PAINT, UNDOTEST_PAINTSIZE, UNDOTEST_PAINTSIZE, 4, ReadPaint, WritePaint );
+	undo.setLimits ( 1000, (size_t) 1 << 30 );
+	srand ( 1 );
+	std::vector<unsigned long long> hashes;
+	hashes.push_back ( HashTerrain ( ) );
+	double fRecordMS = 0;
+	for ( int s = 0; s < UNDOTEST_STROKES; s++ )
+	{
+		int iStepsBefore = undo.getStepCount ( );
+		double fStart = GuruTimeMS ( );
+		undo.beginStep ( );
+		Stroke ( undo );
+		undo.endStep ( );
+		fRecordMS += GuruTimeMS ( ) - fStart;
+		if ( undo.getStepCount ( ) != iStepsBefore ) hashes.push_back ( HashTerrain ( ) );
+	}
+	int iSteps = undo.getStepCount ( );
+	printf ( "  %d steps in %.2f MB, %.3f ms a step to record\n", iSteps, undo.getMemoryUsed ( ) / 1048576.0, fRecordMS / iSteps );
+	iFailed += GuruCheck ( iSteps == UNDOTEST_STROKES && (int) hashes.size ( ) == iSteps + 1, "every stroke made a step" );
+
+	// undo everything then redo everything, every state must match the one recorded
+	int iBadUndos = 0;
+	double fTotalMS = 0;
+	double fWorstMS = 0;
+	for ( int s = iSteps - 1; s >= 0; s-- )
+	{
+		double fStepStart = GuruTimeMS ( );
+		undo.undo ( );
+		double fStepMS = GuruTimeMS ( ) - fStepStart;
+		fTotalMS += fStepMS;
+		if ( fStepMS > fWorstMS ) fWorstMS = fStepMS;
+		if ( HashTerrain ( ) != hashes[s] ) iBadUndos++;
+	}
+	printf ( "  undo %.3f ms a step, worst %.3f ms\n", fTotalMS / iSteps, fWorstMS );
+	iFailed += GuruCheck ( iBadUndos == 0, "every undo restores the state before the stroke" );
+	iFailed += GuruCheck ( undo.canUndo ( ) == false && undo.undo ( ) == 0, "nothing is left to undo" );
+	int iBadRedos = 0;
+	fTotalMS = 0;
+	fWorstMS = 0;
+	for ( int s = 1; s <= iSteps; s++ )
+	{
+		double fStepStart = GuruTimeMS ( );
+		undo.redo ( );
+		double fStepMS = GuruTimeMS ( ) - fStepStart;
+		fTotalMS += fStepMS;
+		if ( fStepMS > fWorstMS ) fWorstMS = fStepMS;
+		if ( HashTerrain ( ) != hashes[s] ) iBadRedos++;
+	}
+	printf ( "  redo %.3f ms a step, worst %.3f ms\n", fTotalMS / iSteps, fWorstMS );
+	iFailed += GuruCheck ( iBadRedos == 0, "every redo restores the state after the stroke" );
+	iFailed += GuruCheck ( undo.canRedo ( ) == false && undo.redo ( ) == 0, "nothing is left to redo" );
+
+	// half the memory drops the oldest steps, the newest still undo
+	size_t budget = undo.getMemoryUsed ( ) / 2;
+	undo.setLimits ( 1000, budget );
+	int iKept = undo.getStepCount ( );
+	printf ( "  %d steps kept in %.2f MB\n", iKept, undo.getMemoryUsed ( ) / 1048576.0 );
+	iFailed += GuruCheck ( undo.getMemoryUsed ( ) <= budget && iKept > 0 && iKept < iSteps, "the memory limit drops the oldest steps" );
+	undo.undo ( );
+	iFailed += GuruCheck ( HashTerrain ( ) == hashes[iSteps-1], "the newest step still undoes after trimming" );
+
+	return iFailed;
+}
@@ -0,0 +1,53 @@
+//
+// Guru-Tests - standalone checks and benchmarks for engine modules that run without a device
+//
+
+#include "stdafx.h"
+#include "GuruTests.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+struct sGuruTest
+{
+	const char* pName;
+	int ( *pFunction ) ( void );
+};
+
+static sGuruTest g_GuruTests[] =
+{
+	{ "occlusion", OcclusionRasterizerTest },
+	{ "particles", ParticleSimTest },
+	{ "terrainundo", TerrainUndoTest },
+	{ "terrainsmoothing", TerrainSmoothingTest },
+	{ "terrainhorizon", TerrainHorizonTest },
+	{ "terraingenerator", TerrainGeneratorTest },
+};
+
+int GuruCheck ( bool bPassed, const char* pDescription )
+{
+	printf ( "  %s: %s\n", bPassed ? "ok" : "FAILED", pDescription );
+	return bPassed ? 0 : 1;
+}
+
+double GuruTimeMS ( void )
+{
+	return std::chrono::duration<double, std::milli> ( std::chrono::steady_clock::now ( ).time_since_epoch ( ) ).count ( );
+}
+
+int main ( int argc, char* argv[] )
+{
+	// run every test, or only those named on the command line, the exit code is the number of failures
+	int iFailed = 0;
+	int iTestCount = sizeof(g_GuruTests) / sizeof(g_GuruTests[0]);
+	for ( int i = 0; i < iTestCount; i++ )
+	{
+		bool bRun = argc < 2;
+		for ( int a = 1; a < argc; a++ ) if ( strcmp ( argv[a], g_GuruTests[i].pName ) == 0 ) bRun = true;
+		if ( bRun == false ) continue;
+		printf ( "%s\n", g_GuruTests[i].pName );
+		iFailed += g_GuruTests[i].pFunction ( );
+	}
+	printf ( "%d failed\n", iFailed );
+	return iFailed;
+}
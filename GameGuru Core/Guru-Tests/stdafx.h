@@ -0,0 +1,5 @@
+//
+// Guru-Tests - the modules under test only need the platform headers
+//
+
+#include "Windows.h"